@@ -9,12 +9,16 @@
 
 #include "NetworkMonitor/Common.h"
 #include "NetworkMonitor/ConfigManager.h"
+#include "NetworkMonitor/ConfigFile.h"
+#include "NetworkMonitor/ConfigStore.h"
 #include "NetworkMonitor/NetworkMonitor.h"
 #include "NetworkMonitor/TrayIcon.h"
 #include "NetworkMonitor/TaskbarOverlay.h"
 #include "NetworkMonitor/PingMonitor.h"
+#include "NetworkMonitor/UsageDeltaTracker.h"
 #include <windows.h>
 #include <memory>
+#include <vector>
 
 namespace NetworkMonitor
 {
@@ -38,13 +42,17 @@ public:
     TrayIcon* GetTrayIcon() { return m_pTrayIcon.get(); }
     TaskbarOverlay* GetTaskbarOverlay() { return m_pTaskbarOverlay.get(); }
     PingMonitor* GetPingMonitor() { return m_pPingMonitor.get(); }
-    const AppConfig& GetConfig() const { return m_config; }
+    const AppConfig& GetConfig() const { return m_configStore.Current(); }
+    ConfigStore& GetConfigStore() { return m_configStore; }
 
-    // Configuration operations
+    // Configuration operations: both publish the result to the store
     bool LoadConfig();
-    bool SaveConfig();
+    bool SaveConfig(const AppConfig& config);
     void ApplyLanguageFromConfig();
 
+    // Settings file edited outside the app (portable mode)
+    void OnConfigFileChanged();
+
     // UI operations
     void ShowSettingsDialog();
     void ShowDashboardDialog();
@@ -74,10 +82,11 @@ private:
     void UnregisterHotkeys();
     void CenterDialogOnScreen(HWND hDlg);
     NetworkStats GetCurrentStatsForConfig();
-    void LogHistorySample(const NetworkStats& stats);
+    void LogHistorySamples();
     void UpdateTrayIcon(const NetworkStats& stats);
     void UpdateTaskbarOverlay(const NetworkStats& stats);
     void CheckConnectionStatus(bool hasActiveInterface);
+    void SubscribeToConfigChanges();
 
     // Component instances (using smart pointers for automatic cleanup)
     std::unique_ptr<ConfigManager> m_pConfigManager;
@@ -85,16 +94,16 @@ private:
     std::unique_ptr<TrayIcon> m_pTrayIcon;
     std::unique_ptr<TaskbarOverlay> m_pTaskbarOverlay;
     std::unique_ptr<PingMonitor> m_pPingMonitor;
+    std::unique_ptr<ConfigFileWatcher> m_pConfigWatcher;   // Portable mode only
 
-    // Application state
-    AppConfig m_config;
+    // Application state; every thread reads the config through the store
+    ConfigStore m_configStore;
     HWND m_hwnd;
     HINSTANCE m_hInstance;
 
-    // Previous totals for logging per-interval usage
-    unsigned long long m_prevTotalBytesDown;
-    unsigned long long m_prevTotalBytesUp;
-    bool m_prevTotalsValid;
+    // Per-interface counters between history logging ticks
+    UsageDeltaTracker m_usageDeltas;
+    std::vector<InterfaceUsage> m_tickUsage;
 
     // Connection state tracking
     bool m_wasConnected;
@@ -0,0 +1,115 @@
+// ============================================================================
+// File: AsyncQuery.h
+// Description: Results, supersession and options for asynchronous history queries
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#ifndef NETWORK_MONITOR_ASYNCQUERY_H
+#define NETWORK_MONITOR_ASYNCQUERY_H
+
+#include "NetworkMonitor/Common.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace NetworkMonitor
+{
+
+// Threads running asynchronous HistoryLogger queries. Two, so a long export
+// or statistics scan does not hold up the dashboard's small queries.
+constexpr int HISTORY_QUERY_THREADS = 2;
+
+// Outcome of an asynchronous query. value is only meaningful when ok.
+template <typename T>
+struct AsyncQueryResult
+{
+    bool ok;          // Ran to completion and succeeded
+    bool cancelled;   // Superseded, cancelled or shut down before finishing
+    T value;
+
+    AsyncQueryResult()
+        : ok(false)
+        , cancelled(false)
+        , value()
+    {
+    }
+};
+
+// Download and upload byte counts of a totals query
+struct UsageTotals
+{
+    unsigned long long bytesDown;
+    unsigned long long bytesUp;
+
+    UsageTotals()
+        : bytesDown(0)
+        , bytesUp(0)
+    {
+    }
+};
+
+/**
+ * Supersession point for asynchronous queries: each query submitted
+ * through a slot cancels the one submitted before it. A query still queued
+ * is dropped without touching SQLite; one already running is interrupted at
+ * its next progress check. Either way its future reports cancelled.
+ *
+ * A dialog typically keeps one slot per view it refreshes, so clicking
+ * Refresh repeatedly leaves only the newest request doing work.
+ */
+class QuerySlot
+{
+public:
+    QuerySlot() = default;
+    ~QuerySlot() { Cancel(); }
+
+    QuerySlot(const QuerySlot&) = delete;
+    QuerySlot& operator=(const QuerySlot&) = delete;
+
+    // Cancel the query last submitted through this slot, if any
+    void Cancel()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_current)
+        {
+            m_current->store(true);
+        }
+    }
+
+    // Cancel the previous query and return the flag for a new one
+    std::shared_ptr<std::atomic<bool>> Supersede()
+    {
+        auto next = std::make_shared<std::atomic<bool>>(false);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_current)
+        {
+            m_current->store(true);
+        }
+        m_current = next;
+        return next;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::shared_ptr<std::atomic<bool>> m_current;
+};
+
+struct AsyncQueryOptions
+{
+    // Optional; a newer query through the same slot cancels this one
+    QuerySlot* slot;
+
+    // Optional; called on the query thread once the future is ready
+    // (including when cancelled). Keep it short, e.g. post a window message.
+    std::function<void()> onComplete;
+
+    AsyncQueryOptions()
+        : slot(nullptr)
+    {
+    }
+};
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_ASYNCQUERY_H
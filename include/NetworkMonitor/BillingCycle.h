@@ -0,0 +1,117 @@
+// ============================================================================
+// File: BillingCycle.h
+// Description: Billing cycle boundaries, quotas and end-of-cycle projection
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#ifndef NETWORK_MONITOR_BILLINGCYCLE_H
+#define NETWORK_MONITOR_BILLINGCYCLE_H
+
+#include "NetworkMonitor/Common.h"
+#include <string>
+#include <ctime>
+
+namespace NetworkMonitor
+{
+
+// Hours in the time-of-day usage profile passed to ProjectBillingUsage
+constexpr int BILLING_PROFILE_HOURS = 24;
+
+// [start, end) of one billing cycle, as UTC epoch seconds
+struct BillingPeriod
+{
+    std::time_t start;
+    std::time_t end;
+
+    BillingPeriod()
+        : start(0)
+        , end(0)
+    {
+    }
+};
+
+/**
+ * The billing cycle containing t. A cycle starts at local midnight on
+ * startDay and ends where the next month's cycle starts. In months shorter
+ * than startDay the cycle starts on the month's last day instead, so a
+ * cycle configured for the 31st starts on 28 or 29 February.
+ *
+ * Boundaries are local midnights from the shared LocalCalendar (mktime
+ * outside its window), so a cycle spanning a DST change is an hour shorter
+ * or longer than its calendar days.
+ * @param startDay Day of month, clamped to 1..31
+ * @return false if local time conversion fails
+ */
+bool GetBillingPeriod(std::time_t t, int startDay, BillingPeriod& out);
+
+/**
+ * Maps timestamps to the start of their billing cycle. The bounds of the
+ * last cycle looked up are kept, so a stream of samples costs one range
+ * check each and only a timestamp in another cycle needs a calendar lookup.
+ */
+class BillingCycleCache
+{
+public:
+    explicit BillingCycleCache(int startDay = DEFAULT_BILLING_CYCLE_START_DAY);
+
+    int StartDay() const { return m_startDay; }
+    void SetStartDay(int startDay);
+
+    // Start of the cycle containing t, or -1 if local time conversion fails
+    std::time_t CycleStart(std::time_t t);
+
+private:
+    int m_startDay;
+    BillingPeriod m_period;
+    bool m_valid;
+};
+
+// Usage of one interface (or all) in the current cycle, with projections.
+// Quota and projections count download and upload together, as metered
+// plans do.
+struct BillingStatus
+{
+    BillingPeriod period;
+    std::time_t asOf;                      // Time the status was taken
+    unsigned long long bytesDown;          // So far this cycle
+    unsigned long long bytesUp;
+    unsigned long long quotaBytes;         // 0 = no cap
+
+    // Expected cycle total if the average rate so far continues
+    unsigned long long projectedLinear;
+    // Expected cycle total if each remaining hour sees the recent average
+    // for that hour of the day
+    unsigned long long projectedWeighted;
+
+    // When each projection reaches the quota; asOf if it is already used up,
+    // 0 if there is no quota or it lasts the cycle
+    std::time_t capReachedLinear;
+    std::time_t capReachedWeighted;
+
+    BillingStatus()
+        : asOf(0)
+        , bytesDown(0)
+        , bytesUp(0)
+        , quotaBytes(0)
+        , projectedLinear(0)
+        , projectedWeighted(0)
+        , capReachedLinear(0)
+        , capReachedWeighted(0)
+    {
+    }
+};
+
+/**
+ * Fill the projection fields of status from its period, asOf, byte counts
+ * and quota.
+ * @param hourlyProfile Average bytes per local hour of day (24 entries),
+ *                      or nullptr to reuse the linear projection
+ */
+void ProjectBillingUsage(BillingStatus& status, const double* hourlyProfile);
+
+// Quota configured for an interface ("" = all interfaces), 0 if none
+unsigned long long GetBillingQuota(const AppConfig& config, const std::wstring& interfaceName);
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_BILLINGCYCLE_H
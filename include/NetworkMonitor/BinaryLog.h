@@ -0,0 +1,372 @@
+// ============================================================================
+// File: BinaryLog.h
+// Description: Deferred-formatting binary log records and their decoder
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#ifndef NETWORK_MONITOR_BINARYLOG_H
+#define NETWORK_MONITOR_BINARYLOG_H
+
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/DiagnosticLog.h"
+#include "NetworkMonitor/LogRotation.h"
+#include "NetworkMonitor/Utils.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <cwchar>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace NetworkMonitor
+{
+
+// FNV-1a over the UTF-16 units of a format string
+constexpr unsigned long long HashLogFormat(const wchar_t* text)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    for (; *text; ++text)
+    {
+        hash ^= static_cast<unsigned long long>(static_cast<unsigned short>(*text));
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * Format of a log message, e.g. L"samples returned: {} (limit={})".
+ * Each "{}" takes the next argument; surplus "{}" stay as they are.
+ *
+ * The text must be a string literal: the binary log keeps its address until
+ * the record is written. Declared static constexpr, the id is worked out by
+ * the compiler.
+ */
+struct LogFormat
+{
+    const wchar_t* text;
+    unsigned long long id;
+
+    constexpr explicit LogFormat(const wchar_t* formatText)
+        : text(formatText)
+        , id(HashLogFormat(formatText))
+    {
+    }
+};
+
+// A string that lives for the whole process (a literal); the binary log
+// records its address and writes the text once per file
+struct LogInterned
+{
+    const wchar_t* text;
+
+    constexpr explicit LogInterned(const wchar_t* staticText)
+        : text(staticText)
+    {
+    }
+};
+
+enum class LogArgumentType : unsigned char
+{
+    None = 0,
+    Signed = 1,
+    Unsigned = 2,
+    Double = 3,
+    Interned = 4,
+    Text = 5
+};
+
+// One argument of a log call, by value for numbers and by pointer for text
+struct LogArgument
+{
+    LogArgumentType type;
+    unsigned long long bits;    // Integer value, or the bit pattern of a double
+    const wchar_t* text;        // Interned or inline text
+    size_t length;              // Units of inline text
+
+    LogArgument()
+        : type(LogArgumentType::None)
+        , bits(0)
+        , text(nullptr)
+        , length(0)
+    {
+    }
+};
+
+template <typename T,
+          typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, int>::type = 0>
+LogArgument MakeLogArgument(T value)
+{
+    LogArgument argument;
+    if (std::is_signed<T>::value)
+    {
+        argument.type = LogArgumentType::Signed;
+        argument.bits = static_cast<unsigned long long>(static_cast<long long>(value));
+    }
+    else
+    {
+        argument.type = LogArgumentType::Unsigned;
+        argument.bits = static_cast<unsigned long long>(value);
+    }
+    return argument;
+}
+
+inline LogArgument MakeLogArgument(double value)
+{
+    LogArgument argument;
+    argument.type = LogArgumentType::Double;
+    std::memcpy(&argument.bits, &value, sizeof(value));
+    return argument;
+}
+
+inline LogArgument MakeLogArgument(LogInterned value)
+{
+    LogArgument argument;
+    argument.type = LogArgumentType::Interned;
+    argument.bits = static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(value.text));
+    argument.text = value.text;
+    return argument;
+}
+
+inline LogArgument MakeLogArgument(const std::wstring& value)
+{
+    LogArgument argument;
+    argument.type = LogArgumentType::Text;
+    argument.text = value.c_str();
+    argument.length = value.size();
+    return argument;
+}
+
+inline LogArgument MakeLogArgument(const wchar_t* value)
+{
+    LogArgument argument;
+    argument.type = LogArgumentType::Text;
+    argument.text = value ? value : L"";
+    argument.length = std::wcslen(argument.text);
+    return argument;
+}
+
+// Substitute the arguments into the format. Numbers come out as
+// std::to_wstring would print them, so a message logged through a format
+// reads the same as one concatenated by hand.
+std::wstring RenderLogFormat(const wchar_t* format, const LogArgument* args, size_t count);
+
+struct BinaryLogOptions
+{
+    std::wstring path;              // Binary log file, appended to
+    unsigned int threadBufferBytes; // Per-thread ring, rounded up to a power of two
+    unsigned int flushIntervalMs;   // Longest a record waits before it is written
+    LogRotationOptions rotation;
+
+    BinaryLogOptions()
+        : threadBufferBytes(64 * 1024)
+        , flushIntervalMs(1000)
+    {
+    }
+};
+
+struct BinaryLogStats
+{
+    unsigned long long written;     // Records written to the file
+    unsigned long long dropped;     // Records refused because a thread's ring was full
+    unsigned long long writes;      // WriteFile batches
+    unsigned long long threads;     // Threads with a ring still registered
+    unsigned long long rotations;   // Files moved aside
+
+    BinaryLogStats()
+        : written(0)
+        , dropped(0)
+        , writes(0)
+        , threads(0)
+        , rotations(0)
+    {
+    }
+};
+
+struct BinaryLogThreadBuffer;
+
+/**
+ * Log writer that leaves formatting to an offline decoder.
+ *
+ * Write copies the format id and the raw arguments into a ring owned by the
+ * calling thread: no lock, no allocation after the thread's first record,
+ * no text conversion. A background thread merges what the rings hold by
+ * timestamp and appends the records to the file, writing each format string
+ * and interned string once per file session. Each thread's records stay in
+ * order; across threads the order is by time within one writer pass.
+ * ReadBinaryLog turns the file back into the lines DiagnosticLog would have
+ * written.
+ *
+ * Records are written when flushIntervalMs has passed, as soon as an
+ * error-level record arrives, when a thread's ring is half full, on Flush
+ * and on destruction. A thread that exits keeps its ring registered until
+ * the writer has emptied it.
+ *
+ * The file rotates between batches once it reaches the size cap (so it may
+ * pass it by up to one batch) or the age limit; every file starts a new
+ * session and decodes on its own.
+ *
+ * Inline text is limited to 65535 UTF-16 units and cut there.
+ */
+class BinaryLog
+{
+public:
+    explicit BinaryLog(const BinaryLogOptions& options);
+    ~BinaryLog();   // Writes everything recorded so far
+
+    BinaryLog(const BinaryLog&) = delete;
+    BinaryLog& operator=(const BinaryLog&) = delete;
+
+    // Record one message; false if it was dropped
+    template <typename... Args>
+    bool Write(LogLevel level, const LogFormat& format, const Args&... args)
+    {
+        const LogArgument arguments[sizeof...(Args) + 1] = { MakeLogArgument(args)..., LogArgument() };
+        return WriteRecord(level, format, arguments, sizeof...(Args));
+    }
+
+    bool WriteRecord(LogLevel level, const LogFormat& format, const LogArgument* args, size_t count);
+
+    // Block until every record written before the call is in the file
+    void Flush();
+
+    // Takes effect from the next batch
+    void SetRotation(const LogRotationOptions& rotation);
+
+    BinaryLogStats GetStats() const;
+
+private:
+    BinaryLogThreadBuffer* GetThreadBuffer();
+    BinaryLogThreadBuffer* RegisterThread();
+    void WriterThreadMain();
+    size_t Drain(std::vector<std::shared_ptr<BinaryLogThreadBuffer>>& buffers, std::string& out, bool& sawError);
+    void AppendRecord(const std::string& record, std::string& out);
+    void AppendDefinition(unsigned char tag, unsigned long long key, const wchar_t* text, std::string& out);
+    bool WriteOut(std::string& buffer);
+    void Wake();
+
+    size_t m_bufferBytes;
+    unsigned int m_flushIntervalMs;
+    unsigned long long m_serial;            // Tells this log's thread rings apart
+
+    alignas(64) std::atomic<unsigned long long> m_dropped;
+    std::atomic<bool> m_wakePending;        // A producer already woke the writer
+
+    // Writer thread only
+    RotatingLogFile m_file;
+    bool m_needHeader;                      // Next batch starts a new file session
+    std::vector<unsigned long long> m_writtenFormats;
+    std::vector<unsigned long long> m_writtenStrings;
+    unsigned long long m_reportedDrops;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;         // Writer: work or stop
+    std::condition_variable m_progress;     // Flush waiters
+    std::vector<std::shared_ptr<BinaryLogThreadBuffer>> m_buffers;  // Guarded by m_mutex
+    bool m_wakeRequested;                   // Guarded by m_mutex
+    bool m_flushRequested;                  // Guarded by m_mutex
+    bool m_stop;                            // Guarded by m_mutex
+    LogRotationOptions m_rotation;          // Guarded by m_mutex
+    bool m_rotationChanged;                 // Guarded by m_mutex
+    unsigned long long m_passesStarted;     // Guarded by m_mutex
+    unsigned long long m_passesWritten;     // Guarded by m_mutex
+    BinaryLogStats m_stats;                 // Guarded by m_mutex
+
+    std::thread m_writer;
+};
+
+// One message read back from a binary log
+struct DecodedLogRecord
+{
+    unsigned long long time;        // FILETIME ticks, UTC
+    LogLevel level;
+    unsigned long long dropped;     // Non-zero: a dropped-records notice
+    std::wstring text;
+
+    DecodedLogRecord()
+        : time(0)
+        , level(LogLevel::Debug)
+        , dropped(0)
+    {
+    }
+};
+
+// Call visitor for each record in file order. False if the file could not
+// be opened or is not a binary log; a record cut short by a crash ends the
+// read quietly.
+bool ReadBinaryLog(const std::wstring& path, const std::function<void(const DecodedLogRecord&)>& visitor);
+
+// The line DiagnosticLog writes for the same message, CRLF included
+std::string FormatDecodedLogLine(const DecodedLogRecord& record);
+
+// Write the text form of a binary log; recordsOut gets the line count
+bool DecodeBinaryLog(const std::wstring& binaryPath, const std::wstring& textPath, unsigned long long* recordsOut);
+
+// ============================================================================
+// FORMATTED LOGGING
+// ============================================================================
+
+// Record through the process's binary log; false while the text log is in
+// use, and once the binary log has shut down at exit
+bool WriteBinaryLogRecord(LogLevel level, const LogFormat& format, const LogArgument* args, size_t count);
+
+// Log through a format: as a binary record when the binary debug log is
+// on, otherwise rendered here and passed to LogDebug / LogError
+template <typename... Args>
+void LogDebugFormat(const LogFormat& format, const Args&... args)
+{
+    if (!IsDebugLoggingEnabled())
+    {
+        return;
+    }
+
+    const LogArgument arguments[sizeof...(Args) + 1] = { MakeLogArgument(args)..., LogArgument() };
+    if (WriteBinaryLogRecord(LogLevel::Debug, format, arguments, sizeof...(Args)))
+    {
+        return;
+    }
+    LogDebug(RenderLogFormat(format.text, arguments, sizeof...(Args)));
+}
+
+template <typename... Args>
+void LogErrorFormat(const LogFormat& format, const Args&... args)
+{
+    const LogArgument arguments[sizeof...(Args) + 1] = { MakeLogArgument(args)..., LogArgument() };
+    if (WriteBinaryLogRecord(LogLevel::Error, format, arguments, sizeof...(Args)))
+    {
+        return;
+    }
+    LogError(RenderLogFormat(format.text, arguments, sizeof...(Args)));
+}
+
+} // namespace NetworkMonitor
+
+// Format counterparts of NM_LOG_DEBUG / NM_LOG_ERROR: the arguments are
+// evaluated only when the record is logged
+//   NM_LOG_DEBUG_FORMAT(SAMPLES_FORMAT, count, limit);
+#define NM_LOG_DEBUG_FORMAT(...)                                    \
+    do                                                              \
+    {                                                               \
+        if constexpr (NM_MIN_LOG_LEVEL <= NM_LOG_LEVEL_DEBUG)       \
+        {                                                           \
+            if (::NetworkMonitor::IsDebugLoggingEnabled())          \
+            {                                                       \
+                ::NetworkMonitor::LogDebugFormat(__VA_ARGS__);      \
+            }                                                       \
+        }                                                           \
+    } while (0)
+
+#define NM_LOG_ERROR_FORMAT(...)                                    \
+    do                                                              \
+    {                                                               \
+        if constexpr (NM_MIN_LOG_LEVEL <= NM_LOG_LEVEL_ERROR)       \
+        {                                                           \
+            ::NetworkMonitor::LogErrorFormat(__VA_ARGS__);          \
+        }                                                           \
+    } while (0)
+
+#endif // NETWORK_MONITOR_BINARYLOG_H
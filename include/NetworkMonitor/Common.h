@@ -36,6 +36,7 @@
 // ============================================================================
 
 #include <string>
+#include <map>
 #include <cstdint>
 
 // ============================================================================
@@ -56,10 +57,26 @@ constexpr UINT UPDATE_INTERVAL_SLOW = 5000;      // 5 seconds
 constexpr UINT DEFAULT_UPDATE_INTERVAL = UPDATE_INTERVAL_NORMAL;
 constexpr int DEFAULT_HISTORY_AUTO_TRIM_DAYS = 0;
 constexpr int MAX_HISTORY_AUTO_TRIM_DAYS = 365;
+constexpr int DEFAULT_HISTORY_RAW_DAYS = 0;          // Forever; raw rows are only deleted by choice
+constexpr int DEFAULT_HISTORY_MINUTE_DAYS = 90;      // Applies once raw samples expire
+constexpr int DEFAULT_HISTORY_HOUR_DAYS = 0;         // Forever
+constexpr int MAX_HISTORY_TIER_DAYS = 3650;
+constexpr UINT MAX_HISTORY_SIZE_MB = 1024 * 1024;
+constexpr UINT DEFAULT_HISTORY_COALESCE_PERCENT = 5;
+constexpr UINT MAX_HISTORY_COALESCE_PERCENT = 50;
+constexpr int DEFAULT_BILLING_CYCLE_START_DAY = 1;
+constexpr UINT DEFAULT_LOG_MAX_SIZE_MB = 10;
+constexpr UINT MAX_LOG_MAX_SIZE_MB = 4096;
+constexpr UINT DEFAULT_LOG_MAX_AGE_DAYS = 7;
+constexpr UINT MAX_LOG_MAX_AGE_DAYS = 3650;
+constexpr UINT DEFAULT_LOG_KEEP_FILES = 5;
+constexpr UINT MAX_LOG_KEEP_FILES = 100;
+constexpr int MAX_BILLING_CYCLE_START_DAY = 31;
 
 // Message IDs
 #define WM_TRAYICON (WM_USER + 1)
 #define WM_UPDATE_STATS (WM_USER + 2)
+#define WM_CONFIG_FILE_CHANGED (WM_USER + 3)
 
 // Menu IDs
 #define IDM_SETTINGS 1001
@@ -149,6 +166,20 @@ struct NetworkStats
     }
 };
 
+// Bytes one interface transferred during a sampling interval
+struct InterfaceUsage
+{
+    std::wstring interfaceName;
+    unsigned long long bytesDown;
+    unsigned long long bytesUp;
+
+    InterfaceUsage()
+        : bytesDown(0)
+        , bytesUp(0)
+    {
+    }
+};
+
 // Application configuration
 struct AppConfig
 {
@@ -159,9 +190,18 @@ struct AppConfig
     bool showDownloadSpeed;          // Show download speed
     bool enableLogging;              // Enable history logging
     bool debugLogging;               // Enable debug logging to file
+    bool binaryDebugLog;             // Log as binary records (NetworkMonitor.binlog)
+    UINT logMaxSizeMB;               // Rotate the log past this size (0 = no limit)
+    UINT logMaxAgeDays;              // Rotate the log after this many days (0 = no limit)
+    UINT logKeepFiles;               // Compressed log archives kept
     bool darkTheme;
     ThemeMode themeMode;             // Theme selection mode
     int historyAutoTrimDays;
+    int historyRawDays;              // Per-sample history (0 = forever)
+    int historyMinuteDays;           // Per-minute history (0 = forever)
+    int historyHourDays;             // Per-hour history (0 = forever)
+    UINT historyMaxSizeMB;           // Database size cap (0 = none)
+    UINT historyCoalescePercent;     // Rate tolerance for merging steady samples (0 = off)
     AppLanguage language;            // UI language
     std::wstring selectedInterface;  // Selected interface name (empty = all)
     bool enableConnectionNotification; // Show notification on connect/disconnect
@@ -169,6 +209,9 @@ struct AppConfig
     UINT pingIntervalMs;             // Ping interval in milliseconds (default: 5000)
     UINT hotkeyModifier;             // Hotkey modifier (MOD_WIN | MOD_SHIFT, etc.)
     UINT hotkeyKey;                  // Hotkey virtual key code (default: 'N')
+    int billingCycleStartDay;        // Day of month a billing cycle starts (1-31)
+    // Bytes allowed per billing cycle, by interface name ("" = all interfaces)
+    std::map<std::wstring, unsigned long long> billingQuotas;
 
     AppConfig()
         : updateInterval(DEFAULT_UPDATE_INTERVAL)
@@ -178,9 +221,18 @@ struct AppConfig
         , showDownloadSpeed(true)
         , enableLogging(true)
         , debugLogging(false)
+        , binaryDebugLog(false)
+        , logMaxSizeMB(DEFAULT_LOG_MAX_SIZE_MB)
+        , logMaxAgeDays(DEFAULT_LOG_MAX_AGE_DAYS)
+        , logKeepFiles(DEFAULT_LOG_KEEP_FILES)
         , darkTheme(false)
         , themeMode(ThemeMode::SystemDefault)
         , historyAutoTrimDays(DEFAULT_HISTORY_AUTO_TRIM_DAYS)
+        , historyRawDays(DEFAULT_HISTORY_RAW_DAYS)
+        , historyMinuteDays(DEFAULT_HISTORY_MINUTE_DAYS)
+        , historyHourDays(DEFAULT_HISTORY_HOUR_DAYS)
+        , historyMaxSizeMB(0)
+        , historyCoalescePercent(DEFAULT_HISTORY_COALESCE_PERCENT)
         , language(AppLanguage::SystemDefault)
         , selectedInterface(L"")
         , enableConnectionNotification(true)
@@ -188,6 +240,7 @@ struct AppConfig
         , pingIntervalMs(5000)
         , hotkeyModifier(MOD_WIN | MOD_SHIFT)
         , hotkeyKey('N')
+        , billingCycleStartDay(DEFAULT_BILLING_CYCLE_START_DAY)
     {
     }
 };
@@ -0,0 +1,96 @@
+// ============================================================================
+// File: ConfigFile.h
+// Description: AppConfig stored in an INI-style settings file, with atomic
+//              saves and change notification
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#ifndef NETWORK_MONITOR_CONFIGFILE_H
+#define NETWORK_MONITOR_CONFIGFILE_H
+
+#include "NetworkMonitor/Common.h"
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace NetworkMonitor
+{
+
+// Settings file looked for next to the executable (portable mode)
+constexpr const wchar_t* CONFIG_FILE_NAME = L"NetworkMonitor.ini";
+
+/**
+ * The settings file is UTF-8 text in two sections, with the same value
+ * names the registry uses:
+ *
+ *     ; comment
+ *     [Settings]
+ *     UpdateInterval=2000
+ *     PingTarget=8.8.8.8
+ *     [BillingQuotas]
+ *     Ethernet=53687091200
+ *     *=107374182400          ; all interfaces
+ *
+ * Names and values are trimmed. Unknown names and sections are skipped so
+ * older builds can read newer files; values out of range are clamped the
+ * way the registry backend clamps them, and unreadable ones leave the field
+ * as it was. autoStart is not stored (it is the Windows Run key).
+ */
+
+// Applies every value in the text to config in one pass. Returns false if
+// any line could not be read; the lines that could are still applied.
+bool ParseConfigText(std::string_view text, AppConfig& config);
+
+std::string FormatConfigText(const AppConfig& config);
+
+// Defaults overlaid with the file, read through a memory mapping. False if
+// the file cannot be opened (config is then the defaults).
+bool LoadConfigFile(const std::wstring& path, AppConfig& config);
+
+// Writes "<path>.tmp", flushes it and renames it over path, so readers see
+// either the old file or the new one, never a partial write
+bool SaveConfigFile(const std::wstring& path, const AppConfig& config);
+
+/**
+ * Reports changes to one file: writes, and files created or renamed into
+ * its place (as SaveConfigFile does). Watches the directory with
+ * ReadDirectoryChangesW on Windows and inotify on Linux; no polling.
+ *
+ * Editors often write a file in several steps, so onChange runs on the
+ * watcher thread once no further change has come for CONFIG_CHANGE_SETTLE_MS.
+ */
+constexpr unsigned int CONFIG_CHANGE_SETTLE_MS = 50;
+
+class ConfigFileWatcher
+{
+public:
+    ConfigFileWatcher();
+    ~ConfigFileWatcher();   // Stops
+
+    ConfigFileWatcher(const ConfigFileWatcher&) = delete;
+    ConfigFileWatcher& operator=(const ConfigFileWatcher&) = delete;
+
+    // False if the directory cannot be watched on this system
+    bool Start(const std::wstring& path, std::function<void()> onChange);
+    void Stop();
+
+private:
+    void Run();
+
+    std::wstring m_directory;
+    std::wstring m_fileName;
+    std::function<void()> m_onChange;
+    std::thread m_thread;
+#ifdef _WIN32
+    HANDLE m_directoryHandle;
+    HANDLE m_stopEvent;
+#else
+    int m_notifyFd;
+    int m_wakeFds[2];       // Written to stop the thread
+#endif
+};
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_CONFIGFILE_H
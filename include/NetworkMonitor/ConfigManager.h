@@ -15,17 +15,24 @@ namespace NetworkMonitor {
 class ConfigManager {
 public:
   ConfigManager();
+
+  /**
+   * Store the configuration in a settings file (see ConfigFile.h) instead
+   * of the registry; auto-start stays in the Run key
+   * @param settingsFile Path of the settings file
+   */
+  explicit ConfigManager(const std::wstring &settingsFile);
   ~ConfigManager();
 
   /**
-   * Load configuration from registry
+   * Load configuration from registry or the settings file
    * @param config Output configuration
    * @return true if successful, false otherwise
    */
   bool LoadConfig(AppConfig &config);
 
   /**
-   * Save configuration to registry
+   * Save configuration to registry or the settings file
    * @param config Configuration to save
    * @return true if successful, false otherwise
    */
@@ -90,9 +97,27 @@ private:
   bool WriteString(HKEY hKey, const wchar_t *valueName,
                    const std::wstring &value);
 
+  /**
+   * Read per-interface billing quotas from their registry subkey
+   * @param quotas Output map of interface name to bytes per cycle
+   * @return true if the subkey exists and was read
+   */
+  bool ReadBillingQuotas(std::map<std::wstring, unsigned long long> &quotas);
+
+  /**
+   * Replace the stored billing quotas (one REG_QWORD per interface)
+   * @param quotas Interface name to bytes per cycle; zero entries are skipped
+   * @return true if successful, false otherwise
+   */
+  bool WriteBillingQuotas(const std::map<std::wstring, unsigned long long> &quotas);
+
 private:
+  std::wstring m_settingsFile; // Empty = registry
+
   // FIX: Thêm const vào đây
   static constexpr const wchar_t *REGISTRY_PATH = L"Software\\NetworkMonitor";
+  static constexpr const wchar_t *QUOTAS_PATH =
+      L"Software\\NetworkMonitor\\BillingQuotas";
   static constexpr const wchar_t *AUTOSTART_PATH =
       L"Software\\Microsoft\\Windows\\CurrentVersion\\Run";
 };
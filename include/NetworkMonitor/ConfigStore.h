@@ -0,0 +1,168 @@
+// ============================================================================
+// File: ConfigStore.h
+// Description: AppConfig published as immutable snapshots, with field-level
+//              change notification
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#ifndef NETWORK_MONITOR_CONFIGSTORE_H
+#define NETWORK_MONITOR_CONFIGSTORE_H
+
+#include "NetworkMonitor/Common.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace NetworkMonitor
+{
+
+// Every AppConfig member as X(Field, member), in declaration order. The
+// field enumeration and DiffConfig are generated from it, so a member
+// added to AppConfig must be added here too.
+#define NM_APP_CONFIG_FIELDS(X)                                   \
+    X(UpdateInterval, updateInterval)                             \
+    X(DisplayUnit, displayUnit)                                   \
+    X(AutoStart, autoStart)                                       \
+    X(ShowUploadSpeed, showUploadSpeed)                           \
+    X(ShowDownloadSpeed, showDownloadSpeed)                       \
+    X(EnableLogging, enableLogging)                               \
+    X(DebugLogging, debugLogging)                                 \
+    X(BinaryDebugLog, binaryDebugLog)                             \
+    X(LogMaxSizeMB, logMaxSizeMB)                                 \
+    X(LogMaxAgeDays, logMaxAgeDays)                               \
+    X(LogKeepFiles, logKeepFiles)                                 \
+    X(DarkTheme, darkTheme)                                       \
+    X(ThemeMode, themeMode)                                       \
+    X(HistoryAutoTrimDays, historyAutoTrimDays)                   \
+    X(HistoryRawDays, historyRawDays)                             \
+    X(HistoryMinuteDays, historyMinuteDays)                       \
+    X(HistoryHourDays, historyHourDays)                           \
+    X(HistoryMaxSizeMB, historyMaxSizeMB)                         \
+    X(HistoryCoalescePercent, historyCoalescePercent)             \
+    X(Language, language)                                         \
+    X(SelectedInterface, selectedInterface)                       \
+    X(EnableConnectionNotification, enableConnectionNotification) \
+    X(PingTarget, pingTarget)                                     \
+    X(PingIntervalMs, pingIntervalMs)                             \
+    X(HotkeyModifier, hotkeyModifier)                             \
+    X(HotkeyKey, hotkeyKey)                                       \
+    X(BillingCycleStartDay, billingCycleStartDay)                 \
+    X(BillingQuotas, billingQuotas)
+
+enum class ConfigField : unsigned int
+{
+#define NM_CONFIG_FIELD_ENUM(field, member) field,
+    NM_APP_CONFIG_FIELDS(NM_CONFIG_FIELD_ENUM)
+#undef NM_CONFIG_FIELD_ENUM
+    Count
+};
+
+static_assert(static_cast<unsigned int>(ConfigField::Count) < 64, "ConfigChanges holds 63 fields");
+
+// A set of ConfigFields: what a publish changed, or what a subscriber
+// wants to hear about
+class ConfigChanges
+{
+public:
+    constexpr ConfigChanges() : m_bits(0) {}
+    constexpr ConfigChanges(ConfigField field) : m_bits(Bit(field)) {}
+
+    static constexpr ConfigChanges All()
+    {
+        return ConfigChanges(Bit(ConfigField::Count) - 1);
+    }
+
+    constexpr bool Any() const { return m_bits != 0; }
+    constexpr bool Contains(ConfigField field) const { return (m_bits & Bit(field)) != 0; }
+    constexpr bool Intersects(ConfigChanges other) const { return (m_bits & other.m_bits) != 0; }
+
+    constexpr ConfigChanges operator|(ConfigChanges other) const { return ConfigChanges(m_bits | other.m_bits); }
+    ConfigChanges& operator|=(ConfigChanges other)
+    {
+        m_bits |= other.m_bits;
+        return *this;
+    }
+    constexpr bool operator==(ConfigChanges other) const { return m_bits == other.m_bits; }
+    constexpr bool operator!=(ConfigChanges other) const { return m_bits != other.m_bits; }
+
+private:
+    explicit constexpr ConfigChanges(uint64_t bits) : m_bits(bits) {}
+    static constexpr uint64_t Bit(ConfigField field) { return 1ULL << static_cast<unsigned int>(field); }
+
+    uint64_t m_bits;
+};
+
+constexpr ConfigChanges operator|(ConfigField a, ConfigField b)
+{
+    return ConfigChanges(a) | ConfigChanges(b);
+}
+
+// The fields that differ between two configurations
+ConfigChanges DiffConfig(const AppConfig& before, const AppConfig& after);
+
+// Name of a field ("UpdateInterval"), for logging
+const wchar_t* GetConfigFieldName(ConfigField field);
+
+using ConfigSnapshot = std::shared_ptr<const AppConfig>;
+
+/**
+ * The current configuration, shared by every thread.
+ *
+ * Each publish creates a new immutable snapshot and swaps it in, so a
+ * reader never sees a half-updated AppConfig. The store owns only the
+ * current snapshot; an older one is freed when its last Snapshot() owner
+ * lets go.
+ *
+ * Publish from one thread (the UI thread). Current() is for that thread:
+ * no lock and no reference count, and the reference stays valid until its
+ * next Publish. Other threads, and code that holds a config across
+ * something that may publish (a modal dialog's message loop), take a
+ * Snapshot() instead.
+ *
+ * Subscribers run on the publishing thread, synchronously, after the new
+ * snapshot is current; each is told only of changes to the fields it
+ * asked for.
+ */
+class ConfigStore
+{
+public:
+    using Subscriber = std::function<void(const AppConfig& before, const AppConfig& after, ConfigChanges changes)>;
+
+    ConfigStore();   // Holds the defaults until the first publish
+
+    ConfigStore(const ConfigStore&) = delete;
+    ConfigStore& operator=(const ConfigStore&) = delete;
+
+    const AppConfig& Current() const { return *m_current; }
+    ConfigSnapshot Snapshot() const { return std::atomic_load(&m_current); }
+
+    // Makes config current and notifies subscribers of what changed.
+    // Returns the changes; publishing an equal config does nothing.
+    ConfigChanges Publish(const AppConfig& config);
+
+    // Returns an ID for Unsubscribe
+    unsigned int Subscribe(ConfigChanges fields, Subscriber subscriber);
+    void Unsubscribe(unsigned int id);
+
+private:
+    struct Subscription
+    {
+        unsigned int id;
+        ConfigChanges fields;
+        std::shared_ptr<Subscriber> subscriber;
+    };
+
+    // Replaced with std::atomic_store, read with std::atomic_load from
+    // other threads
+    ConfigSnapshot m_current;
+
+    mutable std::mutex m_mutex;
+    std::vector<Subscription> m_subscriptions;
+    unsigned int m_nextSubscriptionId;
+};
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_CONFIGSTORE_H
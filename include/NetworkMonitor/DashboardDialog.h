@@ -9,6 +9,7 @@
 
 #include "NetworkMonitor/Common.h"
 #include "NetworkMonitor/HistoryLogger.h"
+#include <future>
 #include <vector>
 
 namespace NetworkMonitor
@@ -32,7 +33,13 @@ private:
     INT_PTR CALLBACK InstanceDialogProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam);
 
     // Dialog helper methods
+    // Queue the dashboard queries; each result arrives as a
+    // WM_DASHBOARD_QUERY_DONE message and is applied by OnQueryDone, so the
+    // UI thread never waits on SQLite.
     void UpdateDashboardData(HWND hDlg);
+    void OnQueryDone(HWND hDlg, WPARAM query);
+    void ShowRecentSamples(HWND hDlg);
+    void ShowBillingCycle(HWND hDlg, const AsyncQueryResult<BillingStatus>& result);
     void DrawDashboardChart(HDC hdc, const RECT& rc);
     void CenterDialogOnScreen(HWND hDlg);
 
@@ -43,6 +50,19 @@ private:
     HWND m_hDialog;
     NetworkMonitorClass* m_pNetworkMonitor;
     const AppConfig* m_pConfig;
+
+    // One slot per view: a refresh supersedes the previous one's queries
+    QuerySlot m_todaySlot;
+    QuerySlot m_monthSlot;
+    QuerySlot m_cycleSlot;
+    QuerySlot m_recentSlot;
+    std::future<AsyncQueryResult<UsageTotals>> m_todayQuery;
+    std::future<AsyncQueryResult<UsageTotals>> m_monthQuery;
+    std::future<AsyncQueryResult<BillingStatus>> m_cycleQuery;
+    std::future<AsyncQueryResult<std::vector<HistorySample>>> m_recentQuery;
+    unsigned long long m_cycleQuota;
+
+    // Latest recent samples, shared by the list and the chart
     std::vector<NetworkMonitor::HistorySample> m_chartSamples;
 };
 
@@ -0,0 +1,161 @@
+// ============================================================================
+// File: DiagnosticLog.h
+// Description: Asynchronous diagnostic log fed through a lock-free ring
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#ifndef NETWORK_MONITOR_DIAGNOSTICLOG_H
+#define NETWORK_MONITOR_DIAGNOSTICLOG_H
+
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/LogRotation.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace NetworkMonitor
+{
+
+enum class LogLevel
+{
+    Debug,
+    Error
+};
+
+// Pieces of a log file line, shared with the binary log decoder so both
+// produce the same bytes: "YYYY-MM-DD HH:MM:SS [LEVEL] text\r\n"
+const char* GetLogLevelName(LogLevel level);
+
+// "YYYY-MM-DD HH:MM:SS " in local time; fileTime is in FILETIME ticks (UTC)
+std::string FormatLogTimestamp(unsigned long long fileTime);
+
+void AppendLogTextUtf8(std::string& out, const std::wstring& text);
+
+// FILETIME ticks (UTC) now
+inline unsigned long long CurrentLogTime()
+{
+    FILETIME now = {};
+    GetSystemTimeAsFileTime(&now);
+    return (static_cast<unsigned long long>(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+}
+
+// Text of the line that reports records lost to a full buffer
+std::wstring FormatDroppedRecordsNotice(unsigned long long dropped);
+
+struct DiagnosticLogOptions
+{
+    std::wstring path;              // Log file, appended to (UTF-8)
+    unsigned int capacity;          // Ring slots, rounded up to a power of two
+    unsigned int flushIntervalMs;   // Longest a record waits before it is written
+    LogRotationOptions rotation;
+
+    DiagnosticLogOptions()
+        : capacity(4096)
+        , flushIntervalMs(1000)
+    {
+    }
+};
+
+struct DiagnosticLogStats
+{
+    unsigned long long written;     // Records written to the file
+    unsigned long long dropped;     // Records refused because the ring was full
+    unsigned long long writes;      // WriteFile batches
+    unsigned long long rotations;   // Files moved aside
+
+    DiagnosticLogStats()
+        : written(0)
+        , dropped(0)
+        , writes(0)
+        , rotations(0)
+    {
+    }
+};
+
+/**
+ * Log file writer that keeps I/O off the calling threads.
+ *
+ * Push stamps the record with the current time and hands it to a bounded
+ * multi-producer ring with one compare-and-swap; it never takes a lock or
+ * makes a system call for debug records. A background thread keeps the
+ * file open, formats the records and writes them in batches: when
+ * flushIntervalMs has passed, as soon as an error-level record arrives, when
+ * the ring is half full, on Flush and on destruction.
+ *
+ * When the ring is full the record is dropped and counted; the next batch
+ * carries a line saying how many were lost.
+ *
+ * The file is rotated by the writer thread between lines (see
+ * RotatingLogFile), so a rotation never splits or repeats a line.
+ */
+class DiagnosticLog
+{
+public:
+    explicit DiagnosticLog(const DiagnosticLogOptions& options);
+    ~DiagnosticLog();   // Writes everything pushed so far
+
+    DiagnosticLog(const DiagnosticLog&) = delete;
+    DiagnosticLog& operator=(const DiagnosticLog&) = delete;
+
+    // Queue one line; false if it was dropped
+    bool Push(LogLevel level, std::wstring message);
+
+    // Block until every record pushed before the call is written
+    void Flush();
+
+    // Takes effect from the next batch
+    void SetRotation(const LogRotationOptions& rotation);
+
+    DiagnosticLogStats GetStats() const;
+
+private:
+    struct Slot
+    {
+        std::atomic<unsigned long long> sequence;
+        LogLevel level;
+        unsigned long long time;    // FILETIME ticks, UTC
+        std::wstring message;
+    };
+
+    void WriterThreadMain();
+    size_t Drain(std::string& out, bool& sawError);
+    bool WriteOut(std::string& buffer);
+    void Wake();
+
+    unsigned long long m_mask;
+    unsigned int m_flushIntervalMs;
+    std::unique_ptr<Slot[]> m_slots;
+
+    // Producers claim slots at m_enqueuePos; only the writer thread reads
+    // (and stores m_dequeuePos, which producers check for a filling ring).
+    // Kept on separate cache lines.
+    alignas(64) std::atomic<unsigned long long> m_enqueuePos;
+    alignas(64) std::atomic<unsigned long long> m_dequeuePos;
+    alignas(64) std::atomic<unsigned long long> m_dropped;
+    unsigned long long m_reportedDrops;     // Writer thread only
+    std::atomic<bool> m_wakePending;        // A producer already woke the writer
+
+    RotatingLogFile m_file;                 // Writer thread only
+    unsigned long long m_lastStampSecond;   // Second of the cached prefix
+    std::string m_stampPrefix;              // "YYYY-MM-DD HH:MM:SS "
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;         // Writer: work or stop
+    std::condition_variable m_progress;     // Flush waiters
+    bool m_wakeRequested;                   // Guarded by m_mutex
+    bool m_stop;                            // Guarded by m_mutex
+    LogRotationOptions m_rotation;          // Guarded by m_mutex
+    bool m_rotationChanged;                 // Guarded by m_mutex
+    unsigned long long m_flushTarget;       // Guarded by m_mutex
+    unsigned long long m_writtenPos;        // Guarded by m_mutex
+    DiagnosticLogStats m_stats;             // Guarded by m_mutex
+
+    std::thread m_writer;
+};
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_DIAGNOSTICLOG_H
@@ -8,6 +8,8 @@
 #define NETWORK_MONITOR_HISTORY_DIALOG_H
 
 #include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/AsyncQuery.h"
+#include <future>
 
 namespace NetworkMonitor
 {
@@ -28,11 +30,18 @@ private:
 
     // Dialog helper methods
     void UpdateHistoryInfo(HWND hDlg);
+    // Starts the export on a query thread; OnExportDone reports the result
+    void ExportHistoryToFile(HWND hDlg);
+    void OnExportDone(HWND hDlg);
     void CenterDialogOnScreen(HWND hDlg);
 
     // Member variables
     HWND m_hDialog;
     const AppConfig* m_pConfig;
+
+    // Closing the dialog cancels a running export
+    QuerySlot m_exportSlot;
+    std::future<AsyncQueryResult<unsigned long long>> m_exportQuery;
 };
 
 } // namespace NetworkMonitor
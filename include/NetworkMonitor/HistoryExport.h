@@ -0,0 +1,115 @@
+// ============================================================================
+// File: HistoryExport.h
+// Description: Streaming export/import of usage history to flat files
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#ifndef NETWORK_MONITOR_HISTORYEXPORT_H
+#define NETWORK_MONITOR_HISTORYEXPORT_H
+
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/HistoryLogger.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+
+namespace NetworkMonitor
+{
+
+// Supported on-disk formats for history export
+enum class HistoryExportFormat
+{
+    Csv,        // timestamp,interface,bytes_down,bytes_up (UTF-8, RFC 4180 quoting)
+    JsonLines,  // One JSON object per line (NDJSON)
+    Columnar    // Blocked little-endian column arrays with an interface dictionary
+};
+
+/**
+ * Parse a format name ("csv", "ndjson"/"jsonl", "columnar"/"nmhx")
+ * @param name Format name (case-insensitive)
+ * @param format Output format
+ * @return true if the name is recognized
+ */
+bool ParseHistoryExportFormat(const std::wstring& name, HistoryExportFormat& format);
+
+/**
+ * Default file extension for a format, without the leading dot
+ */
+const wchar_t* HistoryExportExtension(HistoryExportFormat format);
+
+/**
+ * Writes samples to a file in one of the export formats.
+ *
+ * Output goes through a single large buffer that is flushed with WriteFile
+ * when full; numbers are rendered with std::to_chars so the output does not
+ * depend on the C locale. Interface names are converted to UTF-8 once per
+ * distinct name, so steady-state rows do not allocate.
+ */
+class HistoryExportWriter
+{
+public:
+    HistoryExportWriter();
+    ~HistoryExportWriter();
+
+    HistoryExportWriter(const HistoryExportWriter&) = delete;
+    HistoryExportWriter& operator=(const HistoryExportWriter&) = delete;
+
+    bool Open(const std::wstring& path, HistoryExportFormat format);
+    bool Write(const HistorySampleView& row);
+    bool Close();
+
+    unsigned long long GetRowCount() const { return m_rowCount; }
+
+private:
+    struct InterfaceEntry
+    {
+        std::wstring name;
+        std::string utf8;   // Raw UTF-8 (columnar dictionary)
+        std::string csv;    // UTF-8, quoted/escaped for CSV when needed
+        std::string json;   // UTF-8, JSON string literal including quotes
+    };
+
+    bool WriteCsv(const HistorySampleView& row, const InterfaceEntry& iface);
+    bool WriteJsonLine(const HistorySampleView& row, const InterfaceEntry& iface);
+    bool WriteColumnar(const HistorySampleView& row, unsigned int ifaceId);
+    bool FlushColumnarBlock();
+
+    size_t InternInterface(std::wstring_view name);
+    bool Append(const char* data, size_t length);
+    bool FlushBuffer();
+
+    HANDLE m_file;
+    HistoryExportFormat m_format;
+    std::unique_ptr<char[]> m_buffer;
+    size_t m_bufferUsed;
+    unsigned long long m_rowCount;
+    bool m_failed;
+
+    std::vector<InterfaceEntry> m_interfaces;
+    size_t m_lastInterface;
+    size_t m_dictionaryWritten;
+
+    // Columnar block staging (fixed size, allocated once)
+    std::unique_ptr<long long[]> m_blockTimestamps;
+    std::unique_ptr<unsigned int[]> m_blockInterfaces;
+    std::unique_ptr<unsigned long long[]> m_blockDown;
+    std::unique_ptr<unsigned long long[]> m_blockUp;
+    unsigned int m_blockRows;
+};
+
+/**
+ * Stream rows back out of an exported file. The view passed to the visitor
+ * is only valid during the call; id carries the 1-based row ordinal.
+ * @param path File written by HistoryExportWriter (or compatible CSV)
+ * @param format Format of the file
+ * @param visitor Called once per row; return false to stop
+ * @return true if the whole file parsed (or the visitor stopped early)
+ */
+bool ReadHistoryExport(const std::wstring& path,
+                       HistoryExportFormat format,
+                       const HistorySampleVisitor& visitor);
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_HISTORYEXPORT_H
@@ -8,38 +8,386 @@
 #define NETWORK_MONITOR_HISTORYLOGGER_H
 
 #include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/SampleJournal.h"
+#include "NetworkMonitor/BillingCycle.h"
+#include "NetworkMonitor/HistoryRetention.h"
+#include "NetworkMonitor/AsyncQuery.h"
 #include <string>
+#include <string_view>
 #include <vector>
+#include <functional>
+#include <atomic>
+#include <chrono>
 #include <ctime>
+#include <deque>
+#include <future>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 struct sqlite3;
+struct sqlite3_stmt;
 
 namespace NetworkMonitor
 {
 
+enum class HistoryExportFormat;
+struct RateQuery;
+struct InterfaceRateStatistics;
+struct TopKQuery;
+struct RankedInterval;
+struct RankedInterface;
+struct CalendarTotal;
+enum class CalendarUnit;
+
 struct HistorySample
 {
     std::time_t timestamp;           // UTC timestamp (seconds since epoch)
-    std::wstring interfaceName;      // Interface name or "All Interfaces"
+    std::wstring interfaceName;      // Interface name ("All Interfaces" in older rows)
     unsigned long long bytesDown;    // Bytes downloaded in interval
     unsigned long long bytesUp;      // Bytes uploaded in interval
 };
 
+// Keyset position of a row in (timestamp, id) order. Pass the last key seen
+// back as HistoryQuery::after to resume a scan without OFFSET.
+struct HistoryCursor
+{
+    std::time_t timestamp;
+    long long id;
+
+    HistoryCursor()
+        : timestamp(0)
+        , id(0)
+    {
+    }
+};
+
+// Row handed to a streaming visitor. interfaceName points into SQLite's
+// column buffer and is only valid for the duration of the visitor call;
+// copy it if it must outlive the callback.
+//
+// A span row stands for `samples` samples of steady traffic taken from
+// timestamp to timestamp + spanSeconds (see HistoryCoalescingOptions), with
+// bytesDown/bytesUp their sum. A plain row has spanSeconds 0 and samples 1
+// (0 is read as 1).
+struct HistorySampleView
+{
+    long long id;
+    std::time_t timestamp;
+    std::wstring_view interfaceName;
+    unsigned long long bytesDown;
+    unsigned long long bytesUp;
+    long long spanSeconds;
+    long long samples;
+};
+
+// Filter and ordering for streaming scans over the usage table.
+struct HistoryQuery
+{
+    std::time_t from;                      // Inclusive lower bound (0 = unbounded)
+    std::time_t to;                        // Exclusive upper bound (0 = unbounded)
+    const std::wstring* interfaceFilter;   // Optional exact interface match
+    bool descending;                       // Newest first when true
+    int limit;                             // Maximum rows (0 = no limit)
+    const HistoryCursor* after;            // Resume strictly after this key
+
+    HistoryQuery()
+        : from(0)
+        , to(0)
+        , interfaceFilter(nullptr)
+        , descending(false)
+        , limit(0)
+        , after(nullptr)
+    {
+    }
+};
+
+// Return false from the visitor to stop the scan early.
+using HistorySampleVisitor = std::function<bool(const HistorySampleView&)>;
+
+// Feeds rows to a bulk import by calling the sink once per row; returns
+// false on a read error or when the sink returns false.
+using HistorySampleProducer = std::function<bool(const HistorySampleVisitor& sink)>;
+
+/**
+ * Run-length coalescing of steady traffic. When an interface's next sample
+ * arrives on its usual interval with per-second rates (each direction)
+ * within rateTolerance of the average of the run so far, or within
+ * rateSlackBytesPerSecond of it, the sample extends the run's span row
+ * instead of adding a row. Spans never cross a minute boundary, so the
+ * per-minute rollup and everything read from it are unaffected.
+ *
+ * Byte totals are always exact. Queries that bucket raw rows spread a span
+ * evenly over its samples; GetRecentSamples and ExportHistory return the
+ * samples one by one in the same way. rateTolerance 0 turns coalescing off
+ * (the default).
+ */
+struct HistoryCoalescingOptions
+{
+    double rateTolerance;                        // 0.05 = within 5%
+    unsigned long long rateSlackBytesPerSecond;  // Keep-alive trickles count as steady
+
+    HistoryCoalescingOptions()
+        : rateTolerance(0.0)
+        , rateSlackBytesPerSecond(64)
+    {
+    }
+};
+
+// Longest gap between the first two samples of a span; later samples must
+// follow on the interval those two set
+constexpr long long HISTORY_COALESCE_MAX_GAP_SECONDS = 10;
+
+// Tuning and reporting for HistoryLogger::ImportSamples.
+struct HistoryImportOptions
+{
+    unsigned long long rowsPerTransaction;   // Commit interval
+    // Drop the usage indexes for the load and recreate them afterwards.
+    // Helps when rows arrive out of timestamp order; for time-ordered input
+    // index appends are cheap and the rebuild's sort costs more.
+    bool rebuildIndexes;
+    unsigned long long progressInterval;     // Rows between progress callbacks (0 = end only)
+    // Merge steady runs of the imported samples into span rows, as the
+    // live write path does (off by default: rows are stored as given)
+    HistoryCoalescingOptions coalescing;
+
+    // Called on the writer thread with the rows imported so far; return
+    // false to stop. Rows already added are kept.
+    std::function<bool(unsigned long long rowsImported)> progress;
+
+    HistoryImportOptions()
+        : rowsPerTransaction(1000000ULL)
+        , rebuildIndexes(false)
+        , progressInterval(100000ULL)
+    {
+    }
+};
+
+// Time budget of one idle-maintenance slice. Retention and vacuum chunks
+// are sized to the time left and interrupted shortly past the deadline, so
+// a sample arriving while a slice runs waits at most about this long, plus
+// any wait on the disk (a checkpoint's fsync).
+constexpr unsigned int HISTORY_MAINTENANCE_SLICE_MS = 4;
+
+// Counters for HistoryLogger's idle-time maintenance since startup.
+struct HistoryMaintenanceStats
+{
+    bool incrementalVacuum;                     // auto_vacuum=INCREMENTAL in effect
+    unsigned long long slices;                  // Slices run
+    unsigned long long pagesReclaimed;          // Free pages given back to the file system
+    unsigned long long freePages;               // Free pages left after the last slice
+    unsigned long long checkpoints;             // Passive WAL checkpoints
+    unsigned long long framesCheckpointed;      // WAL frames copied into the database
+    unsigned long long optimizeRuns;            // PRAGMA optimize runs that completed
+    unsigned long long vacuumMicroseconds;
+    unsigned long long checkpointMicroseconds;
+    unsigned long long optimizeMicroseconds;
+    unsigned long long conversionMicroseconds;  // One-off VACUUM switching an old file to incremental
+    unsigned long long rawRowsExpired;          // Raw samples deleted by the retention policy
+    unsigned long long minuteRowsFolded;        // usage_minute rows folded into usage_hour
+    unsigned long long hourRowsExpired;         // usage_hour rows deleted
+    unsigned long long retentionMicroseconds;
+    unsigned long long lastSliceMicroseconds;
+    unsigned long long longestSliceMicroseconds;
+
+    HistoryMaintenanceStats()
+        : incrementalVacuum(false)
+        , slices(0)
+        , pagesReclaimed(0)
+        , freePages(0)
+        , checkpoints(0)
+        , framesCheckpointed(0)
+        , optimizeRuns(0)
+        , vacuumMicroseconds(0)
+        , checkpointMicroseconds(0)
+        , optimizeMicroseconds(0)
+        , conversionMicroseconds(0)
+        , rawRowsExpired(0)
+        , minuteRowsFolded(0)
+        , hourRowsExpired(0)
+        , retentionMicroseconds(0)
+        , lastSliceMicroseconds(0)
+        , longestSliceMicroseconds(0)
+    {
+    }
+};
+
+// Pacing and progress for HistoryLogger::BackupTo.
+struct HistoryBackupOptions
+{
+    // Pages copied per sqlite3_backup_step (<= 0: everything in one step).
+    // A step is the unit of work between pauses and cancellation checks.
+    int pagesPerStep;
+    // Sleep between steps, leaving the disk to the live writer
+    unsigned int pauseMs;
+    // Called after each step with pages copied so far and the total;
+    // return false to stop (the partial copy is deleted)
+    std::function<bool(unsigned long long pagesCopied, unsigned long long pagesTotal)> progress;
+
+    HistoryBackupOptions()
+        : pagesPerStep(256)
+        , pauseMs(2)
+    {
+    }
+};
+
+struct HistoryBackupStats
+{
+    unsigned long long pagesCopied;
+    unsigned long long pagesTotal;
+    unsigned long long steps;
+    unsigned long long elapsedMicroseconds;
+    unsigned long long longestStepMicroseconds;
+
+    HistoryBackupStats()
+        : pagesCopied(0)
+        , pagesTotal(0)
+        , steps(0)
+        , elapsedMicroseconds(0)
+        , longestStepMicroseconds(0)
+    {
+    }
+};
+
+// Where a HistorySnapshot reads from
+enum class HistorySnapshotMode
+{
+    // A read transaction held on the live database. Opens instantly and the
+    // writer carries on, but the WAL cannot be checkpointed past the
+    // snapshot (and idle maintenance waits) until it closes.
+    ReadTransaction,
+    // A private copy made with BackupTo into the temp folder. Costs a full
+    // copy up front, then leaves the live database alone however long the
+    // analysis runs. The copy is deleted when the snapshot closes.
+    PrivateCopy
+};
+
+class HistoryLogger;
+
+/**
+ * Point-in-time view of the history for a run of heavy queries. While it
+ * is open, every HistoryLogger query made on the thread that opened it
+ * (totals, statistics, scans, exports, backups) reads the database as it
+ * was when the snapshot was taken; samples committed since are invisible
+ * to them. Other threads, async queries included, are unaffected.
+ *
+ * Destroy it on the thread that opened it; snapshots on one thread nest
+ * and must close in reverse order.
+ */
+class HistorySnapshot
+{
+public:
+    ~HistorySnapshot();
+
+    HistorySnapshot(const HistorySnapshot&) = delete;
+    HistorySnapshot& operator=(const HistorySnapshot&) = delete;
+
+    HistorySnapshotMode Mode() const { return m_copyPath.empty() ? HistorySnapshotMode::ReadTransaction
+                                                                 : HistorySnapshotMode::PrivateCopy; }
+
+private:
+    friend class HistoryLogger;
+
+    HistorySnapshot(HistoryLogger& owner, sqlite3* db, const std::wstring& copyPath);
+
+    HistoryLogger& m_owner;
+    sqlite3* m_db;
+    std::wstring m_copyPath;             // Empty for a pooled read transaction
+    const HistoryLogger* m_previousOwner;
+    sqlite3* m_previousDb;
+};
+
+/**
+ * Usage history store. Safe to call from any thread.
+ *
+ * A single writer connection is owned by a background thread that applies
+ * queued appends in batched transactions. Queries run on read-only WAL
+ * connections leased from a small pool, so long reads do not block inserts.
+ * A query issued after AppendSample on the same thread waits until that
+ * thread's queued samples are committed (read-your-writes).
+ *
+ * Queued samples are also written to a memory-mapped SampleJournal next to
+ * the database before AppendSample returns; anything not yet committed when
+ * the process dies is replayed on the next start.
+ *
+ * Every query also has an ...Async variant for UI threads. It copies its
+ * arguments, queues the query for a small pool of query threads and returns
+ * a future at once; the caller only takes a lock to enqueue. Read-your-
+ * writes still holds: the query waits for samples the caller queued before
+ * submitting it.
+ *
+ * When no sample has been written and no query has run for a short while,
+ * the writer thread spends its idle time on maintenance in slices of
+ * HISTORY_MAINTENANCE_SLICE_MS: passive WAL checkpoints (taken off the
+ * commit path; a commit only checkpoints if the WAL outgrows the usual
+ * automatic threshold), incremental_vacuum to hand pages freed by
+ * DeleteAll/TrimToRecentDays back to the file system, and a bounded
+ * PRAGMA optimize to keep planner statistics fresh.
+ *
+ * History is kept in three tiers: raw samples (usage), per-minute sums
+ * (usage_minute, updated with every insert) and per-hour sums (usage_hour).
+ * Under a HistoryRetentionPolicy the same idle slices age data out in small
+ * transactions: old raw rows are deleted, old minutes are folded into hours
+ * and old hours deleted. Totals, statistics, top-K, calendar and billing
+ * queries read each part of their range from the finest tier that still
+ * holds it; per-sample queries and exports return raw rows only.
+ *
+ * BackupTo copies the live database with the SQLite online backup API
+ * from one read transaction, a few pages at a time with pauses in between,
+ * so the writer keeps committing while a consistent copy is made.
+ * OpenSnapshot pins a point-in-time view for long analytical reads.
+ */
 class HistoryLogger
 {
 public:
     static HistoryLogger& Instance();
 
+    /**
+     * Override the folder holding network_usage.db and its journal.
+     * Must be called before the first use of Instance(); the default is the
+     * executable's folder.
+     */
+    static void SetStorageDirectory(const std::wstring& directory);
+
+    /**
+     * Open network_usage.db read-only, for a second process next to the
+     * tray instance (command-line export and backup). Schema upgrades, the
+     * rollup backfill, the sample journal and the writer thread are all
+     * left to the process that owns the database; every write fails.
+     * Must be called before the first use of Instance().
+     */
+    static void SetReadOnly(bool readOnly);
+
+    /**
+     * Stop the writer and query threads and close the database, committing
+     * what is queued. Call at exit while the diagnostic log is still up, so
+     * no thread of this logger outlives it; every later call fails as if
+     * SQLite were unavailable.
+     */
+    void Shutdown();
+
     /**
      * Append a usage sample (delta bytes for the interval).
-     * If SQLite is not available, the call is a no-op.
+     * The insert is queued for the writer thread; the call does not block
+     * on disk I/O. If SQLite is not available, the call is a no-op.
      */
     void AppendSample(const std::wstring& interfaceName,
                       unsigned long long bytesDown,
                       unsigned long long bytesUp);
 
+    /**
+     * Append the usage of several interfaces over the same interval, e.g.
+     * every interface in one timer tick. The rows share a timestamp, are
+     * journaled and queued under one lock with a single journal write-back
+     * and writer wake-up, and are committed together in one transaction
+     * through multi-row INSERTs. Entries without traffic are skipped.
+     */
+    void AppendSamples(const std::vector<InterfaceUsage>& usage);
+
     // Dashboard queries
     // If interfaceFilter is non-null and non-empty, filter by that interface name.
+    // Day and month bounds come from the shared LocalCalendar.
     bool GetTotalsToday(unsigned long long& totalDown, unsigned long long& totalUp,
                         const std::wstring* interfaceFilter = nullptr);
 
@@ -51,10 +399,322 @@ public:
                           const std::wstring* interfaceFilter = nullptr,
                           bool onlyToday = false);
 
+    /**
+     * Stream rows matching the query straight from sqlite3_step without
+     * materializing them. Memory use is independent of the result size.
+     * @param query Range, filter, ordering and resume position
+     * @param visitor Called once per row; return false to stop
+     * @param lastOut Optional; receives the key of the last visited row
+     * @return true if the scan completed or was stopped by the visitor
+     */
+    bool ForEachSample(const HistoryQuery& query,
+                       const HistorySampleVisitor& visitor,
+                       HistoryCursor* lastOut = nullptr);
+
+    /**
+     * Stream rows in [from, to) into a file, oldest first.
+     * @param path Destination file (overwritten)
+     * @param format Output format
+     * @param from Inclusive lower bound (0 = unbounded)
+     * @param to Exclusive upper bound (0 = unbounded)
+     * @param interfaceFilter Optional exact interface match
+     * @param rowsOut Optional; receives the number of rows written
+     * @return true if every row was written and the file closed cleanly
+     */
+    bool ExportHistory(const std::wstring& path,
+                       HistoryExportFormat format,
+                       std::time_t from = 0,
+                       std::time_t to = 0,
+                       const std::wstring* interfaceFilter = nullptr,
+                       unsigned long long* rowsOut = nullptr);
+
+    /**
+     * Bulk-insert rows with explicit timestamps (backfill, imports from other
+     * tools, synthetic data). Runs on the writer connection using large
+     * transactions and multi-row INSERT statements; queued appends wait until
+     * it finishes. Row ids in the input are ignored.
+     * @param producer Source of rows
+     * @param options Transaction size, index rebuild and progress reporting
+     * @param rowsOut Optional; receives the number of rows inserted
+     * @return true if the producer finished and every row was committed
+     */
+    bool ImportSamples(const HistorySampleProducer& producer,
+                       const HistoryImportOptions& options = HistoryImportOptions(),
+                       unsigned long long* rowsOut = nullptr);
+
+    /**
+     * Import a file written by ExportHistory (or any CSV/NDJSON file in the
+     * same layout).
+     */
+    bool ImportHistory(const std::wstring& path,
+                       HistoryExportFormat format,
+                       const HistoryImportOptions& options = HistoryImportOptions(),
+                       unsigned long long* rowsOut = nullptr);
+
+    /**
+     * Copy the database to path while the app keeps running. The copy is
+     * the database as of the start of the call (later commits are not
+     * included and do not restart it), written to path + ".partial" and
+     * renamed into place once complete, as a single file in rollback-journal
+     * mode that opens anywhere. The copy is synced once at the end, and the
+     * WAL the read transaction held back is checkpointed on the caller's
+     * thread rather than in the writer's next commit.
+     * @param options Step size, pause between steps and progress callback
+     * @param statsOut Optional; pages copied and time spent
+     * @return true if the copy completed
+     */
+    bool BackupTo(const std::wstring& path,
+                  const HistoryBackupOptions& options = HistoryBackupOptions(),
+                  HistoryBackupStats* statsOut = nullptr);
+
+    /**
+     * Pin a point-in-time view for this thread's queries (see
+     * HistorySnapshot). Includes samples this thread queued before the
+     * call. Returns null if the database is unavailable or the copy failed.
+     */
+    std::unique_ptr<HistorySnapshot> OpenSnapshot(
+        HistorySnapshotMode mode = HistorySnapshotMode::ReadTransaction);
+
+    /**
+     * Per-interface rate distribution over a billing period: traffic summed
+     * into query.bucketSeconds buckets, then 95th/99th percentile, max and
+     * a histogram of the bucket rates. Periods aligned to whole minutes are
+     * answered from the per-minute rollup; unaligned edges read raw rows.
+     * @param query Period, bucket length, optional interface and bin count
+     * @param out One entry per interface with traffic (or the filtered one),
+     *            sorted by name
+     * @return true if the period was valid (at most 2^20 buckets) and the
+     *         scan succeeded
+     */
+    bool GetRateStatistics(const RateQuery& query, std::vector<InterfaceRateStatistics>& out);
+
+    /**
+     * The K busiest intervals of query.bucketSeconds in [from, to), busiest
+     * first (ties: earliest first). One streaming pass in time order feeds a
+     * bounded heap, so memory stays O(K) whatever the range.
+     */
+    bool GetTopIntervals(const TopKQuery& query, std::vector<RankedInterval>& out);
+
+    // The K interfaces with the most traffic in [from, to), busiest first
+    bool GetTopInterfaces(const TopKQuery& query, std::vector<RankedInterface>& out);
+
+    /**
+     * Traffic per local day or month in [from, to), oldest first; periods
+     * without traffic are omitted. Rows are bucketed with the shared
+     * LocalCalendar (one table lookup each, no CRT time conversion), so DST
+     * days are 23 or 25 hours long. Minute-aligned ranges read the rollup.
+     * @param to Exclusive end (0 = now)
+     * @return false on an invalid range, one wider than the calendar allows,
+     *         or a query error
+     */
+    bool GetCalendarTotals(CalendarUnit unit,
+                           std::time_t from,
+                           std::time_t to,
+                           const std::wstring* interfaceFilter,
+                           std::vector<CalendarTotal>& out);
+
+    /**
+     * Set the day of month billing cycles start on (1-31; see
+     * GetBillingPeriod). Current-cycle totals are kept per interface as
+     * samples are committed; changing the day rebuilds them once from the
+     * per-minute rollup. The day is stored with the totals.
+     */
+    bool SetBillingCycleStartDay(int day);
+    int GetBillingCycleStartDay() const;
+
+    /**
+     * Usage in the current billing cycle and when quotaBytes will run out.
+     * Totals are a keyed lookup of the incrementally maintained per-cycle
+     * row; the time-of-day weighted projection uses the hour-of-day average
+     * of the last week's traffic.
+     * @param interfaceFilter Optional exact interface match (null = all)
+     * @param quotaBytes Cycle allowance for download + upload (0 = none)
+     */
+    bool GetBillingStatus(const std::wstring* interfaceFilter,
+                          unsigned long long quotaBytes,
+                          BillingStatus& out);
+
+    // DeleteAll also clears billing-cycle totals. TrimToRecentDays keeps
+    // them: they record usage already counted against the plan.
     bool DeleteAll();
     bool TrimToRecentDays(int days);
 
+    /**
+     * Set how long each tier is kept and the optional size cap. The policy
+     * is normalized (see NormalizeRetentionPolicy) and applied by idle
+     * maintenance; RunMaintenanceSlice applies it at once. The default
+     * policy keeps everything.
+     */
+    void SetRetentionPolicy(const HistoryRetentionPolicy& policy);
+    HistoryRetentionPolicy GetRetentionPolicy() const;
+
+    // Merge runs of steady traffic into span rows from the next sample on;
+    // waits for samples queued before the call to be written first
+    bool SetCoalescingOptions(const HistoryCoalescingOptions& options);
+
+    /**
+     * Block until every sample queued so far (from any thread) is committed.
+     */
+    void Flush();
+
+    /**
+     * Run one maintenance slice on the writer thread now, whether or not the
+     * logger is idle.
+     * @param budgetMs Time budget of the slice
+     * @return true if maintenance work remains after the slice
+     */
+    bool RunMaintenanceSlice(unsigned int budgetMs = HISTORY_MAINTENANCE_SLICE_MS);
+
+    HistoryMaintenanceStats GetMaintenanceStats() const;
+
+    // Asynchronous variants of the queries above. Interface filters are
+    // taken by value (empty = all interfaces) and pointer members of query
+    // structs are copied, so nothing needs to outlive the call. Results are
+    // delivered through the future; options.onComplete fires once it is
+    // ready. Queries submitted through the same options.slot supersede one
+    // another. A query that throws reports ok = false.
+    std::future<AsyncQueryResult<UsageTotals>> GetTotalsTodayAsync(
+        const std::wstring& interfaceFilter,
+        const AsyncQueryOptions& options = AsyncQueryOptions());
+
+    std::future<AsyncQueryResult<UsageTotals>> GetTotalsThisMonthAsync(
+        const std::wstring& interfaceFilter,
+        const AsyncQueryOptions& options = AsyncQueryOptions());
+
+    std::future<AsyncQueryResult<std::vector<HistorySample>>> GetRecentSamplesAsync(
+        int limit,
+        const std::wstring& interfaceFilter,
+        bool onlyToday,
+        const AsyncQueryOptions& options = AsyncQueryOptions());
+
+    // The visitor runs on a query thread; the result is the last key visited
+    std::future<AsyncQueryResult<HistoryCursor>> ForEachSampleAsync(
+        const HistoryQuery& query,
+        const HistorySampleVisitor& visitor,
+        const AsyncQueryOptions& options = AsyncQueryOptions());
+
+    // The result is the number of rows written
+    std::future<AsyncQueryResult<unsigned long long>> ExportHistoryAsync(
+        const std::wstring& path,
+        HistoryExportFormat format,
+        std::time_t from,
+        std::time_t to,
+        const std::wstring& interfaceFilter,
+        const AsyncQueryOptions& options = AsyncQueryOptions());
+
+    // Occupies a query thread for the whole copy; backupOptions.progress
+    // runs there too. Cancelling stops after the current step.
+    std::future<AsyncQueryResult<HistoryBackupStats>> BackupToAsync(
+        const std::wstring& path,
+        const HistoryBackupOptions& backupOptions = HistoryBackupOptions(),
+        const AsyncQueryOptions& options = AsyncQueryOptions());
+
+    std::future<AsyncQueryResult<std::vector<InterfaceRateStatistics>>> GetRateStatisticsAsync(
+        const RateQuery& query,
+        const AsyncQueryOptions& options = AsyncQueryOptions());
+
+    std::future<AsyncQueryResult<std::vector<RankedInterval>>> GetTopIntervalsAsync(
+        const TopKQuery& query,
+        const AsyncQueryOptions& options = AsyncQueryOptions());
+
+    std::future<AsyncQueryResult<std::vector<RankedInterface>>> GetTopInterfacesAsync(
+        const TopKQuery& query,
+        const AsyncQueryOptions& options = AsyncQueryOptions());
+
+    std::future<AsyncQueryResult<std::vector<CalendarTotal>>> GetCalendarTotalsAsync(
+        CalendarUnit unit,
+        std::time_t from,
+        std::time_t to,
+        const std::wstring& interfaceFilter,
+        const AsyncQueryOptions& options = AsyncQueryOptions());
+
+    std::future<AsyncQueryResult<BillingStatus>> GetBillingStatusAsync(
+        const std::wstring& interfaceFilter,
+        unsigned long long quotaBytes,
+        const AsyncQueryOptions& options = AsyncQueryOptions());
+
 private:
+    friend class HistorySnapshot;
+
+    // Read-only connection borrowed from the pool for one query, or the
+    // calling thread's open snapshot
+    class ReadLease
+    {
+    public:
+        explicit ReadLease(HistoryLogger& owner);
+        ~ReadLease();
+
+        ReadLease(const ReadLease&) = delete;
+        ReadLease& operator=(const ReadLease&) = delete;
+
+        sqlite3* Get() const { return m_db; }
+
+    private:
+        HistoryLogger& m_owner;
+        sqlite3* m_db;
+        bool m_pinned;      // A snapshot's connection; not returned to the pool
+    };
+
+    // Multi-row writer of usage rows with their rollup and billing sums
+    class BulkInserter;
+
+    // Queued unit of work for the writer thread: either a sample insert or
+    // a task run on the writer connection (with its result reported back).
+    struct WriteItem
+    {
+        unsigned long long seq;
+        unsigned long long journalSeq;   // 0 when not journaled
+        std::time_t timestamp;
+        std::wstring interfaceName;
+        unsigned long long bytesDown;
+        unsigned long long bytesUp;
+        std::function<bool(sqlite3*)> task;
+        bool* taskResult;
+    };
+
+    // Queued asynchronous query. run checks cancel before touching SQLite
+    // and always fulfils the query's promise.
+    struct QueryTask
+    {
+        std::shared_ptr<std::atomic<bool>> cancel;
+        unsigned long long lastQueuedSeq;   // Submitting thread's last write
+        std::function<void(const std::atomic<bool>& cancel)> run;
+    };
+
+    // Idle-maintenance bookkeeping; touched only by the writer thread
+    struct MaintenanceState
+    {
+        bool incremental;              // auto_vacuum=INCREMENTAL in effect
+        bool vacuumDue;                // Rows were deleted since the freelist was last empty
+        int walFrames;                 // Frames in the WAL after the last commit
+        int walBackfilled;             // Of those, frames already checkpointed
+        bool optimizeDue;
+        int optimizeInterrupts;        // Slices in a row that ran out of time in PRAGMA optimize
+        std::chrono::steady_clock::time_point lastCheckpoint;
+        std::chrono::steady_clock::time_point lastOptimize;
+        long long vacuumChunkPages;    // Size of the last incremental_vacuum chunk
+        double pagesPerMicrosecond;    // Its measured speed
+        bool retentionDue;             // Tiers may hold rows past the policy
+        std::chrono::steady_clock::time_point lastRetention;
+        long long retentionChunkRows;  // Size of the last retention chunk
+        double rowsPerMicrosecond;     // Its measured speed
+
+        MaintenanceState()
+            : incremental(false)
+            , vacuumDue(true)
+            , walFrames(0)
+            , walBackfilled(0)
+            , optimizeDue(true)
+            , optimizeInterrupts(0)
+            , vacuumChunkPages(4)
+            , pagesPerMicrosecond(0.0)
+            , retentionDue(true)
+            , retentionChunkRows(64)
+            , rowsPerMicrosecond(0.0)
+        {
+        }
+    };
+
     HistoryLogger();
     ~HistoryLogger();
 
@@ -63,12 +723,112 @@ private:
 
     void EnsureInitialized();
     void InitializeSQLite();
+    void InitializeReadOnly();
     void ShutdownSQLite();
 
-    bool InsertSampleSQLite(std::time_t ts,
-                            const std::wstring& iface,
-                            unsigned long long down,
-                            unsigned long long up);
+    void ReplayJournal();
+    bool StoreJournalSeq(unsigned long long journalSeq);
+
+    // Journal and queue a sample; waits (bounded) while the journal is full.
+    // Returns its journal sequence (0 if unjournaled) for WriteBack.
+    unsigned long long QueueSampleLocked(std::unique_lock<std::mutex>& lock, WriteItem& item);
+
+    void WriterThreadMain();
+    unsigned long long ApplyWriteBatch(std::deque<WriteItem>& batch);
+    // Wakes waiters on everything up to seq, and frees journal entries up
+    // to journalSeq (0 = none)
+    void PublishCommitted(unsigned long long seq, unsigned long long journalSeq);
+    bool RunOnWriter(const std::function<bool(sqlite3*)>& task);
+    void WaitForCommitted(unsigned long long seq);
+    void WaitForOwnWrites();
+
+    // Whether the writer and the reader pool have been quiet long enough
+    // for a maintenance slice
+    bool IsIdleForMaintenance(std::chrono::steady_clock::time_point lastWrite);
+    // Whether a maintenance step is due. force ignores the checkpoint
+    // interval.
+    bool MaintenancePending(bool force);
+    bool CheckpointDue(bool force) const;
+    // sqlite3_wal_hook on the writer connection: tracks the WAL size
+    static int WalCommitHook(void* owner, sqlite3* db, const char* dbName, int frames);
+    // Run due maintenance steps on the writer connection until budget is
+    // spent; returns true if work remains
+    bool DoMaintenanceSlice(std::chrono::microseconds budget, bool force);
+    void CheckpointStep(HistoryMaintenanceStats& delta);
+    void OptimizeStep(std::chrono::steady_clock::time_point deadline, HistoryMaintenanceStats& delta);
+    void VacuumStep(std::chrono::steady_clock::time_point deadline, HistoryMaintenanceStats& delta);
+    void ConvertToIncrementalVacuum(HistoryMaintenanceStats& delta);
+    // Whether the retention policy may have rows to age out
+    bool RetentionDue();
+    // Age out one chunk at a time until nothing is left or the deadline
+    void RetentionStep(std::chrono::steady_clock::time_point deadline, HistoryMaintenanceStats& delta);
+    // One transaction of about rows rows each; false if the tier has
+    // nothing before limit
+    bool ExpireRawChunk(long long limit, long long rows, HistoryMaintenanceStats& delta);
+    bool FoldMinuteChunk(long long limit, long long rows, HistoryMaintenanceStats& delta);
+    bool ExpireHourChunk(long long limit, long long rows, HistoryMaintenanceStats& delta);
+    // After DeleteAll, TrimToRecentDays or ImportSamples on the writer:
+    // checkpoint the WAL they grew and make vacuum (if freedPages) and
+    // optimize due
+    void FinishBulkChange(bool freedPages);
+
+    sqlite3* AcquireReader();
+    void ReleaseReader(sqlite3* db);
+
+    // Wrap query as a QueryTask and queue it; fulfils the future as
+    // cancelled straight away after shutdown
+    template <typename T>
+    std::future<AsyncQueryResult<T>> SubmitQuery(const AsyncQueryOptions& options,
+                                                 std::function<bool(T&)> query);
+    void QueryThreadMain();
+    void StopQueryThreads();
+
+    // Replace billing_cycle with totals for the cycle containing now under
+    // startDay, summed from usage_minute and usage_hour, and store startDay
+    bool RebuildBillingCycle(sqlite3* db, int startDay);
+
+    // Row source for range aggregations: (timestamp, interface, down, up)
+    using UsageRowVisitor = std::function<void(long long, std::wstring_view,
+                                               unsigned long long, unsigned long long)>;
+
+    // Parts of [from, to) read from each tier: usage_hour for [from,
+    // hourEnd), usage_minute for [hourEnd, minuteEnd) and raw rows for the
+    // rest. Minutes replace raw rows wherever the range allows (minuteAligned)
+    // and wherever raw rows have been aged out.
+    struct TierSplit
+    {
+        long long hourEnd;
+        long long minuteEnd;
+    };
+    static bool SplitByTier(sqlite3* db, long long from, long long to, bool minuteAligned, TierSplit& out);
+
+    // Download and upload bytes in [from, to), summed tier by tier
+    bool SumUsageRange(sqlite3* db,
+                       long long from,
+                       long long to,
+                       const std::wstring* interfaceFilter,
+                       unsigned long long& totalDown,
+                       unsigned long long& totalUp);
+
+    // Visit traffic in [from, to) in timestamp order, tier by tier (see
+    // SplitByTier); whole minutes replace raw rows when from and
+    // bucketSeconds are minute-aligned. Rollup rows carry their bucket's
+    // start time.
+    bool ScanUsageRange(sqlite3* db,
+                        long long from,
+                        long long to,
+                        long long bucketSeconds,
+                        const std::wstring* interfaceFilter,
+                        const UsageRowVisitor& visitor);
+
+    // Visit the raw samples in [from, to) in timestamp order, spreading
+    // span rows over their samples; includes spans that start up to a
+    // minute before from
+    static bool ScanRawSamples(sqlite3* db,
+                               long long from,
+                               long long to,
+                               const std::wstring* interfaceFilter,
+                               const UsageRowVisitor& visitor);
 
     bool ComputeStartOfToday(std::time_t& startOut);
     void LogRecentSamplesDebug(int limit,
@@ -76,10 +836,54 @@ private:
                                const std::wstring* interfaceFilter,
                                const std::vector<HistorySample>& samples);
 
-    bool m_initialized;
-    bool m_sqliteAvailable;
+    std::once_flag m_initOnce;
+    bool m_sqliteAvailable;                 // Writer running; false when read-only
+    bool m_readsAvailable;
+    std::string m_dbPathUtf8;
 
+    // Writer connection and its cached multi-row inserts; touched only by
+    // the writer thread once initialization has finished.
     sqlite3* m_db;
+    std::unique_ptr<BulkInserter> m_sampleInserter;
+    BillingCycleCache m_billingCycles;
+
+    std::thread m_writerThread;
+    std::mutex m_writeMutex;
+    std::condition_variable m_writeQueued;
+    std::condition_variable m_writeCommitted;
+    std::deque<WriteItem> m_writeQueue;
+    unsigned long long m_enqueuedSeq;
+    unsigned long long m_committedSeq;
+    bool m_stopWriter;
+
+    // Guarded by m_writeMutex
+    SampleJournal m_journal;
+    bool m_journalBehind;                   // Full ring already waited out once
+
+    std::mutex m_readerMutex;
+    std::vector<sqlite3*> m_idleReaders;
+    // Guarded by m_readerMutex; maintenance waits for the pool to go quiet
+    size_t m_activeReaders;
+    std::chrono::steady_clock::time_point m_lastReaderRelease;
+    // Backups in progress; each checkpoints the WAL it pinned itself, so
+    // the writer's commits leave that to them
+    std::atomic<int> m_backupsRunning;
+
+    MaintenanceState m_maintenance;
+    mutable std::mutex m_maintenanceMutex;
+    HistoryMaintenanceStats m_maintenanceStats;   // Guarded by m_maintenanceMutex
+    HistoryRetentionPolicy m_retentionPolicy;     // Guarded by m_maintenanceMutex
+    bool m_retentionChanged;                      // Guarded by m_maintenanceMutex
+
+    // Copy of m_billingCycles' start day for reader threads
+    std::atomic<int> m_billingStartDay;
+
+    // Asynchronous query pool, started by the first submission
+    std::mutex m_queryMutex;
+    std::condition_variable m_queryQueued;
+    std::deque<QueryTask> m_queryQueue;
+    std::vector<std::thread> m_queryThreads;
+    bool m_stopQueries;
 };
 
 } // namespace NetworkMonitor
@@ -0,0 +1,92 @@
+// ============================================================================
+// File: HistoryRetention.h
+// Description: Tiered retention policy for usage history (raw, minute, hour)
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#ifndef NETWORK_MONITOR_HISTORYRETENTION_H
+#define NETWORK_MONITOR_HISTORYRETENTION_H
+
+#include "NetworkMonitor/Common.h"
+#include <ctime>
+
+namespace NetworkMonitor
+{
+
+// Bucket length of the usage_hour tier
+constexpr long long HISTORY_HOUR_SECONDS = 60LL * 60;
+
+/**
+ * How long history is kept at each resolution. 0 days keeps a tier
+ * forever.
+ *
+ * Raw samples older than rawDays are deleted; usage_minute already holds
+ * their per-minute sums. Minutes older than minuteDays are folded into
+ * usage_hour, and hours older than hourDays are deleted.
+ *
+ * With maxSizeMB set, history beyond the policy goes too while the
+ * database holds more than that: the oldest raw rows first, then the oldest
+ * minutes (folded into hours), then the oldest hours. The last
+ * HISTORY_SIZE_CAP_KEEP_DAYS are never removed for the cap.
+ */
+struct HistoryRetentionPolicy
+{
+    int rawDays;
+    int minuteDays;
+    int hourDays;
+    unsigned int maxSizeMB;     // 0 = no cap
+
+    HistoryRetentionPolicy()
+        : rawDays(0)
+        , minuteDays(0)
+        , hourDays(0)
+        , maxSizeMB(0)
+    {
+    }
+
+    // Whether anything is ever removed
+    bool IsActive() const
+    {
+        return rawDays > 0 || minuteDays > 0 || hourDays > 0 || maxSizeMB > 0;
+    }
+};
+
+// Days the size cap always leaves alone
+constexpr int HISTORY_SIZE_CAP_KEEP_DAYS = 1;
+
+/**
+ * Clamp each tier to 0..MAX_HISTORY_TIER_DAYS and make every coarser tier
+ * last at least as long as the finer one (forever counts as longest), so
+ * data is always folded before it disappears.
+ */
+HistoryRetentionPolicy NormalizeRetentionPolicy(const HistoryRetentionPolicy& policy);
+
+// Where each tier ends at a given time: rows before the cutoff leave the
+// tier. 0 = the tier keeps everything.
+struct RetentionCutoffs
+{
+    std::time_t raw;       // Whole seconds
+    std::time_t minute;    // Whole hours, so folded hours are complete
+    std::time_t hour;      // Whole hours
+
+    RetentionCutoffs()
+        : raw(0)
+        , minute(0)
+        , hour(0)
+    {
+    }
+};
+
+// Cutoffs of a normalized policy at now
+RetentionCutoffs GetRetentionCutoffs(const HistoryRetentionPolicy& policy, std::time_t now);
+
+// Start of the whole UTC hour containing t
+inline long long HourStart(long long t)
+{
+    long long offset = t % HISTORY_HOUR_SECONDS;
+    return t - ((offset < 0) ? offset + HISTORY_HOUR_SECONDS : offset);
+}
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_HISTORYRETENTION_H
@@ -0,0 +1,192 @@
+// ============================================================================
+// File: HistoryStatistics.h
+// Description: Rate percentiles, histograms and top-K over usage history
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#ifndef NETWORK_MONITOR_HISTORYSTATISTICS_H
+#define NETWORK_MONITOR_HISTORYSTATISTICS_H
+
+#include "NetworkMonitor/Common.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <ctime>
+
+namespace NetworkMonitor
+{
+
+// Billing-period rate query: traffic is summed into fixed buckets starting
+// at `from` and each bucket's average rate becomes one observation.
+struct RateQuery
+{
+    std::time_t from;                      // Inclusive start of the period (required)
+    std::time_t to;                        // Exclusive end (0 = now)
+    const std::wstring* interfaceFilter;   // Optional exact interface match
+    int bucketSeconds;                     // Bucket length (300 for 95th-percentile billing)
+    int histogramBins;                     // Number of equal-width histogram bins
+
+    RateQuery()
+        : from(0)
+        , to(0)
+        , interfaceFilter(nullptr)
+        , bucketSeconds(300)
+        , histogramBins(20)
+    {
+    }
+};
+
+// Distribution of per-bucket rates in one direction, in bytes per second.
+struct RateDistribution
+{
+    double p95;                            // Burstable-billing 95th percentile
+    double p99;
+    double max;
+    double mean;
+    double binWidth;                       // Bin i covers [i * binWidth, (i + 1) * binWidth)
+    std::vector<unsigned int> histogram;   // Bucket counts per bin; the last bin includes max
+
+    RateDistribution()
+        : p95(0.0)
+        , p99(0.0)
+        , max(0.0)
+        , mean(0.0)
+        , binWidth(0.0)
+    {
+    }
+};
+
+struct InterfaceRateStatistics
+{
+    std::wstring interfaceName;
+    size_t bucketCount;                    // Buckets in the period, including idle ones
+    RateDistribution down;
+    RateDistribution up;
+
+    InterfaceRateStatistics()
+        : bucketCount(0)
+    {
+    }
+};
+
+// Which traffic a top-K query ranks by
+enum class TrafficMetric
+{
+    Total,
+    Down,
+    Up
+};
+
+// Range, bucket size and K for top-K queries. The interface filter applies
+// to GetTopIntervals; GetTopInterfaces ranks every interface.
+struct TopKQuery
+{
+    std::time_t from;                      // Inclusive start (required; buckets start here)
+    std::time_t to;                        // Exclusive end (0 = now)
+    const std::wstring* interfaceFilter;   // Optional exact interface match
+    int bucketSeconds;                     // Interval length for GetTopIntervals
+    size_t k;                              // Maximum results
+    TrafficMetric metric;
+
+    TopKQuery()
+        : from(0)
+        , to(0)
+        , interfaceFilter(nullptr)
+        , bucketSeconds(60)
+        , k(20)
+        , metric(TrafficMetric::Total)
+    {
+    }
+};
+
+// One interval in a top-K result; traffic of all matching interfaces
+struct RankedInterval
+{
+    std::time_t start;
+    unsigned long long bytesDown;
+    unsigned long long bytesUp;
+};
+
+struct RankedInterface
+{
+    std::wstring interfaceName;
+    unsigned long long bytesDown;
+    unsigned long long bytesUp;
+};
+
+inline unsigned long long MetricValue(TrafficMetric metric, unsigned long long down, unsigned long long up)
+{
+    switch (metric)
+    {
+    case TrafficMetric::Down: return down;
+    case TrafficMetric::Up:   return up;
+    default:                  return down + up;
+    }
+}
+
+/**
+ * Keeps the K best items seen so far in a min-heap ordered by `better`, so
+ * offering N items costs O(N log K) time and O(K) memory.
+ * better(a, b) must return true when a ranks strictly above b.
+ */
+template <typename T, typename Better>
+class TopKCollector
+{
+public:
+    TopKCollector(size_t k, Better better)
+        : m_k(k)
+        , m_better(better)
+    {
+        m_heap.reserve((std::min)(k, static_cast<size_t>(1024)));
+    }
+
+    void Offer(const T& item)
+    {
+        if (m_k == 0)
+        {
+            return;
+        }
+
+        if (m_heap.size() < m_k)
+        {
+            m_heap.push_back(item);
+            std::push_heap(m_heap.begin(), m_heap.end(), m_better);
+        }
+        else if (m_better(item, m_heap.front()))
+        {
+            // front() is the weakest of the kept items
+            std::pop_heap(m_heap.begin(), m_heap.end(), m_better);
+            m_heap.back() = item;
+            std::push_heap(m_heap.begin(), m_heap.end(), m_better);
+        }
+    }
+
+    // Best first; leaves the collector empty
+    std::vector<T> TakeSorted()
+    {
+        std::sort_heap(m_heap.begin(), m_heap.end(), m_better);
+        return std::move(m_heap);
+    }
+
+private:
+    size_t m_k;
+    Better m_better;
+    std::vector<T> m_heap;
+};
+
+/**
+ * Summarize per-bucket rates. Buckets with no traffic count as zero, as a
+ * transit provider's 5-minute samples would.
+ *
+ * Percentiles use the billing convention: sort ascending, drop the top
+ * (100 - p)% of samples and take the highest remaining one. They are found
+ * with std::nth_element (linear time) rather than a full sort; rates is
+ * reordered in the process.
+ * @param rates Per-bucket rates in bytes per second (reordered)
+ * @param histogramBins Number of histogram bins (at least 1)
+ */
+RateDistribution ComputeRateDistribution(std::vector<double>& rates, int histogramBins);
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_HISTORYSTATISTICS_H
@@ -0,0 +1,168 @@
+// ============================================================================
+// File: LocalCalendar.h
+// Description: Precomputed local day and month boundaries for fast bucketing
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#ifndef NETWORK_MONITOR_LOCALCALENDAR_H
+#define NETWORK_MONITOR_LOCALCALENDAR_H
+
+#include "NetworkMonitor/Common.h"
+#include <ctime>
+#include <memory>
+#include <vector>
+
+namespace NetworkMonitor
+{
+
+// Years before the current one covered by the shared calendar by default
+constexpr int LOCAL_CALENDAR_YEARS_BACK = 5;
+// Years after the current one covered by the shared calendar by default
+constexpr int LOCAL_CALENDAR_YEARS_AHEAD = 1;
+// Widest window the shared calendar grows to; lookups outside it fall back
+// to localtime_s/mktime
+constexpr int LOCAL_CALENDAR_MAX_YEARS = 100;
+
+// [start, end) of a local day or month, as UTC epoch seconds
+struct CalendarSpan
+{
+    std::time_t start;
+    std::time_t end;
+
+    CalendarSpan()
+        : start(0)
+        , end(0)
+    {
+    }
+};
+
+enum class CalendarUnit
+{
+    Day,
+    Month
+};
+
+// Traffic in one local day or month
+struct CalendarTotal
+{
+    std::time_t start;
+    std::time_t end;
+    unsigned long long bytesDown;
+    unsigned long long bytesUp;
+};
+
+/**
+ * Table of local-midnight and month-start epochs for whole local years.
+ *
+ * Boundaries are computed once with mktime, so DST changes (23- and 25-hour
+ * days, or a midnight that does not exist and starts the day at 01:00) are
+ * baked into the table. Mapping a timestamp to its day guesses the index
+ * from the elapsed seconds and corrects it by at most a step or two, so a
+ * lookup costs a division and a few comparisons instead of a CRT call.
+ *
+ * A built calendar is immutable and safe to share between threads. The
+ * shared instance reflects the time zone in effect when it was built; call
+ * Reset after _tzset changes it.
+ */
+class LocalCalendar
+{
+public:
+    LocalCalendar();
+
+    /**
+     * Build the table for local years firstYear..lastYear (inclusive).
+     * @return false if the range is empty or mktime fails
+     */
+    bool Build(int firstYear, int lastYear);
+
+    /**
+     * Shared calendar covering [from, to], widened from the default window
+     * around the current year as needed.
+     * @return nullptr if the range would exceed LOCAL_CALENDAR_MAX_YEARS or
+     *         the table could not be built
+     */
+    static std::shared_ptr<const LocalCalendar> Shared(std::time_t from, std::time_t to);
+    static std::shared_ptr<const LocalCalendar> Shared(std::time_t t) { return Shared(t, t); }
+
+    // Drop the shared calendar so the next lookup rebuilds it
+    static void Reset();
+
+    int FirstYear() const { return m_firstYear; }
+    int LastYear() const { return m_firstYear + MonthCount() / 12 - 1; }
+    int DayCount() const { return static_cast<int>(m_dayStarts.size()) - 1; }
+    int MonthCount() const { return static_cast<int>(m_monthFirstDay.size()) - 1; }
+
+    bool Covers(std::time_t t) const
+    {
+        return !m_dayStarts.empty() && t >= m_dayStarts.front() && t < m_dayStarts.back();
+    }
+
+    // Index of the local day containing t (0 = 1 January of FirstYear), or
+    // -1 outside the table
+    int DayIndex(std::time_t t) const
+    {
+        if (!Covers(t))
+        {
+            return -1;
+        }
+
+        long long guess = static_cast<long long>(t - m_dayStarts.front()) / SECONDS_PER_DAY;
+        int day = static_cast<int>((guess < DayCount()) ? guess : DayCount() - 1);
+        while (t < m_dayStarts[day])
+        {
+            --day;
+        }
+        while (t >= m_dayStarts[day + 1])
+        {
+            ++day;
+        }
+        return day;
+    }
+
+    // Index of the local month containing t (0 = January of FirstYear), or
+    // -1 outside the table
+    int MonthIndex(std::time_t t) const
+    {
+        int day = DayIndex(t);
+        return (day < 0) ? -1 : m_dayMonth[day];
+    }
+
+    int MonthOfDay(int day) const { return m_dayMonth[day]; }
+
+    std::time_t DayStart(int day) const { return m_dayStarts[day]; }
+    std::time_t DayEnd(int day) const { return m_dayStarts[day + 1]; }
+    std::time_t MonthStart(int month) const { return m_dayStarts[m_monthFirstDay[month]]; }
+    std::time_t MonthEnd(int month) const { return m_dayStarts[m_monthFirstDay[month + 1]]; }
+
+    int DaysInMonth(int month) const { return m_monthFirstDay[month + 1] - m_monthFirstDay[month]; }
+
+    /**
+     * Local midnight starting dayOfMonth (1-based) in the given month. Days
+     * past the end of the month are clamped to its last day.
+     * @return -1 if month is outside the table
+     */
+    std::time_t DayOfMonthStart(int month, int dayOfMonth) const;
+
+private:
+    static constexpr long long SECONDS_PER_DAY = 24LL * 60 * 60;
+
+    int m_firstYear;
+    // Local midnight of every day, plus the end of the last day
+    std::vector<std::time_t> m_dayStarts;
+    // Month index of every day
+    std::vector<int> m_dayMonth;
+    // Day index starting every month, plus one past the last day
+    std::vector<int> m_monthFirstDay;
+};
+
+// Days in a month of the Gregorian calendar (month 0-11)
+int GetDaysInMonth(int year, int month);
+
+// Local day / month containing t. Served from the shared calendar, with a
+// localtime_s/mktime fallback outside its window.
+bool GetLocalDay(std::time_t t, CalendarSpan& out);
+bool GetLocalMonth(std::time_t t, CalendarSpan& out);
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_LOCALCALENDAR_H
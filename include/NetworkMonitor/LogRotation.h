@@ -0,0 +1,126 @@
+// ============================================================================
+// File: LogRotation.h
+// Description: Size- and age-capped log files with compressed archives
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#ifndef NETWORK_MONITOR_LOGROTATION_H
+#define NETWORK_MONITOR_LOGROTATION_H
+
+#include "NetworkMonitor/Common.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace NetworkMonitor
+{
+
+struct LogRotationOptions
+{
+    unsigned long long maxFileBytes;    // Rotate before the file passes this (0 = no size limit)
+    unsigned int maxFileAgeSeconds;     // Rotate once the file is this old (0 = no age limit)
+    unsigned int keepFiles;             // Archives kept; older ones are deleted
+    bool compress;                      // Gzip archives in the background
+
+    LogRotationOptions()
+        : maxFileBytes(10ULL * 1024 * 1024)
+        , maxFileAgeSeconds(0)
+        , keepFiles(5)
+        , compress(true)
+    {
+    }
+};
+
+struct LogRotationStats
+{
+    unsigned long long rotations;       // Files moved aside
+    unsigned long long compressed;      // Archives gzipped
+    unsigned long long deleted;         // Archives removed past keepFiles
+
+    LogRotationStats()
+        : rotations(0)
+        , compressed(0)
+        , deleted(0)
+    {
+    }
+};
+
+/**
+ * Append-only log file that moves itself aside when it gets too big or too
+ * old.
+ *
+ * A rotation closes the file, renames it to
+ * "<name>.<YYYYMMDD-HHMMSS-mmm>.<ext>" (UTC) next to it and starts a new
+ * one. Only the owning writer thread appends, so no line can land in both
+ * files or in neither. Archives are gzipped and pruned to keepFiles by a
+ * background thread; an archive another process still has open for writing
+ * is left for a later pass. Archives left uncompressed by an earlier run are
+ * picked up when the file is first opened.
+ *
+ * Not thread-safe apart from GetStats: one writer thread owns the object.
+ */
+class RotatingLogFile
+{
+public:
+    explicit RotatingLogFile(const std::wstring& path);
+    ~RotatingLogFile();     // Finishes queued compression
+
+    RotatingLogFile(const RotatingLogFile&) = delete;
+    RotatingLogFile& operator=(const RotatingLogFile&) = delete;
+
+    void SetOptions(const LogRotationOptions& options);
+
+    // Bytes the current file takes before it is due for rotation; a full
+    // file reports 0. Opens the file if needed.
+    unsigned long long GetRoom();
+
+    bool IsEmpty();
+
+    // True when the age limit has passed for a non-empty file
+    bool IsAged();
+
+    // Write everything to the current file; false (and the file closed for
+    // a retry) on failure
+    bool Append(const char* data, size_t bytes);
+
+    // Move the current file aside and start a new one
+    bool Rotate();
+
+    LogRotationStats GetStats() const;
+
+private:
+    bool Open();
+    void Close();
+    void QueueArchiveWork(const std::wstring& archive);
+    void ArchiveThreadMain();
+    void PruneArchives(unsigned int keepFiles);
+
+    std::wstring m_path;
+    LogRotationOptions m_options;
+    HANDLE m_file;
+    unsigned long long m_size;
+    unsigned long long m_startTime;     // FILETIME ticks (UTC) the file was started
+    bool m_swept;                       // Leftovers of earlier runs queued
+
+    // Background archive work
+    mutable std::mutex m_archiveMutex;
+    std::condition_variable m_archiveWake;
+    std::deque<std::wstring> m_archiveQueue;    // Empty string: prune only
+    LogRotationOptions m_archiveOptions;
+    LogRotationStats m_stats;
+    bool m_archiveStop;
+    std::thread m_archiveThread;
+};
+
+// Archives of a log file, oldest first; compressed ones end in ".gz"
+std::vector<std::wstring> ListLogArchives(const std::wstring& logPath);
+
+// Write source as a gzip file (deflate with fixed Huffman codes), streaming
+bool CompressFileToGzip(const std::wstring& source, const std::wstring& target);
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_LOGROTATION_H
@@ -1,6 +1,6 @@
 // ============================================================================
 // File: PingMonitor.h
-// Description: Lightweight ICMP ping monitor using Windows API
+// Description: Latency to the configured ping target
 // Author: NetworkMonitor Project
 // ============================================================================
 
@@ -8,27 +8,24 @@
 #define NETWORK_MONITOR_PING_MONITOR_H
 
 #include "NetworkMonitor/Common.h"
-#include <winsock2.h>
-#include <iphlpapi.h>
-#include <icmpapi.h>
+#include "NetworkMonitor/ProbeEngine.h"
 #include <string>
 
-#pragma comment(lib, "iphlpapi.lib")
-
 namespace NetworkMonitor
 {
 
+// Pings one target from a ProbeEngine; nothing here waits on the network
 class PingMonitor
 {
 public:
     PingMonitor();
     ~PingMonitor();
 
-    // Initialize with target IP/domain (default: 8.8.8.8)
-    bool Initialize(const std::wstring& target = L"8.8.8.8");
+    // Initialize with target IP/domain (default: 8.8.8.8), pinged every intervalMs
+    bool Initialize(const std::wstring& target = L"8.8.8.8", UINT intervalMs = 5000);
     void Cleanup();
 
-    // Perform ping and update latency (call from timer)
+    // Pick up the latest probe result (call from timer)
     void Update();
 
     // Get last measured latency in milliseconds (-1 if failed/timeout)
@@ -37,18 +34,22 @@ public:
     // Check if ping is available
     bool IsAvailable() const { return m_initialized; }
 
-    // Set new target (will resolve on next Update)
+    // Set new target (resolved now, pinged from the next interval)
     void SetTarget(const std::wstring& target);
+    void SetInterval(UINT intervalMs);
 
 private:
-    HANDLE m_hIcmp;
+    ProbeEngine m_engine;
+    unsigned int m_targetId;  // 0 = none
     bool m_initialized;
     int m_latency;  // -1 = unavailable/timeout
     std::wstring m_target;
     ULONG m_targetIP;
+    UINT m_intervalMs;
 
     // Resolve hostname/IP to IP address
     bool ResolveTarget();
+    void AddTarget();
 
     static constexpr DWORD TIMEOUT_MS = 1000;
 };
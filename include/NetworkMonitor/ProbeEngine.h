@@ -0,0 +1,119 @@
+// ============================================================================
+// File: ProbeEngine.h
+// Description: Asynchronous ICMP echo probes to many targets on one thread
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#ifndef NETWORK_MONITOR_PROBEENGINE_H
+#define NETWORK_MONITOR_PROBEENGINE_H
+
+#include "NetworkMonitor/Common.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace NetworkMonitor
+{
+
+constexpr unsigned int DEFAULT_PROBE_TIMEOUT_MS = 1000;
+constexpr unsigned int MIN_PROBE_INTERVAL_MS = 10;
+
+struct ProbeStats
+{
+    unsigned long long sent;
+    unsigned long long received;
+    unsigned long long lost;            // Timed out, or could not be sent
+    double lastRttMs;                   // -1 before the first reply and after a loss
+
+    ProbeStats()
+        : sent(0)
+        , received(0)
+        , lost(0)
+        , lastRttMs(-1.0)
+    {
+    }
+};
+
+/**
+ * Sends ICMP echo requests to any number of IPv4 targets, each on its own
+ * interval, from one background thread. Nothing the caller does waits on
+ * the network.
+ *
+ * Probes that fall due together go out as one batch; replies are matched
+ * to their probe by sequence number, echo identifier and a payload cookie,
+ * and a timer wheel expires the ones that get no answer.
+ *
+ * Linux uses an unprivileged ICMP datagram socket (net.ipv4.ping_group_range
+ * must include the process's group), falling back to a raw socket when the
+ * process has CAP_NET_RAW; epoll, sendmmsg and recvmmsg move the packets.
+ * Windows has no unprivileged ICMP socket, so each probe is an
+ * IcmpSendEcho2 whose completion is queued as an APC to the engine thread.
+ *
+ * Targets can be added before Start and are kept across Stop. Start and
+ * Stop belong to one thread; the other methods may be called from any.
+ * Start returns false if no ICMP socket can be opened.
+ */
+class ProbeEngine
+{
+public:
+    // rttMs is -1 for a lost probe. Runs on the engine thread.
+    using ResultCallback = std::function<void(unsigned int targetId, double rttMs)>;
+
+    ProbeEngine();
+    ~ProbeEngine();     // Stops
+
+    ProbeEngine(const ProbeEngine&) = delete;
+    ProbeEngine& operator=(const ProbeEngine&) = delete;
+
+    bool Start(ResultCallback onResult = ResultCallback());
+    void Stop();        // Waits out probes in flight, up to their timeout
+    bool IsRunning() const { return m_running.load(std::memory_order_acquire); }
+
+    // address is IPv4 in network byte order. Returns the target's ID; the
+    // first probe goes out within one interval, spread so targets added
+    // together are not probed together.
+    unsigned int AddTarget(uint32_t address, unsigned int intervalMs,
+                           unsigned int timeoutMs = DEFAULT_PROBE_TIMEOUT_MS);
+    void RemoveTarget(unsigned int targetId);
+    bool SetTargetInterval(unsigned int targetId, unsigned int intervalMs);
+
+    bool GetStats(unsigned int targetId, ProbeStats& stats) const;
+    size_t GetTargetCount() const;
+
+private:
+    // Sockets, timer wheel and probes in flight; owned by the engine thread
+    class Worker;
+
+    struct Target
+    {
+        unsigned int id;                // 0 = free slot
+        uint32_t generation;            // Bumped when the slot is freed
+        uint32_t address;
+        unsigned int intervalMs;
+        unsigned int timeoutMs;
+        unsigned int firstDelayMs;
+        ProbeStats stats;
+    };
+
+    mutable std::mutex m_mutex;
+    std::vector<Target> m_targets;          // Slots; IDs map to them
+    std::unordered_map<unsigned int, size_t> m_slotById;
+    std::vector<size_t> m_freeSlots;
+    std::vector<size_t> m_added;            // Slots the engine thread has yet to schedule
+    unsigned int m_nextTargetId;
+    unsigned long long m_addedCount;
+
+    ResultCallback m_onResult;
+    std::unique_ptr<Worker> m_worker;
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+};
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_PROBEENGINE_H
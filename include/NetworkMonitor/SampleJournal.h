@@ -0,0 +1,107 @@
+// ============================================================================
+// File: SampleJournal.h
+// Description: Memory-mapped ring journal protecting queued history samples
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#ifndef NETWORK_MONITOR_SAMPLEJOURNAL_H
+#define NETWORK_MONITOR_SAMPLEJOURNAL_H
+
+#include "NetworkMonitor/Common.h"
+#include <string>
+#include <vector>
+#include <ctime>
+
+namespace NetworkMonitor
+{
+
+// Sample recovered from the journal during replay
+struct JournalSample
+{
+    unsigned long long seq;
+    std::time_t timestamp;
+    std::wstring interfaceName;
+    unsigned long long bytesDown;
+    unsigned long long bytesUp;
+};
+
+/**
+ * Fixed-size ring of checksummed sample records in a memory-mapped file.
+ *
+ * Append copies a record into the mapping; once it returns, the sample
+ * survives a crash or kill of the process because the page belongs to the
+ * OS file cache. WriteBack then hands the records' pages to the OS for
+ * write-back, once for a whole batch of appends. Records carry a sequence number; the caller commits samples
+ * to SQLite together with the highest sequence applied and then calls
+ * MarkCommitted, so replay after a crash skips anything already stored.
+ *
+ * Not internally synchronized; HistoryLogger calls it under its queue lock.
+ */
+class SampleJournal
+{
+public:
+    // Longest interface name that fits in a record (characters)
+    static constexpr size_t MAX_NAME_LENGTH = 236;
+    static constexpr unsigned int DEFAULT_SLOT_COUNT = 4096;
+
+    SampleJournal();
+    ~SampleJournal();
+
+    SampleJournal(const SampleJournal&) = delete;
+    SampleJournal& operator=(const SampleJournal&) = delete;
+
+    /**
+     * Open (or create) the journal file and map it.
+     * @param path Journal file path
+     * @param slotCount Ring capacity in records (used when creating)
+     * @return true on success
+     */
+    bool Open(const std::wstring& path, unsigned int slotCount = DEFAULT_SLOT_COUNT);
+    void Close();
+    bool IsOpen() const { return m_view != nullptr; }
+
+    /**
+     * Collect valid records newer than both the journal's own committed mark
+     * and storedSeq (the sequence recorded in the database), in order.
+     * Also positions the next sequence number past everything seen.
+     */
+    void ReadPending(unsigned long long storedSeq, std::vector<JournalSample>& out);
+
+    /**
+     * Append a sample.
+     * @return Sequence number assigned, or 0 if the sample could not be
+     *         journaled (ring full, name too long, or journal closed)
+     */
+    unsigned long long Append(std::time_t timestamp,
+                              const std::wstring& interfaceName,
+                              unsigned long long bytesDown,
+                              unsigned long long bytesUp);
+
+    // Start writing the records firstSeq..lastSeq back to disk
+    void WriteBack(unsigned long long firstSeq, unsigned long long lastSeq);
+
+    // True when every slot holds an uncommitted record
+    bool IsFull() const;
+
+    // Record that every sample up to seq is stored in the database
+    void MarkCommitted(unsigned long long seq);
+
+private:
+    struct Header;
+    struct Record;
+
+    Header* GetHeader() const;
+    Record* GetSlot(unsigned long long seq) const;
+
+    HANDLE m_file;
+    HANDLE m_mapping;
+    void* m_view;
+    size_t m_viewSize;
+    unsigned int m_slotCount;
+    unsigned long long m_nextSeq;
+    unsigned long long m_committedSeq;
+};
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_SAMPLEJOURNAL_H
@@ -39,6 +39,13 @@ private:
     void PopulateInterfaceCombo(HWND hDlg);
     void CenterDialogOnScreen(HWND hDlg);
 
+    // Interface chosen in the monitor combo ("" = all interfaces)
+    bool GetComboInterface(HWND hDlg, std::wstring& interfaceName) const;
+
+    // Show / keep the billing cap of the interface chosen in the monitor combo
+    void LoadQuotaEdit(HWND hDlg);
+    void StoreQuotaEdit(HWND hDlg);
+
     // Member variables
     HWND m_hDialog;
     ConfigManager* m_pConfigManager;
@@ -46,6 +53,7 @@ private:
     AppConfig m_configCopy;  // Working copy of config
     std::function<void()> m_settingsChangedCallback;
     bool m_isInitializing;   // Prevent recursive updates during initialization
+    std::wstring m_quotaInterface;  // Interface whose cap the quota edit shows
 };
 
 } // namespace NetworkMonitor
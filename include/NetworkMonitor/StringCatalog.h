@@ -0,0 +1,126 @@
+// ============================================================================
+// File: StringCatalog.h
+// Description: Localized strings loaded once into one arena, looked up by ID
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#ifndef NETWORK_MONITOR_STRINGCATALOG_H
+#define NETWORK_MONITOR_STRINGCATALOG_H
+
+#ifdef _WIN32
+#include "NetworkMonitor/Common.h"
+#endif
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace NetworkMonitor
+{
+
+/**
+ * Every string of one language, keyed by resource ID.
+ *
+ * The text lives in a single arena, each string followed by a terminator,
+ * so Get is an index into a table and the view's data() can be passed
+ * where a C string is expected. A missing ID gives an empty view.
+ *
+ * Two backends fill it: the module's STRINGTABLE (Windows), or a UTF-8
+ * text file that works anywhere. The file has one string per line:
+ *
+ *     # comment
+ *     442=Down:
+ *     445=Line one\nLine two
+ *
+ * The text runs to the end of the line, trailing spaces included; \n, \t
+ * and \\ are the only escapes. A later line for the same ID wins. A line
+ * that is not a comment and has no "<id>=" fails the whole load and leaves
+ * the catalog empty.
+ *
+ * Immutable once loaded; any number of threads may read it.
+ */
+class StringCatalog
+{
+public:
+    StringCatalog();
+
+    StringCatalog(const StringCatalog&) = delete;
+    StringCatalog& operator=(const StringCatalog&) = delete;
+
+#ifdef _WIN32
+    // The STRINGTABLE strings of the module, in the language LoadStringW
+    // picks for the calling thread
+    bool LoadFromResources(HINSTANCE instance);
+#endif
+
+    bool LoadFromFile(const std::wstring& path);
+    bool LoadFromText(std::string_view utf8);
+
+    std::wstring_view Get(unsigned int id) const
+    {
+        unsigned int slot = id - m_firstId;
+        if (slot >= m_index.size())
+        {
+            return std::wstring_view(L"", 0);
+        }
+        const Entry& entry = m_index[slot];
+        return std::wstring_view(m_arena.data() + entry.offset, entry.length);
+    }
+
+    size_t GetCount() const { return m_count; }
+
+    // Tag of the language the strings were loaded for (a LANGID on Windows)
+    unsigned int GetLanguage() const { return m_language; }
+    void SetLanguage(unsigned int language) { m_language = language; }
+
+private:
+    struct Entry
+    {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct Pending
+    {
+        unsigned int id;
+        Entry entry;
+    };
+
+    void ResetArena();
+    void Add(std::vector<Pending>& pending, unsigned int id, const wchar_t* text, size_t length);
+    void BuildIndex(const std::vector<Pending>& pending);
+
+    std::wstring m_arena;           // All strings, each terminated; empty at 0
+    std::vector<Entry> m_index;     // By id - m_firstId
+    unsigned int m_firstId;
+    size_t m_count;
+    unsigned int m_language;
+};
+
+// ============================================================================
+// ACTIVE CATALOG
+// ============================================================================
+
+/**
+ * String resourceId of the active catalog; empty if it has none. On
+ * Windows the first call loads the catalog from the module's resources.
+ *
+ * Views stay valid for the life of the process: a catalog that is replaced
+ * is kept, not freed, so a view taken on another thread is never left
+ * dangling. Languages change only when the user picks one.
+ */
+std::wstring_view LoadStringView(unsigned int resourceId);
+
+#ifdef _WIN32
+// Loads the module's strings for the thread UI language just set; does
+// nothing when the active catalog is already in that language
+void ReloadStringCatalog(LANGID language);
+#endif
+
+// Makes the strings of a catalog file active, for builds without Windows
+// resources; keeps the current catalog on failure
+bool LoadStringCatalogFile(const std::wstring& path);
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_STRINGCATALOG_H
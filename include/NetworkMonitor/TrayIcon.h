@@ -8,6 +8,7 @@
 #define NETWORK_MONITOR_TRAYICON_H
 
 #include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/ConfigStore.h"
 #include <windows.h>
 #include <shellapi.h>
 #include <functional>
@@ -70,9 +71,10 @@ public:
     void SetMenuCallback(std::function<void(UINT)> callback);
 
     /**
-     * Provide pointer to current configuration (for reflecting menu state)
+     * Provide the configuration store (for reflecting menu state); the
+     * current snapshot is read on each use
      */
-    void SetConfigSource(const AppConfig* config);
+    void SetConfigSource(const ConfigStore* configStore);
 
     /**
      * Provide callback to query taskbar overlay visibility state
@@ -111,7 +113,7 @@ private:
     HICON m_iconActiveDark;                         // Dark theme active icon
     HICON m_iconHighDark;                           // Dark theme high traffic icon
     std::function<void(UINT)> m_menuCallback;       // Menu selection callback
-    const AppConfig* m_configRef;                   // Current config reference
+    const ConfigStore* m_configStore;               // Current config source
     std::function<bool()> m_overlayVisibleProvider; // Overlay visibility provider
 };
 
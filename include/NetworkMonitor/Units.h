@@ -0,0 +1,153 @@
+// ============================================================================
+// File: Units.h
+// Description: Compile-time data size and rate units (bytes, bits, SI and
+//              IEC prefixes) with conversions folded to one operation
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#ifndef NETWORK_MONITOR_UNITS_H
+#define NETWORK_MONITOR_UNITS_H
+
+#include "NetworkMonitor/Common.h"
+#include <ratio>
+#include <type_traits>
+
+namespace NetworkMonitor
+{
+
+// A unit is its size in bytes, kept as an exact ratio
+template <typename BytesPerUnit>
+struct DataUnit
+{
+    using Ratio = typename BytesPerUnit::type;
+};
+
+// SI prefixes are powers of 1000 (std::kilo, std::mega, ...), IEC ones
+// powers of 1024
+using Kibi = std::ratio<1024>;
+using Mebi = std::ratio<1024LL * 1024>;
+using Gibi = std::ratio<1024LL * 1024 * 1024>;
+using Tebi = std::ratio<1024LL * 1024 * 1024 * 1024>;
+
+template <typename Prefix, typename Unit>
+using Prefixed = DataUnit<std::ratio_multiply<Prefix, typename Unit::Ratio>>;
+
+using Bytes = DataUnit<std::ratio<1>>;
+using Bits = DataUnit<std::ratio<1, 8>>;
+
+using Kibibytes = Prefixed<Kibi, Bytes>;
+using Mebibytes = Prefixed<Mebi, Bytes>;
+using Gibibytes = Prefixed<Gibi, Bytes>;
+using Tebibytes = Prefixed<Tebi, Bytes>;
+
+using Kilobytes = Prefixed<std::kilo, Bytes>;
+using Megabytes = Prefixed<std::mega, Bytes>;
+using Gigabytes = Prefixed<std::giga, Bytes>;
+using Terabytes = Prefixed<std::tera, Bytes>;
+
+using Kilobits = Prefixed<std::kilo, Bits>;
+using Megabits = Prefixed<std::mega, Bits>;
+using Gigabits = Prefixed<std::giga, Bits>;
+
+// Counts of From per count of To, reduced
+template <typename From, typename To>
+using UnitFactor = std::ratio_divide<typename From::Ratio, typename To::Ratio>;
+
+/**
+ * Converts a count between units with the factor known at compile time.
+ * Whole factors multiply and whole divisors divide, so the result is the
+ * exact quotient rounded once (bytes / 125000 rather than bytes * 8e-6).
+ * Integer counts only convert to smaller units, where nothing is lost.
+ */
+template <typename From, typename To, typename Rep>
+constexpr Rep ConvertCount(Rep count)
+{
+    using Factor = UnitFactor<From, To>;
+    if constexpr (std::is_integral<Rep>::value)
+    {
+        static_assert(Factor::den == 1, "an integer count would be truncated; convert it as double");
+        return count * static_cast<Rep>(Factor::num);
+    }
+    else if constexpr (Factor::den == 1)
+    {
+        return count * static_cast<Rep>(Factor::num);
+    }
+    else if constexpr (Factor::num == 1)
+    {
+        return count / static_cast<Rep>(Factor::den);
+    }
+    else
+    {
+        return count * (static_cast<Rep>(Factor::num) / static_cast<Rep>(Factor::den));
+    }
+}
+
+struct PerTransfer {};
+struct PerSecond {};
+
+// A count of Unit; sizes and per-second rates do not mix
+template <typename Unit, typename Rep, typename Per>
+class DataQuantity
+{
+public:
+    constexpr DataQuantity()
+        : m_count(0)
+    {
+    }
+
+    constexpr explicit DataQuantity(Rep count)
+        : m_count(count)
+    {
+    }
+
+    template <typename OtherUnit, typename OtherRep>
+    constexpr DataQuantity(const DataQuantity<OtherUnit, OtherRep, Per>& other)
+        : m_count(ConvertCount<OtherUnit, Unit>(static_cast<Rep>(other.Count())))
+    {
+        static_assert(std::is_floating_point<Rep>::value || std::is_integral<OtherRep>::value,
+                      "a fractional count would be truncated");
+    }
+
+    constexpr Rep Count() const { return m_count; }
+
+private:
+    Rep m_count;
+};
+
+template <typename Unit, typename Rep = double>
+using DataSize = DataQuantity<Unit, Rep, PerTransfer>;
+
+template <typename Unit, typename Rep = double>
+using DataRate = DataQuantity<Unit, Rep, PerSecond>;
+
+template <typename To, typename From, typename Rep, typename Per>
+constexpr DataQuantity<To, Rep, Per> UnitCast(const DataQuantity<From, Rep, Per>& quantity)
+{
+    return DataQuantity<To, Rep, Per>(quantity);
+}
+
+/**
+ * The one place a configured SpeedUnit becomes a unit type: calls fn with
+ * an instance of the matching unit (KB/s for anything unknown). Code past
+ * this point converts with compile-time factors.
+ */
+template <typename Fn>
+decltype(auto) VisitSpeedUnit(SpeedUnit unit, Fn&& fn)
+{
+    switch (unit)
+    {
+    case SpeedUnit::BytesPerSecond:
+        return fn(Bytes());
+    case SpeedUnit::MegaBytesPerSecond:
+        return fn(Mebibytes());
+    case SpeedUnit::MegaBitsPerSecond:
+        return fn(Megabits());
+    case SpeedUnit::KiloBytesPerSecond:
+    default:
+        return fn(Kibibytes());
+    }
+}
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_UNITS_H
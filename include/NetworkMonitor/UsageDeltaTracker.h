@@ -0,0 +1,60 @@
+// ============================================================================
+// File: UsageDeltaTracker.h
+// Description: Per-interface byte deltas between history logging ticks
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#ifndef NETWORK_MONITOR_USAGEDELTATRACKER_H
+#define NETWORK_MONITOR_USAGEDELTATRACKER_H
+
+#include "NetworkMonitor/Common.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace NetworkMonitor
+{
+
+/**
+ * Remembers the cumulative counters of every interface from the previous
+ * tick and turns the current ones into per-interval byte counts.
+ *
+ * Each interface is tracked on its own: the first tick it appears in only
+ * sets its baseline. A counter that went backwards (adapter reset, driver
+ * reload) resets that interface and direction alone; the interval records
+ * nothing and the new value becomes the baseline. An interface missing
+ * from a tick is forgotten, so it starts a new baseline when it returns.
+ */
+class UsageDeltaTracker
+{
+public:
+    UsageDeltaTracker();
+
+    /**
+     * Compute the usage of every interface since the previous call.
+     * @param stats Current counters of the monitored interfaces
+     * @param out Receives one entry per interface that transferred bytes;
+     *            entries are reused across calls to avoid reallocating
+     */
+    void Update(const std::vector<NetworkStats>& stats, std::vector<InterfaceUsage>& out);
+
+    // Forget every baseline, e.g. after logging was switched off and on
+    void Reset();
+
+    size_t TrackedInterfaces() const { return m_previous.size(); }
+
+private:
+    struct Counters
+    {
+        ULONG64 bytesReceived;
+        ULONG64 bytesSent;
+        unsigned long long tick;    // Last Update that saw the interface
+    };
+
+    std::unordered_map<std::wstring, Counters> m_previous;
+    unsigned long long m_tick;
+};
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_USAGEDELTATRACKER_H
@@ -0,0 +1,24 @@
+// ============================================================================
+// File: Utf8Text.h
+// Description: UTF-8 and wide text conversion without Win32 calls
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#ifndef NETWORK_MONITOR_UTF8TEXT_H
+#define NETWORK_MONITOR_UTF8TEXT_H
+
+#include <string>
+#include <string_view>
+
+namespace NetworkMonitor
+{
+
+// For the text files NetworkMonitor reads and writes on any platform.
+// wchar_t may be UTF-16 (surrogate pairs) or UTF-32; malformed input,
+// either way, becomes U+FFFD.
+void AppendUtf8AsWide(std::wstring& out, std::string_view utf8);
+void AppendWideAsUtf8(std::string& out, std::wstring_view text);
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_UTF8TEXT_H
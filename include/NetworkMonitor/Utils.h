@@ -8,6 +8,7 @@
 #define NETWORK_MONITOR_UTILS_H
 
 #include "NetworkMonitor/Common.h"
+#include <atomic>
 #include <string>
 
 namespace NetworkMonitor
@@ -33,6 +34,8 @@ std::wstring FormatSpeed(double bytesPerSecond, SpeedUnit unit);
 std::wstring FormatBytes(ULONG64 bytes);
 
 std::wstring SpeedUnitToString(SpeedUnit unit);
+
+// A copy of LoadStringView (StringCatalog.h); hot paths take the view
 std::wstring LoadStringResource(UINT resourceId);
 
 // ============================================================================
@@ -68,9 +71,27 @@ double GetElapsedSeconds(DWORD start, DWORD end);
  * @return Error message string
  */
 std::wstring GetLastErrorString();
+
+// Prefer NM_LOG_DEBUG / NM_LOG_ERROR below, which skip building the message
 void LogDebug(const std::wstring& message);
 void LogError(const std::wstring& message);
 void SetDebugLoggingEnabled(bool enabled);
+
+// Inline so a disabled debug log costs one load and branch at the call site
+inline std::atomic<bool> g_debugLoggingEnabled(false);
+
+inline bool IsDebugLoggingEnabled()
+{
+    return g_debugLoggingEnabled.load(std::memory_order_relaxed);
+}
+
+// Send log lines to NetworkMonitor.binlog as deferred-format records
+// (decoded offline) instead of the text log
+void SetBinaryLoggingEnabled(bool enabled);
+
+// Size and age limits of the log files and how many archives to keep
+struct LogRotationOptions;
+void SetLogRotation(const LogRotationOptions& options);
 void ShowErrorMessage(const std::wstring& message, const std::wstring& title = L"Error");
 int ShowDarkMessageBox(HWND owner,
                        const std::wstring& message,
@@ -95,4 +116,43 @@ bool IsDarkThemeEnabled(const AppConfig& config);
 
 } // namespace NetworkMonitor
 
+// ============================================================================
+// LOGGING MACROS
+// ============================================================================
+
+// Lowest level compiled in. Build with
+// -DNM_MIN_LOG_LEVEL=NM_LOG_LEVEL_ERROR to leave debug logging out entirely.
+#define NM_LOG_LEVEL_DEBUG 0
+#define NM_LOG_LEVEL_ERROR 1
+#define NM_LOG_LEVEL_NONE 2
+
+#ifndef NM_MIN_LOG_LEVEL
+#define NM_MIN_LOG_LEVEL NM_LOG_LEVEL_DEBUG
+#endif
+
+// The message expression is evaluated only when the line is logged:
+//   NM_LOG_DEBUG(L"read " + std::to_wstring(rows) + L" rows");
+// A level below NM_MIN_LOG_LEVEL generates no code; the expression is still
+// compiled, so it cannot rot and its variables count as used.
+#define NM_LOG_DEBUG(message)                                       \
+    do                                                              \
+    {                                                               \
+        if constexpr (NM_MIN_LOG_LEVEL <= NM_LOG_LEVEL_DEBUG)       \
+        {                                                           \
+            if (::NetworkMonitor::IsDebugLoggingEnabled())          \
+            {                                                       \
+                ::NetworkMonitor::LogDebug(message);                \
+            }                                                       \
+        }                                                           \
+    } while (0)
+
+#define NM_LOG_ERROR(message)                                       \
+    do                                                              \
+    {                                                               \
+        if constexpr (NM_MIN_LOG_LEVEL <= NM_LOG_LEVEL_ERROR)       \
+        {                                                           \
+            ::NetworkMonitor::LogError(message);                    \
+        }                                                           \
+    } while (0)
+
 #endif // NETWORK_MONITOR_UTILS_H
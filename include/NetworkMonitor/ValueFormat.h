@@ -0,0 +1,62 @@
+// ============================================================================
+// File: ValueFormat.h
+// Description: Speed and byte-count text written into caller buffers
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#ifndef NETWORK_MONITOR_VALUEFORMAT_H
+#define NETWORK_MONITOR_VALUEFORMAT_H
+
+#include "NetworkMonitor/Common.h"
+#include <cstddef>
+
+namespace NetworkMonitor
+{
+
+// Room, terminator included, for any byte count and for speeds below
+// 10^20 of their unit; larger speeds need up to MAX_FORMATTED_VALUE_CHARS
+constexpr size_t FORMATTED_VALUE_CHARS = 32;
+constexpr size_t MAX_FORMATTED_VALUE_CHARS = 328;
+
+template <typename CharT>
+struct FormattedValue
+{
+    CharT text[FORMATTED_VALUE_CHARS];
+    size_t length;
+
+    FormattedValue()
+        : length(0)
+    {
+        text[0] = 0;
+    }
+
+    const CharT* c_str() const { return text; }
+};
+
+/**
+ * The text FormatSpeed / FormatBytes return ("1.23 MB/s", "512 B"),
+ * written with std::to_chars: no stream, no locale, no allocation.
+ *
+ * Writes a terminated string and returns its length. A buffer too small
+ * for the text gets an empty string and 0.
+ */
+size_t FormatSpeedTo(double bytesPerSecond, SpeedUnit unit, char* out, size_t capacity);
+size_t FormatSpeedTo(double bytesPerSecond, SpeedUnit unit, wchar_t* out, size_t capacity);
+size_t FormatBytesTo(ULONG64 bytes, char* out, size_t capacity);
+size_t FormatBytesTo(ULONG64 bytes, wchar_t* out, size_t capacity);
+
+template <typename CharT>
+void FormatSpeedTo(double bytesPerSecond, SpeedUnit unit, FormattedValue<CharT>& out)
+{
+    out.length = FormatSpeedTo(bytesPerSecond, unit, out.text, FORMATTED_VALUE_CHARS);
+}
+
+template <typename CharT>
+void FormatBytesTo(ULONG64 bytes, FormattedValue<CharT>& out)
+{
+    out.length = FormatBytesTo(bytes, out.text, FORMATTED_VALUE_CHARS);
+}
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_VALUEFORMAT_H
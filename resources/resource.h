@@ -143,6 +143,14 @@
 #define IDS_NOTIFICATION_CONNECTED_TITLE    483
 #define IDS_NOTIFICATION_CONNECTED_MSG      484
 #define IDS_SETTINGS_LABEL_CONNECTION_NOTIFY 485
+#define IDS_HISTORY_BUTTON_EXPORT       486
+#define IDS_HISTORY_EXPORT_DONE         487
+#define IDS_HISTORY_EXPORT_FAILED       488
+#define IDS_DASHBOARD_LABEL_CYCLE       489
+#define IDS_DASHBOARD_CYCLE_USAGE       490
+#define IDS_DASHBOARD_CYCLE_USAGE_QUOTA 491
+#define IDS_DASHBOARD_CYCLE_PROJECTION  492
+#define IDS_DASHBOARD_CYCLE_CAP         493
 
 // ============================================================================
 // CONTROL IDS (for dialogs)
@@ -197,6 +205,13 @@
 #define IDC_PING_TARGET_EDIT            546
 #define IDC_PING_INTERVAL_COMBO         547
 #define IDC_HOTKEY_COMBO                548
+#define IDC_HISTORY_EXPORT              549
+#define IDC_SETTINGS_GROUP_BILLING      550
+#define IDC_BILLING_START_DAY_COMBO     551
+#define IDC_BILLING_QUOTA_EDIT          552
+#define IDC_DASHBOARD_LABEL_CYCLE       553
+#define IDC_CYCLE_USAGE                 554
+#define IDC_CYCLE_PROJECTION            555
 
 // ============================================================================
 // STANDARD DIALOG IDS
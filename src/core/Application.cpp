@@ -7,10 +7,13 @@
 #include "NetworkMonitor/Application.h"
 #include "NetworkMonitor/Utils.h"
 #include "NetworkMonitor/HistoryLogger.h"
+#include "NetworkMonitor/LogRotation.h"
 #include "NetworkMonitor/SettingsDialog.h"
+#include "NetworkMonitor/StringCatalog.h"
 #include "NetworkMonitor/DashboardDialog.h"
 #include "NetworkMonitor/HistoryDialog.h"
 #include "NetworkMonitor/ThemeHelper.h"
+#include "NetworkMonitor/Units.h"
 #include "../../resources/resource.h"
 #include <windowsx.h>
 #include <commctrl.h>
@@ -18,12 +21,64 @@
 namespace NetworkMonitor
 {
 
+namespace
+{
+    HistoryRetentionPolicy RetentionPolicyFromConfig(const AppConfig& config)
+    {
+        HistoryRetentionPolicy policy;
+        policy.rawDays = config.historyRawDays;
+        policy.minuteDays = config.historyMinuteDays;
+        policy.hourDays = config.historyHourDays;
+        policy.maxSizeMB = config.historyMaxSizeMB;
+        return policy;
+    }
+
+    HistoryCoalescingOptions CoalescingFromConfig(const AppConfig& config)
+    {
+        HistoryCoalescingOptions options;
+        options.rateTolerance = config.historyCoalescePercent / 100.0;
+        return options;
+    }
+
+    LogRotationOptions LogRotationFromConfig(const AppConfig& config)
+    {
+        LogRotationOptions options;
+        options.maxFileBytes = UnitCast<Bytes>(DataSize<Mebibytes, unsigned long long>(config.logMaxSizeMB)).Count();
+        options.maxFileAgeSeconds = config.logMaxAgeDays * 24 * 60 * 60;
+        options.keepFiles = config.logKeepFiles;
+        return options;
+    }
+
+    // NetworkMonitor.ini next to the executable, if there is one; settings
+    // then live in it instead of the registry (portable mode)
+    std::wstring FindPortableConfigFile()
+    {
+        wchar_t exePath[MAX_PATH] = {0};
+        if (!GetModuleFileNameW(nullptr, exePath, MAX_PATH))
+        {
+            return std::wstring();
+        }
+
+        wchar_t* lastSlash = wcsrchr(exePath, L'\\');
+        if (lastSlash)
+        {
+            *(lastSlash + 1) = L'\0';
+        }
+
+        std::wstring path = exePath;
+        path += CONFIG_FILE_NAME;
+        DWORD attributes = GetFileAttributesW(path.c_str());
+        if (attributes == INVALID_FILE_ATTRIBUTES || (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+        {
+            return std::wstring();
+        }
+        return path;
+    }
+}
+
 Application::Application()
     : m_hwnd(nullptr)
     , m_hInstance(nullptr)
-    , m_prevTotalBytesDown(0)
-    , m_prevTotalBytesUp(0)
-    , m_prevTotalsValid(false)
     , m_wasConnected(true)
     , m_initialized(false)
 {
@@ -43,7 +98,7 @@ bool Application::Initialize(HINSTANCE hInstance)
 
     m_hInstance = hInstance;
 
-    LogDebug(L"Application::Initialize: starting");
+    NM_LOG_DEBUG(L"Application::Initialize: starting");
 
     // Initialize common controls
     INITCOMMONCONTROLSEX icc = {};
@@ -69,14 +124,27 @@ bool Application::Initialize(HINSTANCE hInstance)
     }
 
     // Create and initialize components
-    m_pConfigManager = std::make_unique<ConfigManager>();
-    if (!LoadConfig())
-    {
-        // Use default config if load fails
-        m_config = AppConfig();
+    std::wstring configFile = FindPortableConfigFile();
+    m_pConfigManager = configFile.empty() ? std::make_unique<ConfigManager>()
+                                          : std::make_unique<ConfigManager>(configFile);
+    // The store holds the defaults if the load fails
+    LoadConfig();
+    const AppConfig& config = m_configStore.Current();
+
+    if (!configFile.empty())
+    {
+        // Edits to the file apply without a restart
+        HWND hwnd = m_hwnd;
+        m_pConfigWatcher = std::make_unique<ConfigFileWatcher>();
+        if (!m_pConfigWatcher->Start(configFile, [hwnd]() { PostMessageW(hwnd, WM_CONFIG_FILE_CHANGED, 0, 0); }))
+        {
+            m_pConfigWatcher.reset();
+        }
     }
 
-    SetDebugLoggingEnabled(m_config.debugLogging);
+    SetDebugLoggingEnabled(config.debugLogging);
+    SetBinaryLoggingEnabled(config.binaryDebugLog);
+    SetLogRotation(LogRotationFromConfig(config));
 
     // Apply UI language preference (for STRINGTABLE resources)
     ApplyLanguageFromConfig();
@@ -88,10 +156,13 @@ bool Application::Initialize(HINSTANCE hInstance)
     ThemeHelper::AllowDarkModeForApp(systemDark);
 
     // Initialize history logger with auto-trim settings
-    if (m_config.historyAutoTrimDays > 0)
+    if (config.historyAutoTrimDays > 0)
     {
-        HistoryLogger::Instance().TrimToRecentDays(m_config.historyAutoTrimDays);
+        HistoryLogger::Instance().TrimToRecentDays(config.historyAutoTrimDays);
     }
+    HistoryLogger::Instance().SetBillingCycleStartDay(config.billingCycleStartDay);
+    HistoryLogger::Instance().SetRetentionPolicy(RetentionPolicyFromConfig(config));
+    HistoryLogger::Instance().SetCoalescingOptions(CoalescingFromConfig(config));
 
     // Create and initialize network monitor
     m_pNetworkMonitor = std::make_unique<NetworkMonitorClass>();
@@ -111,7 +182,7 @@ bool Application::Initialize(HINSTANCE hInstance)
 
     // Set tray icon callbacks and configuration source
     m_pTrayIcon->SetMenuCallback([this](UINT menuId) { OnMenuCommand(menuId); });
-    m_pTrayIcon->SetConfigSource(&m_config);
+    m_pTrayIcon->SetConfigSource(&m_configStore);
     m_pTrayIcon->SetOverlayVisibilityProvider([this]() -> bool {
         return m_pTaskbarOverlay != nullptr && m_pTaskbarOverlay->IsVisible();
     });
@@ -132,31 +203,34 @@ bool Application::Initialize(HINSTANCE hInstance)
         // Show overlay by default
         m_pTaskbarOverlay->Show(true);
 
-        m_pTaskbarOverlay->SetDarkTheme(m_config.darkTheme);
+        m_pTaskbarOverlay->SetDarkTheme(config.darkTheme);
     }
 
     // Create and initialize ping monitor
     m_pPingMonitor = std::make_unique<PingMonitor>();
-    if (!m_pPingMonitor->Initialize(m_config.pingTarget))
+    if (!m_pPingMonitor->Initialize(config.pingTarget, config.pingIntervalMs))
     {
-        LogDebug(L"Application::Initialize: PingMonitor init failed, continuing without ping");
+        NM_LOG_DEBUG(L"Application::Initialize: PingMonitor init failed, continuing without ping");
         m_pPingMonitor.reset();
     }
 
     // Start timer for network monitoring updates
-    SetTimer(m_hwnd, TIMER_UPDATE_NETWORK, m_config.updateInterval, nullptr);
+    SetTimer(m_hwnd, TIMER_UPDATE_NETWORK, config.updateInterval, nullptr);
 
     // Start timer for ping (use configured interval)
     if (m_pPingMonitor)
     {
-        SetTimer(m_hwnd, TIMER_PING, m_config.pingIntervalMs, nullptr);
+        SetTimer(m_hwnd, TIMER_PING, config.pingIntervalMs, nullptr);
     }
 
     // Register hotkeys
     RegisterHotkeys();
 
+    // Later changes reach only the components whose settings changed
+    SubscribeToConfigChanges();
+
     m_initialized = true;
-    LogDebug(L"Application::Initialize: succeeded");
+    NM_LOG_DEBUG(L"Application::Initialize: succeeded");
     return true;
 }
 
@@ -185,7 +259,10 @@ void Application::Cleanup()
         return;
     }
 
-    LogDebug(L"Application::Cleanup: starting");
+    NM_LOG_DEBUG(L"Application::Cleanup: starting");
+
+    // Stop watching the settings file before the window it posts to goes
+    m_pConfigWatcher.reset();
 
     // Unregister hotkeys
     UnregisterHotkeys();
@@ -222,6 +299,10 @@ void Application::Cleanup()
     // Cleanup config manager
     m_pConfigManager.reset();
 
+    // Commit queued samples and stop the history threads now; left to the
+    // static destructor they could log into a diagnostic log already gone
+    HistoryLogger::Instance().Shutdown();
+
     // Destroy main window
     if (m_hwnd)
     {
@@ -230,7 +311,7 @@ void Application::Cleanup()
     }
 
     m_initialized = false;
-    LogDebug(L"Application::Cleanup: completed");
+    NM_LOG_DEBUG(L"Application::Cleanup: completed");
 }
 
 bool Application::LoadConfig()
@@ -240,24 +321,32 @@ bool Application::LoadConfig()
         return false;
     }
 
-    return m_pConfigManager->LoadConfig(m_config);
+    AppConfig config;
+    if (!m_pConfigManager->LoadConfig(config))
+    {
+        return false;
+    }
+    m_configStore.Publish(config);
+    return true;
 }
 
-bool Application::SaveConfig()
+bool Application::SaveConfig(const AppConfig& config)
 {
     if (!m_pConfigManager)
     {
         return false;
     }
 
-    return m_pConfigManager->SaveConfig(m_config);
+    bool saved = m_pConfigManager->SaveConfig(config);
+    m_configStore.Publish(config);
+    return saved;
 }
 
 void Application::ApplyLanguageFromConfig()
 {
     LANGID langId = 0;
 
-    switch (m_config.language)
+    switch (m_configStore.Current().language)
     {
     case AppLanguage::English:
         langId = MAKELANGID(LANG_ENGLISH, SUBLANG_ENGLISH_US);
@@ -277,6 +366,9 @@ void Application::ApplyLanguageFromConfig()
     {
         SetThreadUILanguage(langId);
     }
+
+    // Strings are loaded once per language, not on every use
+    ReloadStringCatalog(GetThreadUILanguage());
 }
 
 void Application::ShowSettingsDialog()
@@ -286,9 +378,6 @@ void Application::ShowSettingsDialog()
         return;
     }
 
-    // Keep a copy of current config to detect changes after dialog
-    AppConfig oldConfig = m_config;
-
     SettingsDialog dlg;
     if (!dlg.Show(m_hwnd, m_pConfigManager.get(), m_pNetworkMonitor.get()))
     {
@@ -296,66 +385,133 @@ void Application::ShowSettingsDialog()
         return;
     }
 
-    // Reload config from persistent storage
-    if (!LoadConfig())
+    // Reload config from persistent storage; subscribers apply what changed
+    ConfigChanges changes;
+    AppConfig config;
+    if (m_pConfigManager->LoadConfig(config))
     {
-        // If reload fails, keep old config and exit
-        m_config = oldConfig;
-        return;
+        changes = m_configStore.Publish(config);
     }
 
-    SetDebugLoggingEnabled(m_config.debugLogging);
-
-    // Keep process-level dark mode in sync with the current system app
-    // theme so that shell-provided menus remain consistent with Windows.
-    ThemeHelper::AllowDarkModeForApp(ThemeHelper::IsSystemInDarkMode());
-
-    // Propagate updated config to tray icon
-    if (m_pTrayIcon)
+    if (changes.Any())
     {
-        m_pTrayIcon->SetConfigSource(&m_config);
+        // Force immediate refresh so UI reflects new settings
+        OnTimer();
     }
+}
 
-    if (m_pTaskbarOverlay)
+void Application::OnConfigFileChanged()
+{
+    AppConfig config;
+    if (!m_pConfigManager || !m_pConfigManager->LoadConfig(config))
     {
-        m_pTaskbarOverlay->SetDarkTheme(m_config.darkTheme);
+        return;
     }
 
-    // Apply side-effects similar to ApplySettingsFromDialog in main.cpp
-    bool needsTimerUpdate = (m_config.updateInterval != oldConfig.updateInterval);
-    bool historyChanged = (m_config.historyAutoTrimDays != oldConfig.historyAutoTrimDays);
-    bool languageChanged = (m_config.language != oldConfig.language);
-
-    if (needsTimerUpdate)
+    // Our own saves come back through the watcher too, and change nothing
+    ConfigChanges changes = m_configStore.Publish(config);
+    if (changes.Any())
     {
-        KillTimer(m_hwnd, TIMER_UPDATE_NETWORK);
-        SetTimer(m_hwnd, TIMER_UPDATE_NETWORK, m_config.updateInterval, nullptr);
+        NM_LOG_DEBUG(L"Application::OnConfigFileChanged: applied edited settings file");
+        OnTimer();
     }
+}
 
-    if (historyChanged && m_config.historyAutoTrimDays > 0)
-    {
-        HistoryLogger::Instance().TrimToRecentDays(m_config.historyAutoTrimDays);
-    }
+void Application::SubscribeToConfigChanges()
+{
+    // Only the sampler restarts when the interval changes
+    m_configStore.Subscribe(ConfigField::UpdateInterval, [this](const AppConfig&, const AppConfig& config, ConfigChanges) {
+        KillTimer(m_hwnd, TIMER_UPDATE_NETWORK);
+        SetTimer(m_hwnd, TIMER_UPDATE_NETWORK, config.updateInterval, nullptr);
+    });
 
-    if (languageChanged)
-    {
+    m_configStore.Subscribe(ConfigField::PingTarget | ConfigField::PingIntervalMs,
+                            [this](const AppConfig&, const AppConfig& config, ConfigChanges changes) {
+        if (!m_pPingMonitor)
+        {
+            return;
+        }
+        if (changes.Contains(ConfigField::PingTarget))
+        {
+            m_pPingMonitor->SetTarget(config.pingTarget);
+        }
+        if (changes.Contains(ConfigField::PingIntervalMs))
+        {
+            m_pPingMonitor->SetInterval(config.pingIntervalMs);
+            KillTimer(m_hwnd, TIMER_PING);
+            SetTimer(m_hwnd, TIMER_PING, config.pingIntervalMs, nullptr);
+        }
+    });
+
+    m_configStore.Subscribe(ConfigField::DebugLogging | ConfigField::BinaryDebugLog | ConfigField::LogMaxSizeMB |
+                                ConfigField::LogMaxAgeDays | ConfigField::LogKeepFiles,
+                            [](const AppConfig&, const AppConfig& config, ConfigChanges) {
+        SetDebugLoggingEnabled(config.debugLogging);
+        SetBinaryLoggingEnabled(config.binaryDebugLog);
+        SetLogRotation(LogRotationFromConfig(config));
+    });
+
+    m_configStore.Subscribe(ConfigField::DarkTheme | ConfigField::ThemeMode,
+                            [this](const AppConfig&, const AppConfig& config, ConfigChanges) {
+        // Keep process-level dark mode in sync with the current system app
+        // theme so that shell-provided menus remain consistent with Windows.
+        ThemeHelper::AllowDarkModeForApp(ThemeHelper::IsSystemInDarkMode());
+        if (m_pTaskbarOverlay)
+        {
+            m_pTaskbarOverlay->SetDarkTheme(config.darkTheme);
+        }
+    });
+
+    m_configStore.Subscribe(ConfigField::HistoryAutoTrimDays | ConfigField::BillingCycleStartDay |
+                                ConfigField::HistoryRawDays | ConfigField::HistoryMinuteDays |
+                                ConfigField::HistoryHourDays | ConfigField::HistoryMaxSizeMB |
+                                ConfigField::HistoryCoalescePercent,
+                            [](const AppConfig&, const AppConfig& config, ConfigChanges changes) {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        if (changes.Contains(ConfigField::HistoryAutoTrimDays) && config.historyAutoTrimDays > 0)
+        {
+            logger.TrimToRecentDays(config.historyAutoTrimDays);
+        }
+        if (changes.Contains(ConfigField::BillingCycleStartDay))
+        {
+            logger.SetBillingCycleStartDay(config.billingCycleStartDay);
+        }
+        if (changes.Intersects(ConfigField::HistoryRawDays | ConfigField::HistoryMinuteDays |
+                               ConfigField::HistoryHourDays | ConfigField::HistoryMaxSizeMB))
+        {
+            // Applied by the logger's idle maintenance, a chunk at a time
+            logger.SetRetentionPolicy(RetentionPolicyFromConfig(config));
+        }
+        if (changes.Contains(ConfigField::HistoryCoalescePercent))
+        {
+            logger.SetCoalescingOptions(CoalescingFromConfig(config));
+        }
+    });
+
+    m_configStore.Subscribe(ConfigField::Language, [this](const AppConfig&, const AppConfig&, ConfigChanges) {
         ApplyLanguageFromConfig();
-    }
+    });
 
-    // Force immediate refresh so UI reflects new settings
-    OnTimer();
+    m_configStore.Subscribe(ConfigField::HotkeyModifier | ConfigField::HotkeyKey,
+                            [this](const AppConfig&, const AppConfig&, ConfigChanges) {
+        UnregisterHotkeys();
+        RegisterHotkeys();
+    });
 }
 
 void Application::ShowDashboardDialog()
 {
+    // Held for the dialog's lifetime: its message loop may publish
+    ConfigSnapshot config = m_configStore.Snapshot();
     DashboardDialog dlg;
-    dlg.Show(m_hwnd, m_pNetworkMonitor.get(), &m_config);
+    dlg.Show(m_hwnd, m_pNetworkMonitor.get(), config.get());
 }
 
 void Application::ShowHistoryDialog()
 {
+    ConfigSnapshot config = m_configStore.Snapshot();
     HistoryDialog dlg;
-    dlg.Show(m_hwnd, &m_config);
+    dlg.Show(m_hwnd, config.get());
 }
 
 void Application::ShowAboutDialog()
@@ -385,7 +541,8 @@ void Application::ShowAboutDialog()
     message += L"\n\n";
     message += body;
 
-    ShowDarkMessageBox(m_hwnd, message, title, MB_OK | MB_ICONINFORMATION, m_config.darkTheme);
+    ShowDarkMessageBox(m_hwnd, message, title, MB_OK | MB_ICONINFORMATION,
+                       m_configStore.Current().darkTheme);
 }
 
 void Application::OnTaskbarOverlayRightClick()
@@ -399,32 +556,29 @@ void Application::OnTaskbarOverlayRightClick()
 
 void Application::OnMenuCommand(UINT menuId)
 {
+    // Menu choices edit a copy; subscribers apply the saved result
+    AppConfig config = m_configStore.Current();
+
     switch (menuId)
     {
         case IDM_UPDATE_FAST:
-            m_config.updateInterval = UPDATE_INTERVAL_FAST;
-            SaveConfig();
-            KillTimer(m_hwnd, TIMER_UPDATE_NETWORK);
-            SetTimer(m_hwnd, TIMER_UPDATE_NETWORK, m_config.updateInterval, nullptr);
+            config.updateInterval = UPDATE_INTERVAL_FAST;
+            SaveConfig(config);
             break;
 
         case IDM_UPDATE_NORMAL:
-            m_config.updateInterval = UPDATE_INTERVAL_NORMAL;
-            SaveConfig();
-            KillTimer(m_hwnd, TIMER_UPDATE_NETWORK);
-            SetTimer(m_hwnd, TIMER_UPDATE_NETWORK, m_config.updateInterval, nullptr);
+            config.updateInterval = UPDATE_INTERVAL_NORMAL;
+            SaveConfig(config);
             break;
 
         case IDM_UPDATE_SLOW:
-            m_config.updateInterval = UPDATE_INTERVAL_SLOW;
-            SaveConfig();
-            KillTimer(m_hwnd, TIMER_UPDATE_NETWORK);
-            SetTimer(m_hwnd, TIMER_UPDATE_NETWORK, m_config.updateInterval, nullptr);
+            config.updateInterval = UPDATE_INTERVAL_SLOW;
+            SaveConfig(config);
             break;
 
         case IDM_AUTOSTART:
-            m_config.autoStart = !m_config.autoStart;
-            SaveConfig();
+            config.autoStart = !config.autoStart;
+            SaveConfig(config);
             break;
 
         case IDM_SHOW_TASKBAR_OVERLAY:
@@ -465,10 +619,16 @@ void Application::OnTimer()
 
     NetworkStats stats = GetCurrentStatsForConfig();
 
-    if (m_config.enableLogging)
+    if (m_configStore.Current().enableLogging)
     {
-        // History logging: record per-interval usage into SQLite
-        LogHistorySample(stats);
+        // History logging: record per-interval usage of every interface
+        LogHistorySamples();
+    }
+    else
+    {
+        // Logging restarts from fresh baselines rather than recording
+        // everything transferred while it was off
+        m_usageDeltas.Reset();
     }
 
     // Update tray icon
@@ -484,11 +644,12 @@ void Application::OnTimer()
 NetworkStats Application::GetCurrentStatsForConfig()
 {
     NetworkStats stats;
-    bool useSpecificInterface = !m_config.selectedInterface.empty();
+    const AppConfig& config = m_configStore.Current();
+    bool useSpecificInterface = !config.selectedInterface.empty();
     if (useSpecificInterface)
     {
         NetworkStats selectedStats;
-        if (m_pNetworkMonitor->GetInterfaceStats(m_config.selectedInterface, selectedStats))
+        if (m_pNetworkMonitor->GetInterfaceStats(config.selectedInterface, selectedStats))
         {
             stats = selectedStats;
         }
@@ -505,62 +666,22 @@ NetworkStats Application::GetCurrentStatsForConfig()
     return stats;
 }
 
-void Application::LogHistorySample(const NetworkStats& stats)
+void Application::LogHistorySamples()
 {
-    unsigned long long totalDown = static_cast<unsigned long long>(stats.bytesReceived);
-    unsigned long long totalUp = static_cast<unsigned long long>(stats.bytesSent);
-
-    if (!m_prevTotalsValid)
-    {
-        m_prevTotalBytesDown = totalDown;
-        m_prevTotalBytesUp = totalUp;
-        m_prevTotalsValid = true;
-        return;
-    }
-
-    unsigned long long deltaDown = 0;
-    unsigned long long deltaUp = 0;
-
-    if (totalDown >= m_prevTotalBytesDown)
-    {
-        deltaDown = totalDown - m_prevTotalBytesDown;
-    }
-    // else: counters decreased -> treat as reset, don't accumulate
-
-    if (totalUp >= m_prevTotalBytesUp)
-    {
-        deltaUp = totalUp - m_prevTotalBytesUp;
-    }
-    // else: counters decreased -> treat as reset
-
-    if (deltaDown > 0 || deltaUp > 0)
+    // One row per interface; the aggregate is their sum, which is what
+    // queries without an interface filter return
+    m_usageDeltas.Update(m_pNetworkMonitor->GetAllStats(), m_tickUsage);
+    if (!m_tickUsage.empty())
     {
-        std::wstring ifaceName = stats.interfaceName;
-        if (ifaceName.empty())
-        {
-            ifaceName = LoadStringResource(IDS_ALL_INTERFACES);
-            if (ifaceName.empty())
-            {
-                ifaceName = L"All Interfaces";
-            }
-        }
-
-        HistoryLogger::Instance().AppendSample(
-            ifaceName,
-            deltaDown,
-            deltaUp
-        );
+        HistoryLogger::Instance().AppendSamples(m_tickUsage);
     }
-
-    m_prevTotalBytesDown = totalDown;
-    m_prevTotalBytesUp = totalUp;
 }
 
 void Application::UpdateTrayIcon(const NetworkStats& stats)
 {
     if (m_pTrayIcon)
     {
-        m_pTrayIcon->UpdateTooltip(stats, m_config.displayUnit);
+        m_pTrayIcon->UpdateTooltip(stats, m_configStore.Current().displayUnit);
         m_pTrayIcon->UpdateIcon(stats.currentDownloadSpeed, stats.currentUploadSpeed);
     }
 }
@@ -572,7 +693,7 @@ void Application::UpdateTaskbarOverlay(const NetworkStats& stats)
         m_pTaskbarOverlay->UpdateSpeed(
             stats.currentDownloadSpeed,
             stats.currentUploadSpeed,
-            m_config.displayUnit
+            m_configStore.Current().displayUnit
         );
     }
 }
@@ -638,6 +759,12 @@ LRESULT CALLBACK Application::InstanceWindowProc(HWND hwnd, UINT message, WPARAM
             return 0;
         }
 
+        case WM_CONFIG_FILE_CHANGED:
+        {
+            OnConfigFileChanged();
+            return 0;
+        }
+
         case WM_COMMAND:
         {
             // Handle menu commands
@@ -718,14 +845,15 @@ void Application::RegisterHotkeys()
     }
 
     // Register configurable hotkey to toggle overlay
-    UINT modifiers = m_config.hotkeyModifier | MOD_NOREPEAT;
-    if (!RegisterHotKey(m_hwnd, HOTKEY_TOGGLE_OVERLAY, modifiers, m_config.hotkeyKey))
+    const AppConfig& config = m_configStore.Current();
+    UINT modifiers = config.hotkeyModifier | MOD_NOREPEAT;
+    if (!RegisterHotKey(m_hwnd, HOTKEY_TOGGLE_OVERLAY, modifiers, config.hotkeyKey))
     {
-        LogDebug(L"Application::RegisterHotkeys: Failed to register hotkey");
+        NM_LOG_DEBUG(L"Application::RegisterHotkeys: Failed to register hotkey");
     }
     else
     {
-        LogDebug(L"Application::RegisterHotkeys: Registered hotkey");
+        NM_LOG_DEBUG(L"Application::RegisterHotkeys: Registered hotkey");
     }
 }
 
@@ -737,7 +865,7 @@ void Application::UnregisterHotkeys()
     }
 
     UnregisterHotKey(m_hwnd, HOTKEY_TOGGLE_OVERLAY);
-    LogDebug(L"Application::UnregisterHotkeys: Unregistered hotkeys");
+    NM_LOG_DEBUG(L"Application::UnregisterHotkeys: Unregistered hotkeys");
 }
 
 void Application::OnHotkey(int hotkeyId)
@@ -748,7 +876,7 @@ void Application::OnHotkey(int hotkeyId)
         {
             bool isVisible = m_pTaskbarOverlay->IsVisible();
             m_pTaskbarOverlay->Show(!isVisible);
-            LogDebug(L"Application::OnHotkey: Toggled overlay visibility");
+            NM_LOG_DEBUG(L"Application::OnHotkey: Toggled overlay visibility");
         }
     }
 }
@@ -770,7 +898,7 @@ void Application::OnPingTimer()
 
 void Application::CheckConnectionStatus(bool hasActiveInterface)
 {
-    if (!m_config.enableConnectionNotification)
+    if (!m_configStore.Current().enableConnectionNotification)
     {
         m_wasConnected = hasActiveInterface;
         return;
@@ -787,7 +915,7 @@ void Application::CheckConnectionStatus(bool hasActiveInterface)
             if (msg.empty()) msg = L"No active network connection";
             m_pTrayIcon->ShowBalloonNotification(title, msg);
         }
-        LogDebug(L"Application::CheckConnectionStatus: Network disconnected");
+        NM_LOG_DEBUG(L"Application::CheckConnectionStatus: Network disconnected");
     }
     else if (!m_wasConnected && hasActiveInterface)
     {
@@ -800,7 +928,7 @@ void Application::CheckConnectionStatus(bool hasActiveInterface)
             if (msg.empty()) msg = L"Network connection restored";
             m_pTrayIcon->ShowBalloonNotification(title, msg);
         }
-        LogDebug(L"Application::CheckConnectionStatus: Network connected");
+        NM_LOG_DEBUG(L"Application::CheckConnectionStatus: Network connected");
     }
 
     m_wasConnected = hasActiveInterface;
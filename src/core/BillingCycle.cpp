@@ -0,0 +1,202 @@
+// ============================================================================
+// File: BillingCycle.cpp
+// Description: Billing cycle boundaries, quotas and end-of-cycle projection
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#include "NetworkMonitor/BillingCycle.h"
+#include "NetworkMonitor/LocalCalendar.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace NetworkMonitor
+{
+
+namespace
+{
+    // Local midnight starting the cycle in the given month; month may be
+    // one outside 0..11 and is normalized first.
+    std::time_t CycleStartInMonth(int tmYear, int month, int startDay)
+    {
+        if (month < 0)
+        {
+            month += 12;
+            --tmYear;
+        }
+        else if (month > 11)
+        {
+            month -= 12;
+            ++tmYear;
+        }
+
+        std::tm local = {};
+        local.tm_year = tmYear;
+        local.tm_mon = month;
+        local.tm_mday = (std::min)(startDay, GetDaysInMonth(tmYear + 1900, month));
+        local.tm_isdst = -1;   // Let mktime decide whether DST applies that day
+        return std::mktime(&local);
+    }
+
+    int ClampStartDay(int startDay)
+    {
+        return (std::max)(1, (std::min)(startDay, MAX_BILLING_CYCLE_START_DAY));
+    }
+}
+
+bool GetBillingPeriod(std::time_t t, int startDay, BillingPeriod& out)
+{
+    startDay = ClampStartDay(startDay);
+
+    std::shared_ptr<const LocalCalendar> calendar = LocalCalendar::Shared(t);
+    if (calendar && calendar->Covers(t))
+    {
+        int month = calendar->MonthIndex(t);
+        std::time_t start = calendar->DayOfMonthStart(month, startDay);
+        if (t < start)
+        {
+            --month;
+            start = calendar->DayOfMonthStart(month, startDay);
+        }
+
+        std::time_t end = calendar->DayOfMonthStart(month + 1, startDay);
+        if (start != static_cast<std::time_t>(-1) && end != static_cast<std::time_t>(-1))
+        {
+            out.start = start;
+            out.end = end;
+            return true;
+        }
+        // First or last month of the table: ask the CRT
+    }
+
+    std::tm local = {};
+    if (localtime_s(&local, &t) != 0)
+    {
+        return false;
+    }
+
+    // The cycle starting this month, or last month's if t is before it
+    int month = local.tm_mon;
+    std::time_t start = CycleStartInMonth(local.tm_year, month, startDay);
+    if (start != static_cast<std::time_t>(-1) && t < start)
+    {
+        --month;
+        start = CycleStartInMonth(local.tm_year, month, startDay);
+    }
+
+    std::time_t end = CycleStartInMonth(local.tm_year, month + 1, startDay);
+    if (start == static_cast<std::time_t>(-1) || end == static_cast<std::time_t>(-1))
+    {
+        return false;
+    }
+
+    out.start = start;
+    out.end = end;
+    return true;
+}
+
+BillingCycleCache::BillingCycleCache(int startDay)
+    : m_startDay(ClampStartDay(startDay))
+    , m_valid(false)
+{
+}
+
+void BillingCycleCache::SetStartDay(int startDay)
+{
+    m_startDay = ClampStartDay(startDay);
+    m_valid = false;
+}
+
+std::time_t BillingCycleCache::CycleStart(std::time_t t)
+{
+    if (!m_valid || t < m_period.start || t >= m_period.end)
+    {
+        m_valid = GetBillingPeriod(t, m_startDay, m_period);
+        if (!m_valid)
+        {
+            return static_cast<std::time_t>(-1);
+        }
+    }
+    return m_period.start;
+}
+
+void ProjectBillingUsage(BillingStatus& status, const double* hourlyProfile)
+{
+    const unsigned long long used = status.bytesDown + status.bytesUp;
+    const unsigned long long quota = status.quotaBytes;
+    const std::time_t now = (std::max)(status.period.start, (std::min)(status.asOf, status.period.end));
+    const std::time_t end = status.period.end;
+
+    status.projectedLinear = used;
+    status.projectedWeighted = used;
+    status.capReachedLinear = 0;
+    status.capReachedWeighted = 0;
+
+    bool capOpen = (quota > 0 && used < quota);
+    if (quota > 0 && !capOpen)
+    {
+        status.capReachedLinear = status.asOf;
+        status.capReachedWeighted = status.asOf;
+    }
+
+    double elapsed = static_cast<double>(now - status.period.start);
+    double rate = (elapsed > 0.0) ? static_cast<double>(used) / elapsed : 0.0;
+    double left = static_cast<double>(end - now);
+    status.projectedLinear = used + static_cast<unsigned long long>(rate * left);
+
+    if (capOpen && rate > 0.0)
+    {
+        double seconds = static_cast<double>(quota - used) / rate;
+        if (seconds < left)
+        {
+            status.capReachedLinear = now + static_cast<std::time_t>(std::ceil(seconds));
+        }
+    }
+
+    if (!hourlyProfile)
+    {
+        status.projectedWeighted = status.projectedLinear;
+        status.capReachedWeighted = status.capReachedLinear;
+        return;
+    }
+
+    // Walk the rest of the cycle one local clock hour at a time. Slices end
+    // on local hour boundaries, so DST days get 23 or 25 of them and zones
+    // with half-hour offsets stay aligned.
+    double added = 0.0;
+    std::time_t t = now;
+    while (t < end)
+    {
+        std::tm local = {};
+        if (localtime_s(&local, &t) != 0)
+        {
+            break;
+        }
+
+        std::time_t sliceEnd = t + (60 - local.tm_min) * 60 - local.tm_sec;
+        sliceEnd = (std::min)(sliceEnd, end);
+
+        double seconds = static_cast<double>(sliceEnd - t);
+        double bytes = hourlyProfile[local.tm_hour] * seconds / 3600.0;
+
+        if (capOpen && status.capReachedWeighted == 0 && bytes > 0.0 &&
+            static_cast<double>(used) + added + bytes >= static_cast<double>(quota))
+        {
+            double needed = static_cast<double>(quota - used) - added;
+            status.capReachedWeighted = t + static_cast<std::time_t>(std::ceil(seconds * needed / bytes));
+        }
+
+        added += bytes;
+        t = sliceEnd;
+    }
+
+    status.projectedWeighted = used + static_cast<unsigned long long>(added);
+}
+
+unsigned long long GetBillingQuota(const AppConfig& config, const std::wstring& interfaceName)
+{
+    auto it = config.billingQuotas.find(interfaceName);
+    return (it != config.billingQuotas.end()) ? it->second : 0;
+}
+
+} // namespace NetworkMonitor
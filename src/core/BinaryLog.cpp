@@ -0,0 +1,959 @@
+// ============================================================================
+// File: BinaryLog.cpp
+// Description: Deferred-formatting binary log records and their decoder
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#include "NetworkMonitor/BinaryLog.h"
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+
+namespace NetworkMonitor
+{
+
+struct BinaryLogThreadBuffer
+{
+    std::unique_ptr<unsigned char[]> data;
+    size_t mask;
+
+    // The owning thread advances head, the writer thread tail
+    alignas(64) std::atomic<unsigned long long> head;
+    alignas(64) std::atomic<unsigned long long> tail;
+    std::atomic<bool> retired;      // Owning thread has exited
+    std::atomic<bool> closed;       // The log is gone
+
+    explicit BinaryLogThreadBuffer(size_t bytes)
+        : data(new unsigned char[bytes])
+        , mask(bytes - 1)
+        , head(0)
+        , tail(0)
+        , retired(false)
+        , closed(false)
+    {
+    }
+};
+
+namespace
+{
+    // File layout: a sequence of [u8 tag][u32 body bytes][body], starting
+    // with a header each time the writer (re)opens the file. Format and
+    // interned strings are defined once per session before first use.
+    constexpr unsigned char TAG_HEADER = 0;     // "NMBLOG", u16 version
+    constexpr unsigned char TAG_FORMAT = 1;     // u64 id, UTF-8 text
+    constexpr unsigned char TAG_STRING = 2;     // u64 key, UTF-8 text
+    constexpr unsigned char TAG_RECORD = 3;     // u8 level, u8 argc, u64 time, u64 format id, args
+    constexpr unsigned char TAG_DROPPED = 4;    // u64 time, u64 count
+
+    constexpr char FILE_MAGIC[6] = { 'N', 'M', 'B', 'L', 'O', 'G' };
+    constexpr unsigned short FILE_VERSION = 1;
+    constexpr size_t FILE_RECORD_PREFIX = 5;
+
+    // Ring record: u32 size, u8 level, u8 argc, u16 unused, u64 time,
+    // u64 format id, format text pointer (u64), then the arguments as in the file
+    constexpr size_t RING_RECORD_HEADER = 32;
+
+    constexpr size_t MAX_INLINE_TEXT = 0xFFFF;
+    constexpr size_t MAX_ARGUMENTS = 0xFF;
+
+    constexpr size_t WRITE_BATCH_BYTES = 64 * 1024;
+    constexpr size_t READ_CHUNK_BYTES = 1024 * 1024;
+    constexpr unsigned long long FILETIME_TICKS_PER_SECOND = 10000000ULL;
+
+    std::atomic<unsigned long long> g_nextLogSerial(1);
+
+    struct ThreadRegistration
+    {
+        unsigned long long serial;
+        std::shared_ptr<BinaryLogThreadBuffer> buffer;
+    };
+
+    // Set while the thread's registrations are destroyed; records after
+    // that have nowhere to go
+    thread_local bool t_registrationsGone = false;
+
+    struct ThreadRegistrations
+    {
+        std::vector<ThreadRegistration> entries;
+
+        ~ThreadRegistrations()
+        {
+            t_registrationsGone = true;
+            for (const ThreadRegistration& entry : entries)
+            {
+                entry.buffer->retired.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    thread_local ThreadRegistrations t_registrations;
+
+    size_t RoundUpToPowerOfTwo(size_t value)
+    {
+        size_t result = 256;
+        while (result < value)
+        {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    size_t ArgumentBytes(const LogArgument& argument)
+    {
+        if (argument.type == LogArgumentType::Text)
+        {
+            return 3 + 2 * std::min(argument.length, MAX_INLINE_TEXT);
+        }
+        return 9;
+    }
+
+    // Copies into the ring at a running position, wrapping at the end
+    class RingWriter
+    {
+    public:
+        RingWriter(BinaryLogThreadBuffer& buffer, unsigned long long position)
+            : m_data(buffer.data.get())
+            , m_mask(buffer.mask)
+            , m_position(position)
+        {
+        }
+
+        void Put(const void* source, size_t bytes)
+        {
+            size_t offset = static_cast<size_t>(m_position & m_mask);
+            size_t first = std::min(bytes, m_mask + 1 - offset);
+            std::memcpy(m_data + offset, source, first);
+            if (first < bytes)
+            {
+                std::memcpy(m_data, static_cast<const unsigned char*>(source) + first, bytes - first);
+            }
+            m_position += bytes;
+        }
+
+        void PutText(const wchar_t* text, size_t units)
+        {
+            if (sizeof(wchar_t) == sizeof(unsigned short))
+            {
+                Put(text, units * sizeof(wchar_t));
+                return;
+            }
+
+            unsigned short chunk[64];
+            while (units > 0)
+            {
+                size_t count = std::min(units, sizeof(chunk) / sizeof(chunk[0]));
+                for (size_t i = 0; i < count; ++i)
+                {
+                    chunk[i] = static_cast<unsigned short>(text[i]);
+                }
+                Put(chunk, count * sizeof(unsigned short));
+                text += count;
+                units -= count;
+            }
+        }
+
+    private:
+        unsigned char* m_data;
+        size_t m_mask;
+        unsigned long long m_position;
+    };
+
+    void ReadRing(const BinaryLogThreadBuffer& buffer, unsigned long long position, void* target, size_t bytes)
+    {
+        size_t offset = static_cast<size_t>(position & buffer.mask);
+        size_t first = std::min(bytes, buffer.mask + 1 - offset);
+        std::memcpy(target, buffer.data.get() + offset, first);
+        if (first < bytes)
+        {
+            std::memcpy(static_cast<unsigned char*>(target) + first, buffer.data.get(), bytes - first);
+        }
+    }
+
+    template <typename T>
+    void AppendValue(std::string& out, T value)
+    {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    T ReadValue(const char* data)
+    {
+        T value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    void AppendFileRecordPrefix(std::string& out, unsigned char tag, size_t bodyBytes)
+    {
+        out += static_cast<char>(tag);
+        AppendValue(out, static_cast<unsigned int>(bodyBytes));
+    }
+
+    std::wstring Utf8ToWide(const char* data, size_t bytes)
+    {
+        std::wstring result;
+        if (bytes == 0)
+        {
+            return result;
+        }
+        int length = MultiByteToWideChar(CP_UTF8, 0, data, static_cast<int>(bytes), nullptr, 0);
+        if (length <= 0)
+        {
+            return result;
+        }
+        result.resize(static_cast<size_t>(length));
+        MultiByteToWideChar(CP_UTF8, 0, data, static_cast<int>(bytes), &result[0], length);
+        return result;
+    }
+
+    void AppendArgument(std::wstring& out, const LogArgument& argument)
+    {
+        switch (argument.type)
+        {
+        case LogArgumentType::Signed:
+            out += std::to_wstring(static_cast<long long>(argument.bits));
+            break;
+        case LogArgumentType::Unsigned:
+            out += std::to_wstring(argument.bits);
+            break;
+        case LogArgumentType::Double:
+        {
+            double value = 0.0;
+            std::memcpy(&value, &argument.bits, sizeof(value));
+            out += std::to_wstring(value);
+            break;
+        }
+        case LogArgumentType::Interned:
+            out += argument.text ? argument.text : L"";
+            break;
+        case LogArgumentType::Text:
+            out.append(argument.text, argument.length);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+std::wstring RenderLogFormat(const wchar_t* format, const LogArgument* args, size_t count)
+{
+    std::wstring result;
+    size_t next = 0;
+    for (const wchar_t* p = format; *p; ++p)
+    {
+        if (p[0] == L'{' && p[1] == L'}' && next < count)
+        {
+            AppendArgument(result, args[next++]);
+            ++p;
+            continue;
+        }
+        result += *p;
+    }
+    return result;
+}
+
+BinaryLog::BinaryLog(const BinaryLogOptions& options)
+    : m_bufferBytes(RoundUpToPowerOfTwo(options.threadBufferBytes))
+    , m_flushIntervalMs(options.flushIntervalMs > 0 ? options.flushIntervalMs : 1)
+    , m_serial(g_nextLogSerial.fetch_add(1))
+    , m_dropped(0)
+    , m_wakePending(false)
+    , m_file(options.path)
+    , m_needHeader(true)
+    , m_reportedDrops(0)
+    , m_wakeRequested(false)
+    , m_flushRequested(false)
+    , m_stop(false)
+    , m_rotation(options.rotation)
+    , m_rotationChanged(true)
+    , m_passesStarted(0)
+    , m_passesWritten(0)
+{
+    m_writer = std::thread([this]() { WriterThreadMain(); });
+}
+
+BinaryLog::~BinaryLog()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+
+    if (m_writer.joinable())
+    {
+        m_writer.join();
+    }
+
+    // Threads still holding a ring drop it at their next registration
+    for (const std::shared_ptr<BinaryLogThreadBuffer>& buffer : m_buffers)
+    {
+        buffer->closed.store(true, std::memory_order_relaxed);
+    }
+}
+
+BinaryLogThreadBuffer* BinaryLog::GetThreadBuffer()
+{
+    if (t_registrationsGone)
+    {
+        return nullptr;
+    }
+
+    for (const ThreadRegistration& entry : t_registrations.entries)
+    {
+        if (entry.serial == m_serial)
+        {
+            return entry.buffer.get();
+        }
+    }
+    return RegisterThread();
+}
+
+BinaryLogThreadBuffer* BinaryLog::RegisterThread()
+{
+    std::vector<ThreadRegistration>& entries = t_registrations.entries;
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [](const ThreadRegistration& entry) {
+                                     return entry.buffer->closed.load(std::memory_order_relaxed);
+                                 }),
+                  entries.end());
+
+    std::shared_ptr<BinaryLogThreadBuffer> buffer = std::make_shared<BinaryLogThreadBuffer>(m_bufferBytes);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stop)
+        {
+            return nullptr;
+        }
+        m_buffers.push_back(buffer);
+    }
+
+    ThreadRegistration entry;
+    entry.serial = m_serial;
+    entry.buffer = buffer;
+    entries.push_back(entry);
+    return buffer.get();
+}
+
+bool BinaryLog::WriteRecord(LogLevel level, const LogFormat& format, const LogArgument* args, size_t count)
+{
+    unsigned long long now = CurrentLogTime();
+
+    BinaryLogThreadBuffer* buffer = GetThreadBuffer();
+    if (!buffer)
+    {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    count = std::min(count, MAX_ARGUMENTS);
+    size_t size = RING_RECORD_HEADER;
+    for (size_t i = 0; i < count; ++i)
+    {
+        size += ArgumentBytes(args[i]);
+    }
+
+    // Single producer: only the writer moves tail, and only forward
+    size_t capacity = buffer->mask + 1;
+    unsigned long long head = buffer->head.load(std::memory_order_relaxed);
+    unsigned long long tail = buffer->tail.load(std::memory_order_acquire);
+    if (size > capacity - static_cast<size_t>(head - tail))
+    {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    unsigned char header[RING_RECORD_HEADER] = {0};
+    unsigned int recordSize = static_cast<unsigned int>(size);
+    unsigned long long formatPointer = static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(format.text));
+    std::memcpy(header, &recordSize, sizeof(recordSize));
+    header[4] = static_cast<unsigned char>(level);
+    header[5] = static_cast<unsigned char>(count);
+    std::memcpy(header + 8, &now, sizeof(now));
+    std::memcpy(header + 16, &format.id, sizeof(format.id));
+    std::memcpy(header + 24, &formatPointer, sizeof(formatPointer));
+
+    RingWriter writer(*buffer, head);
+    writer.Put(header, sizeof(header));
+    for (size_t i = 0; i < count; ++i)
+    {
+        const LogArgument& argument = args[i];
+        unsigned char tag = static_cast<unsigned char>(argument.type);
+        writer.Put(&tag, 1);
+        if (argument.type == LogArgumentType::Text)
+        {
+            unsigned short units = static_cast<unsigned short>(std::min(argument.length, MAX_INLINE_TEXT));
+            writer.Put(&units, sizeof(units));
+            writer.PutText(argument.text, units);
+        }
+        else
+        {
+            writer.Put(&argument.bits, sizeof(argument.bits));
+        }
+    }
+    buffer->head.store(head + size, std::memory_order_release);
+
+    // Errors go out at once; a ring filling up gets drained before it
+    // overflows. Either way only the first producer pays for the wake.
+    bool urgent = (level == LogLevel::Error) || (head + size - tail > capacity / 2);
+    if (urgent && !m_wakePending.exchange(true, std::memory_order_relaxed))
+    {
+        Wake();
+    }
+    return true;
+}
+
+void BinaryLog::Flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // The first pass to start after this point sees every record written so far
+    unsigned long long pass = m_passesStarted + 1;
+    m_flushRequested = true;
+    m_wakeRequested = true;
+    m_wake.notify_one();
+    m_progress.wait(lock, [this, pass]() { return m_passesWritten >= pass || m_stop; });
+}
+
+BinaryLogStats BinaryLog::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    BinaryLogStats stats = m_stats;
+    stats.dropped = m_dropped.load(std::memory_order_relaxed);
+    stats.threads = m_buffers.size();
+    stats.rotations = m_file.GetStats().rotations;
+    return stats;
+}
+
+void BinaryLog::SetRotation(const LogRotationOptions& rotation)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_rotation = rotation;
+    m_rotationChanged = true;
+}
+
+void BinaryLog::Wake()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_wakeRequested = true;
+    }
+    m_wake.notify_one();
+}
+
+void BinaryLog::AppendDefinition(unsigned char tag, unsigned long long key, const wchar_t* text, std::string& out)
+{
+    std::string utf8;
+    AppendLogTextUtf8(utf8, text ? std::wstring(text) : std::wstring());
+    AppendFileRecordPrefix(out, tag, sizeof(key) + utf8.size());
+    AppendValue(out, key);
+    out += utf8;
+}
+
+void BinaryLog::AppendRecord(const std::string& record, std::string& out)
+{
+    if (m_needHeader)
+    {
+        AppendFileRecordPrefix(out, TAG_HEADER, sizeof(FILE_MAGIC) + sizeof(FILE_VERSION));
+        out.append(FILE_MAGIC, sizeof(FILE_MAGIC));
+        AppendValue(out, FILE_VERSION);
+        m_writtenFormats.clear();
+        m_writtenStrings.clear();
+        m_needHeader = false;
+    }
+
+    if (record.empty())
+    {
+        return;
+    }
+
+    const char* data = record.data();
+    unsigned long long formatId = ReadValue<unsigned long long>(data + 16);
+    if (std::find(m_writtenFormats.begin(), m_writtenFormats.end(), formatId) == m_writtenFormats.end())
+    {
+        const wchar_t* text = reinterpret_cast<const wchar_t*>(
+            static_cast<uintptr_t>(ReadValue<unsigned long long>(data + 24)));
+        AppendDefinition(TAG_FORMAT, formatId, text, out);
+        m_writtenFormats.push_back(formatId);
+    }
+
+    unsigned char argc = static_cast<unsigned char>(data[5]);
+    size_t offset = RING_RECORD_HEADER;
+    for (unsigned char i = 0; i < argc; ++i)
+    {
+        LogArgumentType type = static_cast<LogArgumentType>(data[offset]);
+        if (type == LogArgumentType::Text)
+        {
+            offset += 3 + 2 * static_cast<size_t>(ReadValue<unsigned short>(data + offset + 1));
+            continue;
+        }
+
+        unsigned long long bits = ReadValue<unsigned long long>(data + offset + 1);
+        if (type == LogArgumentType::Interned &&
+            std::find(m_writtenStrings.begin(), m_writtenStrings.end(), bits) == m_writtenStrings.end())
+        {
+            AppendDefinition(TAG_STRING, bits, reinterpret_cast<const wchar_t*>(static_cast<uintptr_t>(bits)), out);
+            m_writtenStrings.push_back(bits);
+        }
+        offset += 9;
+    }
+
+    // Level, argc, time and format id, then the arguments; the pointer stays behind
+    size_t argumentBytes = record.size() - RING_RECORD_HEADER;
+    AppendFileRecordPrefix(out, TAG_RECORD, 2 + 16 + argumentBytes);
+    out.append(data + 4, 2);
+    out.append(data + 8, 16);
+    out.append(data + RING_RECORD_HEADER, argumentBytes);
+}
+
+size_t BinaryLog::Drain(std::vector<std::shared_ptr<BinaryLogThreadBuffer>>& buffers, std::string& out, bool& sawError)
+{
+    struct Cursor
+    {
+        BinaryLogThreadBuffer* buffer;
+        unsigned long long position;
+        unsigned long long end;
+        unsigned long long time;    // Of the record at position
+    };
+
+    // Stop at what each ring holds now, so a busy thread cannot keep the
+    // pass going
+    std::vector<Cursor> cursors;
+    for (const std::shared_ptr<BinaryLogThreadBuffer>& buffer : buffers)
+    {
+        Cursor cursor;
+        cursor.buffer = buffer.get();
+        cursor.end = buffer->head.load(std::memory_order_acquire);
+        cursor.position = buffer->tail.load(std::memory_order_relaxed);
+        if (cursor.position != cursor.end)
+        {
+            ReadRing(*cursor.buffer, cursor.position + 8, &cursor.time, sizeof(cursor.time));
+            cursors.push_back(cursor);
+        }
+    }
+
+    // Merge by timestamp so the file reads in the order things happened
+    std::string record;
+    size_t count = 0;
+    while (!cursors.empty())
+    {
+        size_t pick = 0;
+        for (size_t i = 1; i < cursors.size(); ++i)
+        {
+            if (cursors[i].time < cursors[pick].time)
+            {
+                pick = i;
+            }
+        }
+
+        Cursor& cursor = cursors[pick];
+        unsigned int size = 0;
+        ReadRing(*cursor.buffer, cursor.position, &size, sizeof(size));
+        record.resize(size);
+        ReadRing(*cursor.buffer, cursor.position, &record[0], size);
+        AppendRecord(record, out);
+        sawError = sawError || (static_cast<LogLevel>(record[4]) == LogLevel::Error);
+        ++count;
+
+        cursor.position += size;
+        cursor.buffer->tail.store(cursor.position, std::memory_order_release);
+        if (cursor.position == cursor.end)
+        {
+            cursors.erase(cursors.begin() + static_cast<std::ptrdiff_t>(pick));
+        }
+        else
+        {
+            ReadRing(*cursor.buffer, cursor.position + 8, &cursor.time, sizeof(cursor.time));
+        }
+    }
+    return count;
+}
+
+bool BinaryLog::WriteOut(std::string& buffer)
+{
+    bool ok = m_file.Append(buffer.data(), buffer.size());
+    buffer.clear();
+
+    // Rotate with nothing buffered, so the next batch opens the new file
+    // with a header and its own definitions
+    if (!ok || ((m_file.GetRoom() == 0 || m_file.IsAged()) && m_file.Rotate()))
+    {
+        m_needHeader = true;
+    }
+    return ok;
+}
+
+void BinaryLog::WriterThreadMain()
+{
+    const std::chrono::milliseconds interval(m_flushIntervalMs);
+    std::string buffer;
+    unsigned long long buffered = 0;    // Records in buffer
+    auto lastWrite = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<BinaryLogThreadBuffer>> buffers;
+
+    for (;;)
+    {
+        bool stop = false;
+        bool flush = false;
+        unsigned long long pass = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            auto timeout = interval;
+            if (!buffer.empty())
+            {
+                auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - lastWrite);
+                timeout = (waited < interval) ? interval - waited : std::chrono::milliseconds(0);
+            }
+            m_wake.wait_for(lock, timeout, [this]() { return m_wakeRequested || m_stop; });
+            m_wakeRequested = false;
+            stop = m_stop;
+            flush = m_flushRequested;
+            m_flushRequested = false;
+            pass = ++m_passesStarted;
+            buffers = m_buffers;
+            if (m_rotationChanged)
+            {
+                m_file.SetOptions(m_rotation);
+                m_rotationChanged = false;
+            }
+        }
+        m_wakePending.store(false, std::memory_order_relaxed);
+
+        // A record is in a ring only once it is complete, so on stop one
+        // more drain picks up everything
+        bool sawError = false;
+        size_t drained = Drain(buffers, buffer, sawError);
+
+        unsigned long long dropped = m_dropped.load(std::memory_order_relaxed);
+        if (dropped != m_reportedDrops)
+        {
+            AppendRecord(std::string(), buffer);
+            AppendFileRecordPrefix(buffer, TAG_DROPPED, 16);
+            AppendValue(buffer, CurrentLogTime());
+            AppendValue(buffer, dropped - m_reportedDrops);
+            m_reportedDrops = dropped;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        bool due = stop || flush || sawError ||
+                   buffer.size() >= WRITE_BATCH_BYTES || now - lastWrite >= interval;
+
+        buffered += drained;
+        bool wrote = false;
+        bool writeOk = false;
+        if (due && !buffer.empty())
+        {
+            writeOk = WriteOut(buffer);
+            lastWrite = now;
+            wrote = true;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (wrote)
+            {
+                ++m_stats.writes;
+                m_stats.written += writeOk ? buffered : 0;
+                buffered = 0;
+            }
+            if (buffer.empty())
+            {
+                m_passesWritten = pass;
+            }
+
+            // Rings of exited threads go once emptied; a retired ring gets
+            // no more records, so an equal head and tail is final
+            m_buffers.erase(std::remove_if(m_buffers.begin(), m_buffers.end(),
+                                           [](const std::shared_ptr<BinaryLogThreadBuffer>& ring) {
+                                               return ring->retired.load(std::memory_order_acquire) &&
+                                                      ring->tail.load(std::memory_order_relaxed) ==
+                                                          ring->head.load(std::memory_order_relaxed);
+                                           }),
+                            m_buffers.end());
+        }
+        m_progress.notify_all();
+        buffers.clear();
+
+        if (stop)
+        {
+            break;
+        }
+    }
+}
+
+// ============================================================================
+// DECODER
+// ============================================================================
+
+namespace
+{
+    struct DecodeState
+    {
+        std::unordered_map<unsigned long long, std::wstring> formats;
+        std::unordered_map<unsigned long long, std::wstring> strings;
+        bool sawHeader;
+
+        DecodeState()
+            : sawHeader(false)
+        {
+        }
+    };
+
+    // False on a malformed body
+    bool DecodeRecordBody(DecodeState& state, const char* body, size_t bytes, DecodedLogRecord& record)
+    {
+        if (bytes < 18)
+        {
+            return false;
+        }
+
+        unsigned char level = static_cast<unsigned char>(body[0]);
+        unsigned char argc = static_cast<unsigned char>(body[1]);
+        record.level = (level == static_cast<unsigned char>(LogLevel::Error)) ? LogLevel::Error : LogLevel::Debug;
+        record.time = ReadValue<unsigned long long>(body + 2);
+        record.dropped = 0;
+        unsigned long long formatId = ReadValue<unsigned long long>(body + 10);
+
+        LogArgument args[MAX_ARGUMENTS];
+        std::vector<std::wstring> texts(argc);
+        size_t offset = 18;
+        for (unsigned char i = 0; i < argc; ++i)
+        {
+            if (offset + 1 > bytes)
+            {
+                return false;
+            }
+            LogArgument& argument = args[i];
+            argument.type = static_cast<LogArgumentType>(body[offset]);
+            ++offset;
+
+            if (argument.type == LogArgumentType::Text)
+            {
+                if (offset + 2 > bytes)
+                {
+                    return false;
+                }
+                size_t units = ReadValue<unsigned short>(body + offset);
+                offset += 2;
+                if (offset + units * 2 > bytes)
+                {
+                    return false;
+                }
+                std::wstring& text = texts[i];
+                text.resize(units);
+                for (size_t u = 0; u < units; ++u)
+                {
+                    text[u] = static_cast<wchar_t>(ReadValue<unsigned short>(body + offset + u * 2));
+                }
+                offset += units * 2;
+                argument.text = text.c_str();
+                argument.length = units;
+                continue;
+            }
+
+            if (offset + 8 > bytes)
+            {
+                return false;
+            }
+            argument.bits = ReadValue<unsigned long long>(body + offset);
+            offset += 8;
+            if (argument.type == LogArgumentType::Interned)
+            {
+                auto found = state.strings.find(argument.bits);
+                argument.text = (found != state.strings.end()) ? found->second.c_str() : L"?";
+            }
+        }
+
+        auto format = state.formats.find(formatId);
+        if (format == state.formats.end())
+        {
+            record.text = L"<unknown log format " + std::to_wstring(formatId) + L">";
+            return true;
+        }
+        record.text = RenderLogFormat(format->second.c_str(), args, argc);
+        return true;
+    }
+
+    // Handle one file record; false if the file is not a usable binary log
+    bool DecodeFileRecord(DecodeState& state, unsigned char tag, const char* body, size_t bytes,
+                          const std::function<void(const DecodedLogRecord&)>& visitor)
+    {
+        if (tag == TAG_HEADER)
+        {
+            if (bytes < sizeof(FILE_MAGIC) + sizeof(FILE_VERSION) ||
+                std::memcmp(body, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 ||
+                ReadValue<unsigned short>(body + sizeof(FILE_MAGIC)) != FILE_VERSION)
+            {
+                return false;
+            }
+            // A new writer session; its ids mean nothing to the last one
+            state.formats.clear();
+            state.strings.clear();
+            state.sawHeader = true;
+            return true;
+        }
+
+        if (!state.sawHeader)
+        {
+            return false;
+        }
+
+        switch (tag)
+        {
+        case TAG_FORMAT:
+        case TAG_STRING:
+        {
+            if (bytes < 8)
+            {
+                return false;
+            }
+            unsigned long long key = ReadValue<unsigned long long>(body);
+            std::wstring text = Utf8ToWide(body + 8, bytes - 8);
+            (tag == TAG_FORMAT ? state.formats : state.strings)[key] = std::move(text);
+            return true;
+        }
+        case TAG_RECORD:
+        {
+            DecodedLogRecord record;
+            if (!DecodeRecordBody(state, body, bytes, record))
+            {
+                return false;
+            }
+            visitor(record);
+            return true;
+        }
+        case TAG_DROPPED:
+        {
+            if (bytes < 16)
+            {
+                return false;
+            }
+            DecodedLogRecord record;
+            record.time = ReadValue<unsigned long long>(body);
+            record.dropped = ReadValue<unsigned long long>(body + 8);
+            record.text = FormatDroppedRecordsNotice(record.dropped);
+            visitor(record);
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+}
+
+bool ReadBinaryLog(const std::wstring& path, const std::function<void(const DecodedLogRecord&)>& visitor)
+{
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    DecodeState state;
+    std::string pending;
+    std::vector<char> chunk(READ_CHUNK_BYTES);
+    bool ok = true;
+    for (;;)
+    {
+        DWORD read = 0;
+        if (!ReadFile(file, chunk.data(), static_cast<DWORD>(chunk.size()), &read, nullptr) || read == 0)
+        {
+            break;
+        }
+        pending.append(chunk.data(), read);
+
+        size_t offset = 0;
+        while (ok && pending.size() - offset >= FILE_RECORD_PREFIX)
+        {
+            unsigned char tag = static_cast<unsigned char>(pending[offset]);
+            size_t bodyBytes = ReadValue<unsigned int>(pending.data() + offset + 1);
+            if (pending.size() - offset - FILE_RECORD_PREFIX < bodyBytes)
+            {
+                break;
+            }
+            ok = DecodeFileRecord(state, tag, pending.data() + offset + FILE_RECORD_PREFIX, bodyBytes, visitor);
+            offset += FILE_RECORD_PREFIX + bodyBytes;
+        }
+        pending.erase(0, offset);
+
+        if (!ok)
+        {
+            break;
+        }
+    }
+
+    CloseHandle(file);
+    return ok && state.sawHeader;
+}
+
+std::string FormatDecodedLogLine(const DecodedLogRecord& record)
+{
+    std::string line = FormatLogTimestamp(record.time);
+    line += '[';
+    line += (record.dropped != 0) ? "WARN" : GetLogLevelName(record.level);
+    line += "] ";
+    AppendLogTextUtf8(line, record.text);
+    line += "\r\n";
+    return line;
+}
+
+bool DecodeBinaryLog(const std::wstring& binaryPath, const std::wstring& textPath, unsigned long long* recordsOut)
+{
+    HANDLE output = CreateFileW(textPath.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                                CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (output == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    bool writeOk = true;
+    std::string buffer;
+    auto writeBuffer = [&]() {
+        size_t offset = 0;
+        while (writeOk && offset < buffer.size())
+        {
+            DWORD written = 0;
+            writeOk = WriteFile(output, buffer.data() + offset, static_cast<DWORD>(buffer.size() - offset),
+                                &written, nullptr) && written > 0;
+            offset += written;
+        }
+        buffer.clear();
+    };
+
+    // Local time changes at most once a second; reuse the prefix until then
+    unsigned long long records = 0;
+    unsigned long long stampSecond = 0;
+    std::string stamp;
+    bool readOk = ReadBinaryLog(binaryPath, [&](const DecodedLogRecord& record) {
+        unsigned long long second = record.time / FILETIME_TICKS_PER_SECOND;
+        if (stamp.empty() || second != stampSecond)
+        {
+            stamp = FormatLogTimestamp(record.time);
+            stampSecond = second;
+        }
+        buffer += stamp;
+        buffer += '[';
+        buffer += (record.dropped != 0) ? "WARN" : GetLogLevelName(record.level);
+        buffer += "] ";
+        AppendLogTextUtf8(buffer, record.text);
+        buffer += "\r\n";
+        ++records;
+        if (buffer.size() >= WRITE_BATCH_BYTES)
+        {
+            writeBuffer();
+        }
+    });
+    writeBuffer();
+    CloseHandle(output);
+
+    if (recordsOut)
+    {
+        *recordsOut = records;
+    }
+    return readOk && writeOk;
+}
+
+} // namespace NetworkMonitor
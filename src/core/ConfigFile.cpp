@@ -0,0 +1,772 @@
+// ============================================================================
+// File: ConfigFile.cpp
+// Description: AppConfig stored in an INI-style settings file, with atomic
+//              saves and change notification
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#include "NetworkMonitor/ConfigFile.h"
+#include "NetworkMonitor/Utf8Text.h"
+#include "NetworkMonitor/Utils.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#endif
+
+namespace NetworkMonitor
+{
+
+namespace
+{
+    constexpr std::string_view SETTINGS_SECTION = "Settings";
+    constexpr std::string_view QUOTAS_SECTION = "BillingQuotas";
+    // BillingQuotas name of the quota for all interfaces ("" in AppConfig)
+    constexpr std::string_view ALL_INTERFACES_QUOTA = "*";
+
+    enum class SettingKind
+    {
+        Bool,
+        UInt,
+        Int,
+        Text,
+        DisplayUnit,
+        ThemeMode,
+        Language
+    };
+
+    // One value of the [Settings] section; the member matching kind is set
+    struct ConfigSetting
+    {
+        std::string_view name;
+        SettingKind kind;
+        bool AppConfig::*boolMember;
+        UINT AppConfig::*uintMember;
+        int AppConfig::*intMember;
+        std::wstring AppConfig::*textMember;
+        long long minValue;
+        long long maxValue;
+    };
+
+    constexpr long long UINT_LIMIT = (std::numeric_limits<UINT>::max)();
+
+    constexpr ConfigSetting BoolSetting(std::string_view name, bool AppConfig::*member)
+    {
+        return { name, SettingKind::Bool, member, nullptr, nullptr, nullptr, 0, 1 };
+    }
+
+    constexpr ConfigSetting UIntSetting(std::string_view name, UINT AppConfig::*member, long long maxValue)
+    {
+        return { name, SettingKind::UInt, nullptr, member, nullptr, nullptr, 0, maxValue };
+    }
+
+    constexpr ConfigSetting IntSetting(std::string_view name, int AppConfig::*member, long long minValue,
+                                       long long maxValue)
+    {
+        return { name, SettingKind::Int, nullptr, nullptr, member, nullptr, minValue, maxValue };
+    }
+
+    constexpr ConfigSetting TextSetting(std::string_view name, std::wstring AppConfig::*member)
+    {
+        return { name, SettingKind::Text, nullptr, nullptr, nullptr, member, 0, 0 };
+    }
+
+    constexpr ConfigSetting EnumSetting(std::string_view name, SettingKind kind, long long maxValue)
+    {
+        return { name, kind, nullptr, nullptr, nullptr, nullptr, 0, maxValue };
+    }
+
+    // In the order they are written; limits match ConfigManager's registry
+    // backend
+    const ConfigSetting SETTINGS[] = {
+        UIntSetting("UpdateInterval", &AppConfig::updateInterval, UINT_LIMIT),
+        EnumSetting("DisplayUnit", SettingKind::DisplayUnit, static_cast<long long>(SpeedUnit::MegaBitsPerSecond)),
+        BoolSetting("ShowUploadSpeed", &AppConfig::showUploadSpeed),
+        BoolSetting("ShowDownloadSpeed", &AppConfig::showDownloadSpeed),
+        BoolSetting("EnableLogging", &AppConfig::enableLogging),
+        BoolSetting("DebugLogging", &AppConfig::debugLogging),
+        BoolSetting("BinaryDebugLog", &AppConfig::binaryDebugLog),
+        UIntSetting("LogMaxSizeMB", &AppConfig::logMaxSizeMB, MAX_LOG_MAX_SIZE_MB),
+        UIntSetting("LogMaxAgeDays", &AppConfig::logMaxAgeDays, MAX_LOG_MAX_AGE_DAYS),
+        UIntSetting("LogKeepFiles", &AppConfig::logKeepFiles, MAX_LOG_KEEP_FILES),
+        BoolSetting("DarkTheme", &AppConfig::darkTheme),
+        EnumSetting("ThemeMode", SettingKind::ThemeMode, static_cast<long long>(ThemeMode::Dark)),
+        IntSetting("HistoryAutoTrimDays", &AppConfig::historyAutoTrimDays, 0, MAX_HISTORY_AUTO_TRIM_DAYS),
+        IntSetting("HistoryRawDays", &AppConfig::historyRawDays, 0, MAX_HISTORY_TIER_DAYS),
+        IntSetting("HistoryMinuteDays", &AppConfig::historyMinuteDays, 0, MAX_HISTORY_TIER_DAYS),
+        IntSetting("HistoryHourDays", &AppConfig::historyHourDays, 0, MAX_HISTORY_TIER_DAYS),
+        UIntSetting("HistoryMaxSizeMB", &AppConfig::historyMaxSizeMB, MAX_HISTORY_SIZE_MB),
+        UIntSetting("HistoryCoalescePercent", &AppConfig::historyCoalescePercent, MAX_HISTORY_COALESCE_PERCENT),
+        EnumSetting("Language", SettingKind::Language, static_cast<long long>(AppLanguage::Vietnamese)),
+        TextSetting("SelectedInterface", &AppConfig::selectedInterface),
+        BoolSetting("EnableConnectionNotify", &AppConfig::enableConnectionNotification),
+        TextSetting("PingTarget", &AppConfig::pingTarget),
+        UIntSetting("PingIntervalMs", &AppConfig::pingIntervalMs, UINT_LIMIT),
+        UIntSetting("HotkeyModifier", &AppConfig::hotkeyModifier, UINT_LIMIT),
+        UIntSetting("HotkeyKey", &AppConfig::hotkeyKey, UINT_LIMIT),
+        IntSetting("BillingCycleStartDay", &AppConfig::billingCycleStartDay, 1, MAX_BILLING_CYCLE_START_DAY),
+    };
+
+    std::string_view Trim(std::string_view text)
+    {
+        size_t start = 0;
+        while (start < text.size() && (text[start] == ' ' || text[start] == '\t'))
+        {
+            ++start;
+        }
+        size_t end = text.size();
+        while (end > start && (text[end - 1] == ' ' || text[end - 1] == '\t' || text[end - 1] == '\r'))
+        {
+            --end;
+        }
+        return text.substr(start, end - start);
+    }
+
+    bool ParseInteger(std::string_view text, long long& value)
+    {
+        if (text == "true")
+        {
+            value = 1;
+            return true;
+        }
+        if (text == "false")
+        {
+            value = 0;
+            return true;
+        }
+        const char* end = text.data() + text.size();
+        std::from_chars_result result = std::from_chars(text.data(), end, value);
+        return result.ec == std::errc() && result.ptr == end;
+    }
+
+    const ConfigSetting* FindSetting(std::string_view name)
+    {
+        for (const ConfigSetting& setting : SETTINGS)
+        {
+            if (setting.name == name)
+            {
+                return &setting;
+            }
+        }
+        return nullptr;
+    }
+
+    bool ApplySetting(const ConfigSetting& setting, std::string_view value, AppConfig& config)
+    {
+        if (setting.kind == SettingKind::Text)
+        {
+            std::wstring& text = config.*setting.textMember;
+            text.clear();
+            AppendUtf8AsWide(text, value);
+            return true;
+        }
+
+        long long number = 0;
+        if (!ParseInteger(value, number))
+        {
+            return false;
+        }
+
+        switch (setting.kind)
+        {
+        case SettingKind::Bool:
+            config.*setting.boolMember = (number != 0);
+            return true;
+        case SettingKind::UInt:
+            config.*setting.uintMember = static_cast<UINT>((std::clamp)(number, 0LL, setting.maxValue));
+            return true;
+        case SettingKind::Int:
+            config.*setting.intMember = static_cast<int>((std::clamp)(number, setting.minValue, setting.maxValue));
+            return true;
+        default:
+            break;
+        }
+
+        // Enumerations out of range keep the current value
+        if (number < 0 || number > setting.maxValue)
+        {
+            return false;
+        }
+        if (setting.kind == SettingKind::DisplayUnit)
+        {
+            config.displayUnit = static_cast<SpeedUnit>(number);
+        }
+        else if (setting.kind == SettingKind::ThemeMode)
+        {
+            config.themeMode = static_cast<ThemeMode>(number);
+        }
+        else
+        {
+            config.language = static_cast<AppLanguage>(number);
+        }
+        return true;
+    }
+
+    template <typename Integer>
+    void AppendNumber(std::string& out, Integer value)
+    {
+        char digits[24];
+        std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+        out.append(digits, result.ptr);
+    }
+
+    long long SettingValue(const ConfigSetting& setting, const AppConfig& config)
+    {
+        switch (setting.kind)
+        {
+        case SettingKind::Bool:
+            return (config.*setting.boolMember) ? 1 : 0;
+        case SettingKind::UInt:
+            return (std::min)(static_cast<long long>(config.*setting.uintMember), setting.maxValue);
+        case SettingKind::Int:
+            return (std::clamp)(static_cast<long long>(config.*setting.intMember), setting.minValue, setting.maxValue);
+        case SettingKind::DisplayUnit:
+            return static_cast<long long>(config.displayUnit);
+        case SettingKind::ThemeMode:
+            return static_cast<long long>(config.themeMode);
+        case SettingKind::Language:
+        default:
+            return static_cast<long long>(config.language);
+        }
+    }
+
+    // Read-only view of a whole file; empty files map to an empty view
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        ~MappedFile() { Close(); }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool Open(const std::wstring& path)
+        {
+#ifdef _WIN32
+            HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                      nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+            {
+                return false;
+            }
+            LARGE_INTEGER size = {};
+            bool ok = GetFileSizeEx(file, &size) != FALSE;
+            if (ok && size.QuadPart > 0)
+            {
+                HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (mapping)
+                {
+                    m_view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                    CloseHandle(mapping);   // The view keeps the mapping alive
+                }
+                ok = (m_view != nullptr);
+                m_size = ok ? static_cast<size_t>(size.QuadPart) : 0;
+            }
+            CloseHandle(file);
+            return ok;
+#else
+            int fd = open(std::filesystem::path(path).c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                return false;
+            }
+            struct stat info = {};
+            bool ok = fstat(fd, &info) == 0;
+            if (ok && info.st_size > 0)
+            {
+                void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                ok = (view != MAP_FAILED);
+                if (ok)
+                {
+                    m_view = view;
+                    m_size = static_cast<size_t>(info.st_size);
+                }
+            }
+            close(fd);
+            return ok;
+#endif
+        }
+
+        std::string_view Text() const
+        {
+            return m_view ? std::string_view(static_cast<const char*>(m_view), m_size) : std::string_view();
+        }
+
+    private:
+        void Close()
+        {
+            if (!m_view)
+            {
+                return;
+            }
+#ifdef _WIN32
+            UnmapViewOfFile(m_view);
+#else
+            munmap(m_view, m_size);
+#endif
+            m_view = nullptr;
+            m_size = 0;
+        }
+
+        void* m_view = nullptr;
+        size_t m_size = 0;
+    };
+
+    bool WriteFileAtomically(const std::wstring& path, const std::string& data)
+    {
+        const std::wstring tempPath = path + L".tmp";
+#ifdef _WIN32
+        HANDLE file = CreateFileW(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                  FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            NM_LOG_ERROR(L"ConfigFile: cannot create " + tempPath + L": " + GetLastErrorString());
+            return false;
+        }
+        DWORD written = 0;
+        bool ok = WriteFile(file, data.data(), static_cast<DWORD>(data.size()), &written, nullptr) &&
+                  written == data.size() && FlushFileBuffers(file);
+        CloseHandle(file);
+        ok = ok && MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+        if (!ok)
+        {
+            NM_LOG_ERROR(L"ConfigFile: cannot replace " + path + L": " + GetLastErrorString());
+            DeleteFileW(tempPath.c_str());
+        }
+        return ok;
+#else
+        const std::filesystem::path target(path);
+        const std::filesystem::path temp(tempPath);
+        int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            NM_LOG_ERROR(L"ConfigFile: cannot create " + tempPath + L": errno " + std::to_wstring(errno));
+            return false;
+        }
+        bool ok = true;
+        size_t offset = 0;
+        while (ok && offset < data.size())
+        {
+            ssize_t written = write(fd, data.data() + offset, data.size() - offset);
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            ok = written > 0;
+            offset += ok ? static_cast<size_t>(written) : 0;
+        }
+        ok = ok && fsync(fd) == 0;
+        ok = (close(fd) == 0) && ok;
+        ok = ok && rename(temp.c_str(), target.c_str()) == 0;
+        if (!ok)
+        {
+            NM_LOG_ERROR(L"ConfigFile: cannot replace " + path + L": errno " + std::to_wstring(errno));
+            unlink(temp.c_str());
+        }
+        return ok;
+#endif
+    }
+}
+
+bool ParseConfigText(std::string_view text, AppConfig& config)
+{
+    if (text.size() >= 3 && text.substr(0, 3) == "\xEF\xBB\xBF")
+    {
+        text.remove_prefix(3);
+    }
+
+    bool allRead = true;
+    std::string_view section;
+    std::wstring name;
+    size_t lineStart = 0;
+    while (lineStart < text.size())
+    {
+        const char* newline = static_cast<const char*>(
+            std::memchr(text.data() + lineStart, '\n', text.size() - lineStart));
+        size_t lineEnd = newline ? static_cast<size_t>(newline - text.data()) : text.size();
+        std::string_view line = Trim(text.substr(lineStart, lineEnd - lineStart));
+        lineStart = lineEnd + 1;
+
+        if (line.empty() || line[0] == ';' || line[0] == '#')
+        {
+            continue;
+        }
+        if (line[0] == '[')
+        {
+            if (line.back() != ']')
+            {
+                allRead = false;
+                section = std::string_view();
+                continue;
+            }
+            section = Trim(line.substr(1, line.size() - 2));
+            continue;
+        }
+
+        if (section == SETTINGS_SECTION)
+        {
+            size_t equals = line.find('=');
+            if (equals == std::string_view::npos)
+            {
+                allRead = false;
+                continue;
+            }
+            const ConfigSetting* setting = FindSetting(Trim(line.substr(0, equals)));
+            if (setting && !ApplySetting(*setting, Trim(line.substr(equals + 1)), config))
+            {
+                allRead = false;
+            }
+        }
+        else if (section == QUOTAS_SECTION)
+        {
+            // Interface names may hold '='; the byte count cannot
+            size_t equals = line.rfind('=');
+            long long bytes = 0;
+            if (equals == std::string_view::npos || !ParseInteger(Trim(line.substr(equals + 1)), bytes) || bytes < 0)
+            {
+                allRead = false;
+                continue;
+            }
+            std::string_view interfaceName = Trim(line.substr(0, equals));
+            name.clear();
+            if (interfaceName != ALL_INTERFACES_QUOTA)
+            {
+                AppendUtf8AsWide(name, interfaceName);
+            }
+            if (bytes > 0)
+            {
+                config.billingQuotas[name] = static_cast<unsigned long long>(bytes);
+            }
+            else
+            {
+                config.billingQuotas.erase(name);
+            }
+        }
+    }
+    return allRead;
+}
+
+std::string FormatConfigText(const AppConfig& config)
+{
+    std::string text;
+    text.reserve(1024);
+    text += "; NetworkMonitor settings; edits apply while it runs\r\n";
+    text += '[';
+    text += SETTINGS_SECTION;
+    text += "]\r\n";
+    for (const ConfigSetting& setting : SETTINGS)
+    {
+        text += setting.name;
+        text += '=';
+        if (setting.kind == SettingKind::Text)
+        {
+            AppendWideAsUtf8(text, config.*setting.textMember);
+        }
+        else
+        {
+            AppendNumber(text, SettingValue(setting, config));
+        }
+        text += "\r\n";
+    }
+
+    text += "\r\n[";
+    text += QUOTAS_SECTION;
+    text += "]\r\n";
+    for (const auto& quota : config.billingQuotas)
+    {
+        if (quota.second == 0)
+        {
+            continue;
+        }
+        if (quota.first.empty())
+        {
+            text += ALL_INTERFACES_QUOTA;
+        }
+        else
+        {
+            AppendWideAsUtf8(text, quota.first);
+        }
+        text += '=';
+        AppendNumber(text, quota.second);
+        text += "\r\n";
+    }
+    return text;
+}
+
+bool LoadConfigFile(const std::wstring& path, AppConfig& config)
+{
+    config = AppConfig();
+
+    MappedFile file;
+    if (!file.Open(path))
+    {
+        return false;
+    }
+    if (!ParseConfigText(file.Text(), config))
+    {
+        NM_LOG_ERROR(L"ConfigFile: some lines of " + path + L" were not understood and were skipped");
+    }
+    return true;
+}
+
+bool SaveConfigFile(const std::wstring& path, const AppConfig& config)
+{
+    return WriteFileAtomically(path, FormatConfigText(config));
+}
+
+// ============================================================================
+// CHANGE NOTIFICATION
+// ============================================================================
+
+ConfigFileWatcher::ConfigFileWatcher()
+#ifdef _WIN32
+    : m_directoryHandle(INVALID_HANDLE_VALUE)
+    , m_stopEvent(nullptr)
+#else
+    : m_notifyFd(-1)
+    , m_wakeFds{ -1, -1 }
+#endif
+{
+}
+
+ConfigFileWatcher::~ConfigFileWatcher()
+{
+    Stop();
+}
+
+bool ConfigFileWatcher::Start(const std::wstring& path, std::function<void()> onChange)
+{
+    Stop();
+
+    std::filesystem::path filePath(path);
+    m_directory = filePath.has_parent_path() ? filePath.parent_path().wstring() : std::wstring(L".");
+    m_fileName = filePath.filename().wstring();
+    m_onChange = std::move(onChange);
+
+#ifdef _WIN32
+    m_directoryHandle = CreateFileW(m_directory.c_str(), FILE_LIST_DIRECTORY,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                    FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    m_stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (m_directoryHandle == INVALID_HANDLE_VALUE || !m_stopEvent)
+    {
+        NM_LOG_ERROR(L"ConfigFileWatcher: cannot watch " + m_directory + L": " + GetLastErrorString());
+        Stop();
+        return false;
+    }
+#elif defined(__linux__)
+    m_notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_notifyFd < 0 || pipe(m_wakeFds) != 0 ||
+        inotify_add_watch(m_notifyFd, std::filesystem::path(m_directory).c_str(),
+                          IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO) < 0)
+    {
+        NM_LOG_ERROR(L"ConfigFileWatcher: cannot watch " + m_directory + L": errno " + std::to_wstring(errno));
+        Stop();
+        return false;
+    }
+#else
+    NM_LOG_ERROR(L"ConfigFileWatcher: not supported on this system");
+    return false;
+#endif
+
+    m_thread = std::thread(&ConfigFileWatcher::Run, this);
+    return true;
+}
+
+void ConfigFileWatcher::Stop()
+{
+#ifdef _WIN32
+    if (m_stopEvent)
+    {
+        SetEvent(m_stopEvent);
+    }
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+    if (m_directoryHandle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_directoryHandle);
+        m_directoryHandle = INVALID_HANDLE_VALUE;
+    }
+    if (m_stopEvent)
+    {
+        CloseHandle(m_stopEvent);
+        m_stopEvent = nullptr;
+    }
+#else
+    if (m_wakeFds[1] >= 0)
+    {
+        char wake = 1;
+        while (write(m_wakeFds[1], &wake, 1) < 0 && errno == EINTR)
+        {
+        }
+    }
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+    for (int* fd : { &m_notifyFd, &m_wakeFds[0], &m_wakeFds[1] })
+    {
+        if (*fd >= 0)
+        {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+#endif
+}
+
+#ifdef _WIN32
+void ConfigFileWatcher::Run()
+{
+    // FILE_NOTIFY_INFORMATION records are DWORD aligned
+    DWORD buffer[4096];
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!overlapped.hEvent)
+    {
+        NM_LOG_ERROR(L"ConfigFileWatcher: CreateEventW failed: " + GetLastErrorString());
+        return;
+    }
+
+    bool reading = false;
+    bool pending = false;
+    for (;;)
+    {
+        if (!reading)
+        {
+            ResetEvent(overlapped.hEvent);
+            if (!ReadDirectoryChangesW(m_directoryHandle, buffer, sizeof(buffer), FALSE,
+                                       FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE |
+                                           FILE_NOTIFY_CHANGE_SIZE,
+                                       nullptr, &overlapped, nullptr))
+            {
+                NM_LOG_ERROR(L"ConfigFileWatcher: ReadDirectoryChangesW failed: " + GetLastErrorString());
+                break;
+            }
+            reading = true;
+        }
+
+        HANDLE handles[2] = { m_stopEvent, overlapped.hEvent };
+        DWORD wait = WaitForMultipleObjects(2, handles, FALSE, pending ? CONFIG_CHANGE_SETTLE_MS : INFINITE);
+        if (wait == WAIT_OBJECT_0)
+        {
+            break;
+        }
+        if (wait == WAIT_TIMEOUT)
+        {
+            pending = false;
+            m_onChange();
+            continue;
+        }
+
+        reading = false;
+        DWORD bytes = 0;
+        if (!GetOverlappedResult(m_directoryHandle, &overlapped, &bytes, FALSE))
+        {
+            NM_LOG_ERROR(L"ConfigFileWatcher: GetOverlappedResult failed: " + GetLastErrorString());
+            break;
+        }
+        if (bytes == 0)
+        {
+            // More changes than the buffer holds; one of them may be ours
+            pending = true;
+            continue;
+        }
+
+        const BYTE* record = reinterpret_cast<const BYTE*>(buffer);
+        for (;;)
+        {
+            const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(record);
+            int nameLength = static_cast<int>(info->FileNameLength / sizeof(wchar_t));
+            if (info->Action != FILE_ACTION_REMOVED && info->Action != FILE_ACTION_RENAMED_OLD_NAME &&
+                CompareStringOrdinal(info->FileName, nameLength, m_fileName.c_str(),
+                                     static_cast<int>(m_fileName.size()), TRUE) == CSTR_EQUAL)
+            {
+                pending = true;
+            }
+            if (info->NextEntryOffset == 0)
+            {
+                break;
+            }
+            record += info->NextEntryOffset;
+        }
+    }
+
+    if (reading)
+    {
+        DWORD bytes = 0;
+        CancelIoEx(m_directoryHandle, &overlapped);
+        GetOverlappedResult(m_directoryHandle, &overlapped, &bytes, TRUE);
+    }
+    CloseHandle(overlapped.hEvent);
+}
+#else
+void ConfigFileWatcher::Run()
+{
+#ifdef __linux__
+    const std::string fileName = std::filesystem::path(m_fileName).string();
+    alignas(inotify_event) char buffer[4096];
+    bool pending = false;
+    for (;;)
+    {
+        pollfd fds[2] = { { m_notifyFd, POLLIN, 0 }, { m_wakeFds[0], POLLIN, 0 } };
+        int ready = poll(fds, 2, pending ? static_cast<int>(CONFIG_CHANGE_SETTLE_MS) : -1);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            NM_LOG_ERROR(L"ConfigFileWatcher: poll failed: errno " + std::to_wstring(errno));
+            break;
+        }
+        if (ready == 0)
+        {
+            pending = false;
+            m_onChange();
+            continue;
+        }
+        if (fds[1].revents != 0)
+        {
+            break;
+        }
+
+        for (;;)
+        {
+            ssize_t length = read(m_notifyFd, buffer, sizeof(buffer));
+            if (length <= 0)
+            {
+                break;
+            }
+            for (ssize_t offset = 0; offset < length;)
+            {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                if ((event->mask & IN_Q_OVERFLOW) != 0 ||
+                    (event->len > 0 && fileName == event->name))
+                {
+                    pending = true;
+                }
+                offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            }
+        }
+    }
+#endif
+}
+#endif
+
+} // namespace NetworkMonitor
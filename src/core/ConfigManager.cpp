@@ -5,22 +5,47 @@
 // ============================================================================
 
 #include "NetworkMonitor/ConfigManager.h"
+#include "NetworkMonitor/ConfigFile.h"
 #include "NetworkMonitor/Utils.h"
 #include "NetworkMonitor/ThemeHelper.h"
 
+#include <algorithm>
+
 namespace NetworkMonitor
 {
 
+namespace
+{
+    DWORD ClampTierDays(int days)
+    {
+        return static_cast<DWORD>((std::max)(0, (std::min)(days, MAX_HISTORY_TIER_DAYS)));
+    }
+}
+
 ConfigManager::ConfigManager()
 {
 }
 
+ConfigManager::ConfigManager(const std::wstring& settingsFile)
+    : m_settingsFile(settingsFile)
+{
+}
+
 ConfigManager::~ConfigManager()
 {
 }
 
 bool ConfigManager::LoadConfig(AppConfig& config)
 {
+    if (!m_settingsFile.empty())
+    {
+        // A missing or unreadable file leaves the defaults, as the registry does
+        LoadConfigFile(m_settingsFile, config);
+        config.darkTheme = IsDarkThemeEnabled(config);
+        config.autoStart = IsAutoStartEnabled();
+        return true;
+    }
+
     HKEY hKey = nullptr;
     if (!OpenSettingsKey(hKey))
     {
@@ -40,6 +65,13 @@ bool ConfigManager::LoadConfig(AppConfig& config)
     config.showDownloadSpeed = ReadDWORD(hKey, L"ShowDownloadSpeed", 1) != 0;
     config.enableLogging = ReadDWORD(hKey, L"EnableLogging", 1) != 0;
     config.debugLogging = ReadDWORD(hKey, L"DebugLogging", 0) != 0;
+    config.binaryDebugLog = ReadDWORD(hKey, L"BinaryDebugLog", 0) != 0;
+    config.logMaxSizeMB = (std::min)(static_cast<UINT>(ReadDWORD(hKey, L"LogMaxSizeMB", DEFAULT_LOG_MAX_SIZE_MB)),
+                                     MAX_LOG_MAX_SIZE_MB);
+    config.logMaxAgeDays = (std::min)(static_cast<UINT>(ReadDWORD(hKey, L"LogMaxAgeDays", DEFAULT_LOG_MAX_AGE_DAYS)),
+                                      MAX_LOG_MAX_AGE_DAYS);
+    config.logKeepFiles = (std::min)(static_cast<UINT>(ReadDWORD(hKey, L"LogKeepFiles", DEFAULT_LOG_KEEP_FILES)),
+                                     MAX_LOG_KEEP_FILES);
     
     // Default to system theme if not found in registry
     bool defaultDark = ThemeHelper::IsSystemInDarkMode();
@@ -76,6 +108,16 @@ bool ConfigManager::LoadConfig(AppConfig& config)
     {
         config.historyAutoTrimDays = MAX_HISTORY_AUTO_TRIM_DAYS;
     }
+    config.historyRawDays = static_cast<int>(
+        (std::min)(ReadDWORD(hKey, L"HistoryRawDays", DEFAULT_HISTORY_RAW_DAYS), ClampTierDays(MAX_HISTORY_TIER_DAYS)));
+    config.historyMinuteDays = static_cast<int>(
+        (std::min)(ReadDWORD(hKey, L"HistoryMinuteDays", DEFAULT_HISTORY_MINUTE_DAYS), ClampTierDays(MAX_HISTORY_TIER_DAYS)));
+    config.historyHourDays = static_cast<int>(
+        (std::min)(ReadDWORD(hKey, L"HistoryHourDays", DEFAULT_HISTORY_HOUR_DAYS), ClampTierDays(MAX_HISTORY_TIER_DAYS)));
+    config.historyMaxSizeMB = (std::min)(static_cast<UINT>(ReadDWORD(hKey, L"HistoryMaxSizeMB", 0)), MAX_HISTORY_SIZE_MB);
+    config.historyCoalescePercent = (std::min)(
+        static_cast<UINT>(ReadDWORD(hKey, L"HistoryCoalescePercent", DEFAULT_HISTORY_COALESCE_PERCENT)),
+        MAX_HISTORY_COALESCE_PERCENT);
     DWORD langValue = ReadDWORD(hKey, L"Language", static_cast<DWORD>(AppLanguage::SystemDefault));
     if (langValue > static_cast<DWORD>(AppLanguage::Vietnamese))
     {
@@ -89,13 +131,27 @@ bool ConfigManager::LoadConfig(AppConfig& config)
     config.pingIntervalMs = ReadDWORD(hKey, L"PingIntervalMs", 5000);
     config.hotkeyModifier = ReadDWORD(hKey, L"HotkeyModifier", MOD_WIN | MOD_SHIFT);
     config.hotkeyKey = ReadDWORD(hKey, L"HotkeyKey", 'N');
+    config.billingCycleStartDay = static_cast<int>(ReadDWORD(hKey, L"BillingCycleStartDay", DEFAULT_BILLING_CYCLE_START_DAY));
+    if (config.billingCycleStartDay < 1 || config.billingCycleStartDay > MAX_BILLING_CYCLE_START_DAY)
+    {
+        config.billingCycleStartDay = DEFAULT_BILLING_CYCLE_START_DAY;
+    }
 
     RegCloseKey(hKey);
+
+    config.billingQuotas.clear();
+    ReadBillingQuotas(config.billingQuotas);
     return true;
 }
 
 bool ConfigManager::SaveConfig(const AppConfig& config)
 {
+    if (!m_settingsFile.empty())
+    {
+        bool saved = SaveConfigFile(m_settingsFile, config);
+        return SetAutoStart(config.autoStart) && saved;
+    }
+
     HKEY hKey = nullptr;
     if (!OpenSettingsKey(hKey))
     {
@@ -110,6 +166,10 @@ bool ConfigManager::SaveConfig(const AppConfig& config)
     success &= WriteDWORD(hKey, L"ShowDownloadSpeed", config.showDownloadSpeed ? 1 : 0);
     success &= WriteDWORD(hKey, L"EnableLogging", config.enableLogging ? 1 : 0);
     success &= WriteDWORD(hKey, L"DebugLogging", config.debugLogging ? 1 : 0);
+    success &= WriteDWORD(hKey, L"BinaryDebugLog", config.binaryDebugLog ? 1 : 0);
+    success &= WriteDWORD(hKey, L"LogMaxSizeMB", (std::min)(config.logMaxSizeMB, MAX_LOG_MAX_SIZE_MB));
+    success &= WriteDWORD(hKey, L"LogMaxAgeDays", (std::min)(config.logMaxAgeDays, MAX_LOG_MAX_AGE_DAYS));
+    success &= WriteDWORD(hKey, L"LogKeepFiles", (std::min)(config.logKeepFiles, MAX_LOG_KEEP_FILES));
     success &= WriteDWORD(hKey, L"DarkTheme", config.darkTheme ? 1 : 0);
 
     // If ThemeMode was never explicitly set (still SystemDefault), derive
@@ -141,6 +201,14 @@ bool ConfigManager::SaveConfig(const AppConfig& config)
         trimDays = MAX_HISTORY_AUTO_TRIM_DAYS;
     }
     success &= WriteDWORD(hKey, L"HistoryAutoTrimDays", static_cast<DWORD>(trimDays));
+
+    // Tier lengths are stored as chosen; HistoryLogger makes them consistent
+    success &= WriteDWORD(hKey, L"HistoryRawDays", ClampTierDays(config.historyRawDays));
+    success &= WriteDWORD(hKey, L"HistoryMinuteDays", ClampTierDays(config.historyMinuteDays));
+    success &= WriteDWORD(hKey, L"HistoryHourDays", ClampTierDays(config.historyHourDays));
+    success &= WriteDWORD(hKey, L"HistoryMaxSizeMB", (std::min)(config.historyMaxSizeMB, MAX_HISTORY_SIZE_MB));
+    success &= WriteDWORD(hKey, L"HistoryCoalescePercent",
+                          (std::min)(config.historyCoalescePercent, MAX_HISTORY_COALESCE_PERCENT));
     success &= WriteDWORD(hKey, L"Language", static_cast<DWORD>(config.language));
     success &= WriteString(hKey, L"SelectedInterface", config.selectedInterface);
     success &= WriteDWORD(hKey, L"EnableConnectionNotify", config.enableConnectionNotification ? 1 : 0);
@@ -148,6 +216,8 @@ bool ConfigManager::SaveConfig(const AppConfig& config)
     success &= WriteDWORD(hKey, L"PingIntervalMs", config.pingIntervalMs);
     success &= WriteDWORD(hKey, L"HotkeyModifier", config.hotkeyModifier);
     success &= WriteDWORD(hKey, L"HotkeyKey", config.hotkeyKey);
+    success &= WriteDWORD(hKey, L"BillingCycleStartDay", static_cast<DWORD>(config.billingCycleStartDay));
+    success &= WriteBillingQuotas(config.billingQuotas);
 
     // Save auto-start setting
     success &= SetAutoStart(config.autoStart);
@@ -257,6 +327,76 @@ bool ConfigManager::WriteDWORD(HKEY hKey, const wchar_t* valueName, DWORD value)
     return (result == ERROR_SUCCESS);
 }
 
+bool ConfigManager::ReadBillingQuotas(std::map<std::wstring, unsigned long long>& quotas)
+{
+    HKEY hKey = nullptr;
+    if (RegOpenKeyExW(HKEY_CURRENT_USER, QUOTAS_PATH, 0, KEY_READ, &hKey) != ERROR_SUCCESS)
+    {
+        return false;
+    }
+
+    for (DWORD index = 0;; ++index)
+    {
+        // Value names are interface names; the unnamed default value is the
+        // quota for all interfaces
+        wchar_t name[256] = {0};
+        DWORD nameLength = 256;
+        DWORD type = 0;
+        unsigned long long bytes = 0;
+        DWORD bytesSize = sizeof(bytes);
+
+        LONG result = RegEnumValueW(hKey, index, name, &nameLength, nullptr, &type,
+                                    reinterpret_cast<BYTE*>(&bytes), &bytesSize);
+        if (result == ERROR_NO_MORE_ITEMS)
+        {
+            break;
+        }
+        if (result == ERROR_SUCCESS && type == REG_QWORD && bytes > 0)
+        {
+            quotas[std::wstring(name, nameLength)] = bytes;
+        }
+    }
+
+    RegCloseKey(hKey);
+    return true;
+}
+
+bool ConfigManager::WriteBillingQuotas(const std::map<std::wstring, unsigned long long>& quotas)
+{
+    // Rewrite the key so quotas removed from the map disappear
+    LONG deleted = RegDeleteKeyW(HKEY_CURRENT_USER, QUOTAS_PATH);
+    if (deleted != ERROR_SUCCESS && deleted != ERROR_FILE_NOT_FOUND)
+    {
+        return false;
+    }
+    if (quotas.empty())
+    {
+        return true;
+    }
+
+    HKEY hKey = nullptr;
+    if (RegCreateKeyExW(HKEY_CURRENT_USER, QUOTAS_PATH, 0, nullptr, REG_OPTION_NON_VOLATILE,
+                        KEY_WRITE, nullptr, &hKey, nullptr) != ERROR_SUCCESS)
+    {
+        return false;
+    }
+
+    bool success = true;
+    for (const auto& quota : quotas)
+    {
+        if (quota.second == 0)
+        {
+            continue;
+        }
+        unsigned long long bytes = quota.second;
+        success &= (RegSetValueExW(hKey, quota.first.c_str(), 0, REG_QWORD,
+                                   reinterpret_cast<const BYTE*>(&bytes), sizeof(bytes)) == ERROR_SUCCESS);
+    }
+
+    RegCloseKey(hKey);
+    return success;
+}
+
 std::wstring ConfigManager::ReadString(HKEY hKey, const wchar_t* valueName, const std::wstring& defaultValue)
 {
     wchar_t buffer[256] = {0};
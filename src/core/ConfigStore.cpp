@@ -0,0 +1,104 @@
+// ============================================================================
+// File: ConfigStore.cpp
+// Description: AppConfig published as immutable snapshots, with field-level
+//              change notification
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#include "NetworkMonitor/ConfigStore.h"
+
+namespace NetworkMonitor
+{
+
+ConfigChanges DiffConfig(const AppConfig& before, const AppConfig& after)
+{
+    ConfigChanges changes;
+#define NM_CONFIG_FIELD_DIFF(field, member) \
+    if (!(before.member == after.member))   \
+    {                                       \
+        changes |= ConfigField::field;      \
+    }
+    NM_APP_CONFIG_FIELDS(NM_CONFIG_FIELD_DIFF)
+#undef NM_CONFIG_FIELD_DIFF
+    return changes;
+}
+
+const wchar_t* GetConfigFieldName(ConfigField field)
+{
+    switch (field)
+    {
+#define NM_CONFIG_FIELD_NAME(field, member) \
+    case ConfigField::field:                \
+        return L"" #field;
+        NM_APP_CONFIG_FIELDS(NM_CONFIG_FIELD_NAME)
+#undef NM_CONFIG_FIELD_NAME
+    default:
+        return L"";
+    }
+}
+
+ConfigStore::ConfigStore()
+    : m_current(std::make_shared<const AppConfig>())
+    , m_nextSubscriptionId(1)
+{
+}
+
+ConfigChanges ConfigStore::Publish(const AppConfig& config)
+{
+    ConfigSnapshot before;
+    ConfigSnapshot after;
+    ConfigChanges changes;
+    std::vector<Subscription> subscriptions;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        before = m_current;
+        changes = DiffConfig(*before, config);
+        if (!changes.Any())
+        {
+            return changes;
+        }
+
+        // before keeps the old snapshot alive for the subscribers; it is
+        // freed afterwards unless a Snapshot() owner still holds it
+        after = std::make_shared<const AppConfig>(config);
+        std::atomic_store(&m_current, after);
+
+        // Called unlocked, so a subscriber may subscribe or take a Snapshot()
+        subscriptions = m_subscriptions;
+    }
+
+    for (const Subscription& subscription : subscriptions)
+    {
+        if (subscription.fields.Intersects(changes))
+        {
+            (*subscription.subscriber)(*before, *after, changes);
+        }
+    }
+    return changes;
+}
+
+unsigned int ConfigStore::Subscribe(ConfigChanges fields, Subscriber subscriber)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Subscription subscription;
+    subscription.id = m_nextSubscriptionId++;
+    subscription.fields = fields;
+    subscription.subscriber = std::make_shared<Subscriber>(std::move(subscriber));
+    m_subscriptions.push_back(subscription);
+    return subscription.id;
+}
+
+void ConfigStore::Unsubscribe(unsigned int id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_subscriptions.begin(); it != m_subscriptions.end(); ++it)
+    {
+        if (it->id == id)
+        {
+            m_subscriptions.erase(it);
+            return;
+        }
+    }
+}
+
+} // namespace NetworkMonitor
@@ -0,0 +1,397 @@
+// ============================================================================
+// File: DiagnosticLog.cpp
+// Description: Asynchronous diagnostic log fed through a lock-free ring
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#include "NetworkMonitor/DiagnosticLog.h"
+#include <chrono>
+#include <cstdio>
+
+namespace NetworkMonitor
+{
+
+namespace
+{
+    // Formatted bytes held back before a write is forced
+    constexpr size_t WRITE_BATCH_BYTES = 64 * 1024;
+
+    // Poll while Flush waits on a slot a producer has claimed but not filled
+    constexpr std::chrono::milliseconds PUBLISH_POLL(1);
+
+    constexpr unsigned long long FILETIME_TICKS_PER_SECOND = 10000000ULL;
+
+    unsigned long long RoundUpToPowerOfTwo(unsigned int value)
+    {
+        unsigned long long result = 2;
+        while (result < value)
+        {
+            result <<= 1;
+        }
+        return result;
+    }
+
+}
+
+const char* GetLogLevelName(LogLevel level)
+{
+    return (level == LogLevel::Error) ? "ERROR" : "DEBUG";
+}
+
+std::string FormatLogTimestamp(unsigned long long fileTime)
+{
+    FILETIME utcTime = {};
+    utcTime.dwLowDateTime = static_cast<DWORD>(fileTime & 0xFFFFFFFFULL);
+    utcTime.dwHighDateTime = static_cast<DWORD>(fileTime >> 32);
+    SYSTEMTIME utc = {};
+    SYSTEMTIME local = {};
+    FileTimeToSystemTime(&utcTime, &utc);
+    if (!SystemTimeToTzSpecificLocalTime(nullptr, &utc, &local))
+    {
+        local = utc;
+    }
+
+    char stamp[32] = {0};
+    snprintf(stamp, sizeof(stamp), "%04u-%02u-%02u %02u:%02u:%02u ",
+             local.wYear, local.wMonth, local.wDay, local.wHour, local.wMinute, local.wSecond);
+    return stamp;
+}
+
+void AppendLogTextUtf8(std::string& out, const std::wstring& text)
+{
+    if (text.empty())
+    {
+        return;
+    }
+    int length = static_cast<int>(text.size());
+    int bytes = WideCharToMultiByte(CP_UTF8, 0, text.data(), length, nullptr, 0, nullptr, nullptr);
+    if (bytes <= 0)
+    {
+        return;
+    }
+    size_t offset = out.size();
+    out.resize(offset + static_cast<size_t>(bytes));
+    WideCharToMultiByte(CP_UTF8, 0, text.data(), length, &out[offset], bytes, nullptr, nullptr);
+}
+
+std::wstring FormatDroppedRecordsNotice(unsigned long long dropped)
+{
+    return std::to_wstring(dropped) + L" log records dropped (buffer full)";
+}
+
+DiagnosticLog::DiagnosticLog(const DiagnosticLogOptions& options)
+    : m_mask(RoundUpToPowerOfTwo(options.capacity) - 1)
+    , m_flushIntervalMs(options.flushIntervalMs > 0 ? options.flushIntervalMs : 1)
+    , m_slots(new Slot[static_cast<size_t>(m_mask + 1)])
+    , m_enqueuePos(0)
+    , m_dequeuePos(0)
+    , m_dropped(0)
+    , m_reportedDrops(0)
+    , m_wakePending(false)
+    , m_file(options.path)
+    , m_lastStampSecond(0)
+    , m_wakeRequested(false)
+    , m_stop(false)
+    , m_rotation(options.rotation)
+    , m_rotationChanged(true)
+    , m_flushTarget(0)
+    , m_writtenPos(0)
+{
+    // Slot i is free for the producer that claims position i
+    for (unsigned long long i = 0; i <= m_mask; ++i)
+    {
+        m_slots[static_cast<size_t>(i)].sequence.store(i, std::memory_order_relaxed);
+        m_slots[static_cast<size_t>(i)].level = LogLevel::Debug;
+        m_slots[static_cast<size_t>(i)].time = 0;
+    }
+
+    m_writer = std::thread([this]() { WriterThreadMain(); });
+}
+
+DiagnosticLog::~DiagnosticLog()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+
+    if (m_writer.joinable())
+    {
+        m_writer.join();
+    }
+}
+
+bool DiagnosticLog::Push(LogLevel level, std::wstring message)
+{
+    unsigned long long now = CurrentLogTime();
+
+    // Bounded MPMC ring (one consumer here): a slot whose sequence equals
+    // the position is free, one past it is filled
+    unsigned long long pos = m_enqueuePos.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    for (;;)
+    {
+        slot = &m_slots[static_cast<size_t>(pos & m_mask)];
+        unsigned long long seq = slot->sequence.load(std::memory_order_acquire);
+        long long diff = static_cast<long long>(seq - pos);
+        if (diff == 0)
+        {
+            if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            // Still holds a record from one lap ago: full
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->level = level;
+    slot->time = now;
+    slot->message = std::move(message);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    // Errors go out at once; a ring filling up gets drained before it
+    // overflows. Either way only the first producer pays for the wake.
+    bool urgent = (level == LogLevel::Error) ||
+                  (pos + 1 - m_dequeuePos.load(std::memory_order_relaxed) > (m_mask + 1) / 2);
+    if (urgent && !m_wakePending.exchange(true, std::memory_order_acq_rel))
+    {
+        Wake();
+    }
+    return true;
+}
+
+void DiagnosticLog::Flush()
+{
+    unsigned long long target = m_enqueuePos.load(std::memory_order_acquire);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (target > m_flushTarget)
+    {
+        m_flushTarget = target;
+    }
+    m_wakeRequested = true;
+    m_wake.notify_one();
+    m_progress.wait(lock, [this, target]() { return m_writtenPos >= target || m_stop; });
+}
+
+DiagnosticLogStats DiagnosticLog::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    DiagnosticLogStats stats = m_stats;
+    stats.dropped = m_dropped.load(std::memory_order_relaxed);
+    stats.rotations = m_file.GetStats().rotations;
+    return stats;
+}
+
+void DiagnosticLog::SetRotation(const LogRotationOptions& rotation)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_rotation = rotation;
+    m_rotationChanged = true;
+}
+
+void DiagnosticLog::Wake()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_wakeRequested = true;
+    }
+    m_wake.notify_one();
+}
+
+size_t DiagnosticLog::Drain(std::string& out, bool& sawError)
+{
+    unsigned long long pos = m_dequeuePos.load(std::memory_order_relaxed);
+    size_t count = 0;
+    for (;;)
+    {
+        Slot& slot = m_slots[static_cast<size_t>(pos & m_mask)];
+        if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+        {
+            break;
+        }
+
+        // Local time is worked out once per second, not per record
+        unsigned long long second = slot.time / FILETIME_TICKS_PER_SECOND;
+        if (second != m_lastStampSecond || m_stampPrefix.empty())
+        {
+            m_stampPrefix = FormatLogTimestamp(slot.time);
+            m_lastStampSecond = second;
+        }
+
+        out += m_stampPrefix;
+        out += '[';
+        out += GetLogLevelName(slot.level);
+        out += "] ";
+        AppendLogTextUtf8(out, slot.message);
+        out += "\r\n";
+        sawError = sawError || (slot.level == LogLevel::Error);
+
+        // Take the text so the slot holds no heap block for the next lap
+        std::wstring().swap(slot.message);
+        slot.sequence.store(pos + m_mask + 1, std::memory_order_release);
+        ++pos;
+        ++count;
+    }
+
+    m_dequeuePos.store(pos, std::memory_order_relaxed);
+    return count;
+}
+
+bool DiagnosticLog::WriteOut(std::string& buffer)
+{
+    if (m_file.IsAged())
+    {
+        m_file.Rotate();
+    }
+
+    // Fill each file with whole lines up to its size cap, then rotate.
+    // A failed rotation keeps writing to the current file.
+    bool ok = true;
+    size_t offset = 0;
+    while (ok && offset < buffer.size())
+    {
+        size_t chunk = buffer.size() - offset;
+        unsigned long long room = m_file.GetRoom();
+        if (chunk > room)
+        {
+            size_t end = (room >= 2) ? buffer.rfind("\r\n", offset + static_cast<size_t>(room) - 2) : std::string::npos;
+            if (end != std::string::npos && end >= offset)
+            {
+                chunk = end + 2 - offset;
+            }
+            else if (m_file.IsEmpty())
+            {
+                // A single line longer than the cap gets a file to itself
+                size_t lineEnd = buffer.find("\r\n", offset);
+                chunk = (lineEnd == std::string::npos) ? chunk : lineEnd + 2 - offset;
+            }
+            else if (m_file.Rotate())
+            {
+                continue;
+            }
+        }
+
+        ok = m_file.Append(buffer.data() + offset, chunk);
+        offset += chunk;
+    }
+
+    // Nowhere to report a failure to; the batch is dropped either way
+    buffer.clear();
+    return ok;
+}
+
+void DiagnosticLog::WriterThreadMain()
+{
+    const std::chrono::milliseconds interval(m_flushIntervalMs);
+    std::string buffer;
+    unsigned long long buffered = 0;    // Records in buffer
+    auto lastWrite = std::chrono::steady_clock::now();
+
+    for (;;)
+    {
+        bool stop = false;
+        unsigned long long flushTarget = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            auto timeout = interval;
+            if (m_flushTarget > m_writtenPos)
+            {
+                timeout = PUBLISH_POLL;
+            }
+            else if (!buffer.empty())
+            {
+                auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - lastWrite);
+                timeout = (waited < interval) ? interval - waited : std::chrono::milliseconds(0);
+            }
+            // A producer that found m_wakePending set skipped Wake(); its
+            // record is in the ring even if the wake it relied on was
+            // already consumed
+            m_wake.wait_for(lock, timeout, [this]() {
+                return m_wakeRequested || m_stop || m_wakePending.load(std::memory_order_acquire);
+            });
+            m_wakeRequested = false;
+            stop = m_stop;
+            flushTarget = m_flushTarget;
+            if (m_rotationChanged)
+            {
+                m_file.SetOptions(m_rotation);
+                m_rotationChanged = false;
+            }
+        }
+        // Cleared before draining: a producer that still sees it set
+        // published its record first, so this drain picks it up; one that
+        // sees it clear wakes the writer again
+        m_wakePending.exchange(false, std::memory_order_acq_rel);
+
+        bool sawError = false;
+        size_t drained = Drain(buffer, sawError);
+        if (stop)
+        {
+            // Producers are done; wait out any slot still being filled
+            while (m_dequeuePos.load(std::memory_order_relaxed) != m_enqueuePos.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+                drained += Drain(buffer, sawError);
+            }
+        }
+
+        unsigned long long dropped = m_dropped.load(std::memory_order_relaxed);
+        if (dropped != m_reportedDrops)
+        {
+            buffer += m_stampPrefix.empty() ? FormatLogTimestamp(CurrentLogTime()) : m_stampPrefix;
+            buffer += "[WARN] ";
+            AppendLogTextUtf8(buffer, FormatDroppedRecordsNotice(dropped - m_reportedDrops));
+            buffer += "\r\n";
+            m_reportedDrops = dropped;
+        }
+
+        unsigned long long position = m_dequeuePos.load(std::memory_order_relaxed);
+        auto now = std::chrono::steady_clock::now();
+        bool due = stop || sawError || flushTarget > m_writtenPos ||
+                   buffer.size() >= WRITE_BATCH_BYTES || now - lastWrite >= interval;
+
+        buffered += drained;
+        bool wrote = false;
+        bool writeOk = false;
+        if (due && !buffer.empty())
+        {
+            writeOk = WriteOut(buffer);
+            lastWrite = now;
+            wrote = true;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (wrote)
+            {
+                ++m_stats.writes;
+                m_stats.written += writeOk ? buffered : 0;
+                buffered = 0;
+            }
+            if (buffer.empty())
+            {
+                m_writtenPos = position;
+            }
+        }
+        m_progress.notify_all();
+
+        if (stop)
+        {
+            break;
+        }
+    }
+}
+
+} // namespace NetworkMonitor
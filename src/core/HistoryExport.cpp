@@ -0,0 +1,1078 @@
+// ============================================================================
+// File: HistoryExport.cpp
+// Description: Streaming export/import of usage history to flat files
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#include "NetworkMonitor/HistoryExport.h"
+#include "NetworkMonitor/Utils.h"
+
+#include <charconv>
+#include <cstring>
+#include <cwctype>
+
+namespace NetworkMonitor
+{
+
+namespace
+{
+    constexpr size_t EXPORT_BUFFER_SIZE = 1 << 20;     // 1 MiB write/read buffer
+    constexpr unsigned int COLUMNAR_BLOCK_ROWS = 8192;
+    constexpr char COLUMNAR_MAGIC[4] = { 'N', 'M', 'H', 'X' };
+    constexpr unsigned int COLUMNAR_VERSION = 1;
+    const char CSV_HEADER[] = "timestamp,interface,bytes_down,bytes_up\n";
+
+    std::string WideToUtf8(std::wstring_view text)
+    {
+        std::string result;
+        if (text.empty())
+        {
+            return result;
+        }
+
+        int needed = WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.size()),
+                                         nullptr, 0, nullptr, nullptr);
+        if (needed <= 0)
+        {
+            return result;
+        }
+
+        result.resize(static_cast<size_t>(needed));
+        WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.size()),
+                            &result[0], needed, nullptr, nullptr);
+        return result;
+    }
+
+    // Decode UTF-8 into a reusable buffer; only grows, so steady-state rows
+    // do not allocate.
+    bool Utf8ToWide(std::string_view text, std::wstring& out)
+    {
+        out.clear();
+        if (text.empty())
+        {
+            return true;
+        }
+
+        int needed = MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), nullptr, 0);
+        if (needed <= 0)
+        {
+            return false;
+        }
+
+        out.resize(static_cast<size_t>(needed));
+        MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), &out[0], needed);
+        return true;
+    }
+
+    std::string EscapeCsv(const std::string& utf8)
+    {
+        if (utf8.find_first_of(",\"\r\n") == std::string::npos)
+        {
+            return utf8;
+        }
+
+        std::string quoted = "\"";
+        for (char c : utf8)
+        {
+            if (c == '"')
+            {
+                quoted += '"';
+            }
+            quoted += c;
+        }
+        quoted += '"';
+        return quoted;
+    }
+
+    std::string EscapeJson(const std::string& utf8)
+    {
+        static const char HEX[] = "0123456789abcdef";
+
+        std::string quoted = "\"";
+        for (char c : utf8)
+        {
+            unsigned char uc = static_cast<unsigned char>(c);
+            switch (c)
+            {
+            case '"':  quoted += "\\\""; break;
+            case '\\': quoted += "\\\\"; break;
+            case '\n': quoted += "\\n"; break;
+            case '\r': quoted += "\\r"; break;
+            case '\t': quoted += "\\t"; break;
+            default:
+                if (uc < 0x20)
+                {
+                    quoted += "\\u00";
+                    quoted += HEX[uc >> 4];
+                    quoted += HEX[uc & 0x0F];
+                }
+                else
+                {
+                    quoted += c;
+                }
+                break;
+            }
+        }
+        quoted += '"';
+        return quoted;
+    }
+
+    // Sequential reader over a file with a fixed buffer; hands out lines or
+    // raw byte runs without allocating per call.
+    class ChunkReader
+    {
+    public:
+        ChunkReader()
+            : m_file(INVALID_HANDLE_VALUE)
+            , m_buffer(new char[EXPORT_BUFFER_SIZE])
+            , m_begin(0)
+            , m_end(0)
+            , m_eof(false)
+        {
+        }
+
+        ~ChunkReader()
+        {
+            if (m_file != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(m_file);
+            }
+        }
+
+        bool Open(const std::wstring& path)
+        {
+            m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                 OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            return (m_file != INVALID_HANDLE_VALUE);
+        }
+
+        // Returns false at end of file. A final line without '\n' is returned.
+        bool ReadLine(std::string_view& line, bool& error)
+        {
+            error = false;
+            for (;;)
+            {
+                const char* start = m_buffer.get() + m_begin;
+                const char* newline = static_cast<const char*>(std::memchr(start, '\n', m_end - m_begin));
+                if (newline)
+                {
+                    size_t length = static_cast<size_t>(newline - start);
+                    m_begin += length + 1;
+                    if (length > 0 && start[length - 1] == '\r')
+                    {
+                        --length;
+                    }
+                    line = std::string_view(start, length);
+                    return true;
+                }
+
+                if (m_eof)
+                {
+                    if (m_begin == m_end)
+                    {
+                        return false;
+                    }
+                    line = std::string_view(start, m_end - m_begin);
+                    m_begin = m_end;
+                    return true;
+                }
+
+                if (m_begin == 0 && m_end == EXPORT_BUFFER_SIZE)
+                {
+                    // Line longer than the whole buffer: not a file we wrote.
+                    error = true;
+                    return false;
+                }
+
+                if (!Fill())
+                {
+                    error = true;
+                    return false;
+                }
+            }
+        }
+
+        bool ReadExact(void* destination, size_t length)
+        {
+            char* out = static_cast<char*>(destination);
+            while (length > 0)
+            {
+                if (m_begin == m_end)
+                {
+                    if (m_eof || !Fill())
+                    {
+                        return false;
+                    }
+                    if (m_begin == m_end)
+                    {
+                        return false;
+                    }
+                }
+
+                size_t chunk = (std::min)(length, m_end - m_begin);
+                std::memcpy(out, m_buffer.get() + m_begin, chunk);
+                m_begin += chunk;
+                out += chunk;
+                length -= chunk;
+            }
+            return true;
+        }
+
+    private:
+        bool Fill()
+        {
+            if (m_begin > 0)
+            {
+                std::memmove(m_buffer.get(), m_buffer.get() + m_begin, m_end - m_begin);
+                m_end -= m_begin;
+                m_begin = 0;
+            }
+
+            DWORD read = 0;
+            DWORD wanted = static_cast<DWORD>(EXPORT_BUFFER_SIZE - m_end);
+            if (!ReadFile(m_file, m_buffer.get() + m_end, wanted, &read, nullptr))
+            {
+                return false;
+            }
+
+            if (read == 0)
+            {
+                m_eof = true;
+            }
+            m_end += read;
+            return true;
+        }
+
+        HANDLE m_file;
+        std::unique_ptr<char[]> m_buffer;
+        size_t m_begin;
+        size_t m_end;
+        bool m_eof;
+    };
+
+    template <typename T>
+    bool ParseNumber(std::string_view text, T& value)
+    {
+        const char* first = text.data();
+        const char* last = text.data() + text.size();
+        auto result = std::from_chars(first, last, value);
+        return (result.ec == std::errc() && result.ptr == last);
+    }
+
+    // Split the next CSV field starting at pos, unescaping quoted fields into
+    // scratch. pos is left after the separating comma.
+    bool NextCsvField(std::string_view line, size_t& pos, std::string_view& field, std::string& scratch)
+    {
+        if (pos > line.size())
+        {
+            return false;
+        }
+
+        if (pos < line.size() && line[pos] == '"')
+        {
+            scratch.clear();
+            size_t i = pos + 1;
+            for (;;)
+            {
+                if (i >= line.size())
+                {
+                    return false;
+                }
+                if (line[i] == '"')
+                {
+                    if (i + 1 < line.size() && line[i + 1] == '"')
+                    {
+                        scratch += '"';
+                        i += 2;
+                        continue;
+                    }
+                    ++i;
+                    break;
+                }
+                scratch += line[i++];
+            }
+
+            field = scratch;
+            pos = (i < line.size() && line[i] == ',') ? i + 1 : line.size() + 1;
+            return true;
+        }
+
+        size_t comma = line.find(',', pos);
+        if (comma == std::string_view::npos)
+        {
+            field = line.substr(pos);
+            pos = line.size() + 1;
+        }
+        else
+        {
+            field = line.substr(pos, comma - pos);
+            pos = comma + 1;
+        }
+        return true;
+    }
+
+    void AppendUtf8(std::string& out, unsigned int codePoint)
+    {
+        if (codePoint < 0x80)
+        {
+            out += static_cast<char>(codePoint);
+        }
+        else if (codePoint < 0x800)
+        {
+            out += static_cast<char>(0xC0 | (codePoint >> 6));
+            out += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        else if (codePoint < 0x10000)
+        {
+            out += static_cast<char>(0xE0 | (codePoint >> 12));
+            out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        else
+        {
+            out += static_cast<char>(0xF0 | (codePoint >> 18));
+            out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+    }
+
+    bool ParseHex4(std::string_view text, size_t pos, unsigned int& value)
+    {
+        if (pos + 4 > text.size())
+        {
+            return false;
+        }
+        auto result = std::from_chars(text.data() + pos, text.data() + pos + 4, value, 16);
+        return (result.ec == std::errc() && result.ptr == text.data() + pos + 4);
+    }
+
+    size_t SkipJsonSpace(std::string_view line, size_t pos)
+    {
+        while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t' || line[pos] == '\r'))
+        {
+            ++pos;
+        }
+        return pos;
+    }
+
+    // Offset just past the string starting at pos (an opening quote), or npos
+    size_t SkipJsonString(std::string_view line, size_t pos)
+    {
+        for (size_t i = pos + 1; i < line.size(); ++i)
+        {
+            if (line[i] == '\\')
+            {
+                ++i;
+            }
+            else if (line[i] == '"')
+            {
+                return i + 1;
+            }
+        }
+        return std::string_view::npos;
+    }
+
+    // Offset of the ',' or '}' ending the member value at pos, or npos
+    size_t SkipJsonValue(std::string_view line, size_t pos)
+    {
+        int depth = 0;
+        while (pos < line.size())
+        {
+            char c = line[pos];
+            if (c == '"')
+            {
+                pos = SkipJsonString(line, pos);
+                if (pos == std::string_view::npos)
+                {
+                    return pos;
+                }
+                continue;
+            }
+            if (c == '{' || c == '[')
+            {
+                ++depth;
+            }
+            else if ((c == '}' || c == ']') && depth > 0)
+            {
+                --depth;
+            }
+            else if (depth == 0 && (c == ',' || c == '}'))
+            {
+                return pos;
+            }
+            ++pos;
+        }
+        return std::string_view::npos;
+    }
+
+    // Walk the members of the one-object JSON line and return the offset of
+    // the value whose key is exactly `key`. Keys are only read in key
+    // position, so a string value that spells a key name is never matched.
+    bool FindJsonValue(std::string_view line, std::string_view key, size_t& valuePos)
+    {
+        size_t pos = SkipJsonSpace(line, 0);
+        if (pos >= line.size() || line[pos] != '{')
+        {
+            return false;
+        }
+
+        for (;;)
+        {
+            pos = SkipJsonSpace(line, pos + 1);
+            if (pos >= line.size() || line[pos] != '"')
+            {
+                return false;
+            }
+
+            size_t keyEnd = SkipJsonString(line, pos);
+            if (keyEnd == std::string_view::npos)
+            {
+                return false;
+            }
+            std::string_view name = line.substr(pos + 1, keyEnd - pos - 2);
+
+            pos = SkipJsonSpace(line, keyEnd);
+            if (pos >= line.size() || line[pos] != ':')
+            {
+                return false;
+            }
+            pos = SkipJsonSpace(line, pos + 1);
+
+            if (name == key)
+            {
+                valuePos = pos;
+                return true;
+            }
+
+            pos = SkipJsonValue(line, pos);
+            if (pos == std::string_view::npos || line[pos] != ',')
+            {
+                return false;
+            }
+        }
+    }
+
+    bool ParseJsonNumber(std::string_view line, std::string_view key, unsigned long long& value)
+    {
+        size_t pos = 0;
+        if (!FindJsonValue(line, key, pos))
+        {
+            return false;
+        }
+
+        size_t end = pos;
+        while (end < line.size() && line[end] >= '0' && line[end] <= '9')
+        {
+            ++end;
+        }
+        return ParseNumber(line.substr(pos, end - pos), value);
+    }
+
+    bool ParseJsonString(std::string_view line, std::string_view key, std::string& scratch)
+    {
+        size_t pos = 0;
+        if (!FindJsonValue(line, key, pos) || pos >= line.size() || line[pos] != '"')
+        {
+            return false;
+        }
+
+        scratch.clear();
+        for (size_t i = pos + 1; i < line.size(); ++i)
+        {
+            char c = line[i];
+            if (c == '"')
+            {
+                return true;
+            }
+            if (c != '\\')
+            {
+                scratch += c;
+                continue;
+            }
+
+            if (++i >= line.size())
+            {
+                return false;
+            }
+
+            switch (line[i])
+            {
+            case '"':  scratch += '"'; break;
+            case '\\': scratch += '\\'; break;
+            case '/':  scratch += '/'; break;
+            case 'b':  scratch += '\b'; break;
+            case 'f':  scratch += '\f'; break;
+            case 'n':  scratch += '\n'; break;
+            case 'r':  scratch += '\r'; break;
+            case 't':  scratch += '\t'; break;
+            case 'u':
+            {
+                unsigned int codePoint = 0;
+                if (!ParseHex4(line, i + 1, codePoint))
+                {
+                    return false;
+                }
+                i += 4;
+
+                if (codePoint >= 0xD800 && codePoint <= 0xDBFF &&
+                    i + 2 < line.size() && line[i + 1] == '\\' && line[i + 2] == 'u')
+                {
+                    unsigned int low = 0;
+                    if (ParseHex4(line, i + 3, low) && low >= 0xDC00 && low <= 0xDFFF)
+                    {
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    }
+                }
+                AppendUtf8(scratch, codePoint);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+
+        return false;
+    }
+
+    bool ReadTextExport(const std::wstring& path,
+                        HistoryExportFormat format,
+                        const HistorySampleVisitor& visitor)
+    {
+        ChunkReader reader;
+        if (!reader.Open(path))
+        {
+            NM_LOG_ERROR(L"ReadHistoryExport: cannot open " + path + L": " + GetLastErrorString());
+            return false;
+        }
+
+        std::string textScratch;
+        std::wstring wideScratch;
+        HistorySampleView row = {};
+        long long ordinal = 0;
+        bool firstLine = true;
+
+        std::string_view line;
+        bool error = false;
+        while (reader.ReadLine(line, error))
+        {
+            if (line.empty())
+            {
+                continue;
+            }
+
+            if (firstLine)
+            {
+                firstLine = false;
+                if (format == HistoryExportFormat::Csv && line.substr(0, 9) == "timestamp")
+                {
+                    continue;
+                }
+            }
+
+            std::string_view ifaceUtf8;
+            unsigned long long ts = 0;
+            bool ok = false;
+
+            if (format == HistoryExportFormat::Csv)
+            {
+                size_t pos = 0;
+                std::string_view field;
+                ok = NextCsvField(line, pos, field, textScratch) && ParseNumber(field, ts) &&
+                     NextCsvField(line, pos, ifaceUtf8, textScratch);
+
+                std::string_view downField;
+                std::string_view upField;
+                std::string unused;
+                ok = ok && NextCsvField(line, pos, downField, unused) && ParseNumber(downField, row.bytesDown) &&
+                     NextCsvField(line, pos, upField, unused) && ParseNumber(upField, row.bytesUp);
+            }
+            else
+            {
+                ok = ParseJsonNumber(line, "timestamp", ts) &&
+                     ParseJsonString(line, "interface", textScratch) &&
+                     ParseJsonNumber(line, "bytes_down", row.bytesDown) &&
+                     ParseJsonNumber(line, "bytes_up", row.bytesUp);
+                ifaceUtf8 = textScratch;
+            }
+
+            if (!ok || !Utf8ToWide(ifaceUtf8, wideScratch))
+            {
+                NM_LOG_ERROR(L"ReadHistoryExport: malformed row " + std::to_wstring(ordinal + 1) + L" in " + path);
+                return false;
+            }
+
+            row.id = ++ordinal;
+            row.timestamp = static_cast<std::time_t>(ts);
+            row.interfaceName = wideScratch;
+
+            if (!visitor(row))
+            {
+                return true;
+            }
+        }
+
+        if (error)
+        {
+            NM_LOG_ERROR(L"ReadHistoryExport: read failed for " + path);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool ReadColumnarExport(const std::wstring& path, const HistorySampleVisitor& visitor)
+    {
+        ChunkReader reader;
+        if (!reader.Open(path))
+        {
+            NM_LOG_ERROR(L"ReadHistoryExport: cannot open " + path + L": " + GetLastErrorString());
+            return false;
+        }
+
+        char magic[4] = {};
+        unsigned int version = 0;
+        if (!reader.ReadExact(magic, sizeof(magic)) || std::memcmp(magic, COLUMNAR_MAGIC, sizeof(magic)) != 0 ||
+            !reader.ReadExact(&version, sizeof(version)) || version != COLUMNAR_VERSION)
+        {
+            NM_LOG_ERROR(L"ReadHistoryExport: not a columnar history file: " + path);
+            return false;
+        }
+
+        std::vector<std::wstring> dictionary;
+        std::string nameScratch;
+        std::unique_ptr<long long[]> timestamps(new long long[COLUMNAR_BLOCK_ROWS]);
+        std::unique_ptr<unsigned int[]> interfaces(new unsigned int[COLUMNAR_BLOCK_ROWS]);
+        std::unique_ptr<unsigned long long[]> down(new unsigned long long[COLUMNAR_BLOCK_ROWS]);
+        std::unique_ptr<unsigned long long[]> up(new unsigned long long[COLUMNAR_BLOCK_ROWS]);
+
+        HistorySampleView row = {};
+        long long ordinal = 0;
+
+        for (;;)
+        {
+            unsigned int rows = 0;
+            unsigned int newNames = 0;
+            if (!reader.ReadExact(&rows, sizeof(rows)) || !reader.ReadExact(&newNames, sizeof(newNames)) ||
+                rows > COLUMNAR_BLOCK_ROWS)
+            {
+                NM_LOG_ERROR(L"ReadHistoryExport: truncated block header in " + path);
+                return false;
+            }
+
+            for (unsigned int i = 0; i < newNames; ++i)
+            {
+                unsigned int length = 0;
+                if (!reader.ReadExact(&length, sizeof(length)) || length > 4096)
+                {
+                    return false;
+                }
+                nameScratch.resize(length);
+                if (length > 0 && !reader.ReadExact(&nameScratch[0], length))
+                {
+                    return false;
+                }
+                dictionary.emplace_back();
+                Utf8ToWide(nameScratch, dictionary.back());
+            }
+
+            if (rows == 0)
+            {
+                return true;
+            }
+
+            if (!reader.ReadExact(timestamps.get(), rows * sizeof(long long)) ||
+                !reader.ReadExact(interfaces.get(), rows * sizeof(unsigned int)) ||
+                !reader.ReadExact(down.get(), rows * sizeof(unsigned long long)) ||
+                !reader.ReadExact(up.get(), rows * sizeof(unsigned long long)))
+            {
+                NM_LOG_ERROR(L"ReadHistoryExport: truncated block in " + path);
+                return false;
+            }
+
+            for (unsigned int i = 0; i < rows; ++i)
+            {
+                if (interfaces[i] >= dictionary.size())
+                {
+                    NM_LOG_ERROR(L"ReadHistoryExport: bad interface id in " + path);
+                    return false;
+                }
+
+                row.id = ++ordinal;
+                row.timestamp = static_cast<std::time_t>(timestamps[i]);
+                row.interfaceName = dictionary[interfaces[i]];
+                row.bytesDown = down[i];
+                row.bytesUp = up[i];
+
+                if (!visitor(row))
+                {
+                    return true;
+                }
+            }
+        }
+    }
+}
+
+bool ParseHistoryExportFormat(const std::wstring& name, HistoryExportFormat& format)
+{
+    std::wstring lower = name;
+    for (auto& c : lower)
+    {
+        c = static_cast<wchar_t>(std::towlower(c));
+    }
+
+    if (lower == L"csv")
+    {
+        format = HistoryExportFormat::Csv;
+        return true;
+    }
+    if (lower == L"ndjson" || lower == L"jsonl" || lower == L"json")
+    {
+        format = HistoryExportFormat::JsonLines;
+        return true;
+    }
+    if (lower == L"columnar" || lower == L"nmhx" || lower == L"binary")
+    {
+        format = HistoryExportFormat::Columnar;
+        return true;
+    }
+    return false;
+}
+
+const wchar_t* HistoryExportExtension(HistoryExportFormat format)
+{
+    switch (format)
+    {
+    case HistoryExportFormat::JsonLines:
+        return L"ndjson";
+    case HistoryExportFormat::Columnar:
+        return L"nmhx";
+    case HistoryExportFormat::Csv:
+    default:
+        return L"csv";
+    }
+}
+
+// ============================================================================
+// HistoryExportWriter
+// ============================================================================
+
+HistoryExportWriter::HistoryExportWriter()
+    : m_file(INVALID_HANDLE_VALUE)
+    , m_format(HistoryExportFormat::Csv)
+    , m_bufferUsed(0)
+    , m_rowCount(0)
+    , m_failed(false)
+    , m_lastInterface(0)
+    , m_dictionaryWritten(0)
+    , m_blockRows(0)
+{
+}
+
+HistoryExportWriter::~HistoryExportWriter()
+{
+    if (m_file != INVALID_HANDLE_VALUE)
+    {
+        Close();
+    }
+}
+
+bool HistoryExportWriter::Open(const std::wstring& path, HistoryExportFormat format)
+{
+    if (m_file != INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    m_file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                         FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        NM_LOG_ERROR(L"HistoryExportWriter::Open: CreateFileW failed for " + path + L": " + GetLastErrorString());
+        return false;
+    }
+
+    m_format = format;
+    m_buffer.reset(new char[EXPORT_BUFFER_SIZE]);
+    m_bufferUsed = 0;
+    m_rowCount = 0;
+    m_failed = false;
+    m_interfaces.clear();
+    m_lastInterface = 0;
+    m_dictionaryWritten = 0;
+    m_blockRows = 0;
+
+    switch (format)
+    {
+    case HistoryExportFormat::Csv:
+        Append(CSV_HEADER, sizeof(CSV_HEADER) - 1);
+        break;
+
+    case HistoryExportFormat::Columnar:
+        m_blockTimestamps.reset(new long long[COLUMNAR_BLOCK_ROWS]);
+        m_blockInterfaces.reset(new unsigned int[COLUMNAR_BLOCK_ROWS]);
+        m_blockDown.reset(new unsigned long long[COLUMNAR_BLOCK_ROWS]);
+        m_blockUp.reset(new unsigned long long[COLUMNAR_BLOCK_ROWS]);
+        Append(COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC));
+        Append(reinterpret_cast<const char*>(&COLUMNAR_VERSION), sizeof(COLUMNAR_VERSION));
+        break;
+
+    case HistoryExportFormat::JsonLines:
+    default:
+        break;
+    }
+
+    return !m_failed;
+}
+
+bool HistoryExportWriter::Write(const HistorySampleView& row)
+{
+    if (m_file == INVALID_HANDLE_VALUE || m_failed)
+    {
+        return false;
+    }
+
+    size_t ifaceIndex = InternInterface(row.interfaceName);
+    bool ok = false;
+
+    switch (m_format)
+    {
+    case HistoryExportFormat::Csv:
+        ok = WriteCsv(row, m_interfaces[ifaceIndex]);
+        break;
+    case HistoryExportFormat::JsonLines:
+        ok = WriteJsonLine(row, m_interfaces[ifaceIndex]);
+        break;
+    case HistoryExportFormat::Columnar:
+        ok = WriteColumnar(row, static_cast<unsigned int>(ifaceIndex));
+        break;
+    }
+
+    if (ok)
+    {
+        ++m_rowCount;
+    }
+    return ok;
+}
+
+bool HistoryExportWriter::Close()
+{
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    if (m_format == HistoryExportFormat::Columnar)
+    {
+        FlushColumnarBlock();
+
+        // Terminator block: zero rows, zero new dictionary entries
+        const unsigned int terminator[2] = { 0, 0 };
+        Append(reinterpret_cast<const char*>(terminator), sizeof(terminator));
+    }
+
+    FlushBuffer();
+    CloseHandle(m_file);
+    m_file = INVALID_HANDLE_VALUE;
+    m_buffer.reset();
+
+    return !m_failed;
+}
+
+bool HistoryExportWriter::WriteCsv(const HistorySampleView& row, const InterfaceEntry& iface)
+{
+    char line[96];
+    char* out = line;
+    char* end = line + sizeof(line);
+
+    out = std::to_chars(out, end, static_cast<long long>(row.timestamp)).ptr;
+    *out++ = ',';
+    if (!Append(line, static_cast<size_t>(out - line)) || !Append(iface.csv.data(), iface.csv.size()))
+    {
+        return false;
+    }
+
+    out = line;
+    *out++ = ',';
+    out = std::to_chars(out, end, row.bytesDown).ptr;
+    *out++ = ',';
+    out = std::to_chars(out, end, row.bytesUp).ptr;
+    *out++ = '\n';
+    return Append(line, static_cast<size_t>(out - line));
+}
+
+bool HistoryExportWriter::WriteJsonLine(const HistorySampleView& row, const InterfaceEntry& iface)
+{
+    static const char TS_KEY[] = "{\"timestamp\":";
+    static const char IFACE_KEY[] = ",\"interface\":";
+    static const char DOWN_KEY[] = ",\"bytes_down\":";
+    static const char UP_KEY[] = ",\"bytes_up\":";
+
+    char line[128];
+    char* out = line;
+    char* end = line + sizeof(line);
+
+    std::memcpy(out, TS_KEY, sizeof(TS_KEY) - 1);
+    out += sizeof(TS_KEY) - 1;
+    out = std::to_chars(out, end, static_cast<long long>(row.timestamp)).ptr;
+    std::memcpy(out, IFACE_KEY, sizeof(IFACE_KEY) - 1);
+    out += sizeof(IFACE_KEY) - 1;
+    if (!Append(line, static_cast<size_t>(out - line)) || !Append(iface.json.data(), iface.json.size()))
+    {
+        return false;
+    }
+
+    out = line;
+    std::memcpy(out, DOWN_KEY, sizeof(DOWN_KEY) - 1);
+    out += sizeof(DOWN_KEY) - 1;
+    out = std::to_chars(out, end, row.bytesDown).ptr;
+    std::memcpy(out, UP_KEY, sizeof(UP_KEY) - 1);
+    out += sizeof(UP_KEY) - 1;
+    out = std::to_chars(out, end, row.bytesUp).ptr;
+    *out++ = '}';
+    *out++ = '\n';
+    return Append(line, static_cast<size_t>(out - line));
+}
+
+bool HistoryExportWriter::WriteColumnar(const HistorySampleView& row, unsigned int ifaceId)
+{
+    m_blockTimestamps[m_blockRows] = static_cast<long long>(row.timestamp);
+    m_blockInterfaces[m_blockRows] = ifaceId;
+    m_blockDown[m_blockRows] = row.bytesDown;
+    m_blockUp[m_blockRows] = row.bytesUp;
+    ++m_blockRows;
+
+    if (m_blockRows == COLUMNAR_BLOCK_ROWS)
+    {
+        return FlushColumnarBlock();
+    }
+    return true;
+}
+
+bool HistoryExportWriter::FlushColumnarBlock()
+{
+    unsigned int header[2] = { m_blockRows, static_cast<unsigned int>(m_interfaces.size() - m_dictionaryWritten) };
+    if (m_blockRows == 0 && header[1] == 0)
+    {
+        return true;
+    }
+
+    Append(reinterpret_cast<const char*>(header), sizeof(header));
+
+    for (; m_dictionaryWritten < m_interfaces.size(); ++m_dictionaryWritten)
+    {
+        const std::string& name = m_interfaces[m_dictionaryWritten].utf8;
+        unsigned int length = static_cast<unsigned int>(name.size());
+        Append(reinterpret_cast<const char*>(&length), sizeof(length));
+        Append(name.data(), name.size());
+    }
+
+    Append(reinterpret_cast<const char*>(m_blockTimestamps.get()), m_blockRows * sizeof(long long));
+    Append(reinterpret_cast<const char*>(m_blockInterfaces.get()), m_blockRows * sizeof(unsigned int));
+    Append(reinterpret_cast<const char*>(m_blockDown.get()), m_blockRows * sizeof(unsigned long long));
+    Append(reinterpret_cast<const char*>(m_blockUp.get()), m_blockRows * sizeof(unsigned long long));
+
+    m_blockRows = 0;
+    return !m_failed;
+}
+
+size_t HistoryExportWriter::InternInterface(std::wstring_view name)
+{
+    // Rows usually repeat the previous interface; check that first.
+    if (m_lastInterface < m_interfaces.size() && m_interfaces[m_lastInterface].name == name)
+    {
+        return m_lastInterface;
+    }
+
+    for (size_t i = 0; i < m_interfaces.size(); ++i)
+    {
+        if (m_interfaces[i].name == name)
+        {
+            m_lastInterface = i;
+            return i;
+        }
+    }
+
+    InterfaceEntry entry;
+    entry.name.assign(name.data(), name.size());
+    entry.utf8 = WideToUtf8(name);
+    entry.csv = EscapeCsv(entry.utf8);
+    entry.json = EscapeJson(entry.utf8);
+    m_interfaces.push_back(std::move(entry));
+
+    m_lastInterface = m_interfaces.size() - 1;
+    return m_lastInterface;
+}
+
+bool HistoryExportWriter::Append(const char* data, size_t length)
+{
+    if (m_failed)
+    {
+        return false;
+    }
+
+    if (m_bufferUsed + length > EXPORT_BUFFER_SIZE)
+    {
+        if (!FlushBuffer())
+        {
+            return false;
+        }
+    }
+
+    if (length > EXPORT_BUFFER_SIZE)
+    {
+        // Oversized payload (large columnar block): write straight through.
+        DWORD written = 0;
+        if (!WriteFile(m_file, data, static_cast<DWORD>(length), &written, nullptr) || written != length)
+        {
+            NM_LOG_ERROR(L"HistoryExportWriter::Append: WriteFile failed: " + GetLastErrorString());
+            m_failed = true;
+            return false;
+        }
+        return true;
+    }
+
+    std::memcpy(m_buffer.get() + m_bufferUsed, data, length);
+    m_bufferUsed += length;
+    return true;
+}
+
+bool HistoryExportWriter::FlushBuffer()
+{
+    if (m_bufferUsed == 0)
+    {
+        return !m_failed;
+    }
+
+    DWORD written = 0;
+    if (!WriteFile(m_file, m_buffer.get(), static_cast<DWORD>(m_bufferUsed), &written, nullptr) ||
+        written != m_bufferUsed)
+    {
+        NM_LOG_ERROR(L"HistoryExportWriter::FlushBuffer: WriteFile failed: " + GetLastErrorString());
+        m_failed = true;
+        return false;
+    }
+
+    m_bufferUsed = 0;
+    return true;
+}
+
+bool ReadHistoryExport(const std::wstring& path,
+                       HistoryExportFormat format,
+                       const HistorySampleVisitor& visitor)
+{
+    if (!visitor)
+    {
+        return false;
+    }
+
+    if (format == HistoryExportFormat::Columnar)
+    {
+        return ReadColumnarExport(path, visitor);
+    }
+
+    return ReadTextExport(path, format, visitor);
+}
+
+} // namespace NetworkMonitor
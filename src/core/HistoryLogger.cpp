@@ -5,507 +5,4148 @@
 // ============================================================================
 
 #include "NetworkMonitor/HistoryLogger.h"
+#include "NetworkMonitor/BinaryLog.h"
+#include "NetworkMonitor/HistoryExport.h"
+#include "NetworkMonitor/HistoryStatistics.h"
+#include "NetworkMonitor/LocalCalendar.h"
+#include "NetworkMonitor/Units.h"
 #include "NetworkMonitor/Utils.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cwchar>   // wcsrchr
 #include <ctime>
+#include <limits>
+#include <map>
+#include <queue>
 #include <string>
+#include <unordered_map>
 #include "sqlite3.h"
 
 namespace NetworkMonitor
 {
 
+namespace
+{
+    // Idle read-only connections kept open between queries
+    constexpr size_t MAX_IDLE_READERS = 4;
+
+    // Granularity of the usage_minute rollup table
+    constexpr long long ROLLUP_SECONDS = 60;
+
+    const char* const ROLLUP_UPSERT_SQL =
+        "INSERT INTO usage_minute (minute_start, interface, bytes_down, bytes_up) VALUES (?, ?, ?, ?) "
+        "ON CONFLICT (minute_start, interface) DO UPDATE SET "
+        "bytes_down = bytes_down + excluded.bytes_down, bytes_up = bytes_up + excluded.bytes_up;";
+
+    long long RollupStart(long long timestamp)
+    {
+        long long offset = timestamp % ROLLUP_SECONDS;
+        return timestamp - ((offset < 0) ? offset + ROLLUP_SECONDS : offset);
+    }
+
+    // First minute boundary at or after timestamp
+    long long RollupCeil(long long timestamp)
+    {
+        return RollupStart(timestamp + ROLLUP_SECONDS - 1);
+    }
+
+    // One row per interface holding its latest cycle. A sample from a later
+    // cycle starts the row over; one from an earlier cycle (a backfill)
+    // leaves it alone.
+    const char* const BILLING_UPSERT_SQL =
+        "INSERT INTO billing_cycle (interface, cycle_start, bytes_down, bytes_up) VALUES (?1, ?2, ?3, ?4) "
+        "ON CONFLICT (interface) DO UPDATE SET "
+        "bytes_down = CASE WHEN excluded.cycle_start > cycle_start THEN excluded.bytes_down "
+        "WHEN excluded.cycle_start = cycle_start THEN bytes_down + excluded.bytes_down ELSE bytes_down END, "
+        "bytes_up = CASE WHEN excluded.cycle_start > cycle_start THEN excluded.bytes_up "
+        "WHEN excluded.cycle_start = cycle_start THEN bytes_up + excluded.bytes_up ELSE bytes_up END, "
+        "cycle_start = MAX(cycle_start, excluded.cycle_start);";
+
+    // Traffic history behind the time-of-day usage profile
+    constexpr long long BILLING_PROFILE_SECONDS = 7LL * 24 * 60 * 60;
+
+    // Run statements binding ?1 and ?2 in one transaction on the writer
+    // connection, or in the caller's if one is open; rolls back on the
+    // first failure. changes, if given, receives the rows each statement
+    // changed.
+    bool RunBoundStatements(sqlite3* db, const char* const* statements, size_t count,
+                            long long param1, long long param2, const wchar_t* caller,
+                            long long* changes = nullptr)
+    {
+        bool owned = (sqlite3_get_autocommit(db) != 0);
+        if (owned)
+        {
+            sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            sqlite3_stmt* stmt = nullptr;
+            int rc = sqlite3_prepare_v2(db, statements[i], -1, &stmt, nullptr);
+            if (rc != SQLITE_OK || !stmt)
+            {
+                NM_LOG_ERROR(std::wstring(caller) + L": sqlite3_prepare_v2 failed, rc=" + std::to_wstring(rc));
+                sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+                return false;
+            }
+
+            // Statements that use fewer parameters just ignore the extra bind
+            sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(param1));
+            sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(param2));
+
+            rc = sqlite3_step(stmt);
+            sqlite3_finalize(stmt);
+            if (changes)
+            {
+                changes[i] = sqlite3_changes(db);
+            }
+
+            if (rc != SQLITE_DONE && rc != SQLITE_OK)
+            {
+                // A maintenance chunk stopped at its deadline is not an error
+                if (rc != SQLITE_INTERRUPT)
+                {
+                    NM_LOG_ERROR(std::wstring(caller) + L": sqlite3_step failed, rc=" + std::to_wstring(rc));
+                }
+                sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+                return false;
+            }
+        }
+        return !owned || sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    }
+
+    // Sequence number of the last write queued by the calling thread, used
+    // to give each thread read-your-writes without waiting on other threads.
+    thread_local unsigned long long t_lastQueuedSeq = 0;
+
+    // Cancel flag of the async query running on this thread, if any.
+    // Connections leased while it is set check it every few thousand VM
+    // steps and interrupt the statement once it is raised.
+    thread_local const std::atomic<bool>* t_queryCancel = nullptr;
+
+    // Snapshot open on this thread, if any: ReadLease hands out its
+    // connection instead of a pooled one while the owner matches.
+    thread_local const HistoryLogger* t_snapshotOwner = nullptr;
+    thread_local sqlite3* t_snapshotDb = nullptr;
+
+    constexpr int QUERY_PROGRESS_STEPS = 1000;
+
+    int QueryProgressHandler(void* cancel)
+    {
+        return static_cast<const std::atomic<bool>*>(cancel)->load(std::memory_order_relaxed) ? 1 : 0;
+    }
+
+    // Step failure of a read query. SQLITE_INTERRUPT is a cancelled async
+    // query, not an error.
+    void LogReadStepError(const std::wstring& message, int rc)
+    {
+        if (rc != SQLITE_INTERRUPT)
+        {
+            NM_LOG_ERROR(message + std::to_wstring(rc));
+        }
+    }
+
+    // Idle maintenance runs once neither the writer nor a reader has been
+    // busy for this long
+    constexpr auto MAINTENANCE_QUIET = std::chrono::milliseconds(250);
+
+    // Writer wake-up interval while maintenance is pending, and otherwise
+    constexpr auto MAINTENANCE_POLL = std::chrono::milliseconds(50);
+    constexpr auto MAINTENANCE_IDLE_POLL = std::chrono::seconds(5);
+
+    // Idle slices checkpoint once this many WAL frames are pending, or any
+    // pending frames after the interval, so a steady trickle of samples does
+    // not cost two fsyncs every second
+    constexpr int MAINTENANCE_CHECKPOINT_FRAMES = 256;
+    constexpr auto MAINTENANCE_CHECKPOINT_INTERVAL = std::chrono::seconds(30);
+
+    // The commit hook checkpoints inline past this many frames, as SQLite's
+    // automatic checkpoint (which the hook replaces) does by default
+    constexpr int WAL_BACKSTOP_CHECKPOINT_FRAMES = 1000;
+
+    // PRAGMA optimize interval when no bulk change makes it due sooner
+    constexpr auto MAINTENANCE_OPTIMIZE_INTERVAL = std::chrono::hours(12);
+
+    // Slices in a row PRAGMA optimize may run out of time before it is
+    // skipped until the next interval
+    constexpr int MAINTENANCE_OPTIMIZE_ATTEMPTS = 3;
+
+    // Rows ANALYZE samples per index, keeping PRAGMA optimize to a few ms
+    constexpr int MAINTENANCE_ANALYSIS_LIMIT = 400;
+
+    // A retention or vacuum chunk still running this long past the slice
+    // deadline (a cold page cache, the thread preempted) is interrupted and
+    // rolled back, checked every MAINTENANCE_PROGRESS_STEPS VM steps. BEGIN,
+    // COMMIT and ROLLBACK take far fewer steps, so they are never cut off.
+    constexpr auto MAINTENANCE_SLICE_GRACE = std::chrono::microseconds(500);
+    constexpr int MAINTENANCE_PROGRESS_STEPS = 100;
+
+    // Largest incremental_vacuum chunk; chunks are sized from the speed of
+    // the last one
+    constexpr long long VACUUM_MAX_CHUNK_PAGES = 8192;
+
+    // Files created before auto_vacuum=INCREMENTAL need one full VACUUM to
+    // switch; it is only worth it once this many pages, and a quarter of
+    // the file, are free
+    constexpr long long VACUUM_CONVERT_MIN_FREE_PAGES = 1024;
+
+    // The WAL is truncated back to this size after a checkpoint resets it
+    constexpr long long WAL_SIZE_LIMIT_BYTES = 4LL * 1024 * 1024;
+
+    // Single integer result of a PRAGMA, or -1
+    long long QueryPragmaInt(sqlite3* db, const char* sql)
+    {
+        long long value = -1;
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK)
+        {
+            if (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                value = sqlite3_column_int64(stmt, 0);
+            }
+            sqlite3_finalize(stmt);
+        }
+        return value;
+    }
+
+    int DeadlineProgressHandler(void* deadline)
+    {
+        return (std::chrono::steady_clock::now() >= *static_cast<std::chrono::steady_clock::time_point*>(deadline))
+                   ? 1 : 0;
+    }
+
+    unsigned long long MicrosecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return static_cast<unsigned long long>(
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    // Rows one retention chunk removes from a tier, in its own transaction.
+    // Chunks are sized from the speed of the last one, like vacuum chunks;
+    // a full chunk of index and table b-tree updates takes a few ms.
+    constexpr long long RETENTION_MAX_CHUNK_ROWS = 1000;
+    constexpr long long RETENTION_MIN_CHUNK_ROWS = 16;
+
+    // The retention policy is checked again this often, as rows age past
+    // it, when no change to the policy or the data prompts it sooner
+    constexpr auto RETENTION_CHECK_INTERVAL = std::chrono::minutes(10);
+
+    // Tier floors only move forward: raw rows are complete from raw_floor
+    // on, minutes from minute_floor on
+    const char* const RAW_FLOOR_SQL =
+        "INSERT INTO retention_state (id, raw_floor, minute_floor) VALUES (1, ?1, 0) "
+        "ON CONFLICT (id) DO UPDATE SET raw_floor = MAX(raw_floor, excluded.raw_floor);";
+    const char* const MINUTE_FLOOR_SQL =
+        "INSERT INTO retention_state (id, raw_floor, minute_floor) VALUES (1, 0, ?1) "
+        "ON CONFLICT (id) DO UPDATE SET minute_floor = MAX(minute_floor, excluded.minute_floor);";
+
+    // Single integer result of a query binding ?1 and ?2; false if it
+    // returned no row or NULL
+    bool QueryBoundInt(sqlite3* db, const char* sql, long long param1, long long param2, long long& value)
+    {
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK || !stmt)
+        {
+            return false;
+        }
+        sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(param1));
+        sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(param2));
+        bool found = (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL);
+        if (found)
+        {
+            value = static_cast<long long>(sqlite3_column_int64(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+        return found;
+    }
+
+    // Keeps the tier floors and the scans that rely on them in one read
+    // transaction, so a retention chunk committing in between cannot
+    // drop or double-count a range. Leaves a caller's open transaction be.
+    class ReadSnapshot
+    {
+    public:
+        explicit ReadSnapshot(sqlite3* db)
+            : m_db(db)
+            , m_owned(sqlite3_get_autocommit(db) != 0 &&
+                      sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr) == SQLITE_OK)
+        {
+        }
+
+        ~ReadSnapshot()
+        {
+            if (m_owned)
+            {
+                sqlite3_exec(m_db, "COMMIT;", nullptr, nullptr, nullptr);
+            }
+        }
+
+        ReadSnapshot(const ReadSnapshot&) = delete;
+        ReadSnapshot& operator=(const ReadSnapshot&) = delete;
+
+    private:
+        sqlite3* m_db;
+        bool m_owned;
+    };
+
+    // Start the read transaction now rather than at the first statement,
+    // so the view is fixed from this point on
+    bool PinReadTransaction(sqlite3* db)
+    {
+        return sqlite3_exec(db, "SELECT 1 FROM sqlite_master LIMIT 1;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    }
+
+    constexpr DWORD BACKUP_BUSY_WAIT_MS = 10;
+
+    unsigned long long ElapsedMicroseconds(std::chrono::steady_clock::time_point start)
+    {
+        return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+
+    // Checkpoint the WAL a long read transaction kept from being copied
+    // back, on a connection of the caller's own. A passive checkpoint does
+    // not block the writer, whose commits would otherwise run it inline
+    // (WAL_BACKSTOP_CHECKPOINT_FRAMES) and stall a sample behind it.
+    void CheckpointAfterLongRead(const std::string& dbPathUtf8)
+    {
+        sqlite3* db = nullptr;
+        if (sqlite3_open_v2(dbPathUtf8.c_str(), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, nullptr) == SQLITE_OK)
+        {
+            // A new connection opens the WAL with its first read
+            sqlite3_exec(db, "PRAGMA schema_version;", nullptr, nullptr, nullptr);
+            sqlite3_wal_checkpoint_v2(db, nullptr, SQLITE_CHECKPOINT_PASSIVE, nullptr, nullptr);
+        }
+        sqlite3_close(db);
+    }
+
+    // Write a closed file's data through to disk
+    bool SyncFile(const std::wstring& path)
+    {
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        bool ok = FlushFileBuffers(file) != 0;
+        CloseHandle(file);
+        return ok;
+    }
+
+    // Copy src (inside a read transaction) into a new file at path with the
+    // online backup API, options.pagesPerStep pages at a time. The copy is
+    // synced once at the end, outside the steps.
+    bool CopyDatabase(sqlite3* src, const std::wstring& path, const HistoryBackupOptions& options,
+                      HistoryBackupStats& stats)
+    {
+        sqlite3* dest = nullptr;
+        int rc = sqlite3_open16(path.c_str(), &dest);
+        if (rc != SQLITE_OK || !dest)
+        {
+            NM_LOG_ERROR(L"HistoryLogger::BackupTo: sqlite3_open16 failed, rc=" + std::to_wstring(rc));
+            if (dest)
+            {
+                sqlite3_close(dest);
+            }
+            return false;
+        }
+
+        // The step that returns SQLITE_DONE commits the copy. With the
+        // default synchronous=FULL it would also fsync the whole file
+        // there, one step of tens of ms for a large database. The partial
+        // file is deleted on any failure, so nothing needs syncing before
+        // the end.
+        sqlite3_exec(dest, "PRAGMA synchronous=OFF;", nullptr, nullptr, nullptr);
+
+        sqlite3_backup* backup = sqlite3_backup_init(dest, "main", src, "main");
+        if (!backup)
+        {
+            NM_LOG_ERROR(L"HistoryLogger::BackupTo: sqlite3_backup_init failed, rc=" +
+                     std::to_wstring(sqlite3_errcode(dest)));
+            sqlite3_close(dest);
+            return false;
+        }
+
+        int pages = (options.pagesPerStep > 0) ? options.pagesPerStep : -1;
+        auto start = std::chrono::steady_clock::now();
+        bool stopped = false;
+        do
+        {
+            auto stepStart = std::chrono::steady_clock::now();
+            rc = sqlite3_backup_step(backup, pages);
+            unsigned long long stepMicroseconds = ElapsedMicroseconds(stepStart);
+
+            ++stats.steps;
+            stats.longestStepMicroseconds = (std::max)(stats.longestStepMicroseconds, stepMicroseconds);
+            stats.pagesTotal = static_cast<unsigned long long>(sqlite3_backup_pagecount(backup));
+            stats.pagesCopied = stats.pagesTotal - static_cast<unsigned long long>(sqlite3_backup_remaining(backup));
+
+            if (rc == SQLITE_DONE)
+            {
+                break;
+            }
+            if (rc != SQLITE_OK && rc != SQLITE_BUSY && rc != SQLITE_LOCKED)
+            {
+                break;
+            }
+
+            if ((t_queryCancel && t_queryCancel->load(std::memory_order_relaxed)) ||
+                (options.progress && !options.progress(stats.pagesCopied, stats.pagesTotal)))
+            {
+                stopped = true;
+                break;
+            }
+
+            DWORD pause = (rc == SQLITE_OK) ? options.pauseMs : BACKUP_BUSY_WAIT_MS;
+            if (pause > 0)
+            {
+                Sleep(pause);
+            }
+        } while (true);
+
+        int finishRc = sqlite3_backup_finish(backup);
+        stats.elapsedMicroseconds = ElapsedMicroseconds(start);
+
+        bool ok = !stopped && rc == SQLITE_DONE && finishRc == SQLITE_OK;
+        if (!ok && !stopped)
+        {
+            NM_LOG_ERROR(L"HistoryLogger::BackupTo: sqlite3_backup_step failed, rc=" + std::to_wstring(rc));
+        }
+
+        // The pages carry the live file's WAL flag; a standalone copy is
+        // easier to move around without -wal and -shm companions
+        if (ok && sqlite3_exec(dest, "PRAGMA journal_mode=DELETE;", nullptr, nullptr, nullptr) != SQLITE_OK)
+        {
+            NM_LOG_ERROR(L"HistoryLogger::BackupTo: leaving WAL mode failed");
+            ok = false;
+        }
+
+        sqlite3_close(dest);
+        if (ok && !SyncFile(path))
+        {
+            NM_LOG_ERROR(L"HistoryLogger::BackupTo: syncing " + path + L" failed, error=" +
+                     std::to_wstring(GetLastError()));
+            ok = false;
+        }
+
+        if (ok && options.progress)
+        {
+            options.progress(stats.pagesCopied, stats.pagesTotal);
+        }
+        return ok;
+    }
+
+    // Share k of n of total, rounded down, so consecutive shares add up to
+    // total exactly. n is a span's sample count, so nothing overflows.
+    unsigned long long ShareOf(unsigned long long total, long long k, long long n)
+    {
+        unsigned long long uk = static_cast<unsigned long long>(k);
+        unsigned long long un = static_cast<unsigned long long>(n);
+        return (total / un) * uk + (total % un) * uk / un;
+    }
+
+    // The samples a span row merged, spaced evenly over its span, with the
+    // bytes split so they add up exactly; a plain row is its one sample
+    template <typename Emit>
+    void ExpandSpan(long long start, long long spanSeconds, long long samples,
+                    unsigned long long down, unsigned long long up, Emit&& emit)
+    {
+        if (samples <= 1 || spanSeconds <= 0)
+        {
+            emit(start, down, up);
+            return;
+        }
+        for (long long k = 0; k < samples; ++k)
+        {
+            emit(start + spanSeconds * k / (samples - 1),
+                 ShareOf(down, k + 1, samples) - ShareOf(down, k, samples),
+                 ShareOf(up, k + 1, samples) - ShareOf(up, k, samples));
+        }
+    }
+
+    // Per-second rates count as equal within the relative tolerance or the
+    // absolute slack, whichever is wider
+    bool RatesMatch(double a, double b, const HistoryCoalescingOptions& options)
+    {
+        double allowed = (std::max)(options.rateTolerance * (std::max)(a, b),
+                                    static_cast<double>(options.rateSlackBytesPerSecond));
+        return std::fabs(a - b) <= allowed;
+    }
+
+    const char* const SPAN_UPDATE_SQL =
+        "UPDATE usage SET bytes_down = ?1, bytes_up = ?2, span_seconds = ?3, samples = ?4 WHERE id = ?5;";
+
+    // Shorten span rows that start before cutoff but reach it to their
+    // samples from cutoff on, so deleting rows before cutoff keeps exactly
+    // the later samples
+    bool TrimSpansBefore(sqlite3* db, long long cutoff)
+    {
+        struct SpanRow
+        {
+            sqlite3_int64 id;
+            long long start;
+            long long spanSeconds;
+            long long samples;
+            unsigned long long down;
+            unsigned long long up;
+        };
+        std::vector<SpanRow> rows;
+
+        sqlite3_stmt* stmt = nullptr;
+        int rc = sqlite3_prepare_v2(db,
+                                    "SELECT id, timestamp, span_seconds, samples, bytes_down, bytes_up FROM usage "
+                                    "WHERE timestamp >= ?1 AND timestamp < ?2 AND samples > 1 "
+                                    "AND timestamp + span_seconds >= ?2;",
+                                    -1, &stmt, nullptr);
+        if (rc != SQLITE_OK || !stmt)
+        {
+            NM_LOG_ERROR(L"HistoryLogger::TrimSpansBefore: sqlite3_prepare_v2 failed, rc=" + std::to_wstring(rc));
+            return false;
+        }
+        sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(RollupStart(cutoff)));
+        sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(cutoff));
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+        {
+            SpanRow row;
+            row.id = sqlite3_column_int64(stmt, 0);
+            row.start = static_cast<long long>(sqlite3_column_int64(stmt, 1));
+            row.spanSeconds = static_cast<long long>(sqlite3_column_int64(stmt, 2));
+            row.samples = static_cast<long long>(sqlite3_column_int64(stmt, 3));
+            row.down = static_cast<unsigned long long>(sqlite3_column_int64(stmt, 4));
+            row.up = static_cast<unsigned long long>(sqlite3_column_int64(stmt, 5));
+            rows.push_back(row);
+        }
+        sqlite3_finalize(stmt);
+        if (rc != SQLITE_DONE)
+        {
+            if (rc != SQLITE_INTERRUPT)
+            {
+                NM_LOG_ERROR(L"HistoryLogger::TrimSpansBefore: sqlite3_step failed, rc=" + std::to_wstring(rc));
+            }
+            return false;
+        }
+        if (rows.empty())
+        {
+            return true;
+        }
+
+        rc = sqlite3_prepare_v2(db,
+                                "UPDATE usage SET timestamp = ?1, bytes_down = ?2, bytes_up = ?3, "
+                                "span_seconds = ?4, samples = ?5 WHERE id = ?6;",
+                                -1, &stmt, nullptr);
+        if (rc != SQLITE_OK || !stmt)
+        {
+            NM_LOG_ERROR(L"HistoryLogger::TrimSpansBefore: sqlite3_prepare_v2 failed, rc=" + std::to_wstring(rc));
+            return false;
+        }
+
+        bool ok = true;
+        for (const SpanRow& row : rows)
+        {
+            long long first = 0;
+            long long last = 0;
+            long long kept = 0;
+            unsigned long long down = 0;
+            unsigned long long up = 0;
+            ExpandSpan(row.start, row.spanSeconds, row.samples, row.down, row.up,
+                       [&](long long t, unsigned long long sampleDown, unsigned long long sampleUp) {
+                           if (t < cutoff)
+                           {
+                               return;
+                           }
+                           first = (kept == 0) ? t : first;
+                           last = t;
+                           ++kept;
+                           down += sampleDown;
+                           up += sampleUp;
+                       });
+
+            sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(first));
+            sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(down));
+            sqlite3_bind_int64(stmt, 3, static_cast<sqlite3_int64>(up));
+            sqlite3_bind_int64(stmt, 4, static_cast<sqlite3_int64>(last - first));
+            sqlite3_bind_int64(stmt, 5, static_cast<sqlite3_int64>(kept));
+            sqlite3_bind_int64(stmt, 6, row.id);
+            ok = (sqlite3_step(stmt) == SQLITE_DONE) && ok;
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+
+        if (!ok)
+        {
+            NM_LOG_ERROR(L"HistoryLogger::TrimSpansBefore: updating a span failed");
+        }
+        return ok;
+    }
+
+    // Set by SetStorageDirectory before first use; empty = next to the exe
+    std::wstring g_storageDirectory;
+
+    // Set by SetReadOnly before first use
+    bool g_readOnly = false;
+
+    // Rows per multi-row INSERT: 6 parameters each stays under SQLite's
+    // historical 999-parameter limit.
+    constexpr int ROWS_PER_INSERT = 64;
+
+    // Multi-row INSERTs of 1, 2, 4 ... ROWS_PER_INSERT rows, so any partial
+    // group is written with at most one statement per set bit of its size
+    constexpr int ROW_GROUP_SIZES = 7;
+}
+
+// Buffers rows and writes them with prepared multi-row INSERTs, one per
+// ROWS_PER_INSERT rows. Interface names are converted to UTF-8 once per
+// distinct name and bound without copying. Per-minute and per-billing-cycle
+// sums are kept in memory and merged into usage_minute and billing_cycle by
+// FlushPending. Used by ImportSamples and, for queued samples, by the
+// writer thread.
+//
+// With coalescing on, a sample whose rate matches its interface's open span
+// extends that span's row instead of adding one: in the buffer while the row
+// is pending, by an UPDATE at the next flush once it is written.
+class HistoryLogger::BulkInserter
+{
+public:
+    BulkInserter(sqlite3* db, BillingCycleCache& billingCycles)
+        : m_db(db)
+        , m_rollupStmt(nullptr)
+        , m_billingStmt(nullptr)
+        , m_spanStmt(nullptr)
+        , m_billingCycles(billingCycles)
+        , m_pending(0)
+    {
+        for (sqlite3_stmt*& stmt : m_groupStmts)
+        {
+            stmt = nullptr;
+        }
+    }
+
+    ~BulkInserter()
+    {
+        for (sqlite3_stmt* stmt : m_groupStmts)
+        {
+            sqlite3_finalize(stmt);
+        }
+        sqlite3_finalize(m_rollupStmt);
+        sqlite3_finalize(m_billingStmt);
+        sqlite3_finalize(m_spanStmt);
+    }
+
+    BulkInserter(const BulkInserter&) = delete;
+    BulkInserter& operator=(const BulkInserter&) = delete;
+
+    bool Prepare()
+    {
+        std::string sql = "INSERT INTO usage (timestamp, interface, bytes_down, bytes_up, span_seconds, samples) "
+                          "VALUES (?, ?, ?, ?, ?, ?)";
+        int rc = SQLITE_OK;
+        for (int group = 0; group < ROW_GROUP_SIZES && rc == SQLITE_OK; ++group)
+        {
+            rc = sqlite3_prepare_v3(m_db, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &m_groupStmts[group], nullptr);
+            for (int i = 0; i < (1 << group); ++i)
+            {
+                sql += ", (?, ?, ?, ?, ?, ?)";
+            }
+        }
+        if (rc == SQLITE_OK)
+        {
+            rc = sqlite3_prepare_v3(m_db, ROLLUP_UPSERT_SQL, -1, SQLITE_PREPARE_PERSISTENT, &m_rollupStmt, nullptr);
+        }
+        if (rc == SQLITE_OK)
+        {
+            rc = sqlite3_prepare_v3(m_db, BILLING_UPSERT_SQL, -1, SQLITE_PREPARE_PERSISTENT, &m_billingStmt, nullptr);
+        }
+        if (rc == SQLITE_OK)
+        {
+            rc = sqlite3_prepare_v3(m_db, SPAN_UPDATE_SQL, -1, SQLITE_PREPARE_PERSISTENT, &m_spanStmt, nullptr);
+        }
+
+        if (rc != SQLITE_OK)
+        {
+            NM_LOG_ERROR(L"HistoryLogger::BulkInserter: sqlite3_prepare_v3 failed, rc=" + std::to_wstring(rc));
+            return false;
+        }
+        return true;
+    }
+
+    // Coalescing starts fresh: rows written so far stay as they are
+    bool SetCoalescing(const HistoryCoalescingOptions& options)
+    {
+        bool ok = EndSpans();
+        m_options = options;
+        return ok;
+    }
+
+    bool Add(const HistorySampleView& row)
+    {
+        const std::string* name = &Utf8Name(row.interfaceName);
+        long long timestamp = static_cast<long long>(row.timestamp);
+        long long samples = (std::max)(1LL, row.samples);
+        long long spanSeconds = (samples > 1) ? (std::max)(0LL, row.spanSeconds) : 0;
+
+        // Sums take a span's samples where they fell, so a span that starts
+        // just before midnight still counts toward the right day and cycle
+        ExpandSpan(timestamp, spanSeconds, samples, row.bytesDown, row.bytesUp,
+                   [&](long long t, unsigned long long down, unsigned long long up) {
+                       AddSums(t, name, static_cast<sqlite3_int64>(down), static_cast<sqlite3_int64>(up));
+                   });
+
+        bool single = (samples == 1);
+        bool ok = true;
+        if (single && m_options.rateTolerance > 0.0)
+        {
+            auto it = m_spans.find(name);
+            if (it != m_spans.end())
+            {
+                if (Extend(it->second, timestamp, row.bytesDown, row.bytesUp))
+                {
+                    return true;
+                }
+                ok = CloseSpan(it->second);
+            }
+        }
+
+        PendingRow& pending = m_rows[m_pending];
+        pending.timestamp = timestamp;
+        pending.name = name;
+        pending.bytesDown = static_cast<sqlite3_int64>(row.bytesDown);
+        pending.bytesUp = static_cast<sqlite3_int64>(row.bytesUp);
+        pending.spanSeconds = spanSeconds;
+        pending.samples = samples;
+        pending.span = nullptr;
+
+        if (single && m_options.rateTolerance > 0.0)
+        {
+            OpenSpan& span = m_spans[name];
+            span.id = 0;
+            span.pendingIndex = m_pending;
+            span.start = timestamp;
+            span.end = timestamp;
+            span.samples = 1;
+            span.bytesDown = pending.bytesDown;
+            span.bytesUp = pending.bytesUp;
+            span.dirty = false;
+            pending.span = &span;
+        }
+
+        if (++m_pending < ROWS_PER_INSERT)
+        {
+            return ok;
+        }
+
+        m_pending = 0;
+        return Execute(ROW_GROUP_SIZES - 1, 0) && ok;
+    }
+
+    // Write rows left over from the last partial group, spans that grew
+    // since they were written, and the minute and billing-cycle sums
+    // gathered since the previous flush
+    bool FlushPending()
+    {
+        int count = m_pending;
+        m_pending = 0;
+
+        // Largest groups first, e.g. 36 rows as 32 + 4
+        bool ok = true;
+        int first = 0;
+        for (int group = ROW_GROUP_SIZES - 1; group >= 0 && ok; --group)
+        {
+            if (count & (1 << group))
+            {
+                ok = Execute(group, first);
+                first += (1 << group);
+            }
+        }
+
+        for (auto it = m_spans.begin(); it != m_spans.end() && ok; ++it)
+        {
+            ok = WriteSpan(it->second);
+        }
+
+        for (auto it = m_rollup.begin(); it != m_rollup.end() && ok; ++it)
+        {
+            const std::string* name = it->first.second;
+            sqlite3_bind_int64(m_rollupStmt, 1, it->first.first);
+            sqlite3_bind_text(m_rollupStmt, 2, name->data(), static_cast<int>(name->size()), SQLITE_STATIC);
+            sqlite3_bind_int64(m_rollupStmt, 3, it->second.first);
+            sqlite3_bind_int64(m_rollupStmt, 4, it->second.second);
+
+            ok = (sqlite3_step(m_rollupStmt) == SQLITE_DONE);
+            sqlite3_reset(m_rollupStmt);
+        }
+        m_rollup.clear();
+
+        // Oldest cycle first, though the upsert accepts any order
+        for (auto it = m_cycles.begin(); it != m_cycles.end() && ok; ++it)
+        {
+            const std::string* name = it->first.second;
+            sqlite3_bind_text(m_billingStmt, 1, name->data(), static_cast<int>(name->size()), SQLITE_STATIC);
+            sqlite3_bind_int64(m_billingStmt, 2, it->first.first);
+            sqlite3_bind_int64(m_billingStmt, 3, it->second.first);
+            sqlite3_bind_int64(m_billingStmt, 4, it->second.second);
+
+            ok = (sqlite3_step(m_billingStmt) == SQLITE_DONE);
+            sqlite3_reset(m_billingStmt);
+        }
+        m_cycles.clear();
+
+        if (!ok)
+        {
+            NM_LOG_ERROR(L"HistoryLogger::BulkInserter: writing rows failed");
+        }
+        return ok;
+    }
+
+    // Forget rows and sums of a transaction that was rolled back
+    void DiscardPending()
+    {
+        m_pending = 0;
+        m_rollup.clear();
+        m_cycles.clear();
+        m_spans.clear();
+    }
+
+    // Stop extending open spans, e.g. after rows were deleted or a
+    // transaction rolled back; growth not yet written is written now
+    bool EndSpans()
+    {
+        bool ok = true;
+        for (auto& entry : m_spans)
+        {
+            ok = CloseSpan(entry.second) && ok;
+        }
+        m_spans.clear();
+        return ok;
+    }
+
+private:
+    using RollupKey = std::pair<long long, const std::string*>;
+    using RollupSums = std::pair<sqlite3_int64, sqlite3_int64>;
+
+    // The newest row of an interface while it can still grow
+    struct OpenSpan
+    {
+        sqlite3_int64 id;           // Row id once written
+        int pendingIndex;           // Slot in m_rows while buffered, else -1
+        long long start;
+        long long end;
+        long long samples;
+        sqlite3_int64 bytesDown;
+        sqlite3_int64 bytesUp;
+        bool dirty;                 // Grew since its row was written
+    };
+
+    struct PendingRow
+    {
+        sqlite3_int64 timestamp;
+        const std::string* name;
+        sqlite3_int64 bytesDown;
+        sqlite3_int64 bytesUp;
+        sqlite3_int64 spanSeconds;
+        sqlite3_int64 samples;
+        OpenSpan* span;             // Learns its row id when written
+    };
+
+    void AddSums(long long timestamp, const std::string* name, sqlite3_int64 down, sqlite3_int64 up)
+    {
+        RollupSums& sums = m_rollup[std::make_pair(RollupStart(timestamp), name)];
+        sums.first += down;
+        sums.second += up;
+
+        RollupSums& cycle = m_cycles[std::make_pair(
+            static_cast<long long>(m_billingCycles.CycleStart(static_cast<std::time_t>(timestamp))), name)];
+        cycle.first += down;
+        cycle.second += up;
+    }
+
+    // Take the sample into span if it follows at the span's interval, in
+    // the same minute, at a rate both directions match
+    bool Extend(OpenSpan& span, long long timestamp, unsigned long long down, unsigned long long up)
+    {
+        long long gap = timestamp - span.end;
+        if (gap < 1 || RollupStart(timestamp) != RollupStart(span.start))
+        {
+            return false;
+        }
+
+        long long interval = gap;
+        if (span.samples == 1)
+        {
+            if (gap > HISTORY_COALESCE_MAX_GAP_SECONDS)
+            {
+                return false;
+            }
+        }
+        else
+        {
+            interval = (span.end - span.start) / (span.samples - 1);
+            if (gap < (std::max)(1LL, interval - interval / 2) || gap > interval + (std::max)(1LL, interval / 2))
+            {
+                return false;
+            }
+        }
+
+        // The first sample counts for one interval before the span starts
+        double covered = static_cast<double>(span.end - span.start + interval);
+        if (!RatesMatch(static_cast<double>(down) / gap, span.bytesDown / covered, m_options) ||
+            !RatesMatch(static_cast<double>(up) / gap, span.bytesUp / covered, m_options))
+        {
+            return false;
+        }
+
+        span.end = timestamp;
+        ++span.samples;
+        span.bytesDown += static_cast<sqlite3_int64>(down);
+        span.bytesUp += static_cast<sqlite3_int64>(up);
+        if (span.pendingIndex >= 0)
+        {
+            PendingRow& row = m_rows[span.pendingIndex];
+            row.bytesDown = span.bytesDown;
+            row.bytesUp = span.bytesUp;
+            row.spanSeconds = span.end - span.start;
+            row.samples = span.samples;
+        }
+        else
+        {
+            span.dirty = true;
+        }
+        return true;
+    }
+
+    // Detach span from its buffered row, or write its growth
+    bool CloseSpan(OpenSpan& span)
+    {
+        if (span.pendingIndex >= 0)
+        {
+            m_rows[span.pendingIndex].span = nullptr;
+            span.pendingIndex = -1;
+            return true;
+        }
+        return WriteSpan(span);
+    }
+
+    bool WriteSpan(OpenSpan& span)
+    {
+        if (!span.dirty)
+        {
+            return true;
+        }
+        span.dirty = false;
+
+        sqlite3_bind_int64(m_spanStmt, 1, span.bytesDown);
+        sqlite3_bind_int64(m_spanStmt, 2, span.bytesUp);
+        sqlite3_bind_int64(m_spanStmt, 3, span.end - span.start);
+        sqlite3_bind_int64(m_spanStmt, 4, span.samples);
+        sqlite3_bind_int64(m_spanStmt, 5, span.id);
+        int rc = sqlite3_step(m_spanStmt);
+        sqlite3_reset(m_spanStmt);
+        if (rc != SQLITE_DONE)
+        {
+            NM_LOG_ERROR(L"HistoryLogger::BulkInserter: updating a span failed, rc=" + std::to_wstring(rc));
+            return false;
+        }
+        return true;
+    }
+
+    // Write 2^group buffered rows starting at first
+    bool Execute(int group, int first)
+    {
+        sqlite3_stmt* stmt = m_groupStmts[group];
+        int count = 1 << group;
+        int param = 1;
+        for (int i = first; i < first + count; ++i)
+        {
+            const PendingRow& row = m_rows[i];
+            sqlite3_bind_int64(stmt, param++, row.timestamp);
+            sqlite3_bind_text(stmt, param++, row.name->data(), static_cast<int>(row.name->size()), SQLITE_STATIC);
+            sqlite3_bind_int64(stmt, param++, row.bytesDown);
+            sqlite3_bind_int64(stmt, param++, row.bytesUp);
+            sqlite3_bind_int64(stmt, param++, row.spanSeconds);
+            sqlite3_bind_int64(stmt, param++, row.samples);
+        }
+
+        int rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE)
+        {
+            NM_LOG_ERROR(L"HistoryLogger::BulkInserter: sqlite3_step failed, rc=" + std::to_wstring(rc));
+            return false;
+        }
+
+        // AUTOINCREMENT hands one statement's rows consecutive ids
+        sqlite3_int64 firstId = sqlite3_last_insert_rowid(m_db) - count + 1;
+        for (int i = first; i < first + count; ++i)
+        {
+            OpenSpan* span = m_rows[i].span;
+            if (span)
+            {
+                span->id = firstId + (i - first);
+                span->pendingIndex = -1;
+            }
+        }
+        return true;
+    }
+
+    const std::string& Utf8Name(std::wstring_view name)
+    {
+        m_key.assign(name.data(), name.size());
+        auto it = m_names.find(m_key);
+        if (it != m_names.end())
+        {
+            return it->second;
+        }
+
+        std::string utf8;
+        int bytes = WideCharToMultiByte(CP_UTF8, 0, m_key.data(), static_cast<int>(m_key.size()),
+                                        nullptr, 0, nullptr, nullptr);
+        if (bytes > 0)
+        {
+            utf8.resize(static_cast<size_t>(bytes));
+            WideCharToMultiByte(CP_UTF8, 0, m_key.data(), static_cast<int>(m_key.size()),
+                                &utf8[0], bytes, nullptr, nullptr);
+        }
+
+        // Node-based map: the string's address stays valid for binding
+        return m_names.emplace(m_key, std::move(utf8)).first->second;
+    }
+
+    sqlite3* m_db;
+    sqlite3_stmt* m_groupStmts[ROW_GROUP_SIZES];
+    sqlite3_stmt* m_rollupStmt;
+    sqlite3_stmt* m_billingStmt;
+    sqlite3_stmt* m_spanStmt;
+    BillingCycleCache& m_billingCycles;
+    HistoryCoalescingOptions m_options;
+    PendingRow m_rows[ROWS_PER_INSERT];
+    int m_pending;
+    std::unordered_map<std::wstring, std::string> m_names;
+    std::wstring m_key;
+    std::map<RollupKey, RollupSums> m_rollup;
+    std::map<RollupKey, RollupSums> m_cycles;
+    // Node-based: buffered rows point at their span
+    std::unordered_map<const std::string*, OpenSpan> m_spans;
+};
+
+void HistoryLogger::SetStorageDirectory(const std::wstring& directory)
+{
+    g_storageDirectory = directory;
+}
+
+void HistoryLogger::SetReadOnly(bool readOnly)
+{
+    g_readOnly = readOnly;
+}
+
 HistoryLogger& HistoryLogger::Instance()
 {
-    static HistoryLogger instance;
-    return instance;
+    static HistoryLogger instance;
+    return instance;
+}
+
+HistoryLogger::HistoryLogger()
+    : m_sqliteAvailable(false)
+    , m_readsAvailable(false)
+    , m_db(nullptr)
+    , m_enqueuedSeq(0)
+    , m_committedSeq(0)
+    , m_stopWriter(false)
+    , m_journalBehind(false)
+    , m_activeReaders(0)
+    , m_backupsRunning(0)
+    , m_retentionChanged(false)
+    , m_billingStartDay(DEFAULT_BILLING_CYCLE_START_DAY)
+    , m_stopQueries(false)
+{
+}
+
+HistoryLogger::~HistoryLogger()
+{
+    ShutdownSQLite();
+}
+
+void HistoryLogger::Shutdown()
+{
+    // Never open the database on the way out
+    std::call_once(m_initOnce, []() {});
+    ShutdownSQLite();
+}
+
+void HistoryLogger::EnsureInitialized()
+{
+    std::call_once(m_initOnce, [this]() { InitializeSQLite(); });
+}
+
+void HistoryLogger::InitializeSQLite()
+{
+    m_sqliteAvailable = false;
+
+    // Build database path next to the executable (or the override)
+    wchar_t exePath[MAX_PATH] = {0};
+    if (!g_storageDirectory.empty())
+    {
+        wcsncpy_s(exePath, g_storageDirectory.c_str(), _TRUNCATE);
+    }
+    else
+    {
+        if (!GetModuleFileNameW(nullptr, exePath, MAX_PATH))
+        {
+            NM_LOG_ERROR(L"HistoryLogger::InitializeSQLite: GetModuleFileNameW failed: " + GetLastErrorString());
+            ShutdownSQLite();
+            return;
+        }
+
+        wchar_t* lastSlash = wcsrchr(exePath, L'\\');
+        if (lastSlash)
+        {
+            *lastSlash = L'\0';
+        }
+    }
+
+    wchar_t dbPath[MAX_PATH] = {0};
+    swprintf_s(dbPath, L"%s\\network_usage.db", exePath);
+
+    // Reader connections are opened with sqlite3_open_v2, which takes UTF-8
+    int pathBytes = WideCharToMultiByte(CP_UTF8, 0, dbPath, -1, nullptr, 0, nullptr, nullptr);
+    if (pathBytes > 1)
+    {
+        m_dbPathUtf8.resize(static_cast<size_t>(pathBytes));
+        WideCharToMultiByte(CP_UTF8, 0, dbPath, -1, &m_dbPathUtf8[0], pathBytes, nullptr, nullptr);
+        m_dbPathUtf8.resize(static_cast<size_t>(pathBytes - 1));
+    }
+
+    if (g_readOnly)
+    {
+        InitializeReadOnly();
+        return;
+    }
+
+    int openRc = sqlite3_open16(dbPath, &m_db);
+    if (openRc != SQLITE_OK || !m_db)
+    {
+        NM_LOG_ERROR(L"HistoryLogger::InitializeSQLite: sqlite3_open16 failed, rc=" + std::to_wstring(openRc));
+        if (m_db)
+        {
+            sqlite3_close(m_db);
+            m_db = nullptr;
+        }
+        return;
+    }
+
+    // Another process (e.g. a command-line export) may hold the file briefly
+    sqlite3_busy_timeout(m_db, 2000);
+
+    // Only takes effect on a file with no tables yet; older files are
+    // switched by idle maintenance once enough of them is free space
+    sqlite3_exec(m_db, "PRAGMA auto_vacuum=INCREMENTAL;", nullptr, nullptr, nullptr);
+
+    // WAL lets the read-only pool query while the writer commits
+    int walRc = sqlite3_exec(m_db, "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL;",
+                             nullptr, nullptr, nullptr);
+    if (walRc != SQLITE_OK)
+    {
+        NM_LOG_ERROR(L"HistoryLogger::InitializeSQLite: enabling WAL failed, rc=" + std::to_wstring(walRc));
+    }
+
+    // Checkpoints move to idle maintenance; the hook keeps a backstop
+    sqlite3_wal_hook(m_db, &HistoryLogger::WalCommitHook, this);
+
+    std::string limitsSql = "PRAGMA journal_size_limit=" + std::to_string(WAL_SIZE_LIMIT_BYTES) +
+                            "; PRAGMA analysis_limit=" + std::to_string(MAINTENANCE_ANALYSIS_LIMIT) + ";";
+    sqlite3_exec(m_db, limitsSql.c_str(), nullptr, nullptr, nullptr);
+
+    // Create table and index if they don't exist yet
+    const char* createSql =
+        "CREATE TABLE IF NOT EXISTS usage ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "timestamp INTEGER NOT NULL,"
+        "interface TEXT NOT NULL,"
+        "bytes_down INTEGER NOT NULL,"
+        "bytes_up INTEGER NOT NULL,"
+        "span_seconds INTEGER NOT NULL DEFAULT 0,"
+        "samples INTEGER NOT NULL DEFAULT 1);"
+        "CREATE INDEX IF NOT EXISTS idx_usage_ts ON usage(timestamp);"
+        "CREATE TABLE IF NOT EXISTS journal_state ("
+        "id INTEGER PRIMARY KEY CHECK (id = 1),"
+        "last_seq INTEGER NOT NULL);"
+        "CREATE TABLE IF NOT EXISTS usage_minute ("
+        "minute_start INTEGER NOT NULL,"
+        "interface TEXT NOT NULL,"
+        "bytes_down INTEGER NOT NULL,"
+        "bytes_up INTEGER NOT NULL,"
+        "PRIMARY KEY (minute_start, interface)) WITHOUT ROWID;"
+        "CREATE TABLE IF NOT EXISTS usage_hour ("
+        "hour_start INTEGER NOT NULL,"
+        "interface TEXT NOT NULL,"
+        "bytes_down INTEGER NOT NULL,"
+        "bytes_up INTEGER NOT NULL,"
+        "PRIMARY KEY (hour_start, interface)) WITHOUT ROWID;"
+        "CREATE TABLE IF NOT EXISTS retention_state ("
+        "id INTEGER PRIMARY KEY CHECK (id = 1),"
+        "raw_floor INTEGER NOT NULL,"
+        "minute_floor INTEGER NOT NULL);"
+        "CREATE TABLE IF NOT EXISTS billing_cycle ("
+        "interface TEXT PRIMARY KEY,"
+        "cycle_start INTEGER NOT NULL,"
+        "bytes_down INTEGER NOT NULL,"
+        "bytes_up INTEGER NOT NULL) WITHOUT ROWID;"
+        "CREATE TABLE IF NOT EXISTS billing_state ("
+        "id INTEGER PRIMARY KEY CHECK (id = 1),"
+        "start_day INTEGER NOT NULL);";
+
+    int createRc = sqlite3_exec(m_db, createSql, nullptr, nullptr, nullptr);
+    if (createRc != SQLITE_OK)
+    {
+        NM_LOG_ERROR(L"HistoryLogger::InitializeSQLite: sqlite3_exec(create table) failed, rc=" + std::to_wstring(createRc));
+    }
+
+    // Databases from before coalescing: every existing row is one sample
+    sqlite3_stmt* spanStmt = nullptr;
+    if (sqlite3_prepare_v2(m_db, "SELECT span_seconds, samples FROM usage LIMIT 0;", -1, &spanStmt, nullptr) != SQLITE_OK)
+    {
+        int alterRc = sqlite3_exec(m_db,
+                                   "ALTER TABLE usage ADD COLUMN span_seconds INTEGER NOT NULL DEFAULT 0;"
+                                   "ALTER TABLE usage ADD COLUMN samples INTEGER NOT NULL DEFAULT 1;",
+                                   nullptr, nullptr, nullptr);
+        if (alterRc != SQLITE_OK)
+        {
+            NM_LOG_ERROR(L"HistoryLogger::InitializeSQLite: adding span columns failed, rc=" + std::to_wstring(alterRc));
+        }
+    }
+    sqlite3_finalize(spanStmt);
+
+    m_maintenance.incremental = (QueryPragmaInt(m_db, "PRAGMA auto_vacuum;") == 2);
+    m_maintenanceStats.incrementalVacuum = m_maintenance.incremental;
+
+    // Databases from before the rollup existed: build it once from raw rows.
+    // Retention may empty usage_minute later; raw rows are not the whole
+    // story then.
+    const char* backfillSql =
+        "INSERT INTO usage_minute (minute_start, interface, bytes_down, bytes_up) "
+        "SELECT timestamp - (timestamp % 60), interface, SUM(bytes_down), SUM(bytes_up) FROM usage "
+        "WHERE NOT EXISTS (SELECT 1 FROM usage_minute) AND NOT EXISTS (SELECT 1 FROM retention_state) "
+        "GROUP BY 1, 2;";
+    int backfillRc = sqlite3_exec(m_db, backfillSql, nullptr, nullptr, nullptr);
+    if (backfillRc != SQLITE_OK)
+    {
+        NM_LOG_ERROR(L"HistoryLogger::InitializeSQLite: building usage_minute failed, rc=" + std::to_wstring(backfillRc));
+    }
+
+    // Billing totals follow the stored start day. Databases from before
+    // billing cycles existed get them built once from the rollup, as do
+    // totals whose cycle start is off by less than a day (the time zone
+    // changed, so local midnight moved).
+    int startDay = 0;
+    sqlite3_stmt* stateStmt = nullptr;
+    if (sqlite3_prepare_v2(m_db, "SELECT start_day FROM billing_state WHERE id = 1;", -1, &stateStmt, nullptr) == SQLITE_OK)
+    {
+        if (sqlite3_step(stateStmt) == SQLITE_ROW)
+        {
+            startDay = sqlite3_column_int(stateStmt, 0);
+        }
+        sqlite3_finalize(stateStmt);
+    }
+
+    bool rebuildBilling = (startDay == 0);
+    BillingPeriod currentCycle;
+    if (!rebuildBilling && GetBillingPeriod(std::time(nullptr), startDay, currentCycle))
+    {
+        const char* shiftedSql = "SELECT 1 FROM billing_cycle WHERE cycle_start <> ?1 "
+                                 "AND cycle_start > ?1 - 86400 AND cycle_start < ?1 + 86400 LIMIT 1;";
+        if (sqlite3_prepare_v2(m_db, shiftedSql, -1, &stateStmt, nullptr) == SQLITE_OK)
+        {
+            sqlite3_bind_int64(stateStmt, 1, static_cast<sqlite3_int64>(currentCycle.start));
+            rebuildBilling = (sqlite3_step(stateStmt) == SQLITE_ROW);
+            sqlite3_finalize(stateStmt);
+        }
+    }
+
+    if (startDay == 0)
+    {
+        startDay = DEFAULT_BILLING_CYCLE_START_DAY;
+    }
+    if (rebuildBilling)
+    {
+        RebuildBillingCycle(m_db, startDay);
+    }
+    m_billingCycles.SetStartDay(startDay);
+    m_billingStartDay = m_billingCycles.StartDay();
+
+    m_sampleInserter.reset(new BulkInserter(m_db, m_billingCycles));
+    if (!m_sampleInserter->Prepare())
+    {
+        m_sampleInserter.reset();
+        sqlite3_close(m_db);
+        m_db = nullptr;
+        return;
+    }
+
+    // Recover samples that were journaled but not committed last run
+    wchar_t journalPath[MAX_PATH] = {0};
+    swprintf_s(journalPath, L"%s\\network_usage.journal", exePath);
+    if (m_journal.Open(journalPath))
+    {
+        ReplayJournal();
+    }
+
+    m_sqliteAvailable = true;
+    m_readsAvailable = true;
+    m_writerThread = std::thread(&HistoryLogger::WriterThreadMain, this);
+}
+
+void HistoryLogger::InitializeReadOnly()
+{
+    // Only the reader pool: the file must exist, and nothing here writes to
+    // it or to the journal the owning process holds
+    sqlite3* db = AcquireReader();
+    if (!db)
+    {
+        NM_LOG_ERROR(L"HistoryLogger::InitializeReadOnly: network_usage.db cannot be opened");
+        return;
+    }
+
+    int startDay = 0;
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT start_day FROM billing_state WHERE id = 1;", -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            startDay = sqlite3_column_int(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    ReleaseReader(db);
+
+    m_billingCycles.SetStartDay((startDay == 0) ? DEFAULT_BILLING_CYCLE_START_DAY : startDay);
+    m_billingStartDay = m_billingCycles.StartDay();
+    m_readsAvailable = true;
+}
+
+void HistoryLogger::ReplayJournal()
+{
+    unsigned long long storedSeq = 0;
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(m_db, "SELECT last_seq FROM journal_state WHERE id = 1;", -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            storedSeq = static_cast<unsigned long long>(sqlite3_column_int64(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    std::vector<JournalSample> pending;
+    m_journal.ReadPending(storedSeq, pending);
+    if (pending.empty())
+    {
+        return;
+    }
+
+    // Same rule as the writer: samples and the sequence mark commit together
+    sqlite3_exec(m_db, "BEGIN;", nullptr, nullptr, nullptr);
+    bool written = true;
+    for (const JournalSample& sample : pending)
+    {
+        HistorySampleView row = {};
+        row.timestamp = sample.timestamp;
+        row.interfaceName = sample.interfaceName;
+        row.bytesDown = sample.bytesDown;
+        row.bytesUp = sample.bytesUp;
+        written = m_sampleInserter->Add(row) && written;
+    }
+    written = m_sampleInserter->FlushPending() && written;
+
+    unsigned long long lastSeq = pending.back().seq;
+    if (written && StoreJournalSeq(lastSeq) &&
+        sqlite3_exec(m_db, "COMMIT;", nullptr, nullptr, nullptr) == SQLITE_OK)
+    {
+        m_journal.MarkCommitted(lastSeq);
+        NM_LOG_DEBUG(L"HistoryLogger::ReplayJournal: restored " +
+                 std::to_wstring(static_cast<unsigned long long>(pending.size())) + L" samples");
+    }
+    else
+    {
+        NM_LOG_ERROR(L"HistoryLogger::ReplayJournal: commit failed; samples stay in the journal");
+        sqlite3_exec(m_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+    }
+}
+
+bool HistoryLogger::StoreJournalSeq(unsigned long long journalSeq)
+{
+    sqlite3_stmt* stmt = nullptr;
+    int rc = sqlite3_prepare_v2(m_db, "INSERT OR REPLACE INTO journal_state (id, last_seq) VALUES (1, ?);",
+                                -1, &stmt, nullptr);
+    if (rc != SQLITE_OK || !stmt)
+    {
+        NM_LOG_ERROR(L"HistoryLogger::StoreJournalSeq: sqlite3_prepare_v2 failed, rc=" + std::to_wstring(rc));
+        return false;
+    }
+
+    sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(journalSeq));
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    return (rc == SQLITE_DONE);
+}
+
+void HistoryLogger::ShutdownSQLite()
+{
+    StopQueryThreads();
+
+    if (m_writerThread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_writeMutex);
+            m_stopWriter = true;
+        }
+        m_writeQueued.notify_all();
+        m_writerThread.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_readerMutex);
+        for (sqlite3* reader : m_idleReaders)
+        {
+            sqlite3_close(reader);
+        }
+        m_idleReaders.clear();
+    }
+
+    m_journal.Close();
+
+    m_sampleInserter.reset();
+
+    if (m_db)
+    {
+        sqlite3_close(m_db);
+        m_db = nullptr;
+    }
+
+    m_sqliteAvailable = false;
+    m_readsAvailable = false;
+}
+
+void HistoryLogger::AppendSample(const std::wstring& interfaceName,
+                                 unsigned long long bytesDown,
+                                 unsigned long long bytesUp)
+{
+    if (bytesDown == 0 && bytesUp == 0)
+    {
+        return;
+    }
+
+    EnsureInitialized();
+    if (!m_sqliteAvailable)
+    {
+        return;
+    }
+
+    WriteItem item;
+    item.timestamp = std::time(nullptr);
+    item.interfaceName = interfaceName;
+    item.bytesDown = bytesDown;
+    item.bytesUp = bytesUp;
+    item.taskResult = nullptr;
+
+    {
+        std::unique_lock<std::mutex> lock(m_writeMutex);
+        unsigned long long journalSeq = QueueSampleLocked(lock, item);
+        m_journal.WriteBack(journalSeq, journalSeq);
+    }
+    m_writeQueued.notify_one();
+}
+
+void HistoryLogger::AppendSamples(const std::vector<InterfaceUsage>& usage)
+{
+    EnsureInitialized();
+    if (!m_sqliteAvailable)
+    {
+        return;
+    }
+
+    std::time_t now = std::time(nullptr);
+    bool queued = false;
+    {
+        std::unique_lock<std::mutex> lock(m_writeMutex);
+        unsigned long long firstJournalSeq = 0;
+        unsigned long long lastJournalSeq = 0;
+        for (const InterfaceUsage& entry : usage)
+        {
+            if (entry.bytesDown == 0 && entry.bytesUp == 0)
+            {
+                continue;
+            }
+
+            WriteItem item;
+            item.timestamp = now;
+            item.interfaceName = entry.interfaceName;
+            item.bytesDown = entry.bytesDown;
+            item.bytesUp = entry.bytesUp;
+            item.taskResult = nullptr;
+            unsigned long long journalSeq = QueueSampleLocked(lock, item);
+            if (journalSeq != 0)
+            {
+                firstJournalSeq = (firstJournalSeq == 0) ? journalSeq : firstJournalSeq;
+                lastJournalSeq = journalSeq;
+            }
+            queued = true;
+        }
+
+        // The tick's records are adjacent in the ring: one write-back
+        m_journal.WriteBack(firstJournalSeq, lastJournalSeq);
+    }
+
+    // The writer wakes once and finds the whole tick queued
+    if (queued)
+    {
+        m_writeQueued.notify_one();
+    }
+}
+
+unsigned long long HistoryLogger::QueueSampleLocked(std::unique_lock<std::mutex>& lock, WriteItem& item)
+{
+    // A full ring means the writer is behind; wait rather than accept a
+    // sample that would not survive a crash. Bounded so a failing
+    // database cannot stall the caller. After one wait runs out, samples
+    // go unjournaled without waiting until the ring has room again, so a
+    // stuck writer costs the UI thread one wait rather than one per
+    // interface per tick.
+    if (!m_journal.IsFull())
+    {
+        m_journalBehind = false;
+    }
+    else if (!m_journalBehind)
+    {
+        m_writeQueued.notify_one();
+        if (!m_writeCommitted.wait_for(lock, std::chrono::seconds(2),
+                                       [this]() { return !m_journal.IsFull(); }))
+        {
+            NM_LOG_ERROR(L"HistoryLogger::AppendSample: journal full, samples queued without journal "
+                         L"until the writer catches up");
+            m_journalBehind = true;
+        }
+    }
+
+    unsigned long long journalSeq = m_journal.Append(item.timestamp, item.interfaceName, item.bytesDown, item.bytesUp);
+    item.journalSeq = journalSeq;
+    item.seq = ++m_enqueuedSeq;
+    t_lastQueuedSeq = item.seq;
+    m_writeQueue.push_back(std::move(item));
+    return journalSeq;
+}
+
+void HistoryLogger::Flush()
+{
+    EnsureInitialized();
+    if (!m_sqliteAvailable)
+    {
+        return;
+    }
+
+    unsigned long long target = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        target = m_enqueuedSeq;
+    }
+    WaitForCommitted(target);
+}
+
+void HistoryLogger::WaitForCommitted(unsigned long long seq)
+{
+    std::unique_lock<std::mutex> lock(m_writeMutex);
+    m_writeCommitted.wait(lock, [this, seq]() { return m_committedSeq >= seq; });
+}
+
+void HistoryLogger::WaitForOwnWrites()
+{
+    if (t_lastQueuedSeq != 0)
+    {
+        WaitForCommitted(t_lastQueuedSeq);
+    }
+}
+
+void HistoryLogger::WriterThreadMain()
+{
+    std::deque<WriteItem> batch;
+    auto lastWrite = std::chrono::steady_clock::now();
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_writeMutex);
+            bool pending = MaintenancePending(false);
+            if (!m_writeQueued.wait_for(lock, pending ? MAINTENANCE_POLL : MAINTENANCE_IDLE_POLL,
+                                        [this]() { return m_stopWriter || !m_writeQueue.empty(); }))
+            {
+                // Nothing queued: spend a slice on maintenance if the
+                // readers are quiet too. A sample queued meanwhile waits
+                // at most one slice.
+                lock.unlock();
+                if (pending && IsIdleForMaintenance(lastWrite))
+                {
+                    DoMaintenanceSlice(std::chrono::milliseconds(HISTORY_MAINTENANCE_SLICE_MS), false);
+                }
+                continue;
+            }
+
+            if (m_writeQueue.empty())
+            {
+                // Stop requested and everything queued has been applied
+                break;
+            }
+            batch.swap(m_writeQueue);
+        }
+
+        unsigned long long lastSeq = batch.back().seq;
+        unsigned long long journalSeq = ApplyWriteBatch(batch);
+        batch.clear();
+        lastWrite = std::chrono::steady_clock::now();
+        PublishCommitted(lastSeq, journalSeq);
+    }
+}
+
+void HistoryLogger::PublishCommitted(unsigned long long seq, unsigned long long journalSeq)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        m_committedSeq = seq;
+        if (journalSeq != 0)
+        {
+            m_journal.MarkCommitted(journalSeq);
+        }
+    }
+    m_writeCommitted.notify_all();
+}
+
+unsigned long long HistoryLogger::ApplyWriteBatch(std::deque<WriteItem>& batch)
+{
+    // Consecutive inserts share one transaction and go through the
+    // multi-row INSERTs of m_sampleInserter, so a tick's worth of interfaces
+    // costs a statement or two rather than one per row. A task closes the
+    // open transaction first so it observes (and orders after) earlier
+    // samples, and publishes them first, so a Flush waiting on those
+    // samples does not also wait for the task (a maintenance slice queued
+    // right behind them, say). Each transaction also records the highest
+    // journal sequence it holds, so a replay after a crash never applies a
+    // sample twice.
+    bool inTransaction = false;
+    bool samplesOk = true;
+    unsigned long long pendingJournalSeq = 0;
+    unsigned long long committedJournalSeq = 0;
+
+    auto commit = [&]() {
+        if (!inTransaction)
+        {
+            return;
+        }
+
+        bool ok = m_sampleInserter->FlushPending() && samplesOk;
+        ok = ok && (pendingJournalSeq == 0 || StoreJournalSeq(pendingJournalSeq));
+        int rc = ok ? sqlite3_exec(m_db, "COMMIT;", nullptr, nullptr, nullptr) : SQLITE_ERROR;
+        if (rc == SQLITE_OK)
+        {
+            committedJournalSeq = (std::max)(committedJournalSeq, pendingJournalSeq);
+        }
+        else
+        {
+            NM_LOG_ERROR(L"HistoryLogger::ApplyWriteBatch: COMMIT failed, rc=" + std::to_wstring(rc));
+            sqlite3_exec(m_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+            m_sampleInserter->DiscardPending();
+        }
+
+        inTransaction = false;
+        samplesOk = true;
+        pendingJournalSeq = 0;
+    };
+
+    unsigned long long previousSeq = 0;
+    for (WriteItem& item : batch)
+    {
+        if (item.task)
+        {
+            bool samplesBefore = inTransaction;
+            commit();
+            if (samplesBefore)
+            {
+                PublishCommitted(previousSeq, committedJournalSeq);
+            }
+
+            bool ok = item.task(m_db);
+            if (item.taskResult)
+            {
+                *item.taskResult = ok;
+            }
+            previousSeq = item.seq;
+            continue;
+        }
+        previousSeq = item.seq;
+
+        if (!inTransaction)
+        {
+            // Rows are buffered until commit, which flushes them even if
+            // BEGIN failed and they end up autocommitted
+            if (sqlite3_exec(m_db, "BEGIN;", nullptr, nullptr, nullptr) != SQLITE_OK)
+            {
+                NM_LOG_ERROR(L"HistoryLogger::ApplyWriteBatch: BEGIN failed");
+            }
+            inTransaction = true;
+        }
+
+        HistorySampleView row = {};
+        row.timestamp = item.timestamp;
+        row.interfaceName = item.interfaceName;
+        row.bytesDown = item.bytesDown;
+        row.bytesUp = item.bytesUp;
+        samplesOk = m_sampleInserter->Add(row) && samplesOk;
+        pendingJournalSeq = (std::max)(pendingJournalSeq, item.journalSeq);
+    }
+
+    commit();
+    return committedJournalSeq;
+}
+
+bool HistoryLogger::RunOnWriter(const std::function<bool(sqlite3*)>& task)
+{
+    EnsureInitialized();
+    if (!m_sqliteAvailable)
+    {
+        return false;
+    }
+
+    bool result = false;
+
+    WriteItem item;
+    item.journalSeq = 0;
+    item.timestamp = 0;
+    item.bytesDown = 0;
+    item.bytesUp = 0;
+    item.task = task;
+    item.taskResult = &result;
+
+    unsigned long long seq = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        seq = ++m_enqueuedSeq;
+        item.seq = seq;
+        t_lastQueuedSeq = seq;
+        m_writeQueue.push_back(std::move(item));
+    }
+    m_writeQueued.notify_one();
+
+    // result is written by the writer thread before it publishes seq
+    WaitForCommitted(seq);
+    return result;
+}
+
+HistoryLogger::ReadLease::ReadLease(HistoryLogger& owner)
+    : m_owner(owner)
+    , m_db(nullptr)
+    , m_pinned(false)
+{
+    m_owner.EnsureInitialized();
+    if (t_snapshotOwner == &m_owner)
+    {
+        // The snapshot's view is fixed; writes queued since cannot show up
+        m_db = t_snapshotDb;
+        m_pinned = true;
+    }
+    else if (m_owner.m_readsAvailable)
+    {
+        m_owner.WaitForOwnWrites();
+        m_db = m_owner.AcquireReader();
+        if (m_db && t_queryCancel)
+        {
+            sqlite3_progress_handler(m_db, QUERY_PROGRESS_STEPS, QueryProgressHandler,
+                                     const_cast<std::atomic<bool>*>(t_queryCancel));
+        }
+    }
+}
+
+HistoryLogger::ReadLease::~ReadLease()
+{
+    if (m_db)
+    {
+        if (t_queryCancel)
+        {
+            sqlite3_progress_handler(m_db, 0, nullptr, nullptr);
+        }
+        if (!m_pinned)
+        {
+            m_owner.ReleaseReader(m_db);
+        }
+    }
+}
+
+sqlite3* HistoryLogger::AcquireReader()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_readerMutex);
+        ++m_activeReaders;
+        if (!m_idleReaders.empty())
+        {
+            sqlite3* reader = m_idleReaders.back();
+            m_idleReaders.pop_back();
+            return reader;
+        }
+    }
+
+    // Pool empty: open another connection rather than wait, so a visitor
+    // that issues a nested query cannot deadlock on the pool.
+    sqlite3* reader = nullptr;
+    int rc = sqlite3_open_v2(m_dbPathUtf8.c_str(), &reader,
+                             SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr);
+    if (rc != SQLITE_OK || !reader)
+    {
+        NM_LOG_ERROR(L"HistoryLogger::AcquireReader: sqlite3_open_v2 failed, rc=" + std::to_wstring(rc));
+        if (reader)
+        {
+            sqlite3_close(reader);
+        }
+
+        std::lock_guard<std::mutex> lock(m_readerMutex);
+        --m_activeReaders;
+        return nullptr;
+    }
+
+    sqlite3_busy_timeout(reader, 2000);
+    return reader;
+}
+
+void HistoryLogger::ReleaseReader(sqlite3* db)
+{
+    // Queries finalize their own statements; one still here was leaked by a
+    // visitor that threw, and would pin the reader's read transaction
+    while (sqlite3_stmt* leaked = sqlite3_next_stmt(db, nullptr))
+    {
+        sqlite3_finalize(leaked);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_readerMutex);
+        --m_activeReaders;
+        m_lastReaderRelease = std::chrono::steady_clock::now();
+        if (m_idleReaders.size() < MAX_IDLE_READERS)
+        {
+            m_idleReaders.push_back(db);
+            return;
+        }
+    }
+
+    sqlite3_close(db);
+}
+
+bool HistoryLogger::IsIdleForMaintenance(std::chrono::steady_clock::time_point lastWrite)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastWrite < MAINTENANCE_QUIET)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_readerMutex);
+    return m_activeReaders == 0 && now - m_lastReaderRelease >= MAINTENANCE_QUIET;
+}
+
+bool HistoryLogger::MaintenancePending(bool force)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_maintenance.lastOptimize >= MAINTENANCE_OPTIMIZE_INTERVAL)
+    {
+        m_maintenance.optimizeDue = true;
+    }
+
+    return CheckpointDue(force) || m_maintenance.vacuumDue || m_maintenance.optimizeDue || RetentionDue();
+}
+
+bool HistoryLogger::CheckpointDue(bool force) const
+{
+    int pending = m_maintenance.walFrames - m_maintenance.walBackfilled;
+    if (pending <= 0)
+    {
+        return false;
+    }
+    return force || pending >= MAINTENANCE_CHECKPOINT_FRAMES ||
+           std::chrono::steady_clock::now() - m_maintenance.lastCheckpoint >= MAINTENANCE_CHECKPOINT_INTERVAL;
+}
+
+int HistoryLogger::WalCommitHook(void* owner, sqlite3* db, const char*, int frames)
+{
+    HistoryLogger* self = static_cast<HistoryLogger*>(owner);
+    self->m_maintenance.walFrames = frames;
+
+    // A checkpoint that restarted the WAL leaves fewer frames than it copied
+    if (frames < self->m_maintenance.walBackfilled)
+    {
+        self->m_maintenance.walBackfilled = 0;
+    }
+
+    // Backstop for when the logger is never idle long enough, as SQLite's
+    // own automatic checkpoint would do
+    if (frames - self->m_maintenance.walBackfilled >= WAL_BACKSTOP_CHECKPOINT_FRAMES &&
+        self->m_backupsRunning.load() == 0)
+    {
+        int logFrames = 0;
+        int checkpointed = 0;
+        if (sqlite3_wal_checkpoint_v2(db, nullptr, SQLITE_CHECKPOINT_PASSIVE, &logFrames, &checkpointed) == SQLITE_OK)
+        {
+            self->m_maintenance.walFrames = logFrames;
+            self->m_maintenance.walBackfilled = checkpointed;
+        }
+    }
+    return SQLITE_OK;
+}
+
+bool HistoryLogger::DoMaintenanceSlice(std::chrono::microseconds budget, bool force)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + budget;
+    HistoryMaintenanceStats delta;
+
+    // Checkpoint first: it is short (the WAL is capped by the automatic
+    // checkpoint) and lets vacuumed pages leave the file sooner
+    if (CheckpointDue(force))
+    {
+        CheckpointStep(delta);
+    }
+
+    if (m_maintenance.optimizeDue && std::chrono::steady_clock::now() < deadline)
+    {
+        OptimizeStep(deadline, delta);
+    }
+
+    // Before vacuuming, so the pages it frees go back in the same pass
+    if (RetentionDue() && std::chrono::steady_clock::now() < deadline)
+    {
+        RetentionStep(deadline, delta);
+    }
+
+    bool measuredFreePages = false;
+    if (m_maintenance.vacuumDue && std::chrono::steady_clock::now() < deadline)
+    {
+        VacuumStep(deadline, delta);
+        measuredFreePages = true;
+    }
+
+    // The one-off conversion VACUUM is reported on its own, not as a slice
+    unsigned long long sliceMicros = MicrosecondsSince(start) - delta.conversionMicroseconds;
+    {
+        std::lock_guard<std::mutex> lock(m_maintenanceMutex);
+        HistoryMaintenanceStats& stats = m_maintenanceStats;
+        stats.incrementalVacuum = m_maintenance.incremental;
+        stats.slices += 1;
+        stats.pagesReclaimed += delta.pagesReclaimed;
+        if (measuredFreePages)
+        {
+            stats.freePages = delta.freePages;
+        }
+        stats.checkpoints += delta.checkpoints;
+        stats.framesCheckpointed += delta.framesCheckpointed;
+        stats.optimizeRuns += delta.optimizeRuns;
+        stats.vacuumMicroseconds += delta.vacuumMicroseconds;
+        stats.checkpointMicroseconds += delta.checkpointMicroseconds;
+        stats.optimizeMicroseconds += delta.optimizeMicroseconds;
+        stats.conversionMicroseconds += delta.conversionMicroseconds;
+        stats.rawRowsExpired += delta.rawRowsExpired;
+        stats.minuteRowsFolded += delta.minuteRowsFolded;
+        stats.hourRowsExpired += delta.hourRowsExpired;
+        stats.retentionMicroseconds += delta.retentionMicroseconds;
+        stats.lastSliceMicroseconds = sliceMicros;
+        stats.longestSliceMicroseconds = (std::max)(stats.longestSliceMicroseconds, sliceMicros);
+    }
+
+    return MaintenancePending(force);
+}
+
+void HistoryLogger::CheckpointStep(HistoryMaintenanceStats& delta)
+{
+    auto start = std::chrono::steady_clock::now();
+    int logFrames = 0;
+    int checkpointed = 0;
+    int rc = sqlite3_wal_checkpoint_v2(m_db, nullptr, SQLITE_CHECKPOINT_PASSIVE, &logFrames, &checkpointed);
+    delta.checkpointMicroseconds += MicrosecondsSince(start);
+
+    if (rc != SQLITE_OK)
+    {
+        if (rc != SQLITE_BUSY)
+        {
+            NM_LOG_ERROR(L"HistoryLogger::CheckpointStep: sqlite3_wal_checkpoint_v2 failed, rc=" + std::to_wstring(rc));
+        }
+        m_maintenance.lastCheckpoint = std::chrono::steady_clock::now();
+        return;
+    }
+
+    // A reader still using older frames can keep it from copying them all;
+    // the rest stay pending
+    delta.checkpoints += 1;
+    delta.framesCheckpointed += static_cast<unsigned long long>(
+        (std::max)(checkpointed - (std::min)(m_maintenance.walBackfilled, checkpointed), 0));
+    m_maintenance.walFrames = (std::max)(logFrames, 0);
+    m_maintenance.walBackfilled = (std::max)(checkpointed, 0);
+    m_maintenance.lastCheckpoint = std::chrono::steady_clock::now();
+}
+
+void HistoryLogger::OptimizeStep(std::chrono::steady_clock::time_point deadline, HistoryMaintenanceStats& delta)
+{
+    // Checks every table, analyzing those whose statistics are missing or
+    // stale; analysis_limit keeps each ANALYZE to a sample of rows
+    auto start = std::chrono::steady_clock::now();
+    sqlite3_progress_handler(m_db, QUERY_PROGRESS_STEPS, DeadlineProgressHandler, &deadline);
+    int rc = sqlite3_exec(m_db, "PRAGMA optimize=0x10002;", nullptr, nullptr, nullptr);
+    sqlite3_progress_handler(m_db, 0, nullptr, nullptr);
+    delta.optimizeMicroseconds += MicrosecondsSince(start);
+
+    if (rc == SQLITE_INTERRUPT && ++m_maintenance.optimizeInterrupts < MAINTENANCE_OPTIMIZE_ATTEMPTS)
+    {
+        return;
+    }
+
+    if (rc == SQLITE_OK)
+    {
+        delta.optimizeRuns += 1;
+    }
+    else if (rc != SQLITE_INTERRUPT)
+    {
+        NM_LOG_ERROR(L"HistoryLogger::OptimizeStep: PRAGMA optimize failed, rc=" + std::to_wstring(rc));
+    }
+
+    m_maintenance.optimizeDue = false;
+    m_maintenance.optimizeInterrupts = 0;
+    m_maintenance.lastOptimize = std::chrono::steady_clock::now();
+}
+
+void HistoryLogger::VacuumStep(std::chrono::steady_clock::time_point deadline, HistoryMaintenanceStats& delta)
+{
+    if (!m_maintenance.incremental)
+    {
+        ConvertToIncrementalVacuum(delta);
+        return;
+    }
+
+    auto hardStop = deadline + MAINTENANCE_SLICE_GRACE;
+    sqlite3_progress_handler(m_db, MAINTENANCE_PROGRESS_STEPS, DeadlineProgressHandler, &hardStop);
+
+    long long freePages = QueryPragmaInt(m_db, "PRAGMA freelist_count;");
+    while (freePages > 0)
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+        {
+            break;
+        }
+
+        // Chunks grow at most twofold and aim at a third of the time left:
+        // the cost per page ranges from nothing (free pages at the end of
+        // the file) to a page move plus parent-pointer updates, and the
+        // commit's sync varies
+        auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count();
+        long long pages = (std::min)(m_maintenance.vacuumChunkPages * 2, VACUUM_MAX_CHUNK_PAGES);
+        if (m_maintenance.pagesPerMicrosecond > 0.0)
+        {
+            long long fits = static_cast<long long>(m_maintenance.pagesPerMicrosecond * static_cast<double>(remaining) / 3.0);
+            pages = (std::min)(pages, fits);
+        }
+        pages = (std::max)(1LL, (std::min)(pages, freePages));
+
+        std::string sql = "PRAGMA incremental_vacuum(" + std::to_string(pages) + ");";
+        int rc = sqlite3_exec(m_db, sql.c_str(), nullptr, nullptr, nullptr);
+        unsigned long long micros = MicrosecondsSince(now);
+        delta.vacuumMicroseconds += micros;
+        if (rc == SQLITE_INTERRUPT)
+        {
+            // Ran past the deadline and was rolled back; retry smaller
+            m_maintenance.vacuumChunkPages = (std::max)(1LL, pages / 4);
+            break;
+        }
+        if (rc != SQLITE_OK)
+        {
+            NM_LOG_ERROR(L"HistoryLogger::VacuumStep: incremental_vacuum failed, rc=" + std::to_wstring(rc));
+            m_maintenance.vacuumDue = false;
+            break;
+        }
+
+        long long after = QueryPragmaInt(m_db, "PRAGMA freelist_count;");
+        long long reclaimed = (after >= 0 && after < freePages) ? freePages - after : 0;
+        delta.pagesReclaimed += static_cast<unsigned long long>(reclaimed);
+        freePages = after;
+        if (reclaimed == 0)
+        {
+            break;
+        }
+
+        m_maintenance.pagesPerMicrosecond =
+            static_cast<double>(reclaimed) / static_cast<double>((std::max)(micros, 1ULL));
+        m_maintenance.vacuumChunkPages = (micros > static_cast<unsigned long long>(remaining))
+                                             ? (std::max)(1LL, pages / 2)
+                                             : pages;
+    }
+
+    sqlite3_progress_handler(m_db, 0, nullptr, nullptr);
+    if (freePages <= 0)
+    {
+        m_maintenance.vacuumDue = false;
+    }
+
+    delta.freePages = static_cast<unsigned long long>((std::max)(freePages, 0LL));
+}
+
+void HistoryLogger::ConvertToIncrementalVacuum(HistoryMaintenanceStats& delta)
+{
+    m_maintenance.vacuumDue = false;
+
+    long long freePages = QueryPragmaInt(m_db, "PRAGMA freelist_count;");
+    long long pageCount = QueryPragmaInt(m_db, "PRAGMA page_count;");
+    delta.freePages = static_cast<unsigned long long>((std::max)(freePages, 0LL));
+    if (freePages < VACUUM_CONVERT_MIN_FREE_PAGES || freePages * 4 < pageCount)
+    {
+        return;
+    }
+
+    // Rewrites the whole file, so it costs more than a slice; it runs once,
+    // when most of what it copies is gone anyway
+    auto start = std::chrono::steady_clock::now();
+    int rc = sqlite3_exec(m_db, "PRAGMA auto_vacuum=INCREMENTAL; VACUUM;", nullptr, nullptr, nullptr);
+    delta.conversionMicroseconds += MicrosecondsSince(start);
+    if (rc != SQLITE_OK)
+    {
+        NM_LOG_ERROR(L"HistoryLogger::ConvertToIncrementalVacuum: VACUUM failed, rc=" + std::to_wstring(rc));
+        return;
+    }
+
+    // The rewritten file sits in the WAL; copy it back as part of the
+    // one-off cost rather than in a later slice
+    HistoryMaintenanceStats checkpoint;
+    CheckpointStep(checkpoint);
+    delta.conversionMicroseconds += checkpoint.checkpointMicroseconds;
+
+    m_maintenance.incremental = (QueryPragmaInt(m_db, "PRAGMA auto_vacuum;") == 2);
+    long long after = QueryPragmaInt(m_db, "PRAGMA freelist_count;");
+    delta.pagesReclaimed += static_cast<unsigned long long>(freePages - (std::max)(after, 0LL));
+    delta.freePages = static_cast<unsigned long long>((std::max)(after, 0LL));
+    NM_LOG_DEBUG(L"HistoryLogger::ConvertToIncrementalVacuum: switched to auto_vacuum=INCREMENTAL, freed " +
+             std::to_wstring(freePages) + L" pages");
+}
+
+bool HistoryLogger::RetentionDue()
+{
+    bool active = false;
+    {
+        std::lock_guard<std::mutex> lock(m_maintenanceMutex);
+        if (m_retentionChanged)
+        {
+            m_maintenance.retentionDue = true;
+            m_retentionChanged = false;
+        }
+        active = m_retentionPolicy.IsActive();
+    }
+
+    if (!active)
+    {
+        m_maintenance.retentionDue = false;
+        return false;
+    }
+
+    // Rows age past the cutoffs as time goes by
+    if (std::chrono::steady_clock::now() - m_maintenance.lastRetention >= RETENTION_CHECK_INTERVAL)
+    {
+        m_maintenance.retentionDue = true;
+    }
+    return m_maintenance.retentionDue;
+}
+
+void HistoryLogger::RetentionStep(std::chrono::steady_clock::time_point deadline, HistoryMaintenanceStats& delta)
+{
+    auto start = std::chrono::steady_clock::now();
+    HistoryRetentionPolicy policy;
+    {
+        std::lock_guard<std::mutex> lock(m_maintenanceMutex);
+        policy = m_retentionPolicy;
+    }
+
+    std::time_t now = std::time(nullptr);
+    RetentionCutoffs cutoffs = GetRetentionCutoffs(policy, now);
+    long long capLimit = HourStart(static_cast<long long>(now) - HISTORY_SIZE_CAP_KEEP_DAYS * 24LL * 60 * 60);
+    long long capBytes = UnitCast<Bytes>(DataSize<Mebibytes, long long>(policy.maxSizeMB)).Count();
+
+    // Tiers age out oldest first and finest first: raw rows go before the
+    // minutes that hold them are folded, and minutes are folded before
+    // their hours can expire
+    auto hardStop = deadline + MAINTENANCE_SLICE_GRACE;
+    sqlite3_progress_handler(m_db, MAINTENANCE_PROGRESS_STEPS, DeadlineProgressHandler, &hardStop);
+
+    bool worked = true;
+    bool removedRows = false;
+    while (worked)
+    {
+        auto chunkStart = std::chrono::steady_clock::now();
+        if (chunkStart >= deadline)
+        {
+            break;
+        }
+
+        // As in VacuumStep: grow at most twofold, aim at a third of the time left
+        auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - chunkStart).count();
+        long long rows = (std::min)(m_maintenance.retentionChunkRows * 2, RETENTION_MAX_CHUNK_ROWS);
+        if (m_maintenance.rowsPerMicrosecond > 0.0)
+        {
+            long long fits = static_cast<long long>(m_maintenance.rowsPerMicrosecond * static_cast<double>(remaining) / 3.0);
+            rows = (std::min)(rows, fits);
+        }
+        rows = (std::max)(rows, RETENTION_MIN_CHUNK_ROWS);
+        unsigned long long removedBefore = delta.rawRowsExpired + delta.minuteRowsFolded + delta.hourRowsExpired;
+
+        worked = (cutoffs.raw != 0 && ExpireRawChunk(cutoffs.raw, rows, delta)) ||
+                 (cutoffs.minute != 0 && FoldMinuteChunk(cutoffs.minute, rows, delta)) ||
+                 (cutoffs.hour != 0 && ExpireHourChunk(cutoffs.hour, rows, delta));
+
+        // Pages in use, not the file size: deleted rows count as soon as
+        // their pages are on the freelist
+        if (!worked && capBytes > 0)
+        {
+            long long pageSize = QueryPragmaInt(m_db, "PRAGMA page_size;");
+            long long used = QueryPragmaInt(m_db, "PRAGMA page_count;") -
+                             QueryPragmaInt(m_db, "PRAGMA freelist_count;");
+            if (pageSize > 0 && used * pageSize > capBytes)
+            {
+                worked = ExpireRawChunk(capLimit, rows, delta) ||
+                         FoldMinuteChunk(capLimit, rows, delta) ||
+                         ExpireHourChunk(capLimit, rows, delta);
+            }
+        }
+        removedRows = removedRows || worked;
+
+        if (!worked && std::chrono::steady_clock::now() >= hardStop)
+        {
+            // Interrupted and rolled back rather than done; retry smaller
+            m_maintenance.retentionChunkRows = (std::max)(RETENTION_MIN_CHUNK_ROWS, rows / 4);
+            worked = true;
+            break;
+        }
+
+        unsigned long long removed = delta.rawRowsExpired + delta.minuteRowsFolded + delta.hourRowsExpired - removedBefore;
+        if (removed > 0)
+        {
+            unsigned long long micros = MicrosecondsSince(chunkStart);
+            m_maintenance.rowsPerMicrosecond =
+                static_cast<double>(removed) / static_cast<double>((std::max)(micros, 1ULL));
+            m_maintenance.retentionChunkRows = (micros > static_cast<unsigned long long>(remaining))
+                                                   ? (std::max)(RETENTION_MIN_CHUNK_ROWS, rows / 2)
+                                                   : rows;
+        }
+    }
+    sqlite3_progress_handler(m_db, 0, nullptr, nullptr);
+
+    if (!worked)
+    {
+        m_maintenance.retentionDue = false;
+    }
+    m_maintenance.lastRetention = std::chrono::steady_clock::now();
+    m_maintenance.vacuumDue = m_maintenance.vacuumDue || removedRows;
+    delta.retentionMicroseconds += MicrosecondsSince(start);
+}
+
+bool HistoryLogger::ExpireRawChunk(long long limit, long long rows, HistoryMaintenanceStats& delta)
+{
+    long long oldest = 0;
+    if (!QueryBoundInt(m_db, "SELECT MIN(timestamp) FROM usage;", 0, 0, oldest) || oldest >= limit)
+    {
+        return false;
+    }
+
+    // Up to rows rows, ending on a whole second
+    long long boundary = limit;
+    QueryBoundInt(m_db, "SELECT timestamp FROM usage WHERE timestamp < ?1 ORDER BY timestamp LIMIT 1 OFFSET ?2;",
+                  limit, rows, boundary);
+    boundary = (std::max)(boundary, oldest + 1);
+
+    // usage_minute already holds these rows' sums
+    const char* statements[] = {
+        "DELETE FROM usage WHERE timestamp < ?1;",
+        RAW_FLOOR_SQL
+    };
+    // A span reaching the boundary keeps its later samples
+    long long changes[2] = {0, 0};
+    sqlite3_exec(m_db, "BEGIN;", nullptr, nullptr, nullptr);
+    if (!TrimSpansBefore(m_db, boundary) ||
+        !RunBoundStatements(m_db, statements, 2, boundary, 0, L"HistoryLogger::ExpireRawChunk", changes) ||
+        sqlite3_exec(m_db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK)
+    {
+        if (sqlite3_get_autocommit(m_db) == 0)
+        {
+            sqlite3_exec(m_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        }
+        return false;
+    }
+    delta.rawRowsExpired += static_cast<unsigned long long>(changes[0]);
+    return true;
+}
+
+bool HistoryLogger::FoldMinuteChunk(long long limit, long long rows, HistoryMaintenanceStats& delta)
+{
+    long long oldest = 0;
+    if (!QueryBoundInt(m_db, "SELECT MIN(minute_start) FROM usage_minute;", 0, 0, oldest) || oldest >= limit)
+    {
+        return false;
+    }
+
+    // Whole hours only, so no hour is left split between the tiers
+    long long boundary = limit;
+    if (QueryBoundInt(m_db, "SELECT minute_start FROM usage_minute WHERE minute_start < ?1 "
+                            "ORDER BY minute_start LIMIT 1 OFFSET ?2;",
+                      limit, rows, boundary))
+    {
+        boundary = HourStart(boundary);
+    }
+    boundary = (std::max)(boundary, HourStart(oldest) + HISTORY_HOUR_SECONDS);
+
+    const char* statements[] = {
+        "INSERT INTO usage_hour (hour_start, interface, bytes_down, bytes_up) "
+        "SELECT minute_start - (minute_start % 3600), interface, SUM(bytes_down), SUM(bytes_up) "
+        "FROM usage_minute WHERE minute_start < ?1 GROUP BY 1, 2 "
+        "ON CONFLICT (hour_start, interface) DO UPDATE SET "
+        "bytes_down = bytes_down + excluded.bytes_down, bytes_up = bytes_up + excluded.bytes_up;",
+        "DELETE FROM usage_minute WHERE minute_start < ?1;",
+        MINUTE_FLOOR_SQL
+    };
+    long long changes[3] = {0, 0, 0};
+    if (!RunBoundStatements(m_db, statements, 3, boundary, 0, L"HistoryLogger::FoldMinuteChunk", changes))
+    {
+        return false;
+    }
+    delta.minuteRowsFolded += static_cast<unsigned long long>(changes[1]);
+    return true;
+}
+
+bool HistoryLogger::ExpireHourChunk(long long limit, long long rows, HistoryMaintenanceStats& delta)
+{
+    long long oldest = 0;
+    if (!QueryBoundInt(m_db, "SELECT MIN(hour_start) FROM usage_hour;", 0, 0, oldest) || oldest >= limit)
+    {
+        return false;
+    }
+
+    long long boundary = limit;
+    QueryBoundInt(m_db, "SELECT hour_start FROM usage_hour WHERE hour_start < ?1 "
+                        "ORDER BY hour_start LIMIT 1 OFFSET ?2;",
+                  limit, rows, boundary);
+    boundary = (std::max)(boundary, oldest + 1);
+
+    const char* statements[] = {
+        "DELETE FROM usage_hour WHERE hour_start < ?1;"
+    };
+    long long changes[1] = {0};
+    if (!RunBoundStatements(m_db, statements, 1, boundary, 0, L"HistoryLogger::ExpireHourChunk", changes))
+    {
+        return false;
+    }
+    delta.hourRowsExpired += static_cast<unsigned long long>(changes[0]);
+    return true;
+}
+
+void HistoryLogger::FinishBulkChange(bool freedPages)
+{
+    // A bulk transaction can leave a WAL far larger than the automatic
+    // checkpoint allows, and copying it back would blow a slice's budget.
+    // The bulk task has held the writer for a while already, so it pays for
+    // the checkpoint here.
+    HistoryMaintenanceStats delta;
+    CheckpointStep(delta);
+    {
+        std::lock_guard<std::mutex> lock(m_maintenanceMutex);
+        m_maintenanceStats.checkpoints += delta.checkpoints;
+        m_maintenanceStats.framesCheckpointed += delta.framesCheckpointed;
+        m_maintenanceStats.checkpointMicroseconds += delta.checkpointMicroseconds;
+    }
+
+    m_maintenance.vacuumDue = m_maintenance.vacuumDue || freedPages;
+    m_maintenance.optimizeDue = true;
+
+    // Imported rows may be older than the policy keeps
+    m_maintenance.retentionDue = true;
+
+    // Open spans may point at rows that are gone
+    m_sampleInserter->EndSpans();
+}
+
+bool HistoryLogger::RunMaintenanceSlice(unsigned int budgetMs)
+{
+    bool more = false;
+    bool ok = RunOnWriter([this, budgetMs, &more](sqlite3*) {
+        more = DoMaintenanceSlice(std::chrono::milliseconds(budgetMs), true);
+        return true;
+    });
+    return ok && more;
+}
+
+HistoryMaintenanceStats HistoryLogger::GetMaintenanceStats() const
+{
+    std::lock_guard<std::mutex> lock(m_maintenanceMutex);
+    return m_maintenanceStats;
+}
+
+bool HistoryLogger::RebuildBillingCycle(sqlite3* db, int startDay)
+{
+    BillingPeriod period;
+    if (!GetBillingPeriod(std::time(nullptr), startDay, period))
+    {
+        NM_LOG_ERROR(L"HistoryLogger::RebuildBillingCycle: local time conversion failed");
+        return false;
+    }
+
+    // Cycles start at local midnight, which is always a whole minute. Hours
+    // folded by retention count when they start inside the cycle.
+    const char* statements[] = {
+        "DELETE FROM billing_cycle;",
+        "INSERT INTO billing_cycle (interface, cycle_start, bytes_down, bytes_up) "
+        "SELECT interface, ?1, SUM(bytes_down), SUM(bytes_up) FROM ("
+        "SELECT interface, bytes_down, bytes_up FROM usage_minute WHERE minute_start >= ?1 "
+        "UNION ALL SELECT interface, bytes_down, bytes_up FROM usage_hour WHERE hour_start >= ?1) "
+        "GROUP BY interface;",
+        "INSERT OR REPLACE INTO billing_state (id, start_day) VALUES (1, ?2);"
+    };
+
+    bool ok = RunBoundStatements(db, statements, sizeof(statements) / sizeof(statements[0]),
+                                 static_cast<long long>(period.start), startDay,
+                                 L"HistoryLogger::RebuildBillingCycle");
+    if (ok)
+    {
+        NM_LOG_DEBUG(L"HistoryLogger::RebuildBillingCycle: totals rebuilt for start day " + std::to_wstring(startDay));
+    }
+    return ok;
+}
+
+bool HistoryLogger::SetBillingCycleStartDay(int day)
+{
+    day = (std::max)(1, (std::min)(day, MAX_BILLING_CYCLE_START_DAY));
+
+    EnsureInitialized();
+    if (!m_sqliteAvailable)
+    {
+        NM_LOG_ERROR(L"HistoryLogger::SetBillingCycleStartDay: SQLite not available");
+        return false;
+    }
+
+    return RunOnWriter([this, day](sqlite3* db) {
+        if (day == m_billingCycles.StartDay())
+        {
+            return true;
+        }
+        if (!RebuildBillingCycle(db, day))
+        {
+            return false;
+        }
+        m_billingCycles.SetStartDay(day);
+        m_billingStartDay = day;
+        return true;
+    });
+}
+
+int HistoryLogger::GetBillingCycleStartDay() const
+{
+    return m_billingStartDay.load();
+}
+
+bool HistoryLogger::GetBillingStatus(const std::wstring* interfaceFilter,
+                                     unsigned long long quotaBytes,
+                                     BillingStatus& out)
+{
+    out = BillingStatus();
+    out.asOf = std::time(nullptr);
+    out.quotaBytes = quotaBytes;
+
+    ReadLease lease(*this);
+    if (!lease.Get())
+    {
+        NM_LOG_ERROR(L"HistoryLogger::GetBillingStatus: SQLite not available");
+        return false;
+    }
+
+    if (!GetBillingPeriod(out.asOf, m_billingStartDay.load(), out.period))
+    {
+        NM_LOG_ERROR(L"HistoryLogger::GetBillingStatus: local time conversion failed");
+        return false;
+    }
+
+    bool useFilter = (interfaceFilter != nullptr && !interfaceFilter->empty());
+    const char* sql = useFilter
+        ? "SELECT COALESCE(SUM(bytes_down), 0), COALESCE(SUM(bytes_up), 0) FROM billing_cycle "
+          "WHERE cycle_start = ? AND interface = ?"
+        : "SELECT COALESCE(SUM(bytes_down), 0), COALESCE(SUM(bytes_up), 0) FROM billing_cycle "
+          "WHERE cycle_start = ?";
+
+    sqlite3_stmt* stmt = nullptr;
+    int rc = sqlite3_prepare_v2(lease.Get(), sql, -1, &stmt, nullptr);
+    if (rc != SQLITE_OK || !stmt)
+    {
+        NM_LOG_ERROR(L"HistoryLogger::GetBillingStatus: sqlite3_prepare_v2 failed, rc=" + std::to_wstring(rc));
+        return false;
+    }
+
+    sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(out.period.start));
+    if (useFilter)
+    {
+        sqlite3_bind_text16(stmt, 2, interfaceFilter->c_str(), -1, nullptr);
+    }
+
+    rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW)
+    {
+        out.bytesDown = static_cast<unsigned long long>(sqlite3_column_int64(stmt, 0));
+        out.bytesUp = static_cast<unsigned long long>(sqlite3_column_int64(stmt, 1));
+    }
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_ROW)
+    {
+        LogReadStepError(L"HistoryLogger::GetBillingStatus: sqlite3_step failed, rc=", rc);
+        return false;
+    }
+
+    // Average traffic per local hour of day over the last week. Each hour
+    // is divided by how long it was observed since the first sample, so a
+    // short history does not dilute the hours it has seen.
+    long long to = static_cast<long long>(out.asOf);
+    long long first = -1;
+    long long hourStart = 0;
+    long long hourEnd = 0;
+    int hour = 0;
+    double bytesByHour[BILLING_PROFILE_HOURS] = {};
+
+    bool scanOk = ScanUsageRange(lease.Get(), RollupStart(to - BILLING_PROFILE_SECONDS), to, ROLLUP_SECONDS,
+                                 interfaceFilter,
+                                 [&](long long ts, std::wstring_view, unsigned long long down, unsigned long long up) {
+        if (first < 0)
+        {
+            first = ts;
+        }
+        if (ts < hourStart || ts >= hourEnd)
+        {
+            std::time_t t = static_cast<std::time_t>(ts);
+            std::tm local = {};
+            localtime_s(&local, &t);
+            hour = local.tm_hour;
+            hourStart = ts - local.tm_min * 60 - local.tm_sec;
+            hourEnd = hourStart + 60 * 60;
+        }
+        bytesByHour[hour] += static_cast<double>(down + up);
+    });
+
+    if (!scanOk || first < 0)
+    {
+        ProjectBillingUsage(out, nullptr);
+        return true;
+    }
+
+    double hoursObserved[BILLING_PROFILE_HOURS] = {};
+    for (long long t = first; t < to;)
+    {
+        std::time_t tt = static_cast<std::time_t>(t);
+        std::tm local = {};
+        if (localtime_s(&local, &tt) != 0)
+        {
+            break;
+        }
+        long long sliceEnd = (std::min)(to, t + (60 - local.tm_min) * 60 - local.tm_sec);
+        hoursObserved[local.tm_hour] += static_cast<double>(sliceEnd - t) / 3600.0;
+        t = sliceEnd;
+    }
+
+    double totalBytes = 0.0;
+    double totalHours = 0.0;
+    for (int h = 0; h < BILLING_PROFILE_HOURS; ++h)
+    {
+        totalBytes += bytesByHour[h];
+        totalHours += hoursObserved[h];
+    }
+
+    // Hours not seen yet get the overall hourly average
+    double fallback = (totalHours > 0.0) ? totalBytes / totalHours : 0.0;
+    double profile[BILLING_PROFILE_HOURS] = {};
+    for (int h = 0; h < BILLING_PROFILE_HOURS; ++h)
+    {
+        profile[h] = (hoursObserved[h] > 0.0) ? bytesByHour[h] / hoursObserved[h] : fallback;
+    }
+
+    ProjectBillingUsage(out, profile);
+    return true;
+}
+
+bool HistoryLogger::GetTotalsToday(unsigned long long& totalDown, unsigned long long& totalUp,
+                                   const std::wstring* interfaceFilter)
+{
+    totalDown = 0;
+    totalUp = 0;
+
+    ReadLease lease(*this);
+    if (!lease.Get())
+    {
+        NM_LOG_ERROR(L"HistoryLogger::GetTotalsToday: SQLite not available");
+        return false;
+    }
+
+    CalendarSpan today;
+    if (!GetLocalDay(std::time(nullptr), today))
+    {
+        NM_LOG_ERROR(L"HistoryLogger::GetTotalsToday: local day lookup failed");
+        return false;
+    }
+
+    // Local midnights are whole minutes, so this reads usage_minute (and
+    // usage_hour for anything retention has folded) rather than raw rows
+    return SumUsageRange(lease.Get(), static_cast<long long>(today.start), static_cast<long long>(today.end),
+                         interfaceFilter, totalDown, totalUp);
+}
+
+bool HistoryLogger::GetTotalsThisMonth(unsigned long long& totalDown, unsigned long long& totalUp,
+                                       const std::wstring* interfaceFilter)
+{
+    totalDown = 0;
+    totalUp = 0;
+
+    ReadLease lease(*this);
+    if (!lease.Get())
+    {
+        NM_LOG_ERROR(L"HistoryLogger::GetTotalsThisMonth: SQLite not available");
+        return false;
+    }
+
+    CalendarSpan month;
+    if (!GetLocalMonth(std::time(nullptr), month))
+    {
+        NM_LOG_ERROR(L"HistoryLogger::GetTotalsThisMonth: local month lookup failed");
+        return false;
+    }
+
+    // Local midnights are whole minutes, so this reads usage_minute (and
+    // usage_hour for anything retention has folded) rather than raw rows
+    return SumUsageRange(lease.Get(), static_cast<long long>(month.start), static_cast<long long>(month.end),
+                         interfaceFilter, totalDown, totalUp);
+}
+
+bool HistoryLogger::GetRecentSamples(int limit, std::vector<HistorySample>& outSamples,
+                                     const std::wstring* interfaceFilter,
+                                     bool onlyToday)
+{
+    outSamples.clear();
+
+    if (limit <= 0)
+    {
+        return true;
+    }
+
+    HistoryQuery query;
+    query.interfaceFilter = interfaceFilter;
+    query.descending = true;
+
+    if (onlyToday)
+    {
+        std::time_t startToday = 0;
+        if (ComputeStartOfToday(startToday))
+        {
+            query.from = startToday;
+        }
+    }
+
+    outSamples.reserve(static_cast<size_t>(limit));
+
+    // Rows arrive newest start first, but a span's samples reach to the end
+    // of its minute, past plain rows and spans of other interfaces that
+    // start later. Samples wait here, newest on top, until no row still to
+    // come can hold a newer one.
+    auto older = [](const HistorySample& a, const HistorySample& b) { return a.timestamp < b.timestamp; };
+    std::priority_queue<HistorySample, std::vector<HistorySample>, decltype(older)> waiting(older);
+
+    size_t wanted = static_cast<size_t>(limit);
+    auto release = [&](long long notBefore) {
+        while (!waiting.empty() && outSamples.size() < wanted &&
+               static_cast<long long>(waiting.top().timestamp) >= notBefore)
+        {
+            outSamples.push_back(waiting.top());
+            waiting.pop();
+        }
+    };
+
+    bool ok = ForEachSample(query, [&](const HistorySampleView& row) {
+        // Rows still to come start no later than this one, and spans never
+        // leave their minute
+        release(RollupStart(static_cast<long long>(row.timestamp)) + ROLLUP_SECONDS);
+        if (outSamples.size() >= wanted)
+        {
+            return false;
+        }
+        ExpandSpan(static_cast<long long>(row.timestamp), row.spanSeconds, row.samples, row.bytesDown, row.bytesUp,
+                   [&](long long timestamp, unsigned long long down, unsigned long long up) {
+                       HistorySample sample;
+                       sample.timestamp = static_cast<std::time_t>(timestamp);
+                       sample.interfaceName.assign(row.interfaceName.data(), row.interfaceName.size());
+                       sample.bytesDown = down;
+                       sample.bytesUp = up;
+                       waiting.push(std::move(sample));
+                   });
+        return true;
+    });
+    release(std::numeric_limits<long long>::min());
+
+    LogRecentSamplesDebug(limit, onlyToday, interfaceFilter, outSamples);
+
+    return ok;
+}
+
+bool HistoryLogger::ForEachSample(const HistoryQuery& query,
+                                  const HistorySampleVisitor& visitor,
+                                  HistoryCursor* lastOut)
+{
+    if (!visitor)
+    {
+        return false;
+    }
+
+    ReadLease lease(*this);
+    if (!lease.Get())
+    {
+        return false;
+    }
+
+    // Build the WHERE clause from the query. Ordering by (timestamp, id)
+    // is served by idx_usage_ts, which carries the rowid implicitly, so
+    // keyset resumption never needs OFFSET or a temporary sort.
+    std::string sql =
+        "SELECT id, timestamp, interface, bytes_down, bytes_up, span_seconds, samples FROM usage";
+
+    bool useFilter = (query.interfaceFilter != nullptr && !query.interfaceFilter->empty());
+
+    const char* joiner = " WHERE ";
+    if (query.from != 0)
+    {
+        sql += joiner;
+        sql += "timestamp >= ?";
+        joiner = " AND ";
+    }
+    if (query.to != 0)
+    {
+        sql += joiner;
+        sql += "timestamp < ?";
+        joiner = " AND ";
+    }
+    if (useFilter)
+    {
+        sql += joiner;
+        sql += "interface = ?";
+        joiner = " AND ";
+    }
+    if (query.after)
+    {
+        sql += joiner;
+        sql += query.descending
+            ? "(timestamp < ? OR (timestamp = ? AND id < ?))"
+            : "(timestamp > ? OR (timestamp = ? AND id > ?))";
+    }
+
+    sql += query.descending ? " ORDER BY timestamp DESC, id DESC" : " ORDER BY timestamp ASC, id ASC";
+
+    if (query.limit > 0)
+    {
+        sql += " LIMIT ?";
+    }
+
+    sqlite3_stmt* stmt = nullptr;
+    int rc = sqlite3_prepare_v2(lease.Get(), sql.c_str(), -1, &stmt, nullptr);
+    if (rc != SQLITE_OK || !stmt)
+    {
+        NM_LOG_ERROR(L"HistoryLogger::ForEachSample: sqlite3_prepare_v2 failed, rc=" + std::to_wstring(rc));
+        return false;
+    }
+
+    int bindIndex = 1;
+    if (query.from != 0)
+    {
+        sqlite3_bind_int64(stmt, bindIndex++, static_cast<sqlite3_int64>(query.from));
+    }
+    if (query.to != 0)
+    {
+        sqlite3_bind_int64(stmt, bindIndex++, static_cast<sqlite3_int64>(query.to));
+    }
+    if (useFilter)
+    {
+        sqlite3_bind_text16(stmt, bindIndex++, query.interfaceFilter->c_str(), -1, nullptr);
+    }
+    if (query.after)
+    {
+        sqlite3_bind_int64(stmt, bindIndex++, static_cast<sqlite3_int64>(query.after->timestamp));
+        sqlite3_bind_int64(stmt, bindIndex++, static_cast<sqlite3_int64>(query.after->timestamp));
+        sqlite3_bind_int64(stmt, bindIndex++, static_cast<sqlite3_int64>(query.after->id));
+    }
+    if (query.limit > 0)
+    {
+        sqlite3_bind_int(stmt, bindIndex++, query.limit);
+    }
+
+    HistorySampleView row = {};
+    bool stopped = false;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        row.id = static_cast<long long>(sqlite3_column_int64(stmt, 0));
+        row.timestamp = static_cast<std::time_t>(sqlite3_column_int64(stmt, 1));
+
+        // text16 is converted in place inside the statement; the view stays
+        // valid until the next sqlite3_step, so no per-row allocation.
+        const void* ifaceText = sqlite3_column_text16(stmt, 2);
+        int ifaceBytes = sqlite3_column_bytes16(stmt, 2);
+        if (ifaceText)
+        {
+            row.interfaceName = std::wstring_view(static_cast<const wchar_t*>(ifaceText),
+                                                  static_cast<size_t>(ifaceBytes) / sizeof(wchar_t));
+        }
+        else
+        {
+            row.interfaceName = std::wstring_view();
+        }
+
+        row.bytesDown = static_cast<unsigned long long>(sqlite3_column_int64(stmt, 3));
+        row.bytesUp = static_cast<unsigned long long>(sqlite3_column_int64(stmt, 4));
+        row.spanSeconds = static_cast<long long>(sqlite3_column_int64(stmt, 5));
+        row.samples = static_cast<long long>(sqlite3_column_int64(stmt, 6));
+
+        if (lastOut)
+        {
+            lastOut->timestamp = row.timestamp;
+            lastOut->id = row.id;
+        }
+
+        if (!visitor(row))
+        {
+            stopped = true;
+            break;
+        }
+    }
+
+    sqlite3_finalize(stmt);
+
+    if (!stopped && rc != SQLITE_DONE)
+    {
+        LogReadStepError(L"HistoryLogger::ForEachSample: sqlite3_step ended with rc=", rc);
+        return false;
+    }
+
+    return true;
+}
+
+bool HistoryLogger::ExportHistory(const std::wstring& path,
+                                  HistoryExportFormat format,
+                                  std::time_t from,
+                                  std::time_t to,
+                                  const std::wstring* interfaceFilter,
+                                  unsigned long long* rowsOut)
+{
+    if (rowsOut)
+    {
+        *rowsOut = 0;
+    }
+
+    HistoryExportWriter writer;
+    if (!writer.Open(path, format))
+    {
+        return false;
+    }
+
+    // Spans are written as the samples they merged, so exports look the
+    // same with or without coalescing. A span that starts before from can
+    // still reach into the range; spans never leave their minute.
+    HistoryQuery query;
+    query.from = (from != 0) ? static_cast<std::time_t>(RollupStart(static_cast<long long>(from))) : 0;
+    query.to = to;
+    query.interfaceFilter = interfaceFilter;
+
+    bool writeOk = true;
+    bool scanOk = ForEachSample(query, [&](const HistorySampleView& row) {
+        HistorySampleView sample = row;
+        sample.spanSeconds = 0;
+        sample.samples = 1;
+        ExpandSpan(static_cast<long long>(row.timestamp), row.spanSeconds, row.samples, row.bytesDown, row.bytesUp,
+                   [&](long long timestamp, unsigned long long down, unsigned long long up) {
+                       if (!writeOk || timestamp < static_cast<long long>(from) ||
+                           (to != 0 && timestamp >= static_cast<long long>(to)))
+                       {
+                           return;
+                       }
+                       sample.timestamp = static_cast<std::time_t>(timestamp);
+                       sample.bytesDown = down;
+                       sample.bytesUp = up;
+                       writeOk = writer.Write(sample);
+                   });
+        return writeOk;
+    });
+
+    bool closeOk = writer.Close();
+    if (rowsOut)
+    {
+        *rowsOut = writer.GetRowCount();
+    }
+
+    if (!scanOk || !writeOk || !closeOk)
+    {
+        NM_LOG_ERROR(L"HistoryLogger::ExportHistory: export to " + path + L" failed");
+        return false;
+    }
+
+    NM_LOG_DEBUG(L"HistoryLogger::ExportHistory: wrote " + std::to_wstring(writer.GetRowCount()) +
+             L" rows to " + path);
+    return true;
 }
 
-HistoryLogger::HistoryLogger()
-    : m_initialized(false)
-    , m_sqliteAvailable(false)
-    , m_db(nullptr)
+namespace
 {
+    // Per-interface bucket sums for GetRateStatistics
+    struct RateAccumulator
+    {
+        std::wstring name;
+        std::vector<unsigned long long> down;
+        std::vector<unsigned long long> up;
+    };
+
+    // Upper bound on buckets per query: about 12 days of 1-second buckets or
+    // two years of 1-minute ones. Each bucket costs 24 bytes per interface
+    constexpr long long MAX_RATE_BUCKETS = 1LL << 20;
 }
 
-HistoryLogger::~HistoryLogger()
+bool HistoryLogger::SplitByTier(sqlite3* db, long long from, long long to, bool minuteAligned, TierSplit& out)
 {
-    ShutdownSQLite();
+    long long rawFloor = 0;
+    long long minuteFloor = 0;
+
+    sqlite3_stmt* stmt = nullptr;
+    int rc = sqlite3_prepare_v2(db, "SELECT raw_floor, minute_floor FROM retention_state WHERE id = 1;",
+                                -1, &stmt, nullptr);
+    if (rc != SQLITE_OK || !stmt)
+    {
+        NM_LOG_ERROR(L"HistoryLogger::SplitByTier: sqlite3_prepare_v2 failed, rc=" + std::to_wstring(rc));
+        return false;
+    }
+    rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW)
+    {
+        rawFloor = static_cast<long long>(sqlite3_column_int64(stmt, 0));
+        minuteFloor = static_cast<long long>(sqlite3_column_int64(stmt, 1));
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE)
+    {
+        LogReadStepError(L"HistoryLogger::SplitByTier: sqlite3_step failed, rc=", rc);
+        return false;
+    }
+
+    // Everything before minute_floor lives in usage_hour. Raw rows serve
+    // from the first whole minute they are complete for; the minute raw
+    // rows were expired partway through comes from usage_minute whole.
+    out.hourEnd = (std::max)(from, (std::min)(minuteFloor, to));
+    long long rawStart = (std::max)(rawFloor, minuteFloor);
+    long long minuteEnd = minuteAligned ? RollupStart(to) : out.hourEnd;
+    if (rawStart > out.hourEnd)
+    {
+        minuteEnd = (std::max)(minuteEnd, RollupCeil(rawStart));
+    }
+    out.minuteEnd = (std::max)(out.hourEnd, (std::min)(minuteEnd, to));
+    return true;
 }
 
-void HistoryLogger::EnsureInitialized()
+bool HistoryLogger::SumUsageRange(sqlite3* db,
+                                  long long from,
+                                  long long to,
+                                  const std::wstring* interfaceFilter,
+                                  unsigned long long& totalDown,
+                                  unsigned long long& totalUp)
 {
-    if (m_initialized)
+    totalDown = 0;
+    totalUp = 0;
+
+    ReadSnapshot snapshot(db);
+    TierSplit split;
+    if (!SplitByTier(db, from, to, from % ROLLUP_SECONDS == 0, split))
     {
-        return;
+        return false;
     }
 
-    m_initialized = true;
-    InitializeSQLite();
+    bool useFilter = (interfaceFilter != nullptr && !interfaceFilter->empty());
+
+    auto sum = [&](const char* sql, long long rangeFrom, long long rangeTo) {
+        if (rangeFrom >= rangeTo)
+        {
+            return true;
+        }
+
+        std::string fullSql = sql;
+        fullSql += useFilter ? " AND interface = ?;" : ";";
+
+        sqlite3_stmt* stmt = nullptr;
+        int rc = sqlite3_prepare_v2(db, fullSql.c_str(), -1, &stmt, nullptr);
+        if (rc != SQLITE_OK || !stmt)
+        {
+            NM_LOG_ERROR(L"HistoryLogger::SumUsageRange: sqlite3_prepare_v2 failed, rc=" + std::to_wstring(rc));
+            return false;
+        }
+
+        sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(rangeFrom));
+        sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(rangeTo));
+        if (useFilter)
+        {
+            sqlite3_bind_text16(stmt, 3, interfaceFilter->c_str(), -1, nullptr);
+        }
+
+        rc = sqlite3_step(stmt);
+        if (rc == SQLITE_ROW)
+        {
+            totalDown += static_cast<unsigned long long>(sqlite3_column_int64(stmt, 0));
+            totalUp += static_cast<unsigned long long>(sqlite3_column_int64(stmt, 1));
+        }
+        sqlite3_finalize(stmt);
+
+        if (rc != SQLITE_ROW && rc != SQLITE_DONE)
+        {
+            LogReadStepError(L"HistoryLogger::SumUsageRange: sqlite3_step failed, rc=", rc);
+            return false;
+        }
+        return true;
+    };
+
+    // Raw rows may be spans that reach past either end, so they are
+    // summed sample by sample
+    return sum("SELECT COALESCE(SUM(bytes_down), 0), COALESCE(SUM(bytes_up), 0) FROM usage_hour "
+               "WHERE hour_start >= ? AND hour_start < ?", from, split.hourEnd) &&
+           sum("SELECT COALESCE(SUM(bytes_down), 0), COALESCE(SUM(bytes_up), 0) FROM usage_minute "
+               "WHERE minute_start >= ? AND minute_start < ?", split.hourEnd, split.minuteEnd) &&
+           ScanRawSamples(db, split.minuteEnd, to, interfaceFilter,
+                          [&](long long, std::wstring_view, unsigned long long down, unsigned long long up) {
+                              totalDown += down;
+                              totalUp += up;
+                          });
 }
 
-void HistoryLogger::InitializeSQLite()
+bool HistoryLogger::ScanUsageRange(sqlite3* db,
+                                   long long from,
+                                   long long to,
+                                   long long bucketSeconds,
+                                   const std::wstring* interfaceFilter,
+                                   const UsageRowVisitor& visitor)
 {
-    m_sqliteAvailable = false;
+    bool useFilter = (interfaceFilter != nullptr && !interfaceFilter->empty());
 
-    // Build database path next to the executable
-    wchar_t exePath[MAX_PATH] = {0};
-    if (!GetModuleFileNameW(nullptr, exePath, MAX_PATH))
+    // Whole minutes come from usage_minute when buckets line up with it;
+    // whatever is left at the end (or everything, if unaligned) from usage,
+    // except where retention moved history to a coarser tier.
+    ReadSnapshot snapshot(db);
+    TierSplit split;
+    bool useRollup = (from % ROLLUP_SECONDS == 0) && (bucketSeconds % ROLLUP_SECONDS == 0);
+    if (!SplitByTier(db, from, to, useRollup, split))
     {
-        LogError(L"HistoryLogger::InitializeSQLite: GetModuleFileNameW failed: " + GetLastErrorString());
-        ShutdownSQLite();
-        return;
+        return false;
+    }
+
+    auto scan = [&](const char* sql, long long rangeFrom, long long rangeTo) {
+        if (rangeFrom >= rangeTo)
+        {
+            return true;
+        }
+
+        std::string fullSql = sql;
+        fullSql += useFilter ? " AND interface = ? ORDER BY 1" : " ORDER BY 1";
+
+        sqlite3_stmt* stmt = nullptr;
+        int rc = sqlite3_prepare_v2(db, fullSql.c_str(), -1, &stmt, nullptr);
+        if (rc != SQLITE_OK || !stmt)
+        {
+            NM_LOG_ERROR(L"HistoryLogger::ScanUsageRange: sqlite3_prepare_v2 failed, rc=" + std::to_wstring(rc));
+            return false;
+        }
+
+        sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(rangeFrom));
+        sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(rangeTo));
+        if (useFilter)
+        {
+            sqlite3_bind_text16(stmt, 3, interfaceFilter->c_str(), -1, nullptr);
+        }
+
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+        {
+            const void* ifaceText = sqlite3_column_text16(stmt, 1);
+            int ifaceBytes = sqlite3_column_bytes16(stmt, 1);
+            std::wstring_view name;
+            if (ifaceText)
+            {
+                name = std::wstring_view(static_cast<const wchar_t*>(ifaceText),
+                                         static_cast<size_t>(ifaceBytes) / sizeof(wchar_t));
+            }
+
+            visitor(static_cast<long long>(sqlite3_column_int64(stmt, 0)), name,
+                    static_cast<unsigned long long>(sqlite3_column_int64(stmt, 2)),
+                    static_cast<unsigned long long>(sqlite3_column_int64(stmt, 3)));
+        }
+        sqlite3_finalize(stmt);
+
+        if (rc != SQLITE_DONE)
+        {
+            LogReadStepError(L"HistoryLogger::ScanUsageRange: sqlite3_step ended with rc=", rc);
+            return false;
+        }
+        return true;
+    };
+
+    return scan("SELECT hour_start, interface, bytes_down, bytes_up FROM usage_hour "
+                "WHERE hour_start >= ? AND hour_start < ?", from, split.hourEnd) &&
+           scan("SELECT minute_start, interface, bytes_down, bytes_up FROM usage_minute "
+                "WHERE minute_start >= ? AND minute_start < ?", split.hourEnd, split.minuteEnd) &&
+           ScanRawSamples(db, split.minuteEnd, to, interfaceFilter, visitor);
+}
+
+bool HistoryLogger::ScanRawSamples(sqlite3* db,
+                                   long long from,
+                                   long long to,
+                                   const std::wstring* interfaceFilter,
+                                   const UsageRowVisitor& visitor)
+{
+    if (from >= to)
+    {
+        return true;
     }
 
-    wchar_t* lastSlash = wcsrchr(exePath, L'\\');
-    if (lastSlash)
+    bool useFilter = (interfaceFilter != nullptr && !interfaceFilter->empty());
+
+    // Spans stay inside one minute, so looking back to its start finds
+    // every span that reaches from
+    std::string sql = "SELECT timestamp, interface, bytes_down, bytes_up, span_seconds, samples FROM usage "
+                      "WHERE timestamp >= ? AND timestamp < ?";
+    sql += useFilter ? " AND interface = ? ORDER BY 1" : " ORDER BY 1";
+
+    sqlite3_stmt* stmt = nullptr;
+    int rc = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
+    if (rc != SQLITE_OK || !stmt)
     {
-        *lastSlash = L'\0';
+        NM_LOG_ERROR(L"HistoryLogger::ScanRawSamples: sqlite3_prepare_v2 failed, rc=" + std::to_wstring(rc));
+        return false;
     }
 
-    wchar_t dbPath[MAX_PATH] = {0};
-    swprintf_s(dbPath, L"%s\\network_usage.db", exePath);
+    sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(RollupStart(from)));
+    sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(to));
+    if (useFilter)
+    {
+        sqlite3_bind_text16(stmt, 3, interfaceFilter->c_str(), -1, nullptr);
+    }
 
-    int openRc = sqlite3_open16(dbPath, &m_db);
-    if (openRc != SQLITE_OK || !m_db)
+    // Samples of spans wait here, earliest on top, until no row that
+    // starts earlier can follow
+    struct SpanSample
     {
-        LogError(L"HistoryLogger::InitializeSQLite: sqlite3_open16 failed, rc=" + std::to_wstring(openRc));
-        if (m_db)
+        long long timestamp;
+        std::wstring name;
+        unsigned long long down;
+        unsigned long long up;
+    };
+    auto later = [](const SpanSample& a, const SpanSample& b) { return a.timestamp > b.timestamp; };
+    std::priority_queue<SpanSample, std::vector<SpanSample>, decltype(later)> waiting(later);
+
+    auto release = [&](long long before) {
+        while (!waiting.empty() && waiting.top().timestamp < before)
         {
-            sqlite3_close(m_db);
-            m_db = nullptr;
+            const SpanSample& sample = waiting.top();
+            visitor(sample.timestamp, sample.name, sample.down, sample.up);
+            waiting.pop();
         }
-        return;
-    }
+    };
 
-    // Create table and index if they don't exist yet
-    const char* createSql =
-        "CREATE TABLE IF NOT EXISTS usage ("
-        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "timestamp INTEGER NOT NULL,"
-        "interface TEXT NOT NULL,"
-        "bytes_down INTEGER NOT NULL,"
-        "bytes_up INTEGER NOT NULL);"
-        "CREATE INDEX IF NOT EXISTS idx_usage_ts ON usage(timestamp);";
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        long long timestamp = static_cast<long long>(sqlite3_column_int64(stmt, 0));
+        const void* ifaceText = sqlite3_column_text16(stmt, 1);
+        int ifaceBytes = sqlite3_column_bytes16(stmt, 1);
+        std::wstring_view name;
+        if (ifaceText)
+        {
+            name = std::wstring_view(static_cast<const wchar_t*>(ifaceText),
+                                     static_cast<size_t>(ifaceBytes) / sizeof(wchar_t));
+        }
+        unsigned long long down = static_cast<unsigned long long>(sqlite3_column_int64(stmt, 2));
+        unsigned long long up = static_cast<unsigned long long>(sqlite3_column_int64(stmt, 3));
+        long long spanSeconds = static_cast<long long>(sqlite3_column_int64(stmt, 4));
+        long long samples = static_cast<long long>(sqlite3_column_int64(stmt, 5));
 
-    int createRc = sqlite3_exec(m_db, createSql, nullptr, nullptr, nullptr);
-    if (createRc != SQLITE_OK)
+        release(timestamp);
+        if (samples <= 1 || spanSeconds <= 0)
+        {
+            if (timestamp >= from)
+            {
+                visitor(timestamp, name, down, up);
+            }
+            continue;
+        }
+
+        ExpandSpan(timestamp, spanSeconds, samples, down, up,
+                   [&](long long t, unsigned long long sampleDown, unsigned long long sampleUp) {
+                       if (t >= from && t < to)
+                       {
+                           waiting.push(SpanSample{ t, std::wstring(name), sampleDown, sampleUp });
+                       }
+                   });
+    }
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE)
     {
-        LogError(L"HistoryLogger::InitializeSQLite: sqlite3_exec(create table) failed, rc=" + std::to_wstring(createRc));
+        LogReadStepError(L"HistoryLogger::ScanRawSamples: sqlite3_step ended with rc=", rc);
+        return false;
     }
 
-    m_sqliteAvailable = true;
+    release(to);
+    return true;
 }
 
-void HistoryLogger::ShutdownSQLite()
+bool HistoryLogger::GetRateStatistics(const RateQuery& query, std::vector<InterfaceRateStatistics>& out)
 {
-    if (m_db)
+    out.clear();
+
+    std::time_t to = (query.to != 0) ? query.to : std::time(nullptr);
+    if (query.from <= 0 || to <= query.from || query.bucketSeconds <= 0)
     {
-        sqlite3_close(m_db);
-        m_db = nullptr;
+        NM_LOG_ERROR(L"HistoryLogger::GetRateStatistics: invalid period or bucket length");
+        return false;
     }
 
-    m_sqliteAvailable = false;
+    long long span = static_cast<long long>(to - query.from);
+    long long bucketSeconds = query.bucketSeconds;
+    long long bucketCount = (span + bucketSeconds - 1) / bucketSeconds;
+    if (bucketCount > MAX_RATE_BUCKETS)
+    {
+        NM_LOG_ERROR(L"HistoryLogger::GetRateStatistics: too many buckets");
+        return false;
+    }
+
+    ReadLease lease(*this);
+    if (!lease.Get())
+    {
+        return false;
+    }
+
+    bool useFilter = (query.interfaceFilter != nullptr && !query.interfaceFilter->empty());
+    long long from = static_cast<long long>(query.from);
+
+    std::vector<RateAccumulator> accumulators;
+    std::unordered_map<std::wstring, size_t> indexByName;
+    std::wstring key;
+    size_t lastIndex = 0;
+
+    bool ok = ScanUsageRange(lease.Get(), from, static_cast<long long>(to), bucketSeconds,
+                             query.interfaceFilter,
+                             [&](long long timestamp, std::wstring_view name,
+                                 unsigned long long down, unsigned long long up) {
+        // Rows mostly repeat the previous interface; skip the hash lookup
+        if (accumulators.empty() || accumulators[lastIndex].name != name)
+        {
+            key.assign(name.data(), name.size());
+            auto it = indexByName.find(key);
+            if (it == indexByName.end())
+            {
+                it = indexByName.emplace(key, accumulators.size()).first;
+                RateAccumulator acc;
+                acc.name = key;
+                acc.down.assign(static_cast<size_t>(bucketCount), 0);
+                acc.up.assign(static_cast<size_t>(bucketCount), 0);
+                accumulators.push_back(std::move(acc));
+            }
+            lastIndex = it->second;
+        }
+
+        size_t bucket = static_cast<size_t>((timestamp - from) / bucketSeconds);
+        accumulators[lastIndex].down[bucket] += down;
+        accumulators[lastIndex].up[bucket] += up;
+    });
+    if (!ok)
+    {
+        return false;
+    }
+
+    if (useFilter && accumulators.empty())
+    {
+        RateAccumulator acc;
+        acc.name = *query.interfaceFilter;
+        acc.down.assign(static_cast<size_t>(bucketCount), 0);
+        acc.up.assign(static_cast<size_t>(bucketCount), 0);
+        accumulators.push_back(std::move(acc));
+    }
+
+    // The final bucket may be shorter than bucketSeconds
+    long long lastBucketSeconds = span - (bucketCount - 1) * bucketSeconds;
+
+    std::vector<double> rates(static_cast<size_t>(bucketCount));
+    auto toRates = [&](const std::vector<unsigned long long>& sums) {
+        for (size_t i = 0; i < sums.size(); ++i)
+        {
+            long long seconds = (i + 1 == sums.size()) ? lastBucketSeconds : bucketSeconds;
+            rates[i] = static_cast<double>(sums[i]) / static_cast<double>(seconds);
+        }
+        return ComputeRateDistribution(rates, query.histogramBins);
+    };
+
+    out.reserve(accumulators.size());
+    for (const RateAccumulator& acc : accumulators)
+    {
+        InterfaceRateStatistics stats;
+        stats.interfaceName = acc.name;
+        stats.bucketCount = static_cast<size_t>(bucketCount);
+        stats.down = toRates(acc.down);
+        stats.up = toRates(acc.up);
+        out.push_back(std::move(stats));
+    }
+
+    std::sort(out.begin(), out.end(), [](const InterfaceRateStatistics& a, const InterfaceRateStatistics& b) {
+        return a.interfaceName < b.interfaceName;
+    });
+    return true;
 }
 
-void HistoryLogger::AppendSample(const std::wstring& interfaceName,
-                                 unsigned long long bytesDown,
-                                 unsigned long long bytesUp)
+bool HistoryLogger::GetTopIntervals(const TopKQuery& query, std::vector<RankedInterval>& out)
 {
-    if (bytesDown == 0 && bytesUp == 0)
+    out.clear();
+
+    std::time_t to = (query.to != 0) ? query.to : std::time(nullptr);
+    if (query.from <= 0 || to <= query.from || query.bucketSeconds <= 0)
     {
-        return;
+        NM_LOG_ERROR(L"HistoryLogger::GetTopIntervals: invalid period or bucket length");
+        return false;
     }
 
-    EnsureInitialized();
-    if (!m_sqliteAvailable || !m_db)
+    ReadLease lease(*this);
+    if (!lease.Get())
     {
-        return;
+        return false;
     }
 
-    std::time_t now = std::time(nullptr);
-    InsertSampleSQLite(now, interfaceName, bytesDown, bytesUp);
+    TrafficMetric metric = query.metric;
+    auto better = [metric](const RankedInterval& a, const RankedInterval& b) {
+        unsigned long long va = MetricValue(metric, a.bytesDown, a.bytesUp);
+        unsigned long long vb = MetricValue(metric, b.bytesDown, b.bytesUp);
+        return (va != vb) ? (va > vb) : (a.start < b.start);
+    };
+    TopKCollector<RankedInterval, decltype(better)> top(query.k, better);
+
+    // Rows arrive in time order, so only the current bucket is open
+    long long from = static_cast<long long>(query.from);
+    long long bucketSeconds = query.bucketSeconds;
+    RankedInterval current = {};
+    bool open = false;
+
+    bool ok = ScanUsageRange(lease.Get(), from, static_cast<long long>(to), bucketSeconds,
+                             query.interfaceFilter,
+                             [&](long long timestamp, std::wstring_view,
+                                 unsigned long long down, unsigned long long up) {
+        std::time_t start = static_cast<std::time_t>(from + (timestamp - from) / bucketSeconds * bucketSeconds);
+        if (open && start != current.start)
+        {
+            top.Offer(current);
+            open = false;
+        }
+        if (!open)
+        {
+            current.start = start;
+            current.bytesDown = 0;
+            current.bytesUp = 0;
+            open = true;
+        }
+        current.bytesDown += down;
+        current.bytesUp += up;
+    });
+
+    if (!ok)
+    {
+        return false;
+    }
+    if (open)
+    {
+        top.Offer(current);
+    }
+
+    out = top.TakeSorted();
+    return true;
 }
 
-bool HistoryLogger::InsertSampleSQLite(std::time_t ts,
-                                       const std::wstring& iface,
-                                       unsigned long long down,
-                                       unsigned long long up)
+bool HistoryLogger::GetCalendarTotals(CalendarUnit unit,
+                                      std::time_t from,
+                                      std::time_t to,
+                                      const std::wstring* interfaceFilter,
+                                      std::vector<CalendarTotal>& out)
 {
-    if (!m_sqliteAvailable || !m_db)
+    out.clear();
+
+    if (to == 0)
+    {
+        to = std::time(nullptr);
+    }
+    if (from <= 0 || to <= from)
     {
+        NM_LOG_ERROR(L"HistoryLogger::GetCalendarTotals: invalid period");
         return false;
     }
 
-    static const wchar_t* INSERT_SQL =
-        L"INSERT INTO usage (timestamp, interface, bytes_down, bytes_up) "
-        L"VALUES (?, ?, ?, ?);";
+    std::shared_ptr<const LocalCalendar> calendar = LocalCalendar::Shared(from, to - 1);
+    if (!calendar)
+    {
+        NM_LOG_ERROR(L"HistoryLogger::GetCalendarTotals: period is outside the local calendar");
+        return false;
+    }
 
-    sqlite3_stmt* stmt = nullptr;
-    int rc = sqlite3_prepare16_v2(m_db, INSERT_SQL, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK || !stmt)
+    ReadLease lease(*this);
+    if (!lease.Get())
     {
-        LogError(L"HistoryLogger::InsertSampleSQLite: sqlite3_prepare16_v2 failed, rc=" + std::to_wstring(rc));
         return false;
     }
 
-    sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(ts));
-    sqlite3_bind_text16(stmt, 2, iface.c_str(), -1, nullptr);
-    sqlite3_bind_int64(stmt, 3, static_cast<sqlite3_int64>(down));
-    sqlite3_bind_int64(stmt, 4, static_cast<sqlite3_int64>(up));
+    // Rows arrive in time order, so only the current period is open
+    int currentIndex = -1;
+    CalendarTotal current = {};
 
-    rc = sqlite3_step(stmt);
-    if (rc != SQLITE_DONE && rc != SQLITE_OK)
+    bool ok = ScanUsageRange(lease.Get(), static_cast<long long>(from), static_cast<long long>(to),
+                             ROLLUP_SECONDS, interfaceFilter,
+                             [&](long long timestamp, std::wstring_view,
+                                 unsigned long long down, unsigned long long up) {
+        int day = calendar->DayIndex(static_cast<std::time_t>(timestamp));
+        int index = (unit == CalendarUnit::Month) ? calendar->MonthOfDay(day) : day;
+        if (index != currentIndex)
+        {
+            if (currentIndex >= 0)
+            {
+                out.push_back(current);
+            }
+            currentIndex = index;
+            current.start = (unit == CalendarUnit::Month) ? calendar->MonthStart(index) : calendar->DayStart(index);
+            current.end = (unit == CalendarUnit::Month) ? calendar->MonthEnd(index) : calendar->DayEnd(index);
+            current.bytesDown = 0;
+            current.bytesUp = 0;
+        }
+        current.bytesDown += down;
+        current.bytesUp += up;
+    });
+
+    if (!ok)
     {
-        LogError(L"HistoryLogger::InsertSampleSQLite: sqlite3_step failed, rc=" + std::to_wstring(rc));
+        out.clear();
+        return false;
     }
-    sqlite3_finalize(stmt);
-
-    return (rc == SQLITE_DONE || rc == SQLITE_OK);
+    if (currentIndex >= 0)
+    {
+        out.push_back(current);
+    }
+    return true;
 }
 
-bool HistoryLogger::GetTotalsToday(unsigned long long& totalDown, unsigned long long& totalUp,
-                                   const std::wstring* interfaceFilter)
+bool HistoryLogger::GetTopInterfaces(const TopKQuery& query, std::vector<RankedInterface>& out)
 {
-    totalDown = 0;
-    totalUp = 0;
+    out.clear();
 
-    EnsureInitialized();
-    if (!m_sqliteAvailable || !m_db)
+    std::time_t to = (query.to != 0) ? query.to : std::time(nullptr);
+    if (query.from <= 0 || to <= query.from)
     {
-        LogError(L"HistoryLogger::GetTotalsToday: SQLite not available");
+        NM_LOG_ERROR(L"HistoryLogger::GetTopInterfaces: invalid period");
         return false;
     }
 
-    std::time_t now = std::time(nullptr);
-    std::tm localTime = {};
-    if (localtime_s(&localTime, &now) != 0)
+    ReadLease lease(*this);
+    if (!lease.Get())
     {
-        LogError(L"HistoryLogger::GetTotalsToday: localtime_s failed");
         return false;
     }
 
-    localTime.tm_hour = 0;
-    localTime.tm_min = 0;
-    localTime.tm_sec = 0;
+    // One running total per distinct interface (a handful in practice)
+    std::vector<RankedInterface> totals;
+    std::unordered_map<std::wstring, size_t> indexByName;
+    std::wstring key;
+    size_t lastIndex = 0;
 
-    std::time_t start = std::mktime(&localTime);
-    if (start == static_cast<std::time_t>(-1))
+    bool ok = ScanUsageRange(lease.Get(), static_cast<long long>(query.from), static_cast<long long>(to),
+                             ROLLUP_SECONDS, nullptr,
+                             [&](long long, std::wstring_view name,
+                                 unsigned long long down, unsigned long long up) {
+        if (totals.empty() || totals[lastIndex].interfaceName != name)
+        {
+            key.assign(name.data(), name.size());
+            auto it = indexByName.find(key);
+            if (it == indexByName.end())
+            {
+                it = indexByName.emplace(key, totals.size()).first;
+                totals.push_back(RankedInterface{ key, 0, 0 });
+            }
+            lastIndex = it->second;
+        }
+        totals[lastIndex].bytesDown += down;
+        totals[lastIndex].bytesUp += up;
+    });
+
+    if (!ok)
     {
-        LogError(L"HistoryLogger::GetTotalsToday: mktime(start) failed");
         return false;
     }
 
-    std::time_t end = start + 24 * 60 * 60;
+    TrafficMetric metric = query.metric;
+    auto better = [metric](const RankedInterface& a, const RankedInterface& b) {
+        unsigned long long va = MetricValue(metric, a.bytesDown, a.bytesUp);
+        unsigned long long vb = MetricValue(metric, b.bytesDown, b.bytesUp);
+        return (va != vb) ? (va > vb) : (a.interfaceName < b.interfaceName);
+    };
+    TopKCollector<RankedInterface, decltype(better)> top(query.k, better);
+    for (const RankedInterface& total : totals)
+    {
+        top.Offer(total);
+    }
 
-    const char* sql =
-        "SELECT COALESCE(SUM(bytes_down), 0), COALESCE(SUM(bytes_up), 0) "
-        "FROM usage WHERE timestamp >= ? AND timestamp < ?";
+    out = top.TakeSorted();
+    return true;
+}
+
+template <typename T>
+std::future<AsyncQueryResult<T>> HistoryLogger::SubmitQuery(const AsyncQueryOptions& options,
+                                                            std::function<bool(T&)> query)
+{
+    auto promise = std::make_shared<std::promise<AsyncQueryResult<T>>>();
+    std::future<AsyncQueryResult<T>> future = promise->get_future();
+
+    QueryTask task;
+    task.cancel = options.slot ? options.slot->Supersede() : std::make_shared<std::atomic<bool>>(false);
+    task.lastQueuedSeq = t_lastQueuedSeq;
+    task.run = [promise, query = std::move(query), onComplete = options.onComplete](const std::atomic<bool>& cancel) {
+        AsyncQueryResult<T> result;
+        if (!cancel.load())
+        {
+            // An exception must not escape the query thread (std::terminate)
+            // or leave the promise unset
+            try
+            {
+                result.ok = query(result.value);
+            }
+            catch (...)
+            {
+                NM_LOG_ERROR(L"HistoryLogger: asynchronous query failed with an exception");
+                result.ok = false;
+                result.value = T();
+            }
+        }
+
+        // A query interrupted part-way may still report success on what it
+        // read so far; the flag is what counts
+        result.cancelled = cancel.load();
+        if (result.cancelled)
+        {
+            result.ok = false;
+        }
+
+        promise->set_value(std::move(result));
+        if (onComplete)
+        {
+            onComplete();
+        }
+    };
 
-    bool useFilter = (interfaceFilter != nullptr && !interfaceFilter->empty());
-    if (useFilter)
     {
-        sql =
-            "SELECT COALESCE(SUM(bytes_down), 0), COALESCE(SUM(bytes_up), 0) "
-            "FROM usage WHERE timestamp >= ? AND timestamp < ? AND interface = ?";
+        std::lock_guard<std::mutex> lock(m_queryMutex);
+        if (!m_stopQueries)
+        {
+            if (m_queryThreads.empty())
+            {
+                for (int i = 0; i < HISTORY_QUERY_THREADS; ++i)
+                {
+                    m_queryThreads.emplace_back(&HistoryLogger::QueryThreadMain, this);
+                }
+            }
+
+            m_queryQueue.push_back(std::move(task));
+            task.run = nullptr;
+        }
     }
 
-    sqlite3_stmt* stmt = nullptr;
-    int rc = sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK || !stmt)
+    if (task.run)
     {
-        LogError(L"HistoryLogger::GetTotalsToday: sqlite3_prepare_v2 failed, rc=" + std::to_wstring(rc));
-        return false;
+        // Shutting down: report the query as cancelled without running it
+        task.cancel->store(true);
+        task.run(*task.cancel);
+    }
+    else
+    {
+        m_queryQueued.notify_one();
     }
 
-    sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(start));
-    sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(end));
+    return future;
+}
 
-    if (useFilter)
+void HistoryLogger::QueryThreadMain()
+{
+    for (;;)
     {
-        sqlite3_bind_text16(stmt, 3, interfaceFilter->c_str(), -1, nullptr);
+        QueryTask task;
+        {
+            std::unique_lock<std::mutex> lock(m_queryMutex);
+            m_queryQueued.wait(lock, [this]() { return m_stopQueries || !m_queryQueue.empty(); });
+
+            if (m_queryQueue.empty())
+            {
+                break;
+            }
+            task = std::move(m_queryQueue.front());
+            m_queryQueue.pop_front();
+        }
+
+        // Read-your-writes for the submitting thread, and in-flight
+        // cancellation for the connections this query leases
+        t_lastQueuedSeq = task.lastQueuedSeq;
+        t_queryCancel = task.cancel.get();
+        task.run(*task.cancel);
+        t_queryCancel = nullptr;
     }
+}
 
-    rc = sqlite3_step(stmt);
-    if (rc == SQLITE_ROW)
+void HistoryLogger::StopQueryThreads()
+{
+    std::vector<std::thread> threads;
     {
-        totalDown = static_cast<unsigned long long>(sqlite3_column_int64(stmt, 0));
-        totalUp = static_cast<unsigned long long>(sqlite3_column_int64(stmt, 1));
-    }
+        std::lock_guard<std::mutex> lock(m_queryMutex);
+        m_stopQueries = true;
 
-    sqlite3_finalize(stmt);
+        // Queued queries still complete their futures, as cancelled
+        for (QueryTask& task : m_queryQueue)
+        {
+            task.cancel->store(true);
+        }
+        threads.swap(m_queryThreads);
+    }
+    m_queryQueued.notify_all();
 
-    if (rc != SQLITE_ROW && rc != SQLITE_DONE)
+    for (std::thread& thread : threads)
     {
-        LogError(L"HistoryLogger::GetTotalsToday: sqlite3_step failed, rc=" + std::to_wstring(rc));
+        thread.join();
     }
+}
 
-    return (rc == SQLITE_ROW || rc == SQLITE_DONE);
+std::future<AsyncQueryResult<UsageTotals>> HistoryLogger::GetTotalsTodayAsync(
+    const std::wstring& interfaceFilter,
+    const AsyncQueryOptions& options)
+{
+    return SubmitQuery<UsageTotals>(options, [this, interfaceFilter](UsageTotals& out) {
+        return GetTotalsToday(out.bytesDown, out.bytesUp, &interfaceFilter);
+    });
 }
 
-bool HistoryLogger::GetTotalsThisMonth(unsigned long long& totalDown, unsigned long long& totalUp,
-                                       const std::wstring* interfaceFilter)
+std::future<AsyncQueryResult<UsageTotals>> HistoryLogger::GetTotalsThisMonthAsync(
+    const std::wstring& interfaceFilter,
+    const AsyncQueryOptions& options)
 {
-    totalDown = 0;
-    totalUp = 0;
+    return SubmitQuery<UsageTotals>(options, [this, interfaceFilter](UsageTotals& out) {
+        return GetTotalsThisMonth(out.bytesDown, out.bytesUp, &interfaceFilter);
+    });
+}
 
-    EnsureInitialized();
-    if (!m_sqliteAvailable || !m_db)
-    {
-        LogError(L"HistoryLogger::GetTotalsThisMonth: SQLite not available");
-        return false;
-    }
+std::future<AsyncQueryResult<std::vector<HistorySample>>> HistoryLogger::GetRecentSamplesAsync(
+    int limit,
+    const std::wstring& interfaceFilter,
+    bool onlyToday,
+    const AsyncQueryOptions& options)
+{
+    return SubmitQuery<std::vector<HistorySample>>(options,
+        [this, limit, interfaceFilter, onlyToday](std::vector<HistorySample>& out) {
+            return GetRecentSamples(limit, out, &interfaceFilter, onlyToday);
+        });
+}
 
-    std::time_t now = std::time(nullptr);
-    std::tm startTm = {};
-    if (localtime_s(&startTm, &now) != 0)
+std::future<AsyncQueryResult<HistoryCursor>> HistoryLogger::ForEachSampleAsync(
+    const HistoryQuery& query,
+    const HistorySampleVisitor& visitor,
+    const AsyncQueryOptions& options)
+{
+    // Own copies of what the query points at
+    std::wstring interfaceFilter = query.interfaceFilter ? *query.interfaceFilter : std::wstring();
+    bool hasAfter = (query.after != nullptr);
+    HistoryCursor after = hasAfter ? *query.after : HistoryCursor();
+
+    return SubmitQuery<HistoryCursor>(options,
+        [this, query, visitor, interfaceFilter, hasAfter, after](HistoryCursor& out) {
+            HistoryQuery copy = query;
+            copy.interfaceFilter = &interfaceFilter;
+            copy.after = hasAfter ? &after : nullptr;
+
+            // Stop between rows as soon as the query is superseded
+            const std::atomic<bool>* cancel = t_queryCancel;
+            return ForEachSample(copy, [&visitor, cancel](const HistorySampleView& row) {
+                return !(cancel && cancel->load(std::memory_order_relaxed)) && visitor(row);
+            }, &out);
+        });
+}
+
+std::future<AsyncQueryResult<unsigned long long>> HistoryLogger::ExportHistoryAsync(
+    const std::wstring& path,
+    HistoryExportFormat format,
+    std::time_t from,
+    std::time_t to,
+    const std::wstring& interfaceFilter,
+    const AsyncQueryOptions& options)
+{
+    return SubmitQuery<unsigned long long>(options,
+        [this, path, format, from, to, interfaceFilter](unsigned long long& rows) {
+            return ExportHistory(path, format, from, to, &interfaceFilter, &rows);
+        });
+}
+
+std::future<AsyncQueryResult<HistoryBackupStats>> HistoryLogger::BackupToAsync(
+    const std::wstring& path,
+    const HistoryBackupOptions& backupOptions,
+    const AsyncQueryOptions& options)
+{
+    return SubmitQuery<HistoryBackupStats>(options, [this, path, backupOptions](HistoryBackupStats& stats) {
+        return BackupTo(path, backupOptions, &stats);
+    });
+}
+
+std::future<AsyncQueryResult<std::vector<InterfaceRateStatistics>>> HistoryLogger::GetRateStatisticsAsync(
+    const RateQuery& query,
+    const AsyncQueryOptions& options)
+{
+    std::wstring interfaceFilter = query.interfaceFilter ? *query.interfaceFilter : std::wstring();
+    return SubmitQuery<std::vector<InterfaceRateStatistics>>(options,
+        [this, query, interfaceFilter](std::vector<InterfaceRateStatistics>& out) {
+            RateQuery copy = query;
+            copy.interfaceFilter = &interfaceFilter;
+            return GetRateStatistics(copy, out);
+        });
+}
+
+std::future<AsyncQueryResult<std::vector<RankedInterval>>> HistoryLogger::GetTopIntervalsAsync(
+    const TopKQuery& query,
+    const AsyncQueryOptions& options)
+{
+    std::wstring interfaceFilter = query.interfaceFilter ? *query.interfaceFilter : std::wstring();
+    return SubmitQuery<std::vector<RankedInterval>>(options,
+        [this, query, interfaceFilter](std::vector<RankedInterval>& out) {
+            TopKQuery copy = query;
+            copy.interfaceFilter = &interfaceFilter;
+            return GetTopIntervals(copy, out);
+        });
+}
+
+std::future<AsyncQueryResult<std::vector<RankedInterface>>> HistoryLogger::GetTopInterfacesAsync(
+    const TopKQuery& query,
+    const AsyncQueryOptions& options)
+{
+    std::wstring interfaceFilter = query.interfaceFilter ? *query.interfaceFilter : std::wstring();
+    return SubmitQuery<std::vector<RankedInterface>>(options,
+        [this, query, interfaceFilter](std::vector<RankedInterface>& out) {
+            TopKQuery copy = query;
+            copy.interfaceFilter = &interfaceFilter;
+            return GetTopInterfaces(copy, out);
+        });
+}
+
+std::future<AsyncQueryResult<std::vector<CalendarTotal>>> HistoryLogger::GetCalendarTotalsAsync(
+    CalendarUnit unit,
+    std::time_t from,
+    std::time_t to,
+    const std::wstring& interfaceFilter,
+    const AsyncQueryOptions& options)
+{
+    return SubmitQuery<std::vector<CalendarTotal>>(options,
+        [this, unit, from, to, interfaceFilter](std::vector<CalendarTotal>& out) {
+            return GetCalendarTotals(unit, from, to, &interfaceFilter, out);
+        });
+}
+
+std::future<AsyncQueryResult<BillingStatus>> HistoryLogger::GetBillingStatusAsync(
+    const std::wstring& interfaceFilter,
+    unsigned long long quotaBytes,
+    const AsyncQueryOptions& options)
+{
+    return SubmitQuery<BillingStatus>(options, [this, interfaceFilter, quotaBytes](BillingStatus& out) {
+        return GetBillingStatus(&interfaceFilter, quotaBytes, out);
+    });
+}
+
+bool HistoryLogger::ComputeStartOfToday(std::time_t& startOut)
+{
+    CalendarSpan today;
+    if (!GetLocalDay(std::time(nullptr), today))
     {
-        LogError(L"HistoryLogger::GetTotalsThisMonth: localtime_s failed");
         return false;
     }
 
-    startTm.tm_mday = 1;
-    startTm.tm_hour = 0;
-    startTm.tm_min = 0;
-    startTm.tm_sec = 0;
+    startOut = today.start;
+    return true;
+}
+
+void HistoryLogger::LogRecentSamplesDebug(int limit,
+                                          bool onlyToday,
+                                          const std::wstring* interfaceFilter,
+                                          const std::vector<HistorySample>& outSamples)
+{
+    // Runs on every history query: arguments go out raw, not concatenated
+    static constexpr LogFormat NO_SAMPLES_FORMAT(
+        L"HistoryLogger::GetRecentSamples: no samples returned (limit={}, onlyToday={}, interfaceFilter={})");
+    static constexpr LogFormat SAMPLES_FORMAT(
+        L"HistoryLogger::GetRecentSamples: {} samples returned (limit={}, onlyToday={}, interfaceFilter={})");
 
-    std::time_t start = std::mktime(&startTm);
-    if (start == static_cast<std::time_t>(-1))
+    LogInterned onlyTodayText(onlyToday ? L"true" : L"false");
+    const wchar_t* filterText = (interfaceFilter && !interfaceFilter->empty()) ? interfaceFilter->c_str() : L"<none>";
+    if (outSamples.empty())
     {
-        LogError(L"HistoryLogger::GetTotalsThisMonth: mktime(start) failed");
-        return false;
+        NM_LOG_DEBUG_FORMAT(NO_SAMPLES_FORMAT, limit, onlyTodayText, filterText);
     }
-
-    std::tm endTm = startTm;
-    endTm.tm_mon += 1;
-    if (endTm.tm_mon >= 12)
+    else
     {
-        endTm.tm_mon -= 12;
-        endTm.tm_year += 1;
+        NM_LOG_DEBUG_FORMAT(SAMPLES_FORMAT, outSamples.size(), limit, onlyTodayText, filterText);
     }
+}
 
-    std::time_t end = std::mktime(&endTm);
-    if (end == static_cast<std::time_t>(-1))
+namespace
+{
+    // Collect CREATE statements of the usage table's explicit indexes
+    std::vector<std::pair<std::string, std::string>> ListUsageIndexes(sqlite3* db)
     {
-        LogError(L"HistoryLogger::GetTotalsThisMonth: mktime(end) failed");
-        return false;
-    }
+        std::vector<std::pair<std::string, std::string>> indexes;
 
-    const char* sql =
-        "SELECT COALESCE(SUM(bytes_down), 0), COALESCE(SUM(bytes_up), 0) "
-        "FROM usage WHERE timestamp >= ? AND timestamp < ?";
+        sqlite3_stmt* stmt = nullptr;
+        const char* sql = "SELECT name, sql FROM sqlite_master "
+                          "WHERE type = 'index' AND tbl_name = 'usage' AND sql IS NOT NULL;";
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK)
+        {
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                indexes.emplace_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)),
+                                     reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
+            }
+        }
+        sqlite3_finalize(stmt);
+        return indexes;
+    }
+}
 
-    bool useFilter = (interfaceFilter != nullptr && !interfaceFilter->empty());
-    if (useFilter)
+bool HistoryLogger::ImportSamples(const HistorySampleProducer& producer,
+                                  const HistoryImportOptions& options,
+                                  unsigned long long* rowsOut)
+{
+    if (rowsOut)
     {
-        sql =
-            "SELECT COALESCE(SUM(bytes_down), 0), COALESCE(SUM(bytes_up), 0) "
-            "FROM usage WHERE timestamp >= ? AND timestamp < ? AND interface = ?";
+        *rowsOut = 0;
     }
 
-    sqlite3_stmt* stmt = nullptr;
-    int rc = sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK || !stmt)
+    EnsureInitialized();
+    if (!m_sqliteAvailable)
     {
-        LogError(L"HistoryLogger::GetTotalsThisMonth: sqlite3_prepare_v2 failed, rc=" + std::to_wstring(rc));
+        NM_LOG_ERROR(L"HistoryLogger::ImportSamples: SQLite not available");
         return false;
     }
 
-    sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(start));
-    sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(end));
+    unsigned long long committed = 0;
 
-    if (useFilter)
-    {
-        sqlite3_bind_text16(stmt, 3, interfaceFilter->c_str(), -1, nullptr);
-    }
+    bool ok = RunOnWriter([&](sqlite3* db) {
+        BulkInserter inserter(db, m_billingCycles);
+        if (!inserter.Prepare())
+        {
+            return false;
+        }
+        inserter.SetCoalescing(options.coalescing);
 
-    rc = sqlite3_step(stmt);
-    if (rc == SQLITE_ROW)
-    {
-        totalDown = static_cast<unsigned long long>(sqlite3_column_int64(stmt, 0));
-        totalUp = static_cast<unsigned long long>(sqlite3_column_int64(stmt, 1));
-    }
+        // Maintaining the timestamp index row by row dominates large loads;
+        // building it once afterwards is a single sorted pass. If the process
+        // dies mid-import, InitializeSQLite recreates idx_usage_ts.
+        std::vector<std::pair<std::string, std::string>> indexes;
+        if (options.rebuildIndexes)
+        {
+            indexes = ListUsageIndexes(db);
+            for (const auto& index : indexes)
+            {
+                std::string drop = "DROP INDEX IF EXISTS \"" + index.first + "\";";
+                sqlite3_exec(db, drop.c_str(), nullptr, nullptr, nullptr);
+            }
+        }
 
-    sqlite3_finalize(stmt);
+        unsigned long long rowsPerTransaction = (options.rowsPerTransaction > 0) ? options.rowsPerTransaction : 1;
+        unsigned long long imported = 0;
+        unsigned long long inTransaction = 0;
+        unsigned long long nextProgress = options.progressInterval;
+        bool writeOk = true;
+        bool cancelled = false;
 
-    if (rc != SQLITE_ROW && rc != SQLITE_DONE)
+        auto commit = [&]() {
+            writeOk = inserter.FlushPending() && writeOk;
+            if (sqlite3_exec(db, writeOk ? "COMMIT;" : "ROLLBACK;", nullptr, nullptr, nullptr) != SQLITE_OK)
+            {
+                writeOk = false;
+            }
+            if (writeOk)
+            {
+                committed += inTransaction;
+            }
+            inTransaction = 0;
+        };
+
+        bool producerOk = producer([&](const HistorySampleView& row) {
+            if (inTransaction == 0)
+            {
+                sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
+            }
+
+            writeOk = inserter.Add(row);
+            ++inTransaction;
+            ++imported;
+
+            if (writeOk && inTransaction >= rowsPerTransaction)
+            {
+                commit();
+            }
+
+            if (writeOk && options.progress && options.progressInterval > 0 && imported >= nextProgress)
+            {
+                nextProgress += options.progressInterval;
+                cancelled = !options.progress(imported);
+            }
+
+            return writeOk && !cancelled;
+        });
+
+        if (inTransaction > 0)
+        {
+            commit();
+        }
+
+        for (const auto& index : indexes)
+        {
+            int rc = sqlite3_exec(db, index.second.c_str(), nullptr, nullptr, nullptr);
+            if (rc != SQLITE_OK)
+            {
+                NM_LOG_ERROR(L"HistoryLogger::ImportSamples: recreating index failed, rc=" + std::to_wstring(rc));
+                writeOk = false;
+            }
+        }
+
+        if (options.progress && writeOk && !cancelled)
+        {
+            options.progress(committed);
+        }
+
+        FinishBulkChange(false);
+        return producerOk && writeOk && !cancelled;
+    });
+
+    // A failed transaction is rolled back; rows committed before it stay
+    if (rowsOut)
     {
-        LogError(L"HistoryLogger::GetTotalsThisMonth: sqlite3_step failed, rc=" + std::to_wstring(rc));
+        *rowsOut = committed;
     }
 
-    return (rc == SQLITE_ROW || rc == SQLITE_DONE);
+    NM_LOG_DEBUG(L"HistoryLogger::ImportSamples: imported " + std::to_wstring(committed) + L" rows" +
+             (ok ? L"" : L" (incomplete)"));
+    return ok;
 }
 
-bool HistoryLogger::GetRecentSamples(int limit, std::vector<HistorySample>& outSamples,
-                                     const std::wstring* interfaceFilter,
-                                     bool onlyToday)
+bool HistoryLogger::ImportHistory(const std::wstring& path,
+                                  HistoryExportFormat format,
+                                  const HistoryImportOptions& options,
+                                  unsigned long long* rowsOut)
 {
-    outSamples.clear();
+    bool readOk = true;
+    bool ok = ImportSamples([&](const HistorySampleVisitor& sink) {
+        readOk = ReadHistoryExport(path, format, sink);
+        return readOk;
+    }, options, rowsOut);
 
-    if (limit <= 0)
+    if (!readOk)
     {
-        return true;
+        NM_LOG_ERROR(L"HistoryLogger::ImportHistory: reading " + path + L" failed");
     }
+    return ok;
+}
 
-    EnsureInitialized();
-    if (!m_sqliteAvailable || !m_db)
+bool HistoryLogger::BackupTo(const std::wstring& path,
+                             const HistoryBackupOptions& options,
+                             HistoryBackupStats* statsOut)
+{
+    HistoryBackupStats stats;
+    if (statsOut)
     {
-        return false;
+        *statsOut = stats;
     }
 
-    // Build dynamic query based on filters
-    std::string sql =
-        "SELECT timestamp, interface, bytes_down, bytes_up FROM usage";
-
-    std::time_t startToday = 0;
-    bool restrictToday = onlyToday;
-    if (restrictToday)
+    ReadLease lease(*this);
+    sqlite3* db = lease.Get();
+    if (!db)
     {
-        if (!ComputeStartOfToday(startToday))
-        {
-            restrictToday = false;
-        }
+        NM_LOG_ERROR(L"HistoryLogger::BackupTo: SQLite not available");
+        return false;
     }
 
-    bool useFilter = (interfaceFilter != nullptr && !interfaceFilter->empty());
+    // Build next to the target and rename into place, so path is either
+    // the old file or a complete copy
+    std::wstring partialPath = path + L".partial";
+    DeleteFileW(partialPath.c_str());
 
-    bool hasWhere = false;
-    if (restrictToday)
+    // One read transaction for the whole copy: every step sees the same
+    // commit, and the writer's commits neither block nor restart it
+    bool ok = false;
+    ++m_backupsRunning;
     {
-        sql += " WHERE timestamp >= ?";
-        hasWhere = true;
+        ReadSnapshot snapshot(db);
+        ok = PinReadTransaction(db) && CopyDatabase(db, partialPath, options, stats);
     }
-
-    if (useFilter)
+    // A read-only process leaves checkpoints to the one that owns the file
+    if (!g_readOnly)
     {
-        sql += hasWhere ? " AND interface = ?" : " WHERE interface = ?";
-        hasWhere = true;
+        CheckpointAfterLongRead(m_dbPathUtf8);
     }
+    --m_backupsRunning;
 
-    sql += " ORDER BY timestamp DESC LIMIT ?";
-
-    sqlite3_stmt* stmt = nullptr;
-    int rc = sqlite3_prepare_v2(m_db, sql.c_str(), -1, &stmt, nullptr);
-    if (rc != SQLITE_OK || !stmt)
+    if (ok && !MoveFileExW(partialPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
     {
-        LogError(L"HistoryLogger::GetRecentSamples: sqlite3_prepare_v2 failed, rc=" + std::to_wstring(rc));
-        return false;
+        NM_LOG_ERROR(L"HistoryLogger::BackupTo: replacing " + path + L" failed, error=" +
+                 std::to_wstring(GetLastError()));
+        ok = false;
+    }
+    if (!ok)
+    {
+        DeleteFileW(partialPath.c_str());
     }
 
-    int bindIndex = 1;
-    if (restrictToday)
+    if (statsOut)
     {
-        sqlite3_bind_int64(stmt, bindIndex++, static_cast<sqlite3_int64>(startToday));
+        *statsOut = stats;
     }
-    if (useFilter)
+    if (ok)
     {
-        sqlite3_bind_text16(stmt, bindIndex++, interfaceFilter->c_str(), -1, nullptr);
+        NM_LOG_DEBUG(L"HistoryLogger::BackupTo: copied " + std::to_wstring(stats.pagesCopied) + L" pages to " +
+                 path + L" in " + std::to_wstring(stats.elapsedMicroseconds / 1000) + L" ms");
     }
+    return ok;
+}
 
-    sqlite3_bind_int(stmt, bindIndex, limit);
+std::unique_ptr<HistorySnapshot> HistoryLogger::OpenSnapshot(HistorySnapshotMode mode)
+{
+    EnsureInitialized();
+    if (!m_readsAvailable)
+    {
+        return nullptr;
+    }
 
-    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    if (mode == HistorySnapshotMode::PrivateCopy)
     {
-        HistorySample sample;
-        sample.timestamp = static_cast<std::time_t>(sqlite3_column_int64(stmt, 0));
+        static std::atomic<unsigned int> s_copyCounter(0);
 
-        const void* ifaceText = sqlite3_column_text16(stmt, 1);
-        if (ifaceText)
+        wchar_t tempDir[MAX_PATH] = {};
+        if (GetTempPathW(MAX_PATH, tempDir) == 0)
         {
-            sample.interfaceName.assign(static_cast<const wchar_t*>(ifaceText));
+            NM_LOG_ERROR(L"HistoryLogger::OpenSnapshot: GetTempPathW failed");
+            return nullptr;
         }
-        else
+        std::wstring copyPath = std::wstring(tempDir) + L"NetworkMonitor-snapshot-" +
+                                std::to_wstring(GetCurrentProcessId()) + L"-" +
+                                std::to_wstring(++s_copyCounter) + L".db";
+
+        if (!BackupTo(copyPath))
         {
-            sample.interfaceName.clear();
+            return nullptr;
         }
 
-        sample.bytesDown = static_cast<unsigned long long>(sqlite3_column_int64(stmt, 2));
-        sample.bytesUp = static_cast<unsigned long long>(sqlite3_column_int64(stmt, 3));
-
-        outSamples.push_back(std::move(sample));
+        sqlite3* copy = nullptr;
+        int rc = sqlite3_open16(copyPath.c_str(), &copy);
+        if (rc != SQLITE_OK || !copy)
+        {
+            NM_LOG_ERROR(L"HistoryLogger::OpenSnapshot: sqlite3_open16 failed, rc=" + std::to_wstring(rc));
+            if (copy)
+            {
+                sqlite3_close(copy);
+            }
+            DeleteFileW(copyPath.c_str());
+            return nullptr;
+        }
+        sqlite3_exec(copy, "PRAGMA query_only=ON;", nullptr, nullptr, nullptr);
+        return std::unique_ptr<HistorySnapshot>(new HistorySnapshot(*this, copy, copyPath));
     }
 
-    sqlite3_finalize(stmt);
-
-    if (rc != SQLITE_DONE)
+    // Include what this thread queued, like any other read
+    if (t_snapshotOwner != this)
     {
-        LogError(L"HistoryLogger::GetRecentSamples: sqlite3_step ended with rc=" + std::to_wstring(rc));
+        WaitForOwnWrites();
     }
 
-    LogRecentSamplesDebug(limit, onlyToday, interfaceFilter, outSamples);
-
-    return (rc == SQLITE_DONE);
-}
-
-bool HistoryLogger::ComputeStartOfToday(std::time_t& startOut)
-{
-    std::time_t now = std::time(nullptr);
-    std::tm localTime = {};
-    if (localtime_s(&localTime, &now) != 0)
+    sqlite3* db = nullptr;
+    if (t_snapshotOwner == this)
     {
-        return false;
+        // Nested in another snapshot: share its point in time
+        db = t_snapshotDb;
     }
-
-    localTime.tm_hour = 0;
-    localTime.tm_min = 0;
-    localTime.tm_sec = 0;
-
-    std::time_t start = std::mktime(&localTime);
-    if (start == static_cast<std::time_t>(-1))
+    else
     {
-        return false;
+        db = AcquireReader();
+        if (!db)
+        {
+            return nullptr;
+        }
+        if (sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr) != SQLITE_OK || !PinReadTransaction(db))
+        {
+            NM_LOG_ERROR(L"HistoryLogger::OpenSnapshot: starting the read transaction failed");
+            sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+            ReleaseReader(db);
+            return nullptr;
+        }
     }
+    return std::unique_ptr<HistorySnapshot>(new HistorySnapshot(*this, db, std::wstring()));
+}
 
-    startOut = start;
-    return true;
+HistorySnapshot::HistorySnapshot(HistoryLogger& owner, sqlite3* db, const std::wstring& copyPath)
+    : m_owner(owner)
+    , m_db(db)
+    , m_copyPath(copyPath)
+    , m_previousOwner(t_snapshotOwner)
+    , m_previousDb(t_snapshotDb)
+{
+    t_snapshotOwner = &m_owner;
+    t_snapshotDb = m_db;
 }
 
-void HistoryLogger::LogRecentSamplesDebug(int limit,
-                                          bool onlyToday,
-                                          const std::wstring* interfaceFilter,
-                                          const std::vector<HistorySample>& outSamples)
+HistorySnapshot::~HistorySnapshot()
 {
-    if (outSamples.empty())
+    t_snapshotOwner = m_previousOwner;
+    t_snapshotDb = m_previousDb;
+
+    if (!m_copyPath.empty())
     {
-        std::wstring info = L"HistoryLogger::GetRecentSamples: no samples returned (limit="
-            + std::to_wstring(limit)
-            + L", onlyToday=" + (onlyToday ? L"true" : L"false")
-            + L", interfaceFilter="
-            + ((interfaceFilter && !interfaceFilter->empty()) ? *interfaceFilter : L"<none>");
-        LogDebug(info);
+        sqlite3_close(m_db);
+        DeleteFileW(m_copyPath.c_str());
     }
-    else
+    else if (m_previousDb != m_db)
     {
-        std::wstring info = L"HistoryLogger::GetRecentSamples: "
-            + std::to_wstring(static_cast<unsigned long long>(outSamples.size()))
-            + L" samples returned (limit="
-            + std::to_wstring(limit)
-            + L", onlyToday=" + (onlyToday ? L"true" : L"false")
-            + L", interfaceFilter="
-            + ((interfaceFilter && !interfaceFilter->empty()) ? *interfaceFilter : L"<none>");
-        LogDebug(info);
+        sqlite3_exec(m_db, "COMMIT;", nullptr, nullptr, nullptr);
+        m_owner.ReleaseReader(m_db);
     }
 }
 
 bool HistoryLogger::DeleteAll()
 {
     EnsureInitialized();
-    if (!m_sqliteAvailable || !m_db)
+    if (!m_sqliteAvailable)
     {
-        LogError(L"HistoryLogger::DeleteAll: SQLite not available");
+        NM_LOG_ERROR(L"HistoryLogger::DeleteAll: SQLite not available");
         return false;
     }
 
-    const char* sql = "DELETE FROM usage;";
-    int rc = sqlite3_exec(m_db, sql, nullptr, nullptr, nullptr);
-    if (rc != SQLITE_OK && rc != SQLITE_DONE)
+    bool ok = RunOnWriter([this](sqlite3* db) {
+        const char* sql = "DELETE FROM usage; DELETE FROM usage_minute; DELETE FROM usage_hour; "
+                          "DELETE FROM retention_state; DELETE FROM billing_cycle;";
+        int rc = sqlite3_exec(db, sql, nullptr, nullptr, nullptr);
+        if (rc != SQLITE_OK && rc != SQLITE_DONE)
+        {
+            NM_LOG_ERROR(L"HistoryLogger::DeleteAll: sqlite3_exec failed, rc=" + std::to_wstring(rc));
+            return false;
+        }
+
+        // Freed pages go back to the file system in idle slices
+        FinishBulkChange(true);
+        return true;
+    });
+
+    if (ok)
     {
-        LogError(L"HistoryLogger::DeleteAll: sqlite3_exec failed, rc=" + std::to_wstring(rc));
-        return false;
+        NM_LOG_DEBUG(L"HistoryLogger::DeleteAll: deleted all history records");
     }
-
-    LogDebug(L"HistoryLogger::DeleteAll: deleted all history records");
-    return true;
+    return ok;
 }
 
 bool HistoryLogger::TrimToRecentDays(int days)
@@ -516,7 +4157,7 @@ bool HistoryLogger::TrimToRecentDays(int days)
     }
 
     EnsureInitialized();
-    if (!m_sqliteAvailable || !m_db)
+    if (!m_sqliteAvailable)
     {
         return false;
     }
@@ -524,29 +4165,70 @@ bool HistoryLogger::TrimToRecentDays(int days)
     std::time_t now = std::time(nullptr);
     std::time_t cutoff = now - static_cast<std::time_t>(static_cast<long long>(days) * 24 * 60 * 60);
 
-    const char* sql = "DELETE FROM usage WHERE timestamp < ?;";
+    bool ok = RunOnWriter([this, cutoff](sqlite3* db) {
+        // Keep the rollup in step: drop whole minutes up to the cutoff and
+        // rebuild the minute it falls in from the raw rows that remain,
+        // unless retention already expired some of them. Hours go by their
+        // start.
+        const char* statements[] = {
+            "DELETE FROM usage WHERE timestamp < ?1;",
+            "DELETE FROM usage_minute WHERE minute_start < ?2 OR (minute_start = ?2 AND "
+            "?2 >= (SELECT COALESCE(MAX(raw_floor), 0) FROM retention_state));",
+            "INSERT INTO usage_minute (minute_start, interface, bytes_down, bytes_up) "
+            "SELECT ?2, interface, SUM(bytes_down), SUM(bytes_up) FROM usage "
+            "WHERE timestamp >= ?2 AND timestamp < ?2 + 60 "
+            "AND ?2 >= (SELECT COALESCE(MAX(raw_floor), 0) FROM retention_state) GROUP BY interface;",
+            "DELETE FROM usage_hour WHERE hour_start < ?1;"
+        };
+        long long minute = RollupStart(static_cast<long long>(cutoff));
 
-    sqlite3_stmt* stmt = nullptr;
-    int rc = sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK || !stmt)
+        sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
+        bool trimmed = TrimSpansBefore(db, static_cast<long long>(cutoff)) &&
+                       RunBoundStatements(db, statements, sizeof(statements) / sizeof(statements[0]),
+                                          static_cast<long long>(cutoff), minute, L"HistoryLogger::TrimToRecentDays");
+        trimmed = trimmed && sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) == SQLITE_OK;
+        if (!trimmed && sqlite3_get_autocommit(db) == 0)
+        {
+            sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        }
+        FinishBulkChange(true);
+        return trimmed;
+    });
+
+    if (ok)
     {
-        LogError(L"HistoryLogger::TrimToRecentDays: sqlite3_prepare_v2 failed, rc=" + std::to_wstring(rc));
-        return false;
+        NM_LOG_DEBUG(L"HistoryLogger::TrimToRecentDays: trimmed history to last " + std::to_wstring(days) + L" days");
     }
+    return ok;
+}
 
-    sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(cutoff));
+void HistoryLogger::SetRetentionPolicy(const HistoryRetentionPolicy& policy)
+{
+    HistoryRetentionPolicy normalized = NormalizeRetentionPolicy(policy);
 
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    std::lock_guard<std::mutex> lock(m_maintenanceMutex);
+    m_retentionPolicy = normalized;
+    m_retentionChanged = true;
+}
+
+HistoryRetentionPolicy HistoryLogger::GetRetentionPolicy() const
+{
+    std::lock_guard<std::mutex> lock(m_maintenanceMutex);
+    return m_retentionPolicy;
+}
 
-    if (rc != SQLITE_DONE && rc != SQLITE_OK)
+bool HistoryLogger::SetCoalescingOptions(const HistoryCoalescingOptions& options)
+{
+    HistoryCoalescingOptions normalized = options;
+    if (!(normalized.rateTolerance > 0.0))
     {
-        LogError(L"HistoryLogger::TrimToRecentDays: sqlite3_step failed, rc=" + std::to_wstring(rc));
-        return false;
+        normalized.rateTolerance = 0.0;
     }
 
-    LogDebug(L"HistoryLogger::TrimToRecentDays: trimmed history to last " + std::to_wstring(days) + L" days");
-    return true;
+    // The inserter belongs to the writer thread
+    return RunOnWriter([this, normalized](sqlite3*) {
+        return m_sampleInserter->SetCoalescing(normalized);
+    });
 }
 
 } // namespace NetworkMonitor
@@ -0,0 +1,62 @@
+// ============================================================================
+// File: HistoryRetention.cpp
+// Description: Tiered retention policy for usage history (raw, minute, hour)
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#include "NetworkMonitor/HistoryRetention.h"
+#include <algorithm>
+
+namespace NetworkMonitor
+{
+
+namespace
+{
+    constexpr long long SECONDS_PER_DAY = 24LL * 60 * 60;
+
+    int ClampDays(int days)
+    {
+        return (std::max)(0, (std::min)(days, MAX_HISTORY_TIER_DAYS));
+    }
+
+    // A coarser tier keeps at least as long as the finer one; 0 is forever
+    int AtLeast(int days, int finerDays)
+    {
+        if (days == 0 || finerDays == 0)
+        {
+            return 0;
+        }
+        return (std::max)(days, finerDays);
+    }
+}
+
+HistoryRetentionPolicy NormalizeRetentionPolicy(const HistoryRetentionPolicy& policy)
+{
+    HistoryRetentionPolicy result;
+    result.rawDays = ClampDays(policy.rawDays);
+    result.minuteDays = AtLeast(ClampDays(policy.minuteDays), result.rawDays);
+    result.hourDays = AtLeast(ClampDays(policy.hourDays), result.minuteDays);
+    result.maxSizeMB = (std::min)(policy.maxSizeMB, MAX_HISTORY_SIZE_MB);
+    return result;
+}
+
+RetentionCutoffs GetRetentionCutoffs(const HistoryRetentionPolicy& policy, std::time_t now)
+{
+    RetentionCutoffs cutoffs;
+    long long t = static_cast<long long>(now);
+    if (policy.rawDays > 0)
+    {
+        cutoffs.raw = static_cast<std::time_t>(t - policy.rawDays * SECONDS_PER_DAY);
+    }
+    if (policy.minuteDays > 0)
+    {
+        cutoffs.minute = static_cast<std::time_t>(HourStart(t - policy.minuteDays * SECONDS_PER_DAY));
+    }
+    if (policy.hourDays > 0)
+    {
+        cutoffs.hour = static_cast<std::time_t>(HourStart(t - policy.hourDays * SECONDS_PER_DAY));
+    }
+    return cutoffs;
+}
+
+} // namespace NetworkMonitor
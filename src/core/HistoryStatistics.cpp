@@ -0,0 +1,69 @@
+// ============================================================================
+// File: HistoryStatistics.cpp
+// Description: Rate percentiles and histograms over usage history
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#include "NetworkMonitor/HistoryStatistics.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace NetworkMonitor
+{
+
+namespace
+{
+    // Index of the p-th percentile in ascending order: the highest sample
+    // left after discarding the top (1 - p) share.
+    size_t PercentileIndex(size_t count, double fraction)
+    {
+        size_t rank = static_cast<size_t>(std::ceil(fraction * static_cast<double>(count)));
+        return (rank > 0) ? rank - 1 : 0;
+    }
+}
+
+RateDistribution ComputeRateDistribution(std::vector<double>& rates, int histogramBins)
+{
+    RateDistribution result;
+    if (histogramBins < 1)
+    {
+        histogramBins = 1;
+    }
+    result.histogram.assign(static_cast<size_t>(histogramBins), 0);
+
+    if (rates.empty())
+    {
+        return result;
+    }
+
+    double sum = 0.0;
+    for (double rate : rates)
+    {
+        sum += rate;
+    }
+    result.mean = sum / static_cast<double>(rates.size());
+
+    // Each selection only partitions the tail left by the previous one
+    size_t i95 = PercentileIndex(rates.size(), 0.95);
+    std::nth_element(rates.begin(), rates.begin() + i95, rates.end());
+    result.p95 = rates[i95];
+
+    size_t i99 = PercentileIndex(rates.size(), 0.99);
+    std::nth_element(rates.begin() + i95, rates.begin() + i99, rates.end());
+    result.p99 = rates[i99];
+
+    result.max = *std::max_element(rates.begin() + i99, rates.end());
+
+    result.binWidth = (result.max > 0.0) ? result.max / histogramBins : 1.0;
+    size_t lastBin = static_cast<size_t>(histogramBins - 1);
+    for (double rate : rates)
+    {
+        size_t bin = static_cast<size_t>(rate / result.binWidth);
+        ++result.histogram[(std::min)(bin, lastBin)];
+    }
+
+    return result;
+}
+
+} // namespace NetworkMonitor
@@ -0,0 +1,241 @@
+// ============================================================================
+// File: LocalCalendar.cpp
+// Description: Precomputed local day and month boundaries for fast bucketing
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#include "NetworkMonitor/LocalCalendar.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace NetworkMonitor
+{
+
+namespace
+{
+    std::mutex g_sharedMutex;
+    std::shared_ptr<const LocalCalendar> g_shared;
+
+    std::time_t LocalMidnight(int year, int month, int day)
+    {
+        std::tm local = {};
+        local.tm_year = year - 1900;
+        local.tm_mon = month;
+        local.tm_mday = day;
+        local.tm_isdst = -1;   // Let mktime decide whether DST applies that day
+        return std::mktime(&local);
+    }
+
+    bool LocalYear(std::time_t t, int& year)
+    {
+        std::tm local = {};
+        if (localtime_s(&local, &t) != 0)
+        {
+            return false;
+        }
+        year = local.tm_year + 1900;
+        return true;
+    }
+
+    // Day or month containing t straight from the CRT, for timestamps
+    // outside the shared calendar
+    bool GetLocalSpanSlow(std::time_t t, bool month, CalendarSpan& out)
+    {
+        std::tm local = {};
+        if (localtime_s(&local, &t) != 0)
+        {
+            return false;
+        }
+
+        int year = local.tm_year + 1900;
+        int day = month ? 1 : local.tm_mday;
+        std::time_t start = LocalMidnight(year, local.tm_mon, day);
+        // mktime normalizes the day or month past the end
+        std::time_t end = month ? LocalMidnight(year, local.tm_mon + 1, 1)
+                                : LocalMidnight(year, local.tm_mon, day + 1);
+        if (start == static_cast<std::time_t>(-1) || end == static_cast<std::time_t>(-1))
+        {
+            return false;
+        }
+
+        out.start = start;
+        out.end = end;
+        return true;
+    }
+}
+
+int GetDaysInMonth(int year, int month)
+{
+    static const int DAYS[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    if (month == 1)
+    {
+        bool leap = (year % 4 == 0 && year % 100 != 0) || (year % 400 == 0);
+        return leap ? 29 : 28;
+    }
+    return DAYS[month];
+}
+
+LocalCalendar::LocalCalendar()
+    : m_firstYear(0)
+{
+}
+
+bool LocalCalendar::Build(int firstYear, int lastYear)
+{
+    m_dayStarts.clear();
+    m_dayMonth.clear();
+    m_monthFirstDay.clear();
+
+    if (lastYear < firstYear)
+    {
+        return false;
+    }
+
+    const size_t years = static_cast<size_t>(lastYear - firstYear + 1);
+    m_dayStarts.reserve(years * 366 + 1);
+    m_dayMonth.reserve(years * 366);
+    m_monthFirstDay.reserve(years * 12 + 1);
+    m_firstYear = firstYear;
+
+    int monthIndex = 0;
+    for (int year = firstYear; year <= lastYear; ++year)
+    {
+        for (int month = 0; month < 12; ++month, ++monthIndex)
+        {
+            m_monthFirstDay.push_back(static_cast<int>(m_dayStarts.size()));
+
+            int days = GetDaysInMonth(year, month);
+            for (int day = 1; day <= days; ++day)
+            {
+                std::time_t start = LocalMidnight(year, month, day);
+                if (start == static_cast<std::time_t>(-1))
+                {
+                    m_dayStarts.clear();
+                    m_dayMonth.clear();
+                    m_monthFirstDay.clear();
+                    return false;
+                }
+
+                // A day skipped by a zone change (the date line moving) gets
+                // no seconds rather than an out-of-order start
+                if (!m_dayStarts.empty())
+                {
+                    start = (std::max)(start, m_dayStarts.back());
+                }
+
+                m_dayStarts.push_back(start);
+                m_dayMonth.push_back(monthIndex);
+            }
+        }
+    }
+
+    std::time_t end = LocalMidnight(lastYear + 1, 0, 1);
+    if (end == static_cast<std::time_t>(-1))
+    {
+        m_dayStarts.clear();
+        m_dayMonth.clear();
+        m_monthFirstDay.clear();
+        return false;
+    }
+
+    m_dayStarts.push_back((std::max)(end, m_dayStarts.back()));
+    m_monthFirstDay.push_back(static_cast<int>(m_dayMonth.size()));
+    return true;
+}
+
+std::shared_ptr<const LocalCalendar> LocalCalendar::Shared(std::time_t from, std::time_t to)
+{
+    std::lock_guard<std::mutex> lock(g_sharedMutex);
+
+    if (g_shared && g_shared->Covers(from) && g_shared->Covers(to))
+    {
+        return g_shared;
+    }
+
+    int fromYear = 0;
+    int toYear = 0;
+    if (!LocalYear(from, fromYear) || !LocalYear(to, toYear))
+    {
+        return nullptr;
+    }
+
+    int firstYear = 0;
+    int lastYear = 0;
+    if (g_shared)
+    {
+        firstYear = g_shared->FirstYear();
+        lastYear = g_shared->LastYear();
+    }
+    else
+    {
+        int nowYear = 0;
+        if (!LocalYear(std::time(nullptr), nowYear))
+        {
+            return nullptr;
+        }
+        firstYear = nowYear - LOCAL_CALENDAR_YEARS_BACK;
+        lastYear = nowYear + LOCAL_CALENDAR_YEARS_AHEAD;
+    }
+
+    firstYear = (std::min)(firstYear, (std::min)(fromYear, toYear));
+    lastYear = (std::max)(lastYear, (std::max)(fromYear, toYear));
+    if (lastYear - firstYear + 1 > LOCAL_CALENDAR_MAX_YEARS)
+    {
+        return nullptr;
+    }
+
+    auto calendar = std::make_shared<LocalCalendar>();
+    if (!calendar->Build(firstYear, lastYear))
+    {
+        return nullptr;
+    }
+
+    g_shared = calendar;
+    return g_shared;
+}
+
+void LocalCalendar::Reset()
+{
+    std::lock_guard<std::mutex> lock(g_sharedMutex);
+    g_shared.reset();
+}
+
+std::time_t LocalCalendar::DayOfMonthStart(int month, int dayOfMonth) const
+{
+    if (month < 0 || month >= MonthCount())
+    {
+        return static_cast<std::time_t>(-1);
+    }
+
+    int day = (std::max)(1, (std::min)(dayOfMonth, DaysInMonth(month)));
+    return m_dayStarts[m_monthFirstDay[month] + day - 1];
+}
+
+bool GetLocalDay(std::time_t t, CalendarSpan& out)
+{
+    std::shared_ptr<const LocalCalendar> calendar = LocalCalendar::Shared(t);
+    if (calendar && calendar->Covers(t))
+    {
+        int day = calendar->DayIndex(t);
+        out.start = calendar->DayStart(day);
+        out.end = calendar->DayEnd(day);
+        return true;
+    }
+    return GetLocalSpanSlow(t, false, out);
+}
+
+bool GetLocalMonth(std::time_t t, CalendarSpan& out)
+{
+    std::shared_ptr<const LocalCalendar> calendar = LocalCalendar::Shared(t);
+    if (calendar && calendar->Covers(t))
+    {
+        int month = calendar->MonthIndex(t);
+        out.start = calendar->MonthStart(month);
+        out.end = calendar->MonthEnd(month);
+        return true;
+    }
+    return GetLocalSpanSlow(t, true, out);
+}
+
+} // namespace NetworkMonitor
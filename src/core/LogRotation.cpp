@@ -0,0 +1,784 @@
+// ============================================================================
+// File: LogRotation.cpp
+// Description: Size- and age-capped log files with compressed archives
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#include "NetworkMonitor/LogRotation.h"
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+
+namespace NetworkMonitor
+{
+
+namespace
+{
+    constexpr unsigned long long FILETIME_TICKS_PER_SECOND = 10000000ULL;
+    constexpr unsigned long long FILETIME_TICKS_PER_MS = 10000ULL;
+
+    // "YYYYMMDD-HHMMSS-mmm"
+    constexpr size_t ARCHIVE_STAMP_LENGTH = 19;
+
+    unsigned long long CurrentFileTime()
+    {
+        FILETIME now = {};
+        GetSystemTimeAsFileTime(&now);
+        return (static_cast<unsigned long long>(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+    }
+
+    struct LogPathParts
+    {
+        std::wstring directory;     // With the trailing separator, or empty
+        std::wstring stem;          // "NetworkMonitor"
+        std::wstring extension;     // ".log", or empty
+    };
+
+    LogPathParts SplitLogPath(const std::wstring& path)
+    {
+        LogPathParts parts;
+        size_t slash = path.find_last_of(L"\\/");
+        size_t nameStart = (slash == std::wstring::npos) ? 0 : slash + 1;
+        parts.directory = path.substr(0, nameStart);
+        std::wstring name = path.substr(nameStart);
+        size_t dot = name.rfind(L'.');
+        if (dot == std::wstring::npos || dot == 0)
+        {
+            parts.stem = name;
+        }
+        else
+        {
+            parts.stem = name.substr(0, dot);
+            parts.extension = name.substr(dot);
+        }
+        return parts;
+    }
+
+    std::wstring FormatArchiveStamp(unsigned long long fileTime)
+    {
+        FILETIME ft = {};
+        ft.dwLowDateTime = static_cast<DWORD>(fileTime & 0xFFFFFFFFULL);
+        ft.dwHighDateTime = static_cast<DWORD>(fileTime >> 32);
+        SYSTEMTIME utc = {};
+        FileTimeToSystemTime(&ft, &utc);
+
+        wchar_t stamp[32] = {0};
+        swprintf(stamp, 32, L"%04u%02u%02u-%02u%02u%02u-%03u",
+                 utc.wYear, utc.wMonth, utc.wDay, utc.wHour, utc.wMinute, utc.wSecond, utc.wMilliseconds);
+        return stamp;
+    }
+
+    bool IsArchiveStamp(const std::wstring& text, size_t offset)
+    {
+        if (text.size() < offset + ARCHIVE_STAMP_LENGTH)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < ARCHIVE_STAMP_LENGTH; ++i)
+        {
+            wchar_t c = text[offset + i];
+            bool ok = (i == 8 || i == 15) ? (c == L'-') : (c >= L'0' && c <= L'9');
+            if (!ok)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool ParseArchiveStamp(const std::wstring& stamp, unsigned long long& fileTimeOut)
+    {
+        if (!IsArchiveStamp(stamp, 0))
+        {
+            return false;
+        }
+        auto number = [&stamp](size_t offset, size_t digits) {
+            unsigned int value = 0;
+            for (size_t i = 0; i < digits; ++i)
+            {
+                value = value * 10 + static_cast<unsigned int>(stamp[offset + i] - L'0');
+            }
+            return static_cast<WORD>(value);
+        };
+
+        SYSTEMTIME utc = {};
+        utc.wYear = number(0, 4);
+        utc.wMonth = number(4, 2);
+        utc.wDay = number(6, 2);
+        utc.wHour = number(9, 2);
+        utc.wMinute = number(11, 2);
+        utc.wSecond = number(13, 2);
+        utc.wMilliseconds = number(16, 3);
+        FILETIME ft = {};
+        if (!SystemTimeToFileTime(&utc, &ft))
+        {
+            return false;
+        }
+        fileTimeOut = (static_cast<unsigned long long>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+        return true;
+    }
+
+    bool FileExists(const std::wstring& path)
+    {
+        WIN32_FILE_ATTRIBUTE_DATA data = {};
+        return GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data) != 0;
+    }
+
+    bool EndsWith(const std::wstring& text, const std::wstring& suffix)
+    {
+        return text.size() >= suffix.size() &&
+               text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    const std::wstring GZIP_SUFFIX = L".gz";
+
+    // ------------------------------------------------------------------
+    // Deflate (RFC 1951) with the fixed Huffman codes: no code tables to
+    // build or store, and repetitive log text still shrinks several times
+    // ------------------------------------------------------------------
+
+    constexpr size_t DEFLATE_WINDOW = 32768;
+    constexpr size_t DEFLATE_MIN_MATCH = 3;
+    constexpr size_t DEFLATE_MAX_MATCH = 258;
+    constexpr int DEFLATE_HASH_BITS = 15;
+    constexpr int DEFLATE_MAX_CHAIN = 32;
+    constexpr size_t DEFLATE_READ_BYTES = 256 * 1024;
+    constexpr size_t DEFLATE_WRITE_BYTES = 64 * 1024;
+
+    const unsigned short LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                             35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const unsigned char LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                             3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const unsigned short DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                               257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                               8193, 12289, 16385, 24577 };
+    const unsigned char DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                               7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    unsigned int ReverseBits(unsigned int value, int length)
+    {
+        unsigned int result = 0;
+        for (int i = 0; i < length; ++i)
+        {
+            result = (result << 1) | (value & 1);
+            value >>= 1;
+        }
+        return result;
+    }
+
+    struct DeflateTables
+    {
+        unsigned short literalCode[288];    // Bit-reversed, ready to emit
+        unsigned char literalLength[288];
+        unsigned char lengthSymbol[DEFLATE_MAX_MATCH + 1];  // Index into LENGTH_BASE
+        unsigned int crc[256];
+
+        DeflateTables()
+        {
+            for (unsigned int symbol = 0; symbol < 288; ++symbol)
+            {
+                unsigned int code = 0;
+                int length = 0;
+                if (symbol <= 143)
+                {
+                    code = 0x30 + symbol;
+                    length = 8;
+                }
+                else if (symbol <= 255)
+                {
+                    code = 0x190 + (symbol - 144);
+                    length = 9;
+                }
+                else if (symbol <= 279)
+                {
+                    code = symbol - 256;
+                    length = 7;
+                }
+                else
+                {
+                    code = 0xC0 + (symbol - 280);
+                    length = 8;
+                }
+                literalCode[symbol] = static_cast<unsigned short>(ReverseBits(code, length));
+                literalLength[symbol] = static_cast<unsigned char>(length);
+            }
+
+            unsigned char index = 0;
+            for (size_t length = DEFLATE_MIN_MATCH; length <= DEFLATE_MAX_MATCH; ++length)
+            {
+                while (index < 28 && LENGTH_BASE[index + 1] <= length)
+                {
+                    ++index;
+                }
+                lengthSymbol[length] = index;
+            }
+
+            for (unsigned int n = 0; n < 256; ++n)
+            {
+                unsigned int c = n;
+                for (int k = 0; k < 8; ++k)
+                {
+                    c = (c & 1) ? (0xEDB88320U ^ (c >> 1)) : (c >> 1);
+                }
+                crc[n] = c;
+            }
+        }
+    };
+
+    const DeflateTables& GetDeflateTables()
+    {
+        static const DeflateTables tables;
+        return tables;
+    }
+
+    class BitWriter
+    {
+    public:
+        explicit BitWriter(std::string& out)
+            : m_out(out)
+            , m_bits(0)
+            , m_count(0)
+        {
+        }
+
+        // Values go out least significant bit first
+        void Put(unsigned int value, int length)
+        {
+            m_bits |= static_cast<unsigned long long>(value) << m_count;
+            m_count += length;
+            while (m_count >= 8)
+            {
+                m_out += static_cast<char>(m_bits & 0xFF);
+                m_bits >>= 8;
+                m_count -= 8;
+            }
+        }
+
+        void Finish()
+        {
+            if (m_count > 0)
+            {
+                m_out += static_cast<char>(m_bits & 0xFF);
+            }
+            m_bits = 0;
+            m_count = 0;
+        }
+
+    private:
+        std::string& m_out;
+        unsigned long long m_bits;
+        int m_count;
+    };
+
+    bool WriteAll(HANDLE file, std::string& buffer)
+    {
+        size_t offset = 0;
+        while (offset < buffer.size())
+        {
+            DWORD written = 0;
+            if (!WriteFile(file, buffer.data() + offset, static_cast<DWORD>(buffer.size() - offset), &written, nullptr) ||
+                written == 0)
+            {
+                return false;
+            }
+            offset += written;
+        }
+        buffer.clear();
+        return true;
+    }
+
+    void AppendLittleEndian32(std::string& out, unsigned int value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            out += static_cast<char>((value >> (8 * i)) & 0xFF);
+        }
+    }
+}
+
+bool CompressFileToGzip(const std::wstring& source, const std::wstring& target)
+{
+    // No write sharing: an archive someone still appends to fails here
+    HANDLE input = CreateFileW(source.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (input == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    HANDLE output = CreateFileW(target.c_str(), GENERIC_WRITE, 0, nullptr,
+                                CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (output == INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(input);
+        return false;
+    }
+
+    const DeflateTables& tables = GetDeflateTables();
+    std::string out;
+    // gzip member header: deflate, no name, no mtime, NTFS
+    const unsigned char header[10] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 11 };
+    out.append(reinterpret_cast<const char*>(header), sizeof(header));
+
+    BitWriter bits(out);
+    bits.Put(1, 1);     // BFINAL: one block for the whole stream
+    bits.Put(1, 2);     // BTYPE 01: fixed Huffman codes
+
+    auto putSymbol = [&](unsigned int symbol) { bits.Put(tables.literalCode[symbol], tables.literalLength[symbol]); };
+
+    // data holds up to DEFLATE_WINDOW bytes before pos for back references
+    std::vector<unsigned char> data;
+    std::vector<long long> head(static_cast<size_t>(1) << DEFLATE_HASH_BITS, -1);
+    std::vector<long long> prev(DEFLATE_WINDOW, -1);
+    long long base = 0;     // Stream position of data[0]
+    size_t pos = 0;
+    bool eof = false;
+    bool ok = true;
+    unsigned int crc = 0xFFFFFFFFU;
+    unsigned int totalBytes = 0;    // Modulo 2^32, as gzip stores it
+
+    auto hashAt = [&data](size_t at) {
+        unsigned int h = (static_cast<unsigned int>(data[at]) << 10) ^
+                         (static_cast<unsigned int>(data[at + 1]) << 5) ^ data[at + 2];
+        return static_cast<size_t>(h & ((1U << DEFLATE_HASH_BITS) - 1));
+    };
+    auto insert = [&](size_t at) {
+        size_t h = hashAt(at);
+        long long position = base + static_cast<long long>(at);
+        prev[static_cast<size_t>(position) & (DEFLATE_WINDOW - 1)] = head[h];
+        head[h] = position;
+    };
+
+    for (;;)
+    {
+        if (!eof && data.size() - pos < DEFLATE_MAX_MATCH + 1)
+        {
+            if (pos > DEFLATE_WINDOW)
+            {
+                size_t drop = pos - DEFLATE_WINDOW;
+                data.erase(data.begin(), data.begin() + static_cast<std::ptrdiff_t>(drop));
+                base += static_cast<long long>(drop);
+                pos -= drop;
+            }
+
+            size_t offset = data.size();
+            data.resize(offset + DEFLATE_READ_BYTES);
+            DWORD read = 0;
+            if (!ReadFile(input, &data[offset], static_cast<DWORD>(DEFLATE_READ_BYTES), &read, nullptr))
+            {
+                ok = false;
+                read = 0;
+            }
+            data.resize(offset + read);
+            eof = (read == 0);
+            for (size_t i = offset; i < data.size(); ++i)
+            {
+                crc = tables.crc[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+            }
+            totalBytes += static_cast<unsigned int>(read);
+            continue;
+        }
+
+        size_t available = data.size() - pos;
+        if (available == 0)
+        {
+            break;
+        }
+
+        size_t bestLength = 0;
+        size_t bestDistance = 0;
+        if (available >= DEFLATE_MIN_MATCH)
+        {
+            size_t maxLength = std::min(available, DEFLATE_MAX_MATCH);
+            long long position = base + static_cast<long long>(pos);
+            long long candidate = head[hashAt(pos)];
+            for (int chain = 0; candidate >= 0 && chain < DEFLATE_MAX_CHAIN; ++chain)
+            {
+                size_t distance = static_cast<size_t>(position - candidate);
+                if (distance > DEFLATE_WINDOW)
+                {
+                    break;
+                }
+                const unsigned char* a = &data[static_cast<size_t>(candidate - base)];
+                const unsigned char* b = &data[pos];
+                if (a[bestLength] == b[bestLength])
+                {
+                    size_t length = 0;
+                    while (length < maxLength && a[length] == b[length])
+                    {
+                        ++length;
+                    }
+                    if (length > bestLength)
+                    {
+                        bestLength = length;
+                        bestDistance = distance;
+                        if (length == maxLength)
+                        {
+                            break;
+                        }
+                    }
+                }
+
+                long long next = prev[static_cast<size_t>(candidate) & (DEFLATE_WINDOW - 1)];
+                if (next >= candidate)
+                {
+                    break;
+                }
+                candidate = next;
+            }
+            insert(pos);
+        }
+
+        if (bestLength >= DEFLATE_MIN_MATCH)
+        {
+            unsigned char lengthIndex = tables.lengthSymbol[bestLength];
+            putSymbol(257 + lengthIndex);
+            if (LENGTH_EXTRA[lengthIndex] > 0)
+            {
+                bits.Put(static_cast<unsigned int>(bestLength - LENGTH_BASE[lengthIndex]), LENGTH_EXTRA[lengthIndex]);
+            }
+
+            int distanceIndex = 29;
+            while (DISTANCE_BASE[distanceIndex] > bestDistance)
+            {
+                --distanceIndex;
+            }
+            bits.Put(ReverseBits(static_cast<unsigned int>(distanceIndex), 5), 5);
+            if (DISTANCE_EXTRA[distanceIndex] > 0)
+            {
+                bits.Put(static_cast<unsigned int>(bestDistance - DISTANCE_BASE[distanceIndex]),
+                         DISTANCE_EXTRA[distanceIndex]);
+            }
+
+            for (size_t i = 1; i < bestLength; ++i)
+            {
+                if (pos + i + DEFLATE_MIN_MATCH <= data.size())
+                {
+                    insert(pos + i);
+                }
+            }
+            pos += bestLength;
+        }
+        else
+        {
+            putSymbol(data[pos]);
+            ++pos;
+        }
+
+        if (out.size() >= DEFLATE_WRITE_BYTES && !WriteAll(output, out))
+        {
+            ok = false;
+            break;
+        }
+    }
+
+    putSymbol(256);     // End of block
+    bits.Finish();
+    AppendLittleEndian32(out, crc ^ 0xFFFFFFFFU);
+    AppendLittleEndian32(out, totalBytes);
+    ok = ok && WriteAll(output, out);
+
+    CloseHandle(output);
+    CloseHandle(input);
+    if (!ok)
+    {
+        DeleteFileW(target.c_str());
+    }
+    return ok;
+}
+
+std::vector<std::wstring> ListLogArchives(const std::wstring& logPath)
+{
+    std::vector<std::wstring> archives;
+    LogPathParts parts = SplitLogPath(logPath);
+    std::wstring prefix = parts.stem + L".";
+
+    WIN32_FIND_DATAW found = {};
+    std::wstring pattern = parts.directory + prefix + L"*";
+    HANDLE search = FindFirstFileW(pattern.c_str(), &found);
+    if (search == INVALID_HANDLE_VALUE)
+    {
+        return archives;
+    }
+
+    do
+    {
+        std::wstring name = found.cFileName;
+        if (name.compare(0, prefix.size(), prefix) != 0 || !IsArchiveStamp(name, prefix.size()))
+        {
+            continue;
+        }
+        std::wstring rest = name.substr(prefix.size() + ARCHIVE_STAMP_LENGTH);
+        if (rest == parts.extension || rest == parts.extension + GZIP_SUFFIX)
+        {
+            archives.push_back(parts.directory + name);
+        }
+    } while (FindNextFileW(search, &found));
+    FindClose(search);
+
+    // The stamp sorts by time
+    std::sort(archives.begin(), archives.end());
+    return archives;
+}
+
+RotatingLogFile::RotatingLogFile(const std::wstring& path)
+    : m_path(path)
+    , m_file(INVALID_HANDLE_VALUE)
+    , m_size(0)
+    , m_startTime(0)
+    , m_swept(false)
+    , m_archiveStop(false)
+{
+    m_archiveOptions = m_options;
+}
+
+RotatingLogFile::~RotatingLogFile()
+{
+    Close();
+
+    {
+        std::lock_guard<std::mutex> lock(m_archiveMutex);
+        m_archiveStop = true;
+    }
+    m_archiveWake.notify_one();
+    if (m_archiveThread.joinable())
+    {
+        m_archiveThread.join();
+    }
+}
+
+void RotatingLogFile::SetOptions(const LogRotationOptions& options)
+{
+    m_options = options;
+    std::lock_guard<std::mutex> lock(m_archiveMutex);
+    m_archiveOptions = options;
+}
+
+bool RotatingLogFile::Open()
+{
+    if (m_file != INVALID_HANDLE_VALUE)
+    {
+        return true;
+    }
+
+    // Append-only access: every write lands at the current end, even
+    // with another instance logging to the same file
+    m_file = CreateFileW(m_path.c_str(), FILE_APPEND_DATA,
+                         FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                         OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size = {};
+    m_size = GetFileSizeEx(m_file, &size) ? static_cast<unsigned long long>(size.QuadPart) : 0;
+
+    if (!m_swept)
+    {
+        m_swept = true;
+
+        // The file was started when the newest archive was moved aside;
+        // with no archive its age counts from now
+        std::vector<std::wstring> archives = ListLogArchives(m_path);
+        m_startTime = CurrentFileTime();
+        if (m_size > 0 && !archives.empty())
+        {
+            LogPathParts parts = SplitLogPath(m_path);
+            std::wstring newest = archives.back().substr(parts.directory.size() + parts.stem.size() + 1,
+                                                         ARCHIVE_STAMP_LENGTH);
+            ParseArchiveStamp(newest, m_startTime);
+        }
+
+        // Archives an earlier run moved aside but did not get to compress
+        for (const std::wstring& archive : archives)
+        {
+            if (!EndsWith(archive, GZIP_SUFFIX))
+            {
+                QueueArchiveWork(archive);
+            }
+        }
+    }
+    else if (m_size == 0)
+    {
+        m_startTime = CurrentFileTime();
+    }
+    return true;
+}
+
+void RotatingLogFile::Close()
+{
+    if (m_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+}
+
+unsigned long long RotatingLogFile::GetRoom()
+{
+    if (!Open() || m_options.maxFileBytes == 0)
+    {
+        return ULLONG_MAX;
+    }
+    return (m_size >= m_options.maxFileBytes) ? 0 : m_options.maxFileBytes - m_size;
+}
+
+bool RotatingLogFile::IsEmpty()
+{
+    return Open() && m_size == 0;
+}
+
+bool RotatingLogFile::IsAged()
+{
+    if (m_options.maxFileAgeSeconds == 0 || !Open() || m_size == 0)
+    {
+        return false;
+    }
+    unsigned long long age = CurrentFileTime() - m_startTime;
+    return age >= m_options.maxFileAgeSeconds * FILETIME_TICKS_PER_SECOND;
+}
+
+bool RotatingLogFile::Append(const char* data, size_t bytes)
+{
+    bool ok = Open();
+    size_t offset = 0;
+    while (ok && offset < bytes)
+    {
+        DWORD written = 0;
+        DWORD chunk = static_cast<DWORD>(bytes - offset);
+        ok = WriteFile(m_file, data + offset, chunk, &written, nullptr) && written > 0;
+        offset += written;
+        m_size += written;
+    }
+
+    if (!ok)
+    {
+        // Reopen on the next write, in case the file was moved away
+        Close();
+    }
+    return ok;
+}
+
+bool RotatingLogFile::Rotate()
+{
+    if (!Open())
+    {
+        return false;
+    }
+    if (m_size == 0)
+    {
+        m_startTime = CurrentFileTime();
+        return true;
+    }
+    Close();
+
+    // A unique name even for two rotations within a millisecond
+    LogPathParts parts = SplitLogPath(m_path);
+    unsigned long long stampTime = CurrentFileTime();
+    std::wstring archive;
+    for (;;)
+    {
+        archive = parts.directory + parts.stem + L"." + FormatArchiveStamp(stampTime) + parts.extension;
+        if (!FileExists(archive) && !FileExists(archive + GZIP_SUFFIX))
+        {
+            break;
+        }
+        stampTime += FILETIME_TICKS_PER_MS;
+    }
+
+    // The writer holds no handle now, so the rename moves every byte
+    // written so far and the next write creates a fresh file
+    bool moved = MoveFileExW(m_path.c_str(), archive.c_str(), 0) != 0;
+    bool opened = Open();
+    if (moved)
+    {
+        m_startTime = stampTime;
+        {
+            std::lock_guard<std::mutex> lock(m_archiveMutex);
+            ++m_stats.rotations;
+        }
+        QueueArchiveWork(archive);
+    }
+    return moved && opened;
+}
+
+LogRotationStats RotatingLogFile::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_archiveMutex);
+    return m_stats;
+}
+
+void RotatingLogFile::QueueArchiveWork(const std::wstring& archive)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_archiveMutex);
+        m_archiveQueue.push_back(archive);
+        if (!m_archiveThread.joinable())
+        {
+            m_archiveThread = std::thread([this]() { ArchiveThreadMain(); });
+        }
+    }
+    m_archiveWake.notify_one();
+}
+
+void RotatingLogFile::PruneArchives(unsigned int keepFiles)
+{
+    std::vector<std::wstring> archives = ListLogArchives(m_path);
+    if (archives.size() <= keepFiles)
+    {
+        return;
+    }
+
+    size_t excess = archives.size() - keepFiles;
+    unsigned long long deleted = 0;
+    for (size_t i = 0; i < excess; ++i)
+    {
+        deleted += DeleteFileW(archives[i].c_str()) ? 1 : 0;
+    }
+
+    std::lock_guard<std::mutex> lock(m_archiveMutex);
+    m_stats.deleted += deleted;
+}
+
+void RotatingLogFile::ArchiveThreadMain()
+{
+    for (;;)
+    {
+        std::wstring archive;
+        LogRotationOptions options;
+        {
+            std::unique_lock<std::mutex> lock(m_archiveMutex);
+            m_archiveWake.wait(lock, [this]() { return m_archiveStop || !m_archiveQueue.empty(); });
+            if (m_archiveQueue.empty())
+            {
+                return;
+            }
+            archive = m_archiveQueue.front();
+            m_archiveQueue.pop_front();
+            options = m_archiveOptions;
+        }
+
+        if (options.compress && FileExists(archive))
+        {
+            // Written under a temporary name so a crash never leaves a
+            // truncated .gz that looks complete
+            std::wstring compressed = archive + GZIP_SUFFIX;
+            std::wstring partial = compressed + L".partial";
+            if (CompressFileToGzip(archive, partial) &&
+                MoveFileExW(partial.c_str(), compressed.c_str(), MOVEFILE_REPLACE_EXISTING))
+            {
+                DeleteFileW(archive.c_str());
+                std::lock_guard<std::mutex> lock(m_archiveMutex);
+                ++m_stats.compressed;
+            }
+            else
+            {
+                DeleteFileW(partial.c_str());
+            }
+        }
+
+        PruneArchives(options.keepFiles);
+    }
+}
+
+} // namespace NetworkMonitor
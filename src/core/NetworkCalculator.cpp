@@ -5,6 +5,7 @@
 // ============================================================================
 
 #include "NetworkMonitor/NetworkCalculator.h"
+#include "NetworkMonitor/StringCatalog.h"
 #include "NetworkMonitor/Utils.h"
 #include "../../resources/resource.h"
 #include <algorithm>
@@ -102,17 +103,11 @@ bool NetworkCalculator::UpdateStats(NetworkStats& stats, ULONG64 currentBytesIn,
 NetworkStats NetworkCalculator::CalculateAggregate(const std::vector<NetworkStats>& statsList)
 {
     NetworkStats aggregate;
-    aggregate.interfaceName = LoadStringResource(IDS_ALL_INTERFACES);
-    if (aggregate.interfaceName.empty())
-    {
-        aggregate.interfaceName = L"All Interfaces";
-    }
+    std::wstring_view name = LoadStringView(IDS_ALL_INTERFACES);
+    aggregate.interfaceName.assign(name.empty() ? std::wstring_view(L"All Interfaces") : name);
 
-    aggregate.interfaceDesc = LoadStringResource(IDS_AGGREGATED_STATS);
-    if (aggregate.interfaceDesc.empty())
-    {
-        aggregate.interfaceDesc = L"Aggregated Statistics";
-    }
+    std::wstring_view desc = LoadStringView(IDS_AGGREGATED_STATS);
+    aggregate.interfaceDesc.assign(desc.empty() ? std::wstring_view(L"Aggregated Statistics") : desc);
 
     if (statsList.empty())
     {
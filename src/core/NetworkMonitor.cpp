@@ -31,7 +31,7 @@ bool NetworkMonitorClass::Start()
     // Initialize by querying interfaces once
     if (!QueryNetworkInterfaces())
     {
-        LogError(L"NetworkMonitorClass::Start: initial QueryNetworkInterfaces failed");
+        NM_LOG_ERROR(L"NetworkMonitorClass::Start: initial QueryNetworkInterfaces failed");
         return false;
     }
 
@@ -101,7 +101,7 @@ bool NetworkMonitorClass::QueryNetworkInterfaces()
     DWORD result = GetIfTable2(&pIfTable);
     if (result != NO_ERROR)
     {
-        LogError(L"NetworkMonitorClass::QueryNetworkInterfaces: GetIfTable2 failed, error=" + std::to_wstring(result));
+        NM_LOG_ERROR(L"NetworkMonitorClass::QueryNetworkInterfaces: GetIfTable2 failed, error=" + std::to_wstring(result));
         return false;
     }
 
@@ -159,7 +159,7 @@ bool NetworkMonitorClass::QueryNetworkInterfaces()
     catch (...)
     {
         FreeMibTable(pIfTable);
-        LogError(L"NetworkMonitorClass::QueryNetworkInterfaces: exception while processing interface table");
+        NM_LOG_ERROR(L"NetworkMonitorClass::QueryNetworkInterfaces: exception while processing interface table");
         return false;
     }
 
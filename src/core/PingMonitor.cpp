@@ -14,11 +14,12 @@ namespace NetworkMonitor
 {
 
 PingMonitor::PingMonitor()
-    : m_hIcmp(INVALID_HANDLE_VALUE)
+    : m_targetId(0)
     , m_initialized(false)
     , m_latency(-1)
     , m_target(L"8.8.8.8")
     , m_targetIP(0)
+    , m_intervalMs(5000)
 {
 }
 
@@ -27,7 +28,7 @@ PingMonitor::~PingMonitor()
     Cleanup();
 }
 
-bool PingMonitor::Initialize(const std::wstring& target)
+bool PingMonitor::Initialize(const std::wstring& target, UINT intervalMs)
 {
     if (m_initialized)
     {
@@ -35,30 +36,32 @@ bool PingMonitor::Initialize(const std::wstring& target)
     }
 
     m_target = target;
+    m_intervalMs = intervalMs;
     if (!ResolveTarget())
     {
-        LogError(L"PingMonitor::Initialize: Failed to resolve target");
+        NM_LOG_ERROR(L"PingMonitor::Initialize: Failed to resolve target");
         return false;
     }
 
-    m_hIcmp = IcmpCreateFile();
-    if (m_hIcmp == INVALID_HANDLE_VALUE)
+    if (!m_engine.Start())
     {
-        LogError(L"PingMonitor::Initialize: IcmpCreateFile failed");
+        NM_LOG_ERROR(L"PingMonitor::Initialize: ProbeEngine failed to start");
         return false;
     }
 
+    AddTarget();
     m_initialized = true;
-    LogDebug(L"PingMonitor::Initialize: success, target=" + m_target);
+    NM_LOG_DEBUG(L"PingMonitor::Initialize: success, target=" + m_target);
     return true;
 }
 
 void PingMonitor::Cleanup()
 {
-    if (m_hIcmp != INVALID_HANDLE_VALUE)
+    m_engine.Stop();
+    if (m_targetId != 0)
     {
-        IcmpCloseHandle(m_hIcmp);
-        m_hIcmp = INVALID_HANDLE_VALUE;
+        m_engine.RemoveTarget(m_targetId);
+        m_targetId = 0;
     }
 
     m_initialized = false;
@@ -72,6 +75,34 @@ void PingMonitor::SetTarget(const std::wstring& target)
     {
         m_target = target;
         ResolveTarget();
+        if (m_initialized)
+        {
+            // A fresh target, so no reply to the old address is counted
+            AddTarget();
+        }
+    }
+}
+
+void PingMonitor::SetInterval(UINT intervalMs)
+{
+    m_intervalMs = intervalMs;
+    if (m_targetId != 0)
+    {
+        m_engine.SetTargetInterval(m_targetId, intervalMs);
+    }
+}
+
+void PingMonitor::AddTarget()
+{
+    if (m_targetId != 0)
+    {
+        m_engine.RemoveTarget(m_targetId);
+        m_targetId = 0;
+    }
+    m_latency = -1;
+    if (m_targetIP != 0)
+    {
+        m_targetId = m_engine.AddTarget(m_targetIP, m_intervalMs, TIMEOUT_MS);
     }
 }
 
@@ -121,44 +152,14 @@ bool PingMonitor::ResolveTarget()
 
 void PingMonitor::Update()
 {
-    if (!m_initialized || m_hIcmp == INVALID_HANDLE_VALUE || m_targetIP == 0)
+    ProbeStats stats;
+    if (!m_initialized || m_targetId == 0 || !m_engine.GetStats(m_targetId, stats) || stats.lastRttMs < 0.0)
     {
         m_latency = -1;
         return;
     }
 
-    // Prepare reply buffer
-    char replyBuffer[sizeof(ICMP_ECHO_REPLY) + 8];
-    DWORD replySize = sizeof(replyBuffer);
-
-    // Send ICMP echo request (no data payload)
-    DWORD result = IcmpSendEcho(
-        m_hIcmp,
-        m_targetIP,
-        nullptr,    // No send data
-        0,          // No send data size
-        nullptr,    // No IP options
-        replyBuffer,
-        replySize,
-        TIMEOUT_MS
-    );
-
-    if (result > 0)
-    {
-        PICMP_ECHO_REPLY pReply = reinterpret_cast<PICMP_ECHO_REPLY>(replyBuffer);
-        if (pReply->Status == IP_SUCCESS)
-        {
-            m_latency = static_cast<int>(pReply->RoundTripTime);
-        }
-        else
-        {
-            m_latency = -1;
-        }
-    }
-    else
-    {
-        m_latency = -1;
-    }
+    m_latency = static_cast<int>(stats.lastRttMs + 0.5);
 }
 
 } // namespace NetworkMonitor
@@ -0,0 +1,1076 @@
+// ============================================================================
+// File: ProbeEngine.cpp
+// Description: Asynchronous ICMP echo probes to many targets on one thread
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#include "NetworkMonitor/ProbeEngine.h"
+#include "NetworkMonitor/Utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef _WIN32
+#include <iphlpapi.h>
+#include <icmpapi.h>
+#pragma comment(lib, "iphlpapi.lib")
+#elif defined(__linux__)
+#include <cerrno>
+#include <arpa/inet.h>
+#include <linux/icmp.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace NetworkMonitor
+{
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    constexpr unsigned int WHEEL_TICK_MS = 5;
+    constexpr size_t WHEEL_SLOTS = 1024;        // One turn is 5.12 s; later timers wait whole turns
+    constexpr size_t WHEEL_WORDS = WHEEL_SLOTS / 64;
+    constexpr size_t SEQUENCE_COUNT = 65536;    // Every 16-bit sequence number
+    constexpr size_t BATCH_SIZE = 64;           // Packets per sendmmsg / recvmmsg call
+
+    constexpr uint8_t ECHO_REPLY_TYPE = 0;
+    constexpr uint8_t ECHO_REQUEST_TYPE = 8;
+
+    // Echoed back unchanged; ties a reply to the probe that asked for it
+    struct ProbePayload
+    {
+        uint32_t cookie;                        // Random per engine
+        uint32_t slot;
+        uint32_t generation;
+        uint32_t sequence;
+    };
+
+    struct EchoPacket
+    {
+        uint8_t type;
+        uint8_t code;
+        uint16_t checksum;
+        uint16_t identifier;                    // Network byte order
+        uint16_t sequence;                      // Network byte order
+        ProbePayload payload;
+    };
+
+    static_assert(sizeof(EchoPacket) == 8 + sizeof(ProbePayload), "EchoPacket must not be padded");
+
+    // Internet checksum (RFC 1071)
+    uint16_t InternetChecksum(const void* data, size_t length)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        uint32_t sum = 0;
+        for (size_t i = 0; i + 1 < length; i += 2)
+        {
+            uint16_t word = 0;
+            std::memcpy(&word, bytes + i, sizeof(word));
+            sum += word;
+        }
+        if ((length & 1) != 0)
+        {
+            uint16_t word = 0;
+            std::memcpy(&word, bytes + length - 1, 1);
+            sum += word;
+        }
+        while ((sum >> 16) != 0)
+        {
+            sum = (sum & 0xFFFF) + (sum >> 16);
+        }
+        return static_cast<uint16_t>(~sum);
+    }
+
+    unsigned int ToTicks(unsigned int milliseconds)
+    {
+        return (milliseconds + WHEEL_TICK_MS - 1) / WHEEL_TICK_MS;
+    }
+
+    // Index of the lowest set bit; bits must not be 0
+    unsigned int LowestSetBit(uint64_t bits)
+    {
+#if defined(_MSC_VER) && defined(_WIN64)
+        unsigned long index = 0;
+        _BitScanForward64(&index, bits);
+        return static_cast<unsigned int>(index);
+#elif defined(_MSC_VER)
+        unsigned long index = 0;
+        if (_BitScanForward(&index, static_cast<unsigned long>(bits)))
+        {
+            return static_cast<unsigned int>(index);
+        }
+        _BitScanForward(&index, static_cast<unsigned long>(bits >> 32));
+        return static_cast<unsigned int>(index) + 32;
+#else
+        return static_cast<unsigned int>(__builtin_ctzll(bits));
+#endif
+    }
+
+    struct Timer
+    {
+        uint64_t dueTick;
+        size_t slot;
+        uint32_t generation;
+        uint16_t sequence;
+        bool isTimeout;                         // Otherwise the target's next send
+    };
+
+    /**
+     * Hashed timer wheel: a timer sits in the bucket of its due tick modulo
+     * the wheel size, so scheduling is O(1) and each tick looks at one
+     * bucket. Timers more than a turn away stay put until their turn. A
+     * bitmap of non-empty buckets finds the next one a word at a time.
+     */
+    class TimerWheel
+    {
+    public:
+        TimerWheel()
+            : m_buckets(WHEEL_SLOTS)
+            , m_occupied()
+            , m_nextTick(0)
+            , m_count(0)
+        {
+        }
+
+        void Reset(uint64_t tick)
+        {
+            for (std::vector<Timer>& bucket : m_buckets)
+            {
+                bucket.clear();
+            }
+            std::fill(m_occupied, m_occupied + WHEEL_WORDS, 0ULL);
+            m_nextTick = tick;
+            m_count = 0;
+        }
+
+        // A timer already due fires on the next Advance
+        void Schedule(Timer timer)
+        {
+            timer.dueTick = (std::max)(timer.dueTick, m_nextTick);
+            size_t index = static_cast<size_t>(timer.dueTick % WHEEL_SLOTS);
+            m_buckets[index].push_back(timer);
+            m_occupied[index / 64] |= 1ULL << (index % 64);
+            ++m_count;
+        }
+
+        // Appends every timer due by nowTick to fired
+        void Advance(uint64_t nowTick, std::vector<Timer>& fired)
+        {
+            if (nowTick < m_nextTick)
+            {
+                return;
+            }
+            // After a stall longer than a turn, every bucket is looked at once
+            uint64_t steps = (std::min)(nowTick - m_nextTick + 1, static_cast<uint64_t>(WHEEL_SLOTS));
+            for (uint64_t step = 0; step < steps; ++step)
+            {
+                size_t index = static_cast<size_t>((m_nextTick + step) % WHEEL_SLOTS);
+                std::vector<Timer>& bucket = m_buckets[index];
+                if (bucket.empty())
+                {
+                    continue;
+                }
+                size_t kept = 0;
+                for (size_t i = 0; i < bucket.size(); ++i)
+                {
+                    if (bucket[i].dueTick <= nowTick)
+                    {
+                        fired.push_back(bucket[i]);
+                    }
+                    else
+                    {
+                        bucket[kept++] = bucket[i];
+                    }
+                }
+                m_count -= bucket.size() - kept;
+                bucket.resize(kept);
+                if (kept == 0)
+                {
+                    m_occupied[index / 64] &= ~(1ULL << (index % 64));
+                }
+            }
+            m_nextTick = nowTick + 1;
+        }
+
+        bool Empty() const { return m_count == 0; }
+
+        // No timer fires before this tick (it may be a turn early)
+        uint64_t GetNextDueTick() const
+        {
+            // From the bucket of m_nextTick round to just before it: the
+            // first word without the buckets already behind, then whole
+            // words, then the first word again for the wrap
+            size_t start = static_cast<size_t>(m_nextTick % WHEEL_SLOTS);
+            size_t word = start / 64;
+            uint64_t bits = m_occupied[word] & (~0ULL << (start % 64));
+            for (size_t scanned = 0; scanned <= WHEEL_WORDS; ++scanned)
+            {
+                if (bits != 0)
+                {
+                    size_t index = word * 64 + LowestSetBit(bits);
+                    return m_nextTick + (index + WHEEL_SLOTS - start) % WHEEL_SLOTS;
+                }
+                word = (word + 1) % WHEEL_WORDS;
+                bits = m_occupied[word];
+            }
+            return m_nextTick + WHEEL_SLOTS;
+        }
+
+    private:
+        std::vector<std::vector<Timer>> m_buckets;
+        uint64_t m_occupied[WHEEL_WORDS];       // Bit per non-empty bucket
+        uint64_t m_nextTick;
+        size_t m_count;
+    };
+}
+
+// ============================================================================
+// ENGINE THREAD
+// ============================================================================
+
+class ProbeEngine::Worker
+{
+public:
+    explicit Worker(ProbeEngine& engine);
+    ~Worker();
+
+    Worker(const Worker&) = delete;
+    Worker& operator=(const Worker&) = delete;
+
+    bool Open();
+    void Run();
+    void Wake();
+    void RequestStop();
+
+private:
+    struct Probe
+    {
+        size_t slot;
+        uint32_t generation;
+        uint32_t address;
+        unsigned int timeoutMs;
+        uint16_t sequence;
+    };
+
+    struct InFlight
+    {
+        size_t slot;
+        uint32_t generation;
+        uint32_t address;
+        Clock::time_point sent;
+        bool active;
+    };
+
+    struct Result
+    {
+        size_t slot;
+        uint32_t generation;
+        double rttMs;                       // -1 = lost
+    };
+
+    uint64_t NowTick() const;
+    uint16_t AllocateSequence();
+    void ScheduleAdded(uint64_t nowTick);
+    void FireTimers(uint64_t nowTick);
+    void FailProbe(const Probe& probe);
+    void OnReply(uint16_t sequence, uint32_t address, const ProbePayload& payload, Clock::time_point received);
+    void Publish();
+    void BuildPacket(const Probe& probe, EchoPacket& packet) const;
+
+    // Platform parts
+    void SendProbes();
+    void WaitForReplies(int timeoutMs);
+    void Close();
+
+    ProbeEngine& m_engine;
+    TimerWheel m_wheel;
+    std::vector<Timer> m_fired;
+    std::vector<InFlight> m_inFlight;       // By sequence number
+    std::vector<Probe> m_due;
+    std::vector<Result> m_results;
+    std::vector<std::pair<unsigned int, double>> m_callbacks;
+    Clock::time_point m_epoch;
+    uint16_t m_nextSequence;
+    uint16_t m_identifier;
+    uint32_t m_cookie;
+    std::atomic<bool> m_stop;
+
+#ifdef _WIN32
+    struct PendingEcho;
+    static void NTAPI OnEchoComplete(PVOID context, PIO_STATUS_BLOCK status, ULONG reserved);
+
+    HANDLE m_icmp;
+    HANDLE m_wakeEvent;
+    unsigned int m_pending;                 // Echo requests whose completion has not run
+#elif defined(__linux__)
+    void ReceiveReplies();
+
+    int m_socket;
+    int m_epoll;
+    int m_wakeFd;
+    bool m_rawSocket;                       // Replies start with the IP header
+    EchoPacket m_sendPackets[BATCH_SIZE];
+    sockaddr_in m_sendAddresses[BATCH_SIZE];
+    iovec m_sendVectors[BATCH_SIZE];
+    mmsghdr m_sendMessages[BATCH_SIZE];
+    uint8_t m_receiveBuffers[BATCH_SIZE][128];
+    sockaddr_in m_receiveAddresses[BATCH_SIZE];
+    iovec m_receiveVectors[BATCH_SIZE];
+    mmsghdr m_receiveMessages[BATCH_SIZE];
+#endif
+};
+
+ProbeEngine::Worker::Worker(ProbeEngine& engine)
+    : m_engine(engine)
+    , m_inFlight(SEQUENCE_COUNT)
+    , m_epoch(Clock::now())
+    , m_nextSequence(0)
+    , m_identifier(0)
+    , m_cookie(0)
+    , m_stop(false)
+#ifdef _WIN32
+    , m_icmp(INVALID_HANDLE_VALUE)
+    , m_wakeEvent(nullptr)
+    , m_pending(0)
+#elif defined(__linux__)
+    , m_socket(-1)
+    , m_epoll(-1)
+    , m_wakeFd(-1)
+    , m_rawSocket(false)
+#endif
+{
+    std::random_device random;
+    m_identifier = static_cast<uint16_t>(random());
+    m_nextSequence = static_cast<uint16_t>(random());
+    m_cookie = static_cast<uint32_t>(random());
+    for (InFlight& probe : m_inFlight)
+    {
+        probe.active = false;
+    }
+    m_fired.reserve(BATCH_SIZE);
+    m_due.reserve(BATCH_SIZE);
+}
+
+ProbeEngine::Worker::~Worker()
+{
+    // On Windows, Run has drained every echo completion before returning
+    Close();
+}
+
+void ProbeEngine::Worker::RequestStop()
+{
+    m_stop.store(true, std::memory_order_release);
+    Wake();
+}
+
+uint64_t ProbeEngine::Worker::NowTick() const
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - m_epoch);
+    return static_cast<uint64_t>(elapsed.count()) / WHEEL_TICK_MS;
+}
+
+uint16_t ProbeEngine::Worker::AllocateSequence()
+{
+    for (size_t attempt = 0; attempt < SEQUENCE_COUNT; ++attempt)
+    {
+        uint16_t sequence = m_nextSequence++;
+        if (!m_inFlight[sequence].active)
+        {
+            return sequence;
+        }
+    }
+    return m_nextSequence++;
+}
+
+void ProbeEngine::Worker::Run()
+{
+    m_wheel.Reset(NowTick());
+    while (!m_stop.load(std::memory_order_acquire))
+    {
+        uint64_t nowTick = NowTick();
+        ScheduleAdded(nowTick);
+        m_wheel.Advance(nowTick, m_fired);
+        FireTimers(nowTick);
+        SendProbes();
+        Publish();
+
+        int timeoutMs = -1;
+        if (!m_wheel.Empty())
+        {
+            uint64_t dueMs = m_wheel.GetNextDueTick() * WHEEL_TICK_MS;
+            uint64_t nowMs = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - m_epoch).count());
+            timeoutMs = (dueMs > nowMs) ? static_cast<int>(dueMs - nowMs) : 0;
+        }
+        WaitForReplies(timeoutMs);
+        Publish();
+    }
+
+#ifdef _WIN32
+    // Completions are APCs queued to this thread and each frees its own
+    // buffers. Every request completes within its timeout, replied to or
+    // not, so wait for all of them rather than leak any
+    while (m_pending > 0)
+    {
+        SleepEx(INFINITE, TRUE);
+    }
+#endif
+}
+
+void ProbeEngine::Worker::ScheduleAdded(uint64_t nowTick)
+{
+    std::lock_guard<std::mutex> lock(m_engine.m_mutex);
+    for (size_t slot : m_engine.m_added)
+    {
+        const Target& target = m_engine.m_targets[slot];
+        Timer timer = {};
+        timer.dueTick = nowTick + ToTicks(target.firstDelayMs);
+        timer.slot = slot;
+        timer.generation = target.generation;
+        timer.isTimeout = false;
+        m_wheel.Schedule(timer);
+    }
+    m_engine.m_added.clear();
+}
+
+void ProbeEngine::Worker::FireTimers(uint64_t nowTick)
+{
+    if (m_fired.empty())
+    {
+        return;
+    }
+
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(m_engine.m_mutex);
+    for (const Timer& timer : m_fired)
+    {
+        Target& target = m_engine.m_targets[timer.slot];
+        if (timer.isTimeout)
+        {
+            InFlight& probe = m_inFlight[timer.sequence];
+            if (probe.active && probe.slot == timer.slot && probe.generation == timer.generation)
+            {
+                probe.active = false;
+                m_results.push_back({ timer.slot, timer.generation, -1.0 });
+            }
+            continue;
+        }
+
+        // A removed target's timers run out here
+        if (target.id == 0 || target.generation != timer.generation)
+        {
+            continue;
+        }
+
+        Probe probe = {};
+        probe.slot = timer.slot;
+        probe.generation = timer.generation;
+        probe.address = target.address;
+        probe.timeoutMs = target.timeoutMs;
+        probe.sequence = AllocateSequence();
+        m_due.push_back(probe);
+
+        InFlight& inFlight = m_inFlight[probe.sequence];
+        inFlight.slot = probe.slot;
+        inFlight.generation = probe.generation;
+        inFlight.address = probe.address;
+        inFlight.sent = now;
+        inFlight.active = true;
+        ++target.stats.sent;
+
+        Timer timeout = timer;
+        timeout.dueTick = nowTick + ToTicks(target.timeoutMs);
+        timeout.sequence = probe.sequence;
+        timeout.isTimeout = true;
+        m_wheel.Schedule(timeout);
+
+        // Keep the target's phase; a late tick does not push later probes back
+        Timer next = timer;
+        next.dueTick = (std::max)(timer.dueTick + ToTicks(target.intervalMs), nowTick + 1);
+        m_wheel.Schedule(next);
+    }
+    m_fired.clear();
+}
+
+void ProbeEngine::Worker::FailProbe(const Probe& probe)
+{
+    InFlight& inFlight = m_inFlight[probe.sequence];
+    if (inFlight.active)
+    {
+        inFlight.active = false;
+        m_results.push_back({ probe.slot, probe.generation, -1.0 });
+    }
+}
+
+void ProbeEngine::Worker::OnReply(uint16_t sequence, uint32_t address, const ProbePayload& payload,
+                                  Clock::time_point received)
+{
+    InFlight& probe = m_inFlight[sequence];
+    if (!probe.active || payload.cookie != m_cookie || payload.sequence != sequence ||
+        payload.slot != probe.slot || payload.generation != probe.generation || address != probe.address)
+    {
+        // Late, duplicated or somebody else's
+        return;
+    }
+
+    probe.active = false;
+    double rttMs = std::chrono::duration<double, std::milli>(received - probe.sent).count();
+    m_results.push_back({ probe.slot, probe.generation, rttMs });
+}
+
+void ProbeEngine::Worker::Publish()
+{
+    if (m_results.empty())
+    {
+        return;
+    }
+
+    m_callbacks.clear();
+    {
+        std::lock_guard<std::mutex> lock(m_engine.m_mutex);
+        for (const Result& result : m_results)
+        {
+            Target& target = m_engine.m_targets[result.slot];
+            if (target.id == 0 || target.generation != result.generation)
+            {
+                continue;
+            }
+            if (result.rttMs >= 0.0)
+            {
+                ++target.stats.received;
+            }
+            else
+            {
+                ++target.stats.lost;
+            }
+            target.stats.lastRttMs = result.rttMs;
+            if (m_engine.m_onResult)
+            {
+                m_callbacks.emplace_back(target.id, result.rttMs);
+            }
+        }
+    }
+    m_results.clear();
+
+    for (const auto& callback : m_callbacks)
+    {
+        m_engine.m_onResult(callback.first, callback.second);
+    }
+}
+
+void ProbeEngine::Worker::BuildPacket(const Probe& probe, EchoPacket& packet) const
+{
+    packet.type = ECHO_REQUEST_TYPE;
+    packet.code = 0;
+    packet.checksum = 0;
+    packet.identifier = htons(m_identifier);
+    packet.sequence = htons(probe.sequence);
+    packet.payload.cookie = m_cookie;
+    packet.payload.slot = static_cast<uint32_t>(probe.slot);
+    packet.payload.generation = probe.generation;
+    packet.payload.sequence = probe.sequence;
+    packet.checksum = InternetChecksum(&packet, sizeof(packet));
+}
+
+#ifdef _WIN32
+
+struct ProbeEngine::Worker::PendingEcho
+{
+    Worker* worker;
+    uint16_t sequence;
+    ProbePayload payload;
+    // Room for the reply, its echoed data, an ICMP error and the status block
+    alignas(8) unsigned char reply[sizeof(ICMP_ECHO_REPLY) + sizeof(ProbePayload) + 8 + sizeof(IO_STATUS_BLOCK)];
+};
+
+bool ProbeEngine::Worker::Open()
+{
+    m_icmp = IcmpCreateFile();
+    m_wakeEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    if (m_icmp == INVALID_HANDLE_VALUE || !m_wakeEvent)
+    {
+        NM_LOG_ERROR(L"ProbeEngine: IcmpCreateFile failed: " + GetLastErrorString());
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void ProbeEngine::Worker::Close()
+{
+    if (m_icmp != INVALID_HANDLE_VALUE)
+    {
+        IcmpCloseHandle(m_icmp);
+        m_icmp = INVALID_HANDLE_VALUE;
+    }
+    if (m_wakeEvent)
+    {
+        CloseHandle(m_wakeEvent);
+        m_wakeEvent = nullptr;
+    }
+}
+
+void ProbeEngine::Worker::Wake()
+{
+    if (m_wakeEvent)
+    {
+        SetEvent(m_wakeEvent);
+    }
+}
+
+void NTAPI ProbeEngine::Worker::OnEchoComplete(PVOID context, PIO_STATUS_BLOCK, ULONG)
+{
+    std::unique_ptr<PendingEcho> pending(static_cast<PendingEcho*>(context));
+    Worker& worker = *pending->worker;
+    --worker.m_pending;
+
+    Clock::time_point received = Clock::now();
+    if (IcmpParseReplies(pending->reply, sizeof(pending->reply)) == 0)
+    {
+        // Timed out or unreachable; the timer wheel counts it lost
+        return;
+    }
+
+    const ICMP_ECHO_REPLY* reply = reinterpret_cast<const ICMP_ECHO_REPLY*>(pending->reply);
+    if (reply->Status == IP_SUCCESS && reply->Data && reply->DataSize >= sizeof(ProbePayload))
+    {
+        ProbePayload payload;
+        std::memcpy(&payload, reply->Data, sizeof(payload));
+        worker.OnReply(pending->sequence, reply->Address, payload, received);
+    }
+}
+
+void ProbeEngine::Worker::SendProbes()
+{
+    // IcmpSendEcho2 takes one request per call; the completions arrive
+    // together when this thread next waits
+    for (const Probe& probe : m_due)
+    {
+        std::unique_ptr<PendingEcho> pending(new PendingEcho());
+        pending->worker = this;
+        pending->sequence = probe.sequence;
+        pending->payload.cookie = m_cookie;
+        pending->payload.slot = static_cast<uint32_t>(probe.slot);
+        pending->payload.generation = probe.generation;
+        pending->payload.sequence = probe.sequence;
+
+        DWORD result = IcmpSendEcho2(m_icmp, nullptr, OnEchoComplete, pending.get(), probe.address,
+                                     &pending->payload, static_cast<WORD>(sizeof(pending->payload)), nullptr,
+                                     pending->reply, static_cast<DWORD>(sizeof(pending->reply)), probe.timeoutMs);
+        if (result == 0 && GetLastError() != ERROR_IO_PENDING)
+        {
+            FailProbe(probe);
+            continue;
+        }
+        // Completes through OnEchoComplete, which frees it
+        pending.release();
+        ++m_pending;
+    }
+    m_due.clear();
+}
+
+void ProbeEngine::Worker::WaitForReplies(int timeoutMs)
+{
+    // Alertable, so echo completions run here
+    WaitForSingleObjectEx(m_wakeEvent, timeoutMs < 0 ? INFINITE : static_cast<DWORD>(timeoutMs), TRUE);
+}
+
+#elif defined(__linux__)
+
+bool ProbeEngine::Worker::Open()
+{
+    // Unprivileged ICMP; the kernel sets the identifier and hands this
+    // socket only its own replies
+    m_socket = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_ICMP);
+    if (m_socket < 0 && (errno == EACCES || errno == EPERM || errno == EPROTONOSUPPORT))
+    {
+        m_socket = socket(AF_INET, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_ICMP);
+        m_rawSocket = (m_socket >= 0);
+        if (m_rawSocket)
+        {
+            // Leave every ICMP type but echo replies in the kernel
+            icmp_filter filter = {};
+            filter.data = ~(1U << ECHO_REPLY_TYPE);
+            setsockopt(m_socket, SOL_RAW, ICMP_FILTER, &filter, sizeof(filter));
+        }
+    }
+    if (m_socket < 0)
+    {
+        NM_LOG_ERROR(L"ProbeEngine: cannot open an ICMP socket: errno " + std::to_wstring(errno));
+        return false;
+    }
+
+    // Replies to a burst of probes arrive together
+    int receiveBuffer = 1 << 20;
+    setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event socketEvent = {};
+    socketEvent.events = EPOLLIN;
+    socketEvent.data.fd = m_socket;
+    epoll_event wakeEvent = {};
+    wakeEvent.events = EPOLLIN;
+    wakeEvent.data.fd = m_wakeFd;
+    if (m_wakeFd < 0 || m_epoll < 0 || epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_socket, &socketEvent) != 0 ||
+        epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeFd, &wakeEvent) != 0)
+    {
+        NM_LOG_ERROR(L"ProbeEngine: cannot set up epoll: errno " + std::to_wstring(errno));
+        Close();
+        return false;
+    }
+
+    for (size_t i = 0; i < BATCH_SIZE; ++i)
+    {
+        m_sendVectors[i].iov_base = &m_sendPackets[i];
+        m_sendVectors[i].iov_len = sizeof(EchoPacket);
+        m_receiveVectors[i].iov_base = m_receiveBuffers[i];
+        m_receiveVectors[i].iov_len = sizeof(m_receiveBuffers[i]);
+    }
+    return true;
+}
+
+void ProbeEngine::Worker::Close()
+{
+    for (int* fd : { &m_socket, &m_epoll, &m_wakeFd })
+    {
+        if (*fd >= 0)
+        {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+void ProbeEngine::Worker::Wake()
+{
+    if (m_wakeFd >= 0)
+    {
+        uint64_t one = 1;
+        while (write(m_wakeFd, &one, sizeof(one)) < 0 && errno == EINTR)
+        {
+        }
+    }
+}
+
+void ProbeEngine::Worker::SendProbes()
+{
+    for (size_t start = 0; start < m_due.size(); start += BATCH_SIZE)
+    {
+        size_t count = (std::min)(BATCH_SIZE, m_due.size() - start);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Probe& probe = m_due[start + i];
+            BuildPacket(probe, m_sendPackets[i]);
+            m_sendAddresses[i] = sockaddr_in();
+            m_sendAddresses[i].sin_family = AF_INET;
+            m_sendAddresses[i].sin_addr.s_addr = probe.address;
+            m_sendMessages[i] = mmsghdr();
+            m_sendMessages[i].msg_hdr.msg_name = &m_sendAddresses[i];
+            m_sendMessages[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            m_sendMessages[i].msg_hdr.msg_iov = &m_sendVectors[i];
+            m_sendMessages[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        size_t done = 0;
+        while (done < count)
+        {
+            int sent = sendmmsg(m_socket, m_sendMessages + done, static_cast<unsigned int>(count - done), 0);
+            if (sent > 0)
+            {
+                done += static_cast<size_t>(sent);
+                continue;
+            }
+            if (sent < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            // This one cannot go out (no route, buffer full); the rest still try
+            FailProbe(m_due[start + done]);
+            ++done;
+        }
+    }
+    m_due.clear();
+}
+
+void ProbeEngine::Worker::WaitForReplies(int timeoutMs)
+{
+    epoll_event events[2];
+    int ready = epoll_wait(m_epoll, events, 2, timeoutMs);
+    for (int i = 0; i < ready; ++i)
+    {
+        if (events[i].data.fd == m_wakeFd)
+        {
+            uint64_t count = 0;
+            while (read(m_wakeFd, &count, sizeof(count)) < 0 && errno == EINTR)
+            {
+            }
+        }
+        else
+        {
+            ReceiveReplies();
+        }
+    }
+}
+
+void ProbeEngine::Worker::ReceiveReplies()
+{
+    for (;;)
+    {
+        for (size_t i = 0; i < BATCH_SIZE; ++i)
+        {
+            m_receiveMessages[i] = mmsghdr();
+            m_receiveMessages[i].msg_hdr.msg_name = &m_receiveAddresses[i];
+            m_receiveMessages[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            m_receiveMessages[i].msg_hdr.msg_iov = &m_receiveVectors[i];
+            m_receiveMessages[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int received = recvmmsg(m_socket, m_receiveMessages, BATCH_SIZE, MSG_DONTWAIT, nullptr);
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (received <= 0)
+        {
+            return;
+        }
+
+        Clock::time_point now = Clock::now();
+        for (int i = 0; i < received; ++i)
+        {
+            const uint8_t* data = m_receiveBuffers[i];
+            size_t length = m_receiveMessages[i].msg_len;
+            if (m_rawSocket)
+            {
+                size_t headerLength = (length > 0) ? static_cast<size_t>(data[0] & 0x0F) * 4 : 0;
+                if (headerLength < 20 || headerLength > length)
+                {
+                    continue;
+                }
+                data += headerLength;
+                length -= headerLength;
+            }
+            if (length < sizeof(EchoPacket))
+            {
+                continue;
+            }
+
+            EchoPacket packet;
+            std::memcpy(&packet, data, sizeof(packet));
+            // The kernel picks the identifier of a datagram socket's probes
+            if (packet.type != ECHO_REPLY_TYPE || (m_rawSocket && ntohs(packet.identifier) != m_identifier))
+            {
+                continue;
+            }
+            OnReply(ntohs(packet.sequence), m_receiveAddresses[i].sin_addr.s_addr, packet.payload, now);
+        }
+
+        if (static_cast<size_t>(received) < BATCH_SIZE)
+        {
+            return;
+        }
+    }
+}
+
+#else
+
+bool ProbeEngine::Worker::Open()
+{
+    NM_LOG_ERROR(L"ProbeEngine: not supported on this system");
+    return false;
+}
+
+void ProbeEngine::Worker::Close()
+{
+}
+
+void ProbeEngine::Worker::Wake()
+{
+}
+
+void ProbeEngine::Worker::SendProbes()
+{
+    m_due.clear();
+}
+
+void ProbeEngine::Worker::WaitForReplies(int)
+{
+}
+
+#endif
+
+// ============================================================================
+// PROBE ENGINE
+// ============================================================================
+
+ProbeEngine::ProbeEngine()
+    : m_nextTargetId(1)
+    , m_addedCount(0)
+    , m_running(false)
+{
+}
+
+ProbeEngine::~ProbeEngine()
+{
+    Stop();
+}
+
+bool ProbeEngine::Start(ResultCallback onResult)
+{
+    if (IsRunning())
+    {
+        return true;
+    }
+
+    std::unique_ptr<Worker> worker(new Worker(*this));
+    if (!worker->Open())
+    {
+        return false;
+    }
+
+    m_onResult = std::move(onResult);
+    Worker* running = worker.get();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_worker = std::move(worker);
+    }
+    m_running.store(true, std::memory_order_release);
+    m_thread = std::thread([running]() { running->Run(); });
+    return true;
+}
+
+void ProbeEngine::Stop()
+{
+    std::unique_ptr<Worker> worker;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        worker = std::move(m_worker);
+    }
+    if (!worker)
+    {
+        return;
+    }
+
+    worker->RequestStop();
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+    worker.reset();
+    m_running.store(false, std::memory_order_release);
+
+    // A later Start probes the same targets again
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_added.clear();
+    for (size_t slot = 0; slot < m_targets.size(); ++slot)
+    {
+        if (m_targets[slot].id != 0)
+        {
+            m_added.push_back(slot);
+        }
+    }
+}
+
+unsigned int ProbeEngine::AddTarget(uint32_t address, unsigned int intervalMs, unsigned int timeoutMs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    size_t slot = m_targets.size();
+    if (!m_freeSlots.empty())
+    {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+    else
+    {
+        m_targets.push_back(Target());
+        m_targets[slot].generation = 0;
+    }
+
+    Target& target = m_targets[slot];
+    target.id = m_nextTargetId++;
+    if (m_nextTargetId == 0)
+    {
+        m_nextTargetId = 1;
+    }
+    target.address = address;
+    target.intervalMs = (std::max)(intervalMs, MIN_PROBE_INTERVAL_MS);
+    target.timeoutMs = (std::max)(timeoutMs, WHEEL_TICK_MS);
+    target.stats = ProbeStats();
+
+    // Golden-ratio offsets spread the first probes of a batch of targets
+    // evenly over the interval
+    double phase = std::fmod(static_cast<double>(m_addedCount++) * 0.6180339887498949, 1.0);
+    target.firstDelayMs = static_cast<unsigned int>(phase * target.intervalMs);
+
+    m_slotById[target.id] = slot;
+    m_added.push_back(slot);
+    if (m_worker)
+    {
+        m_worker->Wake();
+    }
+    return target.id;
+}
+
+void ProbeEngine::RemoveTarget(unsigned int targetId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_slotById.find(targetId);
+    if (found == m_slotById.end())
+    {
+        return;
+    }
+
+    size_t slot = found->second;
+    m_slotById.erase(found);
+    m_targets[slot].id = 0;
+    ++m_targets[slot].generation;    // Its timers and replies in flight are dropped
+    m_added.erase(std::remove(m_added.begin(), m_added.end(), slot), m_added.end());
+    m_freeSlots.push_back(slot);
+}
+
+bool ProbeEngine::SetTargetInterval(unsigned int targetId, unsigned int intervalMs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_slotById.find(targetId);
+    if (found == m_slotById.end())
+    {
+        return false;
+    }
+    // Takes effect from the probe after the next one
+    m_targets[found->second].intervalMs = (std::max)(intervalMs, MIN_PROBE_INTERVAL_MS);
+    return true;
+}
+
+bool ProbeEngine::GetStats(unsigned int targetId, ProbeStats& stats) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_slotById.find(targetId);
+    if (found == m_slotById.end())
+    {
+        return false;
+    }
+    stats = m_targets[found->second].stats;
+    return true;
+}
+
+size_t ProbeEngine::GetTargetCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_slotById.size();
+}
+
+} // namespace NetworkMonitor
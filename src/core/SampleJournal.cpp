@@ -0,0 +1,319 @@
+// ============================================================================
+// File: SampleJournal.cpp
+// Description: Memory-mapped ring journal protecting queued history samples
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#include "NetworkMonitor/SampleJournal.h"
+#include "NetworkMonitor/Utils.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+
+namespace NetworkMonitor
+{
+
+namespace
+{
+    constexpr char JOURNAL_MAGIC[4] = { 'N', 'M', 'J', 'R' };
+    constexpr unsigned int JOURNAL_VERSION = 1;
+
+    unsigned int Crc32(const void* data, size_t length, unsigned int crc = 0)
+    {
+        static const std::array<unsigned int, 256> table = []() {
+            std::array<unsigned int, 256> t = {};
+            for (unsigned int i = 0; i < 256; ++i)
+            {
+                unsigned int c = i;
+                for (int k = 0; k < 8; ++k)
+                {
+                    c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+                }
+                t[i] = c;
+            }
+            return t;
+        }();
+
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        crc = ~crc;
+        for (size_t i = 0; i < length; ++i)
+        {
+            crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+}
+
+// On-disk layout: one header block followed by slotCount records. The
+// header occupies a full record-sized block so records stay aligned.
+struct SampleJournal::Header
+{
+    char magic[4];
+    unsigned int version;
+    unsigned int slotCount;
+    unsigned int recordSize;
+    unsigned long long committedSeq;
+};
+
+struct SampleJournal::Record
+{
+    unsigned long long seq;
+    long long timestamp;
+    unsigned long long bytesDown;
+    unsigned long long bytesUp;
+    unsigned int nameLength;
+    unsigned int checksum;
+    wchar_t name[MAX_NAME_LENGTH];
+};
+
+namespace
+{
+    // The checksum covers the fixed fields and the used part of the name,
+    // so a record torn by power loss mid-write fails validation.
+    template <typename RecordT>
+    unsigned int RecordChecksum(const RecordT& record)
+    {
+        unsigned int crc = Crc32(&record, offsetof(RecordT, checksum));
+        return Crc32(record.name, record.nameLength * sizeof(wchar_t), crc);
+    }
+}
+
+SampleJournal::SampleJournal()
+    : m_file(INVALID_HANDLE_VALUE)
+    , m_mapping(nullptr)
+    , m_view(nullptr)
+    , m_viewSize(0)
+    , m_slotCount(0)
+    , m_nextSeq(1)
+    , m_committedSeq(0)
+{
+}
+
+SampleJournal::~SampleJournal()
+{
+    Close();
+}
+
+bool SampleJournal::Open(const std::wstring& path, unsigned int slotCount)
+{
+    Close();
+
+    if (slotCount == 0)
+    {
+        return false;
+    }
+
+    m_file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                         OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        NM_LOG_ERROR(L"SampleJournal::Open: CreateFileW failed for " + path + L": " + GetLastErrorString());
+        return false;
+    }
+
+    // Keep the geometry of an existing journal so its records stay readable
+    Header existing = {};
+    DWORD read = 0;
+    if (ReadFile(m_file, &existing, sizeof(existing), &read, nullptr) && read == sizeof(existing) &&
+        std::memcmp(existing.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) == 0 &&
+        existing.version == JOURNAL_VERSION && existing.recordSize == sizeof(Record) &&
+        existing.slotCount > 0)
+    {
+        slotCount = existing.slotCount;
+    }
+    else
+    {
+        existing = Header();
+    }
+
+    unsigned long long size = static_cast<unsigned long long>(slotCount + 1) * sizeof(Record);
+    m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READWRITE,
+                                   static_cast<DWORD>(size >> 32),
+                                   static_cast<DWORD>(size & 0xFFFFFFFFULL), nullptr);
+    if (!m_mapping)
+    {
+        NM_LOG_ERROR(L"SampleJournal::Open: CreateFileMappingW failed: " + GetLastErrorString());
+        Close();
+        return false;
+    }
+
+    m_view = MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, static_cast<SIZE_T>(size));
+    if (!m_view)
+    {
+        NM_LOG_ERROR(L"SampleJournal::Open: MapViewOfFile failed: " + GetLastErrorString());
+        Close();
+        return false;
+    }
+
+    m_viewSize = static_cast<size_t>(size);
+    m_slotCount = slotCount;
+
+    Header* header = GetHeader();
+    if (existing.slotCount == 0)
+    {
+        // New or unrecognized file: start an empty ring
+        std::memset(m_view, 0, m_viewSize);
+        std::memcpy(header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        header->version = JOURNAL_VERSION;
+        header->slotCount = slotCount;
+        header->recordSize = sizeof(Record);
+        header->committedSeq = 0;
+        FlushViewOfFile(m_view, m_viewSize);
+    }
+
+    m_committedSeq = header->committedSeq;
+    m_nextSeq = m_committedSeq + 1;
+    return true;
+}
+
+void SampleJournal::Close()
+{
+    if (m_view)
+    {
+        FlushViewOfFile(m_view, m_viewSize);
+        UnmapViewOfFile(m_view);
+        m_view = nullptr;
+    }
+
+    if (m_mapping)
+    {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+
+    if (m_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+
+    m_viewSize = 0;
+    m_slotCount = 0;
+}
+
+void SampleJournal::ReadPending(unsigned long long storedSeq, std::vector<JournalSample>& out)
+{
+    out.clear();
+    if (!m_view)
+    {
+        return;
+    }
+
+    unsigned long long base = (std::max)(GetHeader()->committedSeq, storedSeq);
+    unsigned long long highest = base;
+
+    for (unsigned int slot = 0; slot < m_slotCount; ++slot)
+    {
+        const Record* record = GetSlot(slot);
+        if (record->seq == 0 || record->seq % m_slotCount != slot ||
+            record->nameLength > MAX_NAME_LENGTH || record->checksum != RecordChecksum(*record))
+        {
+            continue;
+        }
+
+        highest = (std::max)(highest, record->seq);
+        if (record->seq <= base)
+        {
+            continue;
+        }
+
+        JournalSample sample;
+        sample.seq = record->seq;
+        sample.timestamp = static_cast<std::time_t>(record->timestamp);
+        sample.interfaceName.assign(record->name, record->nameLength);
+        sample.bytesDown = record->bytesDown;
+        sample.bytesUp = record->bytesUp;
+        out.push_back(std::move(sample));
+    }
+
+    std::sort(out.begin(), out.end(), [](const JournalSample& a, const JournalSample& b) {
+        return a.seq < b.seq;
+    });
+
+    m_committedSeq = base;
+    m_nextSeq = highest + 1;
+}
+
+unsigned long long SampleJournal::Append(std::time_t timestamp,
+                                         const std::wstring& interfaceName,
+                                         unsigned long long bytesDown,
+                                         unsigned long long bytesUp)
+{
+    if (!m_view || IsFull() || interfaceName.size() > MAX_NAME_LENGTH)
+    {
+        return 0;
+    }
+
+    unsigned long long seq = m_nextSeq++;
+    Record* record = GetSlot(seq);
+
+    record->seq = seq;
+    record->timestamp = static_cast<long long>(timestamp);
+    record->bytesDown = bytesDown;
+    record->bytesUp = bytesUp;
+    record->nameLength = static_cast<unsigned int>(interfaceName.size());
+    std::memcpy(record->name, interfaceName.data(), interfaceName.size() * sizeof(wchar_t));
+    record->checksum = RecordChecksum(*record);
+    return seq;
+}
+
+void SampleJournal::WriteBack(unsigned long long firstSeq, unsigned long long lastSeq)
+{
+    if (!m_view || firstSeq == 0 || lastSeq < firstSeq)
+    {
+        return;
+    }
+
+    // Hand the pages to the OS for write-back; no FlushFileBuffers, which
+    // would cost as much as the per-sample commit the journal replaces.
+    // A range that wraps around the ring takes two calls.
+    Record* records = static_cast<Record*>(m_view) + 1;
+    if (lastSeq - firstSeq + 1 >= m_slotCount)
+    {
+        FlushViewOfFile(records, sizeof(Record) * m_slotCount);
+        return;
+    }
+
+    Record* first = GetSlot(firstSeq);
+    Record* last = GetSlot(lastSeq);
+    if (first <= last)
+    {
+        FlushViewOfFile(first, sizeof(Record) * static_cast<size_t>(last - first + 1));
+    }
+    else
+    {
+        FlushViewOfFile(first, sizeof(Record) * static_cast<size_t>(records + m_slotCount - first));
+        FlushViewOfFile(records, sizeof(Record) * static_cast<size_t>(last - records + 1));
+    }
+}
+
+bool SampleJournal::IsFull() const
+{
+    return m_view && (m_nextSeq - 1 - m_committedSeq) >= m_slotCount;
+}
+
+void SampleJournal::MarkCommitted(unsigned long long seq)
+{
+    if (!m_view || seq <= m_committedSeq)
+    {
+        return;
+    }
+
+    m_committedSeq = seq;
+    GetHeader()->committedSeq = seq;
+}
+
+SampleJournal::Header* SampleJournal::GetHeader() const
+{
+    return static_cast<Header*>(m_view);
+}
+
+SampleJournal::Record* SampleJournal::GetSlot(unsigned long long seq) const
+{
+    Record* records = static_cast<Record*>(m_view) + 1;
+    return records + (seq % m_slotCount);
+}
+
+} // namespace NetworkMonitor
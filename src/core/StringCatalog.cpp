@@ -0,0 +1,320 @@
+// ============================================================================
+// File: StringCatalog.cpp
+// Description: Localized strings loaded once into one arena, looked up by ID
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#include "NetworkMonitor/StringCatalog.h"
+#include "NetworkMonitor/Utf8Text.h"
+#ifdef _WIN32
+#include "NetworkMonitor/Utils.h"
+#endif
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+
+namespace NetworkMonitor
+{
+
+namespace
+{
+    // String resource IDs are 16-bit; the index spans the IDs in use
+    constexpr unsigned int MAX_STRING_ID = 0xFFFF;
+
+    // Text of a catalog line after the '=', escapes resolved
+    void DecodeCatalogText(std::string_view text, std::wstring& out)
+    {
+        out.clear();
+        size_t pos = 0;
+        while (pos < text.size())
+        {
+            if (text[pos] == '\\' && pos + 1 < text.size())
+            {
+                char escaped = text[pos + 1];
+                if (escaped == 'n' || escaped == 't' || escaped == '\\')
+                {
+                    out.push_back(escaped == 'n' ? L'\n' : escaped == 't' ? L'\t' : L'\\');
+                    pos += 2;
+                    continue;
+                }
+            }
+            // Up to the next escape; an unknown one is kept as text
+            size_t next = text.find('\\', pos + 1);
+            if (next == std::string_view::npos)
+            {
+                next = text.size();
+            }
+            AppendUtf8AsWide(out, text.substr(pos, next - pos));
+            pos = next;
+        }
+    }
+
+    bool ParseStringId(std::string_view text, unsigned int& id)
+    {
+        if (text.empty() || text.size() > 5)
+        {
+            return false;
+        }
+        id = 0;
+        for (char c : text)
+        {
+            if (c < '0' || c > '9')
+            {
+                return false;
+            }
+            id = id * 10 + static_cast<unsigned int>(c - '0');
+        }
+        return id <= MAX_STRING_ID;
+    }
+}
+
+StringCatalog::StringCatalog()
+    : m_firstId(0)
+    , m_count(0)
+    , m_language(0)
+{
+}
+
+void StringCatalog::ResetArena()
+{
+    // Offset 0 is the empty string IDs without text point at
+    m_arena.assign(1, L'\0');
+}
+
+void StringCatalog::Add(std::vector<Pending>& pending, unsigned int id, const wchar_t* text, size_t length)
+{
+    Pending added = {};
+    added.id = id;
+    added.entry.offset = static_cast<uint32_t>(m_arena.size());
+    added.entry.length = static_cast<uint32_t>(length);
+    m_arena.append(text, length);
+    m_arena.push_back(L'\0');
+    pending.push_back(added);
+}
+
+void StringCatalog::BuildIndex(const std::vector<Pending>& pending)
+{
+    m_index.clear();
+    m_firstId = 0;
+    m_count = 0;
+    if (pending.empty())
+    {
+        return;
+    }
+
+    unsigned int firstId = pending[0].id;
+    unsigned int lastId = pending[0].id;
+    for (const Pending& item : pending)
+    {
+        firstId = (std::min)(firstId, item.id);
+        lastId = (std::max)(lastId, item.id);
+    }
+
+    m_index.assign(static_cast<size_t>(lastId - firstId) + 1, Entry{ 0, 0 });
+    std::vector<bool> present(m_index.size(), false);
+    for (const Pending& item : pending)
+    {
+        size_t slot = item.id - firstId;
+        m_index[slot] = item.entry;
+        if (!present[slot])
+        {
+            present[slot] = true;
+            ++m_count;
+        }
+    }
+    m_firstId = firstId;
+}
+
+#ifdef _WIN32
+namespace
+{
+    BOOL CALLBACK CollectStringBlock(HMODULE, LPCWSTR, LPWSTR name, LONG_PTR param)
+    {
+        if (IS_INTRESOURCE(name))
+        {
+            reinterpret_cast<std::vector<unsigned int>*>(param)->push_back(
+                static_cast<unsigned int>(reinterpret_cast<ULONG_PTR>(name)));
+        }
+        return TRUE;
+    }
+}
+
+bool StringCatalog::LoadFromResources(HINSTANCE instance)
+{
+    // A STRINGTABLE is stored in blocks of 16: IDs (block - 1) * 16 and up
+    std::vector<unsigned int> blocks;
+    if (!instance ||
+        !EnumResourceNamesW(instance, RT_STRING, CollectStringBlock, reinterpret_cast<LONG_PTR>(&blocks)))
+    {
+        return false;
+    }
+
+    ResetArena();
+    std::vector<Pending> pending;
+    for (unsigned int block : blocks)
+    {
+        for (unsigned int i = 0; i < 16; ++i)
+        {
+            unsigned int id = (block - 1) * 16 + i;
+            // With a zero buffer size LoadStringW points into the resource
+            const wchar_t* text = nullptr;
+            int length = LoadStringW(instance, id, reinterpret_cast<LPWSTR>(&text), 0);
+            if (length > 0 && text)
+            {
+                Add(pending, id, text, static_cast<size_t>(length));
+            }
+        }
+    }
+    m_arena.shrink_to_fit();
+    BuildIndex(pending);
+    return true;
+}
+#endif
+
+bool StringCatalog::LoadFromFile(const std::wstring& path)
+{
+    std::ifstream file(std::filesystem::path(path), std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (file.bad())
+    {
+        return false;
+    }
+    return LoadFromText(text);
+}
+
+bool StringCatalog::LoadFromText(std::string_view utf8)
+{
+    if (utf8.size() >= 3 && utf8.substr(0, 3) == "\xEF\xBB\xBF")
+    {
+        utf8.remove_prefix(3);
+    }
+
+    ResetArena();
+    std::vector<Pending> pending;
+    std::wstring decoded;
+    size_t lineStart = 0;
+    while (lineStart < utf8.size())
+    {
+        size_t lineEnd = utf8.find('\n', lineStart);
+        if (lineEnd == std::string_view::npos)
+        {
+            lineEnd = utf8.size();
+        }
+        std::string_view line = utf8.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        size_t equals = line.find('=');
+        unsigned int id = 0;
+        if (equals == std::string_view::npos || !ParseStringId(line.substr(0, equals), id))
+        {
+            ResetArena();
+            BuildIndex(std::vector<Pending>());
+            return false;
+        }
+
+        DecodeCatalogText(line.substr(equals + 1), decoded);
+        Add(pending, id, decoded.data(), decoded.size());
+    }
+
+    m_arena.shrink_to_fit();
+    BuildIndex(pending);
+    return true;
+}
+
+// ============================================================================
+// ACTIVE CATALOG
+// ============================================================================
+
+namespace
+{
+    std::mutex g_catalogMutex;
+    // Every catalog made active, kept so views handed out stay valid
+    std::vector<std::unique_ptr<StringCatalog>> g_catalogs;
+    std::atomic<const StringCatalog*> g_activeCatalog(nullptr);
+
+    // Caller holds g_catalogMutex
+    void ActivateCatalog(std::unique_ptr<StringCatalog> catalog)
+    {
+        g_activeCatalog.store(catalog.get(), std::memory_order_release);
+        g_catalogs.push_back(std::move(catalog));
+    }
+
+#ifdef _WIN32
+    // Caller holds g_catalogMutex
+    bool LoadResourceCatalog(LANGID language)
+    {
+        std::unique_ptr<StringCatalog> catalog(new StringCatalog());
+        if (!catalog->LoadFromResources(GetModuleHandleW(nullptr)))
+        {
+            NM_LOG_ERROR(L"StringCatalog: failed to load string resources: " + GetLastErrorString());
+            return false;
+        }
+        catalog->SetLanguage(language);
+        ActivateCatalog(std::move(catalog));
+        return true;
+    }
+#endif
+}
+
+std::wstring_view LoadStringView(unsigned int resourceId)
+{
+    const StringCatalog* catalog = g_activeCatalog.load(std::memory_order_acquire);
+#ifdef _WIN32
+    if (!catalog)
+    {
+        std::lock_guard<std::mutex> lock(g_catalogMutex);
+        if (!g_activeCatalog.load(std::memory_order_acquire))
+        {
+            LoadResourceCatalog(GetThreadUILanguage());
+        }
+        catalog = g_activeCatalog.load(std::memory_order_acquire);
+    }
+#endif
+    return catalog ? catalog->Get(resourceId) : std::wstring_view();
+}
+
+#ifdef _WIN32
+void ReloadStringCatalog(LANGID language)
+{
+    std::lock_guard<std::mutex> lock(g_catalogMutex);
+    const StringCatalog* active = g_activeCatalog.load(std::memory_order_acquire);
+    if (active && active->GetLanguage() == language)
+    {
+        return;
+    }
+    LoadResourceCatalog(language);
+}
+#endif
+
+bool LoadStringCatalogFile(const std::wstring& path)
+{
+    std::unique_ptr<StringCatalog> catalog(new StringCatalog());
+    if (!catalog->LoadFromFile(path))
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(g_catalogMutex);
+    ActivateCatalog(std::move(catalog));
+    return true;
+}
+
+} // namespace NetworkMonitor
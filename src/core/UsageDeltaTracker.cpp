@@ -0,0 +1,78 @@
+// ============================================================================
+// File: UsageDeltaTracker.cpp
+// Description: Per-interface byte deltas between history logging ticks
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#include "NetworkMonitor/UsageDeltaTracker.h"
+#include <iterator>
+
+namespace NetworkMonitor
+{
+
+UsageDeltaTracker::UsageDeltaTracker()
+    : m_tick(0)
+{
+}
+
+void UsageDeltaTracker::Update(const std::vector<NetworkStats>& stats, std::vector<InterfaceUsage>& out)
+{
+    ++m_tick;
+
+    size_t count = 0;
+    for (const NetworkStats& current : stats)
+    {
+        auto it = m_previous.find(current.interfaceName);
+        if (it == m_previous.end())
+        {
+            it = m_previous.emplace(current.interfaceName, Counters()).first;
+        }
+        Counters& previous = it->second;
+
+        // A new interface only sets its baseline
+        bool seenLastTick = (previous.tick != 0 && previous.tick + 1 == m_tick);
+
+        if (seenLastTick)
+        {
+            // A decrease means the counter was reset: nothing to record
+            unsigned long long down = (current.bytesReceived >= previous.bytesReceived)
+                ? current.bytesReceived - previous.bytesReceived : 0;
+            unsigned long long up = (current.bytesSent >= previous.bytesSent)
+                ? current.bytesSent - previous.bytesSent : 0;
+
+            if (down > 0 || up > 0)
+            {
+                // Overwrite entries left from the previous tick in place
+                if (count == out.size())
+                {
+                    out.emplace_back();
+                }
+                InterfaceUsage& usage = out[count++];
+                usage.interfaceName = current.interfaceName;
+                usage.bytesDown = down;
+                usage.bytesUp = up;
+            }
+        }
+
+        previous.bytesReceived = current.bytesReceived;
+        previous.bytesSent = current.bytesSent;
+        previous.tick = m_tick;
+    }
+    out.resize(count);
+
+    // Drop interfaces that disappeared
+    if (m_previous.size() > stats.size())
+    {
+        for (auto it = m_previous.begin(); it != m_previous.end();)
+        {
+            it = (it->second.tick != m_tick) ? m_previous.erase(it) : std::next(it);
+        }
+    }
+}
+
+void UsageDeltaTracker::Reset()
+{
+    m_previous.clear();
+}
+
+} // namespace NetworkMonitor
@@ -0,0 +1,142 @@
+// ============================================================================
+// File: Utf8Text.cpp
+// Description: UTF-8 and wide text conversion without Win32 calls
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#include "NetworkMonitor/Utf8Text.h"
+
+namespace NetworkMonitor
+{
+
+namespace
+{
+    constexpr char32_t REPLACEMENT_CHARACTER = 0xFFFD;
+
+    // Next code point of UTF-8 text
+    char32_t DecodeUtf8(std::string_view text, size_t& pos)
+    {
+        const unsigned char lead = static_cast<unsigned char>(text[pos++]);
+        if (lead < 0x80)
+        {
+            return lead;
+        }
+
+        size_t extra = 0;
+        char32_t code = 0;
+        char32_t minimum = 0;
+        if ((lead & 0xE0) == 0xC0)
+        {
+            extra = 1;
+            code = lead & 0x1F;
+            minimum = 0x80;
+        }
+        else if ((lead & 0xF0) == 0xE0)
+        {
+            extra = 2;
+            code = lead & 0x0F;
+            minimum = 0x800;
+        }
+        else if ((lead & 0xF8) == 0xF0)
+        {
+            extra = 3;
+            code = lead & 0x07;
+            minimum = 0x10000;
+        }
+        else
+        {
+            return REPLACEMENT_CHARACTER;
+        }
+
+        for (size_t i = 0; i < extra; ++i)
+        {
+            if (pos >= text.size() || (static_cast<unsigned char>(text[pos]) & 0xC0) != 0x80)
+            {
+                return REPLACEMENT_CHARACTER;
+            }
+            code = (code << 6) | (static_cast<unsigned char>(text[pos++]) & 0x3F);
+        }
+
+        if (code < minimum || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF))
+        {
+            return REPLACEMENT_CHARACTER;
+        }
+        return code;
+    }
+
+    // Next code point of wide text
+    char32_t DecodeWide(std::wstring_view text, size_t& pos)
+    {
+        char32_t code = static_cast<char32_t>(text[pos++]);
+        if (sizeof(wchar_t) == 2 && code >= 0xD800 && code <= 0xDBFF)
+        {
+            if (pos < text.size())
+            {
+                char32_t low = static_cast<char32_t>(text[pos]);
+                if (low >= 0xDC00 && low <= 0xDFFF)
+                {
+                    ++pos;
+                    return 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+            }
+            return REPLACEMENT_CHARACTER;
+        }
+        if ((code >= 0xD800 && code <= 0xDFFF) || code > 0x10FFFF)
+        {
+            return REPLACEMENT_CHARACTER;
+        }
+        return code;
+    }
+}
+
+void AppendUtf8AsWide(std::wstring& out, std::string_view utf8)
+{
+    size_t pos = 0;
+    while (pos < utf8.size())
+    {
+        char32_t code = DecodeUtf8(utf8, pos);
+        if (sizeof(wchar_t) == 2 && code >= 0x10000)
+        {
+            code -= 0x10000;
+            out.push_back(static_cast<wchar_t>(0xD800 + (code >> 10)));
+            out.push_back(static_cast<wchar_t>(0xDC00 + (code & 0x3FF)));
+        }
+        else
+        {
+            out.push_back(static_cast<wchar_t>(code));
+        }
+    }
+}
+
+void AppendWideAsUtf8(std::string& out, std::wstring_view text)
+{
+    size_t pos = 0;
+    while (pos < text.size())
+    {
+        char32_t code = DecodeWide(text, pos);
+        if (code < 0x80)
+        {
+            out.push_back(static_cast<char>(code));
+        }
+        else if (code < 0x800)
+        {
+            out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+        else if (code < 0x10000)
+        {
+            out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+        else
+        {
+            out.push_back(static_cast<char>(0xF0 | (code >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+    }
+}
+
+} // namespace NetworkMonitor
@@ -5,17 +5,24 @@
 // ============================================================================
 
 #include "NetworkMonitor/Utils.h"
+#include "NetworkMonitor/DiagnosticLog.h"
+#include "NetworkMonitor/BinaryLog.h"
+#include "NetworkMonitor/LogRotation.h"
+#include "NetworkMonitor/StringCatalog.h"
 #include "NetworkMonitor/ThemeHelper.h"
+#include "NetworkMonitor/Units.h"
+#include "NetworkMonitor/ValueFormat.h"
 #include "../../resources/resource.h"
-#include <sstream>
-#include <iomanip>
+#include <atomic>
 #include <fstream>
+#include <mutex>
+#include <thread>
 #include <shellapi.h>
 
 namespace NetworkMonitor
 {
 
-static bool g_debugLoggingEnabled = false;
+static std::atomic<bool> g_binaryLoggingEnabled(false);
 
 // ============================================================================
 // STRING UTILITIES IMPLEMENTATION
@@ -23,109 +30,16 @@ static bool g_debugLoggingEnabled = false;
 
 std::wstring FormatSpeed(double bytesPerSecond, SpeedUnit unit)
 {
-    constexpr double KB = 1024.0;
-    constexpr double MB = KB * 1024.0;
-
-    double convertedValue = 0.0;
-    std::wstring unitStr;
-
-    switch (unit)
-    {
-    case SpeedUnit::BytesPerSecond:
-    {
-        convertedValue = bytesPerSecond;
-        unitStr = L"B/s";
-        if (convertedValue >= KB)
-        {
-            convertedValue /= KB;
-            unitStr = L"KB/s";
-        }
-        if (convertedValue >= KB)
-        {
-            convertedValue /= KB;
-            unitStr = L"MB/s";
-        }
-        if (convertedValue >= KB)
-        {
-            convertedValue /= KB;
-            unitStr = L"GB/s";
-        }
-        break;
-    }
-
-    case SpeedUnit::KiloBytesPerSecond:
-    {
-        convertedValue = bytesPerSecond / KB;
-        unitStr = L"KB/s";
-        if (convertedValue >= KB)
-        {
-            convertedValue /= KB;
-            unitStr = L"MB/s";
-        }
-        if (convertedValue >= KB)
-        {
-            convertedValue /= KB;
-            unitStr = L"GB/s";
-        }
-        break;
-    }
-
-    case SpeedUnit::MegaBytesPerSecond:
-    {
-        convertedValue = bytesPerSecond / MB;
-        unitStr = L"MB/s";
-        if (convertedValue >= KB)
-        {
-            convertedValue /= KB;
-            unitStr = L"GB/s";
-        }
-        break;
-    }
-
-    case SpeedUnit::MegaBitsPerSecond:
-    default:
-        convertedValue = (bytesPerSecond * 8.0) / 1000000.0; // decimal Mbps
-        unitStr = L"Mbps";
-        break;
-    }
-
-    std::wostringstream oss;
-    oss << std::fixed << std::setprecision(2) << convertedValue << L" " << unitStr;
-    return oss.str();
+    wchar_t text[MAX_FORMATTED_VALUE_CHARS];
+    size_t length = FormatSpeedTo(bytesPerSecond, unit, text, MAX_FORMATTED_VALUE_CHARS);
+    return std::wstring(text, length);
 }
 
 std::wstring FormatBytes(ULONG64 bytes)
 {
-    const double KB = 1024.0;
-    const double MB = KB * 1024.0;
-    const double GB = MB * 1024.0;
-    const double TB = GB * 1024.0;
-
-    std::wostringstream oss;
-    oss << std::fixed << std::setprecision(2);
-
-    if (bytes >= TB)
-    {
-        oss << (bytes / TB) << L" TB";
-    }
-    else if (bytes >= GB)
-    {
-        oss << (bytes / GB) << L" GB";
-    }
-    else if (bytes >= MB)
-    {
-        oss << (bytes / MB) << L" MB";
-    }
-    else if (bytes >= KB)
-    {
-        oss << (bytes / KB) << L" KB";
-    }
-    else
-    {
-        oss << bytes << L" B";
-    }
-
-    return oss.str();
+    wchar_t text[MAX_FORMATTED_VALUE_CHARS];
+    size_t length = FormatBytesTo(bytes, text, MAX_FORMATTED_VALUE_CHARS);
+    return std::wstring(text, length);
 }
 
 std::wstring SpeedUnitToString(SpeedUnit unit)
@@ -147,21 +61,7 @@ std::wstring SpeedUnitToString(SpeedUnit unit)
 
 std::wstring LoadStringResource(UINT resourceId)
 {
-    wchar_t buffer[256] = {};
-
-    HINSTANCE hInstance = GetModuleHandleW(nullptr);
-    int length = 0;
-    if (hInstance)
-    {
-        length = LoadStringW(hInstance, resourceId, buffer, static_cast<int>(sizeof(buffer) / sizeof(wchar_t)));
-    }
-
-    if (length <= 0)
-    {
-        return std::wstring();
-    }
-
-    return std::wstring(buffer, length);
+    return std::wstring(LoadStringView(resourceId));
 }
 
 // ============================================================================
@@ -170,23 +70,10 @@ std::wstring LoadStringResource(UINT resourceId)
 
 double ConvertSpeed(double bytesPerSecond, SpeedUnit unit)
 {
-    switch (unit)
-    {
-    case SpeedUnit::BytesPerSecond:
-        return bytesPerSecond;
-
-    case SpeedUnit::KiloBytesPerSecond:
-        return bytesPerSecond / 1024.0;
-
-    case SpeedUnit::MegaBytesPerSecond:
-        return bytesPerSecond / (1024.0 * 1024.0);
-
-    case SpeedUnit::MegaBitsPerSecond:
-        return (bytesPerSecond * 8.0) / (1000.0 * 1000.0); // 1 Mbps = 1,000,000 bits
-
-    default:
-        return bytesPerSecond / 1024.0; // Default to KB/s
-    }
+    const DataRate<Bytes> rate(bytesPerSecond);
+    return VisitSpeedUnit(unit, [&rate](auto target) {
+        return UnitCast<decltype(target)>(rate).Count();
+    });
 }
 
 // ============================================================================
@@ -376,14 +263,14 @@ int ShowDarkMessageBox(HWND owner,
 
 void ShowErrorMessage(const std::wstring& message, const std::wstring& title)
 {
-    LogError(title + L": " + message);
+    NM_LOG_ERROR(title + L": " + message);
     bool dark = ThemeHelper::IsSystemInDarkMode();
     ShowDarkMessageBox(nullptr, message, title, MB_OK | MB_ICONERROR, dark);
 }
 
 namespace
 {
-    std::wstring GetLogFilePath()
+    std::wstring GetLogFilePath(const wchar_t* fileName = L"NetworkMonitor.log")
     {
         wchar_t buffer[MAX_PATH] = {0};
         DWORD length = GetEnvironmentVariableW(L"LOCALAPPDATA", buffer, static_cast<DWORD>(MAX_PATH));
@@ -401,10 +288,144 @@ namespace
         std::wstring dirPath = basePath + L"\\NetworkMonitor";
         CreateDirectoryW(dirPath.c_str(), nullptr);
 
-        std::wstring filePath = dirPath + L"\\NetworkMonitor.log";
+        std::wstring filePath = dirPath + L"\\" + fileName;
         return filePath;
     }
 
+    // Rotation settings for logs opened after SetLogRotation
+    std::mutex g_logRotationMutex;
+    LogRotationOptions g_logRotation;
+
+    LogRotationOptions GetLogRotation()
+    {
+        std::lock_guard<std::mutex> lock(g_logRotationMutex);
+        return g_logRotation;
+    }
+
+    // A process-wide log that its static destructor tears down while other
+    // threads (workers of other statics) may still be logging. Callers
+    // enter before touching the log; closing waits for those already in,
+    // and anyone arriving later is turned away. Constant-initialized, so it
+    // is usable before and after the log's own lifetime.
+    class LogTeardownGuard
+    {
+    public:
+        constexpr LogTeardownGuard()
+            : m_closed(false)
+            , m_users(0)
+        {
+        }
+
+        bool Enter()
+        {
+            m_users.fetch_add(1);
+            if (m_closed.load())
+            {
+                m_users.fetch_sub(1);
+                return false;
+            }
+            return true;
+        }
+
+        void Leave()
+        {
+            m_users.fetch_sub(1);
+        }
+
+        void Close()
+        {
+            m_closed.store(true);
+            while (m_users.load() != 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+
+    private:
+        std::atomic<bool> m_closed;
+        std::atomic<int> m_users;
+    };
+
+    // Anything logged once the process log is closed goes straight to the file
+    LogTeardownGuard g_processLogGuard;
+
+    struct ProcessLog
+    {
+        DiagnosticLog log;
+
+        static DiagnosticLogOptions Options()
+        {
+            DiagnosticLogOptions options;
+            options.path = GetLogFilePath();
+            options.rotation = GetLogRotation();
+            return options;
+        }
+
+        ProcessLog()
+            : log(Options())
+        {
+        }
+
+        // Runs before log is destroyed
+        ~ProcessLog()
+        {
+            g_processLogGuard.Close();
+        }
+    };
+
+    DiagnosticLog& GetProcessLog()
+    {
+        static ProcessLog instance;
+        return instance.log;
+    }
+
+    // False once the process log is closed
+    bool PushToProcessLog(LogLevel level, const std::wstring& message)
+    {
+        if (!g_processLogGuard.Enter())
+        {
+            return false;
+        }
+        GetProcessLog().Push(level, message);
+        g_processLogGuard.Leave();
+        return true;
+    }
+
+    LogTeardownGuard g_binaryLogGuard;
+
+    struct ProcessBinaryLog
+    {
+        BinaryLog log;
+
+        static BinaryLogOptions Options()
+        {
+            BinaryLogOptions options;
+            options.path = GetLogFilePath(L"NetworkMonitor.binlog");
+            options.rotation = GetLogRotation();
+            return options;
+        }
+
+        ProcessBinaryLog()
+            : log(Options())
+        {
+        }
+
+        ~ProcessBinaryLog()
+        {
+            g_binaryLogGuard.Close();
+        }
+    };
+
+    BinaryLog& GetProcessBinaryLog()
+    {
+        static ProcessBinaryLog instance;
+        return instance.log;
+    }
+
+    // Whole lines logged without a format
+    constexpr LogFormat PLAIN_MESSAGE_FORMAT(L"{}");
+
+    // Synchronous fallback for the last lines of a shutting-down process
     void AppendLogLine(const wchar_t* level, const std::wstring& message)
     {
         if (!level)
@@ -439,16 +460,28 @@ namespace
 
 void LogDebug(const std::wstring& message)
 {
-    if (!g_debugLoggingEnabled)
+    if (!g_debugLoggingEnabled.load(std::memory_order_relaxed))
     {
         return;
     }
 
+    const LogArgument arguments[2] = { MakeLogArgument(message), LogArgument() };
+    if (WriteBinaryLogRecord(LogLevel::Debug, PLAIN_MESSAGE_FORMAT, arguments, 1) ||
+        PushToProcessLog(LogLevel::Debug, message))
+    {
+        return;
+    }
     AppendLogLine(L"DEBUG", message);
 }
 
 void LogError(const std::wstring& message)
 {
+    const LogArgument arguments[2] = { MakeLogArgument(message), LogArgument() };
+    if (WriteBinaryLogRecord(LogLevel::Error, PLAIN_MESSAGE_FORMAT, arguments, 1) ||
+        PushToProcessLog(LogLevel::Error, message))
+    {
+        return;
+    }
     AppendLogLine(L"ERROR", message);
 }
 
@@ -457,6 +490,41 @@ void SetDebugLoggingEnabled(bool enabled)
     g_debugLoggingEnabled = enabled;
 }
 
+void SetBinaryLoggingEnabled(bool enabled)
+{
+    g_binaryLoggingEnabled = enabled;
+}
+
+bool WriteBinaryLogRecord(LogLevel level, const LogFormat& format, const LogArgument* args, size_t count)
+{
+    if (!g_binaryLoggingEnabled.load(std::memory_order_relaxed) || !g_binaryLogGuard.Enter())
+    {
+        return false;
+    }
+    GetProcessBinaryLog().WriteRecord(level, format, args, count);
+    g_binaryLogGuard.Leave();
+    return true;
+}
+
+void SetLogRotation(const LogRotationOptions& options)
+{
+    {
+        std::lock_guard<std::mutex> lock(g_logRotationMutex);
+        g_logRotation = options;
+    }
+
+    if (g_processLogGuard.Enter())
+    {
+        GetProcessLog().SetRotation(options);
+        g_processLogGuard.Leave();
+    }
+    if (g_binaryLoggingEnabled.load(std::memory_order_relaxed) && g_binaryLogGuard.Enter())
+    {
+        GetProcessBinaryLog().SetRotation(options);
+        g_binaryLogGuard.Leave();
+    }
+}
+
 void OpenLogFileInExplorer()
 {
     std::wstring logPath = GetLogFilePath();
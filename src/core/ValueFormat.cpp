@@ -0,0 +1,227 @@
+// ============================================================================
+// File: ValueFormat.cpp
+// Description: Speed and byte-count text written into caller buffers
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#include "NetworkMonitor/ValueFormat.h"
+#include "NetworkMonitor/Units.h"
+#include <charconv>
+#include <cmath>
+
+namespace NetworkMonitor
+{
+
+namespace
+{
+    // Bytes in one Unit
+    template <typename Unit>
+    constexpr double BytesPer()
+    {
+        return DataSize<Bytes>(DataSize<Unit>(1.0)).Count();
+    }
+
+    // Each shown size and speed unit is 1024 of the one before
+    constexpr double IEC_STEP = BytesPer<Kibibytes>();
+
+    struct UnitText
+    {
+        const char* narrow;
+        const wchar_t* wide;
+        size_t length;
+    };
+
+    // B/s, KB/s, MB/s and GB/s scale by 1024; Mbps stands alone
+    constexpr size_t SPEED_GB_INDEX = 3;
+    constexpr size_t SPEED_MBPS_INDEX = 4;
+    constexpr UnitText SPEED_UNITS[] = {
+        { " B/s", L" B/s", 4 },
+        { " KB/s", L" KB/s", 5 },
+        { " MB/s", L" MB/s", 5 },
+        { " GB/s", L" GB/s", 5 },
+        { " Mbps", L" Mbps", 5 },
+    };
+
+    // SPEED_UNITS entry a speed converted to Unit starts from
+    template <typename Unit>
+    constexpr size_t SpeedUnitIndex()
+    {
+        if constexpr (std::is_same<Unit, Bytes>::value)
+        {
+            return 0;
+        }
+        else if constexpr (std::is_same<Unit, Kibibytes>::value)
+        {
+            return 1;
+        }
+        else if constexpr (std::is_same<Unit, Mebibytes>::value)
+        {
+            return 2;
+        }
+        else
+        {
+            static_assert(std::is_same<Unit, Megabits>::value, "no text for this speed unit");
+            return SPEED_MBPS_INDEX;
+        }
+    }
+
+    // A count of at least SIZE_STEPS[i] bytes is shown in SIZE_UNITS[i + 1]
+    constexpr double SIZE_STEPS[] = { BytesPer<Kibibytes>(), BytesPer<Mebibytes>(), BytesPer<Gibibytes>(),
+                                      BytesPer<Tebibytes>() };
+    constexpr UnitText SIZE_UNITS[] = {
+        { " B", L" B", 2 },
+        { " KB", L" KB", 3 },
+        { " MB", L" MB", 3 },
+        { " GB", L" GB", 3 },
+        { " TB", L" TB", 3 },
+    };
+    static_assert(sizeof(SIZE_UNITS) / sizeof(SIZE_UNITS[0]) == sizeof(SIZE_STEPS) / sizeof(SIZE_STEPS[0]) + 1,
+                  "one unit per step plus bytes");
+
+    inline const char* UnitChars(const UnitText& unit, char*)
+    {
+        return unit.narrow;
+    }
+
+    inline const wchar_t* UnitChars(const UnitText& unit, wchar_t*)
+    {
+        return unit.wide;
+    }
+
+    // Digits (ASCII) followed by the unit, terminated
+    template <typename CharT>
+    size_t WriteValue(const char* digits, const char* digitsEnd, const UnitText& unit, CharT* out, size_t capacity)
+    {
+        size_t digitCount = static_cast<size_t>(digitsEnd - digits);
+        size_t length = digitCount + unit.length;
+        if (capacity <= length)
+        {
+            if (capacity > 0)
+            {
+                out[0] = 0;
+            }
+            return 0;
+        }
+
+        for (size_t i = 0; i < digitCount; ++i)
+        {
+            out[i] = static_cast<CharT>(digits[i]);
+        }
+        const CharT* unitChars = UnitChars(unit, out);
+        for (size_t i = 0; i < unit.length; ++i)
+        {
+            out[digitCount + i] = unitChars[i];
+        }
+        out[length] = 0;
+        return length;
+    }
+
+    // Largest value * 100 the integer path takes: whole numbers below it
+    // are exact doubles
+    constexpr double FIXED_FAST_LIMIT = 4503599627370496.0;    // 2^52
+    constexpr double FIXED_FAST_MARGIN = 1.0 / 1125899906842624.0;  // 2^-50
+
+    // Two decimals, as std::fixed with setprecision(2) prints them
+    template <typename CharT>
+    size_t WriteFixed(double value, const UnitText& unit, CharT* out, size_t capacity)
+    {
+        char digits[MAX_FORMATTED_VALUE_CHARS];
+
+        // value * 100 is off from the exact product by at most 2^-52 of
+        // itself. Unless that is enough to cross a rounding boundary, its
+        // nearest whole number is the exact result and the digits come from
+        // integer arithmetic. Near-ties (0.125, 2.675) go to to_chars.
+        double hundredths = std::fabs(value) * 100.0;
+        if (hundredths < FIXED_FAST_LIMIT)
+        {
+            double whole = std::floor(hundredths);
+            double fraction = hundredths - whole;
+            if (std::fabs(fraction - 0.5) > hundredths * FIXED_FAST_MARGIN)
+            {
+                unsigned long long rounded = static_cast<unsigned long long>(whole) + (fraction > 0.5 ? 1 : 0);
+                char* end = digits;
+                if (std::signbit(value))
+                {
+                    *end++ = '-';
+                }
+                end = std::to_chars(end, digits + sizeof(digits), rounded / 100).ptr;
+                unsigned int cents = static_cast<unsigned int>(rounded % 100);
+                end[0] = '.';
+                end[1] = static_cast<char>('0' + cents / 10);
+                end[2] = static_cast<char>('0' + cents % 10);
+                return WriteValue(digits, end + 3, unit, out, capacity);
+            }
+        }
+
+        std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::fixed, 2);
+        if (result.ec != std::errc())
+        {
+            if (capacity > 0)
+            {
+                out[0] = 0;
+            }
+            return 0;
+        }
+        return WriteValue(digits, result.ptr, unit, out, capacity);
+    }
+
+    template <typename CharT>
+    size_t FormatSpeedText(double bytesPerSecond, SpeedUnit unit, CharT* out, size_t capacity)
+    {
+        const DataRate<Bytes> rate(bytesPerSecond);
+        double value = 0.0;
+        size_t index = 0;
+        VisitSpeedUnit(unit, [&rate, &value, &index](auto target) {
+            using Unit = decltype(target);
+            value = UnitCast<Unit>(rate).Count();
+            index = SpeedUnitIndex<Unit>();
+        });
+
+        // Decimal megabits are past SPEED_GB_INDEX and not scaled further
+        while (index < SPEED_GB_INDEX && value >= IEC_STEP)
+        {
+            value /= IEC_STEP;
+            ++index;
+        }
+        return WriteFixed(value, SPEED_UNITS[index], out, capacity);
+    }
+
+    template <typename CharT>
+    size_t FormatBytesText(ULONG64 bytes, CharT* out, size_t capacity)
+    {
+        const double size = static_cast<double>(bytes);
+        for (size_t step = sizeof(SIZE_STEPS) / sizeof(SIZE_STEPS[0]); step > 0; --step)
+        {
+            if (size >= SIZE_STEPS[step - 1])
+            {
+                return WriteFixed(size / SIZE_STEPS[step - 1], SIZE_UNITS[step], out, capacity);
+            }
+        }
+
+        char digits[24];
+        std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), bytes);
+        return WriteValue(digits, result.ptr, SIZE_UNITS[0], out, capacity);
+    }
+}
+
+size_t FormatSpeedTo(double bytesPerSecond, SpeedUnit unit, char* out, size_t capacity)
+{
+    return FormatSpeedText(bytesPerSecond, unit, out, capacity);
+}
+
+size_t FormatSpeedTo(double bytesPerSecond, SpeedUnit unit, wchar_t* out, size_t capacity)
+{
+    return FormatSpeedText(bytesPerSecond, unit, out, capacity);
+}
+
+size_t FormatBytesTo(ULONG64 bytes, char* out, size_t capacity)
+{
+    return FormatBytesText(bytes, out, capacity);
+}
+
+size_t FormatBytesTo(ULONG64 bytes, wchar_t* out, size_t capacity)
+{
+    return FormatBytesText(bytes, out, capacity);
+}
+
+} // namespace NetworkMonitor
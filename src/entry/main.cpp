@@ -7,8 +7,276 @@
 #include "NetworkMonitor/Common.h"
 #include "NetworkMonitor/Utils.h"
 #include "NetworkMonitor/Application.h"
+#include "NetworkMonitor/HistoryLogger.h"
+#include "NetworkMonitor/HistoryExport.h"
 #include "../../resources/resource.h"
 #include <windows.h>
+#include <shellapi.h>
+#include <ctime>
+#include <cwchar>
+#include <string>
+
+// ============================================================================
+// COMMAND-LINE EXPORT / IMPORT / BACKUP
+// ============================================================================
+
+enum class CommandLineCommand
+{
+    None,
+    Export,
+    Import,
+    Backup
+};
+
+// --export, --import or --backup and the options that go with them
+struct CommandLineOptions
+{
+    CommandLineCommand command;
+    const wchar_t* commandName;
+    bool argsOk;
+    std::wstring path;
+    NetworkMonitor::HistoryExportFormat format;
+    bool formatGiven;
+    std::time_t from;
+    std::time_t to;
+    std::wstring interfaceName;
+    bool rebuildIndexes;
+
+    CommandLineOptions()
+        : command(CommandLineCommand::None)
+        , commandName(L"")
+        , argsOk(true)
+        , format(NetworkMonitor::HistoryExportFormat::Csv)
+        , formatGiven(false)
+        , from(0)
+        , to(0)
+        , rebuildIndexes(false)
+    {
+    }
+};
+
+// Parses the process command line once for every headless command. A
+// second command, or one missing its path, makes the arguments invalid.
+static CommandLineOptions ParseCommandLine()
+{
+    CommandLineOptions options;
+
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if (!argv)
+    {
+        return options;
+    }
+
+    struct CommandName
+    {
+        const wchar_t* name;
+        CommandLineCommand command;
+    };
+    static const CommandName commands[] = {
+        { L"--export", CommandLineCommand::Export },
+        { L"--import", CommandLineCommand::Import },
+        { L"--backup", CommandLineCommand::Backup },
+    };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::wstring arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+
+        const CommandName* command = nullptr;
+        for (const CommandName& candidate : commands)
+        {
+            if (arg == candidate.name)
+            {
+                command = &candidate;
+            }
+        }
+
+        if (command)
+        {
+            if (options.command != CommandLineCommand::None)
+            {
+                options.argsOk = false;
+            }
+            else
+            {
+                options.command = command->command;
+                options.commandName = command->name;
+            }
+            if (hasValue)
+            {
+                options.path = argv[++i];
+            }
+            else
+            {
+                options.argsOk = false;
+            }
+        }
+        else if (arg == L"--format" && hasValue)
+        {
+            options.formatGiven = true;
+            options.argsOk = NetworkMonitor::ParseHistoryExportFormat(argv[++i], options.format) && options.argsOk;
+        }
+        else if (arg == L"--from" && hasValue)
+        {
+            options.from = static_cast<std::time_t>(_wcstoi64(argv[++i], nullptr, 10));
+        }
+        else if (arg == L"--to" && hasValue)
+        {
+            options.to = static_cast<std::time_t>(_wcstoi64(argv[++i], nullptr, 10));
+        }
+        else if (arg == L"--interface" && hasValue)
+        {
+            options.interfaceName = argv[++i];
+        }
+        else if (arg == L"--rebuild-indexes")
+        {
+            options.rebuildIndexes = true;
+        }
+    }
+    LocalFree(argv);
+
+    if (options.path.empty())
+    {
+        options.argsOk = false;
+    }
+
+    // Infer the format from the extension when --format is absent
+    if (!options.formatGiven)
+    {
+        size_t dot = options.path.find_last_of(L'.');
+        if (dot != std::wstring::npos)
+        {
+            NetworkMonitor::ParseHistoryExportFormat(options.path.substr(dot + 1), options.format);
+        }
+    }
+    return options;
+}
+
+// Handles: --export <path> [--format csv|ndjson|columnar] [--from <epoch>]
+//          [--to <epoch>] [--interface <name>]
+// Reads the database read-only, so it can run next to the tray instance.
+static int RunCommandLineExport(const CommandLineOptions& options)
+{
+    NetworkMonitor::HistoryLogger::SetReadOnly(true);
+
+    unsigned long long rows = 0;
+    bool ok = NetworkMonitor::HistoryLogger::Instance().ExportHistory(
+        options.path, options.format, options.from, options.to,
+        options.interfaceName.empty() ? nullptr : &options.interfaceName, &rows);
+
+    NM_LOG_DEBUG(L"WinMain: command-line export of " + std::to_wstring(rows) +
+                 L" rows to " + options.path + (ok ? L" succeeded" : L" failed"));
+    return ok ? 0 : 1;
+}
+
+// Handles: --import <path> [--format csv|ndjson|columnar] [--rebuild-indexes]
+// Loads an exported (or compatible) file into the history database as a
+// bulk load. --rebuild-indexes drops and recreates the usage indexes, which
+// pays off for loads out of timestamp order. Refuses to run while the tray
+// instance is writing to the same database.
+static int RunCommandLineImport(const CommandLineOptions& options)
+{
+    HANDLE hMutex = CreateMutexW(nullptr, TRUE, L"NetworkMonitor_SingleInstance");
+    if (GetLastError() == ERROR_ALREADY_EXISTS)
+    {
+        NM_LOG_ERROR(L"WinMain: --import needs NetworkMonitor to be closed first");
+        if (hMutex)
+        {
+            CloseHandle(hMutex);
+        }
+        return 3;
+    }
+
+    NetworkMonitor::HistoryImportOptions importOptions;
+    importOptions.rebuildIndexes = options.rebuildIndexes;
+    importOptions.progress = [](unsigned long long rows) {
+        NM_LOG_DEBUG(L"WinMain: imported " + std::to_wstring(rows) + L" rows");
+        return true;
+    };
+
+    unsigned long long rows = 0;
+    bool ok = NetworkMonitor::HistoryLogger::Instance().ImportHistory(options.path, options.format,
+                                                                      importOptions, &rows);
+
+    NM_LOG_DEBUG(L"WinMain: command-line import of " + std::to_wstring(rows) +
+                 L" rows from " + options.path + (ok ? L" succeeded" : L" failed"));
+
+    if (hMutex)
+    {
+        ReleaseMutex(hMutex);
+        CloseHandle(hMutex);
+    }
+    return ok ? 0 : 1;
+}
+
+// Handles: --backup <path>
+// Copies the history database to path as a single standalone file. Reads
+// the database read-only, so it is safe while the tray instance is running:
+// the copy is paced so its sampling keeps committing, and reflects the
+// history as of the start of the copy.
+static int RunCommandLineBackup(const CommandLineOptions& options)
+{
+    NetworkMonitor::HistoryLogger::SetReadOnly(true);
+
+    unsigned long long lastPercent = 0;
+    NetworkMonitor::HistoryBackupOptions backupOptions;
+    backupOptions.progress = [&lastPercent](unsigned long long copied, unsigned long long total) {
+        unsigned long long percent = (total > 0) ? copied * 100 / total : 100;
+        if (percent >= lastPercent + 10 || percent == 100)
+        {
+            lastPercent = percent;
+            NM_LOG_DEBUG(L"WinMain: backup " + std::to_wstring(percent) + L"% (" +
+                         std::to_wstring(copied) + L"/" + std::to_wstring(total) + L" pages)");
+        }
+        return true;
+    };
+
+    NetworkMonitor::HistoryBackupStats stats;
+    bool ok = NetworkMonitor::HistoryLogger::Instance().BackupTo(options.path, backupOptions, &stats);
+
+    NM_LOG_DEBUG(L"WinMain: command-line backup to " + options.path + L" in " +
+                 std::to_wstring(stats.elapsedMicroseconds / 1000) + L" ms" +
+                 (ok ? L" succeeded" : L" failed"));
+    return ok ? 0 : 1;
+}
+
+// Runs the headless command on the command line, if any. Returns false so
+// normal startup continues when there is none; the outcome is reported
+// through exitCode and the log.
+static bool RunCommandLine(int& exitCode)
+{
+    CommandLineOptions options = ParseCommandLine();
+    if (options.command == CommandLineCommand::None)
+    {
+        return false;
+    }
+
+    if (!options.argsOk)
+    {
+        NM_LOG_ERROR(std::wstring(L"WinMain: invalid ") + options.commandName + L" arguments");
+        exitCode = 2;
+        return true;
+    }
+
+    switch (options.command)
+    {
+    case CommandLineCommand::Export:
+        exitCode = RunCommandLineExport(options);
+        break;
+    case CommandLineCommand::Import:
+        exitCode = RunCommandLineImport(options);
+        break;
+    case CommandLineCommand::Backup:
+        exitCode = RunCommandLineBackup(options);
+        break;
+    case CommandLineCommand::None:
+        break;
+    }
+    return true;
+}
+
 // ============================================================================
 // WINMAIN - APPLICATION ENTRY POINT
 // ============================================================================
@@ -23,13 +291,21 @@ int WINAPI WinMain(
     UNREFERENCED_PARAMETER(lpCmdLine);
     UNREFERENCED_PARAMETER(nCmdShow);
 
-    NetworkMonitor::LogDebug(L"WinMain: NetworkMonitor starting");
+    NM_LOG_DEBUG(L"WinMain: NetworkMonitor starting");
+
+    // Headless export and backup open the database read-only next to the
+    // tray instance; import checks for it itself
+    int commandExitCode = 0;
+    if (RunCommandLine(commandExitCode))
+    {
+        return commandExitCode;
+    }
 
     // Check if another instance is already running
     HANDLE hMutex = CreateMutexW(nullptr, TRUE, L"NetworkMonitor_SingleInstance");
     if (GetLastError() == ERROR_ALREADY_EXISTS)
     {
-        NetworkMonitor::LogError(L"WinMain: another instance is already running");
+        NM_LOG_ERROR(L"WinMain: another instance is already running");
         std::wstring msg = NetworkMonitor::LoadStringResource(IDS_ERROR_ALREADY_RUNNING);
         std::wstring title = NetworkMonitor::LoadStringResource(IDS_APP_TITLE);
         if (title.empty())
@@ -49,7 +325,7 @@ int WINAPI WinMain(
     if (!app.Initialize(hInstance))
     {
         // Initialization failed; Application will show any relevant error messages
-        NetworkMonitor::LogError(L"WinMain: Application::Initialize failed");
+        NM_LOG_ERROR(L"WinMain: Application::Initialize failed");
         if (hMutex)
         {
             ReleaseMutex(hMutex);
@@ -69,7 +345,7 @@ int WINAPI WinMain(
         CloseHandle(hMutex);
     }
 
-    NetworkMonitor::LogDebug(L"WinMain: exiting with code " + std::to_wstring(result));
+    NM_LOG_DEBUG(L"WinMain: exiting with code " + std::to_wstring(result));
     return result;
 }
 
@@ -5,7 +5,9 @@
 // ============================================================================
 
 #include "NetworkMonitor/TaskbarOverlay.h"
+#include "NetworkMonitor/StringCatalog.h"
 #include "NetworkMonitor/Utils.h"
+#include "NetworkMonitor/ValueFormat.h"
 #include "../../resources/resource.h"
 #include <dwmapi.h>
 
@@ -473,24 +475,28 @@ void TaskbarOverlay::OnPaint()
     }
 
     // Format speeds
-    std::wstring downStr = FormatSpeed(m_downloadSpeed, m_displayUnit);
-    std::wstring upStr = FormatSpeed(m_uploadSpeed, m_displayUnit);
+    FormattedValue<wchar_t> downText;
+    FormattedValue<wchar_t> upText;
+    FormatSpeedTo(m_downloadSpeed, m_displayUnit, downText);
+    FormatSpeedTo(m_uploadSpeed, m_displayUnit, upText);
 
     // Create 2 lines with localized prefixes
-    std::wstring downPrefix = LoadStringResource(IDS_OVERLAY_DOWN_PREFIX);
+    std::wstring_view downPrefix = LoadStringView(IDS_OVERLAY_DOWN_PREFIX);
     if (downPrefix.empty())
     {
         downPrefix = L"Down: ";
     }
 
-    std::wstring upPrefix = LoadStringResource(IDS_OVERLAY_UP_PREFIX);
+    std::wstring_view upPrefix = LoadStringView(IDS_OVERLAY_UP_PREFIX);
     if (upPrefix.empty())
     {
         upPrefix = L"Up: ";
     }
 
-    std::wstring line1 = downPrefix + downStr;
-    std::wstring line2 = upPrefix + upStr;
+    wchar_t line1[128];
+    wchar_t line2[128];
+    swprintf_s(line1, L"%.*s%s", static_cast<int>(downPrefix.size()), downPrefix.data(), downText.c_str());
+    swprintf_s(line2, L"%.*s%s", static_cast<int>(upPrefix.size()), upPrefix.data(), upText.c_str());
 
     // Calculate line positions
     int lineHeight = 16;
@@ -504,12 +510,12 @@ void TaskbarOverlay::OnPaint()
 
     // Draw Download line - GREEN color
     SetTextColor(hdcMem, downColor);
-    DrawTextW(hdcMem, line1.c_str(), -1, &line1Rect,
+    DrawTextW(hdcMem, line1, -1, &line1Rect,
               DT_SINGLELINE | DT_LEFT | DT_VCENTER);
 
     // Draw Upload line - ORANGE color
     SetTextColor(hdcMem, upColor);
-    DrawTextW(hdcMem, line2.c_str(), -1, &line2Rect,
+    DrawTextW(hdcMem, line2, -1, &line2Rect,
               DT_SINGLELINE | DT_LEFT | DT_VCENTER);
 
     // Draw Ping latency on the right side
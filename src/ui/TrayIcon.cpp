@@ -7,6 +7,8 @@
 #include "NetworkMonitor/TrayIcon.h"
 #include "NetworkMonitor/Utils.h"
 #include "NetworkMonitor/ThemeHelper.h"
+#include "NetworkMonitor/Units.h"
+#include "NetworkMonitor/ValueFormat.h"
 #include "../../resources/resource.h"
 
 namespace NetworkMonitor
@@ -21,7 +23,7 @@ TrayIcon::TrayIcon()
     , m_iconIdleDark(nullptr)
     , m_iconActiveDark(nullptr)
     , m_iconHighDark(nullptr)
-    , m_configRef(nullptr)
+    , m_configStore(nullptr)
     , m_overlayVisibleProvider(nullptr)
 {
     ZeroMemory(&m_notifyIconData, sizeof(NOTIFYICONDATAW));
@@ -124,9 +126,9 @@ bool TrayIcon::Initialize(HWND hwnd)
     m_notifyIconData.uCallbackMessage = WM_TRAYICON;
 
     bool useDark = false;
-    if (m_configRef)
+    if (m_configStore)
     {
-        useDark = m_configRef->darkTheme;
+        useDark = m_configStore->Current().darkTheme;
     }
     else
     {
@@ -202,18 +204,14 @@ void TrayIcon::UpdateTooltip(const NetworkStats& stats, SpeedUnit unit)
         return;
     }
 
-    // Format tooltip text
-    std::wstring downloadStr = FormatSpeed(stats.currentDownloadSpeed, unit);
-    std::wstring uploadStr = FormatSpeed(stats.currentUploadSpeed, unit);
-
-    std::wstring tooltip = APP_NAME;
-    tooltip += L"\n";
-    tooltip += L"↓ " + downloadStr;
-    tooltip += L"\n";
-    tooltip += L"↑ " + uploadStr;
+    // Format tooltip text straight into the notify data, once per tick
+    FormattedValue<wchar_t> downloadText;
+    FormattedValue<wchar_t> uploadText;
+    FormatSpeedTo(stats.currentDownloadSpeed, unit, downloadText);
+    FormatSpeedTo(stats.currentUploadSpeed, unit, uploadText);
 
     // Update tooltip
-    wcscpy_s(m_notifyIconData.szTip, tooltip.c_str());
+    swprintf_s(m_notifyIconData.szTip, L"%s\n↓ %s\n↑ %s", APP_NAME, downloadText.c_str(), uploadText.c_str());
     m_notifyIconData.uFlags = NIF_TIP;
     Shell_NotifyIconW(NIM_MODIFY, &m_notifyIconData);
 }
@@ -227,9 +225,9 @@ void TrayIcon::UpdateIcon(double downloadSpeed, double uploadSpeed)
 
     // Determine if we should use dark theme icons
     bool useDark = false;
-    if (m_configRef)
+    if (m_configStore)
     {
-        useDark = m_configRef->darkTheme;
+        useDark = m_configStore->Current().darkTheme;
     }
     else
     {
@@ -237,8 +235,8 @@ void TrayIcon::UpdateIcon(double downloadSpeed, double uploadSpeed)
     }
 
     // Determine which icon to use based on traffic
-    const double HIGH_THRESHOLD = 1024.0 * 1024.0;  // 1 MB/s
-    const double ACTIVE_THRESHOLD = 10.0 * 1024.0;  // 10 KB/s
+    constexpr double HIGH_THRESHOLD = UnitCast<Bytes>(DataRate<Mebibytes>(1.0)).Count();
+    constexpr double ACTIVE_THRESHOLD = UnitCast<Bytes>(DataRate<Kibibytes>(10.0)).Count();
 
     HICON newIcon = useDark ? m_iconIdleDark : m_iconIdle;
     double totalSpeed = downloadSpeed + uploadSpeed;
@@ -310,12 +308,8 @@ void TrayIcon::ShowContextMenu()
         return;
     }
 
-    const AppConfig* configPtr = m_configRef;
     AppConfig tempConfig;
-    if (!configPtr)
-    {
-        configPtr = &tempConfig;
-    }
+    const AppConfig* configPtr = m_configStore ? &m_configStore->Current() : &tempConfig;
 
     // Ensure the process-level dark mode preference matches the current
     // system app theme so that the tray context menu follows Windows
@@ -371,9 +365,9 @@ void TrayIcon::SetMenuCallback(std::function<void(UINT)> callback)
     m_menuCallback = callback;
 }
 
-void TrayIcon::SetConfigSource(const AppConfig* config)
+void TrayIcon::SetConfigSource(const ConfigStore* configStore)
 {
-    m_configRef = config;
+    m_configStore = configStore;
 }
 
 void TrayIcon::SetOverlayVisibilityProvider(std::function<bool()> provider)
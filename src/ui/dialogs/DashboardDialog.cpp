@@ -8,14 +8,18 @@
 #include "NetworkMonitor/NetworkMonitor.h"
 #include "NetworkMonitor/HistoryLogger.h"
 #include "NetworkMonitor/HistoryDialog.h"
+#include "NetworkMonitor/StringCatalog.h"
+#include "NetworkMonitor/BillingCycle.h"
 #include "NetworkMonitor/Utils.h"
 #include "NetworkMonitor/ThemeHelper.h"
+#include "NetworkMonitor/ValueFormat.h"
 #include "../../../resources/resource.h"
 #include <windowsx.h>
 #include <commctrl.h>
 #include <uxtheme.h>
 #include <algorithm>
 #include <sstream>
+#include <chrono>
 #include <ctime>
 
 // Fix Windows macro conflicts
@@ -31,12 +35,68 @@ namespace
     // instance with the header control.
     const wchar_t* HEADER_OLDPROC_PROP = L"NM_DASHBOARD_HEADER_OLDPROC";
     const wchar_t* HEADER_THIS_PROP    = L"NM_DASHBOARD_HEADER_THIS";
+
+    // Local date (and optionally time) for the billing lines; "-" for 0
+    std::wstring FormatLocalTime(std::time_t t, bool withTime)
+    {
+        wchar_t buffer[64] = L"-";
+        std::tm localTime = {};
+        if (t != 0 && localtime_s(&localTime, &t) == 0)
+        {
+            wcsftime(buffer, sizeof(buffer) / sizeof(wchar_t),
+                     withTime ? L"%Y-%m-%d %H:%M" : L"%Y-%m-%d", &localTime);
+        }
+        return buffer;
+    }
+
+    // Catalog strings are terminated, so the view's data() is a C string
+    const wchar_t* LoadText(UINT id, const wchar_t* fallback)
+    {
+        std::wstring_view fmt = LoadStringView(id);
+        return fmt.empty() ? fallback : fmt.data();
+    }
+
+    // Posted by a query thread when one of the dashboard's queries is done;
+    // wParam is the DashboardQuery
+    constexpr UINT WM_DASHBOARD_QUERY_DONE = WM_APP + 1;
+
+    enum DashboardQuery
+    {
+        QUERY_TODAY,
+        QUERY_MONTH,
+        QUERY_CYCLE,
+        QUERY_RECENT
+    };
+
+    AsyncQueryOptions NotifyWhenDone(HWND hDlg, QuerySlot& slot, DashboardQuery query)
+    {
+        AsyncQueryOptions options;
+        options.slot = &slot;
+        options.onComplete = [hDlg, query]() {
+            PostMessageW(hDlg, WM_DASHBOARD_QUERY_DONE, static_cast<WPARAM>(query), 0);
+        };
+        return options;
+    }
+
+    // Take the result if the future is ready; a completion message for a
+    // superseded query may arrive after a newer future has replaced it
+    template <typename T>
+    bool TakeIfReady(std::future<T>& future, T& out)
+    {
+        if (!future.valid() || future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            return false;
+        }
+        out = future.get();
+        return true;
+    }
 }
 
 DashboardDialog::DashboardDialog()
     : m_hDialog(nullptr)
     , m_pNetworkMonitor(nullptr)
     , m_pConfig(nullptr)
+    , m_cycleQuota(0)
 {
 }
 
@@ -124,6 +184,12 @@ INT_PTR CALLBACK DashboardDialog::InstanceDialogProc(HWND hDlg, UINT message, WP
                 SetDlgItemTextW(hDlg, IDC_DASHBOARD_LABEL_MONTH, monthLabel.c_str());
             }
 
+            std::wstring cycleLabel = LoadStringResource(IDS_DASHBOARD_LABEL_CYCLE);
+            if (!cycleLabel.empty())
+            {
+                SetDlgItemTextW(hDlg, IDC_DASHBOARD_LABEL_CYCLE, cycleLabel.c_str());
+            }
+
             std::wstring dlLabel = LoadStringResource(IDS_DASHBOARD_LABEL_DOWNLOAD);
             if (!dlLabel.empty())
             {
@@ -266,12 +332,6 @@ INT_PTR CALLBACK DashboardDialog::InstanceDialogProc(HWND hDlg, UINT message, WP
                 case IDC_DASHBOARD_REFRESH:
                 {
                     UpdateDashboardData(hDlg);
-
-                    HWND hChart = GetDlgItem(hDlg, IDC_DASHBOARD_CHART);
-                    if (hChart)
-                    {
-                        InvalidateRect(hChart, nullptr, TRUE);
-                    }
                     return TRUE;
                 }
 
@@ -288,6 +348,10 @@ INT_PTR CALLBACK DashboardDialog::InstanceDialogProc(HWND hDlg, UINT message, WP
                 case IDOK:
                 case IDCANCEL:
                 {
+                    m_todaySlot.Cancel();
+                    m_monthSlot.Cancel();
+                    m_cycleSlot.Cancel();
+                    m_recentSlot.Cancel();
                     EndDialog(hDlg, LOWORD(wParam));
                     return TRUE;
                 }
@@ -295,6 +359,12 @@ INT_PTR CALLBACK DashboardDialog::InstanceDialogProc(HWND hDlg, UINT message, WP
             break;
         }
 
+        case WM_DASHBOARD_QUERY_DONE:
+        {
+            OnQueryDone(hDlg, wParam);
+            return TRUE;
+        }
+
         case WM_CTLCOLORDLG:
         case WM_CTLCOLORSTATIC:
         case WM_CTLCOLORBTN:
@@ -392,43 +462,91 @@ INT_PTR CALLBACK DashboardDialog::InstanceDialogProc(HWND hDlg, UINT message, WP
 
 void DashboardDialog::UpdateDashboardData(HWND hDlg)
 {
-    unsigned long long todayDown = 0;
-    unsigned long long todayUp = 0;
-    unsigned long long monthDown = 0;
-    unsigned long long monthUp = 0;
-
     HistoryLogger& logger = HistoryLogger::Instance();
-    const std::wstring* ifaceFilter = nullptr;
+    std::wstring ifaceFilter;
+    m_cycleQuota = 0;
 
-    if (m_pConfig && !m_pConfig->selectedInterface.empty())
+    if (m_pConfig)
     {
-        ifaceFilter = &m_pConfig->selectedInterface;
+        ifaceFilter = m_pConfig->selectedInterface;
+        m_cycleQuota = GetBillingQuota(*m_pConfig, m_pConfig->selectedInterface);
     }
 
-    logger.GetTotalsToday(todayDown, todayUp, ifaceFilter);
-    logger.GetTotalsThisMonth(monthDown, monthUp, ifaceFilter);
+    m_todayQuery = logger.GetTotalsTodayAsync(ifaceFilter, NotifyWhenDone(hDlg, m_todaySlot, QUERY_TODAY));
+    m_monthQuery = logger.GetTotalsThisMonthAsync(ifaceFilter, NotifyWhenDone(hDlg, m_monthSlot, QUERY_MONTH));
+    m_cycleQuery = logger.GetBillingStatusAsync(ifaceFilter, m_cycleQuota,
+                                                NotifyWhenDone(hDlg, m_cycleSlot, QUERY_CYCLE));
+    m_recentQuery = logger.GetRecentSamplesAsync(100, ifaceFilter, true /*onlyToday*/,
+                                                 NotifyWhenDone(hDlg, m_recentSlot, QUERY_RECENT));
+}
 
-    std::wstring todayDownStr = FormatBytes(static_cast<ULONG64>(todayDown));
-    std::wstring todayUpStr = FormatBytes(static_cast<ULONG64>(todayUp));
-    std::wstring monthDownStr = FormatBytes(static_cast<ULONG64>(monthDown));
-    std::wstring monthUpStr = FormatBytes(static_cast<ULONG64>(monthUp));
+void DashboardDialog::OnQueryDone(HWND hDlg, WPARAM query)
+{
+    switch (query)
+    {
+        case QUERY_TODAY:
+        case QUERY_MONTH:
+        {
+            bool today = (query == QUERY_TODAY);
+            AsyncQueryResult<UsageTotals> result;
+            if (!TakeIfReady(today ? m_todayQuery : m_monthQuery, result) || result.cancelled)
+            {
+                return;
+            }
 
-    SetDlgItemTextW(hDlg, IDC_TODAY_DOWN, todayDownStr.c_str());
-    SetDlgItemTextW(hDlg, IDC_TODAY_UP, todayUpStr.c_str());
-    SetDlgItemTextW(hDlg, IDC_MONTH_DOWN, monthDownStr.c_str());
-    SetDlgItemTextW(hDlg, IDC_MONTH_UP, monthUpStr.c_str());
+            FormattedValue<wchar_t> downText;
+            FormattedValue<wchar_t> upText;
+            FormatBytesTo(static_cast<ULONG64>(result.value.bytesDown), downText);
+            FormatBytesTo(static_cast<ULONG64>(result.value.bytesUp), upText);
+            SetDlgItemTextW(hDlg, today ? IDC_TODAY_DOWN : IDC_MONTH_DOWN, downText.c_str());
+            SetDlgItemTextW(hDlg, today ? IDC_TODAY_UP : IDC_MONTH_UP, upText.c_str());
+            break;
+        }
 
+        case QUERY_CYCLE:
+        {
+            AsyncQueryResult<BillingStatus> result;
+            if (TakeIfReady(m_cycleQuery, result) && !result.cancelled)
+            {
+                ShowBillingCycle(hDlg, result);
+            }
+            break;
+        }
+
+        case QUERY_RECENT:
+        {
+            AsyncQueryResult<std::vector<HistorySample>> result;
+            if (!TakeIfReady(m_recentQuery, result) || result.cancelled)
+            {
+                return;
+            }
+
+            m_chartSamples = std::move(result.value);
+            ShowRecentSamples(hDlg);
+
+            HWND hChart = GetDlgItem(hDlg, IDC_DASHBOARD_CHART);
+            if (hChart)
+            {
+                InvalidateRect(hChart, nullptr, TRUE);
+            }
+            break;
+        }
+    }
+}
+
+void DashboardDialog::ShowRecentSamples(HWND hDlg)
+{
     // Populate recent samples list
     HWND hList = GetDlgItem(hDlg, IDC_RECENT_LIST);
     if (hList)
     {
         ListView_DeleteAllItems(hList);
 
-        std::vector<HistorySample> samples;
-        logger.GetRecentSamples(100, samples, ifaceFilter, true /*onlyToday*/);
-
+        // The ListView copies item text, so one pair of buffers serves every row
+        FormattedValue<wchar_t> downText;
+        FormattedValue<wchar_t> upText;
         int index = 0;
-        for (const auto& sample : samples)
+        for (const auto& sample : m_chartSamples)
         {
             wchar_t timeBuffer[64] = {};
             std::tm localTime = {};
@@ -445,22 +563,18 @@ void DashboardDialog::UpdateDashboardData(HWND hDlg)
             item.pszText = timeBuffer;
             int rowIndex = ListView_InsertItem(hList, &item);
 
-            std::wstring iface = sample.interfaceName;
-            if (iface.empty())
+            const wchar_t* iface = sample.interfaceName.c_str();
+            if (sample.interfaceName.empty())
             {
-                iface = LoadStringResource(IDS_ALL_INTERFACES);
-                if (iface.empty())
-                {
-                    iface = L"All Interfaces";
-                }
+                iface = LoadText(IDS_ALL_INTERFACES, L"All Interfaces");
             }
-            ListView_SetItemText(hList, rowIndex, 1, const_cast<wchar_t*>(iface.c_str()));
+            ListView_SetItemText(hList, rowIndex, 1, const_cast<wchar_t*>(iface));
 
-            std::wstring downStr = FormatBytes(static_cast<ULONG64>(sample.bytesDown));
-            std::wstring upStr = FormatBytes(static_cast<ULONG64>(sample.bytesUp));
+            FormatBytesTo(static_cast<ULONG64>(sample.bytesDown), downText);
+            FormatBytesTo(static_cast<ULONG64>(sample.bytesUp), upText);
 
-            ListView_SetItemText(hList, rowIndex, 2, const_cast<wchar_t*>(downStr.c_str()));
-            ListView_SetItemText(hList, rowIndex, 3, const_cast<wchar_t*>(upStr.c_str()));
+            ListView_SetItemText(hList, rowIndex, 2, downText.text);
+            ListView_SetItemText(hList, rowIndex, 3, upText.text);
 
             ++index;
         }
@@ -473,6 +587,56 @@ void DashboardDialog::UpdateDashboardData(HWND hDlg)
     }
 }
 
+void DashboardDialog::ShowBillingCycle(HWND hDlg, const AsyncQueryResult<BillingStatus>& result)
+{
+    if (!result.ok)
+    {
+        SetDlgItemTextW(hDlg, IDC_CYCLE_USAGE, L"");
+        SetDlgItemTextW(hDlg, IDC_CYCLE_PROJECTION, L"");
+        return;
+    }
+
+    const BillingStatus& status = result.value;
+    const unsigned long long quota = m_cycleQuota;
+
+    unsigned long long used = status.bytesDown + status.bytesUp;
+    std::wstring usedStr = FormatBytes(static_cast<ULONG64>(used));
+    std::wstring sinceStr = FormatLocalTime(status.period.start, false);
+
+    wchar_t usageText[256] = {0};
+    if (quota > 0)
+    {
+        const wchar_t* fmt = LoadText(IDS_DASHBOARD_CYCLE_USAGE_QUOTA, L"%s of %s (%d%%) since %s");
+        std::wstring quotaStr = FormatBytes(static_cast<ULONG64>(quota));
+        int percent = static_cast<int>(used * 100ULL / quota);
+        swprintf_s(usageText, fmt, usedStr.c_str(), quotaStr.c_str(), percent, sinceStr.c_str());
+    }
+    else
+    {
+        const wchar_t* fmt = LoadText(IDS_DASHBOARD_CYCLE_USAGE, L"%s since %s");
+        swprintf_s(usageText, fmt, usedStr.c_str(), sinceStr.c_str());
+    }
+    SetDlgItemTextW(hDlg, IDC_CYCLE_USAGE, usageText);
+
+    // With a cap that runs out this cycle, when; otherwise the cycle total
+    wchar_t projectionText[256] = {0};
+    if (status.capReachedLinear != 0 || status.capReachedWeighted != 0)
+    {
+        const wchar_t* fmt = LoadText(IDS_DASHBOARD_CYCLE_CAP, L"Cap reached: %s (linear), %s (time of day)");
+        std::wstring linearStr = FormatLocalTime(status.capReachedLinear, true);
+        std::wstring weightedStr = FormatLocalTime(status.capReachedWeighted, true);
+        swprintf_s(projectionText, fmt, linearStr.c_str(), weightedStr.c_str());
+    }
+    else
+    {
+        const wchar_t* fmt = LoadText(IDS_DASHBOARD_CYCLE_PROJECTION, L"Projected: %s (linear), %s (time of day)");
+        std::wstring linearStr = FormatBytes(static_cast<ULONG64>(status.projectedLinear));
+        std::wstring weightedStr = FormatBytes(static_cast<ULONG64>(status.projectedWeighted));
+        swprintf_s(projectionText, fmt, linearStr.c_str(), weightedStr.c_str());
+    }
+    SetDlgItemTextW(hDlg, IDC_CYCLE_PROJECTION, projectionText);
+}
+
 void DashboardDialog::DrawDashboardChart(HDC hdc, const RECT& rc)
 {
     if (!hdc)
@@ -493,15 +657,8 @@ void DashboardDialog::DrawDashboardChart(HDC hdc, const RECT& rc)
     FillRect(hdc, &rc, backBrush);
     DeleteObject(backBrush);
 
-    HistoryLogger& logger = HistoryLogger::Instance();
-    const std::wstring* ifaceFilter = nullptr;
-    if (m_pConfig && !m_pConfig->selectedInterface.empty())
-    {
-        ifaceFilter = &m_pConfig->selectedInterface;
-    }
-
-    std::vector<HistorySample> samples;
-    logger.GetRecentSamples(100, samples, ifaceFilter, true);
+    // Samples from the last refresh; painting never queries SQLite
+    const std::vector<HistorySample>& samples = m_chartSamples;
 
     if (samples.empty())
     {
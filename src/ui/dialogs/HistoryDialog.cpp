@@ -6,15 +6,24 @@
 
 #include "NetworkMonitor/HistoryDialog.h"
 #include "NetworkMonitor/HistoryLogger.h"
+#include "NetworkMonitor/HistoryExport.h"
 #include "NetworkMonitor/Utils.h"
 #include "NetworkMonitor/ThemeHelper.h"
 #include "../../../resources/resource.h"
 #include <windowsx.h>
 #include <commctrl.h>
+#include <commdlg.h>
+#include <cwchar>
 
 namespace NetworkMonitor
 {
 
+namespace
+{
+    // Posted by the query thread when an export has finished
+    constexpr UINT WM_HISTORY_EXPORT_DONE = WM_APP + 1;
+}
+
 HistoryDialog::HistoryDialog()
     : m_hDialog(nullptr)
     , m_pConfig(nullptr)
@@ -114,6 +123,7 @@ INT_PTR CALLBACK HistoryDialog::InstanceDialogProc(HWND hDlg, UINT message, WPAR
                 makeOwnerDraw(GetDlgItem(hDlg, IDC_HISTORY_DELETE_ALL));
                 makeOwnerDraw(GetDlgItem(hDlg, IDC_HISTORY_KEEP_30));
                 makeOwnerDraw(GetDlgItem(hDlg, IDC_HISTORY_KEEP_90));
+                makeOwnerDraw(GetDlgItem(hDlg, IDC_HISTORY_EXPORT));
                 makeOwnerDraw(GetDlgItem(hDlg, IDCANCEL));
 
                 // Clear default button id so the dialog manager does not draw
@@ -139,6 +149,12 @@ INT_PTR CALLBACK HistoryDialog::InstanceDialogProc(HWND hDlg, UINT message, WPAR
                 SetDlgItemTextW(hDlg, IDC_HISTORY_KEEP_90, btn90.c_str());
             }
 
+            std::wstring btnExport = LoadStringResource(IDS_HISTORY_BUTTON_EXPORT);
+            if (!btnExport.empty())
+            {
+                SetDlgItemTextW(hDlg, IDC_HISTORY_EXPORT, btnExport.c_str());
+            }
+
             return TRUE;
         }
 
@@ -171,7 +187,8 @@ INT_PTR CALLBACK HistoryDialog::InstanceDialogProc(HWND hDlg, UINT message, WPAR
                 {
                     UINT id = pDrawItem->CtlID;
                     if (id == IDC_HISTORY_DELETE_ALL || id == IDC_HISTORY_KEEP_30 ||
-                        id == IDC_HISTORY_KEEP_90 || id == IDCANCEL)
+                        id == IDC_HISTORY_KEEP_90 || id == IDC_HISTORY_EXPORT ||
+                        id == IDCANCEL)
                     {
                         HDC hdc = pDrawItem->hDC;
                         RECT rc = pDrawItem->rcItem;
@@ -297,13 +314,24 @@ INT_PTR CALLBACK HistoryDialog::InstanceDialogProc(HWND hDlg, UINT message, WPAR
                     return TRUE;
                 }
 
+                case IDC_HISTORY_EXPORT:
+                    ExportHistoryToFile(hDlg);
+                    return TRUE;
+
                 case IDCANCEL:
                 case IDOK:
+                    m_exportSlot.Cancel();
                     EndDialog(hDlg, LOWORD(wParam));
                     return TRUE;
             }
             break;
         }
+
+        case WM_HISTORY_EXPORT_DONE:
+        {
+            OnExportDone(hDlg);
+            return TRUE;
+        }
     }
 
     return FALSE;
@@ -315,6 +343,97 @@ void HistoryDialog::UpdateHistoryInfo(HWND hDlg)
     // No additional info section in current dialog resource.
 }
 
+void HistoryDialog::ExportHistoryToFile(HWND hDlg)
+{
+    // Filter order must match the format table below (nFilterIndex is 1-based)
+    static const wchar_t FILTER[] =
+        L"CSV (*.csv)\0*.csv\0"
+        L"NDJSON (*.ndjson)\0*.ndjson\0"
+        L"Columnar (*.nmhx)\0*.nmhx\0";
+    static const HistoryExportFormat FORMATS[] = {
+        HistoryExportFormat::Csv,
+        HistoryExportFormat::JsonLines,
+        HistoryExportFormat::Columnar
+    };
+
+    wchar_t fileName[MAX_PATH] = L"network_usage.csv";
+
+    OPENFILENAMEW ofn = {};
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = hDlg;
+    ofn.lpstrFilter = FILTER;
+    ofn.nFilterIndex = 1;
+    ofn.lpstrFile = fileName;
+    ofn.nMaxFile = MAX_PATH;
+    ofn.lpstrDefExt = L"csv";
+    ofn.Flags = OFN_OVERWRITEPROMPT | OFN_PATHMUSTEXIST | OFN_NOCHANGEDIR;
+
+    if (!GetSaveFileNameW(&ofn))
+    {
+        return;
+    }
+
+    HistoryExportFormat format = HistoryExportFormat::Csv;
+    if (ofn.nFilterIndex >= 1 && ofn.nFilterIndex <= std::size(FORMATS))
+    {
+        format = FORMATS[ofn.nFilterIndex - 1];
+    }
+
+    // Runs on a query thread; the button stays disabled until it is done
+    AsyncQueryOptions options;
+    options.slot = &m_exportSlot;
+    options.onComplete = [hDlg]() {
+        PostMessageW(hDlg, WM_HISTORY_EXPORT_DONE, 0, 0);
+    };
+
+    EnableWindow(GetDlgItem(hDlg, IDC_HISTORY_EXPORT), FALSE);
+    m_exportQuery = HistoryLogger::Instance().ExportHistoryAsync(fileName, format, 0, 0, std::wstring(), options);
+}
+
+void HistoryDialog::OnExportDone(HWND hDlg)
+{
+    if (!m_exportQuery.valid())
+    {
+        return;
+    }
+
+    AsyncQueryResult<unsigned long long> result = m_exportQuery.get();
+    EnableWindow(GetDlgItem(hDlg, IDC_HISTORY_EXPORT), TRUE);
+    if (result.cancelled)
+    {
+        return;
+    }
+
+    std::wstring title = LoadStringResource(IDS_HISTORY_MANAGE_TITLE);
+    if (title.empty())
+    {
+        title = L"Manage History";
+    }
+
+    bool dark = (m_pConfig && m_pConfig->darkTheme);
+    if (result.ok)
+    {
+        std::wstring fmt = LoadStringResource(IDS_HISTORY_EXPORT_DONE);
+        if (fmt.empty())
+        {
+            fmt = L"Exported %llu records.";
+        }
+
+        wchar_t message[256] = {0};
+        swprintf_s(message, fmt.c_str(), result.value);
+        ShowDarkMessageBox(hDlg, message, title, MB_OK | MB_ICONINFORMATION, dark);
+    }
+    else
+    {
+        std::wstring err = LoadStringResource(IDS_HISTORY_EXPORT_FAILED);
+        if (err.empty())
+        {
+            err = L"Failed to export history.";
+        }
+        ShowDarkMessageBox(hDlg, err, title, MB_OK | MB_ICONERROR, dark);
+    }
+}
+
 void HistoryDialog::CenterDialogOnScreen(HWND hDlg)
 {
     CenterWindowOnScreen(hDlg);
@@ -5,14 +5,17 @@
 // ============================================================================
 
 #include "NetworkMonitor/SettingsDialog.h"
+#include "NetworkMonitor/BillingCycle.h"
 #include "NetworkMonitor/ConfigManager.h"
 #include "NetworkMonitor/NetworkMonitor.h"
 #include "NetworkMonitor/Utils.h"
 #include "NetworkMonitor/ThemeHelper.h"
+#include "NetworkMonitor/Units.h"
 #include "../../../resources/resource.h"
 #include <windowsx.h>
 #include <commctrl.h>
 #include <uxtheme.h>
+#include <cwchar>
 #include <vector>
 
 namespace NetworkMonitor
@@ -230,6 +233,17 @@ INT_PTR CALLBACK SettingsDialog::InstanceDialogProc(HWND hDlg, UINT message, WPA
                     return TRUE;
                 }
 
+                case IDC_INTERFACE_COMBO:
+                {
+                    // The cap field edits the quota of the interface being monitored
+                    if (HIWORD(wParam) == CBN_SELCHANGE)
+                    {
+                        StoreQuotaEdit(hDlg);
+                        LoadQuotaEdit(hDlg);
+                    }
+                    break;
+                }
+
                 case IDOK:
                 {
                     if (ApplySettingsFromDialog(hDlg))
@@ -274,7 +288,8 @@ INT_PTR CALLBACK SettingsDialog::InstanceDialogProc(HWND hDlg, UINT message, WPA
                     (ctrlId == IDC_DISPLAY_UNIT_COMBO) ||
                     (ctrlId == IDC_INTERFACE_COMBO) ||
                     (ctrlId == IDC_HISTORY_AUTO_TRIM_COMBO) ||
-                    (ctrlId == IDC_THEME_MODE_COMBO);
+                    (ctrlId == IDC_THEME_MODE_COMBO) ||
+                    (ctrlId == IDC_BILLING_START_DAY_COMBO);
 
                 if (message == WM_CTLCOLORLISTBOX || message == WM_CTLCOLOREDIT || isComboArea)
                 {
@@ -706,6 +721,20 @@ void SettingsDialog::PopulateDialog(HWND hDlg)
         }
     }
 
+    // Populate billing cycle start day and the monitored interface's cap
+    HWND hStartDay = GetDlgItem(hDlg, IDC_BILLING_START_DAY_COMBO);
+    if (hStartDay)
+    {
+        for (int day = 1; day <= MAX_BILLING_CYCLE_START_DAY; ++day)
+        {
+            std::wstring label = std::to_wstring(day);
+            int index = static_cast<int>(SendMessageW(hStartDay, CB_ADDSTRING, 0, reinterpret_cast<LPARAM>(label.c_str())));
+            SendMessageW(hStartDay, CB_SETITEMDATA, index, day);
+        }
+        SendMessageW(hStartDay, CB_SETCURSEL, m_configCopy.billingCycleStartDay - 1, 0);
+    }
+    LoadQuotaEdit(hDlg);
+
     // For dark theme, disable visual styles for comboboxes so our
     // WM_CTLCOLOR* handlers can control background/text colors.
     if (m_configCopy.darkTheme)
@@ -718,6 +747,7 @@ void SettingsDialog::PopulateDialog(HWND hDlg)
         HWND hThemeModeCB = GetDlgItem(hDlg, IDC_THEME_MODE_COMBO);
         HWND hPingIntTheme = GetDlgItem(hDlg, IDC_PING_INTERVAL_COMBO);
         HWND hHotkeyTheme = GetDlgItem(hDlg, IDC_HOTKEY_COMBO);
+        HWND hStartDayTheme = GetDlgItem(hDlg, IDC_BILLING_START_DAY_COMBO);
 
         if (hLangTheme)    SetWindowTheme(hLangTheme,   L"", L"");
         if (hIntTheme)     SetWindowTheme(hIntTheme,    L"", L"");
@@ -727,6 +757,7 @@ void SettingsDialog::PopulateDialog(HWND hDlg)
         if (hThemeModeCB)  SetWindowTheme(hThemeModeCB, L"", L"");
         if (hPingIntTheme) SetWindowTheme(hPingIntTheme, L"", L"");
         if (hHotkeyTheme)  SetWindowTheme(hHotkeyTheme, L"", L"");
+        if (hStartDayTheme) SetWindowTheme(hStartDayTheme, L"", L"");
     }
 }
 
@@ -788,24 +819,7 @@ bool SettingsDialog::ApplySettingsFromDialog(HWND hDlg)
 
     // Get interface selection
     std::wstring newInterface = m_configCopy.selectedInterface;
-    HWND hInterface = GetDlgItem(hDlg, IDC_INTERFACE_COMBO);
-    if (hInterface)
-    {
-        int sel = static_cast<int>(SendMessageW(hInterface, CB_GETCURSEL, 0, 0));
-        if (sel != CB_ERR)
-        {
-            wchar_t buffer[256] = {0};
-            SendMessageW(hInterface, CB_GETLBTEXT, sel, reinterpret_cast<LPARAM>(buffer));
-            if (sel == 0)
-            {
-                newInterface.clear();
-            }
-            else
-            {
-                newInterface = buffer;
-            }
-        }
-    }
+    GetComboInterface(hDlg, newInterface);
 
     // Get history auto-trim selection
     int newTrimDays = m_configCopy.historyAutoTrimDays;
@@ -887,6 +901,23 @@ bool SettingsDialog::ApplySettingsFromDialog(HWND hDlg)
         }
     }
 
+    // Get billing cycle start day; the cap is kept in m_configCopy as edited
+    int newStartDay = m_configCopy.billingCycleStartDay;
+    HWND hStartDay = GetDlgItem(hDlg, IDC_BILLING_START_DAY_COMBO);
+    if (hStartDay)
+    {
+        int sel = static_cast<int>(SendMessageW(hStartDay, CB_GETCURSEL, 0, 0));
+        if (sel != CB_ERR)
+        {
+            LRESULT data = SendMessageW(hStartDay, CB_GETITEMDATA, sel, 0);
+            if (data != CB_ERR)
+            {
+                newStartDay = static_cast<int>(data);
+            }
+        }
+    }
+    StoreQuotaEdit(hDlg);
+
     // Update working copy
     m_configCopy.updateInterval = newInterval;
     m_configCopy.displayUnit = newUnit;
@@ -903,6 +934,7 @@ bool SettingsDialog::ApplySettingsFromDialog(HWND hDlg)
     m_configCopy.pingIntervalMs = newPingInterval;
     m_configCopy.hotkeyModifier = newHotkeyModifier;
     m_configCopy.hotkeyKey = newHotkeyKey;
+    m_configCopy.billingCycleStartDay = newStartDay;
 
     // Save to registry via ConfigManager (ignore errors for now, like main.cpp)
     if (m_pConfigManager)
@@ -974,6 +1006,71 @@ void SettingsDialog::PopulateInterfaceCombo(HWND hDlg)
     }
 }
 
+bool SettingsDialog::GetComboInterface(HWND hDlg, std::wstring& interfaceName) const
+{
+    HWND hInterface = GetDlgItem(hDlg, IDC_INTERFACE_COMBO);
+    if (!hInterface)
+    {
+        return false;
+    }
+
+    int sel = static_cast<int>(SendMessageW(hInterface, CB_GETCURSEL, 0, 0));
+    if (sel == CB_ERR)
+    {
+        return false;
+    }
+
+    // Index 0 is "All Interfaces"
+    wchar_t buffer[256] = {0};
+    SendMessageW(hInterface, CB_GETLBTEXT, sel, reinterpret_cast<LPARAM>(buffer));
+    interfaceName = (sel == 0) ? std::wstring() : std::wstring(buffer);
+    return true;
+}
+
+void SettingsDialog::LoadQuotaEdit(HWND hDlg)
+{
+    m_quotaInterface = m_configCopy.selectedInterface;
+    GetComboInterface(hDlg, m_quotaInterface);
+
+    HWND hQuota = GetDlgItem(hDlg, IDC_BILLING_QUOTA_EDIT);
+    if (!hQuota)
+    {
+        return;
+    }
+
+    // Shown in GB of 1024^3 bytes, the unit FormatBytes uses
+    wchar_t buffer[64] = {0};
+    unsigned long long quota = GetBillingQuota(m_configCopy, m_quotaInterface);
+    if (quota > 0)
+    {
+        swprintf_s(buffer, L"%g", UnitCast<Gibibytes>(DataSize<Bytes>(static_cast<double>(quota))).Count());
+    }
+    SetWindowTextW(hQuota, buffer);
+}
+
+void SettingsDialog::StoreQuotaEdit(HWND hDlg)
+{
+    HWND hQuota = GetDlgItem(hDlg, IDC_BILLING_QUOTA_EDIT);
+    if (!hQuota)
+    {
+        return;
+    }
+
+    wchar_t buffer[64] = {0};
+    GetWindowTextW(hQuota, buffer, 64);
+    double gigabytes = wcstod(buffer, nullptr);
+
+    if (gigabytes > 0.0)
+    {
+        m_configCopy.billingQuotas[m_quotaInterface] =
+            static_cast<unsigned long long>(UnitCast<Bytes>(DataSize<Gibibytes>(gigabytes)).Count() + 0.5);
+    }
+    else
+    {
+        m_configCopy.billingQuotas.erase(m_quotaInterface);
+    }
+}
+
 void SettingsDialog::CenterDialogOnScreen(HWND hDlg)
 {
     CenterWindowOnScreen(hDlg);
@@ -1,6 +1,41 @@
 #include "TestUtils.h"
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/LocalCalendar.h"
+#include "sqlite3.h"
 
 #include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <cwchar>
+#include <new>
+
+namespace
+{
+    // Allocations made by the current thread, through the replaced
+    // operator new below
+    thread_local unsigned long long t_allocations = 0;
+}
+
+void* operator new(std::size_t size)
+{
+    ++t_allocations;
+    void* block = std::malloc(size ? size : 1);
+    if (!block)
+    {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+void operator delete(void* block) noexcept
+{
+    std::free(block);
+}
+
+void operator delete(void* block, std::size_t) noexcept
+{
+    std::free(block);
+}
 
 namespace NetworkMonitorTests
 {
@@ -10,6 +45,11 @@ namespace
     int g_failures = 0;
 }
 
+unsigned long long GetThreadAllocationCount()
+{
+    return t_allocations;
+}
+
 void LogTestMessage(const wchar_t* message)
 {
     if (!message)
@@ -57,4 +97,95 @@ void ResetFailureCount()
     g_failures = 0;
 }
 
+bool BenchmarksEnabled()
+{
+    wchar_t value[8] = {0};
+    DWORD len = GetEnvironmentVariableW(L"NETWORKMONITOR_BENCHMARKS", value, 8);
+    return len > 0 && len < 8 && std::wcscmp(value, L"0") != 0;
+}
+
+std::wstring TempFilePath(const wchar_t* name)
+{
+    wchar_t dir[MAX_PATH] = {0};
+    DWORD len = GetTempPathW(MAX_PATH, dir);
+    std::wstring path = (len > 0) ? std::wstring(dir, len) : std::wstring();
+    path += name;
+    return path;
+}
+
+std::wstring DatabasePath()
+{
+    wchar_t exePath[MAX_PATH] = {0};
+    GetModuleFileNameW(nullptr, exePath, MAX_PATH);
+    wchar_t* lastSlash = wcsrchr(exePath, L'\\');
+    if (lastSlash)
+    {
+        *lastSlash = L'\0';
+    }
+    return std::wstring(exePath) + L"\\network_usage.db";
+}
+
+bool FileExists(const std::wstring& path)
+{
+    return GetFileAttributesW(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+}
+
+unsigned long long FileSize(const std::wstring& path)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data = {};
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data))
+    {
+        return 0;
+    }
+    return (static_cast<unsigned long long>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+}
+
+long long QueryDatabase(const std::wstring& path, const char* sql)
+{
+    sqlite3* db = nullptr;
+    long long value = -1;
+    if (sqlite3_open16(path.c_str(), &db) == SQLITE_OK)
+    {
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK)
+        {
+            if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+            {
+                value = sqlite3_column_int64(stmt, 0);
+            }
+            sqlite3_finalize(stmt);
+        }
+    }
+    sqlite3_close(db);
+    return value;
+}
+
+long long QueryDatabase(const char* sql)
+{
+    return QueryDatabase(DatabasePath(), sql);
+}
+
+ScopedTimeZone::ScopedTimeZone(const char* tz)
+    : m_hadPrevious(false)
+{
+    char* previous = nullptr;
+    size_t length = 0;
+    if (_dupenv_s(&previous, &length, "TZ") == 0 && previous)
+    {
+        m_previous = previous;
+        m_hadPrevious = true;
+        free(previous);
+    }
+    _putenv_s("TZ", tz);
+    _tzset();
+    NetworkMonitor::LocalCalendar::Reset();
+}
+
+ScopedTimeZone::~ScopedTimeZone()
+{
+    _putenv_s("TZ", m_hadPrevious ? m_previous.c_str() : "");
+    _tzset();
+    NetworkMonitor::LocalCalendar::Reset();
+}
+
 } // namespace NetworkMonitorTests
@@ -10,4 +10,43 @@ void AssertTrue(bool condition, const wchar_t* testName);
 int GetFailureCount();
 void ResetFailureCount();
 
+// Heap allocations the calling thread has made so far (operator new is
+// replaced in the test build to count them)
+unsigned long long GetThreadAllocationCount();
+
+// Heavy benchmarks (million-row exports and imports, month-long scans,
+// large backups) run only when NETWORKMONITOR_BENCHMARKS is set to a
+// non-zero value. Timing figures are logged as [bench] lines, never asserted.
+bool BenchmarksEnabled();
+
+// Path of name inside the user's temp directory
+std::wstring TempFilePath(const wchar_t* name);
+
+// network_usage.db next to the test executable, where HistoryLogger keeps it
+std::wstring DatabasePath();
+
+bool FileExists(const std::wstring& path);
+unsigned long long FileSize(const std::wstring& path);
+
+// Integer result of a query on a separate connection to the database at
+// path (DatabasePath() by default), or -1 on error, no row or NULL
+long long QueryDatabase(const std::wstring& path, const char* sql);
+long long QueryDatabase(const char* sql);
+
+// Sets the TZ environment variable for the lifetime of the object and
+// drops the shared LocalCalendar so lookups follow the new zone.
+class ScopedTimeZone
+{
+public:
+    explicit ScopedTimeZone(const char* tz);
+    ~ScopedTimeZone();
+
+    ScopedTimeZone(const ScopedTimeZone&) = delete;
+    ScopedTimeZone& operator=(const ScopedTimeZone&) = delete;
+
+private:
+    std::string m_previous;
+    bool m_hadPrevious;
+};
+
 } // namespace NetworkMonitorTests
@@ -0,0 +1,412 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/Utils.h"
+#include "NetworkMonitor/HistoryLogger.h"
+#include "NetworkMonitor/HistoryExport.h"
+#include "NetworkMonitor/HistoryStatistics.h"
+#include "NetworkMonitor/LocalCalendar.h"
+#include "TestUtils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    const std::wstring ASYNC_IFACES[] = { L"Ethernet", L"Wi-Fi" };
+
+    // One row per second per interface for the `seconds` before now; returns
+    // the end of the imported range
+    std::time_t ImportRecentRows(unsigned long long seconds)
+    {
+        std::time_t now = std::time(nullptr);
+        HistoryImportOptions options;
+        options.progressInterval = 0;
+        HistoryLogger::Instance().ImportSamples([now, seconds](const HistorySampleVisitor& sink) {
+            HistorySampleView row = {};
+            for (unsigned long long i = 0; i < seconds; ++i)
+            {
+                for (int k = 0; k < 2; ++k)
+                {
+                    row.timestamp = now - static_cast<std::time_t>(seconds - i);
+                    row.interfaceName = ASYNC_IFACES[k];
+                    row.bytesDown = (1000 + (i * 7919ULL) % 5000) >> k;
+                    row.bytesUp = (10 + i % 97) >> k;
+                    if (!sink(row))
+                    {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }, options);
+        return now;
+    }
+
+    template <typename T>
+    bool Succeeded(std::future<AsyncQueryResult<T>>& future, T& value)
+    {
+        AsyncQueryResult<T> result = future.get();
+        value = std::move(result.value);
+        return result.ok && !result.cancelled;
+    }
+
+    double Milliseconds(std::chrono::steady_clock::time_point since)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+    }
+
+    void RunEquivalenceChecks(std::time_t from, std::time_t to)
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        const std::wstring all;
+
+        UsageTotals asyncTotals;
+        unsigned long long down = 0;
+        unsigned long long up = 0;
+        auto today = logger.GetTotalsTodayAsync(ASYNC_IFACES[0]);
+        AssertTrue(Succeeded(today, asyncTotals) && logger.GetTotalsToday(down, up, &ASYNC_IFACES[0]) &&
+                   asyncTotals.bytesDown == down && asyncTotals.bytesUp == up,
+                   L"HistoryLogger.GetTotalsTodayAsync matches GetTotalsToday");
+
+        auto month = logger.GetTotalsThisMonthAsync(all);
+        AssertTrue(Succeeded(month, asyncTotals) && logger.GetTotalsThisMonth(down, up) &&
+                   asyncTotals.bytesDown == down && asyncTotals.bytesUp == up && down > 0,
+                   L"HistoryLogger.GetTotalsThisMonthAsync matches GetTotalsThisMonth");
+
+        std::vector<HistorySample> asyncSamples;
+        std::vector<HistorySample> samples;
+        auto recent = logger.GetRecentSamplesAsync(50, ASYNC_IFACES[1], false);
+        AssertTrue(Succeeded(recent, asyncSamples) && logger.GetRecentSamples(50, samples, &ASYNC_IFACES[1]) &&
+                   asyncSamples.size() == 50 && samples.size() == 50 &&
+                   asyncSamples.front().timestamp == samples.front().timestamp &&
+                   asyncSamples.back().bytesDown == samples.back().bytesDown,
+                   L"HistoryLogger.GetRecentSamplesAsync matches GetRecentSamples");
+
+        // The filter and cursor are copied: the originals go out of scope
+        // before the query runs
+        HistoryCursor last;
+        unsigned long long rows = 0;
+        std::future<AsyncQueryResult<HistoryCursor>> scan;
+        {
+            std::wstring filter = ASYNC_IFACES[0];
+            HistoryCursor after;
+            after.timestamp = from;
+            HistoryQuery query;
+            query.interfaceFilter = &filter;
+            query.after = &after;
+            query.to = to;
+            scan = logger.ForEachSampleAsync(query, [&rows](const HistorySampleView& row) {
+                ++rows;
+                return row.interfaceName == ASYNC_IFACES[0];
+            });
+        }
+        AssertTrue(Succeeded(scan, last) && rows == static_cast<unsigned long long>(to - from) &&
+                   last.timestamp == to - 1,
+                   L"HistoryLogger.ForEachSampleAsync visits every row with copied filter and cursor");
+
+        std::wstring path = TempFilePath(L"nm_async_export.tmp");
+        unsigned long long exported = 0;
+        auto exportQuery = logger.ExportHistoryAsync(path, HistoryExportFormat::Csv, from, to, ASYNC_IFACES[1]);
+        AssertTrue(Succeeded(exportQuery, exported) && exported == static_cast<unsigned long long>(to - from),
+                   L"HistoryLogger.ExportHistoryAsync reports the rows written");
+        DeleteFileW(path.c_str());
+
+        RateQuery rateQuery;
+        rateQuery.from = from - from % 60;
+        rateQuery.to = to;
+        std::vector<InterfaceRateStatistics> asyncRates;
+        std::vector<InterfaceRateStatistics> rates;
+        auto rateFuture = logger.GetRateStatisticsAsync(rateQuery);
+        AssertTrue(Succeeded(rateFuture, asyncRates) && logger.GetRateStatistics(rateQuery, rates) &&
+                   asyncRates.size() == 2 && rates.size() == 2 &&
+                   asyncRates[0].down.p95 == rates[0].down.p95 && asyncRates[1].up.max == rates[1].up.max,
+                   L"HistoryLogger.GetRateStatisticsAsync matches GetRateStatistics");
+
+        TopKQuery topQuery;
+        topQuery.from = from;
+        topQuery.to = to;
+        topQuery.k = 5;
+        std::vector<RankedInterval> asyncIntervals;
+        std::vector<RankedInterval> intervals;
+        auto topFuture = logger.GetTopIntervalsAsync(topQuery);
+        AssertTrue(Succeeded(topFuture, asyncIntervals) && logger.GetTopIntervals(topQuery, intervals) &&
+                   asyncIntervals.size() == 5 && asyncIntervals[0].start == intervals[0].start &&
+                   asyncIntervals[4].bytesDown == intervals[4].bytesDown,
+                   L"HistoryLogger.GetTopIntervalsAsync matches GetTopIntervals");
+
+        std::vector<RankedInterface> asyncInterfaces;
+        auto ifaceFuture = logger.GetTopInterfacesAsync(topQuery);
+        AssertTrue(Succeeded(ifaceFuture, asyncInterfaces) && asyncInterfaces.size() == 2 &&
+                   asyncInterfaces[0].interfaceName == ASYNC_IFACES[0],
+                   L"HistoryLogger.GetTopInterfacesAsync ranks the busier interface first");
+
+        std::vector<CalendarTotal> asyncDays;
+        std::vector<CalendarTotal> days;
+        auto dayFuture = logger.GetCalendarTotalsAsync(CalendarUnit::Day, from, to, all);
+        AssertTrue(Succeeded(dayFuture, asyncDays) &&
+                   logger.GetCalendarTotals(CalendarUnit::Day, from, to, nullptr, days) &&
+                   !days.empty() && asyncDays.size() == days.size() &&
+                   asyncDays.back().bytesDown == days.back().bytesDown,
+                   L"HistoryLogger.GetCalendarTotalsAsync matches GetCalendarTotals");
+
+        BillingStatus asyncStatus;
+        BillingStatus status;
+        auto billing = logger.GetBillingStatusAsync(all, 0);
+        AssertTrue(Succeeded(billing, asyncStatus) && logger.GetBillingStatus(nullptr, 0, status) &&
+                   asyncStatus.bytesDown == status.bytesDown && asyncStatus.period.start == status.period.start,
+                   L"HistoryLogger.GetBillingStatusAsync matches GetBillingStatus");
+
+        // A sample queued just before the query is part of its result
+        logger.GetTotalsToday(down, up, &ASYNC_IFACES[1]);
+        logger.AppendSample(ASYNC_IFACES[1], 123456, 0);
+        auto afterWrite = logger.GetTotalsTodayAsync(ASYNC_IFACES[1]);
+        AssertTrue(Succeeded(afterWrite, asyncTotals) && asyncTotals.bytesDown == down + 123456,
+                   L"HistoryLogger async queries see the caller's queued samples");
+
+        bool notified = false;
+        std::promise<void> done;
+        AsyncQueryOptions options;
+        options.onComplete = [&notified, &done]() {
+            notified = true;
+            done.set_value();
+        };
+        auto withCallback = logger.GetTotalsTodayAsync(all, options);
+        done.get_future().wait();
+        AssertTrue(notified && withCallback.wait_for(std::chrono::seconds(0)) == std::future_status::ready,
+                   L"AsyncQueryOptions.onComplete fires once the future is ready");
+    }
+
+    // Keep every query thread busy in a visitor until released
+    class QueryThreadBlocker
+    {
+    public:
+        QueryThreadBlocker()
+            : m_started(0)
+            , m_release(false)
+        {
+            for (int i = 0; i < HISTORY_QUERY_THREADS; ++i)
+            {
+                m_futures.push_back(HistoryLogger::Instance().ForEachSampleAsync(HistoryQuery(),
+                    [this](const HistorySampleView&) {
+                        ++m_started;
+                        while (!m_release.load())
+                        {
+                            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                        }
+                        return false;
+                    }));
+            }
+            while (m_started.load() < HISTORY_QUERY_THREADS)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        ~QueryThreadBlocker()
+        {
+            Release();
+        }
+
+        void Release()
+        {
+            m_release.store(true);
+            for (auto& future : m_futures)
+            {
+                if (future.valid())
+                {
+                    future.wait();
+                }
+            }
+        }
+
+    private:
+        std::atomic<int> m_started;
+        std::atomic<bool> m_release;
+        std::vector<std::future<AsyncQueryResult<HistoryCursor>>> m_futures;
+    };
+
+    void RunCancellationChecks(std::time_t scanFrom, std::time_t to)
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+
+        // Superseded while still queued: never touches SQLite
+        {
+            QuerySlot slot;
+            AsyncQueryOptions options;
+            options.slot = &slot;
+
+            std::atomic<int> firstRows(0);
+            std::future<AsyncQueryResult<HistoryCursor>> first;
+            std::future<AsyncQueryResult<UsageTotals>> second;
+            {
+                QueryThreadBlocker blocker;
+                first = logger.ForEachSampleAsync(HistoryQuery(), [&firstRows](const HistorySampleView&) {
+                    ++firstRows;
+                    return true;
+                }, options);
+                second = logger.GetTotalsTodayAsync(std::wstring(), options);
+            }
+
+            AsyncQueryResult<HistoryCursor> firstResult = first.get();
+            AsyncQueryResult<UsageTotals> secondResult = second.get();
+            AssertTrue(firstResult.cancelled && !firstResult.ok && firstRows.load() == 0,
+                       L"QuerySlot: a superseded queued query is dropped unrun");
+            AssertTrue(secondResult.ok && !secondResult.cancelled && secondResult.value.bytesDown > 0,
+                       L"QuerySlot: the newest query runs");
+        }
+
+        // Cancelled while running: the statement is interrupted
+        {
+            TopKQuery query;
+            query.from = scanFrom + 1;   // unaligned: a long scan of raw rows
+            query.to = to;
+            query.bucketSeconds = 1;
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<RankedInterval> top;
+            logger.GetTopIntervals(query, top);
+            double fullMs = Milliseconds(start);
+
+            QuerySlot slot;
+            AsyncQueryOptions options;
+            options.slot = &slot;
+            start = std::chrono::steady_clock::now();
+            auto running = logger.GetTopIntervalsAsync(query, options);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            slot.Cancel();
+            AsyncQueryResult<std::vector<RankedInterval>> result = running.get();
+            double cancelledMs = Milliseconds(start);
+
+            AssertTrue(result.cancelled && !result.ok, L"QuerySlot.Cancel stops a running scan");
+
+            std::wstring msg = L"[bench] raw 1-second top-K scan: " +
+                               std::to_wstring(static_cast<unsigned long long>(fullMs)) +
+                               L" ms to finish, " +
+                               std::to_wstring(static_cast<unsigned long long>(cancelledMs)) +
+                               L" ms when cancelled after 5 ms";
+            LogTestMessage(msg.c_str());
+        }
+    }
+
+    // A query that throws or asks for too much memory fails cleanly, and the
+    // query threads keep serving afterwards
+    void RunFailureChecks(std::time_t from, std::time_t to)
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+
+        HistoryQuery query;
+        query.from = from;
+        query.to = to;
+        auto throwing = logger.ForEachSampleAsync(query, [](const HistorySampleView&) -> bool {
+            throw std::runtime_error("visitor failure");
+        });
+        AsyncQueryResult<HistoryCursor> thrown = throwing.get();
+        AssertTrue(!thrown.ok && !thrown.cancelled, L"HistoryLogger.ForEachSampleAsync reports a throwing visitor as failed");
+
+        RateQuery rateQuery;
+        rateQuery.from = to - 366 * 86400;
+        rateQuery.to = to;
+        rateQuery.bucketSeconds = 1;
+        auto huge = logger.GetRateStatisticsAsync(rateQuery);
+        AsyncQueryResult<std::vector<InterfaceRateStatistics>> hugeResult = huge.get();
+        AssertTrue(!hugeResult.ok && hugeResult.value.empty(),
+                   L"HistoryLogger.GetRateStatisticsAsync refuses a year of 1-second buckets");
+
+        // The reader the visitor threw on goes back to the pool; it must
+        // not keep serving the view it had open
+        UsageTotals before;
+        auto first = logger.GetTotalsTodayAsync(std::wstring());
+        bool readBefore = Succeeded(first, before);
+        logger.AppendSample(ASYNC_IFACES[0], 1234ULL, 0ULL);
+        logger.Flush();
+        UsageTotals after;
+        auto second = logger.GetTotalsTodayAsync(std::wstring());
+        AssertTrue(readBefore && Succeeded(second, after) && after.bytesDown == before.bytesDown + 1234,
+                   L"Query threads read live data after a failed query");
+    }
+
+    // Caller-thread cost of submitting queries while the query threads are
+    // busy, against one synchronous call
+    void RunCallerLatencyBenchmark(std::time_t from, std::time_t to)
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        const int submissions = 10000;
+
+        RateQuery rateQuery;
+        rateQuery.from = from + 1;   // raw rows: the slowest path
+        rateQuery.to = to;
+        auto start = std::chrono::steady_clock::now();
+        std::vector<InterfaceRateStatistics> stats;
+        logger.GetRateStatistics(rateQuery, stats);
+        double syncMs = Milliseconds(start);
+
+        QuerySlot slot;
+        AsyncQueryOptions options;
+        options.slot = &slot;
+        std::vector<double> micros;
+        micros.reserve(submissions);
+        std::future<AsyncQueryResult<std::vector<InterfaceRateStatistics>>> last;
+
+        {
+            QueryThreadBlocker blocker;
+            for (int i = 0; i < submissions; ++i)
+            {
+                auto callStart = std::chrono::steady_clock::now();
+                last = logger.GetRateStatisticsAsync(rateQuery, options);
+                micros.push_back(std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - callStart).count());
+            }
+        }
+
+        AsyncQueryResult<std::vector<InterfaceRateStatistics>> result = last.get();
+        AssertTrue(result.ok && result.value.size() == 2,
+                   L"HistoryLogger: the last of many superseding submissions completes");
+
+        std::sort(micros.begin(), micros.end());
+        double median = micros[micros.size() / 2];
+        double p99 = micros[micros.size() * 99 / 100];
+
+        wchar_t msg[256] = {0};
+        swprintf(msg, 256,
+                 L"[bench] async submit while query threads are busy (%d calls): median %.1f us, p99 %.1f us, "
+                 L"max %.1f us; synchronous raw-row statistics %.0f ms",
+                 submissions, median, p99, micros.back(), syncMs);
+        LogTestMessage(msg);
+    }
+}
+
+void RunAsyncQueryTests()
+{
+    LogTestMessage(L"=== Async query tests ===");
+
+    HistoryLogger& logger = HistoryLogger::Instance();
+    AssertTrue(logger.DeleteAll(), L"HistoryLogger.DeleteAll before async query tests");
+
+    // 1-second rows on two interfaces (1M rows) so the interrupted scan
+    // runs long enough to cancel; result checks use the last six hours
+    const unsigned long long seconds = 500000ULL;
+    std::time_t to = ImportRecentRows(seconds);
+    std::time_t scanFrom = to - static_cast<std::time_t>(seconds);
+    std::time_t from = to - 6 * 3600;
+
+    RunEquivalenceChecks(from, to);
+    RunCancellationChecks(scanFrom, to);
+    RunFailureChecks(from, to);
+    RunCallerLatencyBenchmark(from, to);
+
+    logger.DeleteAll();
+}
+
+} // namespace NetworkMonitorTests
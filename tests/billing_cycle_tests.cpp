@@ -0,0 +1,302 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/Utils.h"
+#include "NetworkMonitor/HistoryLogger.h"
+#include "NetworkMonitor/BillingCycle.h"
+#include "TestUtils.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    const std::wstring BILLING_IFACES[] = { L"Ethernet", L"LTE" };
+
+    // Switch the CRT time zone for the lifetime of the object
+    std::time_t Local(int year, int month, int day, int hour = 0)
+    {
+        std::tm local = {};
+        local.tm_year = year - 1900;
+        local.tm_mon = month - 1;
+        local.tm_mday = day;
+        local.tm_hour = hour;
+        local.tm_isdst = -1;
+        return std::mktime(&local);
+    }
+
+    bool PeriodIs(std::time_t t, int startDay, std::time_t start, std::time_t end)
+    {
+        BillingPeriod period;
+        return GetBillingPeriod(t, startDay, period) && period.start == start && period.end == end;
+    }
+
+    void RunPeriodChecks()
+    {
+        // US Eastern: DST from the second Sunday of March to the first of November
+        ScopedTimeZone zone("EST5EDT");
+        const std::time_t DAY = 24 * 60 * 60;
+
+        std::time_t jan15 = Local(2025, 1, 15);
+        AssertTrue(PeriodIs(jan15, 15, jan15, Local(2025, 2, 15)),
+                   L"GetBillingPeriod: a cycle starts exactly at local midnight on the start day");
+        AssertTrue(PeriodIs(jan15 - 1, 15, Local(2024, 12, 15), jan15),
+                   L"GetBillingPeriod: the second before belongs to the previous cycle (across the year)");
+        AssertTrue(PeriodIs(Local(2025, 1, 5), 20, Local(2024, 12, 20), Local(2025, 1, 20)),
+                   L"GetBillingPeriod: early January falls in December's cycle");
+
+        BillingPeriod period;
+        GetBillingPeriod(Local(2024, 3, 15, 12), 1, period);
+        AssertTrue(period.start == Local(2024, 3, 1) && period.end - period.start == 31 * DAY - 3600,
+                   L"GetBillingPeriod: a cycle containing the spring DST change is an hour short");
+
+        GetBillingPeriod(Local(2024, 11, 10), 1, period);
+        AssertTrue(period.start == Local(2024, 11, 1) && period.end - period.start == 30 * DAY + 3600,
+                   L"GetBillingPeriod: a cycle containing the autumn DST change is an hour long");
+
+        GetBillingPeriod(Local(2024, 3, 10, 12), 10, period);
+        AssertTrue(period.start == Local(2024, 3, 10) && period.end == Local(2024, 4, 10),
+                   L"GetBillingPeriod: a cycle starting on the DST change day starts at midnight");
+
+        // Start days past the end of February
+        AssertTrue(PeriodIs(Local(2024, 2, 15), 31, Local(2024, 1, 31), Local(2024, 2, 29)),
+                   L"GetBillingPeriod: a 31st start day moves to 29 February in a leap year");
+        AssertTrue(PeriodIs(Local(2024, 2, 29, 12), 31, Local(2024, 2, 29), Local(2024, 3, 31)),
+                   L"GetBillingPeriod: the leap-day cycle runs to 31 March");
+        AssertTrue(PeriodIs(Local(2023, 2, 28, 12), 31, Local(2023, 2, 28), Local(2023, 3, 31)),
+                   L"GetBillingPeriod: a 31st start day moves to 28 February in a common year");
+        AssertTrue(PeriodIs(Local(2023, 3, 1), 29, Local(2023, 2, 28), Local(2023, 3, 29)),
+                   L"GetBillingPeriod: a 29th start day moves to 28 February in a common year");
+        AssertTrue(PeriodIs(Local(2100, 2, 28, 12), 29, Local(2100, 2, 28), Local(2100, 3, 29)),
+                   L"GetBillingPeriod: 2100 is not a leap year");
+
+        // Out-of-range start days are clamped
+        AssertTrue(PeriodIs(Local(2025, 6, 10), 0, Local(2025, 6, 1), Local(2025, 7, 1)) &&
+                   PeriodIs(Local(2025, 6, 10), 40, Local(2025, 5, 31), Local(2025, 6, 30)),
+                   L"GetBillingPeriod: start day is clamped to 1..31");
+
+        // The cache agrees with direct lookups over two years of hours,
+        // through both DST changes and a leap day
+        BillingCycleCache cache(31);
+        bool cacheMatches = true;
+        for (std::time_t t = Local(2023, 12, 1); t < Local(2025, 12, 1) && cacheMatches; t += 3599)
+        {
+            cacheMatches = GetBillingPeriod(t, 31, period) && cache.CycleStart(t) == period.start;
+        }
+        AssertTrue(cacheMatches, L"BillingCycleCache.CycleStart matches GetBillingPeriod");
+
+        cache.SetStartDay(15);
+        AssertTrue(cache.CycleStart(Local(2025, 1, 20)) == jan15,
+                   L"BillingCycleCache.SetStartDay drops the cached cycle");
+    }
+
+    void RunProjectionChecks()
+    {
+        const double GB = 1024.0 * 1024.0 * 1024.0;
+        const std::time_t DAY = 24 * 60 * 60;
+
+        {
+            ScopedTimeZone zone("UTC0");
+            std::time_t start = Local(2025, 4, 1);
+
+            BillingStatus status;
+            status.period.start = start;
+            status.period.end = start + 30 * DAY;
+            status.asOf = start + 10 * DAY;
+            status.bytesDown = static_cast<unsigned long long>(8 * GB);
+            status.bytesUp = static_cast<unsigned long long>(2 * GB);
+            status.quotaBytes = static_cast<unsigned long long>(20 * GB);
+
+            ProjectBillingUsage(status, nullptr);
+            AssertTrue(status.projectedLinear == static_cast<unsigned long long>(30 * GB) &&
+                       status.capReachedLinear == start + 20 * DAY,
+                       L"ProjectBillingUsage: linear projection extends the average rate");
+            AssertTrue(status.projectedWeighted == status.projectedLinear &&
+                       status.capReachedWeighted == status.capReachedLinear,
+                       L"ProjectBillingUsage: without a profile the weighted projection is the linear one");
+
+            // A flat profile at the same average rate agrees with linear
+            double flat[BILLING_PROFILE_HOURS];
+            for (double& bytes : flat)
+            {
+                bytes = GB / 24.0;
+            }
+            ProjectBillingUsage(status, flat);
+            AssertTrue(std::llabs(static_cast<long long>(status.projectedWeighted - status.projectedLinear)) < 1024 &&
+                       std::llabs(static_cast<long long>(status.capReachedWeighted - status.capReachedLinear)) <= 1,
+                       L"ProjectBillingUsage: a flat profile matches the linear projection");
+
+            // All traffic at 20:00-21:00: the cap falls inside that hour
+            double evening[BILLING_PROFILE_HOURS] = {};
+            evening[20] = 3 * GB;
+            status.quotaBytes = static_cast<unsigned long long>(14 * GB);
+            ProjectBillingUsage(status, evening);
+            AssertTrue(status.capReachedWeighted == status.asOf + DAY + 20 * 3600 + 1200 &&
+                       status.projectedWeighted == static_cast<unsigned long long>(70 * GB),
+                       L"ProjectBillingUsage: time-of-day profile places the cap in the busy hour");
+
+            status.quotaBytes = static_cast<unsigned long long>(5 * GB);
+            ProjectBillingUsage(status, evening);
+            AssertTrue(status.capReachedLinear == status.asOf && status.capReachedWeighted == status.asOf,
+                       L"ProjectBillingUsage: a used-up quota is reported as reached now");
+
+            status.quotaBytes = 0;
+            ProjectBillingUsage(status, evening);
+            AssertTrue(status.capReachedLinear == 0 && status.capReachedWeighted == 0,
+                       L"ProjectBillingUsage: no cap date without a quota");
+        }
+
+        {
+            // One byte per second in every hour: the hour walk must cover the
+            // remaining seconds exactly, even on the 23-hour DST day
+            ScopedTimeZone zone("EST5EDT");
+            BillingStatus status;
+            GetBillingPeriod(Local(2024, 3, 5), 1, status.period);
+            status.asOf = Local(2024, 3, 5, 13) + 17 * 60 + 5;
+
+            double perSecond[BILLING_PROFILE_HOURS];
+            for (double& bytes : perSecond)
+            {
+                bytes = 3600.0;
+            }
+            ProjectBillingUsage(status, perSecond);
+            long long expected = static_cast<long long>(status.period.end - status.asOf);
+            AssertTrue(std::llabs(static_cast<long long>(status.projectedWeighted) - expected) <= 1,
+                       L"ProjectBillingUsage: hourly walk across a DST change covers every second once");
+        }
+    }
+
+    // Rows every 10 minutes in [from, to), alternating interfaces
+    HistorySampleProducer BillingRows(std::time_t from, std::time_t to)
+    {
+        return [from, to](const HistorySampleVisitor& sink) {
+            HistorySampleView row = {};
+            unsigned long long i = 0;
+            for (std::time_t t = from; t < to; t += 600, ++i)
+            {
+                row.timestamp = t;
+                row.interfaceName = BILLING_IFACES[i % 2];
+                row.bytesDown = 1000 + i;
+                row.bytesUp = 10 + (i % 7);
+                if (!sink(row))
+                {
+                    return false;
+                }
+            }
+            return true;
+        };
+    }
+
+    // Brute-force cycle totals straight from the raw rows
+    void SumSince(std::time_t from, const std::wstring* filter,
+                  unsigned long long& down, unsigned long long& up)
+    {
+        down = 0;
+        up = 0;
+        HistoryQuery query;
+        query.from = from;
+        query.interfaceFilter = filter;
+        HistoryLogger::Instance().ForEachSample(query, [&](const HistorySampleView& row) {
+            down += row.bytesDown;
+            up += row.bytesUp;
+            return true;
+        });
+    }
+
+    bool StatusMatches(const std::wstring* filter, unsigned long long quota, BillingStatus& status)
+    {
+        unsigned long long down = 0;
+        unsigned long long up = 0;
+        bool ok = HistoryLogger::Instance().GetBillingStatus(filter, quota, status);
+        SumSince(status.period.start, filter, down, up);
+        return ok && status.bytesDown == down && status.bytesUp == up && (down + up) > 0;
+    }
+
+    void RunIncrementalTotalsChecks()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        AssertTrue(logger.DeleteAll(), L"HistoryLogger.DeleteAll before billing tests");
+
+        // A cycle that started at today's local midnight
+        std::time_t now = std::time(nullptr);
+        std::tm today = {};
+        localtime_s(&today, &now);
+        AssertTrue(logger.SetBillingCycleStartDay(today.tm_mday) &&
+                   logger.GetBillingCycleStartDay() == today.tm_mday,
+                   L"HistoryLogger.SetBillingCycleStartDay stores the day");
+
+        BillingPeriod cycle;
+        GetBillingPeriod(now, today.tm_mday, cycle);
+
+        // Backfill starting in the previous cycle: only the current cycle's
+        // part is counted
+        HistoryImportOptions options;
+        options.progressInterval = 0;
+        logger.ImportSamples(BillingRows(cycle.start - 3 * 3600, now), options);
+
+        BillingStatus status;
+        AssertTrue(StatusMatches(nullptr, 0, status) && status.period.start == cycle.start,
+                   L"HistoryLogger.GetBillingStatus: imported rows are counted from the cycle start");
+        AssertTrue(StatusMatches(&BILLING_IFACES[1], 0, status),
+                   L"HistoryLogger.GetBillingStatus: per-interface totals");
+
+        // Live samples add to the same row
+        unsigned long long before = status.bytesDown;
+        logger.AppendSample(BILLING_IFACES[1], 5000, 50);
+        logger.AppendSample(BILLING_IFACES[1], 7000, 70);
+        AssertTrue(StatusMatches(&BILLING_IFACES[1], 0, status) && status.bytesDown == before + 12000,
+                   L"HistoryLogger.GetBillingStatus: appended samples are added incrementally");
+
+        // A sample from an older cycle arriving late leaves the totals alone
+        HistorySampleView old = {};
+        old.timestamp = cycle.start - 40 * 24 * 3600;
+        old.interfaceName = BILLING_IFACES[1];
+        old.bytesDown = 999999;
+        logger.ImportSamples([&old](const HistorySampleVisitor& sink) { return sink(old); }, options);
+        AssertTrue(logger.GetBillingStatus(&BILLING_IFACES[1], 0, status) && status.bytesDown == before + 12000,
+                   L"HistoryLogger.GetBillingStatus: backfill into a past cycle does not touch the current one");
+
+        // Projection fields are filled from the totals and the recent profile
+        unsigned long long used = status.bytesDown + status.bytesUp;
+        AssertTrue(logger.GetBillingStatus(nullptr, used / 2, status) &&
+                   status.capReachedLinear == status.asOf && status.capReachedWeighted == status.asOf &&
+                   status.projectedLinear >= used && status.projectedWeighted >= used,
+                   L"HistoryLogger.GetBillingStatus: quota and projections are reported");
+
+        // A different start day moves the cycle back and rebuilds once
+        std::time_t earlier = now - 3 * 24 * 3600;
+        std::tm earlierTm = {};
+        localtime_s(&earlierTm, &earlier);
+        AssertTrue(logger.SetBillingCycleStartDay(earlierTm.tm_mday) && StatusMatches(nullptr, 0, status) &&
+                   status.period.start < cycle.start,
+                   L"HistoryLogger.SetBillingCycleStartDay rebuilds totals for the new cycle");
+
+        // Trimming raw history keeps what was already counted
+        unsigned long long counted = status.bytesDown;
+        logger.TrimToRecentDays(1);
+        AssertTrue(logger.GetBillingStatus(nullptr, 0, status) && status.bytesDown == counted,
+                   L"HistoryLogger.TrimToRecentDays keeps billing totals");
+
+        logger.DeleteAll();
+        AssertTrue(logger.GetBillingStatus(nullptr, 0, status) && status.bytesDown == 0 && status.bytesUp == 0,
+                   L"HistoryLogger.DeleteAll clears billing totals");
+
+        logger.SetBillingCycleStartDay(DEFAULT_BILLING_CYCLE_START_DAY);
+    }
+}
+
+void RunBillingCycleTests()
+{
+    LogTestMessage(L"=== BillingCycle tests ===");
+
+    RunPeriodChecks();
+    RunProjectionChecks();
+    RunIncrementalTotalsChecks();
+}
+
+} // namespace NetworkMonitorTests
@@ -0,0 +1,424 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/BinaryLog.h"
+#include "NetworkMonitor/DiagnosticLog.h"
+#include "TestUtils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cwchar>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    std::string ReadWholeFile(const std::wstring& path)
+    {
+        std::string text;
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return text;
+        }
+        char buffer[64 * 1024];
+        DWORD read = 0;
+        while (ReadFile(file, buffer, sizeof(buffer), &read, nullptr) && read > 0)
+        {
+            text.append(buffer, read);
+        }
+        CloseHandle(file);
+        return text;
+    }
+
+    void WriteWholeFile(const std::wstring& path, const std::string& bytes)
+    {
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return;
+        }
+        DWORD written = 0;
+        WriteFile(file, bytes.data(), static_cast<DWORD>(bytes.size()), &written, nullptr);
+        CloseHandle(file);
+    }
+
+    std::vector<std::string> SplitLines(const std::string& text)
+    {
+        std::vector<std::string> lines;
+        size_t start = 0;
+        while (start < text.size())
+        {
+            size_t end = text.find("\r\n", start);
+            if (end == std::string::npos)
+            {
+                lines.push_back(text.substr(start));
+                break;
+            }
+            lines.push_back(text.substr(start, end - start));
+            start = end + 2;
+        }
+        return lines;
+    }
+
+    std::vector<DecodedLogRecord> Decode(const std::wstring& path, bool* okOut = nullptr)
+    {
+        std::vector<DecodedLogRecord> records;
+        bool ok = ReadBinaryLog(path, [&records](const DecodedLogRecord& record) { records.push_back(record); });
+        if (okOut)
+        {
+            *okOut = ok;
+        }
+        return records;
+    }
+
+    BinaryLogOptions Options(const std::wstring& path, unsigned int threadBufferBytes, unsigned int flushIntervalMs)
+    {
+        BinaryLogOptions options;
+        options.path = path;
+        options.threadBufferBytes = threadBufferBytes;
+        options.flushIntervalMs = flushIntervalMs;
+        return options;
+    }
+
+    void TestRenderMatchesConcatenation()
+    {
+        static constexpr LogFormat format(L"a={} b={} c={} d={} e={} f={} g={}");
+        static constexpr LogFormat surplus(L"only {} then {}");
+        static_assert(format.id == HashLogFormat(L"a={} b={} c={} d={} e={} f={} g={}"),
+                      "format ids are worked out at compile time");
+
+        int a = -42;
+        unsigned long long b = 18446744073709551615ULL;
+        size_t c = 7;
+        double d = 2.5;
+        std::wstring f = L"eth0";
+        const LogArgument args[] = { MakeLogArgument(a), MakeLogArgument(b), MakeLogArgument(c), MakeLogArgument(d),
+                                     MakeLogArgument(LogInterned(L"true")), MakeLogArgument(f),
+                                     MakeLogArgument(L"K\u1EBFt n\u1ED1i") };
+
+        std::wstring expected = L"a=" + std::to_wstring(a) + L" b=" + std::to_wstring(b) + L" c=" + std::to_wstring(c) +
+                                L" d=" + std::to_wstring(d) + L" e=true f=" + f + L" g=K\u1EBFt n\u1ED1i";
+        AssertTrue(RenderLogFormat(format.text, args, 7) == expected,
+                   L"BinaryLog: rendered text matches hand-concatenated text");
+        AssertTrue(RenderLogFormat(surplus.text, args, 1) == L"only -42 then {}",
+                   L"BinaryLog: placeholders without an argument stay as written");
+    }
+
+    // Records read back as the lines DiagnosticLog writes for the same text
+    void TestRoundTripMatchesTextLog()
+    {
+        std::wstring binaryPath = TempFilePath(L"nm_binlog_roundtrip.binlog");
+        std::wstring textPath = TempFilePath(L"nm_binlog_roundtrip.log");
+        std::wstring decodedPath = TempFilePath(L"nm_binlog_roundtrip_decoded.log");
+        DeleteFileW(binaryPath.c_str());
+        DeleteFileW(textPath.c_str());
+        DeleteFileW(decodedPath.c_str());
+
+        static constexpr LogFormat samples(L"HistoryLogger::GetRecentSamples: {} samples returned (limit={}, onlyToday={}, interfaceFilter={})");
+        static constexpr LogFormat failed(L"HistoryLogger::Open: step failed rc={} after {} ms");
+
+        std::vector<std::wstring> expected;
+        std::vector<LogLevel> levels;
+        {
+            BinaryLog binaryLog(Options(binaryPath, 64 * 1024, 1000));
+            DiagnosticLogOptions textOptions;
+            textOptions.path = textPath;
+            DiagnosticLog textLog(textOptions);
+
+            for (int i = 0; i < 50; ++i)
+            {
+                std::wstring filter = (i % 2) ? L"Wi-Fi" : L"K\u1EBFt n\u1ED1i";
+                binaryLog.Write(LogLevel::Debug, samples, static_cast<size_t>(i * 3), 100, LogInterned(L"false"), filter);
+                expected.push_back(L"HistoryLogger::GetRecentSamples: " + std::to_wstring(i * 3) +
+                                   L" samples returned (limit=100, onlyToday=false, interfaceFilter=" + filter + L")");
+                levels.push_back(LogLevel::Debug);
+            }
+            binaryLog.Write(LogLevel::Error, failed, -5, 1.25);
+            expected.push_back(L"HistoryLogger::Open: step failed rc=-5 after " + std::to_wstring(1.25) + L" ms");
+            levels.push_back(LogLevel::Error);
+
+            for (size_t i = 0; i < expected.size(); ++i)
+            {
+                textLog.Push(levels[i], expected[i]);
+            }
+            binaryLog.Flush();
+            textLog.Flush();
+
+            BinaryLogStats stats = binaryLog.GetStats();
+            AssertTrue(stats.written == expected.size() && stats.dropped == 0,
+                       L"BinaryLog: stats count written records");
+        }
+
+        bool ok = false;
+        std::vector<DecodedLogRecord> records = Decode(binaryPath, &ok);
+        AssertTrue(ok && records.size() == expected.size(), L"BinaryLog: every record decodes");
+
+        bool textMatches = (records.size() == expected.size());
+        for (size_t i = 0; textMatches && i < records.size(); ++i)
+        {
+            textMatches = (records[i].text == expected[i] && records[i].level == levels[i]);
+        }
+        AssertTrue(textMatches, L"BinaryLog: decoded text and levels match what was logged");
+
+        // Same bytes after the timestamp as the text log; the timestamp has
+        // the same shape
+        unsigned long long lines = 0;
+        AssertTrue(DecodeBinaryLog(binaryPath, decodedPath, &lines) && lines == expected.size(),
+                   L"BinaryLog: the decoder writes one line per record");
+        std::vector<std::string> decoded = SplitLines(ReadWholeFile(decodedPath));
+        std::vector<std::string> text = SplitLines(ReadWholeFile(textPath));
+        bool linesMatch = (decoded.size() == text.size() && !text.empty());
+        for (size_t i = 0; linesMatch && i < text.size(); ++i)
+        {
+            linesMatch = decoded[i].size() > 20 && decoded[i].compare(20, std::string::npos, text[i], 20, std::string::npos) == 0 &&
+                         decoded[i][4] == '-' && decoded[i][13] == ':' && decoded[i][19] == ' ';
+        }
+        AssertTrue(linesMatch, L"BinaryLog: decoded lines read the same as the text log");
+        AssertTrue(!records.empty() && FormatDecodedLogLine(records[0]) == decoded[0] + "\r\n",
+                   L"BinaryLog: FormatDecodedLogLine gives the decoder's line");
+
+        DeleteFileW(binaryPath.c_str());
+        DeleteFileW(textPath.c_str());
+        DeleteFileW(decodedPath.c_str());
+    }
+
+    // Each thread's records stay in order, and a thread that exits before
+    // the writer runs still has all of them written
+    void TestThreadsKeepOrderAndExitCleanly()
+    {
+        std::wstring path = TempFilePath(L"nm_binlog_threads.binlog");
+        DeleteFileW(path.c_str());
+
+        static constexpr LogFormat format(L"t{} {}");
+        const int threads = 4;
+        const int perThread = 20000;
+        BinaryLogStats stats;
+        BinaryLogStats afterExit;
+        {
+            BinaryLog log(Options(path, 1 << 20, 60000));
+            std::vector<std::thread> producers;
+            for (int t = 0; t < threads; ++t)
+            {
+                producers.emplace_back([&log, t, perThread]() {
+                    for (int i = 0; i < perThread; ++i)
+                    {
+                        log.Write(LogLevel::Debug, format, t, i);
+                    }
+                });
+            }
+            for (std::thread& producer : producers)
+            {
+                producer.join();
+            }
+
+            log.Flush();
+            stats = log.GetStats();
+            log.Flush();
+            afterExit = log.GetStats();
+        }
+
+        AssertTrue(stats.dropped == 0 && stats.written == static_cast<unsigned long long>(threads * perThread),
+                   L"BinaryLog: records of exited threads are all written");
+        AssertTrue(afterExit.threads == 0, L"BinaryLog: rings of exited threads are released once empty");
+
+        std::vector<DecodedLogRecord> records = Decode(path);
+        std::vector<int> next(threads, 0);
+        bool ordered = true;
+        for (const DecodedLogRecord& record : records)
+        {
+            // "t<thread> <index>"
+            wchar_t* end = nullptr;
+            int producer = (record.text.size() > 1) ? static_cast<int>(std::wcstol(record.text.c_str() + 1, &end, 10)) : -1;
+            int index = end ? static_cast<int>(std::wcstol(end, nullptr, 10)) : -1;
+            if (producer < 0 || producer >= threads || index != next[producer])
+            {
+                ordered = false;
+                break;
+            }
+            ++next[producer];
+        }
+        AssertTrue(records.size() == static_cast<size_t>(threads * perThread) && ordered,
+                   L"BinaryLog: every record written once, in order per thread");
+        DeleteFileW(path.c_str());
+    }
+
+    void TestOverflowIsCounted()
+    {
+        std::wstring path = TempFilePath(L"nm_binlog_drop.binlog");
+        DeleteFileW(path.c_str());
+
+        static constexpr LogFormat format(L"overflow record {}");
+        const int threads = 4;
+        const int perThread = 20000;
+        unsigned long long accepted = 0;
+        BinaryLogStats stats;
+        {
+            BinaryLog log(Options(path, 256, 1000));
+            std::vector<std::thread> producers;
+            std::vector<unsigned long long> counts(threads, 0);
+            for (int t = 0; t < threads; ++t)
+            {
+                producers.emplace_back([&log, &counts, t, perThread]() {
+                    for (int i = 0; i < perThread; ++i)
+                    {
+                        counts[t] += log.Write(LogLevel::Debug, format, i) ? 1 : 0;
+                    }
+                });
+            }
+            for (std::thread& producer : producers)
+            {
+                producer.join();
+            }
+            for (unsigned long long count : counts)
+            {
+                accepted += count;
+            }
+            log.Flush();
+            stats = log.GetStats();
+        }
+
+        AssertTrue(stats.dropped > 0, L"BinaryLog: a tiny ring drops records under load");
+        AssertTrue(accepted + stats.dropped == static_cast<unsigned long long>(threads * perThread) &&
+                   stats.written == accepted,
+                   L"BinaryLog: every record is either written or counted as dropped");
+
+        unsigned long long reported = 0;
+        unsigned long long decoded = 0;
+        for (const DecodedLogRecord& record : Decode(path))
+        {
+            reported += record.dropped;
+            decoded += (record.dropped == 0) ? 1 : 0;
+        }
+        AssertTrue(reported == stats.dropped, L"BinaryLog: the log reports how many records were dropped");
+        AssertTrue(decoded == accepted, L"BinaryLog: accepted records all reach the file");
+        DeleteFileW(path.c_str());
+    }
+
+    // Each open starts a session with its own definitions; a crash can
+    // leave the last record cut short
+    void TestSessionsAndTruncation()
+    {
+        std::wstring path = TempFilePath(L"nm_binlog_sessions.binlog");
+        DeleteFileW(path.c_str());
+
+        static constexpr LogFormat format(L"session {} says {}");
+        for (int session = 0; session < 2; ++session)
+        {
+            BinaryLog log(Options(path, 4096, 1000));
+            log.Write(LogLevel::Debug, format, session, LogInterned(L"hello"));
+            log.Write(LogLevel::Debug, format, session, LogInterned(L"bye"));
+        }
+
+        bool ok = false;
+        std::vector<DecodedLogRecord> records = Decode(path, &ok);
+        AssertTrue(ok && records.size() == 4 && records[0].text == L"session 0 says hello" &&
+                   records[3].text == L"session 1 says bye",
+                   L"BinaryLog: appended sessions decode in turn");
+
+        std::string bytes = ReadWholeFile(path);
+        WriteWholeFile(path, bytes.substr(0, bytes.size() - 3));
+        records = Decode(path, &ok);
+        AssertTrue(ok && records.size() == 3, L"BinaryLog: a record cut short ends the read quietly");
+
+        WriteWholeFile(path, "not a binary log");
+        Decode(path, &ok);
+        AssertTrue(!ok, L"BinaryLog: a file without a header is rejected");
+        DeleteFileW(path.c_str());
+    }
+
+    struct CallLatency
+    {
+        double p50;
+        double p99;
+    };
+
+    template <typename Call>
+    CallLatency MeasureCalls(int calls, Call call)
+    {
+        std::vector<double> samples;
+        samples.reserve(static_cast<size_t>(calls));
+        for (int i = 0; i < calls; ++i)
+        {
+            auto begin = std::chrono::steady_clock::now();
+            call(i);
+            samples.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count());
+        }
+        std::sort(samples.begin(), samples.end());
+        return CallLatency{ samples[samples.size() / 2], samples[(samples.size() * 99) / 100] };
+    }
+
+    // The call-site cost: build the string and queue it, or queue the raw
+    // arguments
+    void BenchmarkAgainstTextLog()
+    {
+        const int calls = 20000;
+        std::wstring textPath = TempFilePath(L"nm_binlog_bench.log");
+        std::wstring binaryPath = TempFilePath(L"nm_binlog_bench.binlog");
+        DeleteFileW(textPath.c_str());
+        DeleteFileW(binaryPath.c_str());
+
+        static constexpr LogFormat format(L"HistoryLogger::GetRecentSamples: {} samples returned (limit={}, onlyToday={}, interfaceFilter={})");
+        const std::wstring filter = L"Ethernet";
+
+        CallLatency text;
+        {
+            DiagnosticLogOptions options;
+            options.path = textPath;
+            options.capacity = calls * 2;
+            DiagnosticLog log(options);
+            text = MeasureCalls(calls, [&](int i) {
+                log.Push(LogLevel::Debug,
+                         L"HistoryLogger::GetRecentSamples: " + std::to_wstring(i) + L" samples returned (limit=" +
+                             std::to_wstring(100) + L", onlyToday=" + L"false" + L", interfaceFilter=" + filter + L")");
+            });
+        }
+
+        CallLatency binary;
+        BinaryLogStats stats;
+        {
+            BinaryLog log(Options(binaryPath, 4 * 1024 * 1024, 1000));
+            log.Write(LogLevel::Debug, format, 0, 0, LogInterned(L"false"), filter);   // Registers the thread
+            binary = MeasureCalls(calls, [&](int i) {
+                log.Write(LogLevel::Debug, format, i, 100, LogInterned(L"false"), filter);
+            });
+            log.Flush();
+            stats = log.GetStats();
+        }
+
+        AssertTrue(stats.dropped == 0, L"BinaryLog: benchmark ring holds every record");
+
+        long long textBytes = static_cast<long long>(ReadWholeFile(textPath).size());
+        long long binaryBytes = static_cast<long long>(ReadWholeFile(binaryPath).size());
+        wchar_t msg[300] = {0};
+        swprintf(msg, 300,
+                 L"[bench] log call p50/p99 ns: format + ring %.0f/%.0f, binary record %.0f/%.0f; "
+                 L"file bytes text %lld vs binary %lld",
+                 text.p50, text.p99, binary.p50, binary.p99, textBytes, binaryBytes);
+        LogTestMessage(msg);
+
+        DeleteFileW(textPath.c_str());
+        DeleteFileW(binaryPath.c_str());
+    }
+}
+
+void RunBinaryLogTests()
+{
+    LogTestMessage(L"=== BinaryLog tests ===");
+
+    TestRenderMatchesConcatenation();
+    TestRoundTripMatchesTextLog();
+    TestThreadsKeepOrderAndExitCleanly();
+    TestOverflowIsCounted();
+    TestSessionsAndTruncation();
+    BenchmarkAgainstTextLog();
+}
+
+} // namespace NetworkMonitorTests
@@ -0,0 +1,226 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/ConfigFile.h"
+#include "TestUtils.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    void WriteTextFile(const std::wstring& path, const std::string& text)
+    {
+        std::ofstream file(std::filesystem::path(path), std::ios::binary | std::ios::trunc);
+        file << text;
+    }
+
+    // Waits for the watcher thread to report a change
+    bool WaitForCount(const std::atomic<int>& count, int expected)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+        while (count.load() < expected && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return count.load() >= expected;
+    }
+
+    AppConfig EditedConfig()
+    {
+        AppConfig config;
+        config.updateInterval = 500;
+        config.displayUnit = SpeedUnit::MegaBitsPerSecond;
+        config.showUploadSpeed = false;
+        config.debugLogging = true;
+        config.logKeepFiles = 12;
+        config.themeMode = ThemeMode::Dark;
+        config.historyRawDays = 14;
+        config.historyMaxSizeMB = 256;
+        config.language = AppLanguage::Vietnamese;
+        config.selectedInterface = L"Wi-Fi 2 (Kết nối)";
+        config.pingTarget = L"1.1.1.1";
+        config.hotkeyKey = 'M';
+        config.billingCycleStartDay = 15;
+        config.billingQuotas[L""] = 107374182400ULL;
+        config.billingQuotas[L"Ethernet=2"] = 53687091200ULL;
+        return config;
+    }
+
+    void TestRoundTrip()
+    {
+        AppConfig edited = EditedConfig();
+        std::string text = FormatConfigText(edited);
+
+        AppConfig loaded;
+        AssertTrue(ParseConfigText(text, loaded), L"ConfigFile: formatted text parses cleanly");
+        AssertTrue(loaded.updateInterval == 500 && loaded.displayUnit == SpeedUnit::MegaBitsPerSecond &&
+                   !loaded.showUploadSpeed && loaded.debugLogging && loaded.logKeepFiles == 12 &&
+                   loaded.themeMode == ThemeMode::Dark && loaded.historyRawDays == 14 &&
+                   loaded.historyMaxSizeMB == 256 && loaded.language == AppLanguage::Vietnamese &&
+                   loaded.hotkeyKey == 'M' && loaded.billingCycleStartDay == 15,
+                   L"ConfigFile: numbers, flags and enumerations round-trip");
+        AssertTrue(loaded.selectedInterface == edited.selectedInterface && loaded.pingTarget == L"1.1.1.1",
+                   L"ConfigFile: text round-trips as UTF-8");
+        AssertTrue(loaded.billingQuotas == edited.billingQuotas,
+                   L"ConfigFile: quotas round-trip, '*' and names holding '=' included");
+        AssertTrue(FormatConfigText(loaded) == text, L"ConfigFile: formatting is stable");
+    }
+
+    void TestLenientParse()
+    {
+        AppConfig config;
+        const char text[] =
+            "\xEF\xBB\xBF; hand edited\r\n"
+            "[Future]\r\n"
+            "UpdateInterval=1\r\n"
+            "  [ Settings ]  \r\n"
+            "  UpdateInterval =  750  \r\n"
+            "# comment\r\n"
+            "NewerSetting=whatever\r\n"
+            "ShowDownloadSpeed=false\r\n"
+            "LogMaxSizeMB=999999\r\n"
+            "HistoryHourDays=-5\r\n"
+            "BillingCycleStartDay=40\r\n"
+            "DisplayUnit=9\r\n"
+            "PingIntervalMs=soon\r\n"
+            "[BillingQuotas]\r\n"
+            "Ethernet = 1000\r\n"
+            "Ethernet=0\r\n"
+            "Wi-Fi=2000\r\n";
+
+        AssertTrue(!ParseConfigText(text, config), L"ConfigFile: unreadable values are reported");
+        AssertTrue(config.updateInterval == 750 && !config.showDownloadSpeed,
+                   L"ConfigFile: names and values are trimmed; other sections are skipped");
+        AssertTrue(config.logMaxSizeMB == MAX_LOG_MAX_SIZE_MB && config.historyHourDays == 0 &&
+                   config.billingCycleStartDay == MAX_BILLING_CYCLE_START_DAY,
+                   L"ConfigFile: values out of range are clamped");
+        AssertTrue(config.displayUnit == AppConfig().displayUnit && config.pingIntervalMs == AppConfig().pingIntervalMs,
+                   L"ConfigFile: unreadable values keep the field");
+        AssertTrue(config.billingQuotas.size() == 1 && config.billingQuotas[L"Wi-Fi"] == 2000,
+                   L"ConfigFile: a zero quota removes the interface's quota");
+
+        AppConfig empty;
+        AssertTrue(ParseConfigText("", empty) && ParseConfigText("[Settings]", empty),
+                   L"ConfigFile: empty files and sections parse");
+    }
+
+    void TestFileSaveAndLoad()
+    {
+        std::wstring path = TempFilePath(L"nm_config_file_test.ini");
+        DeleteFileW(path.c_str());
+
+        AppConfig loaded;
+        loaded.updateInterval = 1;
+        AssertTrue(!LoadConfigFile(path, loaded) && loaded.updateInterval == AppConfig().updateInterval,
+                   L"ConfigFile: a missing file loads the defaults");
+
+        AppConfig edited = EditedConfig();
+        AssertTrue(SaveConfigFile(path, edited), L"ConfigFile: save succeeds");
+        AssertTrue(!std::filesystem::exists(std::filesystem::path(path + L".tmp")),
+                   L"ConfigFile: the temporary file is renamed into place");
+        AssertTrue(LoadConfigFile(path, loaded) && FormatConfigText(loaded) == FormatConfigText(edited),
+                   L"ConfigFile: a saved file loads back");
+
+        edited.updateInterval = 3000;
+        AssertTrue(SaveConfigFile(path, edited) && LoadConfigFile(path, loaded) && loaded.updateInterval == 3000,
+                   L"ConfigFile: a save replaces the file");
+
+        WriteTextFile(path, "");
+        AssertTrue(LoadConfigFile(path, loaded) && loaded.updateInterval == AppConfig().updateInterval,
+                   L"ConfigFile: an empty file loads the defaults");
+
+        DeleteFileW(path.c_str());
+    }
+
+    void TestWatcher()
+    {
+        std::wstring path = TempFilePath(L"nm_config_watch_test.ini");
+        AppConfig config = EditedConfig();
+        SaveConfigFile(path, config);
+
+        std::atomic<int> changes(0);
+        ConfigFileWatcher watcher;
+        if (!watcher.Start(path, [&changes]() { ++changes; }))
+        {
+            LogTestMessage(L"ConfigFile: change notification not supported here, watcher tests skipped");
+            DeleteFileW(path.c_str());
+            return;
+        }
+
+        WriteTextFile(TempFilePath(L"nm_config_watch_other.ini"), "x");
+        config.updateInterval = 250;
+        SaveConfigFile(path, config);
+        AssertTrue(WaitForCount(changes, 1), L"ConfigFile: an atomic save is reported");
+
+        // Several writes close together are reported once
+        std::this_thread::sleep_for(std::chrono::milliseconds(CONFIG_CHANGE_SETTLE_MS * 2));
+        int before = changes.load();
+        WriteTextFile(path, "[Settings]\r\n");
+        WriteTextFile(path, "[Settings]\r\nUpdateInterval=900\r\n");
+        AssertTrue(WaitForCount(changes, before + 1), L"ConfigFile: an in-place edit is reported");
+        std::this_thread::sleep_for(std::chrono::milliseconds(CONFIG_CHANGE_SETTLE_MS * 4));
+        AssertTrue(changes.load() == before + 1, L"ConfigFile: a burst of writes is reported once");
+
+        AppConfig loaded;
+        AssertTrue(LoadConfigFile(path, loaded) && loaded.updateInterval == 900,
+                   L"ConfigFile: the edited file reads back");
+
+        watcher.Stop();
+        int stopped = changes.load();
+        SaveConfigFile(path, config);
+        std::this_thread::sleep_for(std::chrono::milliseconds(CONFIG_CHANGE_SETTLE_MS * 3));
+        AssertTrue(changes.load() == stopped, L"ConfigFile: nothing is reported after Stop");
+
+        DeleteFileW(TempFilePath(L"nm_config_watch_other.ini").c_str());
+        DeleteFileW(path.c_str());
+    }
+
+    // Startup reads the settings once; the whole load should stay well
+    // under the time the window takes to appear
+    void BenchmarkLoad()
+    {
+        std::wstring path = TempFilePath(L"nm_config_bench_test.ini");
+        SaveConfigFile(path, EditedConfig());
+
+        const int loads = 2000;
+        AppConfig config;
+        size_t sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < loads; ++i)
+        {
+            LoadConfigFile(path, config);
+            sink += config.updateInterval;
+        }
+        double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        AssertTrue(sink > 0, L"ConfigFile: repeated loads succeed");
+
+        wchar_t msg[160] = {0};
+        swprintf(msg, 160, L"[bench] config file load us/call: %.2f", micros / loads);
+        LogTestMessage(msg);
+
+        DeleteFileW(path.c_str());
+    }
+}
+
+void RunConfigFileTests()
+{
+    LogTestMessage(L"=== ConfigFile tests ===");
+
+    TestRoundTrip();
+    TestLenientParse();
+    TestFileSaveAndLoad();
+    TestWatcher();
+    BenchmarkLoad();
+}
+
+} // namespace NetworkMonitorTests
@@ -0,0 +1,280 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/ConfigStore.h"
+#include "TestUtils.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cwchar>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    void TestDiff()
+    {
+        AppConfig before;
+        AppConfig after = before;
+        AssertTrue(!DiffConfig(before, after).Any(), L"ConfigStore: equal configs have no diff");
+
+        after.updateInterval = before.updateInterval + 1;
+        after.pingTarget = L"1.1.1.1";
+        after.billingQuotas[L"Ethernet"] = 1000;
+        ConfigChanges changes = DiffConfig(before, after);
+        AssertTrue(changes == (ConfigField::UpdateInterval | ConfigField::PingTarget | ConfigField::BillingQuotas),
+                   L"ConfigStore: the diff holds exactly the changed fields");
+        AssertTrue(changes.Contains(ConfigField::PingTarget) && !changes.Contains(ConfigField::Language) &&
+                   changes.Intersects(ConfigField::Language | ConfigField::UpdateInterval),
+                   L"ConfigStore: changes can be queried by field");
+
+        // Every field is covered by the generated diff
+        AppConfig changed = before;
+        changed.updateInterval += 1;
+        changed.displayUnit = SpeedUnit::MegaBitsPerSecond;
+        changed.autoStart = !before.autoStart;
+        changed.showUploadSpeed = !before.showUploadSpeed;
+        changed.showDownloadSpeed = !before.showDownloadSpeed;
+        changed.enableLogging = !before.enableLogging;
+        changed.debugLogging = !before.debugLogging;
+        changed.binaryDebugLog = !before.binaryDebugLog;
+        changed.logMaxSizeMB += 1;
+        changed.logMaxAgeDays += 1;
+        changed.logKeepFiles += 1;
+        changed.darkTheme = !before.darkTheme;
+        changed.themeMode = (before.themeMode == ThemeMode::Dark) ? ThemeMode::Light : ThemeMode::Dark;
+        changed.historyAutoTrimDays += 1;
+        changed.historyRawDays += 1;
+        changed.historyMinuteDays += 1;
+        changed.historyHourDays += 1;
+        changed.historyMaxSizeMB += 1;
+        changed.historyCoalescePercent += 1;
+        changed.language = AppLanguage::Vietnamese;
+        changed.selectedInterface = L"Wi-Fi";
+        changed.enableConnectionNotification = !before.enableConnectionNotification;
+        changed.pingTarget = L"9.9.9.9";
+        changed.pingIntervalMs += 1;
+        changed.hotkeyModifier += 1;
+        changed.hotkeyKey += 1;
+        changed.billingCycleStartDay = (before.billingCycleStartDay == 2) ? 3 : 2;
+        changed.billingQuotas[L""] = 1;
+        AssertTrue(DiffConfig(before, changed) == ConfigChanges::All(),
+                   L"ConfigStore: a change to any field shows in the diff");
+
+        AssertTrue(std::wcscmp(GetConfigFieldName(ConfigField::PingIntervalMs), L"PingIntervalMs") == 0,
+                   L"ConfigStore: fields have names");
+    }
+
+    void TestPublish()
+    {
+        ConfigStore store;
+        ConfigSnapshot defaults = store.Snapshot();
+        AssertTrue(defaults->updateInterval == AppConfig().updateInterval && defaults.get() == &store.Current(),
+                   L"ConfigStore: starts with the defaults");
+
+        AppConfig edited = *defaults;
+        edited.updateInterval = 250;
+        ConfigChanges changes = store.Publish(edited);
+        AssertTrue(changes == ConfigChanges(ConfigField::UpdateInterval) && store.Current().updateInterval == 250,
+                   L"ConfigStore: a publish makes the config current");
+        AssertTrue(defaults->updateInterval == AppConfig().updateInterval && defaults.get() != &store.Current(),
+                   L"ConfigStore: an earlier snapshot is left as it was");
+
+        // The store keeps only the current snapshot
+        std::weak_ptr<const AppConfig> replaced = defaults;
+        defaults.reset();
+        AssertTrue(replaced.expired(), L"ConfigStore: a replaced snapshot is freed with its last owner");
+
+        const AppConfig* current = &store.Current();
+        AssertTrue(!store.Publish(edited).Any() && &store.Current() == current,
+                   L"ConfigStore: publishing an equal config keeps the snapshot");
+
+        ConfigSnapshot owned;
+        {
+            ConfigStore shortLived;
+            shortLived.Publish(edited);
+            owned = shortLived.Snapshot();
+        }
+        AssertTrue(owned && owned->updateInterval == 250, L"ConfigStore: a snapshot outlives its store");
+    }
+
+    void TestSubscribers()
+    {
+        ConfigStore store;
+        int intervalCalls = 0;
+        int languageCalls = 0;
+        UINT seenBefore = 0;
+        UINT seenAfter = 0;
+        store.Subscribe(ConfigField::UpdateInterval,
+                        [&](const AppConfig& before, const AppConfig& after, ConfigChanges) {
+            ++intervalCalls;
+            seenBefore = before.updateInterval;
+            seenAfter = after.updateInterval;
+        });
+        unsigned int languageId = store.Subscribe(ConfigField::Language | ConfigField::ThemeMode,
+                                                  [&](const AppConfig&, const AppConfig&, ConfigChanges) {
+            ++languageCalls;
+        });
+
+        AppConfig config = store.Current();
+        UINT original = config.updateInterval;
+        config.updateInterval = 500;
+        store.Publish(config);
+        AssertTrue(intervalCalls == 1 && languageCalls == 0 && seenBefore == original && seenAfter == 500,
+                   L"ConfigStore: only subscribers of a changed field are called, with both configs");
+
+        config.pingTarget = L"1.1.1.1";
+        store.Publish(config);
+        AssertTrue(intervalCalls == 1 && languageCalls == 0, L"ConfigStore: unwatched fields call no one");
+
+        store.Publish(config);
+        AssertTrue(intervalCalls == 1, L"ConfigStore: an unchanged publish calls no one");
+
+        config.language = AppLanguage::English;
+        store.Publish(config);
+        store.Unsubscribe(languageId);
+        config.language = AppLanguage::Vietnamese;
+        store.Publish(config);
+        AssertTrue(languageCalls == 1, L"ConfigStore: unsubscribed callbacks are not called");
+
+        // A subscriber sees the new snapshot as current
+        bool sawCurrent = false;
+        store.Subscribe(ConfigField::HotkeyKey, [&](const AppConfig&, const AppConfig& after, ConfigChanges) {
+            sawCurrent = (&after == &store.Current());
+        });
+        config.hotkeyKey = 'Q';
+        store.Publish(config);
+        AssertTrue(sawCurrent, L"ConfigStore: subscribers run after the swap");
+    }
+
+    // Readers on other threads see whole snapshots, never a mix of two
+    void TestConcurrentReaders()
+    {
+        ConfigStore store;
+        const int readerCount = 3;
+        const long long minReadsPerReader = 20000;
+        std::atomic<bool> stop(false);
+        std::atomic<int> notStarted(readerCount);
+        std::atomic<int> belowQuota(readerCount);   // Readers short of minReadsPerReader
+        std::atomic<int> torn(0);
+
+        std::thread readers[readerCount];
+        for (std::thread& reader : readers)
+        {
+            reader = std::thread([&]() {
+                long long count = 0;
+                while (!stop.load(std::memory_order_relaxed))
+                {
+                    ConfigSnapshot config = store.Snapshot();
+                    if (config->updateInterval > 10000 && config->updateInterval != config->pingIntervalMs)
+                    {
+                        ++torn;
+                    }
+                    if (++count == 1)
+                    {
+                        --notStarted;
+                    }
+                    if (count == minReadsPerReader)
+                    {
+                        --belowQuota;
+                    }
+                }
+            });
+        }
+
+        // Publishing only starts once every reader has read, and goes on
+        // until each has read enough to overlap many publishes
+        while (notStarted.load() > 0)
+        {
+            std::this_thread::yield();
+        }
+        AppConfig config;
+        UINT published = 0;
+        while (published < 2000 || belowQuota.load() > 0)
+        {
+            ++published;
+            config.updateInterval = 10000 + published;
+            config.pingIntervalMs = 10000 + published;
+            store.Publish(config);
+            if (published % 64 == 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+        stop = true;
+        for (std::thread& reader : readers)
+        {
+            reader.join();
+        }
+
+        AssertTrue(torn.load() == 0 && store.Current().updateInterval == 10000 + published,
+                   L"ConfigStore: concurrent readers never see a torn config");
+    }
+
+    // Current() on the publishing thread and Snapshot() from any other,
+    // against the mutex-guarded copy readers would need without snapshots
+    void BenchmarkRead()
+    {
+        ConfigStore store;
+        std::mutex mutex;
+        AppConfig shared;
+        const int reads = 1000000;
+        unsigned long long sink = 0;
+
+        // Read through a volatile pointer so the load is not hoisted out
+        // of the loop
+        const ConfigStore* volatile storePtr = &store;
+        unsigned long long allocationsBefore = GetThreadAllocationCount();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < reads; ++i)
+        {
+            sink += storePtr->Current().updateInterval;
+        }
+        double current = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < reads; ++i)
+        {
+            sink += storePtr->Snapshot()->updateInterval;
+        }
+        double snapshot = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        bool noAllocations = GetThreadAllocationCount() == allocationsBefore;
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < reads; ++i)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            AppConfig copy = shared;
+            sink += copy.updateInterval;
+        }
+        double copied = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        // A snapshot costs a reference count, about what a locked copy of
+        // the default config does; the copy grows with its strings and
+        // quotas and holds the lock against the publisher
+        AssertTrue(sink > 0 && noAllocations, L"ConfigStore: reading the current config does not allocate");
+
+        wchar_t msg[200] = {0};
+        swprintf(msg, 200, L"[bench] config read ns/call: locked copy %.1f, Snapshot() %.1f, Current() %.2f",
+                 copied / reads, snapshot / reads, current / reads);
+        LogTestMessage(msg);
+    }
+}
+
+void RunConfigStoreTests()
+{
+    LogTestMessage(L"=== ConfigStore tests ===");
+
+    TestDiff();
+    TestPublish();
+    TestSubscribers();
+    TestConcurrentReaders();
+    BenchmarkRead();
+}
+
+} // namespace NetworkMonitorTests
@@ -0,0 +1,422 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/DiagnosticLog.h"
+#include "TestUtils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    std::string ReadWholeFile(const std::wstring& path)
+    {
+        std::string text;
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return text;
+        }
+        char buffer[64 * 1024];
+        DWORD read = 0;
+        while (ReadFile(file, buffer, sizeof(buffer), &read, nullptr) && read > 0)
+        {
+            text.append(buffer, read);
+        }
+        CloseHandle(file);
+        return text;
+    }
+
+    std::vector<std::string> ReadLines(const std::wstring& path)
+    {
+        std::vector<std::string> lines;
+        std::string text = ReadWholeFile(path);
+        size_t start = 0;
+        while (start < text.size())
+        {
+            size_t end = text.find("\r\n", start);
+            if (end == std::string::npos)
+            {
+                lines.push_back(text.substr(start));
+                break;
+            }
+            lines.push_back(text.substr(start, end - start));
+            start = end + 2;
+        }
+        return lines;
+    }
+
+    size_t CountContaining(const std::vector<std::string>& lines, const char* needle)
+    {
+        return static_cast<size_t>(std::count_if(lines.begin(), lines.end(), [needle](const std::string& line) {
+            return line.find(needle) != std::string::npos;
+        }));
+    }
+
+    DiagnosticLogOptions Options(const std::wstring& path, unsigned int capacity, unsigned int flushIntervalMs)
+    {
+        DiagnosticLogOptions options;
+        options.path = path;
+        options.capacity = capacity;
+        options.flushIntervalMs = flushIntervalMs;
+        return options;
+    }
+
+    void TestLineFormat()
+    {
+        std::wstring path = TempFilePath(L"nm_diaglog_format.log");
+        DeleteFileW(path.c_str());
+        {
+            DiagnosticLog log(Options(path, 64, 1000));
+            AssertTrue(log.Push(LogLevel::Debug, L"hello"), L"DiagnosticLog: Push accepts a record");
+            AssertTrue(log.Push(LogLevel::Debug, L"K\u1EBFt n\u1ED1i"), L"DiagnosticLog: Push accepts non-ASCII text");
+            log.Flush();
+
+            std::vector<std::string> lines = ReadLines(path);
+            AssertTrue(lines.size() == 2, L"DiagnosticLog: Flush writes every queued record");
+            // "YYYY-MM-DD HH:MM:SS [DEBUG] hello"
+            AssertTrue(!lines.empty() && lines[0].size() == 33 && lines[0][4] == '-' && lines[0][13] == ':' &&
+                       lines[0].compare(20, 13, "[DEBUG] hello") == 0,
+                       L"DiagnosticLog: lines keep the timestamp and level format");
+            AssertTrue(lines.size() == 2 && lines[1].find("K\xe1\xba\xbft n\xe1\xbb\x91i") != std::string::npos,
+                       L"DiagnosticLog: text is written as UTF-8");
+
+            DiagnosticLogStats stats = log.GetStats();
+            AssertTrue(stats.written == 2 && stats.dropped == 0 && stats.writes >= 1,
+                       L"DiagnosticLog: stats count written records and batches");
+        }
+
+        // Appends to what is already there
+        {
+            DiagnosticLog log(Options(path, 64, 1000));
+            log.Push(LogLevel::Debug, L"again");
+        }
+        AssertTrue(ReadLines(path).size() == 3, L"DiagnosticLog: reopening appends and destruction flushes");
+        DeleteFileW(path.c_str());
+    }
+
+    void TestErrorWritesImmediately()
+    {
+        std::wstring path = TempFilePath(L"nm_diaglog_error.log");
+        DeleteFileW(path.c_str());
+
+        DiagnosticLog log(Options(path, 64, 60000));
+        log.Push(LogLevel::Debug, L"quiet");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        AssertTrue(ReadLines(path).empty(), L"DiagnosticLog: debug records wait for the flush interval");
+
+        log.Push(LogLevel::Error, L"loud");
+        std::vector<std::string> lines;
+        for (int i = 0; i < 200 && lines.size() < 2; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            lines = ReadLines(path);
+        }
+        AssertTrue(lines.size() == 2 && lines[1].find("[ERROR] loud") != std::string::npos,
+                   L"DiagnosticLog: an error record writes the batch at once");
+    }
+
+    // Errors from several threads at once, with no Flush and a long
+    // interval: each one must still wake the writer, including those
+    // pushed while it is draining after an earlier wake
+    void TestErrorsFromManyThreadsWake()
+    {
+        std::wstring path = TempFilePath(L"nm_diaglog_wake.log");
+        DeleteFileW(path.c_str());
+
+        const int threads = 4;
+        const int perThread = 250;
+        DiagnosticLog log(Options(path, 4096, 60000));
+        std::vector<std::thread> producers;
+        for (int t = 0; t < threads; ++t)
+        {
+            producers.emplace_back([&log]() {
+                for (int i = 0; i < perThread; ++i)
+                {
+                    log.Push(LogLevel::Error, L"wake");
+                    if (i % 16 == 0)
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (std::thread& producer : producers)
+        {
+            producer.join();
+        }
+
+        size_t written = 0;
+        for (int i = 0; i < 300 && written < static_cast<size_t>(threads * perThread); ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            written = CountContaining(ReadLines(path), "[ERROR] wake");
+        }
+        AssertTrue(written == static_cast<size_t>(threads * perThread),
+                   L"DiagnosticLog: every error reaches the file without waiting for the interval");
+    }
+
+    void TestTimerFlush()
+    {
+        std::wstring path = TempFilePath(L"nm_diaglog_timer.log");
+        DeleteFileW(path.c_str());
+
+        DiagnosticLog log(Options(path, 64, 50));
+        log.Push(LogLevel::Debug, L"tick");
+        std::vector<std::string> lines;
+        for (int i = 0; i < 200 && lines.empty(); ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            lines = ReadLines(path);
+        }
+        AssertTrue(lines.size() == 1, L"DiagnosticLog: debug records are written once the interval passes");
+    }
+
+    // Several producers at once: nothing lost or duplicated, and each
+    // producer's records stay in order
+    void TestConcurrentProducers()
+    {
+        std::wstring path = TempFilePath(L"nm_diaglog_mpsc.log");
+        DeleteFileW(path.c_str());
+
+        const int threads = 4;
+        const int perThread = 20000;
+        DiagnosticLogStats stats;
+        {
+            DiagnosticLog log(Options(path, 1 << 17, 1000));
+            std::vector<std::thread> producers;
+            for (int t = 0; t < threads; ++t)
+            {
+                producers.emplace_back([&log, t, perThread]() {
+                    for (int i = 0; i < perThread; ++i)
+                    {
+                        log.Push(LogLevel::Debug, L"p" + std::to_wstring(t) + L" " + std::to_wstring(i));
+                    }
+                });
+            }
+            for (std::thread& producer : producers)
+            {
+                producer.join();
+            }
+            log.Flush();
+            stats = log.GetStats();
+        }
+
+        AssertTrue(stats.dropped == 0 && stats.written == static_cast<unsigned long long>(threads * perThread),
+                   L"DiagnosticLog: a ring large enough drops nothing");
+
+        std::vector<std::string> lines = ReadLines(path);
+        std::vector<int> next(threads, 0);
+        bool ordered = true;
+        for (const std::string& line : lines)
+        {
+            size_t at = line.find("] p");
+            if (at == std::string::npos)
+            {
+                ordered = false;
+                break;
+            }
+            int producer = std::atoi(line.c_str() + at + 3);
+            int index = std::atoi(line.c_str() + line.find(' ', at + 3) + 1);
+            if (producer < 0 || producer >= threads || index != next[producer])
+            {
+                ordered = false;
+                break;
+            }
+            ++next[producer];
+        }
+        AssertTrue(lines.size() == static_cast<size_t>(threads * perThread) && ordered,
+                   L"DiagnosticLog: every record written once, in order per producer");
+        DeleteFileW(path.c_str());
+    }
+
+    void TestOverflowIsCounted()
+    {
+        std::wstring path = TempFilePath(L"nm_diaglog_drop.log");
+        DeleteFileW(path.c_str());
+
+        const int threads = 4;
+        const int perThread = 20000;
+        unsigned long long accepted = 0;
+        DiagnosticLogStats stats;
+        {
+            DiagnosticLog log(Options(path, 8, 1000));
+            std::vector<std::thread> producers;
+            std::vector<unsigned long long> counts(threads, 0);
+            for (int t = 0; t < threads; ++t)
+            {
+                producers.emplace_back([&log, &counts, t, perThread]() {
+                    for (int i = 0; i < perThread; ++i)
+                    {
+                        counts[t] += log.Push(LogLevel::Debug, L"overflow record") ? 1 : 0;
+                    }
+                });
+            }
+            for (std::thread& producer : producers)
+            {
+                producer.join();
+            }
+            for (unsigned long long count : counts)
+            {
+                accepted += count;
+            }
+            log.Flush();
+            stats = log.GetStats();
+        }
+
+        AssertTrue(stats.dropped > 0, L"DiagnosticLog: a tiny ring drops records under load");
+        AssertTrue(accepted + stats.dropped == static_cast<unsigned long long>(threads * perThread) &&
+                   stats.written == accepted,
+                   L"DiagnosticLog: every record is either written or counted as dropped");
+
+        std::vector<std::string> lines = ReadLines(path);
+        unsigned long long reported = 0;
+        for (const std::string& line : lines)
+        {
+            size_t at = line.find("[WARN] ");
+            if (at != std::string::npos)
+            {
+                reported += std::strtoull(line.c_str() + at + 7, nullptr, 10);
+            }
+        }
+        AssertTrue(reported == stats.dropped, L"DiagnosticLog: the log reports how many records were dropped");
+        AssertTrue(CountContaining(lines, "overflow record") == accepted,
+                   L"DiagnosticLog: accepted records all reach the file");
+        DeleteFileW(path.c_str());
+    }
+
+    // What LogDebug/LogError did before: open, append one line, close
+    void AppendLineDirect(const std::wstring& path, const std::wstring& message)
+    {
+        SYSTEMTIME st = {};
+        GetLocalTime(&st);
+        wchar_t timeBuffer[32] = {0};
+        swprintf_s(timeBuffer, L"%04u-%02u-%02u %02u:%02u:%02u",
+                   st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+        std::wstring line = std::wstring(timeBuffer) + L" [DEBUG] " + message + L"\r\n";
+        std::string bytes(line.begin(), line.end());
+
+        HANDLE file = CreateFileW(path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                  OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            DWORD written = 0;
+            WriteFile(file, bytes.data(), static_cast<DWORD>(bytes.size()), &written, nullptr);
+            CloseHandle(file);
+        }
+    }
+
+    struct CallLatency
+    {
+        double p50;
+        double p99;
+        double max;
+    };
+
+    template <typename Call>
+    CallLatency MeasureCalls(int calls, Call call)
+    {
+        std::vector<double> samples;
+        samples.reserve(static_cast<size_t>(calls));
+        for (int i = 0; i < calls; ++i)
+        {
+            auto begin = std::chrono::steady_clock::now();
+            call(i);
+            samples.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count());
+        }
+        std::sort(samples.begin(), samples.end());
+        return CallLatency{ samples[samples.size() / 2], samples[(samples.size() * 99) / 100], samples.back() };
+    }
+
+    // Lines per second from threads callers, each making calls calls
+    template <typename Call>
+    double MeasureThroughput(int threads, int calls, Call call)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        std::vector<std::thread> callers;
+        for (int t = 0; t < threads; ++t)
+        {
+            callers.emplace_back([&call, calls]() {
+                for (int i = 0; i < calls; ++i)
+                {
+                    call(i);
+                }
+            });
+        }
+        for (std::thread& caller : callers)
+        {
+            caller.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        return (seconds > 0.0) ? (threads * calls) / seconds : 0.0;
+    }
+
+    void BenchmarkAgainstDirectAppend()
+    {
+        const int calls = 20000;
+        const int threads = 4;
+        std::wstring directPath = TempFilePath(L"nm_diaglog_bench_direct.log");
+        std::wstring asyncPath = TempFilePath(L"nm_diaglog_bench_async.log");
+        DeleteFileW(directPath.c_str());
+        DeleteFileW(asyncPath.c_str());
+
+        auto message = [](int i) { return L"HistoryLogger::ApplyWriteBatch: committed " + std::to_wstring(i) + L" rows"; };
+
+        CallLatency direct = MeasureCalls(calls, [&](int i) { AppendLineDirect(directPath, message(i)); });
+        double directRate = MeasureThroughput(threads, calls / 4, [&](int i) { AppendLineDirect(directPath, message(i)); });
+
+        CallLatency async;
+        double asyncRate = 0.0;
+        DiagnosticLogStats stats;
+        {
+            DiagnosticLog log(Options(asyncPath, DiagnosticLogOptions().capacity, 1000));
+            async = MeasureCalls(calls, [&](int i) { log.Push(LogLevel::Debug, message(i)); });
+            log.Flush();
+
+            // Lines that reached the file, including the wait for the last
+            // batch; dropped records do not count
+            unsigned long long writtenBefore = log.GetStats().written;
+            auto begin = std::chrono::steady_clock::now();
+            MeasureThroughput(threads, calls, [&](int i) { log.Push(LogLevel::Debug, message(i)); });
+            log.Flush();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            stats = log.GetStats();
+            asyncRate = (seconds > 0.0) ? (stats.written - writtenBefore) / seconds : 0.0;
+        }
+
+        wchar_t msg[400] = {0};
+        swprintf(msg, 400,
+                 L"[bench] log call p50/p99/max ns: open-append-close %.0f/%.0f/%.0f, ring %.0f/%.0f/%.0f; "
+                 L"%d threads: %.0f vs %.0f lines/s written (ring dropped %llu of %d, %llu writes)",
+                 direct.p50, direct.p99, direct.max, async.p50, async.p99, async.max,
+                 threads, directRate, asyncRate, stats.dropped, calls + threads * calls, stats.writes);
+        LogTestMessage(msg);
+
+        DeleteFileW(directPath.c_str());
+        DeleteFileW(asyncPath.c_str());
+    }
+}
+
+void RunDiagnosticLogTests()
+{
+    LogTestMessage(L"=== DiagnosticLog tests ===");
+
+    TestLineFormat();
+    TestErrorWritesImmediately();
+    TestErrorsFromManyThreadsWake();
+    TestTimerFlush();
+    TestConcurrentProducers();
+    TestOverflowIsCounted();
+    BenchmarkAgainstDirectAppend();
+}
+
+} // namespace NetworkMonitorTests
@@ -0,0 +1,441 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/HistoryLogger.h"
+#include "NetworkMonitor/HistoryStatistics.h"
+#include "TestUtils.h"
+#include "sqlite3.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <cwchar>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    const wchar_t* const BACKUP_IFACE = L"BackupEth";
+
+    constexpr long long DAY_SECONDS = 24LL * 60 * 60;
+
+    // Rows for the consistency test: enough for a few hundred small steps
+    constexpr long long BACKUP_TEST_ROWS = 200000;
+
+    // Rows for the latency benchmark, a couple of hundred MB on disk. The
+    // multi-GB case is the same loop with more steps; per-step cost and
+    // pause are what the writer sees.
+    constexpr long long BACKUP_BENCH_ROWS = 2000000;
+
+    std::wstring IntegrityCheck(const std::wstring& path)
+    {
+        sqlite3* db = nullptr;
+        std::wstring result;
+        if (sqlite3_open16(path.c_str(), &db) == SQLITE_OK)
+        {
+            sqlite3_stmt* stmt = nullptr;
+            if (sqlite3_prepare_v2(db, "PRAGMA integrity_check;", -1, &stmt, nullptr) == SQLITE_OK)
+            {
+                if (sqlite3_step(stmt) == SQLITE_ROW)
+                {
+                    const unsigned char* text = sqlite3_column_text(stmt, 0);
+                    for (const unsigned char* c = text; c && *c; ++c)
+                    {
+                        result += static_cast<wchar_t>(*c);
+                    }
+                }
+                sqlite3_finalize(stmt);
+            }
+        }
+        sqlite3_close(db);
+        return result;
+    }
+
+    // Bytes down across every interface and all time, or -1
+    long long AllTimeDown()
+    {
+        TopKQuery query;
+        query.from = 1;
+        query.to = std::time(nullptr) + DAY_SECONDS;
+        std::vector<RankedInterface> ranked;
+        if (!HistoryLogger::Instance().GetTopInterfaces(query, ranked))
+        {
+            return -1;
+        }
+        long long total = 0;
+        for (const RankedInterface& entry : ranked)
+        {
+            total += static_cast<long long>(entry.bytesDown);
+        }
+        return total;
+    }
+
+    // count one-second samples ending two days back, with varying bytes
+    bool ImportRows(long long count)
+    {
+        long long start = static_cast<long long>(std::time(nullptr)) - 2 * DAY_SECONDS - count;
+        HistoryImportOptions options;
+        options.progressInterval = 0;
+        return HistoryLogger::Instance().ImportSamples([&](const HistorySampleVisitor& sink) {
+            HistorySampleView row = {};
+            row.interfaceName = BACKUP_IFACE;
+            for (long long i = 0; i < count; ++i)
+            {
+                row.timestamp = static_cast<std::time_t>(start + i);
+                row.bytesDown = 1000 + static_cast<unsigned long long>((i * 7919) % 50000);
+                row.bytesUp = 100 + static_cast<unsigned long long>((i * 104729) % 5000);
+                if (!sink(row))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }, options);
+    }
+
+    // Appends and flushes one sample at a time until stopped, so the
+    // database keeps changing under whatever runs meanwhile
+    class BusyWriter
+    {
+    public:
+        BusyWriter()
+            : m_stop(false)
+            , m_samples(0)
+            , m_thread([this]() { Run(); })
+        {
+        }
+
+        ~BusyWriter()
+        {
+            Stop();
+        }
+
+        void Stop()
+        {
+            m_stop = true;
+            if (m_thread.joinable())
+            {
+                m_thread.join();
+            }
+        }
+
+        unsigned long long Samples() const { return m_samples.load(); }
+
+        // AppendSample + Flush round trips, in microseconds
+        const std::vector<double>& Latencies() const { return m_latencies; }
+
+    private:
+        void Run()
+        {
+            HistoryLogger& logger = HistoryLogger::Instance();
+            while (!m_stop)
+            {
+                auto begin = std::chrono::steady_clock::now();
+                logger.AppendSample(BACKUP_IFACE, 4096, 512);
+                logger.Flush();
+                m_latencies.push_back(std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - begin).count());
+                ++m_samples;
+            }
+        }
+
+        std::atomic<bool> m_stop;
+        std::atomic<unsigned long long> m_samples;
+        std::vector<double> m_latencies;
+        std::thread m_thread;
+    };
+
+    void TestBackupCopiesDatabase()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        AssertTrue(logger.DeleteAll(), L"HistoryLogger backup: DeleteAll before copy test");
+        AssertTrue(ImportRows(5000), L"HistoryLogger backup: rows import");
+
+        std::wstring path = TempFilePath(L"nm_backup_copy.db");
+        DeleteFileW(path.c_str());
+
+        HistoryBackupStats stats;
+        AssertTrue(logger.BackupTo(path, HistoryBackupOptions(), &stats),
+                   L"HistoryLogger backup: BackupTo succeeds");
+        AssertTrue(stats.pagesTotal > 0 && stats.pagesCopied == stats.pagesTotal && stats.steps > 0,
+                   L"HistoryLogger backup: stats count every page");
+        AssertTrue(!FileExists(path + L".partial"), L"HistoryLogger backup: partial file renamed away");
+
+        AssertTrue(QueryDatabase(path, "SELECT COUNT(*) FROM usage;") == 5000,
+                   L"HistoryLogger backup: copy holds every row");
+        long long liveDown = AllTimeDown();
+        AssertTrue(liveDown > 0 && QueryDatabase(path, "SELECT SUM(bytes_down) FROM usage;") == liveDown,
+                   L"HistoryLogger backup: copy sums match the live database");
+        AssertTrue(IntegrityCheck(path) == L"ok", L"HistoryLogger backup: copy passes integrity_check");
+
+        std::wstring journalMode;
+        {
+            sqlite3* db = nullptr;
+            sqlite3_open16(path.c_str(), &db);
+            sqlite3_stmt* stmt = nullptr;
+            if (sqlite3_prepare_v2(db, "PRAGMA journal_mode;", -1, &stmt, nullptr) == SQLITE_OK &&
+                sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                const unsigned char* text = sqlite3_column_text(stmt, 0);
+                for (const unsigned char* c = text; c && *c; ++c)
+                {
+                    journalMode += static_cast<wchar_t>(*c);
+                }
+            }
+            sqlite3_finalize(stmt);
+            sqlite3_close(db);
+        }
+        AssertTrue(journalMode == L"delete", L"HistoryLogger backup: copy is a standalone rollback-journal file");
+
+        // A second backup replaces the first
+        AssertTrue(logger.BackupTo(path), L"HistoryLogger backup: BackupTo over an existing file");
+        AssertTrue(QueryDatabase(path, "SELECT COUNT(*) FROM usage;") == 5000,
+                   L"HistoryLogger backup: replaced copy is complete");
+
+        DeleteFileW(path.c_str());
+    }
+
+    void TestBackupIsConsistentUnderWrites()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        AssertTrue(logger.DeleteAll(), L"HistoryLogger backup: DeleteAll before consistency test");
+        AssertTrue(ImportRows(BACKUP_TEST_ROWS), L"HistoryLogger backup: large import");
+
+        std::wstring path = TempFilePath(L"nm_backup_consistent.db");
+        DeleteFileW(path.c_str());
+
+        HistoryBackupOptions options;
+        options.pagesPerStep = 8;
+        options.pauseMs = 1;
+
+        HistoryBackupStats stats;
+        bool ok = false;
+        unsigned long long written = 0;
+        {
+            BusyWriter writer;
+            ok = logger.BackupTo(path, options, &stats);
+            writer.Stop();
+            written = writer.Samples();
+        }
+
+        AssertTrue(ok, L"HistoryLogger backup: BackupTo succeeds while the writer commits");
+        AssertTrue(written > 0, L"HistoryLogger backup: the writer kept committing during the copy");
+        AssertTrue(stats.steps > 100, L"HistoryLogger backup: copy ran in many small steps");
+        AssertTrue(IntegrityCheck(path) == L"ok", L"HistoryLogger backup: copy under writes passes integrity_check");
+
+        // Raw rows and the minute rollup are written in the same commit, so
+        // a copy of one point in time has them agree
+        long long rawDown = QueryDatabase(path, "SELECT SUM(bytes_down) FROM usage;");
+        long long minuteDown = QueryDatabase(path, "SELECT SUM(bytes_down) FROM usage_minute;");
+        AssertTrue(rawDown > 0 && rawDown == minuteDown,
+                   L"HistoryLogger backup: copy is a single point in time");
+        AssertTrue(QueryDatabase(path, "SELECT COUNT(*) FROM usage;") >= BACKUP_TEST_ROWS,
+                   L"HistoryLogger backup: copy holds every imported row");
+
+        DeleteFileW(path.c_str());
+    }
+
+    void TestBackupCancel()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        AssertTrue(logger.DeleteAll(), L"HistoryLogger backup: DeleteAll before cancel test");
+        AssertTrue(ImportRows(20000), L"HistoryLogger backup: rows import for cancel");
+
+        std::wstring path = TempFilePath(L"nm_backup_cancel.db");
+        DeleteFileW(path.c_str());
+
+        HistoryBackupOptions options;
+        options.pagesPerStep = 4;
+        options.pauseMs = 0;
+        int calls = 0;
+        options.progress = [&calls](unsigned long long, unsigned long long) {
+            return ++calls < 3;
+        };
+
+        AssertTrue(!logger.BackupTo(path, options), L"HistoryLogger backup: progress returning false stops");
+        AssertTrue(calls == 3, L"HistoryLogger backup: no steps after the stop");
+        AssertTrue(!FileExists(path) && !FileExists(path + L".partial"),
+                   L"HistoryLogger backup: stopped backup leaves no file");
+    }
+
+    void TestBackupAsync()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        AssertTrue(logger.DeleteAll(), L"HistoryLogger backup: DeleteAll before async test");
+        AssertTrue(ImportRows(3000), L"HistoryLogger backup: rows import for async");
+
+        std::wstring path = TempFilePath(L"nm_backup_async.db");
+        DeleteFileW(path.c_str());
+
+        AsyncQueryResult<HistoryBackupStats> result = logger.BackupToAsync(path).get();
+        AssertTrue(result.ok && !result.cancelled, L"HistoryLogger backup: BackupToAsync succeeds");
+        AssertTrue(result.value.pagesCopied > 0 && result.value.pagesCopied == result.value.pagesTotal,
+                   L"HistoryLogger backup: BackupToAsync reports its stats");
+        AssertTrue(QueryDatabase(path, "SELECT COUNT(*) FROM usage;") == 3000,
+                   L"HistoryLogger backup: async copy is complete");
+
+        DeleteFileW(path.c_str());
+    }
+
+    void CheckSnapshot(HistorySnapshotMode mode, const wchar_t* name)
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        std::wstring prefix = std::wstring(L"HistoryLogger snapshot (") + name + L"): ";
+        AssertTrue(logger.DeleteAll(), (prefix + L"DeleteAll").c_str());
+
+        logger.AppendSample(BACKUP_IFACE, 1000, 100);
+        logger.Flush();
+
+        unsigned long long down = 0;
+        unsigned long long up = 0;
+        {
+            std::unique_ptr<HistorySnapshot> snapshot = logger.OpenSnapshot(mode);
+            AssertTrue(snapshot != nullptr, (prefix + L"opens").c_str());
+            if (!snapshot)
+            {
+                return;
+            }
+            AssertTrue(snapshot->Mode() == mode, (prefix + L"reports its mode").c_str());
+
+            logger.AppendSample(BACKUP_IFACE, 2000, 200);
+            logger.Flush();
+
+            AssertTrue(logger.GetTotalsToday(down, up) && down == 1000 && up == 100,
+                       (prefix + L"queries see the point in time it was opened").c_str());
+            AssertTrue(AllTimeDown() == 1000,
+                       (prefix + L"every query reads the same view").c_str());
+
+            // Nested snapshots share the view and close in order
+            {
+                std::unique_ptr<HistorySnapshot> nested = logger.OpenSnapshot();
+                AssertTrue(nested != nullptr && logger.GetTotalsToday(down, up) && down == 1000,
+                           (prefix + L"nested snapshot shares the view").c_str());
+            }
+            AssertTrue(logger.GetTotalsToday(down, up) && down == 1000,
+                       (prefix + L"outer view survives the nested one").c_str());
+
+            // Other threads read the live database meanwhile
+            unsigned long long otherDown = 0;
+            std::thread other([&]() {
+                unsigned long long otherUp = 0;
+                logger.GetTotalsToday(otherDown, otherUp);
+            });
+            other.join();
+            AssertTrue(otherDown == 3000, (prefix + L"other threads see new samples").c_str());
+
+            AsyncQueryResult<UsageTotals> async = logger.GetTotalsTodayAsync(std::wstring()).get();
+            AssertTrue(async.ok && async.value.bytesDown == 3000,
+                       (prefix + L"async queries read the live database").c_str());
+        }
+
+        AssertTrue(logger.GetTotalsToday(down, up) && down == 3000,
+                   (prefix + L"closing it returns to live reads").c_str());
+    }
+
+    void TestSnapshots()
+    {
+        CheckSnapshot(HistorySnapshotMode::ReadTransaction, L"read transaction");
+        CheckSnapshot(HistorySnapshotMode::PrivateCopy, L"private copy");
+    }
+
+    struct LatencySummary
+    {
+        double p50;
+        double p99;
+        double max;
+        size_t count;
+    };
+
+    LatencySummary Summarize(std::vector<double> latencies)
+    {
+        LatencySummary summary = { 0.0, 0.0, 0.0, latencies.size() };
+        if (latencies.empty())
+        {
+            return summary;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        summary.p50 = latencies[latencies.size() / 2];
+        summary.p99 = latencies[(latencies.size() * 99) / 100];
+        summary.max = latencies.back();
+        return summary;
+    }
+
+    // Writer latency while idle, then while a paced and an unpaced backup run
+    void BenchmarkWriterLatencyDuringBackup()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        logger.DeleteAll();
+        ImportRows(BACKUP_BENCH_ROWS);
+
+        std::wstring path = TempFilePath(L"nm_backup_bench.db");
+
+        LatencySummary baseline;
+        {
+            BusyWriter writer;
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            writer.Stop();
+            baseline = Summarize(writer.Latencies());
+        }
+
+        auto measure = [&](const HistoryBackupOptions& options, HistoryBackupStats& stats) {
+            DeleteFileW(path.c_str());
+            BusyWriter writer;
+            logger.BackupTo(path, options, &stats);
+            writer.Stop();
+            return Summarize(writer.Latencies());
+        };
+
+        HistoryBackupStats pacedStats;
+        LatencySummary paced = measure(HistoryBackupOptions(), pacedStats);
+
+        HistoryBackupOptions unpacedOptions;
+        unpacedOptions.pagesPerStep = -1;
+        unpacedOptions.pauseMs = 0;
+        HistoryBackupStats unpacedStats;
+        LatencySummary unpaced = measure(unpacedOptions, unpacedStats);
+
+        double megabytes = static_cast<double>(FileSize(path)) / (1024.0 * 1024.0);
+        auto rate = [megabytes](const HistoryBackupStats& stats) {
+            return (stats.elapsedMicroseconds > 0) ? megabytes * 1e6 / stats.elapsedMicroseconds : 0.0;
+        };
+
+        AssertTrue(pacedStats.pagesCopied > 0 && pacedStats.pagesCopied == pacedStats.pagesTotal,
+                   L"HistoryLogger backup: benchmark copy completes");
+
+        wchar_t msg[512] = {0};
+        swprintf(msg, 512,
+                 L"[bench] backup of %.0f MB (%lld rows): append+flush p50/p99/max us: "
+                 L"idle %.0f/%.0f/%.0f (%zu); paced %.0f/%.0f/%.0f (%zu, %.0f MB/s, longest step %llu us); "
+                 L"unpaced %.0f/%.0f/%.0f (%zu, %.0f MB/s)",
+                 megabytes, BACKUP_BENCH_ROWS,
+                 baseline.p50, baseline.p99, baseline.max, baseline.count,
+                 paced.p50, paced.p99, paced.max, paced.count, rate(pacedStats), pacedStats.longestStepMicroseconds,
+                 unpaced.p50, unpaced.p99, unpaced.max, unpaced.count, rate(unpacedStats));
+        LogTestMessage(msg);
+
+        DeleteFileW(path.c_str());
+        logger.DeleteAll();
+    }
+}
+
+void RunHistoryBackupTests()
+{
+    LogTestMessage(L"=== History backup tests ===");
+
+    TestBackupCopiesDatabase();
+    TestBackupIsConsistentUnderWrites();
+    TestBackupCancel();
+    TestBackupAsync();
+    TestSnapshots();
+    if (BenchmarksEnabled())
+    {
+        BenchmarkWriterLatencyDuringBackup();
+    }
+}
+
+} // namespace NetworkMonitorTests
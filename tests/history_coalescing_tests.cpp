@@ -0,0 +1,505 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/HistoryExport.h"
+#include "NetworkMonitor/HistoryLogger.h"
+#include "NetworkMonitor/HistoryRetention.h"
+#include "NetworkMonitor/HistoryStatistics.h"
+#include "TestUtils.h"
+
+#include <chrono>
+#include <ctime>
+#include <cwchar>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    const wchar_t* const COALESCE_IFACE = L"CoalesceEth";
+
+    constexpr long long DAY_SECONDS = 24LL * 60 * 60;
+
+    struct Traffic
+    {
+        unsigned long long down;
+        unsigned long long up;
+    };
+
+    // Bytes an interface moved in the second ending at t
+    using TrafficPattern = std::function<Traffic(long long t)>;
+
+    HistoryCoalescingOptions Coalescing(double tolerance)
+    {
+        HistoryCoalescingOptions options;
+        options.rateTolerance = tolerance;
+        return options;
+    }
+
+    // One sample of name every step seconds in [from, to), skipping idle
+    // seconds as AppendSample does
+    bool ImportTraffic(const wchar_t* name, long long from, long long to, long long step,
+                       const TrafficPattern& pattern, const HistoryCoalescingOptions& coalescing)
+    {
+        HistoryImportOptions options;
+        options.progressInterval = 0;
+        options.coalescing = coalescing;
+        return HistoryLogger::Instance().ImportSamples([&](const HistorySampleVisitor& sink) {
+            HistorySampleView row = {};
+            row.interfaceName = name;
+            for (long long t = from; t < to; t += step)
+            {
+                Traffic traffic = pattern(t);
+                if (traffic.down == 0 && traffic.up == 0)
+                {
+                    continue;
+                }
+                row.timestamp = static_cast<std::time_t>(t);
+                row.bytesDown = traffic.down;
+                row.bytesUp = traffic.up;
+                if (!sink(row))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }, options);
+    }
+
+    // Sum of the pattern's samples in [from, to)
+    Traffic PatternTotal(long long from, long long to, long long step, const TrafficPattern& pattern)
+    {
+        Traffic total = { 0, 0 };
+        for (long long t = from; t < to; t += step)
+        {
+            Traffic traffic = pattern(t);
+            total.down += traffic.down;
+            total.up += traffic.up;
+        }
+        return total;
+    }
+
+    bool InterfaceTotal(long long from, long long to, Traffic& out)
+    {
+        TopKQuery query;
+        query.from = static_cast<std::time_t>(from);
+        query.to = static_cast<std::time_t>(to);
+        std::vector<RankedInterface> ranked;
+        if (!HistoryLogger::Instance().GetTopInterfaces(query, ranked))
+        {
+            return false;
+        }
+        out.down = 0;
+        out.up = 0;
+        for (const RankedInterface& entry : ranked)
+        {
+            out.down += entry.bytesDown;
+            out.up += entry.bytesUp;
+        }
+        return true;
+    }
+
+    long long UsageRows()
+    {
+        return QueryDatabase("SELECT COUNT(*) FROM usage;");
+    }
+
+    // A whole minute, two days back, well clear of today's boundaries
+    long long PastMinute()
+    {
+        long long now = static_cast<long long>(std::time(nullptr));
+        return HourStart(now - 2 * DAY_SECONDS);
+    }
+
+    Traffic Steady(long long)
+    {
+        return Traffic{ 12000, 800 };
+    }
+
+    // Within 2% of 12000 and 800 bytes per second
+    Traffic Wobbly(long long t)
+    {
+        return Traffic{ 12000 + static_cast<unsigned long long>((t * 37) % 240),
+                        800 + static_cast<unsigned long long>((t * 11) % 16) };
+    }
+
+    // Deterministic pseudo-random bytes, never steady
+    Traffic Bursty(long long t)
+    {
+        unsigned long long x = static_cast<unsigned long long>(t) * 6364136223846793005ULL + 1442695040888963407ULL;
+        x ^= x >> 29;
+        return Traffic{ (x % 4000000ULL) + 1, ((x >> 24) % 200000ULL) + 1 };
+    }
+
+    void TestSteadyRunsShareRows()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        AssertTrue(logger.DeleteAll(), L"HistoryLogger coalescing: DeleteAll before steady-run test");
+
+        // One hour of one-second samples
+        long long start = PastMinute();
+        long long end = start + 3600;
+        AssertTrue(ImportTraffic(COALESCE_IFACE, start, end, 1, Wobbly, Coalescing(0.05)),
+                   L"HistoryLogger coalescing: steady traffic imports");
+
+        long long rows = UsageRows();
+        AssertTrue(rows == 60, L"HistoryLogger coalescing: steady traffic takes one row per minute");
+        AssertTrue(QueryDatabase("SELECT COUNT(*) FROM usage WHERE timestamp / 60 <> (timestamp + span_seconds) / 60;") == 0,
+                   L"HistoryLogger coalescing: no span crosses a minute boundary");
+        AssertTrue(QueryDatabase("SELECT SUM(samples) FROM usage;") == 3600,
+                   L"HistoryLogger coalescing: spans count every merged sample");
+
+        Traffic expected = PatternTotal(start, end, 1, Wobbly);
+        Traffic total = { 0, 0 };
+        AssertTrue(InterfaceTotal(start, end, total) && total.down == expected.down && total.up == expected.up,
+                   L"HistoryLogger coalescing: totals over whole minutes are exact");
+
+        // Unaligned ends read the raw rows and split the spans they cut
+        Traffic steadyExpected = PatternTotal(start + 17, end - 23, 1, Steady);
+        logger.DeleteAll();
+        ImportTraffic(COALESCE_IFACE, start, end, 1, Steady, Coalescing(0.05));
+        AssertTrue(InterfaceTotal(start + 17, end - 23, total) &&
+                   total.down == steadyExpected.down && total.up == steadyExpected.up,
+                   L"HistoryLogger coalescing: a range cutting spans gets their samples inside it");
+
+        logger.DeleteAll();
+    }
+
+    void TestSpansBreak()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        logger.DeleteAll();
+
+        long long start = PastMinute();
+
+        // 20 s at 12 kB/s, then 20 s at five times that
+        auto stepUp = [start](long long t) {
+            return (t < start + 20) ? Traffic{ 12000, 800 } : Traffic{ 60000, 800 };
+        };
+        ImportTraffic(COALESCE_IFACE, start, start + 40, 1, stepUp, Coalescing(0.05));
+        AssertTrue(UsageRows() == 2, L"HistoryLogger coalescing: a rate change starts a new span");
+
+        // A 5-second silence in a one-second cadence
+        logger.DeleteAll();
+        auto gap = [start](long long t) {
+            return (t >= start + 20 && t < start + 25) ? Traffic{ 0, 0 } : Traffic{ 12000, 800 };
+        };
+        ImportTraffic(COALESCE_IFACE, start, start + 40, 1, gap, Coalescing(0.05));
+        AssertTrue(UsageRows() == 2, L"HistoryLogger coalescing: a gap in the cadence starts a new span");
+
+        // Upload alone changing is enough
+        logger.DeleteAll();
+        auto upOnly = [start](long long t) {
+            return (t < start + 20) ? Traffic{ 12000, 800 } : Traffic{ 12000, 9000 };
+        };
+        ImportTraffic(COALESCE_IFACE, start, start + 40, 1, upOnly, Coalescing(0.05));
+        AssertTrue(UsageRows() == 2, L"HistoryLogger coalescing: either direction's rate breaks a span");
+
+        // Keep-alive trickles within the absolute slack count as steady
+        logger.DeleteAll();
+        auto trickle = [](long long t) {
+            return Traffic{ static_cast<unsigned long long>(60 + (t * 7) % 50), 40 };
+        };
+        ImportTraffic(COALESCE_IFACE, start, start + 60, 1, trickle, Coalescing(0.05));
+        AssertTrue(UsageRows() == 1, L"HistoryLogger coalescing: keep-alive trickles merge within the slack");
+
+        // Coalescing off stores every sample
+        logger.DeleteAll();
+        ImportTraffic(COALESCE_IFACE, start, start + 60, 1, Steady, HistoryCoalescingOptions());
+        AssertTrue(UsageRows() == 60, L"HistoryLogger coalescing: off by default");
+
+        logger.DeleteAll();
+    }
+
+    void TestQueriesMatchUncoalesced()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+
+        // Two hours of five-second samples, mostly steady with a burst
+        long long start = PastMinute();
+        long long end = start + 7200;
+        auto mixed = [start](long long t) {
+            return (t >= start + 3000 && t < start + 3300) ? Bursty(t) : Wobbly(t);
+        };
+
+        RateQuery rateQuery;
+        rateQuery.from = static_cast<std::time_t>(start);
+        rateQuery.to = static_cast<std::time_t>(end);
+        rateQuery.bucketSeconds = 300;
+
+        TopKQuery topQuery;
+        topQuery.from = static_cast<std::time_t>(start);
+        topQuery.to = static_cast<std::time_t>(end);
+        topQuery.bucketSeconds = 60;
+        topQuery.k = 10;
+
+        logger.DeleteAll();
+        ImportTraffic(COALESCE_IFACE, start, end, 5, mixed, HistoryCoalescingOptions());
+        long long plainRows = UsageRows();
+        std::vector<InterfaceRateStatistics> plainRates;
+        std::vector<RankedInterval> plainTop;
+        logger.GetRateStatistics(rateQuery, plainRates);
+        logger.GetTopIntervals(topQuery, plainTop);
+
+        logger.DeleteAll();
+        ImportTraffic(COALESCE_IFACE, start, end, 5, mixed, Coalescing(0.05));
+        long long coalescedRows = UsageRows();
+        std::vector<InterfaceRateStatistics> coalescedRates;
+        std::vector<RankedInterval> coalescedTop;
+        AssertTrue(logger.GetRateStatistics(rateQuery, coalescedRates) &&
+                   logger.GetTopIntervals(topQuery, coalescedTop),
+                   L"HistoryLogger coalescing: statistics queries succeed over spans");
+
+        AssertTrue(coalescedRows * 5 < plainRows,
+                   L"HistoryLogger coalescing: mostly steady history needs a fraction of the rows");
+
+        bool ratesMatch = (plainRates.size() == 1 && coalescedRates.size() == 1 &&
+                           plainRates[0].down.p95 == coalescedRates[0].down.p95 &&
+                           plainRates[0].down.max == coalescedRates[0].down.max &&
+                           plainRates[0].up.mean == coalescedRates[0].up.mean);
+        AssertTrue(ratesMatch, L"HistoryLogger coalescing: minute-aligned rate statistics are unchanged");
+
+        bool topMatch = (plainTop.size() == coalescedTop.size());
+        for (size_t i = 0; topMatch && i < plainTop.size(); ++i)
+        {
+            topMatch = (plainTop[i].start == coalescedTop[i].start &&
+                        plainTop[i].bytesDown == coalescedTop[i].bytesDown &&
+                        plainTop[i].bytesUp == coalescedTop[i].bytesUp);
+        }
+        AssertTrue(topMatch, L"HistoryLogger coalescing: top intervals are unchanged");
+
+        // Unaligned buckets read raw rows: spans are spread over their
+        // samples, so only the total is exact
+        RateQuery rawQuery = rateQuery;
+        rawQuery.from = static_cast<std::time_t>(start + 7);
+        rawQuery.bucketSeconds = 7;
+        std::vector<InterfaceRateStatistics> rawRates;
+        Traffic expected = PatternTotal(start + 10, end, 5, mixed);
+        AssertTrue(logger.GetRateStatistics(rawQuery, rawRates) && rawRates.size() == 1,
+                   L"HistoryLogger coalescing: raw-row rate statistics succeed");
+        Traffic total = { 0, 0 };
+        AssertTrue(InterfaceTotal(start + 7, end, total) && total.down + 500 >= expected.down &&
+                   total.down <= expected.down + 500,
+                   L"HistoryLogger coalescing: totals over a cut span stay within its wobble");
+
+        logger.DeleteAll();
+    }
+
+    void TestSamplesExpandForReaders()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        logger.DeleteAll();
+
+        long long start = PastMinute();
+        ImportTraffic(COALESCE_IFACE, start, start + 120, 2, Steady, Coalescing(0.05));
+        AssertTrue(UsageRows() == 2, L"HistoryLogger coalescing: a two-second cadence coalesces too");
+
+        std::vector<HistorySample> recent;
+        AssertTrue(logger.GetRecentSamples(10, recent) && recent.size() == 10,
+                   L"HistoryLogger coalescing: GetRecentSamples returns samples, not spans");
+        bool newestFirst = !recent.empty() && recent[0].timestamp == static_cast<std::time_t>(start + 118);
+        for (size_t i = 0; newestFirst && i < recent.size(); ++i)
+        {
+            newestFirst = recent[i].timestamp == static_cast<std::time_t>(start + 118 - 2 * static_cast<long long>(i)) &&
+                          recent[i].bytesDown == 12000 && recent[i].bytesUp == 800;
+        }
+        AssertTrue(newestFirst, L"HistoryLogger coalescing: recent samples keep their times and bytes");
+
+        std::wstring path = TempFilePath(L"nm_coalesce_export.csv");
+        unsigned long long exported = 0;
+        AssertTrue(logger.ExportHistory(path, HistoryExportFormat::Csv, 0, 0, nullptr, &exported) && exported == 60,
+                   L"HistoryLogger coalescing: export writes one row per sample");
+
+        exported = 0;
+        logger.ExportHistory(path, HistoryExportFormat::Csv, static_cast<std::time_t>(start + 31),
+                             static_cast<std::time_t>(start + 91), nullptr, &exported);
+        AssertTrue(exported == 30, L"HistoryLogger coalescing: export ranges cut spans at sample times");
+        DeleteFileW(path.c_str());
+
+        logger.DeleteAll();
+    }
+
+    // A span of one interface next to plain rows of another: the recent
+    // list is the newest samples of both, in time order
+    void TestRecentSamplesMixInterfaces()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        logger.DeleteAll();
+
+        const wchar_t* const plainIface = L"CoalesceWifi";
+        long long start = PastMinute();
+        ImportTraffic(COALESCE_IFACE, start, start + 60, 1, Steady, Coalescing(0.05));
+        ImportTraffic(plainIface, start, start + 60, 1, Bursty, Coalescing(0.05));
+        AssertTrue(UsageRows() == 61, L"HistoryLogger coalescing: one span next to 60 plain rows");
+
+        std::vector<HistorySample> recent;
+        AssertTrue(logger.GetRecentSamples(100, recent) && recent.size() == 100,
+                   L"HistoryLogger coalescing: GetRecentSamples over two interfaces succeeds");
+
+        // Each second from start + 59 down to start + 10, once per interface
+        bool ordered = (recent.size() == 100);
+        for (size_t i = 0; ordered && i < recent.size(); i += 2)
+        {
+            std::time_t expected = static_cast<std::time_t>(start + 59 - static_cast<long long>(i / 2));
+            ordered = recent[i].timestamp == expected && recent[i + 1].timestamp == expected &&
+                      recent[i].interfaceName != recent[i + 1].interfaceName;
+        }
+        AssertTrue(ordered, L"HistoryLogger coalescing: recent samples across interfaces are the newest, newest first");
+
+        logger.DeleteAll();
+    }
+
+    void TestTrimSplitsSpan()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        logger.DeleteAll();
+
+        // A minute of samples around the one-day trim cutoff; retry if the
+        // clock ticks between import and trim
+        bool checked = false;
+        for (int attempt = 0; attempt < 3 && !checked; ++attempt)
+        {
+            long long cutoff = static_cast<long long>(std::time(nullptr)) - DAY_SECONDS;
+            long long minute = cutoff - ((cutoff % 60 + 60) % 60);
+            ImportTraffic(COALESCE_IFACE, minute, minute + 60, 1, Steady, Coalescing(0.05));
+            logger.TrimToRecentDays(1);
+            long long after = static_cast<long long>(std::time(nullptr)) - DAY_SECONDS;
+            if (after != cutoff)
+            {
+                logger.DeleteAll();
+                continue;
+            }
+
+            long long kept = minute + 60 - cutoff;
+            AssertTrue(QueryDatabase("SELECT SUM(samples) FROM usage;") == kept &&
+                       QueryDatabase("SELECT SUM(bytes_down) FROM usage;") == kept * 12000 &&
+                       QueryDatabase("SELECT MIN(timestamp) FROM usage;") == cutoff,
+                       L"HistoryLogger coalescing: trimming keeps a span's samples after the cutoff");
+            checked = true;
+        }
+        AssertTrue(checked, L"HistoryLogger coalescing: trim test ran");
+
+        logger.DeleteAll();
+    }
+
+    void TestLiveWritePath()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        logger.DeleteAll();
+        AssertTrue(logger.SetCoalescingOptions(Coalescing(0.05)),
+                   L"HistoryLogger coalescing: SetCoalescingOptions succeeds");
+
+        // Four one-second ticks, each committed before the next; at most
+        // one minute boundary falls in between
+        for (int tick = 0; tick < 4; ++tick)
+        {
+            logger.AppendSample(COALESCE_IFACE, 5000, 300);
+            logger.Flush();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        }
+
+        unsigned long long down = 0;
+        unsigned long long up = 0;
+        std::wstring filter = COALESCE_IFACE;
+        AssertTrue(logger.GetTotalsToday(down, up, &filter) && down == 20000 && up == 1200,
+                   L"HistoryLogger coalescing: live totals are exact");
+        long long rows = UsageRows();
+        AssertTrue(rows >= 1 && rows <= 2, L"HistoryLogger coalescing: live ticks extend the open span");
+
+        logger.SetCoalescingOptions(HistoryCoalescingOptions());
+        logger.DeleteAll();
+    }
+
+    struct WriteRun
+    {
+        long long rows;
+        double samplesPerSecond;
+        double queryMicros;
+    };
+
+    // A day of one-second samples on four interfaces: idle keep-alives,
+    // a steady stream, a wobbly download and a bursty one
+    WriteRun MeasureDay(const HistoryCoalescingOptions& coalescing)
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        logger.DeleteAll();
+
+        long long start = PastMinute() - DAY_SECONDS;
+        long long end = start + DAY_SECONDS;
+        auto keepAlive = [](long long t) {
+            return (t % 30 < 3) ? Traffic{ 90, 60 } : Traffic{ 0, 0 };
+        };
+        auto bursty = [start](long long t) {
+            return ((t - start) % 3600 < 300) ? Bursty(t) : Traffic{ 0, 0 };
+        };
+
+        auto begin = std::chrono::steady_clock::now();
+        ImportTraffic(L"BenchIdle", start, end, 1, keepAlive, coalescing);
+        ImportTraffic(L"BenchStream", start, end, 1, Steady, coalescing);
+        ImportTraffic(L"BenchWobbly", start, end, 1, Wobbly, coalescing);
+        ImportTraffic(L"BenchBursty", start, end, 1, bursty, coalescing);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        long long samples = 0;
+        for (long long t = start; t < end; ++t)
+        {
+            samples += 2 + (keepAlive(t).down != 0 ? 1 : 0) + (bursty(t).down != 0 ? 1 : 0);
+        }
+
+        // One-second buckets read every raw row
+        RateQuery query;
+        query.from = static_cast<std::time_t>(start + 1);
+        query.to = static_cast<std::time_t>(end);
+        query.bucketSeconds = 1;
+        std::vector<InterfaceRateStatistics> stats;
+        auto queryBegin = std::chrono::steady_clock::now();
+        logger.GetRateStatistics(query, stats);
+        double queryMicros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - queryBegin).count();
+
+        WriteRun run;
+        run.rows = UsageRows();
+        run.samplesPerSecond = (seconds > 0.0) ? samples / seconds : 0.0;
+        run.queryMicros = queryMicros;
+        return run;
+    }
+
+    void BenchmarkRowCounts()
+    {
+        WriteRun plain = MeasureDay(HistoryCoalescingOptions());
+        WriteRun coalesced = MeasureDay(Coalescing(0.05));
+
+        AssertTrue(coalesced.rows > 0 && coalesced.rows * 10 < plain.rows,
+                   L"HistoryLogger coalescing: a quiet day needs an order of magnitude fewer rows");
+
+        wchar_t msg[320] = {0};
+        swprintf(msg, 320,
+                 L"[bench] 1 day, 4 interfaces at 1 s: %lld rows plain, %lld coalesced (%.1fx); "
+                 L"writes %.0f vs %.0f samples/s; 1-s rate query %.0f vs %.0f us",
+                 plain.rows, coalesced.rows,
+                 (coalesced.rows > 0) ? static_cast<double>(plain.rows) / coalesced.rows : 0.0,
+                 plain.samplesPerSecond, coalesced.samplesPerSecond, plain.queryMicros, coalesced.queryMicros);
+        LogTestMessage(msg);
+
+        HistoryLogger::Instance().DeleteAll();
+    }
+}
+
+void RunHistoryCoalescingTests()
+{
+    LogTestMessage(L"=== History coalescing tests ===");
+
+    TestSteadyRunsShareRows();
+    TestSpansBreak();
+    TestQueriesMatchUncoalesced();
+    TestSamplesExpandForReaders();
+    TestRecentSamplesMixInterfaces();
+    TestTrimSplitsSpan();
+    TestLiveWritePath();
+    BenchmarkRowCounts();
+}
+
+} // namespace NetworkMonitorTests
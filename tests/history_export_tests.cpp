@@ -0,0 +1,241 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/Utils.h"
+#include "NetworkMonitor/HistoryLogger.h"
+#include "NetworkMonitor/HistoryExport.h"
+#include "TestUtils.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    const wchar_t* FormatName(HistoryExportFormat format)
+    {
+        switch (format)
+        {
+        case HistoryExportFormat::Csv:       return L"csv";
+        case HistoryExportFormat::JsonLines: return L"ndjson";
+        case HistoryExportFormat::Columnar:  return L"columnar";
+        }
+        return L"?";
+    }
+
+    void RunRoundTrip(HistoryExportFormat format, const std::vector<HistorySample>& rows)
+    {
+        std::wstring path = TempFilePath(L"nm_export_roundtrip.tmp");
+        std::wstring label = std::wstring(L"HistoryExport round trip (") + FormatName(format) + L")";
+
+        HistoryExportWriter writer;
+        bool opened = writer.Open(path, format);
+        AssertTrue(opened, (label + L": open").c_str());
+
+        long long id = 0;
+        for (const auto& sample : rows)
+        {
+            HistorySampleView view = {};
+            view.id = ++id;
+            view.timestamp = sample.timestamp;
+            view.interfaceName = sample.interfaceName;
+            view.bytesDown = sample.bytesDown;
+            view.bytesUp = sample.bytesUp;
+            writer.Write(view);
+        }
+        AssertTrue(writer.Close() && writer.GetRowCount() == rows.size(), (label + L": write").c_str());
+
+        size_t index = 0;
+        bool matches = true;
+        bool read = ReadHistoryExport(path, format, [&](const HistorySampleView& row) {
+            if (index >= rows.size())
+            {
+                matches = false;
+                return false;
+            }
+
+            const HistorySample& expected = rows[index++];
+            matches = matches &&
+                      row.id == static_cast<long long>(index) &&
+                      row.timestamp == expected.timestamp &&
+                      row.interfaceName == expected.interfaceName &&
+                      row.bytesDown == expected.bytesDown &&
+                      row.bytesUp == expected.bytesUp;
+            return true;
+        });
+
+        AssertTrue(read && matches && index == rows.size(), (label + L": rows match").c_str());
+        DeleteFileW(path.c_str());
+    }
+
+    // Keys are matched only in key position: interface names that spell a
+    // key, member order and spacing must not confuse the reader
+    void RunJsonKeyChecks()
+    {
+        std::vector<HistorySample> rows;
+        const std::wstring names[] = { L"bytes_down", L"x\",\"bytes_up\":7,\"y", L"timestamp" };
+        for (int i = 0; i < 3; ++i)
+        {
+            HistorySample sample;
+            sample.timestamp = static_cast<std::time_t>(1700000000 + i);
+            sample.interfaceName = names[i];
+            sample.bytesDown = static_cast<unsigned long long>(i) + 11ULL;
+            sample.bytesUp = static_cast<unsigned long long>(i) + 22ULL;
+            rows.push_back(sample);
+        }
+        RunRoundTrip(HistoryExportFormat::JsonLines, rows);
+
+        std::wstring path = TempFilePath(L"nm_export_keys.tmp");
+        {
+            std::ofstream file(std::filesystem::path(path), std::ios::binary | std::ios::trunc);
+            file << "{ \"interface\" : \"bytes_up\", \"bytes_up\": 5,\"timestamp\":1700000000 , \"bytes_down\":4 }\n";
+        }
+        HistorySample read;
+        int count = 0;
+        bool ok = ReadHistoryExport(path, HistoryExportFormat::JsonLines, [&](const HistorySampleView& row) {
+            ++count;
+            read.timestamp = row.timestamp;
+            read.interfaceName = row.interfaceName;
+            read.bytesDown = row.bytesDown;
+            read.bytesUp = row.bytesUp;
+            return true;
+        });
+        AssertTrue(ok && count == 1 && read.timestamp == 1700000000 && read.interfaceName == L"bytes_up" &&
+                   read.bytesDown == 4 && read.bytesUp == 5,
+                   L"ReadHistoryExport reads NDJSON members in any order and spacing");
+        DeleteFileW(path.c_str());
+    }
+
+    // Write synthetic rows straight through the writer so the figure reflects
+    // formatting and I/O cost rather than SQLite scan speed.
+    void RunExportBenchmark(HistoryExportFormat format, unsigned long long rowCount)
+    {
+        std::wstring path = TempFilePath(L"nm_export_bench.tmp");
+        const std::wstring ifaces[] = { L"Ethernet", L"Wi-Fi", L"All Interfaces" };
+
+        auto start = std::chrono::steady_clock::now();
+
+        HistoryExportWriter writer;
+        writer.Open(path, format);
+        HistorySampleView view = {};
+        for (unsigned long long i = 0; i < rowCount; ++i)
+        {
+            view.id = static_cast<long long>(i + 1);
+            view.timestamp = static_cast<std::time_t>(1700000000 + i);
+            view.interfaceName = ifaces[i % 3];
+            view.bytesDown = i * 1337ULL;
+            view.bytesUp = i * 71ULL;
+            writer.Write(view);
+        }
+        bool ok = writer.Close();
+
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        double seconds = std::chrono::duration<double>(elapsed).count();
+
+        unsigned long long bytes = FileSize(path);
+        DeleteFileW(path.c_str());
+
+        AssertTrue(ok && writer.GetRowCount() == rowCount, L"HistoryExport benchmark writes every row");
+
+        if (seconds > 0.0)
+        {
+            std::wstring msg = std::wstring(L"[bench] export ") + FormatName(format) + L": " +
+                               std::to_wstring(rowCount) + L" rows in " +
+                               std::to_wstring(static_cast<unsigned long long>(seconds * 1000.0)) + L" ms, " +
+                               std::to_wstring(static_cast<unsigned long long>(rowCount / seconds)) + L" rows/s, " +
+                               std::to_wstring(static_cast<unsigned long long>(bytes / seconds / (1024.0 * 1024.0))) +
+                               L" MB/s";
+            LogTestMessage(msg.c_str());
+        }
+    }
+}
+
+void RunHistoryExportTests()
+{
+    LogTestMessage(L"=== HistoryExport tests ===");
+
+    // Names exercising CSV quoting, JSON escaping and non-ASCII UTF-8
+    std::vector<HistorySample> rows;
+    const std::wstring names[] = {
+        L"Ethernet",
+        L"Wi-Fi, 5GHz",
+        L"VPN \"corp\"",
+        L"Kết nối\tmạng \U0001F310",
+        L"Back\\slash"
+    };
+    for (int i = 0; i < 40; ++i)
+    {
+        HistorySample sample;
+        sample.timestamp = static_cast<std::time_t>(1700000000 + i * 60);
+        sample.interfaceName = names[i % 5];
+        sample.bytesDown = 18446744073709551615ULL - static_cast<unsigned long long>(i);
+        sample.bytesUp = static_cast<unsigned long long>(i) * 1000ULL;
+        rows.push_back(sample);
+    }
+
+    RunRoundTrip(HistoryExportFormat::Csv, rows);
+    RunRoundTrip(HistoryExportFormat::JsonLines, rows);
+    RunRoundTrip(HistoryExportFormat::Columnar, rows);
+    RunJsonKeyChecks();
+
+    // Columnar blocks hold 8192 rows; cross a block boundary with a new
+    // dictionary entry appearing in the second block.
+    std::vector<HistorySample> manyRows;
+    for (int i = 0; i < 9000; ++i)
+    {
+        HistorySample sample;
+        sample.timestamp = static_cast<std::time_t>(1700000000 + i);
+        sample.interfaceName = (i < 8500) ? names[i % 2] : names[2 + i % 3];
+        sample.bytesDown = static_cast<unsigned long long>(i);
+        sample.bytesUp = static_cast<unsigned long long>(i) * 2ULL;
+        manyRows.push_back(sample);
+    }
+    RunRoundTrip(HistoryExportFormat::Columnar, manyRows);
+
+    HistoryExportFormat parsed = HistoryExportFormat::Csv;
+    AssertTrue(ParseHistoryExportFormat(L"NDJSON", parsed) && parsed == HistoryExportFormat::JsonLines,
+               L"ParseHistoryExportFormat is case-insensitive");
+    AssertTrue(!ParseHistoryExportFormat(L"xml", parsed), L"ParseHistoryExportFormat rejects unknown names");
+
+    // Export straight from the database and read it back
+    HistoryLogger& logger = HistoryLogger::Instance();
+    const std::wstring ifaceName = L"ExportIface";
+    logger.DeleteAll();
+    unsigned long long expectedDown = 0;
+    for (int i = 1; i <= 10; ++i)
+    {
+        logger.AppendSample(ifaceName, static_cast<unsigned long long>(i) * 100ULL, 1ULL);
+        expectedDown += static_cast<unsigned long long>(i) * 100ULL;
+    }
+
+    std::wstring dbExportPath = TempFilePath(L"nm_export_db.tmp");
+    unsigned long long exported = 0;
+    bool okExport = logger.ExportHistory(dbExportPath, HistoryExportFormat::JsonLines, 0, 0, &ifaceName, &exported);
+    AssertTrue(okExport && exported == 10, L"HistoryLogger.ExportHistory writes matching rows");
+
+    unsigned long long readDown = 0;
+    int readRows = 0;
+    ReadHistoryExport(dbExportPath, HistoryExportFormat::JsonLines, [&](const HistorySampleView& row) {
+        ++readRows;
+        readDown += row.bytesDown;
+        return row.interfaceName == ifaceName;
+    });
+    AssertTrue(readRows == 10 && readDown == expectedDown, L"HistoryLogger.ExportHistory output reads back");
+    DeleteFileW(dbExportPath.c_str());
+    logger.DeleteAll();
+
+    if (BenchmarksEnabled())
+    {
+        const unsigned long long benchRows = 1000000ULL;
+        RunExportBenchmark(HistoryExportFormat::Csv, benchRows);
+        RunExportBenchmark(HistoryExportFormat::JsonLines, benchRows);
+        RunExportBenchmark(HistoryExportFormat::Columnar, benchRows);
+    }
+}
+
+} // namespace NetworkMonitorTests
@@ -0,0 +1,189 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/Utils.h"
+#include "NetworkMonitor/HistoryLogger.h"
+#include "NetworkMonitor/HistoryExport.h"
+#include "TestUtils.h"
+
+#include <chrono>
+#include <cwchar>
+#include <string>
+#include <vector>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    const std::wstring IMPORT_IFACES[] = { L"Ethernet", L"Wi-Fi", L"Kết nối VPN" };
+
+    // Deterministic synthetic rows: one per second from base, interfaces
+    // cycling, byte counts derived from the ordinal.
+    HistorySampleProducer SyntheticRows(unsigned long long count, std::time_t base)
+    {
+        return [count, base](const HistorySampleVisitor& sink) {
+            HistorySampleView row = {};
+            for (unsigned long long i = 0; i < count; ++i)
+            {
+                row.timestamp = base + static_cast<std::time_t>(i);
+                row.interfaceName = IMPORT_IFACES[i % 3];
+                row.bytesDown = i;
+                row.bytesUp = i * 2ULL;
+                if (!sink(row))
+                {
+                    return false;
+                }
+            }
+            return true;
+        };
+    }
+
+    bool SumRows(std::time_t from, std::time_t to, unsigned long long& rows,
+                 unsigned long long& sumDown, unsigned long long& sumUp, bool& ordered)
+    {
+        rows = 0;
+        sumDown = 0;
+        sumUp = 0;
+        ordered = true;
+
+        HistoryQuery query;
+        query.from = from;
+        query.to = to;
+
+        std::time_t expected = from;
+        return HistoryLogger::Instance().ForEachSample(query, [&](const HistorySampleView& row) {
+            ordered = ordered && row.timestamp == expected &&
+                      row.interfaceName == IMPORT_IFACES[rows % 3];
+            ++expected;
+            ++rows;
+            sumDown += row.bytesDown;
+            sumUp += row.bytesUp;
+            return true;
+        });
+    }
+
+    unsigned long long BenchmarkRowCount()
+    {
+        // Full-scale runs: also set NETWORKMONITOR_IMPORT_BENCH_ROWS=100000000
+        wchar_t value[32] = {0};
+        DWORD len = GetEnvironmentVariableW(L"NETWORKMONITOR_IMPORT_BENCH_ROWS", value, 32);
+        if (len > 0 && len < 32)
+        {
+            unsigned long long rows = std::wcstoull(value, nullptr, 10);
+            if (rows > 0)
+            {
+                return rows;
+            }
+        }
+        return 1000000ULL;
+    }
+
+    void RunImportBenchmark(unsigned long long rowCount, bool rebuildIndexes)
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        logger.DeleteAll();
+
+        HistoryImportOptions options;
+        options.rebuildIndexes = rebuildIndexes;
+
+        auto start = std::chrono::steady_clock::now();
+        unsigned long long rows = 0;
+        bool ok = logger.ImportSamples(SyntheticRows(rowCount, 1600000000), options, &rows);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        AssertTrue(ok && rows == rowCount, L"HistoryLogger.ImportSamples benchmark imports every row");
+
+        if (seconds > 0.0)
+        {
+            std::wstring msg = std::wstring(L"[bench] import ") +
+                               (rebuildIndexes ? L"(rebuild indexes): " : L"(keep indexes): ") +
+                               std::to_wstring(rowCount) + L" rows in " +
+                               std::to_wstring(static_cast<unsigned long long>(seconds * 1000.0)) + L" ms, " +
+                               std::to_wstring(static_cast<unsigned long long>(rowCount / seconds)) + L" rows/s";
+            LogTestMessage(msg.c_str());
+        }
+
+        logger.DeleteAll();
+    }
+}
+
+void RunHistoryImportTests()
+{
+    LogTestMessage(L"=== HistoryImport tests ===");
+
+    HistoryLogger& logger = HistoryLogger::Instance();
+    AssertTrue(logger.DeleteAll(), L"HistoryLogger.DeleteAll before import tests");
+
+    // Not a multiple of the rows-per-INSERT group or the transaction size,
+    // so partial groups and several commits are both exercised.
+    const unsigned long long count = 10007ULL;
+    const std::time_t base = 1500000000;
+
+    HistoryImportOptions options;
+    options.rowsPerTransaction = 3000;
+    options.rebuildIndexes = true;
+    options.progressInterval = 2500;
+
+    std::vector<unsigned long long> progress;
+    options.progress = [&](unsigned long long rows) {
+        progress.push_back(rows);
+        return true;
+    };
+
+    unsigned long long imported = 0;
+    bool ok = logger.ImportSamples(SyntheticRows(count, base), options, &imported);
+    AssertTrue(ok && imported == count, L"HistoryLogger.ImportSamples inserts every row");
+    AssertTrue(progress.size() == 5 && progress.front() == 2500 && progress.back() == count,
+               L"HistoryLogger.ImportSamples reports progress at the interval and at the end");
+
+    unsigned long long rows = 0;
+    unsigned long long sumDown = 0;
+    unsigned long long sumUp = 0;
+    bool ordered = false;
+    SumRows(base, base + static_cast<std::time_t>(count), rows, sumDown, sumUp, ordered);
+    unsigned long long expectedDown = count * (count - 1) / 2;
+    AssertTrue(rows == count && ordered && sumDown == expectedDown && sumUp == expectedDown * 2,
+               L"HistoryLogger.ImportSamples keeps explicit timestamps, names and byte counts");
+
+    // Index was dropped and rebuilt: range scans still use it and succeed
+    SumRows(base + 100, base + 103, rows, sumDown, sumUp, ordered);
+    AssertTrue(rows == 3 && sumDown == 100 + 101 + 102, L"HistoryLogger range query after index rebuild");
+
+    // Cancelling from the progress callback keeps what was already added
+    logger.DeleteAll();
+    HistoryImportOptions cancelOptions;
+    cancelOptions.progressInterval = 1000;
+    cancelOptions.progress = [](unsigned long long rowsSoFar) { return rowsSoFar < 2000; };
+    ok = logger.ImportSamples(SyntheticRows(count, base), cancelOptions, &imported);
+    SumRows(base, base + static_cast<std::time_t>(count), rows, sumDown, sumUp, ordered);
+    AssertTrue(!ok && imported == 2000 && rows == 2000, L"HistoryLogger.ImportSamples stops when progress returns false");
+
+    // Export, wipe and import the file back
+    std::wstring path;
+    {
+        wchar_t dir[MAX_PATH] = {0};
+        DWORD len = GetTempPathW(MAX_PATH, dir);
+        path = std::wstring(dir, len) + L"nm_import_roundtrip.csv";
+    }
+    unsigned long long exported = 0;
+    logger.ExportHistory(path, HistoryExportFormat::Csv, 0, 0, nullptr, &exported);
+    logger.DeleteAll();
+    ok = logger.ImportHistory(path, HistoryExportFormat::Csv, HistoryImportOptions(), &imported);
+    SumRows(base, base + static_cast<std::time_t>(count), rows, sumDown, sumUp, ordered);
+    AssertTrue(ok && exported == 2000 && imported == 2000 && rows == 2000 && ordered,
+               L"HistoryLogger.ImportHistory loads an exported file");
+    DeleteFileW(path.c_str());
+
+    AssertTrue(!logger.ImportHistory(path, HistoryExportFormat::Csv), L"HistoryLogger.ImportHistory fails for a missing file");
+    logger.DeleteAll();
+
+    if (BenchmarksEnabled())
+    {
+        unsigned long long benchRows = BenchmarkRowCount();
+        RunImportBenchmark(benchRows, false);
+        RunImportBenchmark(benchRows, true);
+    }
+}
+
+} // namespace NetworkMonitorTests
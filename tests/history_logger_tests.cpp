@@ -3,6 +3,10 @@
 #include "NetworkMonitor/HistoryLogger.h"
 #include "TestUtils.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include <vector>
 
 using namespace NetworkMonitor;
@@ -70,6 +74,177 @@ void RunHistoryLoggerTests()
 
     bool trimmed2 = logger.TrimToRecentDays(2);
     AssertTrue(trimmed2, L"HistoryLogger.TrimToRecentDays(2) returns true");
+
+    // Phase C: streaming scans with keyset pagination
+    cleared = logger.DeleteAll();
+    AssertTrue(cleared, L"HistoryLogger.DeleteAll before streaming tests");
+
+    const int streamRows = 25;
+    unsigned long long expectedDown = 0;
+    for (int i = 1; i <= streamRows; ++i)
+    {
+        logger.AppendSample(ifaceName, static_cast<unsigned long long>(i), 1ULL);
+        expectedDown += static_cast<unsigned long long>(i);
+    }
+
+    HistoryQuery fullQuery;
+    fullQuery.interfaceFilter = &ifaceName;
+
+    int visited = 0;
+    unsigned long long streamedDown = 0;
+    bool okStream = logger.ForEachSample(fullQuery, [&](const HistorySampleView& row) {
+        ++visited;
+        streamedDown += row.bytesDown;
+        return row.interfaceName == ifaceName;
+    });
+    AssertTrue(okStream, L"HistoryLogger.ForEachSample returns true");
+    AssertTrue(visited == streamRows && streamedDown == expectedDown,
+               L"HistoryLogger.ForEachSample visits every row once");
+
+    // Page through 4 rows at a time; rows share timestamps, so the id part
+    // of the key must break ties without skipping or repeating rows.
+    HistoryCursor cursor;
+    HistoryQuery pageQuery;
+    pageQuery.interfaceFilter = &ifaceName;
+    pageQuery.limit = 4;
+
+    int paged = 0;
+    unsigned long long pagedDown = 0;
+    long long previousId = 0;
+    bool ordered = true;
+    for (int page = 0; page < streamRows; ++page)
+    {
+        int pageRows = 0;
+        bool okPage = logger.ForEachSample(pageQuery, [&](const HistorySampleView& row) {
+            ++pageRows;
+            pagedDown += row.bytesDown;
+            ordered = ordered && (row.id > previousId);
+            previousId = row.id;
+            return true;
+        }, &cursor);
+
+        if (!okPage || pageRows == 0)
+        {
+            break;
+        }
+
+        paged += pageRows;
+        pageQuery.after = &cursor;
+    }
+    AssertTrue(paged == streamRows && pagedDown == expectedDown && ordered,
+               L"HistoryLogger keyset pagination resumes without gaps or duplicates");
+
+    int earlyStop = 0;
+    logger.ForEachSample(fullQuery, [&earlyStop](const HistorySampleView&) {
+        ++earlyStop;
+        return earlyStop < 3;
+    });
+    AssertTrue(earlyStop == 3, L"HistoryLogger.ForEachSample stops when visitor returns false");
+}
+
+void RunHistoryLoggerConcurrencyTests()
+{
+    LogTestMessage(L"=== HistoryLogger concurrency tests ===");
+
+    HistoryLogger& logger = HistoryLogger::Instance();
+    bool cleared = logger.DeleteAll();
+    AssertTrue(cleared, L"HistoryLogger.DeleteAll before concurrency tests");
+
+    const int writerCount = 4;
+    const int appendsPerWriter = 2000;
+    const int readerCount = 3;
+
+    std::atomic<int> writersDone(0);
+    std::atomic<bool> readFailed(false);
+    std::vector<std::vector<double>> latencies(readerCount);
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < writerCount; ++w)
+    {
+        threads.emplace_back([&logger, &writersDone, w, appendsPerWriter]() {
+            const std::wstring iface = L"StressIface" + std::to_wstring(w);
+            for (int i = 0; i < appendsPerWriter; ++i)
+            {
+                logger.AppendSample(iface, 3ULL, 1ULL);
+            }
+            ++writersDone;
+        });
+    }
+
+    for (int r = 0; r < readerCount; ++r)
+    {
+        threads.emplace_back([&logger, &writersDone, &readFailed, &latencies, r, writerCount]() {
+            const std::wstring iface = L"StressIface" + std::to_wstring(r % writerCount);
+            std::vector<HistorySample> samples;
+
+            // Appends only enqueue, so writers can finish long before the
+            // writer thread drains; keep querying for a minimum number of
+            // rounds so reads overlap the commits.
+            for (int round = 0; round < 200 || writersDone.load() < writerCount; ++round)
+            {
+                auto start = std::chrono::steady_clock::now();
+
+                unsigned long long down = 0;
+                unsigned long long up = 0;
+                bool ok = logger.GetTotalsToday(down, up, &iface);
+                ok = logger.GetRecentSamples(20, samples, &iface, false) && ok;
+
+                auto elapsed = std::chrono::steady_clock::now() - start;
+                latencies[r].push_back(std::chrono::duration<double, std::milli>(elapsed).count());
+
+                if (!ok)
+                {
+                    readFailed = true;
+                }
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    logger.Flush();
+
+    AssertTrue(!readFailed.load(), L"HistoryLogger queries succeed under concurrent writes");
+
+    HistoryQuery query;
+    unsigned long long rows = 0;
+    unsigned long long sumDown = 0;
+    unsigned long long sumUp = 0;
+    logger.ForEachSample(query, [&](const HistorySampleView& row) {
+        ++rows;
+        sumDown += row.bytesDown;
+        sumUp += row.bytesUp;
+        return true;
+    });
+
+    const unsigned long long expectedRows = static_cast<unsigned long long>(writerCount) * appendsPerWriter;
+    AssertTrue(rows == expectedRows && sumDown == expectedRows * 3ULL && sumUp == expectedRows,
+               L"HistoryLogger concurrent appends are all committed exactly once");
+
+    std::vector<double> all;
+    for (const auto& perReader : latencies)
+    {
+        all.insert(all.end(), perReader.begin(), perReader.end());
+    }
+
+    if (!all.empty())
+    {
+        std::sort(all.begin(), all.end());
+        double p50 = all[all.size() / 2];
+        double p95 = all[(all.size() * 95) / 100];
+        double worst = all.back();
+
+        std::wstring msg = L"[bench] query latency under write load: " +
+                           std::to_wstring(static_cast<unsigned long long>(all.size())) + L" queries, p50 " +
+                           std::to_wstring(static_cast<unsigned long long>(p50 * 1000.0)) + L" us, p95 " +
+                           std::to_wstring(static_cast<unsigned long long>(p95 * 1000.0)) + L" us, max " +
+                           std::to_wstring(static_cast<unsigned long long>(worst * 1000.0)) + L" us";
+        LogTestMessage(msg.c_str());
+    }
+
+    logger.DeleteAll();
 }
 
 } // namespace NetworkMonitorTests
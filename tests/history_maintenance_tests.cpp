@@ -0,0 +1,172 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/Utils.h"
+#include "NetworkMonitor/HistoryLogger.h"
+#include "TestUtils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <cwchar>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    const wchar_t* const MAINTENANCE_IFACE = L"MaintenanceIface";
+
+    void ImportRows(std::time_t from, unsigned long long seconds)
+    {
+        HistoryImportOptions options;
+        options.progressInterval = 0;
+        HistoryLogger::Instance().ImportSamples([from, seconds](const HistorySampleVisitor& sink) {
+            HistorySampleView row = {};
+            row.interfaceName = MAINTENANCE_IFACE;
+            for (unsigned long long i = 0; i < seconds; ++i)
+            {
+                row.timestamp = from + static_cast<std::time_t>(i);
+                row.bytesDown = 1000 + i % 4099;
+                row.bytesUp = 100 + i % 113;
+                if (!sink(row))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }, options);
+    }
+
+    // Force slices until nothing is left to do; returns the slices run
+    int DrainMaintenance(unsigned long long* longestSliceMicros = nullptr)
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        int slices = 0;
+        bool more = true;
+        while (more && slices < 100000)
+        {
+            more = logger.RunMaintenanceSlice();
+            ++slices;
+            if (longestSliceMicros)
+            {
+                *longestSliceMicros = (std::max)(*longestSliceMicros, logger.GetMaintenanceStats().lastSliceMicroseconds);
+            }
+        }
+        return slices;
+    }
+
+    void TestReclaimAfterDeleteAll()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+
+        // 400,000 rows plus their rollup, then a clean baseline with the
+        // WAL checkpointed into the file
+        std::time_t now = std::time(nullptr);
+        ImportRows(now - 400000, 400000);
+        DrainMaintenance();
+        unsigned long long sizeBefore = FileSize(DatabasePath());
+
+        AssertTrue(logger.DeleteAll(), L"HistoryLogger.DeleteAll before reclaiming space");
+        HistoryMaintenanceStats before = logger.GetMaintenanceStats();
+
+        // Samples keep arriving while the slices run; each waits at most
+        // for the slice in progress
+        std::atomic<bool> done(false);
+        std::vector<double> insertMicros;
+        std::thread inserter([&logger, &done, &insertMicros]() {
+            unsigned long long bytes = 1;
+            while (!done.load())
+            {
+                auto start = std::chrono::steady_clock::now();
+                logger.AppendSample(MAINTENANCE_IFACE, bytes++, 1);
+                logger.Flush();
+                insertMicros.push_back(std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - start).count());
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+
+        auto start = std::chrono::steady_clock::now();
+        unsigned long long longestSlice = 0;
+        int slices = DrainMaintenance(&longestSlice);
+        double drainMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        done.store(true);
+        inserter.join();
+
+        HistoryMaintenanceStats after = logger.GetMaintenanceStats();
+        unsigned long long sizeAfter = FileSize(DatabasePath());
+
+        AssertTrue(after.incrementalVacuum && QueryDatabase("PRAGMA auto_vacuum;") == 2,
+                   L"HistoryLogger maintenance: database uses auto_vacuum=INCREMENTAL");
+        AssertTrue(after.pagesReclaimed - before.pagesReclaimed > 1000 && after.freePages == 0,
+                   L"HistoryLogger maintenance: incremental_vacuum returns every free page");
+        AssertTrue(sizeAfter > 0 && sizeAfter < sizeBefore / 4,
+                   L"HistoryLogger maintenance: network_usage.db shrinks after DeleteAll");
+        AssertTrue(after.checkpoints > before.checkpoints && after.optimizeRuns > before.optimizeRuns,
+                   L"HistoryLogger maintenance: checkpoint and optimize run after a bulk delete");
+        AssertTrue(QueryDatabase("SELECT COUNT(*) FROM sqlite_stat1;") > 0,
+                   L"HistoryLogger maintenance: PRAGMA optimize records planner statistics");
+
+        std::sort(insertMicros.begin(), insertMicros.end());
+        double insertMedian = insertMicros.empty() ? 0.0 : insertMicros[insertMicros.size() / 2];
+        double insertMax = insertMicros.empty() ? 0.0 : insertMicros.back();
+
+        wchar_t msg[512] = {0};
+        swprintf(msg, 512,
+                 L"[bench] reclaim after DeleteAll of 400,000 rows: %llu -> %llu KB in %d slices (%.0f ms); "
+                 L"%llu pages, vacuum %.1f ms, checkpoint %.1f ms, optimize %.1f ms, conversion %.1f ms, "
+                 L"longest slice %llu us; concurrent append+flush median %.0f us, max %.0f us (%zu samples)",
+                 sizeBefore / 1024, sizeAfter / 1024, slices, drainMs,
+                 after.pagesReclaimed - before.pagesReclaimed,
+                 (after.vacuumMicroseconds - before.vacuumMicroseconds) / 1000.0,
+                 (after.checkpointMicroseconds - before.checkpointMicroseconds) / 1000.0,
+                 (after.optimizeMicroseconds - before.optimizeMicroseconds) / 1000.0,
+                 (after.conversionMicroseconds - before.conversionMicroseconds) / 1000.0,
+                 longestSlice, insertMedian, insertMax, insertMicros.size());
+        LogTestMessage(msg);
+    }
+
+    void TestIdleScheduling()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+
+        std::time_t now = std::time(nullptr);
+        ImportRows(now - 50000, 50000);
+        DrainMaintenance();
+        logger.TrimToRecentDays(0);
+
+        // No forced slices: the writer thread finds the idle time itself
+        HistoryMaintenanceStats before = logger.GetMaintenanceStats();
+        HistoryMaintenanceStats stats = before;
+        for (int i = 0; i < 100 && (stats.slices == before.slices || stats.freePages != 0); ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            stats = logger.GetMaintenanceStats();
+        }
+
+        AssertTrue(stats.slices > before.slices && stats.freePages == 0 &&
+                   stats.pagesReclaimed > before.pagesReclaimed,
+                   L"HistoryLogger maintenance: idle writer reclaims pages on its own");
+    }
+}
+
+void RunHistoryMaintenanceTests()
+{
+    LogTestMessage(L"=== HistoryLogger maintenance tests ===");
+
+    HistoryLogger& logger = HistoryLogger::Instance();
+    AssertTrue(logger.DeleteAll(), L"HistoryLogger.DeleteAll before maintenance tests");
+
+    TestReclaimAfterDeleteAll();
+    TestIdleScheduling();
+
+    logger.DeleteAll();
+}
+
+} // namespace NetworkMonitorTests
@@ -0,0 +1,335 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/HistoryLogger.h"
+#include "NetworkMonitor/HistoryRetention.h"
+#include "NetworkMonitor/HistoryStatistics.h"
+#include "TestUtils.h"
+
+#include <chrono>
+#include <ctime>
+#include <cwchar>
+#include <string>
+#include <vector>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    const wchar_t* const RETENTION_IFACE_A = L"RetentionA";
+    const wchar_t* const RETENTION_IFACE_B = L"RetentionB";
+
+    constexpr long long DAY_SECONDS = 24LL * 60 * 60;
+
+    // One sample per interface every step seconds in [from, to)
+    void ImportRows(long long from, long long to, long long step)
+    {
+        HistoryImportOptions options;
+        options.progressInterval = 0;
+        HistoryLogger::Instance().ImportSamples([from, to, step](const HistorySampleVisitor& sink) {
+            HistorySampleView row = {};
+            for (long long t = from; t < to; t += step)
+            {
+                row.timestamp = static_cast<std::time_t>(t);
+                row.interfaceName = RETENTION_IFACE_A;
+                row.bytesDown = 1000 + static_cast<unsigned long long>(t % 4099);
+                row.bytesUp = 100 + static_cast<unsigned long long>(t % 113);
+                if (!sink(row))
+                {
+                    return false;
+                }
+                row.interfaceName = RETENTION_IFACE_B;
+                row.bytesDown = 50 + static_cast<unsigned long long>(t % 31);
+                row.bytesUp = 5;
+                if (!sink(row))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }, options);
+    }
+
+    int DrainMaintenance()
+    {
+        int slices = 1;
+        while (HistoryLogger::Instance().RunMaintenanceSlice() && slices < 100000)
+        {
+            ++slices;
+        }
+        return slices;
+    }
+
+    // Download + upload of each test interface over [from, to)
+    bool InterfaceTotals(long long from, long long to, unsigned long long& a, unsigned long long& b)
+    {
+        TopKQuery query;
+        query.from = static_cast<std::time_t>(from);
+        query.to = static_cast<std::time_t>(to);
+        std::vector<RankedInterface> ranked;
+        if (!HistoryLogger::Instance().GetTopInterfaces(query, ranked))
+        {
+            return false;
+        }
+
+        a = 0;
+        b = 0;
+        for (const RankedInterface& entry : ranked)
+        {
+            if (entry.interfaceName == RETENTION_IFACE_A)
+            {
+                a = entry.bytesDown + entry.bytesUp;
+            }
+            else if (entry.interfaceName == RETENTION_IFACE_B)
+            {
+                b = entry.bytesDown + entry.bytesUp;
+            }
+        }
+        return true;
+    }
+
+    void TestNormalizePolicy()
+    {
+        HistoryRetentionPolicy policy;
+        AssertTrue(!policy.IsActive(), L"HistoryRetentionPolicy: the default keeps everything");
+
+        // Nothing is deleted until the user sets a retention period
+        AppConfig defaults;
+        policy.rawDays = defaults.historyRawDays;
+        policy.minuteDays = defaults.historyMinuteDays;
+        policy.hourDays = defaults.historyHourDays;
+        policy.maxSizeMB = defaults.historyMaxSizeMB;
+        AssertTrue(!NormalizeRetentionPolicy(policy).IsActive(),
+                   L"HistoryRetentionPolicy: default settings keep every raw sample");
+
+        policy.rawDays = 30;
+        policy.minuteDays = 7;
+        policy.hourDays = 14;
+        HistoryRetentionPolicy normalized = NormalizeRetentionPolicy(policy);
+        AssertTrue(normalized.rawDays == 30 && normalized.minuteDays == 30 && normalized.hourDays == 30,
+                   L"NormalizeRetentionPolicy: coarser tiers last at least as long as finer ones");
+
+        policy.rawDays = 7;
+        policy.minuteDays = 0;
+        policy.hourDays = 90;
+        normalized = NormalizeRetentionPolicy(policy);
+        AssertTrue(normalized.minuteDays == 0 && normalized.hourDays == 0,
+                   L"NormalizeRetentionPolicy: a tier kept forever keeps every coarser tier forever");
+
+        policy.rawDays = -5;
+        normalized = NormalizeRetentionPolicy(policy);
+        bool negativeKeeps = (normalized.rawDays == 0);
+
+        policy.rawDays = 1;
+        policy.minuteDays = MAX_HISTORY_TIER_DAYS + 1;
+        policy.hourDays = 0;
+        policy.maxSizeMB = MAX_HISTORY_SIZE_MB + 1;
+        normalized = NormalizeRetentionPolicy(policy);
+        AssertTrue(negativeKeeps && normalized.minuteDays == MAX_HISTORY_TIER_DAYS &&
+                   normalized.maxSizeMB == MAX_HISTORY_SIZE_MB,
+                   L"NormalizeRetentionPolicy: out-of-range values are clamped");
+
+        policy = HistoryRetentionPolicy();
+        policy.rawDays = 7;
+        policy.minuteDays = 90;
+        std::time_t now = 1700000123;
+        RetentionCutoffs cutoffs = GetRetentionCutoffs(NormalizeRetentionPolicy(policy), now);
+        AssertTrue(cutoffs.raw == now - 7 * DAY_SECONDS &&
+                   cutoffs.minute == HourStart(now - 90 * DAY_SECONDS) &&
+                   cutoffs.minute % HISTORY_HOUR_SECONDS == 0 && cutoffs.hour == 0,
+                   L"GetRetentionCutoffs: raw to the second, minutes to the hour, 0 keeps a tier");
+    }
+
+    void TestTieredDownsampling()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        AssertTrue(logger.DeleteAll(), L"HistoryLogger.DeleteAll before retention test");
+
+        // 20 days of samples every 10 seconds on two interfaces
+        long long now = static_cast<long long>(std::time(nullptr));
+        long long start = HourStart(now - 20 * DAY_SECONDS);
+        ImportRows(start, now, 10);
+        DrainMaintenance();
+
+        unsigned long long allA = 0;
+        unsigned long long allB = 0;
+        unsigned long long recentA = 0;
+        unsigned long long recentB = 0;
+        long long recentFrom = HourStart(now - 10 * DAY_SECONDS);
+        InterfaceTotals(start, now + 1, allA, allB);
+        InterfaceTotals(recentFrom, now + 1, recentA, recentB);
+        unsigned long long todayDown = 0;
+        unsigned long long todayUp = 0;
+        unsigned long long monthDown = 0;
+        unsigned long long monthUp = 0;
+        logger.GetTotalsToday(todayDown, todayUp);
+        logger.GetTotalsThisMonth(monthDown, monthUp);
+        long long rawRows = QueryDatabase("SELECT COUNT(*) FROM usage;");
+
+        HistoryRetentionPolicy policy;
+        policy.rawDays = 2;
+        policy.minuteDays = 5;
+        logger.SetRetentionPolicy(policy);
+        HistoryMaintenanceStats before = logger.GetMaintenanceStats();
+        int slices = DrainMaintenance();
+        HistoryMaintenanceStats after = logger.GetMaintenanceStats();
+
+        RetentionCutoffs cutoffs = GetRetentionCutoffs(logger.GetRetentionPolicy(), static_cast<std::time_t>(now));
+        AssertTrue(QueryDatabase("SELECT MIN(timestamp) FROM usage;") >= static_cast<long long>(cutoffs.raw) &&
+                   QueryDatabase("SELECT COUNT(*) FROM usage;") < rawRows / 2,
+                   L"HistoryLogger retention: raw samples past rawDays are deleted");
+        AssertTrue(QueryDatabase("SELECT MIN(minute_start) FROM usage_minute;") >= static_cast<long long>(cutoffs.minute) &&
+                   QueryDatabase("SELECT COUNT(*) FROM usage_hour;") > 0,
+                   L"HistoryLogger retention: minutes past minuteDays are folded into hours");
+        AssertTrue(QueryDatabase("SELECT MIN(hour_start) FROM usage_hour;") == start,
+                   L"HistoryLogger retention: hours are kept forever with hourDays = 0");
+        AssertTrue(after.rawRowsExpired - before.rawRowsExpired > 0 &&
+                   after.minuteRowsFolded - before.minuteRowsFolded > 0 && slices > 1,
+                   L"HistoryLogger retention: aging out runs in chunks over several slices");
+
+        unsigned long long a = 0;
+        unsigned long long b = 0;
+        AssertTrue(InterfaceTotals(start, now + 1, a, b) && a == allA && b == allB && a > 0,
+                   L"HistoryLogger retention: totals across all three tiers are unchanged");
+
+        unsigned long long down = 0;
+        unsigned long long up = 0;
+        AssertTrue(logger.GetTotalsToday(down, up) && down == todayDown && up == todayUp,
+                   L"HistoryLogger retention: today's totals are unchanged");
+        AssertTrue(logger.GetTotalsThisMonth(down, up) && down == monthDown && up == monthUp,
+                   L"HistoryLogger retention: this month's totals are unchanged");
+
+        // Hourly statistics over a range that is now all hours and minutes
+        RateQuery rates;
+        rates.from = static_cast<std::time_t>(start);
+        rates.to = static_cast<std::time_t>(start + 6 * DAY_SECONDS);
+        rates.bucketSeconds = static_cast<int>(HISTORY_HOUR_SECONDS);
+        std::vector<InterfaceRateStatistics> stats;
+        bool statsOk = logger.GetRateStatistics(rates, stats);
+        double bucketed = 0.0;
+        unsigned long long expected = 0;
+        unsigned long long ignored = 0;
+        InterfaceTotals(start, start + 6 * DAY_SECONDS, expected, ignored);
+        for (const InterfaceRateStatistics& entry : stats)
+        {
+            if (entry.interfaceName == RETENTION_IFACE_A)
+            {
+                bucketed = (entry.down.mean + entry.up.mean) * static_cast<double>(entry.bucketCount) *
+                           static_cast<double>(HISTORY_HOUR_SECONDS);
+            }
+        }
+        double error = bucketed - static_cast<double>(expected);
+        AssertTrue(statsOk && expected > 0 && error < 1.0 && error > -1.0,
+                   L"HistoryLogger retention: rate statistics read the hour and minute tiers");
+
+        // Hours past hourDays go too; later history is untouched
+        policy.hourDays = 10;
+        logger.SetRetentionPolicy(policy);
+        DrainMaintenance();
+        cutoffs = GetRetentionCutoffs(logger.GetRetentionPolicy(), static_cast<std::time_t>(now));
+        AssertTrue(QueryDatabase("SELECT MIN(hour_start) FROM usage_hour;") >= static_cast<long long>(cutoffs.hour),
+                   L"HistoryLogger retention: hours past hourDays are deleted");
+        AssertTrue(InterfaceTotals(recentFrom, now + 1, a, b) && a == recentA && b == recentB,
+                   L"HistoryLogger retention: history within hourDays is unchanged");
+
+        logger.SetRetentionPolicy(HistoryRetentionPolicy());
+        logger.DeleteAll();
+    }
+
+    void TestSizeCap()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        AssertTrue(logger.DeleteAll(), L"HistoryLogger.DeleteAll before size cap test");
+        DrainMaintenance();
+
+        // About 8 MB of raw rows over 6 days
+        long long now = static_cast<long long>(std::time(nullptr));
+        ImportRows(now - 6 * DAY_SECONDS, now, 4);
+        DrainMaintenance();
+
+        long long capFloor = HourStart(now - HISTORY_SIZE_CAP_KEEP_DAYS * DAY_SECONDS);
+        unsigned long long keptA = 0;
+        unsigned long long keptB = 0;
+        InterfaceTotals(capFloor, now + 1, keptA, keptB);
+
+        HistoryRetentionPolicy policy;
+        policy.maxSizeMB = 2;
+        logger.SetRetentionPolicy(policy);
+        DrainMaintenance();
+
+        long long used = (QueryDatabase("PRAGMA page_count;") - QueryDatabase("PRAGMA freelist_count;")) *
+                         QueryDatabase("PRAGMA page_size;");
+        long long oldestRaw = QueryDatabase("SELECT MIN(timestamp) FROM usage;");
+        AssertTrue(used <= 2LL * 1024 * 1024 || oldestRaw >= capFloor,
+                   L"HistoryLogger retention: the size cap removes old history until the database fits");
+        AssertTrue(QueryDatabase("SELECT MIN(timestamp) FROM usage;") > now - 6 * DAY_SECONDS,
+                   L"HistoryLogger retention: the oldest raw rows go first");
+
+        unsigned long long a = 0;
+        unsigned long long b = 0;
+        AssertTrue(InterfaceTotals(capFloor, now + 1, a, b) && a == keptA && b == keptB,
+                   L"HistoryLogger retention: the size cap leaves the most recent day alone");
+
+        logger.SetRetentionPolicy(HistoryRetentionPolicy());
+        logger.DeleteAll();
+    }
+
+    // Microseconds per query over the whole range
+    double MeasureRangeQuery(long long from, long long to)
+    {
+        const int runs = 5;
+        unsigned long long a = 0;
+        unsigned long long b = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < runs; ++i)
+        {
+            InterfaceTotals(from, to, a, b);
+        }
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count() / runs;
+    }
+
+    void BenchmarkLongRangeQuery()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        logger.DeleteAll();
+
+        // 60 days of 10-second samples, queried with 1-second precision so
+        // the unfolded history is read from raw rows
+        long long now = static_cast<long long>(std::time(nullptr));
+        long long start = HourStart(now - 60 * DAY_SECONDS);
+        ImportRows(start, now, 10);
+        DrainMaintenance();
+        double rawMicros = MeasureRangeQuery(start + 1, now + 1);
+
+        HistoryRetentionPolicy policy;
+        policy.rawDays = 1;
+        policy.minuteDays = 7;
+        logger.SetRetentionPolicy(policy);
+        DrainMaintenance();
+        double tieredMicros = MeasureRangeQuery(start + 1, now + 1);
+
+        AssertTrue(tieredMicros > 0.0, L"HistoryLogger retention: long-range benchmark ran");
+
+        wchar_t msg[256] = {0};
+        swprintf(msg, 256,
+                 L"[bench] 60-day range, 2 interfaces: %.0f us from raw rows, %.0f us from tiers (%.1fx)",
+                 rawMicros, tieredMicros, (tieredMicros > 0.0) ? rawMicros / tieredMicros : 0.0);
+        LogTestMessage(msg);
+
+        logger.SetRetentionPolicy(HistoryRetentionPolicy());
+        logger.DeleteAll();
+    }
+}
+
+void RunHistoryRetentionTests()
+{
+    LogTestMessage(L"=== History retention tests ===");
+
+    TestNormalizePolicy();
+    TestTieredDownsampling();
+    TestSizeCap();
+    BenchmarkLongRangeQuery();
+}
+
+} // namespace NetworkMonitorTests
@@ -0,0 +1,424 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/Utils.h"
+#include "NetworkMonitor/HistoryLogger.h"
+#include "NetworkMonitor/HistoryStatistics.h"
+#include "TestUtils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    const std::wstring RATE_IFACES[] = { L"Ethernet", L"Wi-Fi" };
+
+    // Traffic with a daytime plateau and a few short bursts, so the 95th
+    // percentile, 99th percentile and max all differ.
+    unsigned long long SyntheticDown(unsigned long long i)
+    {
+        unsigned long long secondOfDay = i % 86400ULL;
+        unsigned long long base = (i * 7919ULL) % 20000ULL;
+        if (secondOfDay >= 30000ULL && secondOfDay < 60000ULL)
+        {
+            base += 400000ULL;
+        }
+        if (i % 10007ULL < 200ULL)
+        {
+            base += 5000000ULL;
+        }
+        return base;
+    }
+
+    unsigned long long SyntheticUp(unsigned long long i)
+    {
+        return (i * 104729ULL) % 3000ULL;
+    }
+
+    // One row per second per interface (interfaces interleaved)
+    void ImportSyntheticPeriod(std::time_t from, unsigned long long seconds)
+    {
+        HistoryImportOptions options;
+        options.progressInterval = 0;
+        HistoryLogger::Instance().ImportSamples([from, seconds](const HistorySampleVisitor& sink) {
+            HistorySampleView row = {};
+            for (unsigned long long i = 0; i < seconds; ++i)
+            {
+                for (int k = 0; k < 2; ++k)
+                {
+                    row.timestamp = from + static_cast<std::time_t>(i);
+                    row.interfaceName = RATE_IFACES[k];
+                    row.bytesDown = SyntheticDown(i) >> k;
+                    row.bytesUp = SyntheticUp(i) >> k;
+                    if (!sink(row))
+                    {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }, options);
+    }
+
+    // Reference p95 and max for one interface by sorting every bucket
+    void ExpectedDownRates(std::time_t dataFrom, unsigned long long seconds, int shift,
+                           std::time_t from, std::time_t to, int bucketSeconds,
+                           double& p95Out, double& maxOut)
+    {
+        size_t buckets = static_cast<size_t>((to - from + bucketSeconds - 1) / bucketSeconds);
+        std::vector<double> sums(buckets, 0.0);
+        for (unsigned long long i = 0; i < seconds; ++i)
+        {
+            std::time_t ts = dataFrom + static_cast<std::time_t>(i);
+            if (ts >= from && ts < to)
+            {
+                sums[static_cast<size_t>((ts - from) / bucketSeconds)] += static_cast<double>(SyntheticDown(i) >> shift);
+            }
+        }
+
+        long long lastSeconds = static_cast<long long>(to - from) - static_cast<long long>(buckets - 1) * bucketSeconds;
+        for (size_t b = 0; b < buckets; ++b)
+        {
+            sums[b] /= static_cast<double>((b + 1 == buckets) ? lastSeconds : bucketSeconds);
+        }
+
+        std::sort(sums.begin(), sums.end());
+        size_t rank = static_cast<size_t>(std::ceil(0.95 * static_cast<double>(buckets)));
+        p95Out = sums[rank - 1];
+        maxOut = sums.back();
+    }
+
+    bool Near(double a, double b)
+    {
+        return std::fabs(a - b) <= 1e-6 * (std::max)(1.0, std::fabs(b));
+    }
+
+    void CheckAgainstReference(std::time_t dataFrom, unsigned long long seconds,
+                               std::time_t from, std::time_t to, const wchar_t* label)
+    {
+        RateQuery query;
+        query.from = from;
+        query.to = to;
+
+        std::vector<InterfaceRateStatistics> stats;
+        bool ok = HistoryLogger::Instance().GetRateStatistics(query, stats);
+
+        bool matches = ok && stats.size() == 2;
+        for (size_t k = 0; matches && k < stats.size(); ++k)
+        {
+            // Sorted by name: "Ethernet" (shift 0) before "Wi-Fi" (shift 1)
+            double p95 = 0.0;
+            double max = 0.0;
+            ExpectedDownRates(dataFrom, seconds, static_cast<int>(k), from, to, query.bucketSeconds, p95, max);
+            matches = stats[k].interfaceName == RATE_IFACES[k] &&
+                      Near(stats[k].down.p95, p95) && Near(stats[k].down.max, max) &&
+                      stats[k].down.p95 <= stats[k].down.p99 && stats[k].down.p99 <= stats[k].down.max;
+        }
+        AssertTrue(matches, label);
+    }
+
+    // Reference busiest intervals by materializing and sorting every bucket
+    std::vector<RankedInterval> ExpectedTopIntervals(std::time_t dataFrom, unsigned long long seconds,
+                                                     const TopKQuery& query, bool wifiOnly)
+    {
+        std::time_t to = query.to;
+        size_t buckets = static_cast<size_t>((to - query.from + query.bucketSeconds - 1) / query.bucketSeconds);
+        std::vector<RankedInterval> all(buckets, RankedInterval{ 0, 0, 0 });
+        for (size_t b = 0; b < buckets; ++b)
+        {
+            all[b].start = query.from + static_cast<std::time_t>(b) * query.bucketSeconds;
+        }
+
+        for (unsigned long long i = 0; i < seconds; ++i)
+        {
+            std::time_t ts = dataFrom + static_cast<std::time_t>(i);
+            if (ts < query.from || ts >= to)
+            {
+                continue;
+            }
+            RankedInterval& bucket = all[static_cast<size_t>((ts - query.from) / query.bucketSeconds)];
+            for (int k = wifiOnly ? 1 : 0; k < 2; ++k)
+            {
+                bucket.bytesDown += SyntheticDown(i) >> k;
+                bucket.bytesUp += SyntheticUp(i) >> k;
+            }
+        }
+
+        TrafficMetric metric = query.metric;
+        std::sort(all.begin(), all.end(), [metric](const RankedInterval& a, const RankedInterval& b) {
+            unsigned long long va = MetricValue(metric, a.bytesDown, a.bytesUp);
+            unsigned long long vb = MetricValue(metric, b.bytesDown, b.bytesUp);
+            return (va != vb) ? (va > vb) : (a.start < b.start);
+        });
+        all.resize((std::min)(all.size(), query.k));
+        return all;
+    }
+
+    bool SameIntervals(const std::vector<RankedInterval>& a, const std::vector<RankedInterval>& b)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            if (a[i].start != b[i].start || a[i].bytesDown != b[i].bytesDown || a[i].bytesUp != b[i].bytesUp)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void RunTopKChecks(std::time_t dayStart, unsigned long long daySeconds)
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+
+        auto better = [](int a, int b) { return a > b; };
+        TopKCollector<int, decltype(better)> collector(5, better);
+        for (int i = 0; i < 1000; ++i)
+        {
+            collector.Offer((i * 389) % 1000);
+        }
+        std::vector<int> best = collector.TakeSorted();
+        AssertTrue(best == std::vector<int>({ 999, 998, 997, 996, 995 }), L"TopKCollector keeps the K largest, best first");
+
+        TopKQuery query;
+        query.from = dayStart;
+        query.to = dayStart + static_cast<std::time_t>(daySeconds);
+
+        std::vector<RankedInterval> intervals;
+        bool ok = logger.GetTopIntervals(query, intervals);
+        AssertTrue(ok && SameIntervals(intervals, ExpectedTopIntervals(dayStart, daySeconds, query, false)),
+                   L"HistoryLogger.GetTopIntervals busiest minutes match a full sort");
+
+        query.bucketSeconds = 7;   // not minute-aligned: raw rows
+        query.metric = TrafficMetric::Up;
+        ok = logger.GetTopIntervals(query, intervals);
+        AssertTrue(ok && SameIntervals(intervals, ExpectedTopIntervals(dayStart, daySeconds, query, false)),
+                   L"HistoryLogger.GetTopIntervals with odd bucket sizes matches a full sort");
+
+        std::wstring wifi = RATE_IFACES[1];
+        query.bucketSeconds = 300;
+        query.metric = TrafficMetric::Down;
+        query.interfaceFilter = &wifi;
+        query.k = 5;
+        ok = logger.GetTopIntervals(query, intervals);
+        AssertTrue(ok && SameIntervals(intervals, ExpectedTopIntervals(dayStart, daySeconds, query, true)),
+                   L"HistoryLogger.GetTopIntervals honours the interface filter");
+
+        query.interfaceFilter = nullptr;
+        query.bucketSeconds = 3600;
+        query.k = 100;
+        ok = logger.GetTopIntervals(query, intervals);
+        AssertTrue(ok && intervals.size() == 24, L"HistoryLogger.GetTopIntervals returns every interval when K exceeds them");
+
+        query.k = 0;
+        ok = logger.GetTopIntervals(query, intervals);
+        AssertTrue(ok && intervals.empty(), L"HistoryLogger.GetTopIntervals with K = 0 is empty");
+
+        std::vector<RankedInterface> interfaces;
+        query.k = 5;
+        ok = logger.GetTopInterfaces(query, interfaces);
+        AssertTrue(ok && interfaces.size() == 2 && interfaces[0].interfaceName == RATE_IFACES[0] &&
+                   interfaces[0].bytesDown > interfaces[1].bytesDown,
+                   L"HistoryLogger.GetTopInterfaces ranks interfaces by traffic");
+
+        query.k = 1;
+        query.from = dayStart + 13;   // unaligned start reads raw rows
+        ok = logger.GetTopInterfaces(query, interfaces);
+        unsigned long long expectedDown = 0;
+        for (unsigned long long i = 13; i < daySeconds; ++i)
+        {
+            expectedDown += SyntheticDown(i);
+        }
+        AssertTrue(ok && interfaces.size() == 1 && interfaces[0].bytesDown == expectedDown,
+                   L"HistoryLogger.GetTopInterfaces totals match the raw rows");
+    }
+
+    double MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // A month of 1-second samples on two interfaces (5,184,000 rows): the
+    // rollup against a raw scan
+    void BenchmarkMonth(std::time_t dayStart)
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        logger.DeleteAll();
+        const unsigned long long monthSeconds = 30ULL * 86400ULL;
+        ImportSyntheticPeriod(dayStart, monthSeconds);
+
+        RateQuery query;
+        query.from = dayStart;
+        query.to = dayStart + static_cast<std::time_t>(monthSeconds);
+
+        std::vector<InterfaceRateStatistics> stats;
+        auto start = std::chrono::steady_clock::now();
+        bool ok = logger.GetRateStatistics(query, stats);
+        double rollupMs = MillisecondsSince(start);
+
+        query.from += 1;   // unaligned: forces a scan of the raw rows
+        start = std::chrono::steady_clock::now();
+        std::vector<InterfaceRateStatistics> rawStats;
+        bool rawOk = logger.GetRateStatistics(query, rawStats);
+        double rawMs = MillisecondsSince(start);
+
+        AssertTrue(ok && rawOk && stats.size() == 2 && stats[0].bucketCount == 8640,
+                   L"HistoryLogger.GetRateStatistics over a month of 1-second samples");
+        CheckAgainstReference(dayStart, monthSeconds, dayStart, dayStart + static_cast<std::time_t>(monthSeconds),
+                              L"HistoryLogger.GetRateStatistics month p95 matches a full sort");
+
+        std::wstring msg = L"[bench] 95th percentile over 30 days x 2 interfaces (5,184,000 rows): rollup " +
+                           std::to_wstring(static_cast<unsigned long long>(rollupMs)) + L" ms, raw scan " +
+                           std::to_wstring(static_cast<unsigned long long>(rawMs)) + L" ms";
+        LogTestMessage(msg.c_str());
+
+        // Top-K over the same month: minute buckets from the rollup, 1-second
+        // buckets from the raw rows
+        TopKQuery topQuery;
+        topQuery.from = dayStart;
+        topQuery.to = dayStart + static_cast<std::time_t>(monthSeconds);
+        std::vector<RankedInterval> top;
+
+        start = std::chrono::steady_clock::now();
+        ok = logger.GetTopIntervals(topQuery, top);
+        double minuteMs = MillisecondsSince(start);
+
+        topQuery.bucketSeconds = 1;
+        start = std::chrono::steady_clock::now();
+        rawOk = logger.GetTopIntervals(topQuery, top);
+        double secondMs = MillisecondsSince(start);
+
+        AssertTrue(ok && rawOk && top.size() == 20, L"HistoryLogger.GetTopIntervals over a month");
+
+        msg = L"[bench] top-20 intervals over 30 days: 1-minute buckets " +
+              std::to_wstring(static_cast<unsigned long long>(minuteMs)) + L" ms, 1-second buckets " +
+              std::to_wstring(static_cast<unsigned long long>(secondMs)) + L" ms";
+        LogTestMessage(msg.c_str());
+    }
+}
+
+void RunHistoryStatisticsTests()
+{
+    LogTestMessage(L"=== HistoryStatistics tests ===");
+
+    // 1..100: billing p95 is the 95th value, p99 the 99th
+    std::vector<double> rates;
+    for (int i = 1; i <= 100; ++i)
+    {
+        rates.push_back(static_cast<double>(101 - i));
+    }
+    RateDistribution dist = ComputeRateDistribution(rates, 10);
+    unsigned int binned = 0;
+    for (unsigned int count : dist.histogram)
+    {
+        binned += count;
+    }
+    AssertTrue(dist.p95 == 95.0 && dist.p99 == 99.0 && dist.max == 100.0 && dist.mean == 50.5,
+               L"ComputeRateDistribution percentiles, max and mean");
+    AssertTrue(dist.histogram.size() == 10 && dist.binWidth == 10.0 && binned == 100 &&
+               dist.histogram[0] == 9 && dist.histogram[9] == 11,
+               L"ComputeRateDistribution histogram bins (max falls in the last bin)");
+
+    rates.clear();
+    dist = ComputeRateDistribution(rates, 4);
+    AssertTrue(dist.p95 == 0.0 && dist.max == 0.0 && dist.histogram.size() == 4,
+               L"ComputeRateDistribution handles no buckets");
+
+    HistoryLogger& logger = HistoryLogger::Instance();
+    logger.DeleteAll();
+
+    // One day of data; compare the rollup path, the raw path and a mix of
+    // both against a full sort of the buckets.
+    const std::time_t dayStart = 1700006400;   // multiple of 300
+    const unsigned long long daySeconds = 86400ULL;
+    ImportSyntheticPeriod(dayStart, daySeconds);
+
+    CheckAgainstReference(dayStart, daySeconds, dayStart, dayStart + 86400,
+                          L"HistoryLogger.GetRateStatistics from the minute rollup matches a full sort");
+    CheckAgainstReference(dayStart, daySeconds, dayStart + 7, dayStart + 86400,
+                          L"HistoryLogger.GetRateStatistics from raw rows matches a full sort");
+    CheckAgainstReference(dayStart, daySeconds, dayStart, dayStart + 40000 + 33,
+                          L"HistoryLogger.GetRateStatistics with a partial tail matches a full sort");
+
+    RateQuery query;
+    query.from = dayStart;
+    query.to = dayStart + 86400;
+    std::wstring wifi = RATE_IFACES[1];
+    query.interfaceFilter = &wifi;
+    std::vector<InterfaceRateStatistics> stats;
+    bool ok = logger.GetRateStatistics(query, stats);
+    AssertTrue(ok && stats.size() == 1 && stats[0].interfaceName == wifi && stats[0].bucketCount == 288,
+               L"HistoryLogger.GetRateStatistics honours the interface filter");
+
+    query.interfaceFilter = nullptr;
+    query.to = query.from;
+    AssertTrue(!logger.GetRateStatistics(query, stats), L"HistoryLogger.GetRateStatistics rejects an empty period");
+
+    query.to = query.from + 366 * 86400;
+    query.bucketSeconds = 1;
+    AssertTrue(!logger.GetRateStatistics(query, stats), L"HistoryLogger.GetRateStatistics rejects a year of 1-second buckets");
+    query.bucketSeconds = 60;
+    AssertTrue(logger.GetRateStatistics(query, stats), L"HistoryLogger.GetRateStatistics accepts a year of 1-minute buckets");
+
+    RunTopKChecks(dayStart, daySeconds);
+
+    // Samples appended live land in the rollup too
+    logger.DeleteAll();
+    std::time_t now = std::time(nullptr);
+    for (int i = 0; i < 3; ++i)
+    {
+        logger.AppendSample(L"LiveIface", 100ULL, 10ULL);
+    }
+    query = RateQuery();
+    query.from = now - (now % 60) - 1800;
+    query.to = query.from + 3600;
+    query.bucketSeconds = 3600;
+    ok = logger.GetRateStatistics(query, stats);
+    AssertTrue(ok && stats.size() == 1 && Near(stats[0].down.max * 3600.0, 300.0) && Near(stats[0].up.max * 3600.0, 30.0),
+               L"HistoryLogger.GetRateStatistics sees appended samples");
+
+    // Trimming keeps the rollup consistent with the raw rows
+    logger.DeleteAll();
+    now = std::time(nullptr);
+    std::time_t trimFrom = now - 2 * 86400;
+    ImportSyntheticPeriod(trimFrom, 2 * 86400ULL - 120);
+    logger.TrimToRecentDays(1);
+
+    unsigned long long rawDown = 0;
+    HistoryQuery rawQuery;
+    logger.ForEachSample(rawQuery, [&](const HistorySampleView& row) {
+        rawDown += row.bytesDown;
+        return true;
+    });
+
+    query = RateQuery();
+    query.from = trimFrom - (trimFrom % 60);
+    query.to = query.from + 3 * 86400;
+    query.bucketSeconds = 60;
+    ok = logger.GetRateStatistics(query, stats);
+    double rollupDown = 0.0;
+    for (const InterfaceRateStatistics& s : stats)
+    {
+        rollupDown += s.down.mean * static_cast<double>(s.bucketCount) * 60.0;
+    }
+    AssertTrue(ok && rawDown > 0 && Near(rollupDown, static_cast<double>(rawDown)),
+               L"HistoryLogger.TrimToRecentDays keeps the minute rollup in step");
+
+    if (BenchmarksEnabled())
+    {
+        BenchmarkMonth(dayStart);
+    }
+
+    logger.DeleteAll();
+}
+
+} // namespace NetworkMonitorTests
@@ -0,0 +1,369 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/Utils.h"
+#include "NetworkMonitor/HistoryLogger.h"
+#include "NetworkMonitor/LocalCalendar.h"
+#include "TestUtils.h"
+
+#include <chrono>
+#include <cwchar>
+#include <ctime>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    const std::wstring CALENDAR_IFACES[] = { L"Ethernet", L"Wi-Fi" };
+
+    std::time_t Local(int year, int month, int day, int hour = 0, int minute = 0)
+    {
+        std::tm local = {};
+        local.tm_year = year - 1900;
+        local.tm_mon = month - 1;
+        local.tm_mday = day;
+        local.tm_hour = hour;
+        local.tm_min = minute;
+        local.tm_isdst = -1;
+        return std::mktime(&local);
+    }
+
+    // Local midnight and date of t, straight from the CRT
+    std::time_t SlowDayStart(std::time_t t)
+    {
+        std::tm local = {};
+        localtime_s(&local, &t);
+        return Local(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday);
+    }
+
+    // Every day start in the table matches mktime, and lookups at and around
+    // each boundary land in the right day
+    bool TableMatchesCrt(const LocalCalendar& calendar)
+    {
+        int day = 0;
+        for (int year = calendar.FirstYear(); year <= calendar.LastYear(); ++year)
+        {
+            for (int month = 1; month <= 12; ++month)
+            {
+                int monthIndex = (year - calendar.FirstYear()) * 12 + (month - 1);
+                if (calendar.MonthStart(monthIndex) != Local(year, month, 1) ||
+                    calendar.DaysInMonth(monthIndex) != GetDaysInMonth(year, month - 1))
+                {
+                    return false;
+                }
+
+                for (int mday = 1; mday <= GetDaysInMonth(year, month - 1); ++mday, ++day)
+                {
+                    std::time_t start = Local(year, month, mday);
+                    if (calendar.DayStart(day) != start ||
+                        calendar.MonthOfDay(day) != monthIndex ||
+                        calendar.DayIndex(start) != day ||
+                        calendar.DayIndex(calendar.DayEnd(day) - 1) != day ||
+                        (day > 0 && calendar.DayIndex(start - 1) != day - 1))
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+        return day == calendar.DayCount();
+    }
+
+    // Pseudo-random timestamps across the table agree with localtime_s
+    bool LookupsMatchCrt(const LocalCalendar& calendar, int count)
+    {
+        unsigned long long state = 88172645463325252ULL;
+        long long first = static_cast<long long>(calendar.DayStart(0));
+        long long span = static_cast<long long>(calendar.DayEnd(calendar.DayCount() - 1)) - first;
+
+        for (int i = 0; i < count; ++i)
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            std::time_t t = static_cast<std::time_t>(first + static_cast<long long>(state % span));
+
+            int day = calendar.DayIndex(t);
+            if (day < 0 || calendar.DayStart(day) != SlowDayStart(t))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void RunTableChecks()
+    {
+        // US Eastern: DST from the second Sunday of March to the first of November
+        {
+            ScopedTimeZone zone("EST5EDT");
+
+            LocalCalendar calendar;
+            AssertTrue(calendar.Build(2024, 2026) && calendar.DayCount() == 366 + 365 + 365 &&
+                       calendar.MonthCount() == 36,
+                       L"LocalCalendar.Build covers whole local years");
+            AssertTrue(TableMatchesCrt(calendar),
+                       L"LocalCalendar: every day and month start matches mktime");
+            AssertTrue(LookupsMatchCrt(calendar, 200000),
+                       L"LocalCalendar.DayIndex agrees with localtime_s for random timestamps");
+
+            int spring = calendar.DayIndex(Local(2025, 3, 9, 12));
+            int autumn = calendar.DayIndex(Local(2025, 11, 2, 12));
+            AssertTrue(calendar.DayEnd(spring) - calendar.DayStart(spring) == 23 * 3600 &&
+                       calendar.DayEnd(autumn) - calendar.DayStart(autumn) == 25 * 3600,
+                       L"LocalCalendar: DST change days are 23 and 25 hours long");
+
+            int march = calendar.MonthIndex(Local(2025, 3, 15));
+            AssertTrue(calendar.MonthEnd(march) - calendar.MonthStart(march) == 31LL * 86400 - 3600,
+                       L"LocalCalendar: the month of the spring change is an hour short");
+
+            int february = calendar.MonthIndex(Local(2024, 2, 10));
+            AssertTrue(calendar.DayOfMonthStart(february, 31) == Local(2024, 2, 29) &&
+                       calendar.DayOfMonthStart(february + 12, 31) == Local(2025, 2, 28) &&
+                       calendar.DayOfMonthStart(february, 0) == Local(2024, 2, 1) &&
+                       calendar.DayOfMonthStart(calendar.MonthCount(), 1) == static_cast<std::time_t>(-1),
+                       L"LocalCalendar.DayOfMonthStart clamps to the month's days");
+
+            AssertTrue(!calendar.Covers(Local(2024, 1, 1) - 1) && calendar.Covers(Local(2024, 1, 1)) &&
+                       calendar.Covers(Local(2027, 1, 1) - 1) && !calendar.Covers(Local(2027, 1, 1)) &&
+                       calendar.DayIndex(Local(2027, 1, 1)) == -1 && calendar.MonthIndex(0) == -1,
+                       L"LocalCalendar.Covers is exact at the table's edges");
+        }
+
+        // Half-hour offset without DST
+        {
+            ScopedTimeZone zone("IST-5:30");
+
+            LocalCalendar calendar;
+            AssertTrue(calendar.Build(2025, 2025) && TableMatchesCrt(calendar) &&
+                       LookupsMatchCrt(calendar, 50000),
+                       L"LocalCalendar: half-hour zone boundaries match the CRT");
+        }
+
+        AssertTrue(!LocalCalendar().Build(2026, 2025), L"LocalCalendar.Build rejects an empty range");
+    }
+
+    void RunSharedChecks()
+    {
+        ScopedTimeZone zone("EST5EDT");
+
+        CalendarSpan day;
+        CalendarSpan month;
+        std::time_t t = Local(2025, 11, 2, 15, 30);
+        AssertTrue(GetLocalDay(t, day) && day.start == Local(2025, 11, 2) && day.end == Local(2025, 11, 3) &&
+                   GetLocalMonth(t, month) && month.start == Local(2025, 11, 1) && month.end == Local(2025, 12, 1),
+                   L"GetLocalDay/GetLocalMonth: bounds of a DST change day");
+
+        // The shared table grows to take in an old timestamp
+        std::shared_ptr<const LocalCalendar> shared = LocalCalendar::Shared(Local(2012, 6, 1));
+        AssertTrue(shared && shared->FirstYear() <= 2012 && shared->Covers(std::time(nullptr)),
+                   L"LocalCalendar.Shared widens the window to cover older timestamps");
+
+        // Beyond LOCAL_CALENDAR_MAX_YEARS the CRT answers instead
+        std::time_t far = Local(2012 + LOCAL_CALENDAR_MAX_YEARS, 3, 9, 12);
+        AssertTrue(!LocalCalendar::Shared(Local(2012, 6, 1), far) &&
+                   GetLocalDay(far, day) && day.start == Local(2012 + LOCAL_CALENDAR_MAX_YEARS, 3, 9) &&
+                   day.end == Local(2012 + LOCAL_CALENDAR_MAX_YEARS, 3, 10) &&
+                   GetLocalMonth(far, month) && month.start == Local(2012 + LOCAL_CALENDAR_MAX_YEARS, 3, 1),
+                   L"GetLocalDay/GetLocalMonth fall back to the CRT outside the window");
+    }
+
+    HistorySampleProducer CalendarRows(std::time_t from, std::time_t to, std::time_t step)
+    {
+        return [from, to, step](const HistorySampleVisitor& sink) {
+            HistorySampleView row = {};
+            unsigned long long i = 0;
+            for (std::time_t t = from; t < to; t += step, ++i)
+            {
+                row.timestamp = t;
+                row.interfaceName = CALENDAR_IFACES[i % 2];
+                row.bytesDown = 100 + i % 1000;
+                row.bytesUp = 1 + i % 10;
+                if (!sink(row))
+                {
+                    return false;
+                }
+            }
+            return true;
+        };
+    }
+
+    // Reference totals keyed by local day (or month) start, via localtime_s
+    // on every row
+    std::map<std::time_t, std::pair<unsigned long long, unsigned long long>>
+    SlowCalendarTotals(CalendarUnit unit, std::time_t from, std::time_t to, const std::wstring* filter)
+    {
+        std::map<std::time_t, std::pair<unsigned long long, unsigned long long>> totals;
+        HistoryQuery query;
+        query.from = from;
+        query.to = to;
+        query.interfaceFilter = filter;
+        HistoryLogger::Instance().ForEachSample(query, [&](const HistorySampleView& row) {
+            std::tm local = {};
+            localtime_s(&local, &row.timestamp);
+            std::time_t key = Local(local.tm_year + 1900, local.tm_mon + 1,
+                                    (unit == CalendarUnit::Month) ? 1 : local.tm_mday);
+            totals[key].first += row.bytesDown;
+            totals[key].second += row.bytesUp;
+            return true;
+        });
+        return totals;
+    }
+
+    bool CalendarTotalsMatch(CalendarUnit unit, std::time_t from, std::time_t to, const std::wstring* filter,
+                             size_t expectedPeriods)
+    {
+        std::vector<CalendarTotal> totals;
+        if (!HistoryLogger::Instance().GetCalendarTotals(unit, from, to, filter, totals) ||
+            totals.size() != expectedPeriods)
+        {
+            return false;
+        }
+
+        auto expected = SlowCalendarTotals(unit, from, to, filter);
+        if (expected.size() != totals.size())
+        {
+            return false;
+        }
+
+        size_t i = 0;
+        for (const auto& entry : expected)
+        {
+            const CalendarTotal& total = totals[i++];
+            CalendarSpan span;
+            bool spanOk = (unit == CalendarUnit::Month) ? GetLocalMonth(entry.first, span)
+                                                        : GetLocalDay(entry.first, span);
+            if (!spanOk || total.start != entry.first || total.end != span.end ||
+                total.bytesDown != entry.second.first || total.bytesUp != entry.second.second)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void RunHistoryChecks()
+    {
+        ScopedTimeZone zone("EST5EDT");
+        HistoryLogger& logger = HistoryLogger::Instance();
+        AssertTrue(logger.DeleteAll(), L"HistoryLogger.DeleteAll before calendar tests");
+
+        // Every 7 minutes from 28 February to 12 March 2025, across the
+        // spring DST change and a month boundary
+        std::time_t from = Local(2025, 2, 28, 5);
+        std::time_t to = Local(2025, 3, 12, 18);
+        HistoryImportOptions options;
+        options.progressInterval = 0;
+        AssertTrue(logger.ImportSamples(CalendarRows(from, to, 7 * 60), options),
+                   L"HistoryLogger.ImportSamples rows for calendar totals");
+
+        std::time_t dayFrom = Local(2025, 2, 28);
+        std::time_t dayTo = Local(2025, 3, 13);
+        AssertTrue(CalendarTotalsMatch(CalendarUnit::Day, dayFrom, dayTo, nullptr, 13),
+                   L"HistoryLogger.GetCalendarTotals: daily totals match per-row localtime");
+        AssertTrue(CalendarTotalsMatch(CalendarUnit::Day, dayFrom, dayTo, &CALENDAR_IFACES[1], 13),
+                   L"HistoryLogger.GetCalendarTotals: daily totals for one interface");
+        AssertTrue(CalendarTotalsMatch(CalendarUnit::Day, from + 1, to - 1, nullptr, 13),
+                   L"HistoryLogger.GetCalendarTotals: unaligned range reads raw rows");
+        AssertTrue(CalendarTotalsMatch(CalendarUnit::Month, dayFrom, dayTo, nullptr, 2),
+                   L"HistoryLogger.GetCalendarTotals: monthly totals match per-row localtime");
+
+        std::vector<CalendarTotal> totals;
+        AssertTrue(logger.GetCalendarTotals(CalendarUnit::Day, dayFrom, dayTo, nullptr, totals) &&
+                   totals[9].start == Local(2025, 3, 9) && totals[9].end - totals[9].start == 23 * 3600,
+                   L"HistoryLogger.GetCalendarTotals: the DST change day is 23 hours long");
+        AssertTrue(!logger.GetCalendarTotals(CalendarUnit::Day, dayTo, dayFrom, nullptr, totals) &&
+                   totals.empty(),
+                   L"HistoryLogger.GetCalendarTotals rejects an empty range");
+
+        logger.DeleteAll();
+    }
+
+    unsigned long long BenchmarkTimestampCount()
+    {
+        // Full-scale runs: set NETWORKMONITOR_CALENDAR_BENCH_ROWS=100000000
+        wchar_t value[32] = {0};
+        DWORD len = GetEnvironmentVariableW(L"NETWORKMONITOR_CALENDAR_BENCH_ROWS", value, 32);
+        if (len > 0 && len < 32)
+        {
+            unsigned long long count = std::wcstoull(value, nullptr, 10);
+            if (count > 0)
+            {
+                return count;
+            }
+        }
+        return 10000000ULL;
+    }
+
+    // Bucket timestamps spread over the default window into local days, once
+    // with the calendar and once with localtime_s per timestamp
+    void RunBucketingBenchmark()
+    {
+        std::shared_ptr<const LocalCalendar> calendar = LocalCalendar::Shared(std::time(nullptr));
+        if (!calendar)
+        {
+            AssertTrue(false, L"LocalCalendar.Shared for the benchmark");
+            return;
+        }
+
+        const unsigned long long count = BenchmarkTimestampCount();
+        const long long first = static_cast<long long>(calendar->DayStart(0));
+        const long long span = static_cast<long long>(calendar->DayEnd(calendar->DayCount() - 1)) - first;
+
+        // Day index of 1 January of each year, to key the localtime_s result
+        std::vector<int> yearFirstDay;
+        for (int year = calendar->FirstYear(); year <= calendar->LastYear(); ++year)
+        {
+            yearFirstDay.push_back(calendar->DayIndex(calendar->MonthStart((year - calendar->FirstYear()) * 12)));
+        }
+
+        std::vector<unsigned int> fastCounts(static_cast<size_t>(calendar->DayCount()), 0);
+        std::vector<unsigned int> slowCounts(fastCounts.size(), 0);
+
+        auto start = std::chrono::steady_clock::now();
+        unsigned long long state = 1;
+        for (unsigned long long i = 0; i < count; ++i)
+        {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            std::time_t t = static_cast<std::time_t>(first + static_cast<long long>((state >> 16) % span));
+            ++fastCounts[calendar->DayIndex(t)];
+        }
+        double fastMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        state = 1;
+        for (unsigned long long i = 0; i < count; ++i)
+        {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            std::time_t t = static_cast<std::time_t>(first + static_cast<long long>((state >> 16) % span));
+            std::tm local = {};
+            localtime_s(&local, &t);
+            ++slowCounts[yearFirstDay[local.tm_year + 1900 - calendar->FirstYear()] + local.tm_yday];
+        }
+        double slowMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        AssertTrue(fastCounts == slowCounts, L"LocalCalendar benchmark: table and localtime_s buckets agree");
+
+        std::wstring msg = L"[bench] bucket " + std::to_wstring(count) + L" timestamps by local day: calendar " +
+                           std::to_wstring(static_cast<unsigned long long>(fastMs)) + L" ms, localtime_s " +
+                           std::to_wstring(static_cast<unsigned long long>(slowMs)) + L" ms";
+        LogTestMessage(msg.c_str());
+    }
+}
+
+void RunLocalCalendarTests()
+{
+    LogTestMessage(L"=== LocalCalendar tests ===");
+
+    RunTableChecks();
+    RunSharedChecks();
+    RunHistoryChecks();
+    RunBucketingBenchmark();
+}
+
+} // namespace NetworkMonitorTests
@@ -0,0 +1,121 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/BinaryLog.h"
+#include "NetworkMonitor/Utils.h"
+#include "TestUtils.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    int g_evaluations = 0;
+
+    std::wstring CountedMessage(int value)
+    {
+        ++g_evaluations;
+        return L"HistoryLogger::GetRecentSamples: " + std::to_wstring(value) + L" samples returned";
+    }
+
+    int CountedValue(int value)
+    {
+        ++g_evaluations;
+        return value;
+    }
+
+    void TestAllocationCounterWorks()
+    {
+        unsigned long long before = GetThreadAllocationCount();
+        std::wstring message = CountedMessage(1);
+        AssertTrue(GetThreadAllocationCount() > before, L"LogMacros: building a message is seen as an allocation");
+    }
+
+    void TestDisabledDebugDoesNotAllocate()
+    {
+        SetDebugLoggingEnabled(false);
+        g_evaluations = 0;
+        static constexpr LogFormat format(L"HistoryLogger::GetRecentSamples: {} samples returned");
+
+        unsigned long long before = GetThreadAllocationCount();
+        for (int i = 0; i < 1000; ++i)
+        {
+            NM_LOG_DEBUG(CountedMessage(i));
+            NM_LOG_DEBUG(L"HistoryLogger::GetRecentSamples: " + std::to_wstring(i) + L" samples returned");
+            NM_LOG_DEBUG_FORMAT(format, CountedValue(i));
+        }
+        AssertTrue(GetThreadAllocationCount() == before, L"LogMacros: disabled debug logging does not allocate");
+        AssertTrue(g_evaluations == 0, L"LogMacros: disabled debug logging does not evaluate its arguments");
+    }
+
+    void TestCompiledOutLevels()
+    {
+        g_evaluations = 0;
+        unsigned long long before = GetThreadAllocationCount();
+
+        // Levels are checked where the macro expands
+#pragma push_macro("NM_MIN_LOG_LEVEL")
+#undef NM_MIN_LOG_LEVEL
+#define NM_MIN_LOG_LEVEL NM_LOG_LEVEL_NONE
+        NM_LOG_ERROR(CountedMessage(1));
+        NM_LOG_ERROR_FORMAT(LogFormat(L"error {}"), CountedValue(2));
+#pragma pop_macro("NM_MIN_LOG_LEVEL")
+
+        AssertTrue(GetThreadAllocationCount() == before && g_evaluations == 0,
+                   L"LogMacros: levels below NM_MIN_LOG_LEVEL are compiled out, errors included");
+    }
+
+    void TestEnabledDebugEvaluatesOnce()
+    {
+#if NM_MIN_LOG_LEVEL <= NM_LOG_LEVEL_DEBUG
+        g_evaluations = 0;
+        SetDebugLoggingEnabled(true);
+        NM_LOG_DEBUG(CountedMessage(7));
+        SetDebugLoggingEnabled(false);
+        AssertTrue(g_evaluations == 1, L"LogMacros: enabled debug logging evaluates the message once");
+#endif
+    }
+
+    // A disabled NM_LOG_DEBUG against the old build-then-check call
+    void BenchmarkDisabledDebug()
+    {
+        SetDebugLoggingEnabled(false);
+        const int calls = 1000000;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < calls; ++i)
+        {
+            LogDebug(L"HistoryLogger::GetRecentSamples: " + std::to_wstring(i) + L" samples returned");
+        }
+        double eager = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < calls; ++i)
+        {
+            NM_LOG_DEBUG(L"HistoryLogger::GetRecentSamples: " + std::to_wstring(i) + L" samples returned");
+        }
+        double lazy = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        wchar_t msg[200] = {0};
+        swprintf(msg, 200, L"[bench] disabled debug log ns/call: build then check %.1f, NM_LOG_DEBUG %.2f",
+                 eager / calls, lazy / calls);
+        LogTestMessage(msg);
+    }
+}
+
+void RunLogMacroTests()
+{
+    LogTestMessage(L"=== LogMacros tests ===");
+
+    TestAllocationCounterWorks();
+    TestDisabledDebugDoesNotAllocate();
+    TestCompiledOutLevels();
+    TestEnabledDebugEvaluatesOnce();
+    BenchmarkDisabledDebug();
+}
+
+} // namespace NetworkMonitorTests
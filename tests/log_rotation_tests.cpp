@@ -0,0 +1,622 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/BinaryLog.h"
+#include "NetworkMonitor/DiagnosticLog.h"
+#include "NetworkMonitor/LogRotation.h"
+#include "TestUtils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cwchar>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    std::string ReadWholeFile(const std::wstring& path)
+    {
+        std::string text;
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return text;
+        }
+        char buffer[64 * 1024];
+        DWORD read = 0;
+        while (ReadFile(file, buffer, sizeof(buffer), &read, nullptr) && read > 0)
+        {
+            text.append(buffer, read);
+        }
+        CloseHandle(file);
+        return text;
+    }
+
+    bool WriteWholeFile(const std::wstring& path, const std::string& data)
+    {
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        DWORD written = 0;
+        bool ok = WriteFile(file, data.data(), static_cast<DWORD>(data.size()), &written, nullptr) &&
+                  written == data.size();
+        CloseHandle(file);
+        return ok;
+    }
+
+    void DeleteLogAndArchives(const std::wstring& path)
+    {
+        for (const std::wstring& archive : ListLogArchives(path))
+        {
+            DeleteFileW(archive.c_str());
+        }
+        DeleteFileW(path.c_str());
+    }
+
+    unsigned int Crc32(const std::string& data)
+    {
+        unsigned int crc = 0xFFFFFFFFU;
+        for (unsigned char byte : data)
+        {
+            crc ^= byte;
+            for (int k = 0; k < 8; ++k)
+            {
+                crc = (crc & 1) ? (0xEDB88320U ^ (crc >> 1)) : (crc >> 1);
+            }
+        }
+        return crc ^ 0xFFFFFFFFU;
+    }
+
+    // Just enough of RFC 1951 / 1952 to check what CompressFileToGzip
+    // writes: stored and fixed-Huffman blocks, CRC and size trailer
+    class GzipReader
+    {
+    public:
+        explicit GzipReader(const std::string& data)
+            : m_data(data)
+            , m_pos(10)
+            , m_bits(0)
+            , m_count(0)
+        {
+        }
+
+        bool Inflate(std::string& out)
+        {
+            if (m_data.size() < 18 || static_cast<unsigned char>(m_data[0]) != 0x1F ||
+                static_cast<unsigned char>(m_data[1]) != 0x8B || m_data[2] != 8 || m_data[3] != 0)
+            {
+                return false;
+            }
+
+            static const unsigned short lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27,
+                                                           31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195,
+                                                           227, 258 };
+            static const unsigned char lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                                           3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+            static const unsigned short distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97,
+                                                             129, 193, 257, 385, 513, 769, 1025, 1537, 2049,
+                                                             3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+            static const unsigned char distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                                             7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+            bool last = false;
+            while (!last)
+            {
+                last = Bits(1) == 1;
+                int type = Bits(2);
+                if (type == 0)
+                {
+                    m_bits = 0;
+                    m_count = 0;
+                    if (m_pos + 4 > m_data.size())
+                    {
+                        return false;
+                    }
+                    size_t length = static_cast<unsigned char>(m_data[m_pos]) |
+                                    (static_cast<unsigned char>(m_data[m_pos + 1]) << 8);
+                    m_pos += 4;
+                    if (m_pos + length > m_data.size())
+                    {
+                        return false;
+                    }
+                    out.append(m_data, m_pos, length);
+                    m_pos += length;
+                    continue;
+                }
+                if (type != 1)
+                {
+                    return false;
+                }
+
+                for (;;)
+                {
+                    int symbol = FixedSymbol();
+                    if (symbol < 0)
+                    {
+                        return false;
+                    }
+                    if (symbol < 256)
+                    {
+                        out += static_cast<char>(symbol);
+                        continue;
+                    }
+                    if (symbol == 256)
+                    {
+                        break;
+                    }
+                    int index = symbol - 257;
+                    if (index >= 29)
+                    {
+                        return false;
+                    }
+                    size_t length = lengthBase[index] + Bits(lengthExtra[index]);
+                    int distanceCode = 0;
+                    for (int i = 0; i < 5; ++i)
+                    {
+                        distanceCode = (distanceCode << 1) | Bits(1);
+                    }
+                    if (distanceCode >= 30)
+                    {
+                        return false;
+                    }
+                    size_t distance = distanceBase[distanceCode] + Bits(distanceExtra[distanceCode]);
+                    if (distance > out.size())
+                    {
+                        return false;
+                    }
+                    size_t from = out.size() - distance;
+                    for (size_t i = 0; i < length; ++i)
+                    {
+                        out += out[from + i];
+                    }
+                }
+            }
+
+            // Trailer starts on the next byte
+            m_bits = 0;
+            m_count = 0;
+            if (m_pos + 8 != m_data.size())
+            {
+                return false;
+            }
+            unsigned int crc = ReadLittleEndian32(m_pos);
+            unsigned int size = ReadLittleEndian32(m_pos + 4);
+            return crc == Crc32(out) && size == static_cast<unsigned int>(out.size());
+        }
+
+    private:
+        int Bits(int length)
+        {
+            while (m_count < length)
+            {
+                unsigned int byte = (m_pos < m_data.size()) ? static_cast<unsigned char>(m_data[m_pos]) : 0;
+                ++m_pos;
+                m_bits |= byte << m_count;
+                m_count += 8;
+            }
+            int value = static_cast<int>(m_bits & ((1U << length) - 1));
+            m_bits >>= length;
+            m_count -= length;
+            return value;
+        }
+
+        // Fixed codes are read most significant bit first
+        int FixedSymbol()
+        {
+            int code = 0;
+            for (int i = 0; i < 7; ++i)
+            {
+                code = (code << 1) | Bits(1);
+            }
+            if (code <= 0x17)
+            {
+                return 256 + code;
+            }
+            code = (code << 1) | Bits(1);
+            if (code >= 0x30 && code <= 0xBF)
+            {
+                return code - 0x30;
+            }
+            if (code >= 0xC0 && code <= 0xC7)
+            {
+                return 280 + (code - 0xC0);
+            }
+            code = (code << 1) | Bits(1);
+            if (code >= 0x190 && code <= 0x1FF)
+            {
+                return 144 + (code - 0x190);
+            }
+            return -1;
+        }
+
+        unsigned int ReadLittleEndian32(size_t at) const
+        {
+            unsigned int value = 0;
+            for (int i = 3; i >= 0; --i)
+            {
+                value = (value << 8) | static_cast<unsigned char>(m_data[at + static_cast<size_t>(i)]);
+            }
+            return value;
+        }
+
+        const std::string& m_data;
+        size_t m_pos;
+        unsigned int m_bits;
+        int m_count;
+    };
+
+    bool EndsWithGz(const std::wstring& path)
+    {
+        return path.size() > 3 && path.compare(path.size() - 3, 3, L".gz") == 0;
+    }
+
+    // Contents of a log file or archive, decompressed; false for a bad .gz
+    bool ReadLogContents(const std::wstring& path, std::string& out)
+    {
+        std::string raw = ReadWholeFile(path);
+        if (!EndsWithGz(path))
+        {
+            out = raw;
+            return true;
+        }
+        out.clear();
+        return GzipReader(raw).Inflate(out);
+    }
+
+    std::vector<std::string> SplitLines(const std::string& text)
+    {
+        std::vector<std::string> lines;
+        size_t start = 0;
+        while (start < text.size())
+        {
+            size_t end = text.find("\r\n", start);
+            if (end == std::string::npos)
+            {
+                lines.push_back(text.substr(start));
+                break;
+            }
+            lines.push_back(text.substr(start, end - start));
+            start = end + 2;
+        }
+        return lines;
+    }
+
+    // Text that looks like the debug log: repeated prefixes, changing numbers
+    std::string MakeLogLikeText(size_t bytes)
+    {
+        std::string text;
+        unsigned int seed = 12345;
+        for (int i = 0; text.size() < bytes; ++i)
+        {
+            seed = seed * 1103515245U + 12345U;
+            char line[160] = {0};
+            snprintf(line, sizeof(line),
+                     "2026-10-18 12:%02d:%02d [DEBUG] HistoryLogger::GetRecentSamples: %u samples returned "
+                     "(limit=100, interface=Ethernet %d)\r\n",
+                     (i / 60) % 60, i % 60, (seed >> 16) % 5000, i % 4);
+            text += line;
+        }
+        text.resize(bytes);
+        return text;
+    }
+
+    void TestGzipRoundTrip()
+    {
+        std::wstring source = TempFilePath(L"nm_rotation_source.log");
+        std::wstring target = TempFilePath(L"nm_rotation_source.log.gz");
+
+        // Log text past one read chunk, then bytes that hardly compress
+        std::string text = MakeLogLikeText(1536 * 1024);
+        unsigned int seed = 99;
+        for (int i = 0; i < 70000; ++i)
+        {
+            seed = seed * 1103515245U + 12345U;
+            text += static_cast<char>(seed >> 24);
+        }
+        text += std::string(1000, 'x');
+
+        AssertTrue(WriteWholeFile(source, text), L"LogRotation: test source written");
+        AssertTrue(CompressFileToGzip(source, target), L"LogRotation: CompressFileToGzip succeeds");
+
+        std::string compressed = ReadWholeFile(target);
+        std::string restored;
+        AssertTrue(GzipReader(compressed).Inflate(restored) && restored == text,
+                   L"LogRotation: gzip output inflates to the source with a matching CRC and size");
+        AssertTrue(compressed.size() < text.size() / 3, L"LogRotation: log text compresses at least three times");
+
+        AssertTrue(WriteWholeFile(source, std::string()), L"LogRotation: empty source written");
+        AssertTrue(CompressFileToGzip(source, target), L"LogRotation: an empty file compresses");
+        compressed = ReadWholeFile(target);
+        restored.clear();
+        AssertTrue(GzipReader(compressed).Inflate(restored) && restored.empty(),
+                   L"LogRotation: an empty file round-trips");
+
+        AssertTrue(!CompressFileToGzip(TempFilePath(L"nm_rotation_missing.log"), target),
+                   L"LogRotation: a missing source fails");
+
+        DeleteFileW(source.c_str());
+        DeleteFileW(target.c_str());
+    }
+
+    DiagnosticLogOptions TextLogOptions(const std::wstring& path, unsigned long long maxFileBytes,
+                                        unsigned int keepFiles)
+    {
+        DiagnosticLogOptions options;
+        options.path = path;
+        options.capacity = 1 << 16;
+        options.flushIntervalMs = 20;
+        options.rotation.maxFileBytes = maxFileBytes;
+        options.rotation.keepFiles = keepFiles;
+        return options;
+    }
+
+    // Producers racing rotations: every line ends up in exactly one file,
+    // in order per producer, and no file passes the cap
+    void TestConcurrentWritersAcrossRotations()
+    {
+        std::wstring path = TempFilePath(L"nm_rotation_mpsc.log");
+        DeleteLogAndArchives(path);
+
+        const int threads = 4;
+        const int perThread = 5000;
+        const unsigned long long cap = 4096;
+        DiagnosticLogStats stats;
+        {
+            DiagnosticLog log(TextLogOptions(path, cap, 100000));
+            std::vector<std::thread> producers;
+            for (int t = 0; t < threads; ++t)
+            {
+                producers.emplace_back([&log, t, perThread]() {
+                    for (int i = 0; i < perThread; ++i)
+                    {
+                        while (!log.Push(LogLevel::Debug, L"p" + std::to_wstring(t) + L" " + std::to_wstring(i)))
+                        {
+                            std::this_thread::yield();
+                        }
+                    }
+                });
+            }
+            for (std::thread& producer : producers)
+            {
+                producer.join();
+            }
+            log.Flush();
+            stats = log.GetStats();
+        }
+
+        std::vector<std::wstring> files = ListLogArchives(path);
+        size_t compressed = static_cast<size_t>(std::count_if(files.begin(), files.end(), EndsWithGz));
+        AssertTrue(!files.empty() && compressed == files.size(),
+                   L"LogRotation: every archive is compressed once the log is closed");
+        AssertTrue(stats.rotations == files.size(), L"LogRotation: stats count each rotation");
+        files.push_back(path);
+
+        std::vector<int> next(threads, 0);
+        bool readable = true;
+        bool underCap = true;
+        bool ordered = true;
+        for (const std::wstring& file : files)
+        {
+            std::string contents;
+            readable = readable && ReadLogContents(file, contents);
+            underCap = underCap && contents.size() <= cap;
+            for (const std::string& line : SplitLines(contents))
+            {
+                size_t at = line.find("] p");
+                if (at == std::string::npos)
+                {
+                    ordered = false;
+                    continue;
+                }
+                int producer = std::atoi(line.c_str() + at + 3);
+                int index = std::atoi(line.c_str() + line.find(' ', at + 3) + 1);
+                if (producer < 0 || producer >= threads || index != next[producer])
+                {
+                    ordered = false;
+                    continue;
+                }
+                ++next[producer];
+            }
+        }
+        AssertTrue(readable, L"LogRotation: archives decompress");
+        AssertTrue(underCap, L"LogRotation: no file grows past the size cap");
+        AssertTrue(ordered && std::all_of(next.begin(), next.end(), [perThread](int n) { return n == perThread; }),
+                   L"LogRotation: each line appears once, in order, across the live file and archives");
+
+        DeleteLogAndArchives(path);
+    }
+
+    void TestPruneKeepsNewest()
+    {
+        std::wstring path = TempFilePath(L"nm_rotation_prune.log");
+        DeleteLogAndArchives(path);
+
+        LogRotationStats stats;
+        {
+            RotatingLogFile file(path);
+            LogRotationOptions options;
+            options.maxFileBytes = 64;
+            options.keepFiles = 2;
+            file.SetOptions(options);
+            for (int i = 0; i < 6; ++i)
+            {
+                std::string line = "file " + std::to_string(i) + "\r\n";
+                AssertTrue(file.Append(line.data(), line.size()), L"LogRotation: Append writes");
+                AssertTrue(file.Rotate(), L"LogRotation: Rotate moves the file aside");
+            }
+            AssertTrue(file.IsEmpty(), L"LogRotation: a rotated file starts empty");
+            AssertTrue(file.Rotate() && file.GetStats().rotations == 6,
+                       L"LogRotation: rotating an empty file leaves it in place");
+        }
+
+        std::vector<std::wstring> archives = ListLogArchives(path);
+        std::string newest;
+        std::string older;
+        AssertTrue(archives.size() == 2, L"LogRotation: archives are pruned to keepFiles");
+        AssertTrue(archives.size() == 2 && ReadLogContents(archives[1], newest) && newest == "file 5\r\n" &&
+                   ReadLogContents(archives[0], older) && older == "file 4\r\n",
+                   L"LogRotation: pruning removes the oldest archives");
+
+        DeleteLogAndArchives(path);
+    }
+
+    void TestLeftoverArchivesAreCompressed()
+    {
+        std::wstring path = TempFilePath(L"nm_rotation_leftover.log");
+        DeleteLogAndArchives(path);
+
+        // An archive an earlier run moved aside but never compressed
+        std::wstring leftover = TempFilePath(L"nm_rotation_leftover.20260101-000000-000.log");
+        WriteWholeFile(leftover, "old line\r\n");
+        {
+            RotatingLogFile file(path);
+            AssertTrue(file.GetRoom() > 0, L"LogRotation: opening the file sweeps leftovers");
+        }
+
+        std::vector<std::wstring> archives = ListLogArchives(path);
+        std::string contents;
+        AssertTrue(archives.size() == 1 && EndsWithGz(archives[0]) && ReadLogContents(archives[0], contents) &&
+                   contents == "old line\r\n",
+                   L"LogRotation: an uncompressed leftover archive is compressed on open");
+
+        DeleteLogAndArchives(path);
+    }
+
+    void TestAgeRotation()
+    {
+        std::wstring path = TempFilePath(L"nm_rotation_age.log");
+        DeleteLogAndArchives(path);
+
+        {
+            DiagnosticLogOptions options = TextLogOptions(path, 0, 10);
+            options.rotation.maxFileAgeSeconds = 1;
+            DiagnosticLog log(options);
+            log.Push(LogLevel::Debug, L"first");
+            log.Flush();
+            AssertTrue(ListLogArchives(path).empty(), L"LogRotation: a young file is not rotated");
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+            log.Push(LogLevel::Debug, L"second");
+            log.Flush();
+            AssertTrue(log.GetStats().rotations == 1, L"LogRotation: an aged file rotates before the next write");
+        }
+
+        std::vector<std::wstring> archives = ListLogArchives(path);
+        std::string archived;
+        std::vector<std::string> live = SplitLines(ReadWholeFile(path));
+        AssertTrue(archives.size() == 1 && ReadLogContents(archives[0], archived) &&
+                   archived.find("first") != std::string::npos && archived.find("second") == std::string::npos,
+                   L"LogRotation: the aged file holds the earlier line");
+        AssertTrue(live.size() == 1 && live[0].find("second") != std::string::npos,
+                   L"LogRotation: the new file starts with the later line");
+
+        DeleteLogAndArchives(path);
+    }
+
+    // Every binary archive starts its own session and decodes on its own
+    void TestBinaryLogRotation()
+    {
+        std::wstring path = TempFilePath(L"nm_rotation_binary.binlog");
+        std::wstring inflated = TempFilePath(L"nm_rotation_binary_inflated.binlog");
+        DeleteLogAndArchives(path);
+
+        static constexpr LogFormat format(L"sample {} on {}");
+        const int records = 20000;
+        BinaryLogStats stats;
+        {
+            BinaryLogOptions options;
+            options.path = path;
+            options.threadBufferBytes = 1 << 20;
+            options.flushIntervalMs = 5;
+            options.rotation.maxFileBytes = 16 * 1024;
+            options.rotation.keepFiles = 1000;
+            BinaryLog log(options);
+            for (int i = 0; i < records; ++i)
+            {
+                while (!log.Write(LogLevel::Debug, format, i, LogInterned(L"Ethernet")))
+                {
+                    std::this_thread::yield();
+                }
+            }
+            log.Flush();
+            stats = log.GetStats();
+        }
+
+        std::vector<std::wstring> files = ListLogArchives(path);
+        AssertTrue(stats.rotations > 0 && stats.rotations == files.size(), L"LogRotation: the binary log rotates");
+        files.push_back(path);
+
+        unsigned long long decoded = 0;
+        int expected = 0;
+        bool allDecode = true;
+        bool ordered = true;
+        for (const std::wstring& file : files)
+        {
+            std::string contents;
+            allDecode = allDecode && ReadLogContents(file, contents) && WriteWholeFile(inflated, contents);
+            if (contents.empty() && file == path)
+            {
+                continue;   // Rotated right after its last batch
+            }
+            allDecode = allDecode && ReadBinaryLog(inflated, [&](const DecodedLogRecord& record) {
+                ++decoded;
+                ordered = ordered && record.text == L"sample " + std::to_wstring(expected) + L" on Ethernet";
+                ++expected;
+            });
+        }
+        AssertTrue(allDecode, L"LogRotation: each binary archive decodes on its own");
+        AssertTrue(ordered && decoded == stats.written && decoded == static_cast<unsigned long long>(records),
+                   L"LogRotation: binary records are split across files without loss or repeats");
+
+        DeleteFileW(inflated.c_str());
+        DeleteLogAndArchives(path);
+    }
+
+    void BenchmarkCompression()
+    {
+        std::wstring source = TempFilePath(L"nm_rotation_bench.log");
+        std::wstring target = TempFilePath(L"nm_rotation_bench.log.gz");
+
+        std::string text = MakeLogLikeText(8 * 1024 * 1024);
+        WriteWholeFile(source, text);
+
+        auto start = std::chrono::steady_clock::now();
+        bool ok = CompressFileToGzip(source, target);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        size_t compressedBytes = ReadWholeFile(target).size();
+        AssertTrue(ok, L"LogRotation: benchmark compression succeeds");
+
+        wchar_t msg[200] = {0};
+        swprintf(msg, 200, L"[bench] gzip of %zu bytes of log text: ratio %.1fx, %.1f MB/s",
+                 text.size(), static_cast<double>(text.size()) / (compressedBytes ? compressedBytes : 1),
+                 text.size() / (1024.0 * 1024.0) / (seconds > 0 ? seconds : 1e-9));
+        LogTestMessage(msg);
+
+        DeleteFileW(source.c_str());
+        DeleteFileW(target.c_str());
+    }
+}
+
+void RunLogRotationTests()
+{
+    LogTestMessage(L"=== LogRotation tests ===");
+
+    TestGzipRoundTrip();
+    TestConcurrentWritersAcrossRotations();
+    TestPruneKeepsNewest();
+    TestLeftoverArchivesAreCompressed();
+    TestAgeRotation();
+    TestBinaryLogRotation();
+    BenchmarkCompression();
+}
+
+} // namespace NetworkMonitorTests
@@ -9,10 +9,34 @@
 namespace NetworkMonitorTests
 {
 void RunHistoryLoggerTests();
+void RunHistoryLoggerConcurrencyTests();
+void RunHistoryExportTests();
+void RunHistoryImportTests();
+void RunHistoryStatisticsTests();
+void RunBillingCycleTests();
+void RunLocalCalendarTests();
+void RunAsyncQueryTests();
+void RunHistoryMaintenanceTests();
+void RunUsageDeltaTests();
+void RunHistoryRetentionTests();
+void RunHistoryCoalescingTests();
+void RunHistoryBackupTests();
+void RunSampleJournalTests();
+bool RunSampleJournalChildProcess(int& exitCode);
 void RunNetworkMonitorTests();
 void RunUtilsTests();
+void RunDiagnosticLogTests();
+void RunBinaryLogTests();
+void RunLogRotationTests();
+void RunLogMacroTests();
+void RunValueFormatTests();
+void RunUnitsTests();
+void RunStringCatalogTests();
 void RunNetworkCalculatorTests();
 void RunConfigManagerTests();
+void RunConfigFileTests();
+void RunConfigStoreTests();
+void RunProbeEngineTests();
 void RunTrayIconTests();
 void RunTaskbarOverlayTests();
 }
@@ -21,13 +45,43 @@ using namespace NetworkMonitorTests;
 
 int main()
 {
+    // Crash-safety tests re-launch this executable as a child process
+    int childExitCode = 0;
+    if (RunSampleJournalChildProcess(childExitCode))
+    {
+        return childExitCode;
+    }
+
     LogTestMessage(L"Running NetworkMonitor tests...");
 
     RunHistoryLoggerTests();
+    RunHistoryLoggerConcurrencyTests();
+    RunHistoryExportTests();
+    RunHistoryImportTests();
+    RunHistoryStatisticsTests();
+    RunBillingCycleTests();
+    RunLocalCalendarTests();
+    RunAsyncQueryTests();
+    RunHistoryMaintenanceTests();
+    RunUsageDeltaTests();
+    RunHistoryRetentionTests();
+    RunHistoryCoalescingTests();
+    RunHistoryBackupTests();
+    RunSampleJournalTests();
     RunNetworkMonitorTests();
     RunUtilsTests();
+    RunDiagnosticLogTests();
+    RunBinaryLogTests();
+    RunLogRotationTests();
+    RunLogMacroTests();
+    RunValueFormatTests();
+    RunUnitsTests();
+    RunStringCatalogTests();
     RunNetworkCalculatorTests();
     RunConfigManagerTests();
+    RunConfigFileTests();
+    RunConfigStoreTests();
+    RunProbeEngineTests();
     RunTrayIconTests();
     RunTaskbarOverlayTests();
 
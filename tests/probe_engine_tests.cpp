@@ -0,0 +1,252 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/ProbeEngine.h"
+#include "TestUtils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+#include <thread>
+#include <vector>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    // IPv4 address in network byte order
+    uint32_t Ipv4(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+    {
+        const uint8_t bytes[4] = { a, b, c, d };
+        uint32_t address = 0;
+        std::memcpy(&address, bytes, sizeof(address));
+        return address;
+    }
+
+    template <typename Condition>
+    bool WaitFor(Condition condition, int timeoutMs)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        while (!condition())
+        {
+            if (std::chrono::steady_clock::now() >= deadline)
+            {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return true;
+    }
+
+    void TestLoopbackReplies(ProbeEngine& engine)
+    {
+        std::vector<unsigned int> ids;
+        for (uint8_t host = 1; host <= 8; ++host)
+        {
+            ids.push_back(engine.AddTarget(Ipv4(127, 0, 0, host), 50));
+        }
+        AssertTrue(engine.GetTargetCount() == ids.size(), L"ProbeEngine: targets are counted");
+
+        bool replied = WaitFor([&]() {
+            for (unsigned int id : ids)
+            {
+                ProbeStats stats;
+                if (!engine.GetStats(id, stats) || stats.received < 2)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }, 3000);
+        AssertTrue(replied, L"ProbeEngine: every loopback target answers");
+
+        ProbeStats stats;
+        engine.GetStats(ids[0], stats);
+        AssertTrue(stats.lastRttMs >= 0.0 && stats.lost == 0,
+                   L"ProbeEngine: loopback replies carry a round-trip time");
+
+        for (unsigned int id : ids)
+        {
+            engine.RemoveTarget(id);
+        }
+        AssertTrue(engine.GetTargetCount() == 0 && !engine.GetStats(ids[0], stats),
+                   L"ProbeEngine: removed targets are gone");
+    }
+
+    // TEST-NET-3 is never routed, so its probes time out (or fail to send)
+    void TestUnreachable(ProbeEngine& engine)
+    {
+        unsigned int id = engine.AddTarget(Ipv4(203, 0, 113, 1), 50, 100);
+        bool lost = WaitFor([&]() {
+            ProbeStats stats;
+            return engine.GetStats(id, stats) && stats.lost >= 2;
+        }, 3000);
+
+        ProbeStats stats;
+        engine.GetStats(id, stats);
+        AssertTrue(lost && stats.received == 0 && stats.lastRttMs < 0.0,
+                   L"ProbeEngine: unanswered probes are counted lost");
+        engine.RemoveTarget(id);
+    }
+
+    void TestRemoveAndRestart(ProbeEngine& engine, std::atomic<int>* resultsById, size_t idCount)
+    {
+        unsigned int kept = engine.AddTarget(Ipv4(127, 0, 0, 20), 20);
+        unsigned int removed = engine.AddTarget(Ipv4(127, 0, 0, 21), 20);
+        AssertTrue(kept < idCount && removed < idCount, L"ProbeEngine: IDs are small integers");
+
+        WaitFor([&]() { return resultsById[removed].load() >= 2; }, 3000);
+        engine.RemoveTarget(removed);
+        // Results gathered before the removal may still be delivered
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        int afterRemove = resultsById[removed].load();
+        int keptBefore = resultsById[kept].load();
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        AssertTrue(resultsById[removed].load() == afterRemove && resultsById[kept].load() > keptBefore,
+                   L"ProbeEngine: a removed target reports nothing more");
+
+        // Targets survive a restart
+        engine.Stop();
+        AssertTrue(!engine.IsRunning(), L"ProbeEngine: stops");
+        int keptStopped = resultsById[kept].load();
+        AssertTrue(engine.Start([&, resultsById, idCount](unsigned int id, double) {
+            if (id < idCount)
+            {
+                ++resultsById[id];
+            }
+        }), L"ProbeEngine: restarts");
+        AssertTrue(WaitFor([&]() { return resultsById[kept].load() > keptStopped; }, 3000),
+                   L"ProbeEngine: targets are probed again after a restart");
+        engine.RemoveTarget(kept);
+    }
+
+    // The caller's side never waits on the network, even with many targets
+    // pointed at a black hole
+    void TestNonBlocking(ProbeEngine& engine)
+    {
+        std::vector<unsigned int> ids;
+        auto start = std::chrono::steady_clock::now();
+        for (uint8_t host = 1; host <= 200; ++host)
+        {
+            ids.push_back(engine.AddTarget(Ipv4(203, 0, 113, host), 10, 1000));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        auto callsStart = std::chrono::steady_clock::now();
+        ProbeStats stats;
+        for (unsigned int id : ids)
+        {
+            engine.GetStats(id, stats);
+            engine.SetTargetInterval(id, 20);
+        }
+        for (unsigned int id : ids)
+        {
+            engine.RemoveTarget(id);
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        AssertTrue(!engine.GetStats(ids[0], stats) && !engine.GetStats(ids.back(), stats),
+                   L"ProbeEngine: removed targets are gone at once");
+
+        double addMs = std::chrono::duration<double, std::milli>(callsStart - start).count() - 100.0;
+        double callsMs = std::chrono::duration<double, std::milli>(end - callsStart).count();
+        wchar_t msg[160] = {0};
+        swprintf(msg, 160, L"[bench] probes 200 unreachable targets: add %.2f ms, stats+interval+remove %.2f ms",
+                 addMs, callsMs);
+        LogTestMessage(msg);
+    }
+
+    // 1000 loopback targets probed once a second: the load a large
+    // monitoring setup would put on the engine
+    void BenchmarkThousandTargets()
+    {
+        const int targetCount = 1000;
+        const int runMs = 3000;
+        std::atomic<long long> replies(0);
+        std::atomic<long long> losses(0);
+        std::vector<double> rtts;
+        rtts.reserve(targetCount * 4);
+
+        ProbeEngine engine;
+        bool started = engine.Start([&](unsigned int, double rttMs) {
+            // Only the engine thread writes rtts; it is read after Stop
+            if (rttMs >= 0.0)
+            {
+                ++replies;
+                rtts.push_back(rttMs);
+            }
+            else
+            {
+                ++losses;
+            }
+        });
+        AssertTrue(started, L"ProbeEngine: benchmark engine starts");
+
+        std::vector<unsigned int> ids;
+        for (int i = 0; i < targetCount; ++i)
+        {
+            ids.push_back(engine.AddTarget(Ipv4(127, 1, static_cast<uint8_t>(i / 250),
+                                                static_cast<uint8_t>(i % 250 + 1)), 1000));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(runMs));
+        engine.Stop();
+
+        unsigned long long sent = 0;
+        for (unsigned int id : ids)
+        {
+            ProbeStats stats;
+            engine.GetStats(id, stats);
+            sent += stats.sent;
+        }
+
+        std::sort(rtts.begin(), rtts.end());
+        double p50 = rtts.empty() ? -1.0 : rtts[rtts.size() / 2];
+        double p99 = rtts.empty() ? -1.0 : rtts[rtts.size() * 99 / 100];
+        AssertTrue(sent >= static_cast<unsigned long long>(targetCount) && replies.load() > 0,
+                   L"ProbeEngine: 1000 targets at 1 Hz are all probed");
+
+        wchar_t msg[200] = {0};
+        swprintf(msg, 200, L"[bench] probes 1000 targets @1Hz: %llu sent, %.0f replies/s, %lld lost, rtt p50 %.3f ms p99 %.3f ms",
+                 sent, static_cast<double>(replies.load()) * 1000.0 / runMs, losses.load(), p50, p99);
+        LogTestMessage(msg);
+    }
+}
+
+void RunProbeEngineTests()
+{
+    LogTestMessage(L"=== ProbeEngine tests ===");
+
+    const size_t idCount = 64;
+    std::atomic<int> resultsById[idCount];
+    for (std::atomic<int>& count : resultsById)
+    {
+        count = 0;
+    }
+
+    ProbeEngine engine;
+    bool started = engine.Start([&resultsById, idCount](unsigned int id, double) {
+        if (id < idCount)
+        {
+            ++resultsById[id];
+        }
+    });
+    if (!started)
+    {
+        LogTestMessage(L"ProbeEngine: no ICMP socket available, skipping");
+        return;
+    }
+    AssertTrue(engine.IsRunning(), L"ProbeEngine: starts");
+
+    TestLoopbackReplies(engine);
+    TestUnreachable(engine);
+    TestRemoveAndRestart(engine, resultsById, idCount);
+    TestNonBlocking(engine);
+    engine.Stop();
+
+    BenchmarkThousandTargets();
+}
+
+} // namespace NetworkMonitorTests
@@ -0,0 +1,408 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/Utils.h"
+#include "NetworkMonitor/HistoryExport.h"
+#include "NetworkMonitor/HistoryLogger.h"
+#include "NetworkMonitor/SampleJournal.h"
+#include "TestUtils.h"
+#include "sqlite3.h"
+
+#include <shellapi.h>
+#include <algorithm>
+#include <cwchar>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    const wchar_t* const JOURNAL_CHILD_ARG = L"--journal-child";
+    const wchar_t* const JOURNAL_VERIFY_ARG = L"--journal-verify";
+    const wchar_t* const READ_ONLY_EXPORT_ARG = L"--read-only-export";
+    const wchar_t* const JOURNAL_IFACE = L"JournalIface";
+
+    void RemoveStoreFiles(const std::wstring& dir)
+    {
+        const wchar_t* files[] = {
+            L"\\network_usage.db", L"\\network_usage.db-wal", L"\\network_usage.db-shm",
+            L"\\network_usage.journal", L"\\acks.txt"
+        };
+        for (const wchar_t* file : files)
+        {
+            DeleteFileW((dir + file).c_str());
+        }
+    }
+
+    // Child: append samples with unique bytesDown ordinals, logging each one
+    // to acks.txt only after AppendSample has returned.
+    int RunJournalWriterChild(const std::wstring& dir, unsigned long long start)
+    {
+        HistoryLogger::SetStorageDirectory(dir);
+        HistoryLogger& logger = HistoryLogger::Instance();
+
+        HANDLE ackFile = CreateFileW((dir + L"\\acks.txt").c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                                     CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (ackFile == INVALID_HANDLE_VALUE)
+        {
+            return 3;
+        }
+
+        for (unsigned long long ordinal = start; ordinal < start + 1000000ULL; ++ordinal)
+        {
+            logger.AppendSample(JOURNAL_IFACE, ordinal, 1ULL);
+
+            std::string line = std::to_string(ordinal) + "\n";
+            DWORD written = 0;
+            WriteFile(ackFile, line.data(), static_cast<DWORD>(line.size()), &written, nullptr);
+        }
+
+        CloseHandle(ackFile);
+        return 0;
+    }
+
+    // Child: opening the store replays the journal; flush and exit cleanly.
+    int RunJournalVerifyChild(const std::wstring& dir)
+    {
+        HistoryLogger::SetStorageDirectory(dir);
+        HistoryLogger::Instance().Flush();
+        return 0;
+    }
+
+    // Child: export the store as a command-line export next to the tray
+    // instance would, without writing to it.
+    int RunReadOnlyExportChild(const std::wstring& dir, const std::wstring& path)
+    {
+        HistoryLogger::SetStorageDirectory(dir);
+        HistoryLogger::SetReadOnly(true);
+        unsigned long long rows = 0;
+        bool ok = HistoryLogger::Instance().ExportHistory(path, HistoryExportFormat::Csv, 0, 0, nullptr, &rows);
+        return (ok && rows == 3) ? 0 : 1;
+    }
+
+    bool RunChild(const std::wstring& args, DWORD killAfterMs, DWORD& exitCode)
+    {
+        wchar_t exePath[MAX_PATH] = {0};
+        GetModuleFileNameW(nullptr, exePath, MAX_PATH);
+
+        std::wstring commandLine = L"\"" + std::wstring(exePath) + L"\" " + args;
+        std::vector<wchar_t> buffer(commandLine.begin(), commandLine.end());
+        buffer.push_back(L'\0');
+
+        STARTUPINFOW si = {};
+        si.cb = sizeof(si);
+        PROCESS_INFORMATION pi = {};
+        if (!CreateProcessW(nullptr, buffer.data(), nullptr, nullptr, FALSE, CREATE_NO_WINDOW,
+                            nullptr, nullptr, &si, &pi))
+        {
+            return false;
+        }
+
+        if (killAfterMs != INFINITE && WaitForSingleObject(pi.hProcess, killAfterMs) == WAIT_TIMEOUT)
+        {
+            TerminateProcess(pi.hProcess, 9);
+        }
+        WaitForSingleObject(pi.hProcess, INFINITE);
+
+        exitCode = 0;
+        GetExitCodeProcess(pi.hProcess, &exitCode);
+        CloseHandle(pi.hProcess);
+        if (pi.hThread)
+        {
+            CloseHandle(pi.hThread);
+        }
+        return true;
+    }
+
+    unsigned long long ReadLastAck(const std::wstring& dir)
+    {
+        HANDLE file = CreateFileW((dir + L"\\acks.txt").c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                  nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return 0;
+        }
+
+        std::string content;
+        char chunk[65536];
+        DWORD read = 0;
+        while (ReadFile(file, chunk, sizeof(chunk), &read, nullptr) && read > 0)
+        {
+            content.append(chunk, read);
+        }
+        CloseHandle(file);
+
+        // Only lines terminated by '\n' count as acknowledged
+        size_t end = content.rfind('\n');
+        if (end == std::string::npos)
+        {
+            return 0;
+        }
+        size_t begin = content.rfind('\n', end - 1);
+        begin = (begin == std::string::npos || end == 0) ? 0 : begin + 1;
+        return std::stoull(content.substr(begin, end - begin));
+    }
+
+    bool ReadStoredOrdinals(const std::wstring& dir, std::vector<unsigned long long>& ordinals)
+    {
+        ordinals.clear();
+
+        sqlite3* db = nullptr;
+        std::wstring path = dir + L"\\network_usage.db";
+        if (sqlite3_open16(path.c_str(), &db) != SQLITE_OK)
+        {
+            sqlite3_close(db);
+            return false;
+        }
+
+        sqlite3_stmt* stmt = nullptr;
+        bool ok = (sqlite3_prepare_v2(db, "SELECT bytes_down FROM usage WHERE interface = 'JournalIface';",
+                                      -1, &stmt, nullptr) == SQLITE_OK);
+        while (ok && sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            ordinals.push_back(static_cast<unsigned long long>(sqlite3_column_int64(stmt, 0)));
+        }
+        sqlite3_finalize(stmt);
+        sqlite3_close(db);
+        return ok;
+    }
+
+    // A read-only process exports what is there and leaves the schema,
+    // the rollup and the journal to the process that owns them
+    void RunReadOnlyTests()
+    {
+        std::wstring dir = TempFilePath(L"nm_read_only_test");
+        std::wstring exportPath = TempFilePath(L"nm_read_only_export.csv");
+        CreateDirectoryW(dir.c_str(), nullptr);
+        RemoveStoreFiles(dir);
+        DeleteFileW(exportPath.c_str());
+
+        DWORD exitCode = 0;
+        std::wstring args = std::wstring(READ_ONLY_EXPORT_ARG) + L" \"" + dir + L"\" \"" + exportPath + L"\"";
+        bool ran = RunChild(args, INFINITE, exitCode);
+        AssertTrue(ran && exitCode != 0 && !FileExists(dir + L"\\network_usage.db"),
+                   L"HistoryLogger read-only: a missing database is not created");
+
+        // Rows written behind the logger's back, so opening the store for
+        // writing would build usage_minute from them
+        ran = RunChild(std::wstring(JOURNAL_VERIFY_ARG) + L" \"" + dir + L"\"", INFINITE, exitCode) && exitCode == 0;
+        DeleteFileW((dir + L"\\network_usage.journal").c_str());
+        sqlite3* db = nullptr;
+        if (sqlite3_open16((dir + L"\\network_usage.db").c_str(), &db) == SQLITE_OK)
+        {
+            sqlite3_exec(db, "INSERT INTO usage (timestamp, interface, bytes_down, bytes_up) "
+                             "VALUES (1000, 'ReadOnly', 1, 1), (1001, 'ReadOnly', 2, 2), (1002, 'ReadOnly', 3, 3);",
+                         nullptr, nullptr, nullptr);
+        }
+        sqlite3_close(db);
+
+        ran = ran && RunChild(args, INFINITE, exitCode);
+        AssertTrue(ran && exitCode == 0, L"HistoryLogger read-only: exports the stored rows");
+        AssertTrue(QueryDatabase(dir + L"\\network_usage.db", "SELECT COUNT(*) FROM usage_minute;") == 0 &&
+                   !FileExists(dir + L"\\network_usage.journal"),
+                   L"HistoryLogger read-only: neither the database nor the journal is written");
+
+        RemoveStoreFiles(dir);
+        DeleteFileW(exportPath.c_str());
+    }
+
+    void RunRingTests()
+    {
+        std::wstring path = TempFilePath(L"nm_ring_test.journal");
+        DeleteFileW(path.c_str());
+
+        {
+            SampleJournal journal;
+            AssertTrue(journal.Open(path, 8), L"SampleJournal.Open creates a journal");
+
+            std::vector<JournalSample> pending;
+            journal.ReadPending(0, pending);
+            AssertTrue(pending.empty(), L"SampleJournal new journal has nothing pending");
+
+            for (unsigned long long i = 1; i <= 5; ++i)
+            {
+                journal.Append(static_cast<std::time_t>(1000 + i), L"Ethernet", i * 10ULL, i);
+            }
+            journal.MarkCommitted(3);
+
+            AssertTrue(journal.Append(0, std::wstring(SampleJournal::MAX_NAME_LENGTH + 1, L'x'), 1, 1) == 0,
+                       L"SampleJournal rejects names that do not fit a record");
+        }
+
+        {
+            SampleJournal journal;
+            AssertTrue(journal.Open(path, 64), L"SampleJournal.Open reopens an existing journal");
+
+            std::vector<JournalSample> pending;
+            journal.ReadPending(0, pending);
+            AssertTrue(pending.size() == 2 && pending[0].seq == 4 && pending[1].seq == 5 &&
+                       pending[1].bytesDown == 50ULL && pending[1].interfaceName == L"Ethernet" &&
+                       pending[1].timestamp == 1005,
+                       L"SampleJournal replays only records after the committed mark");
+
+            journal.ReadPending(5, pending);
+            AssertTrue(pending.empty(), L"SampleJournal skips records already stored in the database");
+
+            // Geometry of the existing file wins over the requested slot count
+            unsigned long long lastSeq = 0;
+            int accepted = 0;
+            while (!journal.IsFull() && accepted < 100)
+            {
+                lastSeq = journal.Append(0, L"Wi-Fi", 1, 1);
+                ++accepted;
+            }
+            AssertTrue(accepted == 8 && journal.Append(0, L"Wi-Fi", 1, 1) == 0,
+                       L"SampleJournal refuses appends when the ring is full");
+
+            journal.MarkCommitted(lastSeq);
+            AssertTrue(!journal.IsFull(), L"SampleJournal.MarkCommitted frees ring slots");
+        }
+
+        // Corrupt the newest record; it must be skipped rather than replayed
+        {
+            SampleJournal journal;
+            journal.Open(path);
+            std::vector<JournalSample> pending;
+            journal.ReadPending(0, pending);
+            unsigned long long seq = journal.Append(0, L"Torn", 7, 7);
+            journal.Close();
+
+            HANDLE file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+                                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            std::vector<char> bytes(1 << 16);
+            DWORD read = 0;
+            ReadFile(file, bytes.data(), static_cast<DWORD>(bytes.size()), &read, nullptr);
+            CloseHandle(file);
+
+            size_t recordSize = read / 9;   // header block + 8 slots
+            size_t offset = recordSize * (1 + (seq % 8)) + 16;   // inside bytesDown
+            bytes[offset] ^= 0x5A;
+
+            file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            DWORD written = 0;
+            WriteFile(file, bytes.data(), read, &written, nullptr);
+            CloseHandle(file);
+
+            journal.Open(path);
+            journal.ReadPending(0, pending);
+            AssertTrue(pending.empty(), L"SampleJournal drops records whose checksum does not match");
+        }
+
+        DeleteFileW(path.c_str());
+    }
+}
+
+bool RunSampleJournalChildProcess(int& exitCode)
+{
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if (!argv)
+    {
+        return false;
+    }
+
+    bool handled = false;
+    if (argc >= 4 && wcscmp(argv[1], JOURNAL_CHILD_ARG) == 0)
+    {
+        exitCode = RunJournalWriterChild(argv[2], std::wcstoull(argv[3], nullptr, 10));
+        handled = true;
+    }
+    else if (argc >= 3 && wcscmp(argv[1], JOURNAL_VERIFY_ARG) == 0)
+    {
+        exitCode = RunJournalVerifyChild(argv[2]);
+        handled = true;
+    }
+    else if (argc >= 4 && wcscmp(argv[1], READ_ONLY_EXPORT_ARG) == 0)
+    {
+        exitCode = RunReadOnlyExportChild(argv[2], argv[3]);
+        handled = true;
+    }
+
+    LocalFree(argv);
+    return handled;
+}
+
+void RunSampleJournalTests()
+{
+    LogTestMessage(L"=== SampleJournal tests ===");
+
+    RunRingTests();
+    RunReadOnlyTests();
+
+    // Kill a writer process at random points, then reopen the store in a
+    // fresh process and check every acknowledged sample is stored once.
+    std::wstring dir = TempFilePath(L"nm_journal_test");
+    CreateDirectoryW(dir.c_str(), nullptr);
+    RemoveStoreFiles(dir);
+
+    std::mt19937 rng(std::random_device{}());
+    std::uniform_int_distribution<DWORD> killDelay(20, 400);
+
+    unsigned long long nextOrdinal = 1;
+    bool allAcked = true;
+    bool noDuplicates = true;
+    bool childrenRan = true;
+    unsigned long long totalAcked = 0;
+    std::vector<std::pair<unsigned long long, unsigned long long>> ackedRanges;
+
+    const int rounds = 6;
+    for (int round = 0; round < rounds; ++round)
+    {
+        DeleteFileW((dir + L"\\acks.txt").c_str());
+
+        DWORD exitCode = 0;
+        std::wstring args = std::wstring(JOURNAL_CHILD_ARG) + L" \"" + dir + L"\" " + std::to_wstring(nextOrdinal);
+        childrenRan = RunChild(args, killDelay(rng), exitCode) && childrenRan;
+
+        unsigned long long lastAck = ReadLastAck(dir);
+
+        childrenRan = RunChild(std::wstring(JOURNAL_VERIFY_ARG) + L" \"" + dir + L"\"", INFINITE, exitCode) &&
+                      exitCode == 0 && childrenRan;
+
+        std::vector<unsigned long long> ordinals;
+        ReadStoredOrdinals(dir, ordinals);
+
+        std::set<unsigned long long> seen;
+        unsigned long long highest = 0;
+        for (unsigned long long ordinal : ordinals)
+        {
+            noDuplicates = seen.insert(ordinal).second && noDuplicates;
+            highest = (std::max)(highest, ordinal);
+        }
+
+        if (lastAck >= nextOrdinal)
+        {
+            ackedRanges.emplace_back(nextOrdinal, lastAck);
+            totalAcked += lastAck - nextOrdinal + 1;
+        }
+
+        // Everything acknowledged in this and earlier rounds must be present
+        for (const auto& range : ackedRanges)
+        {
+            for (unsigned long long ordinal = range.first; ordinal <= range.second && allAcked; ++ordinal)
+            {
+                allAcked = seen.count(ordinal) != 0;
+            }
+        }
+
+        nextOrdinal = (std::max)(lastAck, highest) + 1;
+    }
+
+    AssertTrue(childrenRan, L"SampleJournal kill test child processes ran");
+    AssertTrue(totalAcked > 0, L"SampleJournal kill test acknowledged samples before each kill");
+    AssertTrue(allAcked, L"SampleJournal no acknowledged sample is lost across kills");
+    AssertTrue(noDuplicates, L"SampleJournal no sample is stored twice after replay");
+
+    std::wstring msg = L"SampleJournal kill test: " + std::to_wstring(totalAcked) + L" acknowledged samples over " +
+                       std::to_wstring(rounds) + L" killed writers";
+    LogTestMessage(msg.c_str());
+
+    RemoveStoreFiles(dir);
+}
+
+} // namespace NetworkMonitorTests
@@ -0,0 +1,170 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/StringCatalog.h"
+#include "TestUtils.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cwchar>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    // The shape of the catalog files: comments, a BOM, CRLF line ends,
+    // trailing spaces and UTF-8 text
+    const char CATALOG_TEXT[] =
+        "\xEF\xBB\xBF# Vietnamese\r\n"
+        "\r\n"
+        "442=T\xE1\xBA\xA3i xu\xE1\xBB\x91ng: \r\n"
+        "443=T\xE1\xBA\xA3i l\xC3\xAAn: \r\n"
+        "446=D\xC3\xB2ng m\xE1\xBB\x99t\\nD\xC3\xB2ng hai\\t\\\\\r\n"
+        "401=NetworkMonitor\r\n"
+        "450=\r\n"
+        "443=Up (again): \n"
+        "460=\xF0\x9F\x93\xB6 \xC3\n";
+
+    void TestParsesText()
+    {
+        StringCatalog catalog;
+        AssertTrue(catalog.LoadFromText(CATALOG_TEXT), L"StringCatalog: text catalog loads");
+        AssertTrue(catalog.GetCount() == 6, L"StringCatalog: one entry per ID, duplicates counted once");
+
+        AssertTrue(catalog.Get(442) == L"Tải xuống: ", L"StringCatalog: UTF-8 text and trailing space kept");
+        AssertTrue(catalog.Get(443) == L"Up (again): ", L"StringCatalog: a later line for an ID wins");
+        AssertTrue(catalog.Get(446) == L"Dòng một\nDòng hai\t\\", L"StringCatalog: escapes resolved");
+        AssertTrue(catalog.Get(401) == L"NetworkMonitor", L"StringCatalog: lowest ID found");
+
+        std::wstring signal = L"\U0001F4F6 \uFFFD";
+        AssertTrue(catalog.Get(460) == signal, L"StringCatalog: astral code points and bad bytes decoded");
+    }
+
+    void TestMissingAndTerminated()
+    {
+        StringCatalog catalog;
+        AssertTrue(catalog.Get(401).empty() && catalog.Get(401).data()[0] == 0,
+                   L"StringCatalog: an empty catalog gives terminated empty views");
+
+        catalog.LoadFromText(CATALOG_TEXT);
+        bool terminated = true;
+        for (unsigned int id = 0; id < 70000; id += (id < 400 || id > 470) ? 97 : 1)
+        {
+            std::wstring_view text = catalog.Get(id);
+            terminated = terminated && text.data() != nullptr && text.data()[text.size()] == 0;
+        }
+        AssertTrue(terminated, L"StringCatalog: every view, found or not, is terminated");
+        AssertTrue(catalog.Get(450).empty() && catalog.Get(444).empty() && catalog.Get(0).empty() &&
+                   catalog.Get(0xFFFFFFFFu).empty(),
+                   L"StringCatalog: empty and missing IDs give empty views");
+        AssertTrue(std::wcscmp(catalog.Get(401).data(), L"NetworkMonitor") == 0,
+                   L"StringCatalog: data() can be used as a C string");
+    }
+
+    void TestRejectsMalformed()
+    {
+        StringCatalog catalog;
+        AssertTrue(!catalog.LoadFromText("401=ok\nno equals sign\n") && catalog.GetCount() == 0 &&
+                   catalog.Get(401).empty(),
+                   L"StringCatalog: a malformed line fails the load and leaves the catalog empty");
+        AssertTrue(!catalog.LoadFromText("abc=text\n") && !catalog.LoadFromText("65536=text\n") &&
+                   !catalog.LoadFromText("=text\n"),
+                   L"StringCatalog: IDs must be decimal and 16-bit");
+        AssertTrue(catalog.LoadFromText("65535=last\n0=first\n") && catalog.Get(65535) == L"last" &&
+                   catalog.Get(0) == L"first",
+                   L"StringCatalog: the full ID range is accepted");
+    }
+
+    void TestFileBackend()
+    {
+        std::wstring path = TempFilePath(L"nm_string_catalog_test.txt");
+        {
+            std::ofstream file(std::filesystem::path(path), std::ios::binary | std::ios::trunc);
+            file << CATALOG_TEXT;
+        }
+
+        StringCatalog catalog;
+        AssertTrue(catalog.LoadFromFile(path) && catalog.Get(442) == L"Tải xuống: ",
+                   L"StringCatalog: catalog file loads");
+        AssertTrue(!catalog.LoadFromFile(path + L".missing"), L"StringCatalog: a missing file fails");
+
+        AssertTrue(LoadStringCatalogFile(path) && LoadStringView(446).substr(0, 4) == L"Dòng",
+                   L"StringCatalog: a catalog file can be made active");
+        std::wstring_view before = LoadStringView(401);
+        AssertTrue(!LoadStringCatalogFile(path + L".missing") && LoadStringView(401) == L"NetworkMonitor",
+                   L"StringCatalog: a failed load keeps the active catalog");
+
+        // Replaced catalogs are kept, so an earlier view still reads
+        AssertTrue(LoadStringCatalogFile(path) && before == L"NetworkMonitor",
+                   L"StringCatalog: views survive a catalog switch");
+
+#ifdef _WIN32
+        ReloadStringCatalog(GetThreadUILanguage());
+#endif
+        DeleteFileW(path.c_str());
+    }
+
+    void TestLookupDoesNotAllocate()
+    {
+        StringCatalog catalog;
+        catalog.LoadFromText(CATALOG_TEXT);
+
+        size_t total = 0;
+        unsigned long long before = GetThreadAllocationCount();
+        for (int i = 0; i < 100000; ++i)
+        {
+            total += catalog.Get(442).size() + catalog.Get(443 + (i & 3)).size();
+        }
+        AssertTrue(total > 0 && GetThreadAllocationCount() == before, L"StringCatalog: lookups do not allocate");
+    }
+
+    // A view from the catalog against a string copied out per call, the
+    // way LoadStringResource returned them
+    void BenchmarkLookup()
+    {
+        StringCatalog catalog;
+        catalog.LoadFromText(CATALOG_TEXT);
+        const int calls = 1000000;
+        size_t sink = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < calls; ++i)
+        {
+            std::wstring copy(catalog.Get(i & 1 ? 442 : 443));
+            sink += copy.size();
+        }
+        double copied = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < calls; ++i)
+        {
+            sink += catalog.Get(i & 1 ? 442 : 443).size();
+        }
+        double viewed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        AssertTrue(sink > 0, L"StringCatalog: lookups return the entries");
+
+        wchar_t msg[200] = {0};
+        swprintf(msg, 200, L"[bench] string lookup ns/call: wstring copy %.1f, catalog view %.2f",
+                 copied / calls, viewed / calls);
+        LogTestMessage(msg);
+    }
+}
+
+void RunStringCatalogTests()
+{
+    LogTestMessage(L"=== StringCatalog tests ===");
+
+    TestParsesText();
+    TestMissingAndTerminated();
+    TestRejectsMalformed();
+    TestFileBackend();
+    TestLookupDoesNotAllocate();
+    BenchmarkLookup();
+}
+
+} // namespace NetworkMonitorTests
@@ -63,8 +63,8 @@ void RunTrayIconTests()
         return;
     }
 
-    AppConfig config;
-    icon.SetConfigSource(&config);
+    ConfigStore configStore;
+    icon.SetConfigSource(&configStore);
 
     NetworkStats stats;
     stats.currentDownloadSpeed = 1024.0;
@@ -0,0 +1,139 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/Units.h"
+#include "NetworkMonitor/Utils.h"
+#include "TestUtils.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    template <typename From, typename To, long long Num, long long Den = 1>
+    constexpr bool FactorIs()
+    {
+        return UnitFactor<From, To>::num == Num && UnitFactor<From, To>::den == Den;
+    }
+
+    // Every unit against bytes
+    static_assert(FactorIs<Bytes, Bytes, 1>(), "B");
+    static_assert(FactorIs<Bits, Bytes, 1, 8>(), "bit");
+    static_assert(FactorIs<Kibibytes, Bytes, 1024LL>(), "KiB");
+    static_assert(FactorIs<Mebibytes, Bytes, 1048576LL>(), "MiB");
+    static_assert(FactorIs<Gibibytes, Bytes, 1073741824LL>(), "GiB");
+    static_assert(FactorIs<Tebibytes, Bytes, 1099511627776LL>(), "TiB");
+    static_assert(FactorIs<Kilobytes, Bytes, 1000LL>(), "kB");
+    static_assert(FactorIs<Megabytes, Bytes, 1000000LL>(), "MB");
+    static_assert(FactorIs<Gigabytes, Bytes, 1000000000LL>(), "GB");
+    static_assert(FactorIs<Terabytes, Bytes, 1000000000000LL>(), "TB");
+    static_assert(FactorIs<Kilobits, Bytes, 125LL>(), "kbit");
+    static_assert(FactorIs<Megabits, Bytes, 125000LL>(), "Mbit");
+    static_assert(FactorIs<Gigabits, Bytes, 125000000LL>(), "Gbit");
+
+    // The reverse factors, reduced
+    static_assert(FactorIs<Bytes, Bits, 8>(), "B -> bit");
+    static_assert(FactorIs<Bytes, Kibibytes, 1, 1024>(), "B -> KiB");
+    static_assert(FactorIs<Bytes, Mebibytes, 1, 1048576LL>(), "B -> MiB");
+    static_assert(FactorIs<Bytes, Megabits, 1, 125000LL>(), "B -> Mbit");
+
+    // Across prefixes and families
+    static_assert(FactorIs<Mebibytes, Kibibytes, 1024>(), "MiB -> KiB");
+    static_assert(FactorIs<Gibibytes, Mebibytes, 1024>(), "GiB -> MiB");
+    static_assert(FactorIs<Tebibytes, Gibibytes, 1024>(), "TiB -> GiB");
+    static_assert(FactorIs<Megabytes, Kilobytes, 1000>(), "MB -> kB");
+    static_assert(FactorIs<Kibibytes, Kilobytes, 128, 125>(), "KiB -> kB");
+    static_assert(FactorIs<Mebibytes, Megabits, 131072LL, 15625LL>(), "MiB -> Mbit");
+    static_assert(FactorIs<Megabytes, Megabits, 8>(), "MB -> Mbit");
+    static_assert(FactorIs<Gigabits, Megabits, 1000>(), "Gbit -> Mbit");
+
+    // Conversions fold at compile time, integers included
+    static_assert(UnitCast<Bytes>(DataSize<Mebibytes, unsigned long long>(10)).Count() == 10485760ULL, "10 MiB");
+    static_assert(UnitCast<Bits>(DataSize<Bytes, int>(3)).Count() == 24, "3 B");
+    static_assert(UnitCast<Bytes>(DataRate<Mebibytes>(1.0)).Count() == 1048576.0, "1 MiB/s");
+    static_assert(UnitCast<Kibibytes>(DataRate<Bytes>(1536.0)).Count() == 1.5, "1536 B/s");
+    static_assert(UnitCast<Megabits>(DataRate<Bytes>(125000.0)).Count() == 1.0, "125000 B/s");
+    static_assert(UnitCast<Gibibytes>(DataSize<Tebibytes>(2.0)).Count() == 2048.0, "2 TiB");
+    static_assert(DataRate<Kibibytes>(DataRate<Mebibytes>(0.5)).Count() == 512.0, "implicit conversion");
+
+    // Sizes and rates are different dimensions
+    static_assert(!std::is_convertible<DataSize<Bytes>, DataRate<Bytes>>::value, "size is not a rate");
+    static_assert(!std::is_convertible<DataRate<Bytes>, DataSize<Bytes>>::value, "rate is not a size");
+
+    // The formulas ConvertSpeed used before the unit types
+    double ReferenceConvertSpeed(double bytesPerSecond, SpeedUnit unit)
+    {
+        switch (unit)
+        {
+        case SpeedUnit::BytesPerSecond:
+            return bytesPerSecond;
+        case SpeedUnit::KiloBytesPerSecond:
+            return bytesPerSecond / 1024.0;
+        case SpeedUnit::MegaBytesPerSecond:
+            return bytesPerSecond / (1024.0 * 1024.0);
+        case SpeedUnit::MegaBitsPerSecond:
+            return (bytesPerSecond * 8.0) / (1000.0 * 1000.0);
+        default:
+            return bytesPerSecond / 1024.0;
+        }
+    }
+
+    bool SameBits(double a, double b)
+    {
+        return std::memcmp(&a, &b, sizeof(a)) == 0;
+    }
+
+    void TestConvertSpeedUnchanged()
+    {
+        const SpeedUnit units[] = { SpeedUnit::BytesPerSecond, SpeedUnit::KiloBytesPerSecond,
+                                    SpeedUnit::MegaBytesPerSecond, SpeedUnit::MegaBitsPerSecond,
+                                    static_cast<SpeedUnit>(42) };
+        std::vector<double> values = { 0.0, -0.0, 1.0, 0.1, 1023.999, 1024.0, 125000.0, 1e-300, 1e300, -2048.5 };
+        unsigned long long seed = 11;
+        for (int i = 0; i < 20000; ++i)
+        {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            values.push_back(static_cast<double>(seed >> 11) / static_cast<double>(1ULL << (seed % 40)));
+        }
+
+        bool same = true;
+        for (double value : values)
+        {
+            for (SpeedUnit unit : units)
+            {
+                same = same && SameBits(ConvertSpeed(value, unit), ReferenceConvertSpeed(value, unit));
+            }
+        }
+        AssertTrue(same, L"Units: ConvertSpeed gives the same bits as the old formulas, unknown units included");
+    }
+
+    void TestVisitSpeedUnit()
+    {
+        AssertTrue(VisitSpeedUnit(SpeedUnit::BytesPerSecond, [](auto unit) {
+                       return std::is_same<decltype(unit), Bytes>::value;
+                   }) &&
+                   VisitSpeedUnit(SpeedUnit::KiloBytesPerSecond, [](auto unit) {
+                       return std::is_same<decltype(unit), Kibibytes>::value;
+                   }) &&
+                   VisitSpeedUnit(SpeedUnit::MegaBytesPerSecond, [](auto unit) {
+                       return std::is_same<decltype(unit), Mebibytes>::value;
+                   }) &&
+                   VisitSpeedUnit(SpeedUnit::MegaBitsPerSecond, [](auto unit) {
+                       return std::is_same<decltype(unit), Megabits>::value;
+                   }),
+                   L"Units: each SpeedUnit maps to its unit type");
+    }
+}
+
+void RunUnitsTests()
+{
+    LogTestMessage(L"=== Units tests ===");
+
+    TestConvertSpeedUnchanged();
+    TestVisitSpeedUnit();
+}
+
+} // namespace NetworkMonitorTests
@@ -0,0 +1,343 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/BillingCycle.h"
+#include "NetworkMonitor/HistoryLogger.h"
+#include "NetworkMonitor/SampleJournal.h"
+#include "NetworkMonitor/UsageDeltaTracker.h"
+#include "TestUtils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cwchar>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    NetworkStats Counters(const std::wstring& name, ULONG64 received, ULONG64 sent)
+    {
+        NetworkStats stats;
+        stats.interfaceName = name;
+        stats.bytesReceived = received;
+        stats.bytesSent = sent;
+        stats.isActive = true;
+        return stats;
+    }
+
+    // Usage by interface name, for order-independent comparisons
+    std::map<std::wstring, std::pair<unsigned long long, unsigned long long>>
+    ByName(const std::vector<InterfaceUsage>& usage)
+    {
+        std::map<std::wstring, std::pair<unsigned long long, unsigned long long>> result;
+        for (const InterfaceUsage& entry : usage)
+        {
+            result[entry.interfaceName] = std::make_pair(entry.bytesDown, entry.bytesUp);
+        }
+        return result;
+    }
+
+    void TestBaselineAndDeltas()
+    {
+        UsageDeltaTracker tracker;
+        std::vector<InterfaceUsage> usage;
+
+        tracker.Update({ Counters(L"Ethernet", 1000, 500), Counters(L"Wi-Fi", 70, 30) }, usage);
+        AssertTrue(usage.empty() && tracker.TrackedInterfaces() == 2,
+                   L"UsageDeltaTracker: first tick only sets baselines");
+
+        tracker.Update({ Counters(L"Ethernet", 1600, 520), Counters(L"Wi-Fi", 70, 30) }, usage);
+        auto deltas = ByName(usage);
+        AssertTrue(usage.size() == 1 && deltas[L"Ethernet"] == std::make_pair(600ULL, 20ULL),
+                   L"UsageDeltaTracker: per-interface deltas, idle interfaces skipped");
+    }
+
+    void TestPerInterfaceReset()
+    {
+        UsageDeltaTracker tracker;
+        std::vector<InterfaceUsage> usage;
+
+        tracker.Update({ Counters(L"Ethernet", 5000, 5000), Counters(L"Wi-Fi", 100, 100) }, usage);
+
+        // Ethernet's receive counter restarts; its send counter and Wi-Fi
+        // keep counting
+        tracker.Update({ Counters(L"Ethernet", 40, 5300), Counters(L"Wi-Fi", 180, 110) }, usage);
+        auto deltas = ByName(usage);
+        AssertTrue(deltas[L"Ethernet"] == std::make_pair(0ULL, 300ULL) &&
+                   deltas[L"Wi-Fi"] == std::make_pair(80ULL, 10ULL),
+                   L"UsageDeltaTracker: a counter reset only affects that interface and direction");
+
+        tracker.Update({ Counters(L"Ethernet", 90, 5400), Counters(L"Wi-Fi", 180, 110) }, usage);
+        deltas = ByName(usage);
+        AssertTrue(usage.size() == 1 && deltas[L"Ethernet"] == std::make_pair(50ULL, 100ULL),
+                   L"UsageDeltaTracker: counting resumes from the value after the reset");
+    }
+
+    void TestInterfaceComesAndGoes()
+    {
+        UsageDeltaTracker tracker;
+        std::vector<InterfaceUsage> usage;
+
+        tracker.Update({ Counters(L"Ethernet", 100, 100), Counters(L"VPN", 100, 100) }, usage);
+        tracker.Update({ Counters(L"Ethernet", 200, 200) }, usage);
+        AssertTrue(tracker.TrackedInterfaces() == 1 && usage.size() == 1,
+                   L"UsageDeltaTracker: an interface missing from a tick is forgotten");
+
+        // VPN reconnects with counters far past its old baseline; none of
+        // the traffic while it was gone is attributed to this tick
+        tracker.Update({ Counters(L"Ethernet", 300, 300), Counters(L"VPN", 9000, 9000) }, usage);
+        auto deltas = ByName(usage);
+        AssertTrue(usage.size() == 1 && deltas.count(L"VPN") == 0,
+                   L"UsageDeltaTracker: a returning interface starts a new baseline");
+
+        tracker.Update({ Counters(L"Ethernet", 300, 300), Counters(L"VPN", 9500, 9100) }, usage);
+        deltas = ByName(usage);
+        AssertTrue(deltas[L"VPN"] == std::make_pair(500ULL, 100ULL),
+                   L"UsageDeltaTracker: a returning interface is tracked again");
+    }
+
+    void TestAppendSamplesBatch()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        AssertTrue(logger.DeleteAll(), L"HistoryLogger.DeleteAll before AppendSamples test");
+
+        // 100 interfaces plus one without traffic, all in one call
+        std::vector<InterfaceUsage> usage(101);
+        unsigned long long expectedDown = 0;
+        unsigned long long expectedUp = 0;
+        for (size_t i = 0; i < usage.size(); ++i)
+        {
+            usage[i].interfaceName = L"BatchIface" + std::to_wstring(static_cast<unsigned long long>(i));
+            usage[i].bytesDown = (i == 100) ? 0 : 1000 + i;
+            usage[i].bytesUp = (i == 100) ? 0 : 10 + i;
+            expectedDown += usage[i].bytesDown;
+            expectedUp += usage[i].bytesUp;
+        }
+        logger.AppendSamples(usage);
+
+        // Read-your-writes covers every row of the batch
+        unsigned long long down = 0;
+        unsigned long long up = 0;
+        AssertTrue(logger.GetTotalsToday(down, up) && down == expectedDown && up == expectedUp,
+                   L"HistoryLogger.AppendSamples: unfiltered totals are the sum of all interfaces");
+
+        std::wstring filter = L"BatchIface42";
+        AssertTrue(logger.GetTotalsToday(down, up, &filter) && down == 1042 && up == 52,
+                   L"HistoryLogger.AppendSamples: each interface is stored under its own name");
+
+        std::time_t timestamp = 0;
+        bool sameTimestamp = true;
+        size_t rows = 0;
+        logger.ForEachSample(HistoryQuery(), [&](const HistorySampleView& row) {
+            sameTimestamp = sameTimestamp && (rows == 0 || row.timestamp == timestamp);
+            timestamp = row.timestamp;
+            ++rows;
+            return true;
+        });
+        AssertTrue(rows == 100 && sameTimestamp,
+                   L"HistoryLogger.AppendSamples: one row per active interface, sharing the tick's timestamp");
+
+        BillingStatus billing;
+        AssertTrue(logger.GetBillingStatus(&filter, 0, billing) && billing.bytesDown == 1042 && billing.bytesUp == 52,
+                   L"HistoryLogger.AppendSamples: billing-cycle totals follow the batch");
+
+        logger.DeleteAll();
+    }
+
+    std::vector<InterfaceUsage> TickOf(size_t ifaceCount, const wchar_t* prefix)
+    {
+        std::vector<InterfaceUsage> usage(ifaceCount);
+        for (size_t i = 0; i < ifaceCount; ++i)
+        {
+            usage[i].interfaceName = prefix + std::to_wstring(static_cast<unsigned long long>(i));
+            usage[i].bytesDown = 1000;
+            usage[i].bytesUp = 10;
+        }
+        return usage;
+    }
+
+    // With the writer held up and the journal full, a tick waits for room
+    // once rather than once per interface and later ticks do not wait;
+    // every sample is still stored
+    void TestFullJournalWaitsOnce()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+        logger.DeleteAll();
+
+        // An import whose producer blocks keeps the writer thread busy
+        std::mutex mutex;
+        std::condition_variable changed;
+        bool holding = false;
+        bool released = false;
+        std::thread holder([&]() {
+            logger.ImportSamples([&](const HistorySampleVisitor&) {
+                std::unique_lock<std::mutex> lock(mutex);
+                holding = true;
+                changed.notify_all();
+                changed.wait(lock, [&]() { return released; });
+                return true;
+            });
+        });
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() { return holding; });
+        }
+
+        logger.AppendSamples(TickOf(SampleJournal::DEFAULT_SLOT_COUNT, L"FillIface"));
+
+        // Ten interfaces: one two-second wait instead of ten
+        auto start = std::chrono::steady_clock::now();
+        logger.AppendSamples(TickOf(10, L"FullIface"));
+        double fullTickSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        logger.AppendSamples(TickOf(10, L"NextIface"));
+        double nextTickSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            released = true;
+        }
+        changed.notify_all();
+        holder.join();
+        logger.Flush();
+
+        unsigned long long down = 0;
+        unsigned long long up = 0;
+        AssertTrue(logger.GetTotalsToday(down, up) && down == (SampleJournal::DEFAULT_SLOT_COUNT + 20) * 1000ULL,
+                   L"HistoryLogger.AppendSamples: samples queued past a full journal are still stored");
+
+        // One wait of about two seconds, then none; a wait per interface
+        // would take twenty
+        wchar_t msg[160] = {0};
+        swprintf(msg, 160, L"[bench] 10-interface tick with the journal full: %.2f s, next tick %.2f s",
+                 fullTickSeconds, nextTickSeconds);
+        LogTestMessage(msg);
+
+        logger.DeleteAll();
+    }
+
+    struct TickRates
+    {
+        double committed;   // Ticks per second, each committed before the next
+        double queued;      // Ticks per second spent in the Append calls alone
+
+        TickRates()
+            : committed(0.0)
+            , queued(0.0)
+        {
+        }
+    };
+
+    // Ticks of ifaceCount interfaces, each committed before the next as the
+    // one-second timer would
+    TickRates MeasureTicks(int ifaceCount, int ticks, bool batched)
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+
+        std::vector<NetworkStats> stats;
+        for (int i = 0; i < ifaceCount; ++i)
+        {
+            stats.push_back(Counters(L"BenchIface" + std::to_wstring(static_cast<unsigned long long>(i)), 0, 0));
+        }
+
+        UsageDeltaTracker tracker;
+        std::vector<InterfaceUsage> usage;
+        tracker.Update(stats, usage);
+
+        double appendSeconds = 0.0;
+        auto start = std::chrono::steady_clock::now();
+        for (int tick = 1; tick <= ticks; ++tick)
+        {
+            for (int i = 0; i < ifaceCount; ++i)
+            {
+                stats[i].bytesReceived += 1000 + (tick * 7 + i) % 500;
+                stats[i].bytesSent += 100 + (tick + i) % 50;
+            }
+
+            tracker.Update(stats, usage);
+            auto appendStart = std::chrono::steady_clock::now();
+            if (batched)
+            {
+                logger.AppendSamples(usage);
+            }
+            else
+            {
+                for (const InterfaceUsage& entry : usage)
+                {
+                    logger.AppendSample(entry.interfaceName, entry.bytesDown, entry.bytesUp);
+                }
+            }
+            appendSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - appendStart).count();
+            logger.Flush();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        TickRates rates;
+        rates.committed = (seconds > 0.0) ? ticks / seconds : 0.0;
+        rates.queued = (appendSeconds > 0.0) ? ticks / appendSeconds : 0.0;
+        return rates;
+    }
+
+    void BenchmarkTicksAt100Interfaces()
+    {
+        HistoryLogger& logger = HistoryLogger::Instance();
+
+        // Alternate the two paths and keep the best round of each, so a
+        // busy moment on the machine does not decide the comparison
+        const int ticks = 300;
+        const int rounds = 3;
+        TickRates perSample;
+        TickRates batched;
+        for (int round = 0; round < rounds; ++round)
+        {
+            logger.DeleteAll();
+            TickRates single = MeasureTicks(100, ticks, false);
+            logger.DeleteAll();
+            TickRates batch = MeasureTicks(100, ticks, true);
+
+            perSample.committed = (std::max)(perSample.committed, single.committed);
+            perSample.queued = (std::max)(perSample.queued, single.queued);
+            batched.committed = (std::max)(batched.committed, batch.committed);
+            batched.queued = (std::max)(batched.queued, batch.queued);
+        }
+
+        unsigned long long down = 0;
+        unsigned long long up = 0;
+        AssertTrue(logger.GetTotalsToday(down, up) && down > 0,
+                   L"HistoryLogger.AppendSamples: benchmark ticks were recorded");
+
+        // Both paths commit a tick in one transaction, so the writer's work
+        // is the same; the batch saves the caller 99 lock round trips,
+        // journal write-backs and writer wake-ups
+        wchar_t msg[256] = {0};
+        swprintf(msg, 256,
+                 L"[bench] 100 interfaces, %d committed ticks: AppendSamples %.0f ticks/s (%.0f queued/s), "
+                 L"AppendSample per interface %.0f ticks/s (%.0f queued/s)",
+                 ticks, batched.committed, batched.queued, perSample.committed, perSample.queued);
+        LogTestMessage(msg);
+
+        logger.DeleteAll();
+    }
+}
+
+void RunUsageDeltaTests()
+{
+    LogTestMessage(L"=== Per-interface usage logging tests ===");
+
+    TestBaselineAndDeltas();
+    TestPerInterfaceReset();
+    TestInterfaceComesAndGoes();
+    TestAppendSamplesBatch();
+    TestFullJournalWaitsOnce();
+    BenchmarkTicksAt100Interfaces();
+}
+
+} // namespace NetworkMonitorTests
@@ -0,0 +1,314 @@
+#include "NetworkMonitor/Common.h"
+#include "NetworkMonitor/Utils.h"
+#include "NetworkMonitor/ValueFormat.h"
+#include "TestUtils.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cwchar>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace NetworkMonitor;
+
+namespace NetworkMonitorTests
+{
+
+namespace
+{
+    const SpeedUnit ALL_UNITS[] = { SpeedUnit::BytesPerSecond, SpeedUnit::KiloBytesPerSecond,
+                                    SpeedUnit::MegaBytesPerSecond, SpeedUnit::MegaBitsPerSecond };
+
+    // The stream-based FormatSpeed / FormatBytes the engine replaced; the
+    // new text must match it character for character
+    template <typename Stream>
+    std::basic_string<typename Stream::char_type> ReferenceFormatSpeed(double bytesPerSecond, SpeedUnit unit)
+    {
+        constexpr double KB = 1024.0;
+        constexpr double MB = KB * 1024.0;
+
+        double value = 0.0;
+        const char* unitText = "";
+        switch (unit)
+        {
+        case SpeedUnit::BytesPerSecond:
+            value = bytesPerSecond;
+            unitText = "B/s";
+            if (value >= KB)
+            {
+                value /= KB;
+                unitText = "KB/s";
+            }
+            if (value >= KB)
+            {
+                value /= KB;
+                unitText = "MB/s";
+            }
+            if (value >= KB)
+            {
+                value /= KB;
+                unitText = "GB/s";
+            }
+            break;
+        case SpeedUnit::KiloBytesPerSecond:
+            value = bytesPerSecond / KB;
+            unitText = "KB/s";
+            if (value >= KB)
+            {
+                value /= KB;
+                unitText = "MB/s";
+            }
+            if (value >= KB)
+            {
+                value /= KB;
+                unitText = "GB/s";
+            }
+            break;
+        case SpeedUnit::MegaBytesPerSecond:
+            value = bytesPerSecond / MB;
+            unitText = "MB/s";
+            if (value >= KB)
+            {
+                value /= KB;
+                unitText = "GB/s";
+            }
+            break;
+        case SpeedUnit::MegaBitsPerSecond:
+        default:
+            value = (bytesPerSecond * 8.0) / 1000000.0;
+            unitText = "Mbps";
+            break;
+        }
+
+        Stream oss;
+        oss << std::fixed << std::setprecision(2) << value << ' ' << unitText;
+        return oss.str();
+    }
+
+    template <typename Stream>
+    std::basic_string<typename Stream::char_type> ReferenceFormatBytes(ULONG64 bytes)
+    {
+        const double KB = 1024.0;
+        const double MB = KB * 1024.0;
+        const double GB = MB * 1024.0;
+        const double TB = GB * 1024.0;
+
+        Stream oss;
+        oss << std::fixed << std::setprecision(2);
+        if (bytes >= TB)
+        {
+            oss << (bytes / TB) << " TB";
+        }
+        else if (bytes >= GB)
+        {
+            oss << (bytes / GB) << " GB";
+        }
+        else if (bytes >= MB)
+        {
+            oss << (bytes / MB) << " MB";
+        }
+        else if (bytes >= KB)
+        {
+            oss << (bytes / KB) << " KB";
+        }
+        else
+        {
+            oss << bytes << " B";
+        }
+        return oss.str();
+    }
+
+    std::vector<double> SpeedSamples()
+    {
+        // Rounding edges, unit edges, then a spread of magnitudes
+        std::vector<double> values = { 0.0, 0.004, 0.005, 0.015, 0.125, 0.135, 1.005, 2.675, 999.995, 1023.99,
+                                       1023.995, 1023.999, 1024.0, 1025.0, 1048575.0, 1048576.0, 125000.0,
+                                       1073741823.0, 1073741824.0, 1e12, 1e15, 1e18, -1.0, -0.001, -2048.5,
+                                       -0.0, 4.5e13, 4.5036e13, 9.9e19 };
+        // Values on or next to a tie at the third decimal
+        for (int i = 0; i < 4000; ++i)
+        {
+            values.push_back(i * 0.005);
+            values.push_back(i / 8.0 + 1024.0 * i);
+            values.push_back(std::nextafter(i * 0.005, 0.0));
+        }
+        unsigned long long seed = 42;
+        for (int i = 0; i < 20000; ++i)
+        {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            double fraction = static_cast<double>(seed >> 11) / 9007199254740992.0;
+            double magnitude = static_cast<double>((seed >> 3) % 13);
+            values.push_back(fraction * std::pow(10.0, magnitude));
+        }
+        return values;
+    }
+
+    std::vector<ULONG64> ByteSamples()
+    {
+        std::vector<ULONG64> values = { 0, 1, 512, 1023, 1024, 1025, 1536, 1048575, 1048576, 1073741823,
+                                        1073741824, 1099511627775ULL, 1099511627776ULL, 18446744073709551615ULL };
+        unsigned long long seed = 7;
+        for (int i = 0; i < 20000; ++i)
+        {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            values.push_back(seed >> (seed % 64));
+        }
+        return values;
+    }
+
+    void TestMatchesStreamOutput()
+    {
+        bool wideMatches = true;
+        bool narrowMatches = true;
+        bool stringMatches = true;
+        for (double value : SpeedSamples())
+        {
+            for (SpeedUnit unit : ALL_UNITS)
+            {
+                FormattedValue<wchar_t> wide;
+                FormattedValue<char> narrow;
+                FormatSpeedTo(value, unit, wide);
+                FormatSpeedTo(value, unit, narrow);
+                std::wstring expected = ReferenceFormatSpeed<std::wostringstream>(value, unit);
+                wideMatches = wideMatches && expected == wide.c_str() && wide.length == expected.size();
+                narrowMatches = narrowMatches && ReferenceFormatSpeed<std::ostringstream>(value, unit) == narrow.c_str();
+                stringMatches = stringMatches && FormatSpeed(value, unit) == expected;
+            }
+        }
+        AssertTrue(wideMatches, L"ValueFormat: wide speed text matches the stream output");
+        AssertTrue(narrowMatches, L"ValueFormat: narrow speed text matches the stream output");
+        AssertTrue(stringMatches, L"ValueFormat: FormatSpeed keeps its output");
+
+        wideMatches = true;
+        narrowMatches = true;
+        stringMatches = true;
+        for (ULONG64 value : ByteSamples())
+        {
+            FormattedValue<wchar_t> wide;
+            FormattedValue<char> narrow;
+            FormatBytesTo(value, wide);
+            FormatBytesTo(value, narrow);
+            std::wstring expected = ReferenceFormatBytes<std::wostringstream>(value);
+            wideMatches = wideMatches && expected == wide.c_str() && wide.length == expected.size();
+            narrowMatches = narrowMatches && ReferenceFormatBytes<std::ostringstream>(value) == narrow.c_str();
+            stringMatches = stringMatches && FormatBytes(value) == expected;
+        }
+        AssertTrue(wideMatches, L"ValueFormat: wide byte text matches the stream output");
+        AssertTrue(narrowMatches, L"ValueFormat: narrow byte text matches the stream output");
+        AssertTrue(stringMatches, L"ValueFormat: FormatBytes keeps its output");
+
+        AssertTrue(FormatBytes(512) == L"512 B" && FormatSpeed(1536.0, SpeedUnit::BytesPerSecond) == L"1.50 KB/s" &&
+                   FormatSpeed(125000.0, SpeedUnit::MegaBitsPerSecond) == L"1.00 Mbps",
+                   L"ValueFormat: spot values");
+    }
+
+    void TestBufferLimits()
+    {
+        wchar_t tooSmall[8];
+        std::wmemset(tooSmall, L'x', 8);
+        AssertTrue(FormatSpeedTo(1536.0, SpeedUnit::BytesPerSecond, tooSmall, 8) == 0 && tooSmall[0] == 0,
+                   L"ValueFormat: a buffer too small gets an empty string");
+
+        wchar_t exact[10];
+        AssertTrue(FormatSpeedTo(1536.0, SpeedUnit::BytesPerSecond, exact, 10) == 9 &&
+                   std::wcscmp(exact, L"1.50 KB/s") == 0,
+                   L"ValueFormat: text and terminator fill the buffer exactly");
+
+        FormattedValue<wchar_t> largest;
+        FormatBytesTo(18446744073709551615ULL, largest);
+        FormattedValue<wchar_t> fast;
+        FormatSpeedTo(9.9e19, SpeedUnit::MegaBitsPerSecond, fast);
+        AssertTrue(largest.length > 0 && fast.length > 0,
+                   L"ValueFormat: FormattedValue holds any byte count and speeds below 10^20");
+
+        wchar_t huge[MAX_FORMATTED_VALUE_CHARS];
+        AssertTrue(FormatSpeedTo(-1.7976931348623157e308, SpeedUnit::MegaBytesPerSecond, huge,
+                                 MAX_FORMATTED_VALUE_CHARS) > 300,
+                   L"ValueFormat: MAX_FORMATTED_VALUE_CHARS holds the largest double");
+    }
+
+    void TestNoAllocations()
+    {
+        std::vector<double> speeds = SpeedSamples();
+        std::vector<ULONG64> sizes = ByteSamples();
+
+        FormattedValue<wchar_t> wide;
+        FormattedValue<char> narrow;
+        unsigned long long before = GetThreadAllocationCount();
+        for (double value : speeds)
+        {
+            FormatSpeedTo(value, SpeedUnit::BytesPerSecond, wide);
+            FormatSpeedTo(value, SpeedUnit::MegaBitsPerSecond, narrow);
+        }
+        for (ULONG64 value : sizes)
+        {
+            FormatBytesTo(value, wide);
+            FormatBytesTo(value, narrow);
+        }
+        AssertTrue(GetThreadAllocationCount() == before, L"ValueFormat: formatting into buffers does not allocate");
+    }
+
+    template <typename Fn>
+    double NanosecondsPerCall(int rounds, const std::vector<double>& values, Fn fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < rounds; ++round)
+        {
+            for (double value : values)
+            {
+                fn(value);
+            }
+        }
+        double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        return elapsed / (static_cast<double>(rounds) * values.size());
+    }
+
+    void BenchmarkAgainstStreams()
+    {
+        std::vector<double> values = SpeedSamples();
+        values.resize(4096);
+        const int rounds = 50;
+        size_t sink = 0;
+
+        double stream = NanosecondsPerCall(rounds, values, [&sink](double value) {
+            sink += ReferenceFormatSpeed<std::wostringstream>(value, SpeedUnit::BytesPerSecond).size();
+        });
+        double wrapped = NanosecondsPerCall(rounds, values, [&sink](double value) {
+            sink += FormatSpeed(value, SpeedUnit::BytesPerSecond).size();
+        });
+        FormattedValue<wchar_t> wide;
+        double buffered = NanosecondsPerCall(rounds, values, [&sink, &wide](double value) {
+            FormatSpeedTo(value, SpeedUnit::BytesPerSecond, wide);
+            sink += wide.length;
+        });
+        FormattedValue<char> narrow;
+        double bufferedNarrow = NanosecondsPerCall(rounds, values, [&sink, &narrow](double value) {
+            FormatSpeedTo(value, SpeedUnit::BytesPerSecond, narrow);
+            sink += narrow.length;
+        });
+
+        AssertTrue(sink > 0 && buffered < stream, L"ValueFormat: buffered formatting beats the stream");
+
+        wchar_t msg[240] = {0};
+        swprintf(msg, 240,
+                 L"[bench] FormatSpeed ns/call: wostringstream %.1f, FormatSpeed %.1f, FormatSpeedTo wide %.1f "
+                 L"(%.1fx), narrow %.1f (%.1fx)",
+                 stream, wrapped, buffered, stream / buffered, bufferedNarrow, stream / bufferedNarrow);
+        LogTestMessage(msg);
+    }
+}
+
+void RunValueFormatTests()
+{
+    LogTestMessage(L"=== ValueFormat tests ===");
+
+    TestMatchesStreamOutput();
+    TestBufferLimits();
+    TestNoAllocations();
+    BenchmarkAgainstStreams();
+}
+
+} // namespace NetworkMonitorTests
@@ -0,0 +1,43 @@
+// ============================================================================
+// File: LogDecode.cpp
+// Description: Turns a binary debug log (NetworkMonitor.binlog) into text
+// Author: NetworkMonitor Project
+// ============================================================================
+
+#include "NetworkMonitor/BinaryLog.h"
+#include <cstdio>
+
+// Usage: NetworkMonitorLogDecode <file.binlog> [output.log]
+// Without an output path the text goes to standard output.
+int wmain(int argc, wchar_t* argv[])
+{
+    if (argc < 2 || argc > 3)
+    {
+        fwprintf(stderr, L"Usage: %ls <file.binlog> [output.log]\n", argv[0]);
+        return 2;
+    }
+
+    const std::wstring binaryPath = argv[1];
+    if (argc == 3)
+    {
+        unsigned long long records = 0;
+        if (!NetworkMonitor::DecodeBinaryLog(binaryPath, argv[2], &records))
+        {
+            fwprintf(stderr, L"Could not decode %ls\n", binaryPath.c_str());
+            return 1;
+        }
+        fwprintf(stderr, L"%llu lines written to %ls\n", records, argv[2]);
+        return 0;
+    }
+
+    bool ok = NetworkMonitor::ReadBinaryLog(binaryPath, [](const NetworkMonitor::DecodedLogRecord& record) {
+        std::string line = NetworkMonitor::FormatDecodedLogLine(record);
+        fwrite(line.data(), 1, line.size(), stdout);
+    });
+    if (!ok)
+    {
+        fwprintf(stderr, L"Could not decode %ls\n", binaryPath.c_str());
+        return 1;
+    }
+    return 0;
+}